@@ -17,6 +17,11 @@ void recognizeSpeech() {
 
     // Creates a speech recognizer
     auto recognizer = SpeechRecognizer::FromConfig(config);
+
+    // Opens the connection while the user starts to speak, ahead of RecognizeOnceAsync().
+    auto connection = Connection::FromRecognizer(recognizer);
+    connection->Open(false);
+
     cout << "Say something...\n";
 
     // Starts speech recognition, and returns after a single utterance is recognized. The end of a
@@ -17,6 +17,11 @@ void recognizeSpeech() {
 
     // Creates a speech recognizer
     auto recognizer = SpeechRecognizer::FromConfig(config);
+
+    // Opens the connection while the user starts to speak, ahead of RecognizeOnceAsync().
+    auto connection = Connection::FromRecognizer(recognizer);
+    connection->Open(false);
+
     cout << "Say something...\n";
 
     // Performs recognition. RecognizeOnceAsync() returns when the first utterance has been recognized,
@@ -10,6 +10,19 @@
 #include <locale>
 #include <codecvt>
 #include <string>
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <queue>
+#include <random>
+#include <thread>
+#include <vector>
 
 #include <cpprest/http_client.h>
 #include <cpprest/filestream.h>
@@ -28,7 +41,11 @@ const string_t subscriptionKey = U("YourSubscriptionKey");
 const string name = "Simple transcription";
 const string description = "Simple transcription description";
 const string myLocale = "en-US";
-const string recordingsBlobUri = "YourFileUrl";
+// Urls of the recordings to transcribe, each one is submitted as a separate transcription.
+const std::vector<string> recordingsBlobUris = { "YourFileUrl" };
+// Url of the container that local recordings are uploaded to, with a SAS token that allows creating, writing and
+// reading blobs. Used when the app is run with a directory of recordings, "quickstart <directory>".
+const string_t recordingsContainerUrl = U("YourContainerSasUrl");
 
 class TranscriptionDefinition {
 private:
@@ -36,13 +53,13 @@ private:
         string description,
         string locale,
         string recordingsUrl,
-        std::list<string> models) {
+        std::vector<string> models) {
 
-        Name = name;
-        Description = description;
-        RecordingsUrl = recordingsUrl;
-        Locale = locale;
-        Models = models;
+        Name = std::move(name);
+        Description = std::move(description);
+        RecordingsUrl = std::move(recordingsUrl);
+        Locale = std::move(locale);
+        Models = std::move(models);
     }
 
 public:
@@ -50,15 +67,15 @@ public:
     string Description;
     string RecordingsUrl;
     string Locale;
-    std::list<string> Models;
+    std::vector<string> Models;
     std::map<string, string> properties;
 
     static TranscriptionDefinition Create(string name, string description, string locale, string recordingsUrl) {
-        return TranscriptionDefinition(name, description, locale, recordingsUrl, std::list<string>());
+        return TranscriptionDefinition(std::move(name), std::move(description), std::move(locale), std::move(recordingsUrl), std::vector<string>());
     }
     static TranscriptionDefinition Create(string name, string description, string locale, string recordingsUrl,
-        std::list<string> models) {
-        return TranscriptionDefinition(name, description, locale, recordingsUrl, models);
+        std::vector<string> models) {
+        return TranscriptionDefinition(std::move(name), std::move(description), std::move(locale), std::move(recordingsUrl), std::move(models));
     }
 };
 
@@ -119,7 +136,28 @@ void from_json(const nlohmann::json& j, Transcription& t) {
     j.at("status").get_to(t.status);
     t.statusMessage = j.value("statusMessage", "");
 }
-class Result
+// Base of the result model classes. Results can be large, so they can only be moved, never copied by accident.
+class MoveOnly
+{
+protected:
+    MoveOnly() = default;
+    MoveOnly(MoveOnly&&) = default;
+    MoveOnly& operator=(MoveOnly&&) = default;
+    MoveOnly(const MoveOnly&) = delete;
+    MoveOnly& operator=(const MoveOnly&) = delete;
+};
+
+// Fills 'items' from a json array, allocating the storage once.
+template <typename T>
+void from_json_array(const nlohmann::json& j, std::vector<T>& items) {
+    items.clear();
+    items.reserve(j.size());
+    for (const auto& item : j) {
+        items.push_back(item.get<T>());
+    }
+}
+
+class Result : public MoveOnly
 {
 public:
     string Lexical;
@@ -147,163 +185,913 @@ void from_json(const nlohmann::json& j, NBest& nb) {
     j.at("Display").get_to(nb.Display);
 }
 
-class SegmentResult
+class SegmentResult : public MoveOnly
 {
 public:
     string RecognitionStatus;
-    ULONG Offset;
-    ULONG Duration;
-    std::list<NBest> NBest;
+    // In ticks of 100 ns. 32 bits would overflow for audio longer than about 7 minutes.
+    uint64_t Offset;
+    uint64_t Duration;
+    std::vector<NBest> NBest;
 };
 void from_json(const nlohmann::json& j, SegmentResult& sr) {
     j.at("RecognitionStatus").get_to(sr.RecognitionStatus);
     j.at("Offset").get_to(sr.Offset);
     j.at("Duration").get_to(sr.Duration);
-    sr.NBest = j.at("NBest").get<list<NBest>>();
+    from_json_array(j.at("NBest"), sr.NBest);
 }
 
-class AudioFileResult
+class AudioFileResult : public MoveOnly
 {
 public:
     string AudioFileName;
-    std::list<SegmentResult> SegmentResults;
-    std::list<Result> CombinedResults;
+    std::vector<SegmentResult> SegmentResults;
+    std::vector<Result> CombinedResults;
 };
 void from_json(const nlohmann::json& j, AudioFileResult& arf) {
     j.at("AudioFileName").get_to(arf.AudioFileName);
-    arf.SegmentResults = j.at("SegmentResults").get<list<SegmentResult>>();
-    arf.CombinedResults = j.at("CombinedResults").get<list<Result>>();
+    from_json_array(j.at("SegmentResults"), arf.SegmentResults);
+    from_json_array(j.at("CombinedResults"), arf.CombinedResults);
 }
 
-class RootObject {
+class RootObject : public MoveOnly {
 public:
-    std::list<AudioFileResult> AudioFileResults;
+    std::vector<AudioFileResult> AudioFileResults;
 };
 void from_json(const nlohmann::json& j, RootObject& r) {
-    r.AudioFileResults = j.at("AudioFileResults").get<list<AudioFileResult>>();
+    from_json_array(j.at("AudioFileResults"), r.AudioFileResults);
 }
 
 
-void recognizeSpeech()
+// Exposes the body of an http response as a std::streambuf. The body is read a block at a time as the
+// parser consumes it, so the response is never held in memory as a whole.
+class ResponseBodyStreambuf : public std::streambuf
+{
+public:
+    ResponseBodyStreambuf(concurrency::streams::istream body, size_t blockSize = 64 * 1024)
+        : m_body(body), m_block(blockSize)
+    {
+    }
+
+protected:
+    int_type underflow() override
+    {
+        if (gptr() < egptr())
+        {
+            return traits_type::to_int_type(*gptr());
+        }
+
+        auto count = m_body.streambuf().getn(reinterpret_cast<uint8_t*>(m_block.data()), m_block.size()).get();
+        if (count == 0)
+        {
+            return traits_type::eof();
+        }
+        setg(m_block.data(), m_block.data(), m_block.data() + count);
+        return traits_type::to_int_type(*gptr());
+    }
+
+private:
+    concurrency::streams::istream m_body;
+    std::vector<char> m_block;
+};
+
+// SAX handler for the transcription result document that hands out one SegmentResult at a time.
+// Only the segment being parsed is kept as a json value, so memory use does not grow with the length
+// of the transcript. CombinedResults are skipped.
+class SegmentResultReader
 {
-    std::wstring_convert<std::codecvt_utf8_utf16<wchar_t >> converter;
+public:
+    using SegmentCallback = std::function<void(const std::string& audioFileName, const SegmentResult& segment)>;
+    using AudioFileCallback = std::function<void(const std::string& audioFileName, size_t segmentCount)>;
+
+    SegmentResultReader(SegmentCallback onSegment, AudioFileCallback onAudioFileEnd)
+        : m_onSegment(onSegment), m_onAudioFileEnd(onAudioFileEnd)
+    {
+    }
+
+    // Parses the document from the stream. Throws on malformed json.
+    void Parse(std::istream& input)
+    {
+        m_frames.clear();
+        m_values.clear();
+        m_audioFileName.clear();
+        m_segmentCount = 0;
+        json::sax_parse(input, this);
+    }
+
+    bool null() { return Value(nullptr); }
+    bool boolean(bool val) { return Value(val); }
+    bool number_integer(json::number_integer_t val) { return Value(val); }
+    bool number_unsigned(json::number_unsigned_t val) { return Value(val); }
+    bool number_float(json::number_float_t val, const json::string_t&) { return Value(val); }
+    template <typename BinaryType>
+    bool binary(BinaryType&) { return true; }
+
+    bool string(json::string_t& val)
+    {
+        if (!Capturing() && m_key == "AudioFileName" && IsAudioFileResult(m_frames.size()))
+        {
+            m_audioFileName = val;
+            return true;
+        }
+        return Value(val);
+    }
+
+    bool key(json::string_t& val)
+    {
+        m_key = val;
+        return true;
+    }
+
+    bool start_object(std::size_t)
+    {
+        if (Capturing())
+        {
+            m_values.push_back(Add(json::object()));
+        }
+        else if (!m_frames.empty() && m_frames.back().IsArray && m_frames.back().Key == "SegmentResults")
+        {
+            // A segment starts, everything below it is kept until it ends.
+            m_segment = json::object();
+            m_values.push_back(&m_segment);
+        }
+        m_frames.push_back({ false, m_key });
+        return true;
+    }
+
+    bool end_object()
+    {
+        m_frames.pop_back();
+        if (Capturing())
+        {
+            m_values.pop_back();
+            if (!Capturing())
+            {
+                auto segment = m_segment.get<SegmentResult>();
+                m_onSegment(m_audioFileName, segment);
+                m_segmentCount++;
+                m_segment = nullptr;
+            }
+        }
+        else if (IsAudioFileResult(m_frames.size() + 1))
+        {
+            m_onAudioFileEnd(m_audioFileName, m_segmentCount);
+            m_audioFileName.clear();
+            m_segmentCount = 0;
+        }
+        return true;
+    }
+
+    bool start_array(std::size_t)
+    {
+        if (Capturing())
+        {
+            m_values.push_back(Add(json::array()));
+        }
+        m_frames.push_back({ true, m_key });
+        return true;
+    }
+
+    bool end_array()
+    {
+        m_frames.pop_back();
+        if (Capturing())
+        {
+            m_values.pop_back();
+        }
+        return true;
+    }
+
+    template <typename Exception>
+    bool parse_error(std::size_t, const std::string&, const Exception& ex)
+    {
+        throw ex;
+    }
+
+private:
+    struct Frame
+    {
+        bool IsArray;
+        json::string_t Key;    // key of the container in its parent object.
+    };
+
+    bool Capturing() const
+    {
+        return !m_values.empty();
+    }
+
+    // Whether the object at 'depth' is an element of the top-level AudioFileResults array.
+    bool IsAudioFileResult(size_t depth) const
+    {
+        return depth == 3 && m_frames[1].IsArray && m_frames[1].Key == "AudioFileResults";
+    }
+
+    // Adds a value to the container being built and returns a pointer to it.
+    json* Add(json&& value)
+    {
+        auto& parent = *m_values.back();
+        if (parent.is_array())
+        {
+            parent.push_back(std::move(value));
+            return &parent.back();
+        }
+        auto& slot = parent[m_key];
+        slot = std::move(value);
+        return &slot;
+    }
+
+    template <typename ValueType>
+    bool Value(ValueType&& value)
+    {
+        if (Capturing())
+        {
+            Add(json(std::forward<ValueType>(value)));
+        }
+        return true;
+    }
+
+    SegmentCallback m_onSegment;
+    AudioFileCallback m_onAudioFileEnd;
+
+    std::vector<Frame> m_frames;
+    json::string_t m_key;
+    std::string m_audioFileName;
+    size_t m_segmentCount = 0;
+
+    json m_segment;
+    std::vector<json*> m_values;    // containers of the segment being built, innermost last.
+};
+
+// The wait a throttled or unavailable service asks for in Retry-After, 0 without one.
+std::chrono::milliseconds RetryAfter(http_response& response)
+{
+    auto header = response.headers().find(U("Retry-After"));
+    if (header != response.headers().end())
+    {
+        try
+        {
+            return std::chrono::seconds(std::stoi(header->second));
+        }
+        catch (const exception&)
+        {
+            // Retry-After can also be an http date, which is ignored.
+        }
+    }
+    return std::chrono::milliseconds(0);
+}
+
+// Shares one http_client per host. Requests to the same host then reuse the client's pooled keep-alive
+// connections, instead of setting up a new connection for each status check or result download.
+class HttpClientPool
+{
+public:
+    // Returns the client for the scheme, host and port of 'url'.
+    std::shared_ptr<http_client> Get(const uri& url)
+    {
+        auto authority = url.authority();
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto& client = m_clients[authority.to_string()];
+        if (!client)
+        {
+            client = std::make_shared<http_client>(authority);
+        }
+        return client;
+    }
+
+    // Sends a GET request for an absolute url over the shared client of its host.
+    http_response Get(const string_t& url, const string_t& key)
+    {
+        uri absolute(url);
+        http_request request(methods::GET);
+        request.set_request_uri(absolute.resource());
+        request.headers().add(U("Ocp-Apim-Subscription-Key"), key);
+        return Get(absolute)->request(request).get();
+    }
+
+private:
+    std::mutex m_mutex;
+    std::map<string_t, std::shared_ptr<http_client>> m_clients;
+};
+
+// Tracks submitted transcriptions and polls their status concurrently until each one has failed or its
+// results have been downloaded. The polling interval adapts to the status: transcriptions waiting in the
+// queue (NotStarted) are checked less and less often, running ones more often, and results are fetched
+// as soon as a transcription reports Succeeded. Transcriptions can be added while it runs, as they are submitted.
+class TranscriptionManager
+{
+public:
+    TranscriptionManager(HttpClientPool& clients, string_t key, size_t maxConcurrentRequests = 8)
+        : m_clients(clients), m_key(key), m_maxConcurrentRequests(std::max<size_t>(1, maxConcurrentRequests))
+    {
+    }
+
+    // Adds a transcription by the location returned when it was submitted. Can be called from any thread, also
+    // while Run() is polling.
+    void Track(const string_t& location)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_jobs.push_back(Job{ location });
+        m_queue.push(Due{ std::chrono::steady_clock::now(), m_jobs.size() - 1 });
+        m_pending++;
+        m_changed.notify_all();
+    }
+
+    // Tells Run() that no more transcriptions will be tracked.
+    void Complete()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_complete = true;
+        m_changed.notify_all();
+    }
+
+    // Polls until Complete() has been called and all tracked transcriptions are finished.
+    void Run()
+    {
+        std::vector<std::thread> workers;
+        for (size_t i = 0; i < m_maxConcurrentRequests; i++)
+        {
+            workers.emplace_back([this]() { Worker(); });
+        }
+        for (auto& worker : workers)
+        {
+            worker.join();
+        }
+    }
+
+private:
+    // A transcription that keeps failing to report its status is given up after this many attempts in a row.
+    static constexpr int maxConsecutiveErrors = 5;
+
+    struct Job
+    {
+        string_t Location;
+        string Status;
+        std::chrono::milliseconds Interval{ 0 };
+        int ConsecutiveErrors = 0;
+    };
+
+    struct Due
+    {
+        std::chrono::steady_clock::time_point Time;
+        size_t Job;
+
+        bool operator>(const Due& other) const
+        {
+            return Time > other.Time;
+        }
+    };
+
+    void Worker()
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        while (m_pending > 0 || !m_complete)
+        {
+            if (m_queue.empty())
+            {
+                // All remaining jobs are being polled by other workers, or are yet to be submitted.
+                m_changed.wait(lock);
+                continue;
+            }
+
+            auto due = m_queue.top();
+            if (due.Time > std::chrono::steady_clock::now())
+            {
+                m_changed.wait_until(lock, due.Time);
+                continue;
+            }
+            m_queue.pop();
+            // Jobs are never moved in the deque, the reference stays valid while others are added.
+            auto& job = m_jobs[due.Job];
+            lock.unlock();
+
+            bool finished = false;
+            try
+            {
+                finished = Poll(job);
+                job.ConsecutiveErrors = 0;
+            }
+            catch (const exception& e)
+            {
+                Print(job, string("Checking the transcription failed: ") + e.what());
+                finished = ++job.ConsecutiveErrors >= maxConsecutiveErrors;
+                job.Interval = std::max(job.Interval * 2, std::chrono::milliseconds(1000));
+            }
+
+            lock.lock();
+            if (finished)
+            {
+                m_pending--;
+            }
+            else
+            {
+                m_queue.push(Due{ std::chrono::steady_clock::now() + WithJitter(job.Interval), due.Job });
+            }
+            m_changed.notify_all();
+        }
+    }
+
+    // Checks the status of the job once. Returns true when the job is finished.
+    bool Poll(Job& job)
+    {
+        auto response = m_clients.Get(job.Location, m_key);
+        auto statusCode = response.status_code();
+
+        if (statusCode == status_codes::TooManyRequests || statusCode >= 500)
+        {
+            // Throttled or temporarily unavailable, backs off and tries again.
+            job.Interval = std::max({ job.Interval * 2, std::chrono::milliseconds(1000), RetryAfter(response) });
+            return false;
+        }
+        if (statusCode != status_codes::OK)
+        {
+            Print(job, "Fetching the transcription returned unexpected http code " + std::to_string(statusCode));
+            return true;
+        }
+
+        Transcription transcriptionStatus = nlohmann::json::parse(response.extract_utf8string().get());
+
+        if (!_stricmp(transcriptionStatus.status.c_str(), "Failed"))
+        {
+            Print(job, "Transcription has failed " + transcriptionStatus.statusMessage);
+            return true;
+        }
+        if (!_stricmp(transcriptionStatus.status.c_str(), "Succeeded"))
+        {
+            FetchResults(job, transcriptionStatus);
+            return true;
+        }
+
+        if (_stricmp(transcriptionStatus.status.c_str(), job.Status.c_str()))
+        {
+            Print(job, !_stricmp(transcriptionStatus.status.c_str(), "Running") ? "Transcription is running." : "Transcription has not started.");
+        }
+        job.Interval = std::max(NextInterval(job, transcriptionStatus.status), RetryAfter(response));
+        job.Status = transcriptionStatus.status;
+        return false;
+    }
+
+    // Running transcriptions are polled from 1 s up to every 10 s, queued ones from 2 s up to every 60 s.
+    static std::chrono::milliseconds NextInterval(const Job& job, const string& status)
+    {
+        using std::chrono::milliseconds;
+        bool running = !_stricmp(status.c_str(), "Running");
+        auto initial = running ? milliseconds(1000) : milliseconds(2000);
+        auto maximum = running ? milliseconds(10000) : milliseconds(60000);
+
+        // Starts over when the status changes, e.g. when a queued transcription starts running.
+        if (_stricmp(status.c_str(), job.Status.c_str()) || job.Interval.count() == 0)
+        {
+            return initial;
+        }
+        auto next = running ? job.Interval * 3 / 2 : job.Interval * 2;
+        return std::min(next, maximum);
+    }
+
+    // Spreads polls of jobs submitted at the same time, so they do not all hit the service at once.
+    // Must be called with m_mutex held.
+    std::chrono::milliseconds WithJitter(std::chrono::milliseconds interval)
+    {
+        std::uniform_int_distribution<long long> jitter(0, interval.count() / 10);
+        return interval + std::chrono::milliseconds(jitter(m_random));
+    }
+
+    void FetchResults(const Job& job, Transcription& transcriptionStatus)
+    {
+        Print(job, "Success!");
+        for (auto& channel : transcriptionStatus.resultsUrls)
+        {
+            Print(job, "Transcription has completed. Results are at " + channel.second);
+            Print(job, "Fetching results");
+
+            auto resultResponse = m_clients.Get(conversions::to_string_t(channel.second), m_key);
+            auto responseCode = resultResponse.status_code();
+
+            if (responseCode != status_codes::OK)
+            {
+                Print(job, "Fetching the transcription returned unexpected http code " + std::to_string(responseCode));
+                continue;
+            }
+
+            // Parses the results while they are downloaded, one segment at a time.
+            ResponseBodyStreambuf resultBody(resultResponse.body());
+            std::istream resultStream(&resultBody);
+
+            SegmentResultReader reader(
+                [this, &job](const std::string& audioFileName, const SegmentResult& segResult)
+                {
+                    Print(job, "Status: " + segResult.RecognitionStatus);
+
+                    if (!_stricmp(segResult.RecognitionStatus.c_str(), "success") && segResult.NBest.size() > 0)
+                    {
+                        Print(job, "Best text result was: '" + segResult.NBest.front().Display + "'");
+                    }
+                },
+                [this, &job](const std::string& audioFileName, size_t segmentCount)
+                {
+                    Print(job, "There were " + std::to_string(segmentCount) + " results in " + audioFileName);
+                });
+            reader.Parse(resultStream);
+        }
+    }
 
-    utility::string_t service_url = U("https://") + region + U(".cris.ai/api/speechtotext/v2.0/Transcriptions/");
-    uri u(service_url);
+    // Prints a line prefixed with the transcription id. Lines of concurrent jobs do not interleave.
+    void Print(const Job& job, const string& line)
+    {
+        auto location = conversions::to_utf8string(job.Location);
+        auto id = location.substr(location.find_last_of('/') + 1);
+
+        std::lock_guard<std::mutex> lock(m_outputMutex);
+        cout << "[" << id << "] " << line << endl;
+    }
+
+    HttpClientPool& m_clients;
+    const string_t m_key;
+    const size_t m_maxConcurrentRequests;
+
+    std::deque<Job> m_jobs;
+    std::priority_queue<Due, std::vector<Due>, std::greater<Due>> m_queue;
+    size_t m_pending = 0;
+    bool m_complete = false;
+    std::mutex m_mutex;
+    std::condition_variable m_changed;
+    std::mt19937 m_random{ std::random_device{}() };
+
+    std::mutex m_outputMutex;
+};
+
+// Submits a transcription of the recording at 'recordingsUrl' and has 'manager' track it.
+// Returns false if the service did not accept it.
+bool submitTranscription(HttpClientPool& clients, TranscriptionManager& manager, const string& recordingsUrl)
+{
+    uri u(U("https://") + region + U(".cris.ai/api/speechtotext/v2.0/Transcriptions/"));
 
-    http_client c(u);
     http_request msg(methods::POST);
+    msg.set_request_uri(u.resource());
     msg.headers().add(U("Content-Type"), U("application/json"));
     msg.headers().add(U("Ocp-Apim-Subscription-Key"), subscriptionKey);
 
-    auto transportdef = TranscriptionDefinition::Create(name, description, myLocale, recordingsBlobUri);
+    auto transportdef = TranscriptionDefinition::Create(name, description, myLocale, recordingsUrl);
 
     nlohmann::json transportdefJSON = transportdef;
 
     msg.set_body(transportdefJSON.dump());
 
-    auto response = c.request(msg).get();
+    auto response = clients.Get(u)->request(msg).get();
     auto statusCode = response.status_code();
 
     if (statusCode != status_codes::Accepted)
     {
         cout << "Unexpected status code " << statusCode << endl;
-        return;
+        return false;
     }
 
     string_t transcriptionLocation = response.headers()[U("location")];
 
-    cout << "Transcription status is located at " << converter.to_bytes(transcriptionLocation) << endl;
-
-    http_client statusCheckClient(transcriptionLocation);
-    http_request statusCheckMessage(methods::GET);
-    statusCheckMessage.headers().add(U("Ocp-Apim-Subscription-Key"), subscriptionKey);
+    cout << "Transcription status is located at " << conversions::to_utf8string(transcriptionLocation) << endl;
+    manager.Track(transcriptionLocation);
+    return true;
+}
 
-    bool completed = false;
+// Uploads local recordings to a blob container and submits their transcriptions, while the transcriptions of the
+// files uploaded before are already running. Files are uploaded as blocks of 'blockSize' bytes, up to
+// 'maxConcurrentBlocks' at a time across files, and a group of 'filesPerGroup' files is submitted as soon as its last
+// file is uploaded. A v2.0 TranscriptionDefinition takes one recording, so a group is submitted as one definition per
+// file. With the TranscriptionManager polling and downloading results meanwhile, upload, transcription and result
+// download overlap, and the total time is close to that of the slowest stage rather than the sum of all three.
+class UploadPipeline
+{
+public:
+    UploadPipeline(HttpClientPool& clients, TranscriptionManager& manager, string_t containerUrl,
+        size_t filesPerGroup = 4, size_t maxConcurrentBlocks = 8, size_t blockSize = 4 * 1024 * 1024)
+        : m_clients(clients), m_manager(manager), m_containerUrl(containerUrl),
+          m_filesPerGroup(std::max<size_t>(1, filesPerGroup)), m_maxConcurrentBlocks(std::max<size_t>(1, maxConcurrentBlocks)), m_blockSize(blockSize)
+    {
+    }
 
-    while (!completed)
+    // Uploads and submits 'paths'; returns when all of them are uploaded and submitted, or failed.
+    void Run(const std::vector<string_t>& paths)
     {
-        auto statusResponse = statusCheckClient.request(statusCheckMessage).get();
-        auto statusResponseCode = statusResponse.status_code();
+        for (auto& path : paths)
+        {
+            std::ifstream file(path, std::ios::binary | std::ios::ate);
+            auto size = file ? (uint64_t)file.tellg() : 0;
+            if (size == 0)
+            {
+                cout << "Skipping " << conversions::to_utf8string(path) << ", it cannot be read or is empty." << endl;
+                continue;
+            }
 
-        if (statusResponseCode != status_codes::OK)
+            File upload;
+            upload.Path = path;
+            upload.BlobUrl = BlobUrl(path.substr(path.find_last_of(U("/\\")) + 1));
+            upload.Size = size;
+            upload.Blocks = (size_t)((size + m_blockSize - 1) / m_blockSize);
+            upload.Group = m_files.size() / m_filesPerGroup;
+            m_files.push_back(upload);
+            for (size_t i = 0; i < upload.Blocks; i++)
+            {
+                // Blocks are queued file by file, so the first group is complete as early as possible.
+                m_blocks.push_back(Block{ m_files.size() - 1, i });
+            }
+        }
+        m_groupsPending.assign((m_files.size() + m_filesPerGroup - 1) / m_filesPerGroup, 0);
+        for (auto& file : m_files)
         {
-            cout << "Fetching the transcription returned unexpected http code " << statusResponseCode << endl;
-            return;
+            m_groupsPending[file.Group]++;
         }
 
-        auto body = statusResponse.extract_string().get();
-        auto statusJSON = nlohmann::json::parse(body);
-        Transcription transcriptionStatus = statusJSON;
-
-        if (!_stricmp(transcriptionStatus.status.c_str(), "Failed"))
+        m_started = std::chrono::steady_clock::now();
+        std::vector<std::thread> workers;
+        for (size_t i = 0; i < std::min(m_maxConcurrentBlocks, m_blocks.size()); i++)
         {
-            completed = true;
-            cout << "Transcription has failed " << transcriptionStatus.statusMessage << endl;
+            workers.emplace_back([this]() { Worker(); });
         }
-        else if (!_stricmp(transcriptionStatus.status.c_str(), "Succeeded"))
+        for (auto& worker : workers)
         {
-            completed = true;
-            cout << "Success!" << endl;
-            string result = transcriptionStatus.resultsUrls["channel_0"];
-            cout << "Transcription has completed. Results are at " << result << endl;
-            cout << "Fetching results" << endl;
+            worker.join();
+        }
+        auto failed = std::count_if(m_files.begin(), m_files.end(), [](const File& file) { return file.Failed; });
+        cout << "All uploads done after " << SecondsSinceStart() << " s, " << failed << " of " << m_files.size() << " file(s) failed." << endl;
+    }
 
-            http_client result_client(converter.from_bytes(result));
-            http_request resultMessage(methods::GET);
-            resultMessage.headers().add(U("Ocp-Apim-Subscription-Key"), subscriptionKey);
+private:
+    // A block that fails this many times fails the upload of its file.
+    static constexpr int maxAttempts = 3;
 
-            auto resultResponse = result_client.request(resultMessage).get();
+    struct File
+    {
+        string_t Path;
+        string_t BlobUrl;
+        uint64_t Size = 0;
+        size_t Blocks = 0;
+        size_t BlocksDone = 0;
+        size_t Group = 0;
+        bool Failed = false;
+    };
 
-            auto responseCode = resultResponse.status_code();
+    struct Block
+    {
+        size_t File;
+        size_t Index;
+    };
 
-            if (responseCode != status_codes::OK)
-            {
-                cout << "Fetching the transcription returned unexpected http code " << responseCode << endl;
-                return;
-            }
+    // "https://account.blob.core.windows.net/container?sas" and "a.wav" give ".../container/a.wav?sas".
+    string_t BlobUrl(const string_t& fileName) const
+    {
+        auto query = m_containerUrl.find(U('?'));
+        auto container = m_containerUrl.substr(0, query);
+        auto sas = query == string_t::npos ? string_t() : m_containerUrl.substr(query);
+        return container + U("/") + uri::encode_data_string(fileName) + sas;
+    }
 
-            auto resultBody = resultResponse.extract_string().get();
+    // Block ids are base64 and must have the same length for all blocks of a blob.
+    static string_t BlockId(size_t index)
+    {
+        char id[16];
+        snprintf(id, sizeof(id), "block-%08zu", index);
+        return uri::encode_data_string(conversions::to_base64(std::vector<unsigned char>(id, id + strlen(id))));
+    }
 
-            nlohmann::json resultJSON = nlohmann::json::parse(resultBody);
-            RootObject root = resultJSON;
+    // Adds 'query' (already encoded) to the blob url, whether or not the url has a SAS query.
+    static string_t WithQuery(const string_t& blobUrl, const string_t& query)
+    {
+        uri_builder builder(blobUrl);
+        builder.append_query(query);
+        return builder.to_string();
+    }
 
-            for (AudioFileResult af : root.AudioFileResults)
+    double SecondsSinceStart() const
+    {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - m_started).count();
+    }
+
+    void Worker()
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        while (m_nextBlock < m_blocks.size())
+        {
+            auto block = m_blocks[m_nextBlock++];
+            auto& file = m_files[block.File];
+            if (file.Failed)
             {
-                cout << "There were " << af.SegmentResults.size() << " results in " << af.AudioFileName << endl;
+                continue;
+            }
+            lock.unlock();
 
-                for (SegmentResult segResult : af.SegmentResults)
-                {
-                    cout << "Status: " << segResult.RecognitionStatus << endl;
+            bool uploaded = PutBlock(file, block.Index);
 
-                    if (!_stricmp(segResult.RecognitionStatus.c_str(), "success") && segResult.NBest.size() > 0)
-                    {
-                        cout << "Best text result was: '" << segResult.NBest.front().Display << "'" << endl;
-                    }
+            lock.lock();
+            if (!uploaded)
+            {
+                if (!file.Failed)
+                {
+                    file.Failed = true;
+                    FileDone(lock, file);
                 }
+                continue;
+            }
+            if (++file.BlocksDone == file.Blocks)
+            {
+                // The worker with the last block commits the blob, which makes it visible to the service.
+                lock.unlock();
+                auto committed = PutBlockList(file);
+                lock.lock();
+                file.Failed = !committed;
+                FileDone(lock, file);
+            }
+        }
+    }
+
+    // Submits the group of 'file' when it was the last of the group. Called with 'lock' held, releases it meanwhile.
+    void FileDone(std::unique_lock<std::mutex>& lock, const File& file)
+    {
+        if (--m_groupsPending[file.Group] > 0)
+        {
+            return;
+        }
+        std::vector<size_t> recordings;
+        for (size_t i = 0; i < m_files.size(); i++)
+        {
+            if (m_files[i].Group == file.Group && !m_files[i].Failed)
+            {
+                recordings.push_back(i);
             }
         }
-        else if (!_stricmp(transcriptionStatus.status.c_str(), "Running"))
+        lock.unlock();
+        cout << "Group " << file.Group + 1 << " uploaded after " << SecondsSinceStart() << " s, submitting " << recordings.size() << " transcription(s)." << endl;
+        std::vector<size_t> rejected;
+        for (auto recording : recordings)
         {
-            cout << "Transcription is running." << endl;
+            // This runs on a worker thread, where an escaping exception would terminate the process.
+            bool submitted = false;
+            try
+            {
+                submitted = submitTranscription(m_clients, m_manager, conversions::to_utf8string(m_files[recording].BlobUrl));
+            }
+            catch (const exception& e)
+            {
+                cout << "Submitting " << conversions::to_utf8string(m_files[recording].Path) << " failed: " << e.what() << endl;
+            }
+            if (!submitted)
+            {
+                rejected.push_back(recording);
+            }
         }
-        else if (!_stricmp(transcriptionStatus.status.c_str(), "NotStarted"))
+        lock.lock();
+        for (auto recording : rejected)
         {
-            cout << "Transcription has not started." << endl;
+            m_files[recording].Failed = true;
         }
+    }
 
-        if (!completed) {
-            Sleep(5000);
+    bool PutBlock(const File& file, size_t index)
+    {
+        auto offset = (uint64_t)index * m_blockSize;
+        std::vector<unsigned char> data((size_t)std::min<uint64_t>(m_blockSize, file.Size - offset));
+        std::ifstream input(file.Path, std::ios::binary);
+        input.seekg((std::streamoff)offset);
+        if (!input.read(reinterpret_cast<char*>(data.data()), data.size()))
+        {
+            cout << "Cannot read " << conversions::to_utf8string(file.Path) << endl;
+            return false;
         }
+        return Send(methods::PUT, WithQuery(file.BlobUrl, U("comp=block&blockid=") + BlockId(index)), data, status_codes::Created);
+    }
 
+    bool PutBlockList(const File& file)
+    {
+        string list = "<?xml version=\"1.0\" encoding=\"utf-8\"?><BlockList>";
+        for (size_t i = 0; i < file.Blocks; i++)
+        {
+            list += "<Latest>" + conversions::to_utf8string(uri::decode(BlockId(i))) + "</Latest>";
+        }
+        list += "</BlockList>";
+        return Send(methods::PUT, WithQuery(file.BlobUrl, U("comp=blocklist")), std::vector<unsigned char>(list.begin(), list.end()), status_codes::Created);
     }
+
+    // Sends a request to the blob service, retrying throttled requests and server errors. The wait grows with every
+    // attempt, and is at least what the service asks for in Retry-After.
+    bool Send(const method& verb, const string_t& url, const std::vector<unsigned char>& body, status_code expected)
+    {
+        uri absolute(url);
+        for (int attempt = 1; attempt <= maxAttempts; attempt++)
+        {
+            std::chrono::milliseconds retryAfter(0);
+            http_request request(verb);
+            request.set_request_uri(absolute.resource());
+            request.headers().add(U("x-ms-version"), U("2019-12-12"));
+            request.headers().add(U("x-ms-blob-content-type"), U("audio/wav"));
+            request.set_body(std::vector<unsigned char>(body));
+            try
+            {
+                auto response = m_clients.Get(absolute)->request(request).get();
+                if (response.status_code() == expected)
+                {
+                    return true;
+                }
+                if (response.status_code() != status_codes::TooManyRequests && response.status_code() < 500)
+                {
+                    cout << "The blob service returned unexpected http code " << response.status_code() << endl;
+                    return false;
+                }
+                retryAfter = RetryAfter(response);
+            }
+            catch (const exception& e)
+            {
+                cout << "Uploading failed: " << e.what() << endl;
+            }
+            std::this_thread::sleep_for(std::max<std::chrono::milliseconds>(std::chrono::seconds(attempt), retryAfter));
+        }
+        return false;
+    }
+
+    HttpClientPool& m_clients;
+    TranscriptionManager& m_manager;
+    const string_t m_containerUrl;
+    const size_t m_filesPerGroup;
+    const size_t m_maxConcurrentBlocks;
+    const size_t m_blockSize;
+
+    std::vector<File> m_files;
+    std::vector<Block> m_blocks;
+    std::vector<size_t> m_groupsPending;
+    size_t m_nextBlock = 0;
+    std::chrono::steady_clock::time_point m_started;
+    std::mutex m_mutex;
+};
+
+void recognizeSpeech()
+{
+    HttpClientPool clients;
+    TranscriptionManager manager(clients, subscriptionKey);
+
+    for (auto& recordingsBlobUri : recordingsBlobUris)
+    {
+        submitTranscription(clients, manager, recordingsBlobUri);
+    }
+
+    manager.Complete();
+    manager.Run();
 }
 
-int wmain()
+// Uploads the wav files in 'directory' and transcribes them, polling while the uploads are still running.
+void uploadAndRecognizeSpeech(const string_t& directory)
+{
+    std::vector<string_t> paths;
+    WIN32_FIND_DATAW found;
+    auto search = FindFirstFileW((directory + U("\\*.wav")).c_str(), &found);
+    if (search != INVALID_HANDLE_VALUE)
+    {
+        do
+        {
+            paths.push_back(directory + U("\\") + found.cFileName);
+        } while (FindNextFileW(search, &found));
+        FindClose(search);
+    }
+    if (paths.empty())
+    {
+        cout << "No wav files in " << conversions::to_utf8string(directory) << endl;
+        return;
+    }
+
+    HttpClientPool clients;
+    TranscriptionManager manager(clients, subscriptionKey);
+    auto started = std::chrono::steady_clock::now();
+
+    {
+        // The manager polls on its own threads from the start, so transcriptions are checked as they are submitted.
+        // The poller is completed and joined at the end of this block, also when the upload throws.
+        struct Polling
+        {
+            TranscriptionManager& Manager;
+            std::thread Thread;
+
+            ~Polling()
+            {
+                Manager.Complete();
+                Thread.join();
+            }
+        } polling{ manager, std::thread([&manager]() { manager.Run(); }) };
+
+        UploadPipeline(clients, manager, recordingsContainerUrl).Run(paths);
+    }
+
+    cout << "Uploaded and transcribed " << paths.size() << " file(s) in "
+         << std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count() << " s." << endl;
+}
+
+int wmain(int argc, wchar_t** argv)
 {
     try
     {
-        recognizeSpeech();
+        if (argc > 1)
+        {
+            uploadAndRecognizeSpeech(argv[1]);
+        }
+        else
+        {
+            recognizeSpeech();
+        }
     }
     catch (exception e)
     {
@@ -0,0 +1,284 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+// Cold start profiling for the from-file quickstart, run as "coldstart <launches> [lazy,library,connection]".
+// The app launches itself <launches> times per preload option and each launch recognizes the file once, timing the
+// stages from process creation to the first result. The Speech SDK core library is delay-loaded (see DelayLoadDLLs in
+// coldstart.vcxproj), so loading it is a stage of its own instead of happening before main.
+// Preload options, i.e. what a worker does at startup before its first request arrives:
+//  - lazy: nothing, the first request loads the library on its first SDK call.
+//  - library: loads the library.
+//  - connection: loads the library, creates the recognizer and opens its connection.
+
+#include "stdafx.h"
+#define WIN32_LEAN_AND_MEAN
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <Windows.h>
+#include <algorithm>
+#include <chrono>
+#include <future>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <speechapi_cxx.h>
+
+using namespace std;
+using namespace Microsoft::CognitiveServices::Speech;
+using namespace Microsoft::CognitiveServices::Speech::Audio;
+
+namespace
+{
+    using Clock = chrono::steady_clock;
+
+    const char* const coldStartStages[] = { "launch", "load", "config", "recognizer", "connect", "sessionStarted", "firstHypothesis", "result", "request", "total" };
+
+    double MillisecondsSince(Clock::time_point start)
+    {
+        return chrono::duration<double, milli>(Clock::now() - start).count();
+    }
+
+    // Milliseconds from the creation of this process until now.
+    double MillisecondsSinceProcessCreation()
+    {
+        FILETIME creation, exit, kernel, user, now;
+        GetProcessTimes(GetCurrentProcess(), &creation, &exit, &kernel, &user);
+        GetSystemTimePreciseAsFileTime(&now);
+        auto ticks = [](const FILETIME& time) { return ((uint64_t)time.dwHighDateTime << 32) | time.dwLowDateTime; };
+        // FILETIME counts 100 ns units.
+        return (ticks(now) - ticks(creation)) / 10000.0;
+    }
+
+    // One launch: times every stage and prints them as "STAGES name=ms ..." for the parent.
+    int RunColdStartChild(const string& preload)
+    {
+        map<string, double> stages;
+        auto mainEntered = Clock::now();
+        stages["launch"] = MillisecondsSinceProcessCreation();
+
+        auto load = [&stages]()
+        {
+            auto started = Clock::now();
+            if (LoadLibraryW(L"Microsoft.CognitiveServices.Speech.core.dll") == nullptr)
+            {
+                throw runtime_error("Cannot load Microsoft.CognitiveServices.Speech.core.dll");
+            }
+            stages["load"] = MillisecondsSince(started);
+        };
+        shared_ptr<SpeechRecognizer> recognizer;
+        promise<void> connected;
+        // Connected fires again after a reconnect; the promise can only be set once.
+        once_flag connectedSignaled;
+        auto createRecognizer = [&stages, &recognizer]()
+        {
+            auto started = Clock::now();
+            // Replace with your own subscription key and service region (e.g., "westus").
+            auto config = SpeechConfig::FromSubscription("YourSubscriptionKey", "YourServiceRegion");
+            stages["config"] = MillisecondsSince(started);
+
+            started = Clock::now();
+            recognizer = SpeechRecognizer::FromConfig(config, AudioConfig::FromWavFileInput("whatstheweatherlike.wav"));
+            stages["recognizer"] = MillisecondsSince(started);
+        };
+
+        try
+        {
+            // Worker startup.
+            if (preload != "lazy")
+            {
+                load();
+            }
+            shared_ptr<Connection> connection;
+            if (preload == "connection")
+            {
+                createRecognizer();
+                auto started = Clock::now();
+                connection = Connection::FromRecognizer(recognizer);
+                connection->Connected.Connect([&connected, &connectedSignaled](const ConnectionEventArgs&)
+                {
+                    call_once(connectedSignaled, [&connected]() { connected.set_value(); });
+                });
+                connection->Open(false);
+                if (connected.get_future().wait_for(chrono::seconds(10)) != future_status::ready)
+                {
+                    throw runtime_error("The connection did not open.");
+                }
+                stages["connect"] = MillisecondsSince(started);
+            }
+
+            // The first request.
+            auto requested = Clock::now();
+            if (preload != "connection")
+            {
+                // Without a preloaded library, the first SDK call in here loads it; that time is part of 'config'.
+                createRecognizer();
+            }
+
+            once_flag firstHypothesis;
+            mutex stagesMutex;
+            recognizer->SessionStarted.Connect([&](const SessionEventArgs&)
+            {
+                lock_guard<mutex> lock(stagesMutex);
+                stages["sessionStarted"] = MillisecondsSince(requested);
+            });
+            recognizer->Recognizing.Connect([&](const SpeechRecognitionEventArgs&)
+            {
+                call_once(firstHypothesis, [&]()
+                {
+                    lock_guard<mutex> lock(stagesMutex);
+                    stages["firstHypothesis"] = MillisecondsSince(requested);
+                });
+            });
+
+            auto recognizeStarted = Clock::now();
+            auto result = recognizer->RecognizeOnceAsync().get();
+            lock_guard<mutex> lock(stagesMutex);
+            stages["result"] = MillisecondsSince(recognizeStarted);
+            stages["request"] = MillisecondsSince(requested);
+            stages["total"] = stages["launch"] + MillisecondsSince(mainEntered);
+            if (result->Reason == ResultReason::Canceled)
+            {
+                cout << "ERROR " << CancellationDetails::FromResult(result)->ErrorDetails << std::endl;
+                return 1;
+            }
+        }
+        catch (const exception& e)
+        {
+            cout << "ERROR " << e.what() << std::endl;
+            return 1;
+        }
+
+        cout << "STAGES";
+        for (auto& stage : stages)
+        {
+            cout << " " << stage.first << "=" << stage.second;
+        }
+        cout << std::endl;
+        return 0;
+    }
+
+    // Launches this executable 'launches' times per preload option and prints the median, 90th percentile and maximum
+    // of every stage.
+    int RunColdStartParent(int launches, const vector<string>& preloads)
+    {
+        char executable[MAX_PATH];
+        GetModuleFileNameA(nullptr, executable, MAX_PATH);
+
+        for (auto& preload : preloads)
+        {
+            map<string, vector<double>> stages;
+            int failures = 0;
+            for (int i = 0; i < launches; i++)
+            {
+                // An extra pair of quotes around the whole command keeps cmd.exe from stripping the quoted path.
+                auto command = "\"\"" + string(executable) + "\" --child " + preload + "\"";
+                auto pipe = _popen(command.c_str(), "r");
+                if (pipe == nullptr)
+                {
+                    cout << "Cannot launch " << executable << std::endl;
+                    return 1;
+                }
+                string output;
+                char buffer[512];
+                while (fgets(buffer, sizeof(buffer), pipe) != nullptr)
+                {
+                    output += buffer;
+                }
+                _pclose(pipe);
+
+                auto line = output.find("STAGES");
+                if (line == string::npos)
+                {
+                    failures++;
+                    cout << "Launch " << i + 1 << " failed: " << output;
+                    continue;
+                }
+                istringstream fields(output.substr(line + 6));
+                string field;
+                while (fields >> field)
+                {
+                    auto equals = field.find('=');
+                    if (equals != string::npos)
+                    {
+                        stages[field.substr(0, equals)].push_back(stod(field.substr(equals + 1)));
+                    }
+                }
+            }
+
+            cout << "\npreload=" << preload << ": " << launches - failures << " launches, " << failures << " failed\n";
+            cout << "  stage              p50 ms    p90 ms    max ms\n";
+            for (auto name : coldStartStages)
+            {
+                auto samples = stages[name];
+                if (samples.empty())
+                {
+                    continue;
+                }
+                sort(samples.begin(), samples.end());
+                auto percentile = [&samples](double p) { return samples[min(samples.size() - 1, (size_t)(p / 100 * samples.size()))]; };
+                char row[128];
+                snprintf(row, sizeof(row), "  %-16s %8.1f  %8.1f  %8.1f\n", name, percentile(50), percentile(90), samples.back());
+                cout << row;
+            }
+        }
+        cout << "\n'request' is what a request waits for once the worker has started, 'total' runs from process creation.\n";
+        return 0;
+    }
+}
+
+int wmain(int argc, wchar_t** argv)
+{
+    vector<string> args;
+    for (int i = 1; i < argc; i++)
+    {
+        // Options are plain ASCII.
+        string arg;
+        for (auto c = argv[i]; *c != 0; c++)
+        {
+            arg.push_back((char)*c);
+        }
+        args.push_back(arg);
+    }
+    if (args.size() == 2 && args[0] == "--child")
+    {
+        return RunColdStartChild(args[1]);
+    }
+
+    int launches = 10;
+    if (!args.empty())
+    {
+        size_t parsed = 0;
+        try
+        {
+            launches = stoi(args[0], &parsed);
+        }
+        catch (const exception&)
+        {
+            parsed = 0;
+        }
+        if (parsed != args[0].size() || launches < 1)
+        {
+            cout << "Usage: coldstart [launches] [lazy,library,connection]" << std::endl;
+            return 1;
+        }
+    }
+    vector<string> preloads;
+    istringstream list(args.size() > 1 ? args[1] : "lazy,library,connection");
+    string preload;
+    while (getline(list, preload, ','))
+    {
+        if (preload != "lazy" && preload != "library" && preload != "connection")
+        {
+            cout << "Unknown preload option '" << preload << "', use lazy, library or connection." << std::endl;
+            return 1;
+        }
+        preloads.push_back(preload);
+    }
+    return RunColdStartParent(launches, preloads);
+}
@@ -3,8 +3,18 @@
 // Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
 //
 
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
 #include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <thread>
+#include <vector>
 #include <speechapi_cxx.h>
 
 using namespace std::chrono_literals;
@@ -12,6 +22,364 @@ using namespace Microsoft::CognitiveServices::Speech;
 using namespace Microsoft::CognitiveServices::Speech::Audio;
 using namespace Microsoft::CognitiveServices::Speech::Transcription;
 
+// Sends the instant messages and room commands of a conversation without waiting for one round trip each.
+// Messages queued within 'CoalesceWindowMs' of each other go out together, one per line, as instant messages of
+// at most 'MaxMessageLength' characters. Up to 'MaxOutstanding' requests are in flight at once; they are started
+// in the order they were queued.
+class ConversationSendQueue final
+{
+public:
+    struct Settings
+    {
+        uint32_t CoalesceWindowMs = 250;
+        size_t MaxMessageLength = 1000;
+        size_t MaxOutstanding = 4;
+    };
+
+    struct Statistics
+    {
+        uint64_t Messages = 0;
+        uint64_t Commands = 0;
+        // Requests sent to the service; coalesced messages take one request together.
+        uint64_t Requests = 0;
+        uint64_t Failures = 0;
+    };
+
+    explicit ConversationSendQueue(std::shared_ptr<ConversationTranslator> translator)
+        : ConversationSendQueue(std::move(translator), Settings())
+    {
+    }
+
+    ConversationSendQueue(std::shared_ptr<ConversationTranslator> translator, const Settings& settings)
+        : m_translator(std::move(translator)), m_settings(settings), m_thread(&ConversationSendQueue::Run, this)
+    {
+    }
+
+    ConversationSendQueue(const ConversationSendQueue&) = delete;
+    ConversationSendQueue& operator=(const ConversationSendQueue&) = delete;
+
+    // Sends what is queued, then waits for the requests still in flight.
+    ~ConversationSendQueue()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stopped = true;
+        }
+        m_changed.notify_all();
+        m_thread.join();
+    }
+
+    void SendTextMessage(std::string message)
+    {
+        Enqueue({ std::move(message), nullptr });
+    }
+
+    // Queues a room command, e.g. [&conversation] { return conversation->MuteAllParticipantsAsync(); }.
+    void SendCommand(std::function<std::future<void>()> command)
+    {
+        Enqueue({ std::string(), std::move(command) });
+    }
+
+    // Sends what is queued without waiting for the end of the window, and waits until all requests completed.
+    void Flush()
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        // Nothing queued or in flight: a flag set now would cut the window of the next, unrelated send short.
+        if (m_idle)
+        {
+            return;
+        }
+        m_flushRequested = true;
+        m_changed.notify_all();
+        m_drained.wait(lock, [this] { return m_idle; });
+    }
+
+    Statistics GetStatistics()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_statistics;
+    }
+
+private:
+    struct Item
+    {
+        std::string Message;
+        std::function<std::future<void>()> Command;
+    };
+
+    void Enqueue(Item item)
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            (item.Command ? m_statistics.Commands : m_statistics.Messages)++;
+            m_items.push_back(std::move(item));
+            m_idle = false;
+        }
+        m_changed.notify_all();
+    }
+
+    void Run()
+    {
+        std::deque<std::future<void>> outstanding;
+        std::unique_lock<std::mutex> lock(m_mutex);
+        for (;;)
+        {
+            if (m_items.empty())
+            {
+                if (!outstanding.empty())
+                {
+                    lock.unlock();
+                    for (; !outstanding.empty(); outstanding.pop_front())
+                    {
+                        Complete(outstanding.front());
+                    }
+                    lock.lock();
+                    continue;
+                }
+
+                m_idle = true;
+                m_flushRequested = false;
+                m_drained.notify_all();
+                if (m_stopped)
+                {
+                    break;
+                }
+                m_changed.wait(lock, [this] { return m_stopped || !m_items.empty(); });
+                continue;
+            }
+
+            // Gives the rest of a burst the time to arrive, so it goes out in as few requests as possible.
+            m_changed.wait_for(lock, std::chrono::milliseconds(m_settings.CoalesceWindowMs), [this] { return m_stopped || m_flushRequested; });
+            std::vector<Item> items(std::make_move_iterator(m_items.begin()), std::make_move_iterator(m_items.end()));
+            m_items.clear();
+            lock.unlock();
+
+            auto requests = Coalesce(items);
+            for (auto& request : requests)
+            {
+                if (outstanding.size() >= std::max<size_t>(1, m_settings.MaxOutstanding))
+                {
+                    Complete(outstanding.front());
+                    outstanding.pop_front();
+                }
+                try
+                {
+                    outstanding.push_back(request());
+                }
+                catch (const std::exception& e)
+                {
+                    ReportFailure(e);
+                }
+            }
+            lock.lock();
+            m_statistics.Requests += requests.size();
+        }
+    }
+
+    // Joins runs of messages into as few instant messages as the length limit allows; commands end a run.
+    std::vector<std::function<std::future<void>()>> Coalesce(std::vector<Item>& items)
+    {
+        std::vector<std::function<std::future<void>()>> requests;
+        auto translator = m_translator;
+        std::string message;
+        auto endRun = [&]()
+        {
+            if (!message.empty())
+            {
+                requests.push_back([translator, message]() { return translator->SendTextMessageAsync(message); });
+                message.clear();
+            }
+        };
+
+        for (auto& item : items)
+        {
+            if (item.Command)
+            {
+                endRun();
+                requests.push_back(std::move(item.Command));
+                continue;
+            }
+            if (!message.empty() && message.size() + 1 + item.Message.size() > m_settings.MaxMessageLength)
+            {
+                endRun();
+            }
+            message += message.empty() ? item.Message : "\n" + item.Message;
+        }
+        endRun();
+        return requests;
+    }
+
+    void Complete(std::future<void>& request)
+    {
+        try
+        {
+            request.get();
+        }
+        catch (const std::exception& e)
+        {
+            ReportFailure(e);
+        }
+    }
+
+    void ReportFailure(const std::exception& e)
+    {
+        std::cout << "SEND FAILED: " << e.what() << std::endl;
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_statistics.Failures++;
+    }
+
+    const std::shared_ptr<ConversationTranslator> m_translator;
+    const Settings m_settings;
+
+    std::mutex m_mutex;
+    std::condition_variable m_changed;
+    std::condition_variable m_drained;
+    std::deque<Item> m_items;
+    bool m_idle = true;
+    bool m_flushRequested = false;
+    bool m_stopped = false;
+    Statistics m_statistics;
+    std::thread m_thread;
+};
+
+// Hands the transcriptions, translations and instant messages of a conversation to a listener in batches, at most
+// one callback every 'intervalMs', on a thread of its own. A newer partial of a participant replaces the older one
+// in the batch, and the final replaces the partial, so a chatty room costs a few callbacks per second in total.
+class ConversationEventBatcher final
+{
+public:
+    enum class EventKind { Partial, Final, TextMessage };
+
+    struct Event
+    {
+        EventKind Kind;
+        std::string ParticipantId;
+        std::string Text;
+        std::map<std::string, std::string> Translations;
+    };
+
+    using Listener = std::function<void(const std::vector<Event>&)>;
+
+    // Subscribes to the events of 'translator'. The subscriptions do nothing after the batcher is destroyed.
+    ConversationEventBatcher(ConversationTranslator& translator, Listener listener, uint32_t intervalMs = 200)
+        : m_state(std::make_shared<State>()), m_listener(std::move(listener)), m_interval(intervalMs)
+    {
+        std::weak_ptr<State> state = m_state;
+        translator.Transcribing += [state](const ConversationTranslationEventArgs& args) { Add(state, EventKind::Partial, args); };
+        translator.Transcribed += [state](const ConversationTranslationEventArgs& args) { Add(state, EventKind::Final, args); };
+        translator.TextMessageReceived += [state](const ConversationTranslationEventArgs& args) { Add(state, EventKind::TextMessage, args); };
+        m_thread = std::thread(&ConversationEventBatcher::Run, this);
+    }
+
+    ConversationEventBatcher(const ConversationEventBatcher&) = delete;
+    ConversationEventBatcher& operator=(const ConversationEventBatcher&) = delete;
+
+    // Delivers the last batch, then stops.
+    ~ConversationEventBatcher()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_state->Mutex);
+            m_state->Stopped = true;
+        }
+        m_state->Changed.notify_all();
+        m_thread.join();
+    }
+
+private:
+    struct State
+    {
+        std::mutex Mutex;
+        std::condition_variable Changed;
+        std::vector<Event> Events;
+        // Index in 'Events' of the partial of each participant whose final has not arrived yet.
+        std::map<std::string, size_t> Partials;
+        bool Stopped = false;
+    };
+
+    static void Add(const std::weak_ptr<State>& weakState, EventKind kind, const ConversationTranslationEventArgs& args)
+    {
+        auto state = weakState.lock();
+        if (!state)
+        {
+            return;
+        }
+
+        Event event{ kind, args.Result->ParticipantId, args.Result->Text, args.Result->Translations };
+        std::lock_guard<std::mutex> lock(state->Mutex);
+        auto partial = state->Partials.find(event.ParticipantId);
+        if (kind != EventKind::TextMessage && partial != state->Partials.end())
+        {
+            state->Events[partial->second] = std::move(event);
+            if (kind == EventKind::Final)
+            {
+                state->Partials.erase(partial);
+            }
+            return;
+        }
+        if (kind == EventKind::Partial)
+        {
+            state->Partials[event.ParticipantId] = state->Events.size();
+        }
+        state->Events.push_back(std::move(event));
+    }
+
+    void Run()
+    {
+        std::vector<Event> batch;
+        std::unique_lock<std::mutex> lock(m_state->Mutex);
+        for (;;)
+        {
+            auto stopped = m_state->Changed.wait_for(lock, m_interval, [this] { return m_state->Stopped; });
+            std::swap(batch, m_state->Events);
+            m_state->Partials.clear();
+            lock.unlock();
+
+            if (!batch.empty())
+            {
+                m_listener(batch);
+                batch.clear();
+            }
+            if (stopped)
+            {
+                break;
+            }
+            lock.lock();
+        }
+    }
+
+    std::shared_ptr<State> m_state;
+    Listener m_listener;
+    std::chrono::milliseconds m_interval;
+    std::thread m_thread;
+};
+
+void PrintEvents(const std::vector<ConversationEventBatcher::Event>& events)
+{
+    for (const auto& event : events)
+    {
+        switch (event.Kind)
+        {
+            case ConversationEventBatcher::EventKind::Partial:
+                std::cout << "TRANSCRIBING: ";
+                break;
+
+            case ConversationEventBatcher::EventKind::Final:
+                std::cout << "TRANSCRIBED: ";
+                break;
+
+            case ConversationEventBatcher::EventKind::TextMessage:
+                std::cout << "TEXT MESSAGE: ";
+                break;
+        }
+
+        std::cout << "From " << event.ParticipantId << ": " << event.Text << std::endl;
+        for (const auto& entry : event.Translations)
+        {
+            std::cout << "\tTRANSLATED: " << entry.first << ": " << entry.second << std::endl;
+        }
+    }
+}
+
 void StartNewConversation()
 {
     // Replace with your own subscription key and service region (e.g., "westus").
@@ -96,36 +464,19 @@ void StartNewConversation()
             std::cout << "\tPARTICIPANT: " << participant->DisplayName << std::endl;
         }
     };
-    conversationTranslator->Transcribing += [](const ConversationTranslationEventArgs& args)
-    {
-        std::cout << "TRANSCRIBING: From " << args.Result->ParticipantId << ": " << args.Result->Text << std::endl;
-        for (const auto& entry : args.Result->Translations)
-        {
-            std::cout << "\tTRANSLATED: " << entry.first << ": " << entry.second << std::endl;
-        }
-    };
-    conversationTranslator->Transcribed += [](const ConversationTranslationEventArgs& args)
-    {
-        std::cout << "TRANSCRIBED: From " << args.Result->ParticipantId << ": " << args.Result->Text << std::endl;
-        for (const auto& entry : args.Result->Translations)
-        {
-            std::cout << "\tTRANSLATED: " << entry.first << ": " << entry.second << std::endl;
-        }
-    };
-    conversationTranslator->TextMessageReceived += [](const ConversationTranslationEventArgs& args)
-    {
-        std::cout << "TEXT MESSAGE: From " << args.Result->ParticipantId << ": " << args.Result->Text << std::endl;
-        for (const auto& entry : args.Result->Translations)
-        {
-            std::cout << "\tTRANSLATED: " << entry.first << ": " << entry.second << std::endl;
-        }
-    };
+    // Transcriptions, translations and instant messages arrive in batches, a few times per second at most,
+    // instead of one callback each.
+    ConversationEventBatcher batcher(*conversationTranslator, PrintEvents);
 
     // Join the conversation so you can start receiving events
     conversationTranslator->JoinConversationAsync(conversation, "Test Host").get();
 
-    // Send an instant message
-    conversationTranslator->SendTextMessageAsync("This is a short test message").get();
+    // Send instant messages and room commands through a queue: messages sent close together go out as one,
+    // and several requests are in flight at once instead of waiting for each round trip.
+    ConversationSendQueue sendQueue(conversationTranslator);
+    sendQueue.SendTextMessage("This is a short test message");
+    sendQueue.SendTextMessage("And a second one, sent along with the first");
+    sendQueue.SendCommand([conversation] { return conversation->UnmuteAllParticipantsAsync(); });
 
     // Start sending audio
     conversationTranslator->StartTranscribingAsync().get();
@@ -138,6 +489,9 @@ void StartNewConversation()
     // Stop audio capture
     conversationTranslator->StopTranscribingAsync().get();
 
+    // Wait for the queued messages and commands to be sent before leaving
+    sendQueue.Flush();
+
     // Leave the conversation. You will stop receiving events
     conversationTranslator->LeaveConversationAsync().get();
 
@@ -155,31 +509,8 @@ void JoinExistingConversation(const std::string& conversationId)
     auto audioConfig = AudioConfig::FromDefaultMicrophoneInput();
     auto conversationTranslator = ConversationTranslator::FromConfig(audioConfig);
 
-    // Attach event handlers here. For example:
-    conversationTranslator->Transcribing += [](const ConversationTranslationEventArgs& args)
-    {
-        std::cout << "TRANSCRIBING: From " << args.Result->ParticipantId << ": " << args.Result->Text << std::endl;
-        for (const auto& entry : args.Result->Translations)
-        {
-            std::cout << "\tTRANSLATED: " << entry.first << ": " << entry.second << std::endl;
-        }
-    };
-    conversationTranslator->Transcribed += [](const ConversationTranslationEventArgs& args)
-    {
-        std::cout << "TRANSCRIBED: From " << args.Result->ParticipantId << ": " << args.Result->Text << std::endl;
-        for (const auto& entry : args.Result->Translations)
-        {
-            std::cout << "\tTRANSLATED: " << entry.first << ": " << entry.second << std::endl;
-        }
-    };
-    conversationTranslator->TextMessageReceived += [](const ConversationTranslationEventArgs& args)
-    {
-        std::cout << "TEXT MESSAGE: From " << args.Result->ParticipantId << ": " << args.Result->Text << std::endl;
-        for (const auto& entry : args.Result->Translations)
-        {
-            std::cout << "\tTRANSLATED: " << entry.first << ": " << entry.second << std::endl;
-        }
-    };
+    // Attach event handlers here. For example, batched transcriptions, translations and instant messages:
+    ConversationEventBatcher batcher(*conversationTranslator, PrintEvents);
 
     // Join the conversation
     conversationTranslator->JoinConversationAsync(conversationId, "participant", speechLanguage).get();
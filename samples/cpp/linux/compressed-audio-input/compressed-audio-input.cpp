@@ -4,128 +4,519 @@
 //
 
 #include <iostream> // cin, cout
+#include <sstream>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
 #include <speechapi_cxx.h>
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define G711_SSE2
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#define G711_NEON
+#endif
+
 using namespace Microsoft::CognitiveServices::Speech;
 using namespace Microsoft::CognitiveServices::Speech::Audio;
 
-static void* OpenCompressedFile(const std::string& compressedFileName)
+// Size of the read-ahead buffer of each stream. The SDK asks for small reads, so reading the file in large
+// blocks saves most of the system calls, and small files are read completely with the first one.
+static const size_t readAheadBufferSize = 256 * 1024;
+
+// Alignment of the read-ahead buffer, a multiple of the page size.
+static const size_t readAheadBufferAlignment = 4096;
+
+// A-law and mu-law (G.711) telephony audio is 8 kHz, 8-bit samples.
+enum class G711Law
+{
+    None,
+    ALaw,
+    MuLaw
+};
+
+static const uint32_t g711SampleRate = 8000;
+
+// Expands one G.711 sample to 16-bit PCM, as in the ITU-T reference decoder.
+static int16_t ExpandALaw(uint8_t value)
 {
-    FILE *filep = NULL;
-    filep = fopen(compressedFileName.c_str(), "rb");
-    return filep;
+    value ^= 0x55;
+    int segment = (value & 0x70) >> 4;
+    int magnitude = ((value & 0x0F) << 4) + 8;
+    if (segment > 0)
+    {
+        magnitude = (magnitude + 0x100) << (segment - 1);
+    }
+    return (int16_t)((value & 0x80) ? magnitude : -magnitude);
 }
 
-static void closeStream(void* fp)
+static int16_t ExpandMuLaw(uint8_t value)
 {
-    if (fp != NULL)
+    value = ~value;
+    int magnitude = ((((value & 0x0F) << 3) + 0x84) << ((value & 0x70) >> 4)) - 0x84;
+    return (int16_t)((value & 0x80) ? -magnitude : magnitude);
+}
+
+// Lookup tables with the 16-bit sample of each of the 256 codes.
+struct G711Tables
+{
+    int16_t alaw[256];
+    int16_t mulaw[256];
+
+    G711Tables()
     {
-        fclose((FILE*)fp);
+        for (int code = 0; code < 256; code++)
+        {
+            alaw[code] = ExpandALaw((uint8_t)code);
+            mulaw[code] = ExpandMuLaw((uint8_t)code);
+        }
     }
+};
+
+static const G711Tables g711Tables;
+
+#if defined(G711_SSE2)
+// Shifts each 16-bit lane of 'value' left by the 3-bit count in the same lane of 'shift', with constant shifts
+// selected by the bits of the count, since SSE2 has no per-lane shift.
+static __m128i ShiftLeftPerLane(__m128i value, __m128i shift)
+{
+    const __m128i zero = _mm_setzero_si128();
+    __m128i bit = _mm_cmpgt_epi16(_mm_and_si128(shift, _mm_set1_epi16(1)), zero);
+    value = _mm_or_si128(_mm_and_si128(bit, _mm_slli_epi16(value, 1)), _mm_andnot_si128(bit, value));
+    bit = _mm_cmpgt_epi16(_mm_and_si128(shift, _mm_set1_epi16(2)), zero);
+    value = _mm_or_si128(_mm_and_si128(bit, _mm_slli_epi16(value, 2)), _mm_andnot_si128(bit, value));
+    bit = _mm_cmpgt_epi16(_mm_and_si128(shift, _mm_set1_epi16(4)), zero);
+    return _mm_or_si128(_mm_and_si128(bit, _mm_slli_epi16(value, 4)), _mm_andnot_si128(bit, value));
 }
 
-static int ReadCompressedBinaryData(void *stream, uint8_t *ptr, uint32_t bufSize)
+// Expands 8 codes in the 16-bit lanes of 'codes'; the same arithmetic as ExpandALaw() and ExpandMuLaw().
+static __m128i ExpandG711(__m128i codes, G711Law law)
 {
-    FILE* compressedStreamfptr = (FILE*)stream;
-    if (compressedStreamfptr != NULL && !feof(compressedStreamfptr))
+    const __m128i zero = _mm_setzero_si128();
+    __m128i mantissa, segment, magnitude, negative;
+    if (law == G711Law::ALaw)
     {
-        return fread(ptr, 1, bufSize, compressedStreamfptr);
+        codes = _mm_xor_si128(codes, _mm_set1_epi16(0x55));
+        mantissa = _mm_and_si128(codes, _mm_set1_epi16(0x0F));
+        segment = _mm_srli_epi16(_mm_and_si128(codes, _mm_set1_epi16(0x70)), 4);
+        // Segment 0 is linear, the others add the implicit leading bit and shift by one less than the segment.
+        __m128i leadingBit = _mm_and_si128(_mm_cmpgt_epi16(segment, zero), _mm_set1_epi16(0x100));
+        magnitude = _mm_add_epi16(_mm_add_epi16(_mm_slli_epi16(mantissa, 4), _mm_set1_epi16(8)), leadingBit);
+        magnitude = ShiftLeftPerLane(magnitude, _mm_subs_epu16(segment, _mm_set1_epi16(1)));
+        negative = _mm_cmpeq_epi16(_mm_and_si128(codes, _mm_set1_epi16(0x80)), zero);
     }
     else
+    {
+        codes = _mm_xor_si128(codes, _mm_set1_epi16(0xFF));
+        mantissa = _mm_and_si128(codes, _mm_set1_epi16(0x0F));
+        segment = _mm_srli_epi16(_mm_and_si128(codes, _mm_set1_epi16(0x70)), 4);
+        magnitude = _mm_add_epi16(_mm_slli_epi16(mantissa, 3), _mm_set1_epi16(0x84));
+        magnitude = _mm_sub_epi16(ShiftLeftPerLane(magnitude, segment), _mm_set1_epi16(0x84));
+        negative = _mm_cmpgt_epi16(_mm_and_si128(codes, _mm_set1_epi16(0x80)), zero);
+    }
+    // Negates where the sign bit says so: (x ^ -1) - (-1) == -x.
+    return _mm_sub_epi16(_mm_xor_si128(magnitude, negative), negative);
+}
+#elif defined(G711_NEON)
+static int16x8_t ExpandG711(uint16x8_t codes, G711Law law)
+{
+    uint16x8_t mantissa, segment, magnitude, negative;
+    if (law == G711Law::ALaw)
+    {
+        codes = veorq_u16(codes, vdupq_n_u16(0x55));
+        mantissa = vandq_u16(codes, vdupq_n_u16(0x0F));
+        segment = vshrq_n_u16(vandq_u16(codes, vdupq_n_u16(0x70)), 4);
+        uint16x8_t leadingBit = vandq_u16(vcgtq_u16(segment, vdupq_n_u16(0)), vdupq_n_u16(0x100));
+        magnitude = vaddq_u16(vaddq_u16(vshlq_n_u16(mantissa, 4), vdupq_n_u16(8)), leadingBit);
+        magnitude = vshlq_u16(magnitude, vreinterpretq_s16_u16(vqsubq_u16(segment, vdupq_n_u16(1))));
+        negative = vceqq_u16(vandq_u16(codes, vdupq_n_u16(0x80)), vdupq_n_u16(0));
+    }
+    else
+    {
+        codes = veorq_u16(codes, vdupq_n_u16(0xFF));
+        mantissa = vandq_u16(codes, vdupq_n_u16(0x0F));
+        segment = vshrq_n_u16(vandq_u16(codes, vdupq_n_u16(0x70)), 4);
+        magnitude = vaddq_u16(vshlq_n_u16(mantissa, 3), vdupq_n_u16(0x84));
+        magnitude = vsubq_u16(vshlq_u16(magnitude, vreinterpretq_s16_u16(segment)), vdupq_n_u16(0x84));
+        negative = vtstq_u16(codes, vdupq_n_u16(0x80));
+    }
+    int16x8_t value = vreinterpretq_s16_u16(magnitude);
+    return vbslq_s16(negative, vnegq_s16(value), value);
+}
+#endif
+
+// Expands 'count' G.711 codes to 16-bit PCM in 'pcm', 16 codes per step where SIMD is available, and
+// through the lookup table otherwise and for the rest. 'pcm' need not be aligned.
+static void ExpandG711(const uint8_t* codes, size_t count, uint8_t* pcm, G711Law law)
+{
+    size_t i = 0;
+#if defined(G711_SSE2)
+    const __m128i zero = _mm_setzero_si128();
+    for (; i + 16 <= count; i += 16)
+    {
+        __m128i block = _mm_loadu_si128((const __m128i*)(codes + i));
+        _mm_storeu_si128((__m128i*)(pcm + 2 * i), ExpandG711(_mm_unpacklo_epi8(block, zero), law));
+        _mm_storeu_si128((__m128i*)(pcm + 2 * i + 16), ExpandG711(_mm_unpackhi_epi8(block, zero), law));
+    }
+#elif defined(G711_NEON)
+    for (; i + 16 <= count; i += 16)
+    {
+        uint8x16_t block = vld1q_u8(codes + i);
+        vst1q_u8(pcm + 2 * i, vreinterpretq_u8_s16(ExpandG711(vmovl_u8(vget_low_u8(block)), law)));
+        vst1q_u8(pcm + 2 * i + 16, vreinterpretq_u8_s16(ExpandG711(vmovl_u8(vget_high_u8(block)), law)));
+    }
+#endif
+    const int16_t* table = law == G711Law::ALaw ? g711Tables.alaw : g711Tables.mulaw;
+    for (; i < count; i++)
+    {
+        memcpy(pcm + 2 * i, &table[codes[i]], sizeof(int16_t));
+    }
+}
+
+// A compressed file with a read-ahead buffer, used as context of the pull stream callbacks.
+struct CompressedFileStream
+{
+    int fd;
+    uint8_t* buffer;
+    size_t begin;   // first byte in the buffer not handed to the SDK yet.
+    size_t end;     // end of valid data in the buffer.
+    bool eof;
+    G711Law law;    // G.711 files are expanded to PCM here, the others are decoded by the SDK.
+    uint8_t pendingByte;    // second byte of a PCM sample cut in two by a buffer of odd size.
+    bool hasPendingByte;
+};
+
+static void* OpenCompressedFile(const std::string& compressedFileName)
+{
+    int fd = open(compressedFileName.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+        return NULL;
+    }
+
+    // The file is read once, front to back.
+    posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+    void* buffer = NULL;
+    if (posix_memalign(&buffer, readAheadBufferAlignment, readAheadBufferSize) != 0)
+    {
+        close(fd);
+        return NULL;
+    }
+
+    return new CompressedFileStream{ fd, (uint8_t*)buffer, 0, 0, false, G711Law::None, 0, false };
+}
+
+static void closeStream(void* context)
+{
+    CompressedFileStream* stream = (CompressedFileStream*)context;
+    if (stream != NULL)
+    {
+        close(stream->fd);
+        free(stream->buffer);
+        delete stream;
+    }
+}
+
+// Refills the read-ahead buffer when all of it has been consumed. Returns the number of buffered bytes.
+static size_t FillReadAheadBuffer(CompressedFileStream* stream)
+{
+    if (stream->begin == stream->end && !stream->eof)
+    {
+        ssize_t count;
+        do
+        {
+            count = read(stream->fd, stream->buffer, readAheadBufferSize);
+        } while (count < 0 && errno == EINTR);
+
+        stream->begin = 0;
+        stream->end = count > 0 ? (size_t)count : 0;
+        // Read errors end the stream like the end of the file does.
+        stream->eof = count <= 0;
+    }
+    return stream->end - stream->begin;
+}
+
+static int ReadCompressedBinaryData(void *context, uint8_t *ptr, uint32_t bufSize)
+{
+    CompressedFileStream* stream = (CompressedFileStream*)context;
+    if (stream == NULL)
     {
         return 0;
     }
+
+    size_t available = FillReadAheadBuffer(stream);
+    size_t count = available < bufSize ? available : bufSize;
+    memcpy(ptr, stream->buffer + stream->begin, count);
+    stream->begin += count;
+    return (int)count;
 }
 
-void recognizeSpeech(const std::string& compressedFileName)
+// Reads G.711 codes and hands them to the SDK as 16-bit PCM, two bytes per code.
+// Returning 0 ends the stream, so a buffer too small for a whole sample still gets a byte: the sample is split
+// and its second byte is handed out first on the next call.
+static int ReadG711AsPcm(void *context, uint8_t *ptr, uint32_t bufSize)
 {
-    std::shared_ptr<SpeechRecognizer> recognizer;
-    std::shared_ptr<PullAudioInputStream> pullAudioStream;
+    CompressedFileStream* stream = (CompressedFileStream*)context;
+    if (stream == NULL || bufSize == 0)
+    {
+        return 0;
+    }
 
-    void *compressedFilePtr = OpenCompressedFile(compressedFileName);
+    uint32_t written = 0;
+    if (stream->hasPendingByte)
+    {
+        ptr[written++] = stream->pendingByte;
+        stream->hasPendingByte = false;
+    }
 
-    if (compressedFilePtr == NULL)
+    size_t available = FillReadAheadBuffer(stream);
+    size_t samples = (bufSize - written) / sizeof(int16_t);
+    size_t count = available < samples ? available : samples;
+    ExpandG711(stream->buffer + stream->begin, count, ptr + written, stream->law);
+    stream->begin += count;
+    written += (uint32_t)(count * sizeof(int16_t));
+
+    if (bufSize - written == 1 && FillReadAheadBuffer(stream) > 0)
     {
-        std::cout << "Error: Input file doesn't exist" << std::endl;
-        return;
+        uint8_t sample[sizeof(int16_t)];
+        ExpandG711(stream->buffer + stream->begin, 1, sample, stream->law);
+        stream->begin++;
+        ptr[written++] = sample[0];
+        stream->pendingByte = sample[1];
+        stream->hasPendingByte = true;
     }
+    return (int)written;
+}
 
-    // Creates an instance of a speech config with specified subscription key and service region.
-    // Replace with your own subscription key and service region (e.g., "westus").
-    auto config = SpeechConfig::FromSubscription("YourSubscriptionKey", "YourServiceRegion");
+// Detects the container format from the first bytes of the file.
+// A-law and mu-law files are raw samples without a header and cannot be detected.
+// A bare frame sync (11 set bits) also matches runs of 0xFF, e.g. mu-law silence, so the
+// version, layer, bitrate and sample rate fields must hold valid values as well.
+static bool IsMpegAudioFrameHeader(const uint8_t* header)
+{
+    const bool sync = header[0] == 0xFF && (header[1] & 0xE0) == 0xE0;
+    const uint8_t version = (header[1] >> 3) & 0x03;
+    const uint8_t layer = (header[1] >> 1) & 0x03;
+    const uint8_t bitrateIndex = (header[2] >> 4) & 0x0F;
+    const uint8_t sampleRateIndex = (header[2] >> 2) & 0x03;
+    return sync && version != 0x01 && layer != 0x00 && bitrateIndex != 0x00 && bitrateIndex != 0x0F && sampleRateIndex != 0x03;
+}
 
-    AudioStreamContainerFormat inputFormat;
+static bool SniffContainerFormat(CompressedFileStream* stream, AudioStreamContainerFormat& format)
+{
+    size_t available = FillReadAheadBuffer(stream);
+    const uint8_t* header = stream->buffer + stream->begin;
 
-    if (compressedFileName.find(".mp3") == (compressedFileName.size() - 4))
+    if (available >= 4 && memcmp(header, "fLaC", 4) == 0)
     {
-        inputFormat = AudioStreamContainerFormat::MP3;
+        format = AudioStreamContainerFormat::FLAC;
+        return true;
     }
-    else if (compressedFileName.find(".opus") == (compressedFileName.size() - 5))
+    // An Ogg page header is 27 bytes plus the segment table, the first packet of an Opus stream is 'OpusHead'.
+    if (available >= 4 && memcmp(header, "OggS", 4) == 0)
     {
-        inputFormat = AudioStreamContainerFormat::OGG_OPUS;
+        size_t packetStart = available >= 27 ? 27 + header[26] : available;
+        if (packetStart + 8 <= available && memcmp(header + packetStart, "OpusHead", 8) == 0)
+        {
+            format = AudioStreamContainerFormat::OGG_OPUS;
+            return true;
+        }
+        return false;
     }
-    else if (compressedFileName.find(".alaw") == (compressedFileName.size() - 5))
+    // MP3 either starts with an ID3v2 tag or directly with an MPEG audio frame header.
+    if ((available >= 3 && memcmp(header, "ID3", 3) == 0) ||
+        (available >= 4 && IsMpegAudioFrameHeader(header)))
     {
-        inputFormat = AudioStreamContainerFormat::ALAW;
+        format = AudioStreamContainerFormat::MP3;
+        return true;
     }
-    else if (compressedFileName.find(".mulaw") == (compressedFileName.size() - 6))
+    return false;
+}
+
+static bool EndsWith(const std::string& value, const std::string& suffix)
+{
+    return value.size() >= suffix.size() && value.compare(value.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+// Picks the container format from the file name, for files without a recognizable header.
+static bool GetContainerFormatFromFileName(const std::string& compressedFileName, AudioStreamContainerFormat& format)
+{
+    if (EndsWith(compressedFileName, ".mp3"))
+    {
+        format = AudioStreamContainerFormat::MP3;
+    }
+    else if (EndsWith(compressedFileName, ".opus"))
     {
-        inputFormat = AudioStreamContainerFormat::MULAW;
+        format = AudioStreamContainerFormat::OGG_OPUS;
     }
-    else if (compressedFileName.find(".flac") == (compressedFileName.size() - 5))
+    else if (EndsWith(compressedFileName, ".alaw"))
     {
-        inputFormat = AudioStreamContainerFormat::FLAC;
+        format = AudioStreamContainerFormat::ALAW;
+    }
+    else if (EndsWith(compressedFileName, ".mulaw"))
+    {
+        format = AudioStreamContainerFormat::MULAW;
+    }
+    else if (EndsWith(compressedFileName, ".flac"))
+    {
+        format = AudioStreamContainerFormat::FLAC;
     }
     else
     {
-        std::cout << "Only Opus and MP3 input files are currently supported" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// Recognizes the first utterance in the file and writes the outcome to 'out'.
+void recognizeSpeech(const std::shared_ptr<SpeechConfig>& config, const std::string& compressedFileName, std::ostream& out)
+{
+    std::shared_ptr<SpeechRecognizer> recognizer;
+    std::shared_ptr<PullAudioInputStream> pullAudioStream;
+
+    void *compressedFilePtr = OpenCompressedFile(compressedFileName);
+
+    if (compressedFilePtr == NULL)
+    {
+        out << "Error: Input file doesn't exist" << std::endl;
         return;
     }
 
-    pullAudioStream = AudioInputStream::CreatePullStream(
-        AudioStreamFormat::GetCompressedFormat(inputFormat),
-        compressedFilePtr,
-        ReadCompressedBinaryData,
-        closeStream
-    );
-    recognizer = SpeechRecognizer::FromConfig(config, AudioConfig::FromStreamInput(pullAudioStream));
+    AudioStreamContainerFormat inputFormat;
 
-    std::cout << "Recognizing ..." << std::endl;
+    // Raw G.711 has no header to sniff, so its file extension takes precedence over the content.
+    const bool isG711File = EndsWith(compressedFileName, ".alaw") || EndsWith(compressedFileName, ".mulaw");
+    if (!(isG711File && GetContainerFormatFromFileName(compressedFileName, inputFormat)) &&
+        !SniffContainerFormat((CompressedFileStream*)compressedFilePtr, inputFormat) &&
+        !GetContainerFormatFromFileName(compressedFileName, inputFormat))
+    {
+        out << "Only MP3, Opus, FLAC, A-law and mu-law input files are currently supported" << std::endl;
+        closeStream(compressedFilePtr);
+        return;
+    }
+
+    // The stream takes ownership of the file and closes it through closeStream.
+    if (inputFormat == AudioStreamContainerFormat::ALAW || inputFormat == AudioStreamContainerFormat::MULAW)
+    {
+        // G.711 is expanded to PCM here, which is cheaper than a GStreamer pipeline and does not need GStreamer at all.
+        ((CompressedFileStream*)compressedFilePtr)->law = inputFormat == AudioStreamContainerFormat::ALAW ? G711Law::ALaw : G711Law::MuLaw;
+        pullAudioStream = AudioInputStream::CreatePullStream(
+            AudioStreamFormat::GetWaveFormatPCM(g711SampleRate, 16, 1),
+            compressedFilePtr,
+            ReadG711AsPcm,
+            closeStream
+        );
+    }
+    else
+    {
+        pullAudioStream = AudioInputStream::CreatePullStream(
+            AudioStreamFormat::GetCompressedFormat(inputFormat),
+            compressedFilePtr,
+            ReadCompressedBinaryData,
+            closeStream
+        );
+    }
+    recognizer = SpeechRecognizer::FromConfig(config, AudioConfig::FromStreamInput(pullAudioStream));
 
     // Starts speech recognition, and returns after a single utterance is recognized. The end of a
     // single utterance is determined by listening for silence at the end or until a maximum of 15
-    // seconds of audio is processed.  The task returns the recognition text as result. 
+    // seconds of audio is processed.  The task returns the recognition text as result.
     // Note: Since RecognizeOnceAsync() returns only a single utterance, it is suitable only for single
-    // shot recognition like command or query. 
+    // shot recognition like command or query.
     // For long-running multi-utterance recognition, use StartContinuousRecognitionAsync() instead.
     auto result = recognizer->RecognizeOnceAsync().get();
 
     // Checks result.
     if (result->Reason == ResultReason::RecognizedSpeech) {
-        std::cout << "We recognized: " << result->Text << std::endl;
+        out << "We recognized: " << result->Text << std::endl;
     }
     else if (result->Reason == ResultReason::NoMatch) {
-        std::cout << "NOMATCH: Speech could not be recognized." << std::endl;
+        out << "NOMATCH: Speech could not be recognized." << std::endl;
     }
     else if (result->Reason == ResultReason::Canceled) {
         auto cancellation = CancellationDetails::FromResult(result);
-        std::cout << "CANCELED: Reason=" << (int)cancellation->Reason << std::endl;
+        out << "CANCELED: Reason=" << (int)cancellation->Reason << std::endl;
 
         if (cancellation->Reason == CancellationReason::Error) {
-            std::cout << "CANCELED: ErrorCode= " << (int)cancellation->ErrorCode << std::endl;
-            std::cout << "CANCELED: ErrorDetails=" << cancellation->ErrorDetails << std::endl;
-            std::cout << "CANCELED: Did you update the subscription info?" << std::endl;
+            out << "CANCELED: ErrorCode= " << (int)cancellation->ErrorCode << std::endl;
+            out << "CANCELED: ErrorDetails=" << cancellation->ErrorDetails << std::endl;
+            out << "CANCELED: Did you update the subscription info?" << std::endl;
+        }
+    }
+}
+
+// Recognizes all files with up to 'concurrency' recognizers running at once.
+void recognizeFiles(const std::vector<std::string>& compressedFileNames, unsigned concurrency)
+{
+    // Creates an instance of a speech config with specified subscription key and service region.
+    // Replace with your own subscription key and service region (e.g., "westus").
+    // The config is shared by all recognizers.
+    auto config = SpeechConfig::FromSubscription("YourSubscriptionKey", "YourServiceRegion");
+
+    std::atomic<size_t> nextFile(0);
+    std::mutex outputMutex;
+
+    auto worker = [&]()
+    {
+        for (size_t index = nextFile++; index < compressedFileNames.size(); index = nextFile++)
+        {
+            // Collects the output of a file, so that output of concurrent recognitions does not interleave.
+            std::ostringstream out;
+            recognizeSpeech(config, compressedFileNames[index], out);
+
+            std::lock_guard<std::mutex> lock(outputMutex);
+            std::cout << compressedFileNames[index] << ":" << std::endl << out.str();
         }
+    };
+
+    if (concurrency > compressedFileNames.size())
+    {
+        concurrency = (unsigned)compressedFileNames.size();
+    }
+
+    std::cout << "Recognizing ..." << std::endl;
+
+    std::vector<std::thread> workers;
+    for (unsigned i = 0; i < concurrency; i++)
+    {
+        workers.emplace_back(worker);
+    }
+    for (auto& t : workers)
+    {
+        t.join();
     }
 }
 
 int main(int argc, char **argv) {
-    if (argc != 2)
+    unsigned concurrency = 1;
+    std::vector<std::string> compressedFileNames;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "-j") == 0 && i + 1 < argc)
+        {
+            concurrency = (unsigned)atoi(argv[++i]);
+        }
+        else
+        {
+            compressedFileNames.push_back(argv[i]);
+        }
+    }
+
+    if (compressedFileNames.empty() || concurrency == 0)
     {
-        std::cout << "Usage: ./compressed-audio-input <filename>" << std::endl;
+        std::cout << "Usage: ./compressed-audio-input [-j <concurrent recognitions>] <filename> [<filename> ...]" << std::endl;
         return 0;
     }
     setlocale(LC_ALL, "");
-    recognizeSpeech(argv[1]);
+    recognizeFiles(compressedFileNames, concurrency);
     return 0;
 }
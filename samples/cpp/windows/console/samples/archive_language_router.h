@@ -0,0 +1,343 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#pragma once
+
+#include <speechapi_cxx.h>
+#include <algorithm>
+#include <atomic>
+#include <istream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "shared_audio_buffer.h"
+
+// Finds the languages spoken in the files of an archive, to route every file to the transcription queue of its
+// language. Instead of listening to each file from start to end, the router takes 'WindowsPerFile' windows of
+// 'WindowMs' spread evenly across the file and identifies the language of each window in a short single-shot
+// session of its own. The windows of all files are classified by up to 'MaxConcurrent' sessions at once and are
+// streamed as fast as the service takes them, so the time taken depends on the number of windows and the
+// concurrency, not on the duration of the audio. Verdicts are cached by file name and size, and the cache can be
+// saved and loaded between runs, so files already routed are not sampled again.
+class ArchiveLanguageRouter final
+{
+public:
+    struct Settings
+    {
+        uint32_t WindowMs = 5000;
+        uint32_t WindowsPerFile = 4;
+        size_t MaxConcurrent = 8;
+        // Share of the identified windows a language needs to count as spoken in the file.
+        double MinShare = 0.3;
+    };
+
+    // Queue names for files that are not routed to the queue of one language.
+    static constexpr const char* mixedQueue = "mixed";
+    static constexpr const char* unknownQueue = "unknown";
+
+    struct Verdict
+    {
+        std::string File;
+        uint64_t Size = 0;
+        // Windows per detected language; windows without a detected language are not counted.
+        std::map<std::string, uint32_t> Windows;
+        // The languages with at least 'MinShare' of the identified windows, most windows first.
+        std::vector<std::string> Languages;
+        bool Cached = false;
+        std::string Error;
+
+        // The language of the file, or mixedQueue / unknownQueue.
+        std::string Queue() const
+        {
+            if (Languages.size() == 1)
+            {
+                return Languages[0];
+            }
+            if (Languages.empty())
+            {
+                return unknownQueue;
+            }
+            return mixedQueue;
+        }
+    };
+
+    ArchiveLanguageRouter(std::shared_ptr<Microsoft::CognitiveServices::Speech::SpeechConfig> config,
+        std::shared_ptr<Microsoft::CognitiveServices::Speech::AutoDetectSourceLanguageConfig> autoDetectConfig)
+        : ArchiveLanguageRouter(std::move(config), std::move(autoDetectConfig), Settings())
+    {
+    }
+
+    ArchiveLanguageRouter(std::shared_ptr<Microsoft::CognitiveServices::Speech::SpeechConfig> config,
+        std::shared_ptr<Microsoft::CognitiveServices::Speech::AutoDetectSourceLanguageConfig> autoDetectConfig, const Settings& settings)
+        : m_config(std::move(config)), m_autoDetectConfig(std::move(autoDetectConfig)), m_settings(settings)
+    {
+    }
+
+    // Returns the verdicts of 'files', in the same order. A file that cannot be read gets a verdict with an error.
+    std::vector<Verdict> Classify(const std::vector<std::string>& files)
+    {
+        struct Window
+        {
+            size_t File;
+            size_t Offset;
+            size_t Size;
+        };
+
+        std::vector<Verdict> verdicts(files.size());
+        std::vector<std::shared_ptr<const SharedAudioBuffer>> buffers(files.size());
+        std::vector<Window> windows;
+        for (size_t i = 0; i < files.size(); i++)
+        {
+            auto& verdict = verdicts[i];
+            verdict.File = files[i];
+            try
+            {
+                buffers[i] = SharedAudioBuffer::FromWavFile(files[i]);
+            }
+            catch (const std::exception& e)
+            {
+                verdict.Error = e.what();
+                continue;
+            }
+
+            verdict.Size = buffers[i]->Size();
+            if (LookupCached(verdict))
+            {
+                buffers[i].reset();
+                continue;
+            }
+            for (const auto& window : SampleWindows(*buffers[i]))
+            {
+                windows.push_back({ i, window.first, window.second });
+            }
+        }
+
+        // The windows of all files share one pool of sessions; the mutex guards the verdicts.
+        std::mutex mutex;
+        std::atomic<size_t> next(0);
+        auto worker = [&]()
+        {
+            for (auto index = next++; index < windows.size(); index = next++)
+            {
+                const auto& window = windows[index];
+                std::string language;
+                std::string error;
+                try
+                {
+                    language = Identify(buffers[window.File]->CreatePullStream(window.Offset, window.Size));
+                }
+                catch (const std::exception& e)
+                {
+                    error = e.what();
+                }
+
+                std::lock_guard<std::mutex> lock(mutex);
+                auto& verdict = verdicts[window.File];
+                if (!error.empty())
+                {
+                    verdict.Error = error;
+                }
+                else if (!language.empty())
+                {
+                    verdict.Windows[language]++;
+                }
+            }
+        };
+
+        std::vector<std::thread> threads;
+        auto threadCount = std::min(std::max<size_t>(1, m_settings.MaxConcurrent), windows.size());
+        for (size_t i = 0; i < threadCount; i++)
+        {
+            threads.emplace_back(worker);
+        }
+        for (auto& thread : threads)
+        {
+            thread.join();
+        }
+
+        for (size_t i = 0; i < verdicts.size(); i++)
+        {
+            if (buffers[i] != nullptr)
+            {
+                Decide(verdicts[i]);
+            }
+        }
+        return verdicts;
+    }
+
+    // Groups the files by the queue they go to.
+    static std::map<std::string, std::vector<std::string>> GroupByQueue(const std::vector<Verdict>& verdicts)
+    {
+        std::map<std::string, std::vector<std::string>> queues;
+        for (const auto& verdict : verdicts)
+        {
+            if (verdict.Error.empty())
+            {
+                queues[verdict.Queue()].push_back(verdict.File);
+            }
+        }
+        return queues;
+    }
+
+    // Writes the cached verdicts, one file per line: name, size and the windows per language ("en-US:3,zh-CN:1").
+    void SaveCache(std::ostream& out)
+    {
+        std::lock_guard<std::mutex> lock(m_cacheMutex);
+        for (const auto& entry : m_cache)
+        {
+            out << entry.second.File << '\t' << entry.second.Size << '\t';
+            auto first = true;
+            for (const auto& language : entry.second.Windows)
+            {
+                out << (first ? "" : ",") << language.first << ':' << language.second;
+                first = false;
+            }
+            out << '\n';
+        }
+    }
+
+    // Adds the verdicts written by SaveCache(). Lines that cannot be parsed are skipped.
+    void LoadCache(std::istream& in)
+    {
+        std::string line;
+        while (std::getline(in, line))
+        {
+            std::istringstream fields(line);
+            Verdict verdict;
+            std::string size, languages;
+            if (!std::getline(fields, verdict.File, '\t') || !std::getline(fields, size, '\t'))
+            {
+                continue;
+            }
+            std::getline(fields, languages);
+            try
+            {
+                verdict.Size = std::stoull(size);
+                std::istringstream entries(languages);
+                std::string entry;
+                while (std::getline(entries, entry, ','))
+                {
+                    auto colon = entry.rfind(':');
+                    if (colon != std::string::npos)
+                    {
+                        verdict.Windows[entry.substr(0, colon)] = (uint32_t)std::stoul(entry.substr(colon + 1));
+                    }
+                }
+            }
+            catch (const std::exception&)
+            {
+                continue;
+            }
+            Decide(verdict);
+        }
+    }
+
+private:
+    // Returns the windows to identify, as (offset, size) in bytes, in whole frames.
+    std::vector<std::pair<size_t, size_t>> SampleWindows(const SharedAudioBuffer& buffer) const
+    {
+        const auto& format = buffer.GetFormat();
+        size_t blockAlign = format.BlockAlign != 0 ? format.BlockAlign : 1;
+        auto windowSize = (size_t)((uint64_t)format.AvgBytesPerSec * m_settings.WindowMs / 1000);
+        windowSize = std::max(blockAlign, windowSize - windowSize % blockAlign);
+
+        // A file shorter than all windows together gets fewer windows rather than overlapping ones.
+        auto count = std::max<size_t>(1, std::min<size_t>(m_settings.WindowsPerFile, buffer.Size() / windowSize));
+        std::vector<std::pair<size_t, size_t>> windows;
+        for (size_t i = 0; i < count; i++)
+        {
+            // The windows are centered in equal parts of the file.
+            auto center = buffer.Size() / count * i + buffer.Size() / count / 2;
+            auto offset = center > windowSize / 2 ? center - windowSize / 2 : 0;
+            offset -= offset % blockAlign;
+            windows.emplace_back(offset, windowSize);
+        }
+        return windows;
+    }
+
+    // Identifies the language of one window, empty when none was detected.
+    std::string Identify(const std::shared_ptr<Microsoft::CognitiveServices::Speech::Audio::PullAudioInputStream>& stream)
+    {
+        using namespace Microsoft::CognitiveServices::Speech;
+        using namespace Microsoft::CognitiveServices::Speech::Audio;
+
+        auto recognizer = SourceLanguageRecognizer::FromConfig(m_config, m_autoDetectConfig, AudioConfig::FromStreamInput(stream));
+        auto result = recognizer->RecognizeOnceAsync().get();
+        if (result->Reason == ResultReason::Canceled)
+        {
+            auto cancellation = CancellationDetails::FromResult(result);
+            if (cancellation->Reason == CancellationReason::Error)
+            {
+                throw std::runtime_error(cancellation->ErrorDetails);
+            }
+            return std::string();
+        }
+        return AutoDetectSourceLanguageResult::FromResult(result)->Language;
+    }
+
+    // Computes the languages of the verdict and caches it, unless a window failed.
+    void Decide(Verdict& verdict)
+    {
+        uint32_t identified = 0;
+        for (const auto& language : verdict.Windows)
+        {
+            identified += language.second;
+        }
+
+        std::vector<std::pair<uint32_t, std::string>> ranked;
+        for (const auto& language : verdict.Windows)
+        {
+            if (language.second >= m_settings.MinShare * identified)
+            {
+                ranked.emplace_back(language.second, language.first);
+            }
+        }
+        std::sort(ranked.begin(), ranked.end(), [](const std::pair<uint32_t, std::string>& a, const std::pair<uint32_t, std::string>& b)
+        {
+            return a.first > b.first;
+        });
+        verdict.Languages.clear();
+        for (const auto& language : ranked)
+        {
+            verdict.Languages.push_back(language.second);
+        }
+
+        if (verdict.Error.empty())
+        {
+            std::lock_guard<std::mutex> lock(m_cacheMutex);
+            m_cache[CacheKey(verdict)] = verdict;
+        }
+    }
+
+    bool LookupCached(Verdict& verdict)
+    {
+        std::lock_guard<std::mutex> lock(m_cacheMutex);
+        auto entry = m_cache.find(CacheKey(verdict));
+        if (entry == m_cache.end())
+        {
+            return false;
+        }
+        verdict = entry->second;
+        verdict.Cached = true;
+        return true;
+    }
+
+    // A file replaced by one of another size is sampled again.
+    static std::string CacheKey(const Verdict& verdict)
+    {
+        return verdict.File + '\t' + std::to_string(verdict.Size);
+    }
+
+    const std::shared_ptr<Microsoft::CognitiveServices::Speech::SpeechConfig> m_config;
+    const std::shared_ptr<Microsoft::CognitiveServices::Speech::AutoDetectSourceLanguageConfig> m_autoDetectConfig;
+    const Settings m_settings;
+
+    std::mutex m_cacheMutex;
+    std::map<std::string, Verdict> m_cache;
+};
@@ -0,0 +1,240 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <fstream>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Writes trace lines to a log file on a background thread, for file logging that stays on in production.
+// Write() only appends the line to an in-memory batch, so the SDK threads producing traces (e.g. through an
+// EventLogger callback) never wait for the disk. The batch is written with one write call when it is large
+// enough or when the flush interval has passed. When the file grows beyond 'MaxFileBytes', it is renamed to
+// <file>.1 (the older files moving on to <file>.2 and so on, up to 'MaxFiles') and a new file is started.
+// If writing or rotating fails, the writer stops writing, drops the lines from then on and reports it in GetError().
+class AsyncTraceFileWriter final
+{
+public:
+    struct Settings
+    {
+        // Longest time a line waits in memory before it is written.
+        uint32_t FlushIntervalMs = 500;
+        // Batches reaching this size are written without waiting for the flush interval.
+        size_t MaxBatchBytes = 64 * 1024;
+        // Lines arriving while this much is waiting to be written are dropped rather than held indefinitely.
+        size_t MaxQueuedBytes = 4 * 1024 * 1024;
+        // Size at which the file is rotated, 0 to never rotate.
+        uint64_t MaxFileBytes = 16 * 1024 * 1024;
+        // Number of rotated files kept besides the current one.
+        uint32_t MaxFiles = 4;
+    };
+
+    struct Statistics
+    {
+        uint64_t LinesWritten = 0;
+        uint64_t LinesDropped = 0;
+        uint64_t Batches = 0;
+        uint32_t Rotations = 0;
+    };
+
+    // Throws std::runtime_error if the file cannot be created.
+    explicit AsyncTraceFileWriter(const std::string& fileName)
+        : AsyncTraceFileWriter(fileName, Settings())
+    {
+    }
+
+    AsyncTraceFileWriter(const std::string& fileName, const Settings& settings)
+        : m_fileName(fileName), m_settings(settings)
+    {
+        if (!Open())
+        {
+            throw std::runtime_error("Cannot create the log file " + m_fileName);
+        }
+        m_thread = std::thread(&AsyncTraceFileWriter::Run, this);
+    }
+
+    AsyncTraceFileWriter(const AsyncTraceFileWriter&) = delete;
+    AsyncTraceFileWriter& operator=(const AsyncTraceFileWriter&) = delete;
+
+    ~AsyncTraceFileWriter()
+    {
+        Close();
+    }
+
+    // Writes the lines still in memory, closes the file and returns once that is done. Lines written after
+    // Close() are dropped.
+    void Close()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stopped = true;
+        }
+        m_wakeUp.notify_one();
+        if (m_thread.joinable())
+        {
+            m_thread.join();
+        }
+    }
+
+    void Write(const std::string& line)
+    {
+        bool full;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (m_stopped || !m_error.empty() || m_queued.size() + line.size() > m_settings.MaxQueuedBytes)
+            {
+                m_statistics.LinesDropped++;
+                return;
+            }
+            m_queued.insert(m_queued.end(), line.begin(), line.end());
+            m_queuedLines++;
+            full = m_queued.size() >= m_settings.MaxBatchBytes;
+        }
+        // The writer is only woken for full batches, otherwise the flush interval takes care of the line.
+        if (full)
+        {
+            m_wakeUp.notify_one();
+        }
+    }
+
+    // Makes the writer write what is in memory now, instead of at the end of the flush interval.
+    void Flush()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_flushRequested = true;
+        }
+        m_wakeUp.notify_one();
+    }
+
+    Statistics GetStatistics()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_statistics;
+    }
+
+    // The error that stopped the writer, or an empty string.
+    std::string GetError()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_error;
+    }
+
+private:
+    bool Open()
+    {
+        m_file.open(m_fileName, std::ios::binary | std::ios::trunc);
+        m_fileBytes = 0;
+        return m_file.is_open() && m_file.good();
+    }
+
+    // Runs on the writer thread, where an exception would end the process; returns false instead.
+    bool Rotate()
+    {
+        m_file.close();
+        auto rotatedName = [this](uint32_t index) { return m_fileName + "." + std::to_string(index); };
+        if (m_settings.MaxFiles == 0)
+        {
+            std::remove(m_fileName.c_str());
+        }
+        else
+        {
+            std::remove(rotatedName(m_settings.MaxFiles).c_str());
+            for (auto index = m_settings.MaxFiles; index > 1; index--)
+            {
+                std::rename(rotatedName(index - 1).c_str(), rotatedName(index).c_str());
+            }
+            std::rename(m_fileName.c_str(), rotatedName(1).c_str());
+        }
+        return Open();
+    }
+
+    void Run()
+    {
+        std::vector<char> batch;
+        std::unique_lock<std::mutex> lock(m_mutex);
+        for (;;)
+        {
+            m_wakeUp.wait_for(lock, std::chrono::milliseconds(m_settings.FlushIntervalMs), [this]
+            {
+                return m_stopped || m_flushRequested || m_queued.size() >= m_settings.MaxBatchBytes;
+            });
+
+            auto stopped = m_stopped;
+            m_flushRequested = false;
+            if (!m_queued.empty())
+            {
+                // The batches are swapped, so writers go on appending to the other buffer while this one is written.
+                batch.swap(m_queued);
+                auto lines = m_queuedLines;
+                m_queuedLines = 0;
+
+                lock.unlock();
+                std::string error;
+                bool rotated = false;
+                m_file.write(batch.data(), batch.size());
+                m_file.flush();
+                if (!m_file)
+                {
+                    error = "Cannot write to the log file " + m_fileName;
+                }
+                else
+                {
+                    m_fileBytes += batch.size();
+                    if (m_settings.MaxFileBytes != 0 && m_fileBytes >= m_settings.MaxFileBytes)
+                    {
+                        rotated = Rotate();
+                        if (!rotated)
+                        {
+                            error = "Cannot create the log file " + m_fileName + " after rotating it";
+                        }
+                    }
+                }
+                batch.clear();
+                lock.lock();
+
+                if (error.empty())
+                {
+                    m_statistics.LinesWritten += lines;
+                    m_statistics.Batches++;
+                }
+                else
+                {
+                    // The lines of the failed batch may be partly in the file; they are counted as dropped.
+                    m_statistics.LinesDropped += lines + m_queuedLines;
+                    m_queued.clear();
+                    m_queuedLines = 0;
+                    m_error = error;
+                }
+                m_statistics.Rotations += rotated ? 1 : 0;
+            }
+            if ((stopped && m_queued.empty()) || !m_error.empty())
+            {
+                break;
+            }
+        }
+    }
+
+    const std::string m_fileName;
+    const Settings m_settings;
+    std::ofstream m_file;
+    uint64_t m_fileBytes = 0;
+
+    std::mutex m_mutex;
+    std::condition_variable m_wakeUp;
+    std::vector<char> m_queued;
+    uint64_t m_queuedLines = 0;
+    bool m_flushRequested = false;
+    bool m_stopped = false;
+    std::string m_error;
+    Statistics m_statistics;
+    std::thread m_thread;
+};
@@ -0,0 +1,121 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#pragma once
+
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+#include "wav_file_reader.h"
+
+// Pool of fixed-size audio buffers, sized from the WAV format so that every chunk holds a whole number of frames.
+// Buffers are handed out as Chunk handles and go back to the pool when the handle is destroyed, on any thread.
+// The pool must outlive the chunks it hands out.
+class AudioChunkPool final
+{
+public:
+    // Default amount of audio per chunk. 100 ms keeps the number of Write() calls low (10 per second)
+    // while still feeding the service in small enough steps for timely partial results.
+    static constexpr uint32_t defaultChunkDurationMs = 100;
+
+    // Returns the size of a chunk holding 'durationMs' of audio, rounded down to a multiple of BlockAlign.
+    // At least one frame is returned, so very short durations or odd formats still make progress.
+    static uint32_t ChunkSizeFor(const WavFileReader::WAVEFORMAT& format, uint32_t durationMs = defaultChunkDurationMs)
+    {
+        uint32_t blockAlign = format.BlockAlign != 0 ? format.BlockAlign : 1;
+        uint64_t bytes = (uint64_t)format.AvgBytesPerSec * durationMs / 1000;
+        bytes -= bytes % blockAlign;
+        return bytes < blockAlign ? blockAlign : (uint32_t)bytes;
+    }
+
+    class Releaser
+    {
+    public:
+        Releaser(AudioChunkPool* pool = nullptr) : m_pool(pool) {}
+
+        void operator()(std::vector<uint8_t>* buffer) const
+        {
+            if (m_pool != nullptr)
+            {
+                m_pool->Release(buffer);
+            }
+            else
+            {
+                delete buffer;
+            }
+        }
+
+    private:
+        AudioChunkPool* m_pool;
+    };
+
+    using Chunk = std::unique_ptr<std::vector<uint8_t>, Releaser>;
+
+    // Creates a pool of chunks of 'chunkSize' bytes, keeping at most 'maxPooledChunks' idle chunks around.
+    AudioChunkPool(uint32_t chunkSize, size_t maxPooledChunks = 4)
+        : m_chunkSize(chunkSize), m_maxPooledChunks(maxPooledChunks)
+    {
+        if (chunkSize == 0)
+        {
+            throw std::invalid_argument("Chunk size must be larger than zero.");
+        }
+    }
+
+    // Creates a pool of chunks holding 'durationMs' of audio in the given format.
+    AudioChunkPool(const WavFileReader::WAVEFORMAT& format, uint32_t durationMs = defaultChunkDurationMs, size_t maxPooledChunks = 4)
+        : AudioChunkPool(ChunkSizeFor(format, durationMs), maxPooledChunks)
+    {
+    }
+
+    AudioChunkPool(const AudioChunkPool&) = delete;
+    AudioChunkPool& operator=(const AudioChunkPool&) = delete;
+
+    ~AudioChunkPool()
+    {
+        for (auto buffer : m_idle)
+        {
+            delete buffer;
+        }
+    }
+
+    // Returns a chunk of ChunkSize() bytes, reusing an idle one when available.
+    Chunk Acquire()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (!m_idle.empty())
+            {
+                auto buffer = m_idle.back();
+                m_idle.pop_back();
+                return Chunk(buffer, Releaser(this));
+            }
+        }
+        return Chunk(new std::vector<uint8_t>(m_chunkSize), Releaser(this));
+    }
+
+    uint32_t ChunkSize() const
+    {
+        return m_chunkSize;
+    }
+
+private:
+    void Release(std::vector<uint8_t>* buffer)
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (m_idle.size() < m_maxPooledChunks)
+            {
+                m_idle.push_back(buffer);
+                return;
+            }
+        }
+        delete buffer;
+    }
+
+    const uint32_t m_chunkSize;
+    const size_t m_maxPooledChunks;
+    std::mutex m_mutex;
+    std::vector<std::vector<uint8_t>*> m_idle;
+};
@@ -0,0 +1,185 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#pragma once
+
+#include <speechapi_cxx.h>
+#include <algorithm>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "pull_callback.h"
+#include "wav_file_reader.h"
+
+// The audio data of a set of WAV files, loaded once into one page-aligned block of memory, so benchmark iterations
+// replay the same bytes from memory and measure the SDK rather than the disk and the page cache.
+// The headers are parsed once while loading; entries are packed back to back, each starting on a cache line.
+// Streams created from the arena keep its memory alive, so they can outlive the arena itself.
+class AudioCorpusArena final
+{
+public:
+    struct Entry
+    {
+        // The file name as given to the constructor.
+        std::string Name;
+        WavFileReader::WAVEFORMAT Format;
+        // Position of the audio data in the arena, and its size in bytes.
+        size_t Offset;
+        uint32_t Size;
+    };
+
+    // Loads the 'data' chunks of 'files'. Throws std::invalid_argument or std::runtime_error like MappedWavFileReader,
+    // or std::bad_alloc if the arena cannot be allocated.
+    explicit AudioCorpusArena(const std::vector<std::string>& files)
+    {
+        // Parses all headers first, so the arena is allocated once at its final size.
+        std::vector<std::unique_ptr<MappedWavFileReader>> readers;
+        size_t capacity = 0;
+        for (const auto& file : files)
+        {
+            readers.push_back(std::unique_ptr<MappedWavFileReader>(new MappedWavFileReader(file)));
+            capacity = AlignUp(capacity, entryAlignment);
+            m_entries.push_back({ file, readers.back()->GetFormat(), capacity, readers.back()->Size() });
+            capacity += readers.back()->Size();
+        }
+
+        m_capacity = AlignUp(std::max<size_t>(capacity, 1), PageSize());
+        m_memory = Allocate(m_capacity);
+        // Copying touches every page, so no page fault is left for the iterations.
+        for (size_t i = 0; i < readers.size(); i++)
+        {
+            memcpy(m_memory.get() + m_entries[i].Offset, readers[i]->Data(), m_entries[i].Size);
+        }
+    }
+
+    AudioCorpusArena(const AudioCorpusArena&) = delete;
+    AudioCorpusArena& operator=(const AudioCorpusArena&) = delete;
+
+    const std::vector<Entry>& Entries() const
+    {
+        return m_entries;
+    }
+
+    // Returns the index of the entry loaded from 'name'. Throws std::out_of_range if there is none.
+    size_t Find(const std::string& name) const
+    {
+        for (size_t i = 0; i < m_entries.size(); i++)
+        {
+            if (m_entries[i].Name == name)
+            {
+                return i;
+            }
+        }
+        throw std::out_of_range(name + " is not in the audio corpus.");
+    }
+
+    const Entry& GetEntry(size_t index) const
+    {
+        return m_entries.at(index);
+    }
+
+    const uint8_t* Data(size_t index) const
+    {
+        return m_memory.get() + m_entries.at(index).Offset;
+    }
+
+    // Size of the arena in bytes, a multiple of the page size.
+    size_t Capacity() const
+    {
+        return m_capacity;
+    }
+
+    // Keeps the arena in physical memory, so it is not paged out during long runs. Returns false if the system
+    // refused, e.g. because of the working set or RLIMIT_MEMLOCK limit; the arena still works then.
+    bool Lock() const
+    {
+#ifdef _WIN32
+        return VirtualLock(m_memory.get(), m_capacity) != 0;
+#else
+        return mlock(m_memory.get(), m_capacity) == 0;
+#endif
+    }
+
+    std::shared_ptr<Microsoft::CognitiveServices::Speech::Audio::AudioStreamFormat> CreateFormat(size_t index) const
+    {
+        const auto& format = GetEntry(index).Format;
+        return Microsoft::CognitiveServices::Speech::Audio::AudioStreamFormat::GetWaveFormatPCM(format.SamplesPerSec, (uint8_t)format.BitsPerSample, (uint8_t)format.Channels);
+    }
+
+    // Returns a pull stream reading the entry from the start, in the format of the entry.
+    std::shared_ptr<Microsoft::CognitiveServices::Speech::Audio::PullAudioInputStream> CreatePullStream(size_t index) const
+    {
+        using namespace Microsoft::CognitiveServices::Speech::Audio;
+
+        auto data = Data(index);
+        return AudioInputStream::CreatePullStream(CreateFormat(index), std::make_shared<PullCallback<MemorySource>>(m_memory, data, data + GetEntry(index).Size));
+    }
+
+    // Writes the entry to 'stream' in writes of 'chunkSize' bytes, without pacing, and closes the stream.
+    // 'onWrite' is called with the size of every write after it, e.g. for RecognitionLatencyTracker::OnAudioPushed().
+    void Push(size_t index, Microsoft::CognitiveServices::Speech::Audio::PushAudioInputStream& stream, uint32_t chunkSize,
+        const std::function<void(uint32_t)>& onWrite = nullptr) const
+    {
+        auto data = Data(index);
+        auto size = GetEntry(index).Size;
+        for (uint32_t position = 0; position < size; position += chunkSize)
+        {
+            auto count = std::min(chunkSize, size - position);
+            // Write() does not modify the buffer, it only takes a non-const pointer.
+            stream.Write(const_cast<uint8_t*>(data + position), count);
+            if (onWrite)
+            {
+                onWrite(count);
+            }
+        }
+        stream.Close();
+    }
+
+private:
+    // Entries start on a cache line, so replaying one never shares a line with the end of another.
+    static constexpr size_t entryAlignment = 64;
+
+    static size_t AlignUp(size_t value, size_t alignment)
+    {
+        return (value + alignment - 1) / alignment * alignment;
+    }
+
+    static size_t PageSize()
+    {
+#ifdef _WIN32
+        SYSTEM_INFO info;
+        GetSystemInfo(&info);
+        return info.dwPageSize;
+#else
+        return (size_t)sysconf(_SC_PAGESIZE);
+#endif
+    }
+
+    // Pages straight from the system, which are page-aligned and not shared with other allocations.
+    static std::shared_ptr<uint8_t> Allocate(size_t size)
+    {
+#ifdef _WIN32
+        auto memory = VirtualAlloc(nullptr, size, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+        if (memory == nullptr)
+        {
+            throw std::bad_alloc();
+        }
+        return std::shared_ptr<uint8_t>(static_cast<uint8_t*>(memory), [](uint8_t* pages) { VirtualFree(pages, 0, MEM_RELEASE); });
+#else
+        auto memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (memory == MAP_FAILED)
+        {
+            throw std::bad_alloc();
+        }
+        return std::shared_ptr<uint8_t>(static_cast<uint8_t*>(memory), [size](uint8_t* pages) { munmap(pages, size); });
+#endif
+    }
+
+    std::vector<Entry> m_entries;
+    size_t m_capacity = 0;
+    std::shared_ptr<uint8_t> m_memory;
+};
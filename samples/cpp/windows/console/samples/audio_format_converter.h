@@ -0,0 +1,460 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "audio_chunk_pool.h"
+#include "wav_file_reader.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define PCM_FORMAT_CONVERTER_SSE2
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#define PCM_FORMAT_CONVERTER_NEON
+#endif
+
+// Converts PCM audio to the 16 kHz, 16-bit mono format the service expects, while streaming.
+// Frames are downmixed to mono by averaging the channels, resampled with a polyphase windowed-sinc filter
+// and requantized to 16 bits with rounding and saturation. Input may be 8, 16, 24 or 32-bit integer PCM,
+// or 32 or 64-bit float PCM, at any sample rate. The timeline is kept: the output of N seconds of input
+// is N seconds long, and the filter delay is compensated, so result offsets refer to the input file.
+class PcmFormatConverter final
+{
+public:
+    static constexpr uint32_t outputSamplesPerSec = 16000;
+
+    // Throws std::invalid_argument for formats that cannot be converted, including WAVE_FORMAT_EXTENSIBLE.
+    explicit PcmFormatConverter(const WavFileReader::WAVEFORMAT& input)
+        : m_encoding(EncodingOf(input)), m_channels(input.Channels), m_blockAlign(input.BlockAlign)
+    {
+        if (input.Channels == 0 || input.SamplesPerSec == 0 || input.BlockAlign != input.Channels * input.BitsPerSample / 8)
+        {
+            throw std::invalid_argument("The audio format has no channels, no sample rate or an unexpected block size.");
+        }
+        m_passThrough = m_encoding == Encoding::Int16 && m_channels == 1 && input.SamplesPerSec == outputSamplesPerSec;
+        m_carry.reserve(m_blockAlign);
+        DesignFilter(input.SamplesPerSec);
+    }
+
+    // Returns the format of the converted audio.
+    static WavFileReader::WAVEFORMAT GetOutputFormat()
+    {
+        return WavFileReader::WAVEFORMAT{ 1, 1, outputSamplesPerSec, outputSamplesPerSec * 2, 2, 16 };
+    }
+
+    // True when the input already has the output format and is copied unchanged.
+    bool IsPassThrough() const
+    {
+        return m_passThrough;
+    }
+
+    // Converts 'size' bytes of input and appends the samples that are complete to 'output'.
+    // The input may end in the middle of a frame, the rest of the frame is expected in the next call.
+    void Convert(const uint8_t* data, uint32_t size, std::vector<int16_t>& output)
+    {
+        if (!m_carry.empty())
+        {
+            auto count = std::min<uint32_t>(m_blockAlign - (uint32_t)m_carry.size(), size);
+            m_carry.insert(m_carry.end(), data, data + count);
+            data += count;
+            size -= count;
+            if (m_carry.size() < m_blockAlign)
+            {
+                return;
+            }
+            Decode(m_carry.data(), 1, output);
+            m_carry.clear();
+        }
+
+        auto frames = size / m_blockAlign;
+        Decode(data, frames, output);
+        m_carry.assign(data + frames * m_blockAlign, data + size);
+        if (!m_passThrough)
+        {
+            Resample(output);
+        }
+    }
+
+    // Appends the samples still held in the filter at the end of the input. A partial last frame is dropped.
+    void Flush(std::vector<int16_t>& output)
+    {
+        m_carry.clear();
+        if (m_passThrough)
+        {
+            return;
+        }
+        // Zeros push the last input samples through the center of the filter, and output stops at the
+        // length of the input.
+        m_input.insert(m_input.end(), m_tapsPerPhase, 0.0f);
+        m_outputLimit = (m_inputFrames * m_interpolation + m_decimation - 1) / m_decimation;
+        Resample(output);
+    }
+
+private:
+    enum class Encoding { UInt8, Int16, Int24, Int32, Float32, Float64 };
+
+    static constexpr uint16_t formatTagPcm = 1;
+    static constexpr uint16_t formatTagIeeeFloat = 3;
+
+    // Filter length in zero crossings of the sinc on each side, at the lower of the two rates.
+    static constexpr uint32_t zeroCrossings = 12;
+    // The passband ends at this fraction of the lower Nyquist frequency, the rest is the transition band.
+    static constexpr double passband = 0.9;
+    // Kaiser window shape, for about 80 dB of stopband attenuation.
+    static constexpr double kaiserBeta = 8.0;
+
+    static Encoding EncodingOf(const WavFileReader::WAVEFORMAT& format)
+    {
+        // WAVE_FORMAT_EXTENSIBLE is expected to be resolved to its sub format, see WavFileReader::GetSampleFormat().
+        if (format.FormatTag == formatTagPcm)
+        {
+            switch (format.BitsPerSample)
+            {
+            case 8: return Encoding::UInt8;
+            case 16: return Encoding::Int16;
+            case 24: return Encoding::Int24;
+            case 32: return Encoding::Int32;
+            }
+        }
+        else if (format.FormatTag == formatTagIeeeFloat)
+        {
+            switch (format.BitsPerSample)
+            {
+            case 32: return Encoding::Float32;
+            case 64: return Encoding::Float64;
+            }
+        }
+        throw std::invalid_argument("Only 8, 16, 24 or 32-bit integer and 32 or 64-bit float PCM audio can be converted.");
+    }
+
+    static uint32_t GreatestCommonDivisor(uint32_t a, uint32_t b)
+    {
+        while (b != 0)
+        {
+            auto rest = a % b;
+            a = b;
+            b = rest;
+        }
+        return a;
+    }
+
+    // Zeroth order modified Bessel function of the first kind, for the Kaiser window.
+    static double BesselI0(double x)
+    {
+        double sum = 1, term = 1;
+        for (int k = 1; k < 50 && term > sum * 1e-12; k++)
+        {
+            term *= (x / (2 * k)) * (x / (2 * k));
+            sum += term;
+        }
+        return sum;
+    }
+
+    // Designs the prototype low-pass filter at the rate 'input * interpolation' and splits it into one filter
+    // per phase, with the taps reversed so every output sample is a dot product over consecutive input samples.
+    void DesignFilter(uint32_t inputSamplesPerSec)
+    {
+        auto divisor = GreatestCommonDivisor(outputSamplesPerSec, inputSamplesPerSec);
+        m_interpolation = outputSamplesPerSec / divisor;
+        m_decimation = inputSamplesPerSec / divisor;
+
+        if (m_interpolation == m_decimation)
+        {
+            // Same rate, only the channels or the sample size change.
+            m_tapsPerPhase = 1;
+            m_taps.assign(1, 1.0f);
+        }
+        else
+        {
+            // Cutoff relative to the input Nyquist frequency, below the output Nyquist frequency when downsampling.
+            auto cutoff = std::min(1.0, (double)outputSamplesPerSec / inputSamplesPerSec);
+            m_tapsPerPhase = (uint32_t)std::ceil(2 * zeroCrossings / cutoff);
+            m_tapsPerPhase = (m_tapsPerPhase + 3) & ~3u;
+
+            const double pi = 3.14159265358979323846;
+            auto length = (size_t)m_interpolation * m_tapsPerPhase;
+            // The center is a whole sample of the prototype, so the compensated delay is exact.
+            auto center = (double)((length - 1) / 2);
+            auto bandwidth = cutoff * passband;
+            std::vector<double> prototype(length);
+            for (size_t j = 0; j < length; j++)
+            {
+                // Time in input samples from the center of the filter.
+                auto t = (j - center) / m_interpolation;
+                auto x = pi * bandwidth * t;
+                auto sinc = x == 0 ? 1.0 : std::sin(x) / x;
+                auto w = (j - center) / center;
+                auto window = center == 0 ? 1.0 : BesselI0(kaiserBeta * std::sqrt(std::max(0.0, 1 - w * w))) / BesselI0(kaiserBeta);
+                prototype[j] = bandwidth * sinc * window;
+            }
+
+            m_taps.resize(length);
+            for (uint32_t phase = 0; phase < m_interpolation; phase++)
+            {
+                // Every phase is normalized to unity gain, so silence stays silent and DC is kept exactly.
+                double sum = 0;
+                for (uint32_t k = 0; k < m_tapsPerPhase; k++)
+                {
+                    sum += prototype[phase + (size_t)k * m_interpolation];
+                }
+                for (uint32_t k = 0; k < m_tapsPerPhase; k++)
+                {
+                    m_taps[(size_t)phase * m_tapsPerPhase + (m_tapsPerPhase - 1 - k)] = (float)(prototype[phase + (size_t)k * m_interpolation] / sum);
+                }
+            }
+        }
+
+        // The history starts with zeros, and the first output sample is centered on the first input sample.
+        m_input.assign(m_tapsPerPhase - 1, 0.0f);
+        m_time = (uint64_t)(m_tapsPerPhase - 1) * m_interpolation + ((uint64_t)m_interpolation * m_tapsPerPhase - 1) / 2;
+    }
+
+    // Downmixes 'frames' frames to mono samples in the scale of 16-bit audio.
+    void Decode(const uint8_t* data, size_t frames, std::vector<int16_t>& output)
+    {
+        if (m_passThrough)
+        {
+            auto offset = output.size();
+            output.resize(offset + frames);
+            memcpy(output.data() + offset, data, frames * sizeof(int16_t));
+            return;
+        }
+
+        m_inputFrames += frames;
+        switch (m_encoding)
+        {
+        case Encoding::UInt8:
+            DecodeFrames(data, frames, 1, [](const uint8_t* p) { return (float)((int)p[0] - 128) * 256.0f; });
+            break;
+        case Encoding::Int16:
+            DecodeFrames(data, frames, 2, [](const uint8_t* p) { int16_t s; memcpy(&s, p, sizeof(s)); return (float)s; });
+            break;
+        case Encoding::Int24:
+            DecodeFrames(data, frames, 3, [](const uint8_t* p)
+            {
+                // The sample is placed in the upper bytes of a 32-bit value, which sign extends it.
+                auto s = (int32_t)(((uint32_t)p[0] << 8) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 24));
+                return (float)s * (1.0f / 65536.0f);
+            });
+            break;
+        case Encoding::Int32:
+            DecodeFrames(data, frames, 4, [](const uint8_t* p) { int32_t s; memcpy(&s, p, sizeof(s)); return (float)s * (1.0f / 65536.0f); });
+            break;
+        case Encoding::Float32:
+            DecodeFrames(data, frames, 4, [](const uint8_t* p) { float s; memcpy(&s, p, sizeof(s)); return s * 32768.0f; });
+            break;
+        case Encoding::Float64:
+            DecodeFrames(data, frames, 8, [](const uint8_t* p) { double s; memcpy(&s, p, sizeof(s)); return (float)(s * 32768.0); });
+            break;
+        }
+    }
+
+    template <class ReadSample>
+    void DecodeFrames(const uint8_t* data, size_t frames, uint32_t bytesPerSample, ReadSample read)
+    {
+        auto scale = 1.0f / m_channels;
+        auto offset = m_input.size();
+        m_input.resize(offset + frames);
+        for (size_t frame = 0; frame < frames; frame++)
+        {
+            float sum = 0;
+            for (uint16_t channel = 0; channel < m_channels; channel++, data += bytesPerSample)
+            {
+                sum += read(data);
+            }
+            m_input[offset + frame] = sum * scale;
+        }
+    }
+
+    // Produces an output sample wherever the filter has all of its input, then drops the input no longer needed.
+    void Resample(std::vector<int16_t>& output)
+    {
+        m_resampled.clear();
+        while (m_outputFrames < m_outputLimit)
+        {
+            auto newest = m_time / m_interpolation;
+            if (newest >= m_input.size())
+            {
+                break;
+            }
+            auto phase = (size_t)(m_time % m_interpolation);
+            m_resampled.push_back(Dot(m_taps.data() + phase * m_tapsPerPhase, m_input.data() + newest + 1 - m_tapsPerPhase, m_tapsPerPhase));
+            m_time += m_decimation;
+            m_outputFrames++;
+        }
+
+        auto consumed = std::min<size_t>((size_t)(m_time / m_interpolation) + 1 - m_tapsPerPhase, m_input.size());
+        m_input.erase(m_input.begin(), m_input.begin() + consumed);
+        m_time -= (uint64_t)consumed * m_interpolation;
+
+        Requantize(m_resampled, output);
+    }
+
+    static float Dot(const float* taps, const float* samples, size_t count)
+    {
+        size_t i = 0;
+        float sum = 0;
+#if defined(PCM_FORMAT_CONVERTER_SSE2)
+        auto sums = _mm_setzero_ps();
+        for (; i + 4 <= count; i += 4)
+        {
+            sums = _mm_add_ps(sums, _mm_mul_ps(_mm_loadu_ps(taps + i), _mm_loadu_ps(samples + i)));
+        }
+        float lanes[4];
+        _mm_storeu_ps(lanes, sums);
+        sum = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+#elif defined(PCM_FORMAT_CONVERTER_NEON)
+        auto sums = vdupq_n_f32(0);
+        for (; i + 4 <= count; i += 4)
+        {
+            sums = vmlaq_f32(sums, vld1q_f32(taps + i), vld1q_f32(samples + i));
+        }
+        float lanes[4];
+        vst1q_f32(lanes, sums);
+        sum = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+#endif
+        for (; i < count; i++)
+        {
+            sum += taps[i] * samples[i];
+        }
+        return sum;
+    }
+
+    // Rounds to the nearest 16-bit value, saturating samples beyond full scale.
+    static void Requantize(const std::vector<float>& samples, std::vector<int16_t>& output)
+    {
+        auto offset = output.size();
+        output.resize(offset + samples.size());
+        auto out = output.data() + offset;
+        size_t i = 0;
+#if defined(PCM_FORMAT_CONVERTER_SSE2)
+        // _mm_cvtps_epi32 rounds to nearest, _mm_packs_epi32 saturates to 16 bits. The clamp keeps values
+        // beyond the 32-bit range from wrapping around in the conversion.
+        auto lowest = _mm_set1_ps(-32768.0f);
+        auto highest = _mm_set1_ps(32767.0f);
+        for (; i + 8 <= samples.size(); i += 8)
+        {
+            auto low = _mm_cvtps_epi32(_mm_max_ps(lowest, _mm_min_ps(highest, _mm_loadu_ps(samples.data() + i))));
+            auto high = _mm_cvtps_epi32(_mm_max_ps(lowest, _mm_min_ps(highest, _mm_loadu_ps(samples.data() + i + 4))));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), _mm_packs_epi32(low, high));
+        }
+#endif
+        for (; i < samples.size(); i++)
+        {
+            auto s = std::nearbyint(std::max(-32768.0f, std::min(32767.0f, samples[i])));
+            out[i] = (int16_t)s;
+        }
+    }
+
+    const Encoding m_encoding;
+    const uint16_t m_channels;
+    const uint32_t m_blockAlign;
+    bool m_passThrough;
+
+    uint32_t m_interpolation = 1;
+    uint32_t m_decimation = 1;
+    uint32_t m_tapsPerPhase = 1;
+    std::vector<float> m_taps;
+
+    // Bytes of a frame split across two calls of Convert().
+    std::vector<uint8_t> m_carry;
+    // Mono input not consumed by the filter yet.
+    std::vector<float> m_input;
+    std::vector<float> m_resampled;
+    // Position of the next output sample, in input samples times 'm_interpolation' from the start of m_input.
+    uint64_t m_time = 0;
+    uint64_t m_inputFrames = 0;
+    uint64_t m_outputFrames = 0;
+    uint64_t m_outputLimit = UINT64_MAX;
+};
+
+// Reads a wav file of any format PcmFormatConverter supports and returns it as 16 kHz, 16-bit mono audio.
+// It is a source for ReadAheadAudioCallback, so the conversion also runs on the read-ahead thread.
+class ConvertingWavFileReader final
+{
+public:
+    // Throws std::invalid_argument or std::runtime_error when the file cannot be opened or converted.
+    explicit ConvertingWavFileReader(const std::string& audioFileName)
+        : m_reader(audioFileName), m_converter(m_reader.GetSampleFormat()), m_format(PcmFormatConverter::GetOutputFormat())
+    {
+        m_input.resize(AudioChunkPool::ChunkSizeFor(m_reader.GetFormat()));
+    }
+
+    // Copies up to 'size' bytes of converted audio. Returns 0 at the end of the file.
+    int Read(uint8_t* dataBuffer, uint32_t size)
+    {
+        uint32_t copied = 0;
+        while (copied < size)
+        {
+            auto available = m_output.size() * sizeof(int16_t) - m_outputOffset;
+            if (available == 0)
+            {
+                if (m_endOfFile)
+                {
+                    break;
+                }
+                Refill();
+                continue;
+            }
+            auto count = (uint32_t)std::min<size_t>(size - copied, available);
+            memcpy(dataBuffer + copied, reinterpret_cast<const uint8_t*>(m_output.data()) + m_outputOffset, count);
+            copied += count;
+            m_outputOffset += count;
+        }
+        return (int)copied;
+    }
+
+    void Close()
+    {
+        m_reader.Close();
+        m_endOfFile = true;
+        m_output.clear();
+        m_outputOffset = 0;
+    }
+
+    // Returns the format of the converted audio.
+    const WavFileReader::WAVEFORMAT& GetFormat() const
+    {
+        return m_format;
+    }
+
+    // Returns the format of the file.
+    const WavFileReader::WAVEFORMAT& GetInputFormat() const
+    {
+        return m_reader.GetFormat();
+    }
+
+private:
+    void Refill()
+    {
+        m_output.clear();
+        m_outputOffset = 0;
+        auto count = m_reader.Read(m_input.data(), (uint32_t)m_input.size());
+        if (count > 0)
+        {
+            m_converter.Convert(m_input.data(), (uint32_t)count, m_output);
+        }
+        else
+        {
+            m_converter.Flush(m_output);
+            m_endOfFile = true;
+        }
+    }
+
+    WavFileReader m_reader;
+    PcmFormatConverter m_converter;
+    const WavFileReader::WAVEFORMAT m_format;
+    std::vector<uint8_t> m_input;
+    std::vector<int16_t> m_output;
+    size_t m_outputOffset = 0;
+    bool m_endOfFile = false;
+};
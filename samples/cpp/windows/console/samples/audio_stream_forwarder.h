@@ -0,0 +1,190 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#pragma once
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#pragma comment(lib, "ws2_32.lib")
+#else
+#include <netdb.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+#include <speechapi_cxx.h>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// Sends audio over a TCP connection, e.g. to the media server of a voice bot.
+class TcpAudioSink final
+{
+public:
+    // Connects to 'host' on 'port'. Throws std::runtime_error when the connection cannot be set up.
+    TcpAudioSink(const std::string& host, const std::string& port)
+    {
+#ifdef _WIN32
+        WSADATA wsaData;
+        if (WSAStartup(MAKEWORD(2, 2), &wsaData) != 0)
+        {
+            throw std::runtime_error("Failed to initialize Winsock.");
+        }
+#endif
+        addrinfo hints = {};
+        hints.ai_family = AF_UNSPEC;
+        hints.ai_socktype = SOCK_STREAM;
+        addrinfo* addresses = nullptr;
+        if (getaddrinfo(host.c_str(), port.c_str(), &hints, &addresses) != 0)
+        {
+            Cleanup();
+            throw std::runtime_error("Failed to resolve " + host + ":" + port);
+        }
+
+        for (auto address = addresses; address != nullptr && m_socket == invalidSocket; address = address->ai_next)
+        {
+            m_socket = socket(address->ai_family, address->ai_socktype, address->ai_protocol);
+            if (m_socket != invalidSocket && connect(m_socket, address->ai_addr, (int)address->ai_addrlen) != 0)
+            {
+                CloseSocket();
+            }
+        }
+        freeaddrinfo(addresses);
+
+        if (m_socket == invalidSocket)
+        {
+            Cleanup();
+            throw std::runtime_error("Failed to connect to " + host + ":" + port);
+        }
+    }
+
+    TcpAudioSink(const TcpAudioSink&) = delete;
+    TcpAudioSink& operator=(const TcpAudioSink&) = delete;
+
+    ~TcpAudioSink()
+    {
+        CloseSocket();
+        Cleanup();
+    }
+
+    // Sends all bytes. Returns false when the connection has been closed.
+    bool Send(const uint8_t* data, uint32_t size)
+    {
+        while (size > 0)
+        {
+            auto sent = send(m_socket, reinterpret_cast<const char*>(data), (int)size, sendFlags);
+            if (sent <= 0)
+            {
+                return false;
+            }
+            data += sent;
+            size -= (uint32_t)sent;
+        }
+        return true;
+    }
+
+private:
+#ifdef _WIN32
+    using Socket = SOCKET;
+    static constexpr Socket invalidSocket = INVALID_SOCKET;
+    static constexpr int sendFlags = 0;
+#else
+    using Socket = int;
+    static constexpr Socket invalidSocket = -1;
+    // A closed connection is reported by send(), not by a SIGPIPE that ends the process.
+    static constexpr int sendFlags = MSG_NOSIGNAL;
+#endif
+
+    void CloseSocket()
+    {
+        if (m_socket != invalidSocket)
+        {
+#ifdef _WIN32
+            closesocket(m_socket);
+#else
+            close(m_socket);
+#endif
+            m_socket = invalidSocket;
+        }
+    }
+
+    static void Cleanup()
+    {
+#ifdef _WIN32
+        WSACleanup();
+#endif
+    }
+
+    Socket m_socket = invalidSocket;
+};
+
+// Synthesizes text and forwards the audio while the service is still sending it, instead of waiting for
+// the complete result. Reports the time to the first byte, the delay a listener notices before playback.
+class AudioStreamForwarder final
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    // Returns false to stop, e.g. when the receiver went away.
+    using Sink = std::function<bool(const uint8_t* data, uint32_t size)>;
+
+    struct Statistics
+    {
+        // From the start of the synthesis until the first audio was handed to the sink.
+        std::chrono::microseconds FirstByte{ 0 };
+        std::chrono::microseconds Total{ 0 };
+        uint64_t Bytes = 0;
+        uint32_t Chunks = 0;
+    };
+
+    // ReadData() waits until the buffer is full or the stream ends, so small reads pass on the first audio
+    // sooner. The default of 1600 bytes is 50 ms of 16 kHz 16-bit mono audio.
+    static constexpr uint32_t defaultReadSize = 1600;
+
+    // Synthesizes 'input' and hands the audio to 'sink' chunk by chunk. Returns the stream of the synthesis,
+    // whose status tells whether it was canceled, see SpeechSynthesisCancellationDetails::FromStream().
+    static std::shared_ptr<Microsoft::CognitiveServices::Speech::AudioDataStream> Forward(
+        Microsoft::CognitiveServices::Speech::SpeechSynthesizer& synthesizer, const std::string& input,
+        const Sink& sink, Statistics& statistics, bool isSsml = false, uint32_t readSize = defaultReadSize)
+    {
+        using namespace Microsoft::CognitiveServices::Speech;
+
+        statistics = Statistics();
+        auto started = Clock::now();
+
+        // The result is returned as soon as the first audio arrives, the stream then fills as it keeps coming.
+        auto result = isSsml ? synthesizer.StartSpeakingSsmlAsync(input).get() : synthesizer.StartSpeakingTextAsync(input).get();
+        auto stream = AudioDataStream::FromResult(result);
+
+        std::vector<uint8_t> buffer(readSize);
+        uint32_t filledSize = 0;
+        while ((filledSize = stream->ReadData(buffer.data(), readSize)) > 0)
+        {
+            if (statistics.Chunks++ == 0)
+            {
+                statistics.FirstByte = std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - started);
+            }
+            statistics.Bytes += filledSize;
+
+            if (!sink(buffer.data(), filledSize))
+            {
+                synthesizer.StopSpeakingAsync().get();
+                break;
+            }
+        }
+
+        statistics.Total = std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - started);
+        return stream;
+    }
+};
@@ -0,0 +1,183 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#pragma once
+
+#include <speechapi_cxx.h>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Keeps an authorization token ready for SpeechConfig::FromAuthorizationToken(), so starting a session never waits
+// for the token service. A background thread fetches a new token 'RefreshMargin' before the current one expires, and
+// hands it to every tracked recognizer and synthesizer that is still alive; they use it for their next connection.
+// A failed fetch is retried every 'RetryInterval' while the current token is still valid.
+class AuthorizationTokenManager final
+{
+public:
+    // Returns a new token, e.g. from the issueToken endpoint of the region or from the token service of the
+    // application. Throws on failure.
+    using Fetcher = std::function<std::string()>;
+
+    struct Settings
+    {
+        // Tokens of the Speech service are valid for 10 minutes.
+        std::chrono::seconds Lifetime{ 600 };
+        std::chrono::seconds RefreshMargin{ 120 };
+        std::chrono::seconds RetryInterval{ 5 };
+    };
+
+    struct Statistics
+    {
+        uint64_t Refreshes = 0;
+        uint64_t FailedRefreshes = 0;
+        // Tracked recognizers and synthesizers given the newest token.
+        uint64_t Updates = 0;
+        std::string LastError;
+    };
+
+    explicit AuthorizationTokenManager(Fetcher fetcher)
+        : AuthorizationTokenManager(std::move(fetcher), Settings())
+    {
+    }
+
+    // Fetches the first token before returning, so GetToken() has one right away. Throws what the fetcher throws.
+    AuthorizationTokenManager(Fetcher fetcher, const Settings& settings)
+        : m_fetcher(std::move(fetcher)), m_settings(settings)
+    {
+        if (m_settings.RefreshMargin >= m_settings.Lifetime)
+        {
+            throw std::invalid_argument("The refresh margin must be shorter than the lifetime of a token.");
+        }
+        // The lifetime counts from the request, the token may have been issued any time before the response.
+        auto requested = Clock::now();
+        m_token = m_fetcher();
+        m_expires = requested + m_settings.Lifetime;
+        m_thread = std::thread([this]() { Run(); });
+    }
+
+    AuthorizationTokenManager(const AuthorizationTokenManager&) = delete;
+    AuthorizationTokenManager& operator=(const AuthorizationTokenManager&) = delete;
+
+    ~AuthorizationTokenManager()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stopping = true;
+        }
+        m_wakeUp.notify_one();
+        m_thread.join();
+    }
+
+    // Returns the cached token without waiting. After refreshes failed for longer than the margin, this is an
+    // expired token and sessions get an authentication error, see GetStatistics().LastError.
+    std::string GetToken()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_token;
+    }
+
+    std::shared_ptr<Microsoft::CognitiveServices::Speech::SpeechConfig> CreateConfig(const std::string& region)
+    {
+        return Microsoft::CognitiveServices::Speech::SpeechConfig::FromAuthorizationToken(GetToken(), region);
+    }
+
+    // Gives 'client' every new token for as long as it lives. 'ClientType' is a recognizer, a synthesizer or anything
+    // else with SetAuthorizationToken(). The manager only holds a weak reference.
+    template <class ClientType>
+    void Track(const std::shared_ptr<ClientType>& client)
+    {
+        std::weak_ptr<ClientType> weakClient = client;
+        auto update = [weakClient](const std::string& token)
+        {
+            auto alive = weakClient.lock();
+            if (alive)
+            {
+                alive->SetAuthorizationToken(token);
+            }
+            return alive != nullptr;
+        };
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        // The token may have been refreshed since the client was created from a config.
+        update(m_token);
+        m_clients.push_back(std::move(update));
+    }
+
+    Statistics GetStatistics()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_statistics;
+    }
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    void Run()
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        auto nextRefresh = m_expires - m_settings.RefreshMargin;
+        while (!m_wakeUp.wait_until(lock, nextRefresh, [this]() { return m_stopping; }))
+        {
+            // The fetch is the slow part and runs without the lock, so GetToken() never waits for it.
+            lock.unlock();
+            auto requested = Clock::now();
+            std::string token;
+            std::string error;
+            try
+            {
+                token = m_fetcher();
+            }
+            catch (const std::exception& e)
+            {
+                error = e.what();
+            }
+            lock.lock();
+
+            if (token.empty())
+            {
+                m_statistics.FailedRefreshes++;
+                m_statistics.LastError = error.empty() ? "The token service returned an empty token." : error;
+                nextRefresh = Clock::now() + m_settings.RetryInterval;
+                continue;
+            }
+
+            m_token = token;
+            m_expires = requested + m_settings.Lifetime;
+            m_statistics.Refreshes++;
+            m_statistics.LastError.clear();
+            nextRefresh = m_expires - m_settings.RefreshMargin;
+
+            // Clients that are gone are dropped.
+            std::vector<std::function<bool(const std::string&)>> alive;
+            for (auto& update : m_clients)
+            {
+                if (update(m_token))
+                {
+                    m_statistics.Updates++;
+                    alive.push_back(std::move(update));
+                }
+            }
+            m_clients.swap(alive);
+        }
+    }
+
+    const Fetcher m_fetcher;
+    const Settings m_settings;
+
+    std::mutex m_mutex;
+    std::condition_variable m_wakeUp;
+    std::string m_token;
+    Clock::time_point m_expires;
+    std::vector<std::function<bool(const std::string&)>> m_clients;
+    Statistics m_statistics;
+    bool m_stopping = false;
+    std::thread m_thread;
+};
@@ -0,0 +1,310 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#include "stdafx.h"
+
+#include <speechapi_cxx.h>
+#include <nlohmann/json.hpp>
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <functional>
+#include <future>
+#include <fstream>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <dirent.h>
+#include <sys/stat.h>
+#endif
+
+using namespace std;
+using namespace Microsoft::CognitiveServices::Speech;
+using namespace Microsoft::CognitiveServices::Speech::Audio;
+
+// The outcome of recognizing one file in a batch.
+struct BatchRecognitionResult
+{
+    string FileName;
+    string Status;                 // "Completed" or "Canceled".
+    string ErrorDetails;
+    vector<string> Segments;       // Recognized text, in order.
+    chrono::milliseconds Elapsed{ 0 };
+};
+
+namespace
+{
+    bool EndsWith(const string& value, const string& suffix)
+    {
+        if (value.size() < suffix.size())
+        {
+            return false;
+        }
+        return equal(suffix.rbegin(), suffix.rend(), value.rbegin(), [](char a, char b) { return tolower(a) == tolower(b); });
+    }
+
+    bool IsDirectory(const string& path)
+    {
+#ifdef _WIN32
+        auto attributes = GetFileAttributesA(path.c_str());
+        return attributes != INVALID_FILE_ATTRIBUTES && (attributes & FILE_ATTRIBUTE_DIRECTORY) != 0;
+#else
+        struct stat st;
+        return stat(path.c_str(), &st) == 0 && S_ISDIR(st.st_mode);
+#endif
+    }
+
+    // Lists the .wav files directly inside a directory, sorted by name.
+    vector<string> ListWavFiles(const string& directory)
+    {
+        vector<string> files;
+#ifdef _WIN32
+        const string separator = "\\";
+        WIN32_FIND_DATAA findData;
+        auto handle = FindFirstFileA((directory + separator + "*.wav").c_str(), &findData);
+        if (handle != INVALID_HANDLE_VALUE)
+        {
+            do
+            {
+                if ((findData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) == 0)
+                {
+                    files.push_back(directory + separator + findData.cFileName);
+                }
+            } while (FindNextFileA(handle, &findData));
+            FindClose(handle);
+        }
+#else
+        const string separator = "/";
+        if (auto dir = opendir(directory.c_str()))
+        {
+            while (auto entry = readdir(dir))
+            {
+                string name = entry->d_name;
+                auto path = directory + separator + name;
+                if (EndsWith(name, ".wav") && !IsDirectory(path))
+                {
+                    files.push_back(path);
+                }
+            }
+            closedir(dir);
+        }
+#endif
+        sort(files.begin(), files.end());
+        return files;
+    }
+
+    // Reads a manifest with one file name per line. Empty lines and lines starting with '#' are skipped.
+    vector<string> ReadManifest(const string& manifestFileName)
+    {
+        ifstream manifest(manifestFileName);
+        if (!manifest.good())
+        {
+            throw invalid_argument("Failed to open the specified manifest file.");
+        }
+
+        vector<string> files;
+        string line;
+        while (getline(manifest, line))
+        {
+            // Tolerates manifests written on Windows.
+            if (!line.empty() && line.back() == '\r')
+            {
+                line.pop_back();
+            }
+            if (!line.empty() && line[0] != '#')
+            {
+                files.push_back(line);
+            }
+        }
+        return files;
+    }
+}
+
+// Returns the WAV files named by a directory, a manifest file, or a single WAV file.
+vector<string> GetBatchInputFiles(const string& path)
+{
+    if (IsDirectory(path))
+    {
+        return ListWavFiles(path);
+    }
+    if (EndsWith(path, ".wav"))
+    {
+        return { path };
+    }
+    return ReadManifest(path);
+}
+
+// Runs continuous recognition of one file on the calling thread and returns when the session has ended.
+BatchRecognitionResult RecognizeFileForBatch(const shared_ptr<SpeechConfig>& config, const string& fileName)
+{
+    BatchRecognitionResult result;
+    result.FileName = fileName;
+    auto started = chrono::steady_clock::now();
+
+    try
+    {
+        // Both Canceled and SessionStopped can signal the end, only the first one completes the promise.
+        // Declared before the recognizer, so they outlive any callback still running while it is destroyed.
+        promise<void> recognitionEnd;
+        once_flag endSignaled;
+        mutex resultMutex;
+
+        auto audioInput = AudioConfig::FromWavFileInput(fileName);
+        auto recognizer = SpeechRecognizer::FromConfig(config, audioInput);
+
+        recognizer->Recognized.Connect([&result, &resultMutex](const SpeechRecognitionEventArgs& e)
+        {
+            if (e.Result->Reason == ResultReason::RecognizedSpeech)
+            {
+                lock_guard<mutex> lock(resultMutex);
+                result.Segments.push_back(e.Result->Text);
+            }
+        });
+
+        recognizer->Canceled.Connect([&](const SpeechRecognitionCanceledEventArgs& e)
+        {
+            if (e.Reason == CancellationReason::Error)
+            {
+                {
+                    lock_guard<mutex> lock(resultMutex);
+                    result.Status = "Canceled";
+                    result.ErrorDetails = e.ErrorDetails;
+                }
+                call_once(endSignaled, [&recognitionEnd] { recognitionEnd.set_value(); });
+            }
+        });
+
+        recognizer->SessionStopped.Connect([&](const SessionEventArgs&)
+        {
+            call_once(endSignaled, [&recognitionEnd] { recognitionEnd.set_value(); });
+        });
+
+        recognizer->StartContinuousRecognitionAsync().get();
+        recognitionEnd.get_future().get();
+        recognizer->StopContinuousRecognitionAsync().get();
+
+        if (result.Status.empty())
+        {
+            result.Status = "Completed";
+        }
+    }
+    catch (const exception& e)
+    {
+        result.Status = "Canceled";
+        result.ErrorDetails = e.what();
+    }
+
+    result.Elapsed = chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - started);
+    return result;
+}
+
+// Recognizes all files with at most 'maxConcurrentSessions' sessions in flight on the given config.
+// 'onResult' is called once per file, as soon as that file is done, and never concurrently.
+void RecognizeFilesInBatch(const shared_ptr<SpeechConfig>& config, const vector<string>& files, size_t maxConcurrentSessions,
+    const function<void(const BatchRecognitionResult&)>& onResult)
+{
+    // Workers take the next file from a shared index, so a long file does not hold up the short ones queued behind it.
+    atomic<size_t> nextFile{ 0 };
+    mutex resultMutex;
+
+    auto worker = [&]()
+    {
+        for (auto index = nextFile++; index < files.size(); index = nextFile++)
+        {
+            auto result = RecognizeFileForBatch(config, files[index]);
+
+            lock_guard<mutex> lock(resultMutex);
+            onResult(result);
+        }
+    };
+
+    vector<thread> workers;
+    auto workerCount = max<size_t>(1, min(maxConcurrentSessions, files.size()));
+    for (size_t i = 0; i < workerCount; i++)
+    {
+        workers.emplace_back(worker);
+    }
+    for (auto& t : workers)
+    {
+        t.join();
+    }
+}
+
+// Continuous recognition of a batch of files with a bounded number of concurrent sessions.
+void SpeechContinuousRecognitionBatchWithFiles()
+{
+    // Creates an instance of a speech config with specified subscription key and service region.
+    // Replace with your own subscription key and service region (e.g., "westus").
+    auto config = SpeechConfig::FromSubscription("YourSubscriptionKey", "YourServiceRegion");
+
+    cout << "Enter a directory, a manifest file with one WAV file per line, or a WAV file (empty for the sample files): ";
+    string path;
+    getline(cin, path);
+
+    cout << "Enter the number of concurrent sessions (empty for 4): ";
+    string concurrency;
+    getline(cin, concurrency);
+
+    vector<string> files;
+    size_t maxConcurrentSessions = 4;
+    try
+    {
+        files = path.empty()
+            ? vector<string>{ "whatstheweatherlike.wav", "enrollment_audio_katie.wav", "enrollment_audio_steve.wav" }
+            : GetBatchInputFiles(path);
+        if (!concurrency.empty())
+        {
+            maxConcurrentSessions = (size_t)max(1, stoi(concurrency));
+        }
+    }
+    catch (const exception& e)
+    {
+        cout << "Invalid batch input. " << e.what() << endl;
+        return;
+    }
+
+    // Results are appended as JSON lines as soon as each file is done, so a partial run still leaves usable output.
+    const string resultsFileName = "batch_recognition_results.jsonl";
+    ofstream results(resultsFileName, ios_base::out | ios_base::trunc);
+
+    cout << "Recognizing " << files.size() << " files with up to " << maxConcurrentSessions << " concurrent sessions..." << endl;
+    auto started = chrono::steady_clock::now();
+    size_t completed = 0;
+
+    RecognizeFilesInBatch(config, files, maxConcurrentSessions, [&](const BatchRecognitionResult& result)
+    {
+        nlohmann::json line;
+        line["file"] = result.FileName;
+        line["status"] = result.Status;
+        line["elapsedMs"] = result.Elapsed.count();
+        line["segments"] = result.Segments;
+        if (!result.ErrorDetails.empty())
+        {
+            line["errorDetails"] = result.ErrorDetails;
+        }
+        results << line.dump() << endl;
+
+        cout << "[" << ++completed << "/" << files.size() << "] " << result.Status << " " << result.FileName
+             << " (" << result.Elapsed.count() << " ms)" << endl;
+        if (!result.ErrorDetails.empty())
+        {
+            cout << "CANCELED: ErrorDetails=" << result.ErrorDetails << endl;
+        }
+    });
+
+    auto elapsed = chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - started);
+    cout << "Batch done in " << elapsed.count() << " ms, results written to " << resultsFileName << endl;
+}
@@ -0,0 +1,2218 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#include "stdafx.h"
+
+#include <speechapi_cxx.h>
+#include <nlohmann/json.hpp>
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <fstream>
+#include <functional>
+#include <future>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include <vector>
+#include "wav_file_reader.h"
+#include "audio_chunk_pool.h"
+#include "audio_corpus_arena.h"
+#include "paced_push_writer.h"
+#include "synthesis_format_selector.h"
+#include "recognition_latency_tracker.h"
+#include "process_memory.h"
+#include "process_cpu_time.h"
+#include "process_resources.h"
+
+using namespace std;
+using namespace Microsoft::CognitiveServices::Speech;
+using namespace Microsoft::CognitiveServices::Speech::Audio;
+using namespace Microsoft::CognitiveServices::Speech::Transcription;
+
+namespace
+{
+    using Clock = chrono::steady_clock;
+
+    struct BenchmarkOptions
+    {
+        vector<string> Scenarios{ "pull", "push", "synthesis", "audiodatastream" };
+        uint32_t Iterations = 10;
+        uint32_t Concurrency = 1;
+        string Key = "YourSubscriptionKey";
+        string Region = "YourServiceRegion";
+        string AudioFile = "whatstheweatherlike.wav";
+        // 16-bit PCM with up to 7 microphone channels and the speaker reference in the last channel.
+        string MasAudioFile = "katiesteve.wav";
+        string Text = "What's the weather like?";
+        string Output = "benchmark_report.json";
+        // The audio files, loaded by RunBenchmark() before the first iteration.
+        shared_ptr<const AudioCorpusArena> Corpus;
+    };
+
+    // Timing of one iteration of a scenario.
+    struct IterationResult
+    {
+        Clock::duration Total{ 0 };
+        // Time to the first partial result (recognition) or the first audio chunk (synthesis), when measured.
+        vector<Clock::duration> FirstResponse;
+        // Duration of the audio recognized, for the CPU time per second of audio.
+        chrono::duration<double> Audio{ 0 };
+    };
+
+    using Scenario = function<IterationResult(const shared_ptr<SpeechConfig>&, const BenchmarkOptions&)>;
+
+    // Runs continuous recognition until the session stops, and throws if it was canceled with an error.
+    // 'feed' is called after recognition has started, to provide audio for push streams.
+    IterationResult RecognizeContinuously(const shared_ptr<SpeechConfig>& config, const shared_ptr<AudioConfig>& audioInput,
+        RecognitionLatencyTracker& tracker, const function<void()>& feed)
+    {
+        promise<void> recognitionEnd;
+        once_flag endSignaled;
+        string error;
+
+        auto started = Clock::now();
+        auto recognizer = SpeechRecognizer::FromConfig(config, audioInput);
+        tracker.Attach(recognizer);
+
+        recognizer->Canceled.Connect([&](const SpeechRecognitionCanceledEventArgs& e)
+        {
+            if (e.Reason == CancellationReason::Error)
+            {
+                error = e.ErrorDetails;
+                call_once(endSignaled, [&recognitionEnd] { recognitionEnd.set_value(); });
+            }
+        });
+        recognizer->SessionStopped.Connect([&](const SessionEventArgs&)
+        {
+            call_once(endSignaled, [&recognitionEnd] { recognitionEnd.set_value(); });
+        });
+
+        tracker.OnAudioStart();
+        recognizer->StartContinuousRecognitionAsync().get();
+        if (feed)
+        {
+            feed();
+        }
+        recognitionEnd.get_future().get();
+        recognizer->StopContinuousRecognitionAsync().get();
+
+        if (!error.empty())
+        {
+            throw runtime_error("Recognition canceled: " + error);
+        }
+
+        IterationResult result;
+        result.Total = Clock::now() - started;
+        result.FirstResponse = tracker.FirstPartialLatencies();
+        return result;
+    }
+
+    IterationResult PullStreamRecognition(const shared_ptr<SpeechConfig>& config, const BenchmarkOptions& options)
+    {
+        RecognitionLatencyTracker tracker;
+        auto pullStream = options.Corpus->CreatePullStream(options.Corpus->Find(options.AudioFile));
+        return RecognizeContinuously(config, AudioConfig::FromStreamInput(pullStream), tracker, nullptr);
+    }
+
+    IterationResult PushStreamRecognition(const shared_ptr<SpeechConfig>& config, const BenchmarkOptions& options)
+    {
+        auto index = options.Corpus->Find(options.AudioFile);
+        const auto& format = options.Corpus->GetEntry(index).Format;
+        RecognitionLatencyTracker tracker(format.AvgBytesPerSec);
+        auto pushStream = AudioInputStream::CreatePushStream(options.Corpus->CreateFormat(index));
+
+        return RecognizeContinuously(config, AudioConfig::FromStreamInput(pushStream), tracker, [&]()
+        {
+            options.Corpus->Push(index, *pushStream, AudioChunkPool::ChunkSizeFor(format), [&tracker](uint32_t size) { tracker.OnAudioPushed(size); });
+        });
+    }
+
+    // A Microsoft Audio Stack configuration: the microphone channels of the MAS audio file it takes, and the
+    // processing options, or none for the baseline without MAS.
+    struct MasVariant
+    {
+        vector<uint16_t> Channels;
+        function<shared_ptr<AudioProcessingOptions>()> Options;
+    };
+
+    // Copies 'channels' of the 16-bit PCM corpus entry into interleaved audio with these channels only.
+    vector<uint8_t> SelectChannels(const AudioCorpusArena& corpus, size_t index, const vector<uint16_t>& channels)
+    {
+        const auto& format = corpus.GetEntry(index).Format;
+        if (format.BitsPerSample != 16)
+        {
+            throw runtime_error("The MAS audio file must be 16-bit PCM.");
+        }
+        for (auto channel : channels)
+        {
+            if (channel >= format.Channels)
+            {
+                throw runtime_error("The MAS audio file has " + to_string(format.Channels) + " channels, channel " + to_string(channel) + " is needed.");
+            }
+        }
+
+        auto samples = reinterpret_cast<const int16_t*>(corpus.Data(index));
+        auto frames = corpus.GetEntry(index).Size / format.BlockAlign;
+        vector<uint8_t> audio(frames * channels.size() * sizeof(int16_t));
+        auto selected = reinterpret_cast<int16_t*>(audio.data());
+        for (size_t frame = 0; frame < frames; frame++)
+        {
+            for (auto channel : channels)
+            {
+                *selected++ = samples[frame * format.Channels + channel];
+            }
+        }
+        return audio;
+    }
+
+    // Pushes the selected channels of the MAS audio file unthrottled, so the CPU time per second of audio and the
+    // first-partial latency compare the processing cost of the variants rather than the pace of the audio.
+    IterationResult MasRecognition(const shared_ptr<SpeechConfig>& config, const BenchmarkOptions& options, const MasVariant& variant)
+    {
+        auto index = options.Corpus->Find(options.MasAudioFile);
+        auto audio = SelectChannels(*options.Corpus, index, variant.Channels);
+        auto channels = (uint16_t)variant.Channels.size();
+        auto samplesPerSec = options.Corpus->GetEntry(index).Format.SamplesPerSec;
+        auto bytesPerSecond = samplesPerSec * channels * (uint32_t)sizeof(int16_t);
+
+        auto pushStream = AudioInputStream::CreatePushStream(AudioStreamFormat::GetWaveFormatPCM(samplesPerSec, 16, (uint8_t)channels));
+        auto audioInput = variant.Options ? AudioConfig::FromStreamInput(pushStream, variant.Options()) : AudioConfig::FromStreamInput(pushStream);
+        RecognitionLatencyTracker tracker(bytesPerSecond);
+
+        auto result = RecognizeContinuously(config, audioInput, tracker, [&]()
+        {
+            // 100 ms of audio per write, a whole number of frames.
+            size_t chunkSize = bytesPerSecond / 10;
+            for (size_t position = 0; position < audio.size(); position += chunkSize)
+            {
+                auto size = (uint32_t)min(chunkSize, audio.size() - position);
+                pushStream->Write(audio.data() + position, size);
+                tracker.OnAudioPushed(size);
+            }
+            pushStream->Close();
+        });
+        result.Audio = chrono::duration<double>((double)audio.size() / bytesPerSecond);
+        return result;
+    }
+
+    // The MAS scenarios: "mas-none" recognizes the first microphone channel without MAS; "mas-<geometry>-<variant>"
+    // runs one microphone array geometry with the default enhancements, or with one of them turned off.
+    vector<pair<string, Scenario>> MasScenarios()
+    {
+        struct Geometry
+        {
+            string Name;
+            vector<uint16_t> Microphones;
+            function<shared_ptr<AudioProcessingOptions>(int)> Create;
+        };
+
+        // The speaker reference is the last channel of the file (channel 7), after the microphones.
+        auto preset = [](PresetMicrophoneArrayGeometry geometry)
+        {
+            return [geometry](int flags) { return AudioProcessingOptions::Create(flags, geometry, SpeakerReferenceChannel::LastChannel); };
+        };
+        const vector<Geometry> geometries
+        {
+            { "circular7", { 0, 1, 2, 3, 4, 5, 6 }, preset(PresetMicrophoneArrayGeometry::Circular7) },
+            { "circular4", { 0, 1, 2, 3 }, preset(PresetMicrophoneArrayGeometry::Circular4) },
+            { "linear4", { 0, 1, 2, 3 }, preset(PresetMicrophoneArrayGeometry::Linear4) },
+            { "linear2", { 0, 1 }, preset(PresetMicrophoneArrayGeometry::Linear2) },
+            { "mono", { 0 }, preset(PresetMicrophoneArrayGeometry::Mono) },
+            { "custom7", { 0, 1, 2, 3, 4, 5, 6 }, [](int flags)
+                {
+                    // The planar array of SpeechContinuousRecognitionFromMultiChannelFileWithMASEnabledAndCustomGeometrySpecified.
+                    MicrophoneArrayGeometry geometry
+                    {
+                        MicrophoneArrayType::Planar,
+                        { { 0, 0, 0 }, { 40, 0, 0 }, { 20, -35, 0 }, { -20, -35, 0 }, { -40, 0, 0 }, { -20, 35, 0 }, { 20, 35, 0 } }
+                    };
+                    return AudioProcessingOptions::Create(flags, geometry, SpeakerReferenceChannel::LastChannel);
+                } },
+        };
+        const vector<pair<string, int>> variants
+        {
+            { "default", AUDIO_INPUT_PROCESSING_ENABLE_DEFAULT },
+            { "nodereverberation", AUDIO_INPUT_PROCESSING_ENABLE_DEFAULT | AUDIO_INPUT_PROCESSING_DISABLE_DEREVERBERATION },
+            { "nonoisesuppression", AUDIO_INPUT_PROCESSING_ENABLE_DEFAULT | AUDIO_INPUT_PROCESSING_DISABLE_NOISE_SUPPRESSION },
+            { "nogaincontrol", AUDIO_INPUT_PROCESSING_ENABLE_DEFAULT | AUDIO_INPUT_PROCESSING_DISABLE_AUTOMATIC_GAIN_CONTROL },
+            { "noechocancellation", AUDIO_INPUT_PROCESSING_ENABLE_DEFAULT | AUDIO_INPUT_PROCESSING_DISABLE_ECHO_CANCELLATION },
+        };
+
+        vector<pair<string, Scenario>> scenarios;
+        MasVariant baseline{ { 0 }, nullptr };
+        scenarios.emplace_back("mas-none", [baseline](const shared_ptr<SpeechConfig>& config, const BenchmarkOptions& options)
+        {
+            return MasRecognition(config, options, baseline);
+        });
+        for (const auto& geometry : geometries)
+        {
+            for (const auto& variant : variants)
+            {
+                auto channels = geometry.Microphones;
+                channels.push_back(7);
+                auto create = geometry.Create;
+                auto flags = variant.second;
+                MasVariant mas{ channels, [create, flags]() { return create(flags); } };
+                scenarios.emplace_back("mas-" + geometry.Name + "-" + variant.first, [mas](const shared_ptr<SpeechConfig>& config, const BenchmarkOptions& options)
+                {
+                    return MasRecognition(config, options, mas);
+                });
+            }
+        }
+        return scenarios;
+    }
+
+    IterationResult SynthesisToResult(const shared_ptr<SpeechConfig>& config, const BenchmarkOptions& options)
+    {
+        auto started = Clock::now();
+        auto synthesizer = SpeechSynthesizer::FromConfig(config, nullptr);
+        auto result = synthesizer->SpeakTextAsync(options.Text).get();
+        if (result->Reason != ResultReason::SynthesizingAudioCompleted)
+        {
+            auto cancellation = SpeechSynthesisCancellationDetails::FromResult(result);
+            throw runtime_error("Synthesis canceled: " + cancellation->ErrorDetails);
+        }
+
+        IterationResult iteration;
+        iteration.Total = Clock::now() - started;
+        return iteration;
+    }
+
+    IterationResult SynthesisToAudioDataStream(const shared_ptr<SpeechConfig>& config, const BenchmarkOptions& options)
+    {
+        auto started = Clock::now();
+        auto synthesizer = SpeechSynthesizer::FromConfig(config, nullptr);
+        auto result = synthesizer->StartSpeakingTextAsync(options.Text).get();
+        auto audioDataStream = AudioDataStream::FromResult(result);
+
+        IterationResult iteration;
+        vector<uint8_t> buffer(16000);
+        uint32_t filled = 0;
+        while ((filled = audioDataStream->ReadData(buffer.data(), (uint32_t)buffer.size())) > 0)
+        {
+            if (iteration.FirstResponse.empty())
+            {
+                iteration.FirstResponse.push_back(Clock::now() - started);
+            }
+        }
+
+        if (audioDataStream->GetStatus() == StreamStatus::Canceled)
+        {
+            auto cancellation = SpeechSynthesisCancellationDetails::FromStream(audioDataStream);
+            throw runtime_error("Synthesis canceled: " + cancellation->ErrorDetails);
+        }
+
+        iteration.Total = Clock::now() - started;
+        return iteration;
+    }
+
+    const map<string, Scenario>& GetScenarios()
+    {
+        static const map<string, Scenario> scenarios = []()
+        {
+            map<string, Scenario> all
+            {
+                { "pull", PullStreamRecognition },
+                { "push", PushStreamRecognition },
+                { "synthesis", SynthesisToResult },
+                { "audiodatastream", SynthesisToAudioDataStream },
+            };
+            for (auto& scenario : MasScenarios())
+            {
+                all.insert(scenario);
+            }
+            return all;
+        }();
+        return scenarios;
+    }
+
+    double ToMilliseconds(Clock::duration duration)
+    {
+        return chrono::duration<double, milli>(duration).count();
+    }
+
+    // Summarizes latencies as percentiles and a histogram with fixed millisecond buckets.
+    nlohmann::json Summarize(vector<Clock::duration> samples)
+    {
+        static const vector<double> bucketBoundsMs{ 10, 20, 50, 100, 200, 500, 1000, 2000, 5000, 10000, 20000, 60000 };
+
+        nlohmann::json summary;
+        summary["count"] = samples.size();
+        if (samples.empty())
+        {
+            return summary;
+        }
+
+        sort(samples.begin(), samples.end());
+        Clock::duration total{ 0 };
+        for (auto& sample : samples)
+        {
+            total += sample;
+        }
+
+        summary["minMs"] = ToMilliseconds(samples.front());
+        summary["meanMs"] = ToMilliseconds(total) / samples.size();
+        summary["p50Ms"] = RecognitionLatencyTracker::Percentile(samples, 50).count();
+        summary["p90Ms"] = RecognitionLatencyTracker::Percentile(samples, 90).count();
+        summary["p95Ms"] = RecognitionLatencyTracker::Percentile(samples, 95).count();
+        summary["p99Ms"] = RecognitionLatencyTracker::Percentile(samples, 99).count();
+        summary["maxMs"] = ToMilliseconds(samples.back());
+
+        // Each bucket counts the samples up to its bound that did not fit in the previous bucket.
+        auto histogram = nlohmann::json::array();
+        auto sample = samples.begin();
+        for (auto bound : bucketBoundsMs)
+        {
+            size_t count = 0;
+            for (; sample != samples.end() && ToMilliseconds(*sample) <= bound; ++sample)
+            {
+                count++;
+            }
+            histogram.push_back({ { "leMs", bound }, { "count", count } });
+        }
+        histogram.push_back({ { "leMs", "+Inf" }, { "count", (size_t)(samples.end() - sample) } });
+        summary["histogram"] = histogram;
+        return summary;
+    }
+
+    // Runs 'options.Iterations' iterations of the scenario, with 'options.Concurrency' iterations in flight.
+    nlohmann::json RunScenario(const string& name, const Scenario& scenario, const BenchmarkOptions& options)
+    {
+        auto config = SpeechConfig::FromSubscription(options.Key, options.Region);
+
+        atomic<uint32_t> nextIteration{ 0 };
+        mutex resultMutex;
+        vector<Clock::duration> totals;
+        vector<Clock::duration> firstResponses;
+        chrono::duration<double> audio{ 0 };
+        vector<string> errors;
+
+        auto worker = [&]()
+        {
+            while (nextIteration++ < options.Iterations)
+            {
+                try
+                {
+                    auto result = scenario(config, options);
+                    lock_guard<mutex> lock(resultMutex);
+                    totals.push_back(result.Total);
+                    firstResponses.insert(firstResponses.end(), result.FirstResponse.begin(), result.FirstResponse.end());
+                    audio += result.Audio;
+                }
+                catch (const exception& e)
+                {
+                    lock_guard<mutex> lock(resultMutex);
+                    errors.push_back(e.what());
+                }
+            }
+        };
+
+        auto started = Clock::now();
+        auto cpuStarted = GetProcessCpuTime();
+        vector<thread> workers;
+        for (uint32_t i = 0; i < max<uint32_t>(1, options.Concurrency); i++)
+        {
+            workers.emplace_back(worker);
+        }
+        for (auto& t : workers)
+        {
+            t.join();
+        }
+        auto wallTime = Clock::now() - started;
+        auto cpuTime = GetProcessCpuTime() - cpuStarted;
+
+        nlohmann::json report;
+        report["scenario"] = name;
+        report["iterations"] = options.Iterations;
+        report["concurrency"] = options.Concurrency;
+        report["succeeded"] = totals.size();
+        report["failed"] = errors.size();
+        report["wallTimeMs"] = ToMilliseconds(wallTime);
+        report["throughputPerSecond"] = totals.size() / max(chrono::duration<double>(wallTime).count(), 1e-9);
+        report["latency"] = Summarize(totals);
+        report["firstResponseLatency"] = Summarize(firstResponses);
+        report["peakResidentSetBytes"] = GetPeakResidentSetSize();
+        report["cpuMs"] = cpuTime.count() / 1000.0;
+        report["coresBusy"] = chrono::duration<double>(cpuTime).count() / max(chrono::duration<double>(wallTime).count(), 1e-9);
+        if (audio.count() > 0)
+        {
+            // CPU time of the whole process per second of audio; one core holds 1000 / cpuMsPerAudioSecond real-time streams.
+            auto cpuMsPerAudioSecond = cpuTime.count() / 1000.0 / audio.count();
+            report["audioSeconds"] = audio.count();
+            report["cpuMsPerAudioSecond"] = cpuMsPerAudioSecond;
+            report["streamsPerCore"] = cpuMsPerAudioSecond > 0 ? 1000.0 / cpuMsPerAudioSecond : 0.0;
+        }
+
+        // Keeps the report small when every iteration fails the same way.
+        sort(errors.begin(), errors.end());
+        errors.erase(unique(errors.begin(), errors.end()), errors.end());
+        report["errors"] = errors;
+        return report;
+    }
+
+    void PrintBenchmarkUsage()
+    {
+        cout << "Usage: sample --benchmark [options]\n"
+                "  --scenarios <list>    comma-separated scenarios to run (default pull,push,synthesis,audiodatastream)\n"
+                "  --iterations <n>      iterations per scenario (default 10)\n"
+                "  --concurrency <n>     iterations in flight at once (default 1)\n"
+                "  --key <key>           subscription key\n"
+                "  --region <region>     service region\n"
+                "  --audio <file>        WAV file for the recognition scenarios (default whatstheweatherlike.wav)\n"
+                "  --mas-audio <file>    16-bit WAV file for the mas scenarios, 7 microphones and the speaker reference last\n"
+                "                        (default katiesteve.wav)\n"
+                "  --text <text>         text for the synthesis scenarios\n"
+                "  --output <file>       JSON report file (default benchmark_report.json)\n";
+        cout << "Scenarios:";
+        for (auto& scenario : GetScenarios())
+        {
+            cout << " " << scenario.first;
+        }
+        cout << endl;
+        cout << "\"mas\" runs all mas-* scenarios. Their reports compare CPU time and first-partial latency with mas-none.\n";
+    }
+
+    vector<string> SplitList(const string& list)
+    {
+        vector<string> items;
+        stringstream stream(list);
+        string item;
+        while (getline(stream, item, ','))
+        {
+            if (!item.empty())
+            {
+                items.push_back(item);
+            }
+        }
+        return items;
+    }
+
+    BenchmarkOptions ParseBenchmarkOptions(const vector<string>& args)
+    {
+        BenchmarkOptions options;
+        for (size_t i = 0; i < args.size(); i++)
+        {
+            auto& name = args[i];
+            if (name == "--help" || name == "-h")
+            {
+                throw invalid_argument("");
+            }
+            if (i + 1 >= args.size())
+            {
+                throw invalid_argument("Missing value for " + name);
+            }
+
+            auto& value = args[++i];
+            if (name == "--scenarios")
+            {
+                options.Scenarios.clear();
+                for (auto& scenario : SplitList(value))
+                {
+                    if (scenario != "mas")
+                    {
+                        options.Scenarios.push_back(scenario);
+                        continue;
+                    }
+                    // The baseline runs first, so the others can be compared with it.
+                    for (auto& mas : MasScenarios())
+                    {
+                        options.Scenarios.push_back(mas.first);
+                    }
+                }
+            }
+            else if (name == "--iterations")
+            {
+                options.Iterations = (uint32_t)stoul(value);
+            }
+            else if (name == "--concurrency")
+            {
+                options.Concurrency = (uint32_t)stoul(value);
+            }
+            else if (name == "--key")
+            {
+                options.Key = value;
+            }
+            else if (name == "--region")
+            {
+                options.Region = value;
+            }
+            else if (name == "--audio")
+            {
+                options.AudioFile = value;
+            }
+            else if (name == "--mas-audio")
+            {
+                options.MasAudioFile = value;
+            }
+            else if (name == "--text")
+            {
+                options.Text = value;
+            }
+            else if (name == "--output")
+            {
+                options.Output = value;
+            }
+            else
+            {
+                throw invalid_argument("Unknown option " + name);
+            }
+        }
+
+        for (auto& scenario : options.Scenarios)
+        {
+            if (GetScenarios().find(scenario) == GetScenarios().end())
+            {
+                throw invalid_argument("Unknown scenario " + scenario);
+            }
+        }
+        return options;
+    }
+}
+
+namespace
+{
+    struct SoakOptions
+    {
+        string Key = "YourSubscriptionKey";
+        string Region = "YourServiceRegion";
+        string Voice = "en-US-JennyNeural";
+        string Language = "en-US";
+        // One sentence per line; the built-in sentences are used when empty.
+        string Corpus;
+        uint32_t Sessions = 20;
+        // Runs sessions until this many seconds have passed instead, when not zero.
+        uint32_t DurationSeconds = 0;
+        uint32_t Concurrency = 4;
+        uint32_t Synthesizers = 2;
+        // Sessions started per second; 0 starts the next session as soon as one of 'Concurrency' is free.
+        double ArrivalRate = 0;
+        string Output = "soak_report.json";
+    };
+
+    // Synthesizers connected once and shared by the sessions, so the soak measures sessions rather than handshakes.
+    class SynthesizerLeases final
+    {
+    public:
+        SynthesizerLeases(const shared_ptr<SpeechConfig>& config, uint32_t size)
+        {
+            for (uint32_t i = 0; i < max<uint32_t>(1, size); i++)
+            {
+                auto synthesizer = SpeechSynthesizer::FromConfig(config, nullptr);
+                Connection::FromSpeechSynthesizer(synthesizer)->Open(false);
+                m_idle.push_back(synthesizer);
+            }
+        }
+
+        shared_ptr<SpeechSynthesizer> Acquire()
+        {
+            unique_lock<mutex> lock(m_mutex);
+            m_available.wait(lock, [this] { return !m_idle.empty(); });
+            auto synthesizer = m_idle.front();
+            m_idle.pop_front();
+            return synthesizer;
+        }
+
+        void Release(shared_ptr<SpeechSynthesizer> synthesizer)
+        {
+            {
+                lock_guard<mutex> lock(m_mutex);
+                m_idle.push_back(move(synthesizer));
+            }
+            m_available.notify_one();
+        }
+
+    private:
+        mutex m_mutex;
+        condition_variable m_available;
+        deque<shared_ptr<SpeechSynthesizer>> m_idle;
+    };
+
+    // Lower-case words without punctuation, apostrophes kept, so "What's the weather like?" and "what's the
+    // weather like" are the same transcript.
+    vector<string> NormalizeWords(const string& text)
+    {
+        vector<string> words;
+        string word;
+        for (unsigned char c : text)
+        {
+            if (isalnum(c) || c == '\'' || c >= 0x80)
+            {
+                word.push_back((char)tolower(c));
+            }
+            else if (!word.empty())
+            {
+                words.push_back(word);
+                word.clear();
+            }
+        }
+        if (!word.empty())
+        {
+            words.push_back(word);
+        }
+        return words;
+    }
+
+    // Word-level edit distance: substitutions, deletions and insertions turning 'reference' into 'hypothesis'.
+    size_t WordEdits(const vector<string>& reference, const vector<string>& hypothesis)
+    {
+        vector<size_t> previous(hypothesis.size() + 1), current(hypothesis.size() + 1);
+        for (size_t j = 0; j <= hypothesis.size(); j++)
+        {
+            previous[j] = j;
+        }
+        for (size_t i = 1; i <= reference.size(); i++)
+        {
+            current[0] = i;
+            for (size_t j = 1; j <= hypothesis.size(); j++)
+            {
+                auto substitution = previous[j - 1] + (reference[i - 1] == hypothesis[j - 1] ? 0 : 1);
+                current[j] = min(substitution, min(previous[j], current[j - 1]) + 1);
+            }
+            swap(previous, current);
+        }
+        return previous[hypothesis.size()];
+    }
+
+    struct SoakSession
+    {
+        // From the time the session was due to its end, including the wait for a free slot.
+        Clock::duration Total{ 0 };
+        Clock::duration QueueDelay{ 0 };
+        // From the synthesizer lease to the first audio chunk, without recognizer start-up and the wait for the lease.
+        Clock::duration FirstAudio{ 0 };
+        // From the last audio pushed to the end of recognition.
+        Clock::duration FinalAfterAudio{ 0 };
+        vector<Clock::duration> FirstPartial;
+        size_t ReferenceWords = 0;
+        size_t Edits = 0;
+        chrono::duration<double> Audio{ 0 };
+    };
+
+    // Synthesizes 'text' and streams the audio as it arrives into a push stream recognizer, then compares the
+    // transcript with the text. Throws if either side is canceled.
+    SoakSession RunSoakSession(const shared_ptr<SpeechConfig>& config, SynthesizerLeases& synthesizers, const string& text)
+    {
+        // Raw16Khz16BitMonoPcm is the default format of push streams.
+        const uint32_t bytesPerSecond = 32000;
+
+        SoakSession session;
+        auto started = Clock::now();
+        auto pushStream = AudioInputStream::CreatePushStream();
+        RecognitionLatencyTracker tracker(bytesPerSecond);
+        promise<void> recognitionEnd;
+        once_flag endSignaled;
+        // The recognition error is set on an SDK thread, the synthesis error on this one.
+        mutex recognitionErrorMutex;
+        string recognitionError;
+        string synthesisError;
+        mutex transcriptMutex;
+        string transcript;
+
+        auto recognizer = SpeechRecognizer::FromConfig(config, AudioConfig::FromStreamInput(pushStream));
+        tracker.Attach(recognizer);
+        recognizer->Recognized.Connect([&](const SpeechRecognitionEventArgs& e)
+        {
+            if (e.Result->Reason == ResultReason::RecognizedSpeech)
+            {
+                lock_guard<mutex> lock(transcriptMutex);
+                transcript += (transcript.empty() ? "" : " ") + e.Result->Text;
+            }
+        });
+        recognizer->Canceled.Connect([&](const SpeechRecognitionCanceledEventArgs& e)
+        {
+            if (e.Reason == CancellationReason::Error)
+            {
+                {
+                    lock_guard<mutex> lock(recognitionErrorMutex);
+                    recognitionError = "Recognition canceled: " + e.ErrorDetails;
+                }
+                call_once(endSignaled, [&recognitionEnd] { recognitionEnd.set_value(); });
+            }
+        });
+        recognizer->SessionStopped.Connect([&](const SessionEventArgs&)
+        {
+            call_once(endSignaled, [&recognitionEnd] { recognitionEnd.set_value(); });
+        });
+        recognizer->StartContinuousRecognitionAsync().get();
+
+        // The audio goes from the synthesizer to the recognizer chunk by chunk, without collecting the whole utterance.
+        uint64_t bytes = 0;
+        auto synthesizer = synthesizers.Acquire();
+        auto synthesisStarted = Clock::now();
+        try
+        {
+            auto result = synthesizer->StartSpeakingTextAsync(text).get();
+            auto audioDataStream = AudioDataStream::FromResult(result);
+            vector<uint8_t> buffer(bytesPerSecond / 10);
+            uint32_t filled = 0;
+            while ((filled = audioDataStream->ReadData(buffer.data(), (uint32_t)buffer.size())) > 0)
+            {
+                if (bytes == 0)
+                {
+                    session.FirstAudio = Clock::now() - synthesisStarted;
+                }
+                pushStream->Write(buffer.data(), filled);
+                tracker.OnAudioPushed(filled);
+                bytes += filled;
+            }
+            if (audioDataStream->GetStatus() == StreamStatus::Canceled)
+            {
+                synthesisError = "Synthesis canceled: " + SpeechSynthesisCancellationDetails::FromStream(audioDataStream)->ErrorDetails;
+            }
+        }
+        catch (const exception& e)
+        {
+            synthesisError = e.what();
+        }
+        synthesizers.Release(move(synthesizer));
+        pushStream->Close();
+        auto audioEnd = Clock::now();
+
+        recognitionEnd.get_future().get();
+        recognizer->StopContinuousRecognitionAsync().get();
+        if (!synthesisError.empty())
+        {
+            throw runtime_error(synthesisError);
+        }
+        {
+            lock_guard<mutex> lock(recognitionErrorMutex);
+            if (!recognitionError.empty())
+            {
+                throw runtime_error(recognitionError);
+            }
+        }
+
+        auto end = Clock::now();
+        session.Total = end - started;
+        session.FinalAfterAudio = end - audioEnd;
+        session.FirstPartial = tracker.FirstPartialLatencies();
+        session.Audio = chrono::duration<double>((double)bytes / bytesPerSecond);
+        auto reference = NormalizeWords(text);
+        session.ReferenceWords = reference.size();
+        session.Edits = WordEdits(reference, NormalizeWords(transcript));
+        return session;
+    }
+
+    void PrintSoakUsage()
+    {
+        cout << "Usage: sample --soak [options]\n"
+                "  --key <key>           subscription key\n"
+                "  --region <region>     service region\n"
+                "  --corpus <file>       text corpus, one sentence per line (default: built-in sentences)\n"
+                "  --voice <name>        synthesis voice (default en-US-JennyNeural)\n"
+                "  --language <locale>   recognition language (default en-US)\n"
+                "  --sessions <n>        sessions to run (default 20)\n"
+                "  --duration <s>        run sessions for this many seconds instead\n"
+                "  --concurrency <n>     sessions in flight at most (default 4)\n"
+                "  --synthesizers <n>    connected synthesizers shared by the sessions (default 2)\n"
+                "  --rate <n>            sessions started per second, 0 for as fast as the concurrency allows (default 0)\n"
+                "  --output <file>       JSON report file (default soak_report.json)\n";
+    }
+
+    SoakOptions ParseSoakOptions(const vector<string>& args)
+    {
+        SoakOptions options;
+        for (size_t i = 0; i < args.size(); i++)
+        {
+            auto& name = args[i];
+            if (name == "--help" || name == "-h")
+            {
+                throw invalid_argument("");
+            }
+            if (i + 1 >= args.size())
+            {
+                throw invalid_argument("Missing value for " + name);
+            }
+
+            auto& value = args[++i];
+            if (name == "--key")
+            {
+                options.Key = value;
+            }
+            else if (name == "--region")
+            {
+                options.Region = value;
+            }
+            else if (name == "--corpus")
+            {
+                options.Corpus = value;
+            }
+            else if (name == "--voice")
+            {
+                options.Voice = value;
+            }
+            else if (name == "--language")
+            {
+                options.Language = value;
+            }
+            else if (name == "--sessions")
+            {
+                options.Sessions = (uint32_t)stoul(value);
+            }
+            else if (name == "--duration")
+            {
+                options.DurationSeconds = (uint32_t)stoul(value);
+            }
+            else if (name == "--concurrency")
+            {
+                options.Concurrency = (uint32_t)stoul(value);
+            }
+            else if (name == "--synthesizers")
+            {
+                options.Synthesizers = (uint32_t)stoul(value);
+            }
+            else if (name == "--rate")
+            {
+                options.ArrivalRate = stod(value);
+            }
+            else if (name == "--output")
+            {
+                options.Output = value;
+            }
+            else
+            {
+                throw invalid_argument("Unknown option " + name);
+            }
+        }
+        return options;
+    }
+
+    vector<string> LoadCorpus(const string& fileName)
+    {
+        if (fileName.empty())
+        {
+            return
+            {
+                "What's the weather like?",
+                "Please turn on the lights in the living room.",
+                "My flight leaves from gate twelve at half past four.",
+                "Remind me to call the dentist tomorrow morning.",
+                "The quick brown fox jumps over the lazy dog.",
+            };
+        }
+
+        ifstream file(fileName);
+        if (!file)
+        {
+            throw invalid_argument("Cannot open corpus " + fileName);
+        }
+        vector<string> sentences;
+        string line;
+        while (getline(file, line))
+        {
+            if (!NormalizeWords(line).empty())
+            {
+                sentences.push_back(line);
+            }
+        }
+        if (sentences.empty())
+        {
+            throw invalid_argument("The corpus " + fileName + " has no sentences.");
+        }
+        return sentences;
+    }
+}
+
+namespace
+{
+    struct FootprintOptions
+    {
+        string Key = "YourSubscriptionKey";
+        string Region = "YourServiceRegion";
+        vector<string> Kinds{ "recognizer", "synthesizer", "transcriber" };
+        uint32_t MaxSessions = 32;
+        // Time for threads and buffers to settle after sessions were added, before the process is measured.
+        uint32_t SettleMs = 2000;
+        // A step whose cost per added session exceeds the cost of the first step by this factor is flagged.
+        double NonLinearFactor = 1.5;
+        string Output = "footprint_report.json";
+    };
+
+    struct ProcessSample
+    {
+        uint64_t ResidentBytes = 0;
+        uint32_t Threads = 0;
+        uint32_t Handles = 0;
+    };
+
+    ProcessSample SampleProcess()
+    {
+        return { GetResidentSetSize(), GetThreadCount(), GetHandleCount() };
+    }
+
+    // Keeps active sessions busy from one thread: pushes 100 ms of silence into every registered stream every
+    // 100 ms, streaming at real time, and starts the next synthesis of every registered synthesizer whose last
+    // one has finished, so synthesizers are speaking whenever the process is measured.
+    class ActivityFeeder final
+    {
+    public:
+        ActivityFeeder() : m_thread([this] { Run(); })
+        {
+        }
+
+        ~ActivityFeeder()
+        {
+            {
+                lock_guard<mutex> lock(m_mutex);
+                m_stopping = true;
+            }
+            m_changed.notify_one();
+            m_thread.join();
+        }
+
+        void Add(const shared_ptr<PushAudioInputStream>& stream, uint32_t bytesPerSecond)
+        {
+            lock_guard<mutex> lock(m_mutex);
+            m_streams.push_back({ stream, bytesPerSecond / 10 });
+            m_silence.resize(max<size_t>(m_silence.size(), bytesPerSecond / 10));
+        }
+
+        void Add(const shared_ptr<SpeechSynthesizer>& synthesizer)
+        {
+            auto speaking = make_shared<atomic<bool>>(false);
+            auto finished = [speaking](const SpeechSynthesisEventArgs&) { *speaking = false; };
+            synthesizer->SynthesisCompleted.Connect(finished);
+            synthesizer->SynthesisCanceled.Connect(finished);
+            lock_guard<mutex> lock(m_mutex);
+            m_synthesizers.push_back({ synthesizer, speaking, {} });
+        }
+
+    private:
+        struct Target
+        {
+            weak_ptr<PushAudioInputStream> Stream;
+            uint32_t ChunkSize;
+        };
+
+        struct SpeakingTarget
+        {
+            weak_ptr<SpeechSynthesizer> Synthesizer;
+            shared_ptr<atomic<bool>> Speaking;
+            // Kept so that starting a synthesis does not wait for it, the result is not used.
+            future<shared_ptr<SpeechSynthesisResult>> Started;
+        };
+
+        void Run()
+        {
+            unique_lock<mutex> lock(m_mutex);
+            auto next = Clock::now();
+            while (!m_stopping)
+            {
+                for (auto& target : m_streams)
+                {
+                    if (auto stream = target.Stream.lock())
+                    {
+                        stream->Write(m_silence.data(), target.ChunkSize);
+                    }
+                }
+                for (auto& target : m_synthesizers)
+                {
+                    auto synthesizer = target.Synthesizer.lock();
+                    if (synthesizer && !target.Speaking->exchange(true))
+                    {
+                        target.Started = synthesizer->StartSpeakingTextAsync(
+                            "This session stays busy while the benchmark measures the footprint of the process. "
+                            "The audio is synthesized again as soon as it is complete, and nobody reads it.");
+                    }
+                }
+                next += chrono::milliseconds(100);
+                m_changed.wait_until(lock, next, [this] { return m_stopping; });
+            }
+        }
+
+        mutex m_mutex;
+        condition_variable m_changed;
+        vector<Target> m_streams;
+        vector<SpeakingTarget> m_synthesizers;
+        vector<uint8_t> m_silence;
+        bool m_stopping = false;
+        thread m_thread;
+    };
+
+    // A session kept alive for the measurement; 'Stop' ends it before it is released.
+    struct FootprintSession
+    {
+        shared_ptr<void> Object;
+        function<void()> Stop;
+    };
+
+    // Creates one session of 'kind', idle (created, nothing started) or active (connected and streaming or speaking).
+    // The feeder must be destroyed before an active session is stopped, so it does not restart it.
+    FootprintSession CreateFootprintSession(const string& kind, bool active, const shared_ptr<SpeechConfig>& config, ActivityFeeder& feeder)
+    {
+        FootprintSession session;
+        if (kind == "recognizer")
+        {
+            auto pushStream = AudioInputStream::CreatePushStream();
+            auto recognizer = SpeechRecognizer::FromConfig(config, AudioConfig::FromStreamInput(pushStream));
+            if (active)
+            {
+                recognizer->StartContinuousRecognitionAsync().get();
+                feeder.Add(pushStream, 32000);
+                session.Stop = [recognizer, pushStream] { pushStream->Close(); recognizer->StopContinuousRecognitionAsync().get(); };
+            }
+            session.Object = recognizer;
+        }
+        else if (kind == "synthesizer")
+        {
+            auto synthesizer = SpeechSynthesizer::FromConfig(config, nullptr);
+            if (active)
+            {
+                // Connected, and synthesizing again and again from the feeder.
+                Connection::FromSpeechSynthesizer(synthesizer)->Open(false);
+                feeder.Add(synthesizer);
+                session.Stop = [synthesizer] { synthesizer->StopSpeakingAsync().get(); };
+            }
+            session.Object = synthesizer;
+        }
+        else
+        {
+            // Conversation transcription takes 8 channels of audio.
+            auto pushStream = AudioInputStream::CreatePushStream(AudioStreamFormat::GetWaveFormatPCM(16000, 16, 8));
+            auto conversation = Conversation::CreateConversationAsync(config).get();
+            auto transcriber = ConversationTranscriber::FromConfig(AudioConfig::FromStreamInput(pushStream));
+            transcriber->JoinConversationAsync(conversation).get();
+            if (active)
+            {
+                transcriber->StartTranscribingAsync().get();
+                feeder.Add(pushStream, 16000 * 2 * 8);
+                session.Stop = [transcriber, pushStream] { pushStream->Close(); transcriber->StopTranscribingAsync().get(); };
+            }
+            session.Object = make_shared<pair<shared_ptr<Conversation>, shared_ptr<ConversationTranscriber>>>(conversation, transcriber);
+        }
+        return session;
+    }
+
+    // Stops an active session; returns the error instead of throwing, so the other sessions are still stopped.
+    string StopFootprintSession(FootprintSession& session)
+    {
+        try
+        {
+            if (session.Stop)
+            {
+                session.Stop();
+            }
+            return "";
+        }
+        catch (const exception& e)
+        {
+            return e.what();
+        }
+    }
+
+    // Ramps the sessions of one kind up through 1, 2, 4, ... 'MaxSessions' and measures the process at each step.
+    // The cost of a step is what it added divided by the sessions it added, so a linear footprint has the same
+    // cost at every step.
+    nlohmann::json RunFootprintRamp(const string& kind, bool active, const FootprintOptions& options)
+    {
+        auto config = SpeechConfig::FromSubscription(options.Key, options.Region);
+        if (kind == "transcriber")
+        {
+            config->SetProperty("ConversationTranscriptionInRoomAndOnline", "true");
+        }
+
+        nlohmann::json report;
+        report["kind"] = kind;
+        report["state"] = active ? "active" : "idle";
+        auto steps = nlohmann::json::array();
+        vector<string> flags;
+
+        vector<FootprintSession> sessions;
+        string error;
+        string stopError;
+        {
+            // The first session of a process loads the SDK libraries and the first one of a kind opens its first
+            // connection. A warm-up session pays for that before the baseline, so the first step measures only
+            // what a session costs and is comparable with the later steps.
+            try
+            {
+                auto warmUpFeeder = make_unique<ActivityFeeder>();
+                auto warmUp = CreateFootprintSession(kind, active, config, *warmUpFeeder);
+                this_thread::sleep_for(chrono::milliseconds(options.SettleMs));
+                warmUpFeeder.reset();
+                stopError = StopFootprintSession(warmUp);
+            }
+            catch (const exception& e)
+            {
+                error = e.what();
+            }
+
+            auto feeder = make_unique<ActivityFeeder>();
+            this_thread::sleep_for(chrono::milliseconds(options.SettleMs));
+            auto baseline = SampleProcess();
+            report["baseline"] = { { "residentBytes", baseline.ResidentBytes }, { "threads", baseline.Threads }, { "handles", baseline.Handles } };
+
+            auto previous = baseline;
+            double firstBytesPerSession = 0;
+            for (uint32_t target = 1; target <= options.MaxSessions && error.empty(); target = target < options.MaxSessions ? min(target * 2, options.MaxSessions) : target + 1)
+            {
+                auto added = target - (uint32_t)sessions.size();
+                try
+                {
+                    while (sessions.size() < target)
+                    {
+                        sessions.push_back(CreateFootprintSession(kind, active, config, *feeder));
+                    }
+                }
+                catch (const exception& e)
+                {
+                    error = e.what();
+                    break;
+                }
+                this_thread::sleep_for(chrono::milliseconds(options.SettleMs));
+
+                auto sample = SampleProcess();
+                auto bytesPerSession = ((double)sample.ResidentBytes - (double)previous.ResidentBytes) / added;
+                auto threadsPerSession = ((double)sample.Threads - (double)previous.Threads) / added;
+                auto handlesPerSession = ((double)sample.Handles - (double)previous.Handles) / added;
+                if (steps.empty())
+                {
+                    firstBytesPerSession = bytesPerSession;
+                }
+                auto nonLinear = steps.size() > 0 && firstBytesPerSession > 0 && bytesPerSession > firstBytesPerSession * options.NonLinearFactor;
+
+                steps.push_back({
+                    { "sessions", target },
+                    { "residentBytes", sample.ResidentBytes },
+                    { "threads", sample.Threads },
+                    { "handles", sample.Handles },
+                    { "residentBytesPerAddedSession", bytesPerSession },
+                    { "threadsPerAddedSession", threadsPerSession },
+                    { "handlesPerAddedSession", handlesPerSession },
+                    { "nonLinear", nonLinear },
+                });
+                cout << "  " << kind << " " << (active ? "active" : "idle") << " x" << target << ": rss=" << sample.ResidentBytes / 1024 << " KB threads="
+                     << sample.Threads << " handles=" << sample.Handles << (nonLinear ? "  <- non-linear" : "") << endl;
+                if (nonLinear)
+                {
+                    flags.push_back("memory per session grows at " + to_string(target) + " sessions");
+                }
+                previous = sample;
+            }
+
+            // No more audio or syntheses once the sessions are being stopped.
+            feeder.reset();
+            for (auto& session : sessions)
+            {
+                auto sessionError = StopFootprintSession(session);
+                if (stopError.empty())
+                {
+                    stopError = sessionError;
+                }
+            }
+            sessions.clear();
+        }
+
+        // A session that cannot be stopped cleanly is noted, the measurements taken before are still valid.
+        if (!stopError.empty())
+        {
+            flags.push_back("stopping a session failed: " + stopError);
+        }
+
+        // A thread or more per session, sustained over the ramp, limits density long before memory does.
+        if (steps.size() > 1)
+        {
+            auto& last = steps.back();
+            auto threadsPerSession = ((double)last["threads"].get<uint32_t>() - report["baseline"]["threads"].get<uint32_t>()) / last["sessions"].get<uint32_t>();
+            report["threadsPerSession"] = threadsPerSession;
+            report["residentBytesPerSession"] = ((double)last["residentBytes"].get<uint64_t>() - report["baseline"]["residentBytes"].get<uint64_t>()) / last["sessions"].get<uint32_t>();
+            if (threadsPerSession >= 1)
+            {
+                flags.push_back("about " + to_string((int)(threadsPerSession + 0.5)) + " thread(s) per session");
+            }
+        }
+        report["steps"] = steps;
+        report["flags"] = flags;
+        if (!error.empty())
+        {
+            report["error"] = error;
+        }
+        return report;
+    }
+
+    void PrintFootprintUsage()
+    {
+        cout << "Usage: sample --footprint [options]\n"
+                "  --key <key>           subscription key\n"
+                "  --region <region>     service region\n"
+                "  --kinds <list>        comma-separated session kinds (default recognizer,synthesizer,transcriber)\n"
+                "  --max-sessions <n>    sessions at the last step of each ramp (default 32)\n"
+                "  --settle <ms>         wait after each step before measuring (default 2000)\n"
+                "  --nonlinear <factor>  flag steps costing this much more per session than the first (default 1.5)\n"
+                "  --output <file>       JSON report file (default footprint_report.json)\n";
+    }
+
+    FootprintOptions ParseFootprintOptions(const vector<string>& args)
+    {
+        FootprintOptions options;
+        for (size_t i = 0; i < args.size(); i++)
+        {
+            auto& name = args[i];
+            if (name == "--help" || name == "-h")
+            {
+                throw invalid_argument("");
+            }
+            if (i + 1 >= args.size())
+            {
+                throw invalid_argument("Missing value for " + name);
+            }
+
+            auto& value = args[++i];
+            if (name == "--key")
+            {
+                options.Key = value;
+            }
+            else if (name == "--region")
+            {
+                options.Region = value;
+            }
+            else if (name == "--kinds")
+            {
+                options.Kinds = SplitList(value);
+            }
+            else if (name == "--max-sessions")
+            {
+                options.MaxSessions = max<uint32_t>(1, (uint32_t)stoul(value));
+            }
+            else if (name == "--settle")
+            {
+                options.SettleMs = (uint32_t)stoul(value);
+            }
+            else if (name == "--nonlinear")
+            {
+                options.NonLinearFactor = stod(value);
+            }
+            else if (name == "--output")
+            {
+                options.Output = value;
+            }
+            else
+            {
+                throw invalid_argument("Unknown option " + name);
+            }
+        }
+
+        for (auto& kind : options.Kinds)
+        {
+            if (kind != "recognizer" && kind != "synthesizer" && kind != "transcriber")
+            {
+                throw invalid_argument("Unknown session kind " + kind);
+            }
+        }
+        return options;
+    }
+}
+
+// Runs the selected scenarios without user interaction and writes a JSON report.
+// The audio of the recognition scenarios is loaded into an AudioCorpusArena up front, and replayed from memory.
+// Returns the process exit code: 0 if all iterations succeeded, 1 if any failed, 2 on invalid arguments.
+int RunBenchmark(const vector<string>& args)
+{
+    BenchmarkOptions options;
+    try
+    {
+        options = ParseBenchmarkOptions(args);
+    }
+    catch (const exception& e)
+    {
+        if (*e.what() != '\0')
+        {
+            cout << e.what() << endl;
+        }
+        PrintBenchmarkUsage();
+        return 2;
+    }
+
+    // Only the files the scenarios read are loaded; the others may not exist.
+    vector<string> files;
+    for (auto& name : options.Scenarios)
+    {
+        auto& file = name.compare(0, 4, "mas-") == 0 ? options.MasAudioFile : options.AudioFile;
+        if ((name == "pull" || name == "push" || name.compare(0, 4, "mas-") == 0) && find(files.begin(), files.end(), file) == files.end())
+        {
+            files.push_back(file);
+        }
+    }
+    try
+    {
+        options.Corpus = make_shared<AudioCorpusArena>(files);
+    }
+    catch (const exception& e)
+    {
+        cout << "Cannot load the audio: " << e.what() << endl;
+        return 2;
+    }
+
+    nlohmann::json report;
+    report["scenarios"] = nlohmann::json::array();
+    report["corpusBytes"] = options.Corpus->Capacity();
+    report["corpusLocked"] = options.Corpus->Lock();
+    bool failed = false;
+    nlohmann::json masBaseline;
+
+    for (auto& name : options.Scenarios)
+    {
+        cout << "Running " << name << ": " << options.Iterations << " iterations, concurrency " << options.Concurrency << "..." << endl;
+        auto scenarioReport = RunScenario(name, GetScenarios().at(name), options);
+        cout << "  succeeded=" << scenarioReport["succeeded"] << " failed=" << scenarioReport["failed"]
+             << " throughput=" << scenarioReport["throughputPerSecond"] << "/s";
+        if (scenarioReport.contains("cpuMsPerAudioSecond"))
+        {
+            cout << " cpuMsPerAudioSecond=" << scenarioReport["cpuMsPerAudioSecond"] << " streamsPerCore=" << scenarioReport["streamsPerCore"];
+        }
+        cout << endl;
+
+        // What MAS adds over recognizing one channel without it.
+        if (name == "mas-none")
+        {
+            masBaseline = scenarioReport;
+        }
+        else if (name.compare(0, 4, "mas-") == 0 && masBaseline.contains("cpuMsPerAudioSecond") && scenarioReport.contains("cpuMsPerAudioSecond"))
+        {
+            nlohmann::json added;
+            added["cpuMsPerAudioSecond"] = scenarioReport["cpuMsPerAudioSecond"].get<double>() - masBaseline["cpuMsPerAudioSecond"].get<double>();
+            if (masBaseline["firstResponseLatency"].contains("p50Ms") && scenarioReport["firstResponseLatency"].contains("p50Ms"))
+            {
+                added["firstResponseP50Ms"] = scenarioReport["firstResponseLatency"]["p50Ms"].get<double>() - masBaseline["firstResponseLatency"]["p50Ms"].get<double>();
+            }
+            scenarioReport["addedOverMasNone"] = added;
+        }
+
+        failed = failed || scenarioReport["failed"].get<size_t>() > 0;
+        report["scenarios"].push_back(scenarioReport);
+    }
+    report["peakResidentSetBytes"] = GetPeakResidentSetSize();
+
+    ofstream output(options.Output, ios_base::out | ios_base::trunc);
+    output << report.dump(2) << endl;
+    cout << "Report written to " << options.Output << endl;
+
+    return failed ? 1 : 0;
+}
+
+// Synthesizes a text corpus and recognizes the synthesized audio right away, as a closed loop that needs no recorded
+// audio. Sessions start at a fixed rate or back to back, with at most 'Concurrency' in flight, and the report has the
+// throughput, latency percentiles and the word error rate of the transcripts against the corpus.
+// Returns the process exit code like RunBenchmark().
+int RunSoakTest(const vector<string>& args)
+{
+    SoakOptions options;
+    vector<string> corpus;
+    try
+    {
+        options = ParseSoakOptions(args);
+        corpus = LoadCorpus(options.Corpus);
+    }
+    catch (const exception& e)
+    {
+        if (*e.what() != '\0')
+        {
+            cout << e.what() << endl;
+        }
+        PrintSoakUsage();
+        return 2;
+    }
+
+    auto config = SpeechConfig::FromSubscription(options.Key, options.Region);
+    config->SetSpeechRecognitionLanguage(options.Language);
+    config->SetSpeechSynthesisVoiceName(options.Voice);
+    config->SetSpeechSynthesisOutputFormat(SpeechSynthesisOutputFormat::Raw16Khz16BitMonoPcm);
+
+    unique_ptr<SynthesizerLeases> synthesizers;
+    try
+    {
+        synthesizers = make_unique<SynthesizerLeases>(config, options.Synthesizers);
+    }
+    catch (const exception& e)
+    {
+        cout << e.what() << endl;
+        return 1;
+    }
+
+    atomic<uint64_t> nextSession{ 0 };
+    mutex resultMutex;
+    vector<Clock::duration> totals, queueDelays, firstAudio, firstPartials, finalAfterAudio;
+    size_t referenceWords = 0, edits = 0;
+    chrono::duration<double> audio{ 0 };
+    vector<string> errors;
+
+    auto started = Clock::now();
+    auto deadline = started + chrono::seconds(options.DurationSeconds);
+    auto cpuStarted = GetProcessCpuTime();
+    auto worker = [&]()
+    {
+        for (;;)
+        {
+            auto index = nextSession++;
+            // Session 'index' is due 'index / rate' after the start; it waits for a free worker when all are busy.
+            auto due = options.ArrivalRate > 0
+                ? started + chrono::duration_cast<Clock::duration>(chrono::duration<double>(index / options.ArrivalRate))
+                : Clock::now();
+            if (options.DurationSeconds > 0 ? due >= deadline : index >= options.Sessions)
+            {
+                return;
+            }
+            this_thread::sleep_until(due);
+
+            auto queueDelay = Clock::now() - due;
+            try
+            {
+                auto session = RunSoakSession(config, *synthesizers, corpus[index % corpus.size()]);
+                lock_guard<mutex> lock(resultMutex);
+                totals.push_back(session.Total + queueDelay);
+                queueDelays.push_back(queueDelay);
+                firstAudio.push_back(session.FirstAudio);
+                firstPartials.insert(firstPartials.end(), session.FirstPartial.begin(), session.FirstPartial.end());
+                finalAfterAudio.push_back(session.FinalAfterAudio);
+                referenceWords += session.ReferenceWords;
+                edits += session.Edits;
+                audio += session.Audio;
+                if (totals.size() % 10 == 0)
+                {
+                    cout << "  " << totals.size() << " sessions, WER " << (double)edits / max<size_t>(1, referenceWords) << endl;
+                }
+            }
+            catch (const exception& e)
+            {
+                lock_guard<mutex> lock(resultMutex);
+                errors.push_back(e.what());
+            }
+        }
+    };
+
+    cout << "Soak test: concurrency " << options.Concurrency << ", " << options.Synthesizers << " synthesizers, "
+         << (options.ArrivalRate > 0 ? to_string(options.ArrivalRate) + " sessions/s" : string("back to back")) << "..." << endl;
+    vector<thread> workers;
+    for (uint32_t i = 0; i < max<uint32_t>(1, options.Concurrency); i++)
+    {
+        workers.emplace_back(worker);
+    }
+    for (auto& t : workers)
+    {
+        t.join();
+    }
+    auto wallTime = Clock::now() - started;
+    auto cpuTime = GetProcessCpuTime() - cpuStarted;
+
+    nlohmann::json report;
+    report["concurrency"] = options.Concurrency;
+    report["synthesizers"] = options.Synthesizers;
+    report["arrivalRatePerSecond"] = options.ArrivalRate;
+    report["succeeded"] = totals.size();
+    report["failed"] = errors.size();
+    report["wallTimeMs"] = ToMilliseconds(wallTime);
+    report["throughputPerSecond"] = totals.size() / max(chrono::duration<double>(wallTime).count(), 1e-9);
+    report["audioSeconds"] = audio.count();
+    report["realTimeFactor"] = audio.count() / max(chrono::duration<double>(wallTime).count(), 1e-9);
+    report["cpuMs"] = cpuTime.count() / 1000.0;
+    report["referenceWords"] = referenceWords;
+    report["wordErrors"] = edits;
+    report["wordErrorRate"] = (double)edits / max<size_t>(1, referenceWords);
+    report["latency"] = Summarize(totals);
+    report["queueDelay"] = Summarize(queueDelays);
+    report["firstAudioLatency"] = Summarize(firstAudio);
+    report["firstPartialLatency"] = Summarize(firstPartials);
+    report["finalAfterAudioLatency"] = Summarize(finalAfterAudio);
+    report["peakResidentSetBytes"] = GetPeakResidentSetSize();
+    sort(errors.begin(), errors.end());
+    errors.erase(unique(errors.begin(), errors.end()), errors.end());
+    report["errors"] = errors;
+
+    cout << "  succeeded=" << report["succeeded"] << " failed=" << report["failed"] << " throughput=" << report["throughputPerSecond"]
+         << "/s WER=" << report["wordErrorRate"] << endl;
+    ofstream output(options.Output, ios_base::out | ios_base::trunc);
+    output << report.dump(2) << endl;
+    cout << "Report written to " << options.Output << endl;
+
+    return errors.empty() ? 0 : 1;
+}
+
+// Ramps idle and active sessions of each kind from 1 to 'MaxSessions' and records the resident set, threads and
+// handles of the process at each step, to show what a session costs and where the cost stops being linear.
+// Returns the process exit code like RunBenchmark().
+int RunFootprintBenchmark(const vector<string>& args)
+{
+    FootprintOptions options;
+    try
+    {
+        options = ParseFootprintOptions(args);
+    }
+    catch (const exception& e)
+    {
+        if (*e.what() != '\0')
+        {
+            cout << e.what() << endl;
+        }
+        PrintFootprintUsage();
+        return 2;
+    }
+
+    nlohmann::json report;
+    report["ramps"] = nlohmann::json::array();
+    bool failed = false;
+    for (auto& kind : options.Kinds)
+    {
+        for (auto active : { false, true })
+        {
+            cout << "Ramping " << kind << (active ? " active" : " idle") << " sessions to " << options.MaxSessions << "..." << endl;
+            auto ramp = RunFootprintRamp(kind, active, options);
+            failed = failed || ramp.contains("error");
+            for (auto& flag : ramp["flags"])
+            {
+                cout << "  FLAG: " << flag.get<string>() << endl;
+            }
+            report["ramps"].push_back(ramp);
+        }
+    }
+    report["peakResidentSetBytes"] = GetPeakResidentSetSize();
+
+    ofstream output(options.Output, ios_base::out | ios_base::trunc);
+    output << report.dump(2) << endl;
+    cout << "Report written to " << options.Output << endl;
+
+    return failed ? 1 : 0;
+}
+
+namespace
+{
+    struct SweepOptions
+    {
+        string Key = "YourSubscriptionKey";
+        string Region = "YourServiceRegion";
+        string Language = "en-US";
+        // One "<wav file><tab><reference transcript>" per line; the built-in pair is used when empty.
+        string Corpus;
+        // Values to try for each setting; "default" leaves the setting to the service.
+        vector<string> SegmentationSilenceTimeouts{ "default", "300", "600", "1000" };
+        vector<string> EndSilenceTimeouts{ "default", "500", "1500" };
+        vector<string> StablePartialThresholds{ "default", "2", "5" };
+        // "none" recognizes in 'Language' without language identification.
+        vector<string> LanguageIdPriorities{ "none" };
+        vector<string> LanguageIdLanguages{ "en-US", "de-DE" };
+        uint32_t Repetitions = 1;
+        string Output = "sweep_report.json";
+    };
+
+    struct SweepConfiguration
+    {
+        string SegmentationSilenceTimeout;
+        string EndSilenceTimeout;
+        string StablePartialThreshold;
+        string LanguageIdPriority;
+
+        string Describe() const
+        {
+            return "segmentation=" + SegmentationSilenceTimeout + " endSilence=" + EndSilenceTimeout +
+                " stablePartial=" + StablePartialThreshold + " lid=" + LanguageIdPriority;
+        }
+    };
+
+    struct SweepRun
+    {
+        // Time from the end of each utterance in the audio to its final result.
+        vector<Clock::duration> FinalLatencies;
+        size_t Partials = 0;
+        // Words of a partial that the next partial of the same utterance changed or dropped.
+        size_t RevisedWords = 0;
+        size_t FinalWords = 0;
+        size_t ReferenceWords = 0;
+        size_t Edits = 0;
+    };
+
+    // Recognizes one corpus entry, pushed at the pace of a live source so that the latency of the final results is
+    // what a user would see, and measures latency, partial churn and word errors.
+    SweepRun RunSweepEntry(const SweepOptions& options, const SweepConfiguration& configuration, const AudioCorpusArena& corpus, size_t index, const string& reference)
+    {
+        const auto lid = configuration.LanguageIdPriority != "none";
+        // Continuous language identification needs the v2 endpoint.
+        auto config = lid
+            ? SpeechConfig::FromEndpoint("wss://" + options.Region + ".stt.speech.microsoft.com/speech/universal/v2", options.Key)
+            : SpeechConfig::FromSubscription(options.Key, options.Region);
+        if (configuration.SegmentationSilenceTimeout != "default")
+        {
+            config->SetProperty(PropertyId::Speech_SegmentationSilenceTimeoutMs, configuration.SegmentationSilenceTimeout);
+        }
+        if (configuration.EndSilenceTimeout != "default")
+        {
+            config->SetProperty(PropertyId::SpeechServiceConnection_EndSilenceTimeoutMs, configuration.EndSilenceTimeout);
+        }
+        if (configuration.StablePartialThreshold != "default")
+        {
+            config->SetProperty(PropertyId::SpeechServiceResponse_StablePartialResultThreshold, configuration.StablePartialThreshold);
+        }
+
+        const auto& format = corpus.GetEntry(index).Format;
+        auto pushStream = AudioInputStream::CreatePushStream(corpus.CreateFormat(index));
+        auto audioInput = AudioConfig::FromStreamInput(pushStream);
+        shared_ptr<SpeechRecognizer> recognizer;
+        if (lid)
+        {
+            config->SetProperty(PropertyId::SpeechServiceConnection_ContinuousLanguageIdPriority, configuration.LanguageIdPriority);
+            recognizer = SpeechRecognizer::FromConfig(config, AutoDetectSourceLanguageConfig::FromLanguages(options.LanguageIdLanguages), audioInput);
+        }
+        else
+        {
+            config->SetSpeechRecognitionLanguage(options.Language);
+            recognizer = SpeechRecognizer::FromConfig(config, audioInput);
+        }
+
+        SweepRun run;
+        PacedPushWriter writer(pushStream, format, 1.0);
+        mutex runMutex;
+        vector<string> previousPartial;
+        string transcript;
+        promise<void> recognitionEnd;
+        once_flag endSignaled;
+        // Set on an SDK thread, read here once recognition has ended.
+        mutex errorMutex;
+        string error;
+
+        recognizer->Recognizing.Connect([&](const SpeechRecognitionEventArgs& e)
+        {
+            auto words = NormalizeWords(e.Result->Text);
+            lock_guard<mutex> lock(runMutex);
+            run.Partials++;
+            size_t kept = 0;
+            while (kept < previousPartial.size() && kept < words.size() && previousPartial[kept] == words[kept])
+            {
+                kept++;
+            }
+            run.RevisedWords += previousPartial.size() - kept;
+            previousPartial = move(words);
+        });
+        recognizer->Recognized.Connect([&](const SpeechRecognitionEventArgs& e)
+        {
+            auto now = Clock::now();
+            if (e.Result->Reason != ResultReason::RecognizedSpeech)
+            {
+                return;
+            }
+            lock_guard<mutex> lock(runMutex);
+            // With the audio paced in real time, the end of the utterance was written this long after the first byte.
+            auto utteranceEnd = writer.StartTime() + chrono::duration_cast<Clock::duration>(chrono::nanoseconds((e.Result->Offset() + e.Result->Duration()) * 100));
+            run.FinalLatencies.push_back(now - utteranceEnd);
+            // The final result is the last version of the partials; words it changed are churn as well.
+            auto words = NormalizeWords(e.Result->Text);
+            size_t kept = 0;
+            while (kept < previousPartial.size() && kept < words.size() && previousPartial[kept] == words[kept])
+            {
+                kept++;
+            }
+            run.RevisedWords += previousPartial.size() - kept;
+            previousPartial.clear();
+            run.FinalWords += words.size();
+            transcript += (transcript.empty() ? "" : " ") + e.Result->Text;
+        });
+        recognizer->Canceled.Connect([&](const SpeechRecognitionCanceledEventArgs& e)
+        {
+            if (e.Reason == CancellationReason::Error)
+            {
+                {
+                    lock_guard<mutex> lock(errorMutex);
+                    error = "Recognition canceled: " + e.ErrorDetails;
+                }
+                call_once(endSignaled, [&recognitionEnd] { recognitionEnd.set_value(); });
+            }
+        });
+        recognizer->SessionStopped.Connect([&](const SessionEventArgs&)
+        {
+            call_once(endSignaled, [&recognitionEnd] { recognitionEnd.set_value(); });
+        });
+
+        recognizer->StartContinuousRecognitionAsync().get();
+        auto chunkSize = AudioChunkPool::ChunkSizeFor(format);
+        auto data = corpus.Data(index);
+        auto size = corpus.GetEntry(index).Size;
+        for (uint32_t position = 0; position < size; position += chunkSize)
+        {
+            writer.Write(data + position, min(chunkSize, size - position));
+        }
+        pushStream->Close();
+        recognitionEnd.get_future().get();
+        recognizer->StopContinuousRecognitionAsync().get();
+        {
+            lock_guard<mutex> lock(errorMutex);
+            if (!error.empty())
+            {
+                throw runtime_error(error);
+            }
+        }
+
+        auto referenceWords = NormalizeWords(reference);
+        run.ReferenceWords = referenceWords.size();
+        run.Edits = WordEdits(referenceWords, NormalizeWords(transcript));
+        return run;
+    }
+
+    vector<SweepConfiguration> SweepGrid(const SweepOptions& options)
+    {
+        vector<SweepConfiguration> grid;
+        for (auto& segmentation : options.SegmentationSilenceTimeouts)
+        {
+            for (auto& endSilence : options.EndSilenceTimeouts)
+            {
+                for (auto& stablePartial : options.StablePartialThresholds)
+                {
+                    for (auto& priority : options.LanguageIdPriorities)
+                    {
+                        grid.push_back({ segmentation, endSilence, stablePartial, priority });
+                    }
+                }
+            }
+        }
+        return grid;
+    }
+
+    // Reads "<wav file><tab><reference transcript>" lines.
+    vector<pair<string, string>> LoadSweepCorpus(const string& fileName)
+    {
+        if (fileName.empty())
+        {
+            return { { "whatstheweatherlike.wav", "What's the weather like?" } };
+        }
+
+        ifstream file(fileName);
+        if (!file)
+        {
+            throw invalid_argument("Cannot open corpus " + fileName);
+        }
+        vector<pair<string, string>> entries;
+        string line;
+        while (getline(file, line))
+        {
+            auto tab = line.find('\t');
+            if (tab != string::npos && !NormalizeWords(line.substr(tab + 1)).empty())
+            {
+                entries.emplace_back(line.substr(0, tab), line.substr(tab + 1));
+            }
+        }
+        if (entries.empty())
+        {
+            throw invalid_argument("The corpus " + fileName + " has no \"<wav file><tab><transcript>\" lines.");
+        }
+        return entries;
+    }
+
+    void PrintSweepUsage()
+    {
+        cout << "Usage: sample --sweep [options]\n"
+                "  --key <key>                  subscription key\n"
+                "  --region <region>            service region\n"
+                "  --language <language>        recognition language without language identification (default en-US)\n"
+                "  --corpus <file>              lines of \"<wav file><tab><reference transcript>\"\n"
+                "                               (default whatstheweatherlike.wav)\n"
+                "  --segmentation <list>        Speech_SegmentationSilenceTimeoutMs values (default default,300,600,1000)\n"
+                "  --end-silence <list>         SpeechServiceConnection_EndSilenceTimeoutMs values (default default,500,1500)\n"
+                "  --stable-partial <list>      SpeechServiceResponse_StablePartialResultThreshold values (default default,2,5)\n"
+                "  --lid-priority <list>        none, Latency or Accuracy for continuous language identification (default none)\n"
+                "  --lid-languages <list>       candidate languages for language identification (default en-US,de-DE)\n"
+                "  --repetitions <n>            runs of the corpus per configuration (default 1)\n"
+                "  --output <file>              JSON report file (default sweep_report.json)\n"
+                "\"default\" leaves a setting to the service. Audio is pushed in real time, so a sweep takes\n"
+                "configurations x repetitions x the length of the corpus.\n";
+    }
+
+    SweepOptions ParseSweepOptions(const vector<string>& args)
+    {
+        SweepOptions options;
+        for (size_t i = 0; i < args.size(); i++)
+        {
+            auto& name = args[i];
+            if (name == "--help" || name == "-h")
+            {
+                throw invalid_argument("");
+            }
+            if (i + 1 >= args.size())
+            {
+                throw invalid_argument("Missing value for " + name);
+            }
+
+            auto& value = args[++i];
+            if (name == "--key")
+            {
+                options.Key = value;
+            }
+            else if (name == "--region")
+            {
+                options.Region = value;
+            }
+            else if (name == "--language")
+            {
+                options.Language = value;
+            }
+            else if (name == "--corpus")
+            {
+                options.Corpus = value;
+            }
+            else if (name == "--segmentation")
+            {
+                options.SegmentationSilenceTimeouts = SplitList(value);
+            }
+            else if (name == "--end-silence")
+            {
+                options.EndSilenceTimeouts = SplitList(value);
+            }
+            else if (name == "--stable-partial")
+            {
+                options.StablePartialThresholds = SplitList(value);
+            }
+            else if (name == "--lid-priority")
+            {
+                options.LanguageIdPriorities = SplitList(value);
+            }
+            else if (name == "--lid-languages")
+            {
+                options.LanguageIdLanguages = SplitList(value);
+            }
+            else if (name == "--repetitions")
+            {
+                options.Repetitions = (uint32_t)stoul(value);
+            }
+            else if (name == "--output")
+            {
+                options.Output = value;
+            }
+            else
+            {
+                throw invalid_argument("Unknown option " + name);
+            }
+        }
+        for (auto* list : { &options.SegmentationSilenceTimeouts, &options.EndSilenceTimeouts, &options.StablePartialThresholds, &options.LanguageIdPriorities })
+        {
+            if (list->empty())
+            {
+                throw invalid_argument("Every swept setting needs at least one value.");
+            }
+        }
+        return options;
+    }
+}
+
+// Replays a corpus through continuous recognition for every combination of the segmentation silence timeout, the
+// end silence timeout, the stable partial threshold and the language identification priority, and reports the
+// final-result latency, partial churn and word error rate of each. Configurations that no other one beats on both
+// the median latency and the WER are marked as Pareto optimal.
+// Returns the process exit code like RunBenchmark().
+int RunParameterSweep(const vector<string>& args)
+{
+    SweepOptions options;
+    vector<pair<string, string>> entries;
+    shared_ptr<AudioCorpusArena> corpus;
+    try
+    {
+        options = ParseSweepOptions(args);
+        entries = LoadSweepCorpus(options.Corpus);
+        vector<string> files;
+        for (auto& entry : entries)
+        {
+            if (find(files.begin(), files.end(), entry.first) == files.end())
+            {
+                files.push_back(entry.first);
+            }
+        }
+        corpus = make_shared<AudioCorpusArena>(files);
+    }
+    catch (const exception& e)
+    {
+        if (*e.what() != '\0')
+        {
+            cout << e.what() << endl;
+        }
+        PrintSweepUsage();
+        return 2;
+    }
+
+    struct Point
+    {
+        double LatencyMs;
+        double WordErrorRate;
+    };
+    vector<Point> points;
+    nlohmann::json report;
+    report["configurations"] = nlohmann::json::array();
+    bool failed = false;
+
+    for (auto& configuration : SweepGrid(options))
+    {
+        cout << "Running " << configuration.Describe() << "..." << endl;
+        SweepRun total;
+        vector<string> errors;
+        for (uint32_t repetition = 0; repetition < max<uint32_t>(1, options.Repetitions); repetition++)
+        {
+            for (auto& entry : entries)
+            {
+                try
+                {
+                    auto run = RunSweepEntry(options, configuration, *corpus, corpus->Find(entry.first), entry.second);
+                    total.FinalLatencies.insert(total.FinalLatencies.end(), run.FinalLatencies.begin(), run.FinalLatencies.end());
+                    total.Partials += run.Partials;
+                    total.RevisedWords += run.RevisedWords;
+                    total.FinalWords += run.FinalWords;
+                    total.ReferenceWords += run.ReferenceWords;
+                    total.Edits += run.Edits;
+                }
+                catch (const exception& e)
+                {
+                    errors.push_back(e.what());
+                }
+            }
+        }
+
+        nlohmann::json result;
+        result["segmentationSilenceTimeoutMs"] = configuration.SegmentationSilenceTimeout;
+        result["endSilenceTimeoutMs"] = configuration.EndSilenceTimeout;
+        result["stablePartialResultThreshold"] = configuration.StablePartialThreshold;
+        result["languageIdPriority"] = configuration.LanguageIdPriority;
+        result["finalLatency"] = Summarize(total.FinalLatencies);
+        result["partials"] = total.Partials;
+        result["revisedPartialWords"] = total.RevisedWords;
+        // Revised words per word of the final transcript.
+        result["partialChurn"] = (double)total.RevisedWords / max<size_t>(1, total.FinalWords);
+        result["referenceWords"] = total.ReferenceWords;
+        result["wordErrors"] = total.Edits;
+        result["wordErrorRate"] = (double)total.Edits / max<size_t>(1, total.ReferenceWords);
+        result["failed"] = errors.size();
+        sort(errors.begin(), errors.end());
+        errors.erase(unique(errors.begin(), errors.end()), errors.end());
+        result["errors"] = errors;
+        failed = failed || !errors.empty();
+
+        auto latency = result["finalLatency"].contains("p50Ms") ? result["finalLatency"]["p50Ms"].get<double>() : -1.0;
+        points.push_back({ latency, result["wordErrorRate"].get<double>() });
+        cout << "  finalLatencyP50Ms=" << latency << " partialChurn=" << result["partialChurn"] << " WER=" << result["wordErrorRate"] << endl;
+        report["configurations"].push_back(result);
+    }
+
+    for (size_t i = 0; i < points.size(); i++)
+    {
+        bool dominated = points[i].LatencyMs < 0;
+        for (size_t j = 0; j < points.size() && !dominated; j++)
+        {
+            dominated = j != i && points[j].LatencyMs >= 0 &&
+                points[j].LatencyMs <= points[i].LatencyMs && points[j].WordErrorRate <= points[i].WordErrorRate &&
+                (points[j].LatencyMs < points[i].LatencyMs || points[j].WordErrorRate < points[i].WordErrorRate);
+        }
+        report["configurations"][i]["paretoOptimal"] = !dominated;
+    }
+
+    cout << "Pareto optimal configurations (median final latency vs. WER):" << endl;
+    for (auto& result : report["configurations"])
+    {
+        if (result["paretoOptimal"].get<bool>())
+        {
+            cout << "  segmentation=" << result["segmentationSilenceTimeoutMs"].get<string>() << " endSilence=" << result["endSilenceTimeoutMs"].get<string>()
+                 << " stablePartial=" << result["stablePartialResultThreshold"].get<string>() << " lid=" << result["languageIdPriority"].get<string>()
+                 << ": " << result["finalLatency"]["p50Ms"] << " ms, WER " << result["wordErrorRate"] << endl;
+        }
+    }
+
+    ofstream output(options.Output, ios_base::out | ios_base::trunc);
+    output << report.dump(2) << endl;
+    cout << "Report written to " << options.Output << endl;
+
+    return failed ? 1 : 0;
+}
+
+namespace
+{
+    struct FormatOptions
+    {
+        string Key = "YourSubscriptionKey";
+        string Region = "YourServiceRegion";
+        string Voice = "en-US-JennyNeural";
+        string Text = "What's the weather like? It is sunny with a light breeze, and the temperature will reach twenty degrees this afternoon.";
+        // Format names, all default candidates when empty.
+        vector<string> Formats;
+        uint32_t Iterations = 3;
+        // "<format>=<ms>" pairs: CPU time a client needs to decode a second of audio, measured on that client.
+        vector<string> DecodeCosts;
+        // Client bandwidths in bytes per second to show the choice for, from a slow mobile link to a LAN.
+        vector<string> Bandwidths{ "8000", "24000", "64000", "1000000" };
+        string Output = "format_report.json";
+    };
+
+    void PrintFormatUsage()
+    {
+        cout << "Usage: sample --formats [options]\n"
+                "  --key <key>             subscription key\n"
+                "  --region <region>       service region\n"
+                "  --voice <name>          synthesis voice (default en-US-JennyNeural)\n"
+                "  --text <text>           text to synthesize\n"
+                "  --formats <list>        synthesis output formats (default: PCM, MP3, Ogg and WebM Opus of 16 and 24 kHz)\n"
+                "  --iterations <n>        syntheses per format (default 3)\n"
+                "  --decode-cost <list>    <format>=<ms> pairs, decoding CPU time per second of audio on the client\n"
+                "  --bandwidths <list>     client bandwidths in bytes per second to choose formats for\n"
+                "                          (default 8000,24000,64000,1000000)\n"
+                "  --output <file>         JSON report file (default format_report.json), readable by\n"
+                "                          SynthesisFormatSelector::FromJson()\n";
+    }
+
+    FormatOptions ParseFormatOptions(const vector<string>& args)
+    {
+        FormatOptions options;
+        for (size_t i = 0; i < args.size(); i++)
+        {
+            auto& name = args[i];
+            if (name == "--help" || name == "-h")
+            {
+                throw invalid_argument("");
+            }
+            if (i + 1 >= args.size())
+            {
+                throw invalid_argument("Missing value for " + name);
+            }
+
+            auto& value = args[++i];
+            if (name == "--key")
+            {
+                options.Key = value;
+            }
+            else if (name == "--region")
+            {
+                options.Region = value;
+            }
+            else if (name == "--voice")
+            {
+                options.Voice = value;
+            }
+            else if (name == "--text")
+            {
+                options.Text = value;
+            }
+            else if (name == "--formats")
+            {
+                options.Formats = SplitList(value);
+            }
+            else if (name == "--iterations")
+            {
+                options.Iterations = max<uint32_t>(1, (uint32_t)stoul(value));
+            }
+            else if (name == "--decode-cost")
+            {
+                options.DecodeCosts = SplitList(value);
+            }
+            else if (name == "--bandwidths")
+            {
+                options.Bandwidths = SplitList(value);
+            }
+            else if (name == "--output")
+            {
+                options.Output = value;
+            }
+            else
+            {
+                throw invalid_argument("Unknown option " + name);
+            }
+        }
+        return options;
+    }
+
+    // The candidates named in the options, with the decode costs given for them.
+    vector<SynthesisFormatSelector::Candidate> SelectFormatCandidates(const FormatOptions& options)
+    {
+        auto all = SynthesisFormatSelector::DefaultCandidates();
+        vector<SynthesisFormatSelector::Candidate> candidates;
+        if (options.Formats.empty())
+        {
+            candidates = all;
+        }
+        for (auto& name : options.Formats)
+        {
+            auto candidate = find_if(all.begin(), all.end(), [&name](const SynthesisFormatSelector::Candidate& c) { return c.Name == name; });
+            if (candidate == all.end())
+            {
+                throw invalid_argument("Unknown format " + name);
+            }
+            candidates.push_back(*candidate);
+        }
+        for (auto& cost : options.DecodeCosts)
+        {
+            auto equals = cost.find('=');
+            auto candidate = find_if(candidates.begin(), candidates.end(), [&](const SynthesisFormatSelector::Candidate& c) { return c.Name == cost.substr(0, equals); });
+            if (equals == string::npos || candidate == candidates.end())
+            {
+                throw invalid_argument("Invalid decode cost " + cost + ", expected <format>=<ms> for a measured format.");
+            }
+            candidate->DecodeCost = stod(cost.substr(equals + 1));
+        }
+        return candidates;
+    }
+}
+
+// Synthesizes a text in each output format and reports its time to first byte, bytes per second of audio and, when
+// given, the decode cost on the client, and which format SynthesisFormatSelector chooses for a range of client
+// bandwidths. Decode costs apply after the measurement, since they are a property of the client, not the service.
+// Returns the process exit code like RunBenchmark().
+int RunFormatBenchmark(const vector<string>& args)
+{
+    FormatOptions options;
+    vector<SynthesisFormatSelector::Candidate> candidates;
+    vector<double> bandwidths;
+    try
+    {
+        options = ParseFormatOptions(args);
+        candidates = SelectFormatCandidates(options);
+        for (auto& bandwidth : options.Bandwidths)
+        {
+            bandwidths.push_back(stod(bandwidth));
+        }
+    }
+    catch (const exception& e)
+    {
+        if (*e.what() != '\0')
+        {
+            cout << e.what() << endl;
+        }
+        PrintFormatUsage();
+        return 2;
+    }
+
+    auto config = SpeechConfig::FromSubscription(options.Key, options.Region);
+    config->SetSpeechSynthesisVoiceName(options.Voice);
+    vector<SynthesisFormatSelector::Candidate> measured;
+    try
+    {
+        measured = SynthesisFormatSelector::Measure(config, candidates, options.Text, options.Iterations);
+    }
+    catch (const exception& e)
+    {
+        cout << e.what() << endl;
+        return 1;
+    }
+
+    nlohmann::json report;
+    report["voice"] = options.Voice;
+    report["iterations"] = options.Iterations;
+    report["formats"] = SynthesisFormatSelector::ToJson(measured);
+    for (auto& candidate : measured)
+    {
+        cout << candidate.Name << ": first byte " << candidate.FirstByte.count() << " ms, " << (uint64_t)candidate.BytesPerSecond << " bytes/s";
+        if (candidate.DecodeCost >= 0)
+        {
+            cout << ", decoding " << candidate.DecodeCost << " ms/s";
+        }
+        cout << endl;
+    }
+
+    SynthesisFormatSelector selector(measured);
+    report["selection"] = nlohmann::json::array();
+    for (auto bandwidth : bandwidths)
+    {
+        const auto& chosen = selector.Choose(bandwidth);
+        cout << "Client with " << (uint64_t)bandwidth << " bytes/s: " << chosen.Name << endl;
+        report["selection"].push_back({ { "bandwidthBytesPerSecond", bandwidth }, { "format", chosen.Name } });
+    }
+
+    ofstream output(options.Output, ios_base::out | ios_base::trunc);
+    output << report.dump(2) << endl;
+    cout << "Report written to " << options.Output << endl;
+
+    return 0;
+}
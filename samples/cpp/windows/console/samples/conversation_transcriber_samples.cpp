@@ -8,6 +8,10 @@
 #include <speechapi_cxx.h>
 #include <fstream>
 #include "wav_file_reader.h"
+#include "audio_chunk_pool.h"
+#include "recognition_session_runner.h"
+#include "read_ahead_audio_callback.h"
+#include "push_stream_multiplexer.h"
 #include <chrono>
 
 using namespace std;
@@ -20,37 +24,7 @@ using namespace Microsoft::CognitiveServices::Speech::Audio;
 // Note: This is only available on the devices with Circular7 (Circular6+1) microphone array geometry.
 void ConversationWithPullAudioStream()
 {
-    // First, define your own pull audio input stream callback class that implements the
-    // PullAudioInputStreamCallback interface. The sample here illustrates how to define such
-    // a callback that reads audio data from a wav file.
-    // AudioInputFromFileCallback implements PullAudioInputStreamCallback interface, and uses a wav file as source
-    class AudioInputFromFileCallback final : public PullAudioInputStreamCallback
-    {
-    public:
-        // Constructor that creates an input stream from a file.
-        AudioInputFromFileCallback(const string& audioFileName)
-            : m_reader(audioFileName)
-        {
-        }
-        // Implements AudioInputStream::Read() which is called to get data from the audio stream.
-        // It copies data available in the stream to 'dataBuffer', but no more than 'size' bytes.
-        // If the data available is less than 'size' bytes, it is allowed to just return the amount of data that is currently available.
-        // If there is no data, this function must wait until data is available.
-        // It returns the number of bytes that have been copied in 'dataBuffer'.
-        // It returns 0 to indicate that the stream reaches end or is closed.
-        int Read(uint8_t* dataBuffer, uint32_t size) override
-        {
-            return m_reader.Read(dataBuffer, size);
-        }
-        // Implements AudioInputStream::Close() which is called when the stream needs to be closed.
-        void Close() override
-        {
-            m_reader.Close();
-        }
-
-    private:
-        WavFileReader m_reader;
-    };
+    // Reads the wav file ahead with ReadAheadAudioCallback, see SpeechContinuousRecognitionWithPullStream().
 
     // Creates an instance of a speech config with your subscription key and region.
     // Replace with your own subscription key and service region (e.g., "eastasia").
@@ -59,12 +33,12 @@ void ConversationWithPullAudioStream()
     config->SetProperty("ConversationTranscriptionInRoomAndOnline", "true");
 
     // Creates a callback that will read audio data from a WAV file.
-    shared_ptr<AudioInputFromFileCallback> callback;
+    shared_ptr<ReadAheadAudioCallback<WavFileReader>> callback;
     try
     {
         // Replace with your own audio file name.
         // The audio file should be in a format of 16 kHz sampling rate, 16 bits per sample, and 8 channels.
-        callback = make_shared<AudioInputFromFileCallback>("katiesteve.wav");
+        callback = CreateReadAheadWavFileCallback("katiesteve.wav");
     }
     catch (const exception& e)
     {
@@ -78,6 +52,10 @@ void ConversationWithPullAudioStream()
     // Create a conversation from a speech config and conversation Id.
     auto conversation = Conversation::CreateConversationAsync(config, "ConversationTranscriberSamples").get();
 
+    // Runs the event handlers on the shared event dispatch executor instead of the SDK callback thread,
+    // and ends the session on cancellation or session stop.
+    RecognitionSessionRunner session;
+
     // Create a conversation transcriber given an audio config. If you don't specify any audio input, Speech SDK opens the default microphone.
     auto recognizer = ConversationTranscriber::FromConfig(audioInput);
 
@@ -111,31 +89,28 @@ void ConversationWithPullAudioStream()
     // Adds steve as a participant to the conversation.
     conversation->AddParticipantAsync(steve).get();
 
-    // a promise for synchronization of recognition end.
-    promise<void> recognitionEnd;
-
     // Subscribes to events.
-    recognizer->Transcribing.Connect([](const ConversationTranscriptionEventArgs& e)
+    session.OnPartial(recognizer->Transcribing, [](const shared_ptr<ConversationTranscriptionResult>& result)
     {
-        cout << "TRANSCRIBING: Text=" << e.Result->Text << std::endl;
+        cout << "TRANSCRIBING: Text=" << result->Text << std::endl;
     });
 
-    recognizer->Transcribed.Connect([](const ConversationTranscriptionEventArgs& e)
+    session.OnFinal(recognizer->Transcribed, [](const shared_ptr<ConversationTranscriptionResult>& result)
     {
-        if (e.Result->Reason == ResultReason::RecognizedSpeech)
+        if (result->Reason == ResultReason::RecognizedSpeech)
         {
-            cout << "Transcribed: Text=" << e.Result->Text << std::endl
-                << "  Offset=" << e.Result->Offset() << std::endl
-                << "  Duration=" << e.Result->Duration() << std::endl
-                << "  UserId=" << e.Result->UserId << std::endl;
+            cout << "Transcribed: Text=" << result->Text << std::endl
+                << "  Offset=" << result->Offset() << std::endl
+                << "  Duration=" << result->Duration() << std::endl
+                << "  UserId=" << result->UserId << std::endl;
         }
-        else if (e.Result->Reason == ResultReason::NoMatch)
+        else if (result->Reason == ResultReason::NoMatch)
         {
             cout << "NOMATCH: Speech could not be recognized." << std::endl;
         }
     });
 
-    recognizer->Canceled.Connect([&recognitionEnd](const ConversationTranscriptionCanceledEventArgs& e)
+    session.OnCanceled(recognizer->Canceled, [](const RecognitionSessionRunner::CancellationInfo& e)
     {
         switch (e.Reason)
         {
@@ -146,7 +121,6 @@ void ConversationWithPullAudioStream()
         case CancellationReason::Error:
             cout << "CANCELED: ErrorCode=" << (int)e.ErrorCode << std::endl;
             cout << "CANCELED: ErrorDetails=" << e.ErrorDetails << std::endl;
-            recognitionEnd.set_value();
             break;
 
         default:
@@ -154,17 +128,16 @@ void ConversationWithPullAudioStream()
         }
     });
 
-    recognizer->SessionStopped.Connect([&recognitionEnd](const SessionEventArgs& e)
+    session.OnSessionStopped(recognizer->SessionStopped, []()
     {
-        cout << "SESSION: " << e.SessionId << " stopped." << std::endl;
-        recognitionEnd.set_value(); // Notify to stop recognition.
+        cout << "SESSION: stopped." << std::endl;
     });
 
     // Starts transcribing.
     recognizer->StartTranscribingAsync().wait();
 
     // Waits for transcribing to end.
-    recognitionEnd.get_future().wait();
+    session.Wait();
 
     // Stops transcribing. This is optional.
     recognizer->StopTranscribingAsync().wait();
@@ -273,14 +246,17 @@ void ConversationWithPushAudioStream()
     try
     {
         WavFileReader reader("katiesteve.wav");
-        vector<uint8_t> buffer(1000);
+
+        // Takes a buffer holding 100 ms of audio, so that samples of the 8 channels are never split across writes.
+        AudioChunkPool pool(reader.GetFormat());
+        auto buffer = pool.Acquire();
 
         // Read data and push them into the stream
         int readSamples = 0;
-        while ((readSamples = reader.Read(buffer.data(), (uint32_t)buffer.size())) != 0)
+        while ((readSamples = reader.Read(buffer->data(), (uint32_t)buffer->size())) != 0)
         {
             // Push a buffer into the stream
-            pushStream->Write(buffer.data(), readSamples);
+            pushStream->Write(buffer->data(), readSamples);
             this_thread::sleep_for(10ms);
         }
     }
@@ -410,3 +386,88 @@ void ConversationWithMicrophone()
     // Stops transcribing. This is optional.
     recognizer->StopTranscribingAsync().wait();
 }
+
+// Transcribing many conversations at once, with their push streams fed by a small pool of threads.
+void ConversationsWithMultiplexedPushAudioStreams()
+{
+    // Creates an instance of a speech config with your subscription key and region.
+    // Replace with your own subscription key and service region (e.g., "eastasia").
+    // Conversation Transcription is currently available in eastasia and centralus region.
+    auto config = SpeechConfig::FromSubscription("YourSubscriptionKey", "YourServiceRegion");
+    config->SetProperty("ConversationTranscriptionInRoomAndOnline", "true");
+
+    // Replace with the number of meetings to host, and the audio of each in 16 kHz, 16 bits per sample, 8 channels.
+    const int meetings = 8;
+    const string audioFile = "katiesteve.wav";
+
+    struct Meeting
+    {
+        shared_ptr<Conversation> Session;
+        shared_ptr<ConversationTranscriber> Recognizer;
+        promise<void> Stopped;
+    };
+    vector<unique_ptr<Meeting>> running;
+
+    // Two threads feed all the streams; each source hands out only the audio that is available, without blocking.
+    PushStreamMultiplexer::Settings settings;
+    settings.Threads = 2;
+    PushStreamMultiplexer multiplexer(settings);
+
+    for (int i = 0; i < meetings; i++)
+    {
+        shared_ptr<PacedWavFileSource> source;
+        try
+        {
+            source = make_shared<PacedWavFileSource>(audioFile);
+        }
+        catch (const exception& e)
+        {
+            cout << "Cannot open " << audioFile << ": " << e.what() << endl;
+            break;
+        }
+
+        auto meeting = make_unique<Meeting>();
+        auto pushStream = AudioInputStream::CreatePushStream(AudioStreamFormat::GetWaveFormatPCM(16000, 16, 8));
+        meeting->Session = Conversation::CreateConversationAsync(config, "Meeting" + to_string(i)).get();
+        meeting->Recognizer = ConversationTranscriber::FromConfig(AudioConfig::FromStreamInput(pushStream));
+        meeting->Recognizer->JoinConversationAsync(meeting->Session).get();
+
+        meeting->Recognizer->Transcribed.Connect([i](const ConversationTranscriptionEventArgs& e)
+        {
+            if (e.Result->Reason == ResultReason::RecognizedSpeech)
+            {
+                cout << "Meeting " << i << " TRANSCRIBED: Text=" << e.Result->Text << " UserId=" << e.Result->UserId << std::endl;
+            }
+        });
+
+        meeting->Recognizer->Canceled.Connect([i](const ConversationTranscriptionCanceledEventArgs& e)
+        {
+            if (e.Reason == CancellationReason::Error)
+            {
+                cout << "Meeting " << i << " CANCELED: ErrorCode=" << (int)e.ErrorCode << " ErrorDetails=" << e.ErrorDetails << std::endl;
+            }
+        });
+
+        auto stopped = &meeting->Stopped;
+        meeting->Recognizer->SessionStopped.Connect([stopped](const SessionEventArgs&)
+        {
+            stopped->set_value();
+        });
+
+        meeting->Recognizer->StartTranscribingAsync().wait();
+        multiplexer.Add(source, pushStream);
+        running.push_back(std::move(meeting));
+    }
+
+    // The multiplexer closes each push stream at the end of its audio, which ends the session.
+    multiplexer.WaitUntilDone();
+    for (auto& meeting : running)
+    {
+        meeting->Stopped.get_future().wait();
+        meeting->Recognizer->StopTranscribingAsync().wait();
+    }
+
+    auto statistics = multiplexer.GetStatistics();
+    cout << "Multiplexer: Streams=" << statistics.FinishedStreams << " Failed=" << statistics.FailedStreams
+         << " Writes=" << statistics.Writes << " Bytes=" << statistics.Bytes << " EmptyPolls=" << statistics.EmptyPolls << std::endl;
+}
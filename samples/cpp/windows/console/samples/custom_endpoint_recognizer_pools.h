@@ -0,0 +1,409 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#pragma once
+
+#include <speechapi_cxx.h>
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include "warm_recognizer_pool.h"
+
+// Warm recognizers for many custom speech models, e.g. one endpoint per tenant. The first request for an endpoint
+// creates a WarmRecognizerPool for it; a pool grows (up to 'MaxPoolSize') when more requests are in flight than it
+// has recognizers, and shrinks back to the peak of the last 'MaintenanceInterval'. Endpoints that were not used for
+// 'IdleTimeout' are closed, and while more than 'MaxEndpoints' are open the least recently used idle one is closed.
+// Leases report the latency of their first result, so cold and warm starts can be compared per endpoint.
+template <class RecognizerType>
+class CustomEndpointRecognizerPools final
+{
+    struct EndpointState;
+
+public:
+    using Pool = WarmRecognizerPool<RecognizerType>;
+
+    // Creates a recognizer for the model deployed at 'endpointId', e.g. from a config with SetEndpointId().
+    using Factory = std::function<std::shared_ptr<RecognizerType>(const std::string& endpointId)>;
+
+    struct Settings
+    {
+        size_t MinPoolSize = 1;
+        size_t MaxPoolSize = 4;
+        size_t MaxEndpoints = 16;
+        std::chrono::seconds IdleTimeout{ 600 };
+        // Also the health check interval of the pools.
+        std::chrono::seconds MaintenanceInterval{ 30 };
+    };
+
+    struct EndpointStatistics
+    {
+        std::string EndpointId;
+        size_t PoolSize = 0;
+        size_t InUse = 0;
+        uint64_t WarmLeases = 0;
+        uint64_t ColdLeases = 0;
+        // Mean latency of the first results reported by warm and by cold leases, and how many were reported.
+        uint64_t WarmResults = 0;
+        std::chrono::milliseconds WarmFirstResult{ 0 };
+        uint64_t ColdResults = 0;
+        std::chrono::milliseconds ColdFirstResult{ 0 };
+    };
+
+    struct Statistics
+    {
+        uint64_t EndpointsOpened = 0;
+        uint64_t EndpointsEvicted = 0;
+        std::vector<EndpointStatistics> Endpoints;
+    };
+
+    // A recognizer of one endpoint. It goes back to the pool of the endpoint when the lease is destroyed.
+    class Lease final
+    {
+    public:
+        Lease(Lease&& other) : m_pools(other.m_pools), m_state(std::move(other.m_state)), m_lease(std::move(other.m_lease))
+        {
+            other.m_pools = nullptr;
+        }
+
+        Lease(const Lease&) = delete;
+        Lease& operator=(const Lease&) = delete;
+        Lease& operator=(Lease&&) = delete;
+
+        ~Lease()
+        {
+            if (m_pools != nullptr)
+            {
+                m_pools->Return(*m_state);
+            }
+        }
+
+        RecognizerType* operator->() const
+        {
+            return m_lease.operator->();
+        }
+
+        std::shared_ptr<RecognizerType> Get() const
+        {
+            return m_lease.Get();
+        }
+
+        bool IsWarm() const
+        {
+            return m_lease.IsWarm();
+        }
+
+        // Drops the recognizer instead of returning it, e.g. after a canceled recognition or when its audio input
+        // was used up; the pool connects a replacement in the background.
+        void Discard()
+        {
+            m_lease.Discard();
+        }
+
+        // Records the time from starting the recognition to its first result, counted as warm or cold by IsWarm().
+        // Does nothing on a lease that was moved from.
+        void RecordFirstResult(std::chrono::milliseconds latency)
+        {
+            if (m_pools != nullptr)
+            {
+                m_pools->Record(*m_state, IsWarm(), latency);
+            }
+        }
+
+    private:
+        friend class CustomEndpointRecognizerPools;
+
+        Lease(CustomEndpointRecognizerPools* pools, std::shared_ptr<EndpointState> state, typename Pool::Lease&& lease)
+            : m_pools(pools), m_state(std::move(state)), m_lease(std::move(lease))
+        {
+        }
+
+        CustomEndpointRecognizerPools* m_pools;
+        // Declared before the recognizer lease, so the pool outlives the lease even after an eviction.
+        std::shared_ptr<EndpointState> m_state;
+        typename Pool::Lease m_lease;
+    };
+
+    explicit CustomEndpointRecognizerPools(Factory factory)
+        : CustomEndpointRecognizerPools(std::move(factory), Settings())
+    {
+    }
+
+    // Opens no endpoint yet. The pools must outlive their leases.
+    CustomEndpointRecognizerPools(Factory factory, const Settings& settings)
+        : m_factory(std::move(factory)), m_settings(settings)
+    {
+        if (!m_factory || m_settings.MinPoolSize == 0 || m_settings.MaxPoolSize < m_settings.MinPoolSize || m_settings.MaxEndpoints == 0)
+        {
+            throw std::invalid_argument("The pools need a recognizer factory, pool sizes of at least one and room for an endpoint.");
+        }
+        m_thread = std::thread([this]() { Maintain(); });
+    }
+
+    CustomEndpointRecognizerPools(const CustomEndpointRecognizerPools&) = delete;
+    CustomEndpointRecognizerPools& operator=(const CustomEndpointRecognizerPools&) = delete;
+
+    ~CustomEndpointRecognizerPools()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stopping = true;
+        }
+        m_wakeUp.notify_one();
+        m_thread.join();
+    }
+
+    // Hands out a recognizer of 'endpointId', opening the endpoint on first use. Throws what the factory throws.
+    Lease Acquire(const std::string& endpointId)
+    {
+        bool grow = false;
+        auto state = Open(endpointId, grow);
+        try
+        {
+            if (grow)
+            {
+                ApplySize(*state);
+            }
+            auto lease = state->Recognizers->Acquire();
+            return Lease(this, state, std::move(lease));
+        }
+        catch (...)
+        {
+            Return(*state);
+            throw;
+        }
+    }
+
+    Statistics GetStatistics()
+    {
+        std::vector<std::shared_ptr<EndpointState>> endpoints;
+        Statistics statistics;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            statistics.EndpointsOpened = m_opened;
+            statistics.EndpointsEvicted = m_evicted;
+            for (auto& endpoint : m_endpoints)
+            {
+                endpoints.push_back(endpoint.second);
+            }
+        }
+        for (auto& state : endpoints)
+        {
+            auto poolStatistics = state->Recognizers->GetStatistics();
+            std::lock_guard<std::mutex> lock(m_mutex);
+            EndpointStatistics endpoint;
+            endpoint.EndpointId = state->EndpointId;
+            endpoint.PoolSize = state->Size;
+            endpoint.InUse = state->InUse;
+            endpoint.WarmLeases = poolStatistics.WarmLeases;
+            endpoint.ColdLeases = poolStatistics.ColdLeases;
+            endpoint.WarmResults = state->WarmResults;
+            endpoint.WarmFirstResult = state->WarmResults > 0 ? state->WarmLatency / (int64_t)state->WarmResults : std::chrono::milliseconds(0);
+            endpoint.ColdResults = state->ColdResults;
+            endpoint.ColdFirstResult = state->ColdResults > 0 ? state->ColdLatency / (int64_t)state->ColdResults : std::chrono::milliseconds(0);
+            statistics.Endpoints.push_back(endpoint);
+        }
+        return statistics;
+    }
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    // Guarded by m_mutex, except for 'Recognizers', which has its own lock.
+    struct EndpointState
+    {
+        std::string EndpointId;
+        std::shared_ptr<Pool> Recognizers;
+        size_t Size = 0;
+        size_t InUse = 0;
+        // The most leases in flight at once since the last maintenance.
+        size_t PeakInUse = 0;
+        Clock::time_point LastUsed;
+        // Held while 'Size' is applied to the pool, so the newest size is applied last.
+        std::mutex ResizeMutex;
+        uint64_t WarmResults = 0;
+        std::chrono::milliseconds WarmLatency{ 0 };
+        uint64_t ColdResults = 0;
+        std::chrono::milliseconds ColdLatency{ 0 };
+    };
+
+    // Finds or opens the endpoint and counts the lease in 'InUse' under the same lock, so the endpoint cannot be
+    // evicted before the lease holds it. Sets 'grow' when the pool needs more recognizers for this lease.
+    std::shared_ptr<EndpointState> Open(const std::string& endpointId, bool& grow)
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            auto found = m_endpoints.find(endpointId);
+            if (found != m_endpoints.end())
+            {
+                grow = Claim(*found->second);
+                return found->second;
+            }
+        }
+
+        // The pool connects its first recognizers without the lock, so other endpoints are served meanwhile.
+        auto state = std::make_shared<EndpointState>();
+        state->EndpointId = endpointId;
+        state->Size = m_settings.MinPoolSize;
+        auto factory = m_factory;
+        state->Recognizers = std::make_shared<Pool>([factory, endpointId]() { return factory(endpointId); }, m_settings.MinPoolSize,
+            m_settings.MaintenanceInterval);
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto inserted = m_endpoints.insert({ endpointId, state });
+        if (!inserted.second)
+        {
+            // Another request opened the endpoint first; this pool is closed when 'state' goes away.
+            grow = Claim(*inserted.first->second);
+            return inserted.first->second;
+        }
+        m_opened++;
+        grow = Claim(*state);
+        while (m_endpoints.size() > m_settings.MaxEndpoints)
+        {
+            auto oldest = m_endpoints.end();
+            for (auto candidate = m_endpoints.begin(); candidate != m_endpoints.end(); ++candidate)
+            {
+                if (candidate->second->InUse == 0 && candidate->second != state &&
+                    (oldest == m_endpoints.end() || candidate->second->LastUsed < oldest->second->LastUsed))
+                {
+                    oldest = candidate;
+                }
+            }
+            if (oldest == m_endpoints.end())
+            {
+                // All other endpoints are in use; they are closed once idle.
+                break;
+            }
+            m_evicted++;
+            m_closing.push_back(std::move(oldest->second));
+            m_endpoints.erase(oldest);
+        }
+        if (!m_closing.empty())
+        {
+            m_wakeUp.notify_one();
+        }
+        return state;
+    }
+
+    // Counts a lease of 'state'. Called with m_mutex held; returns true when the pool has to grow.
+    bool Claim(EndpointState& state)
+    {
+        state.InUse++;
+        state.PeakInUse = std::max(state.PeakInUse, state.InUse);
+        state.LastUsed = Clock::now();
+        // More requests in flight than recognizers: this one is cold, the next one at this load is not.
+        if (state.InUse > state.Size && state.Size < m_settings.MaxPoolSize)
+        {
+            state.Size = std::min(state.InUse, m_settings.MaxPoolSize);
+            return true;
+        }
+        return false;
+    }
+
+    void ApplySize(EndpointState& state)
+    {
+        std::lock_guard<std::mutex> resizeLock(state.ResizeMutex);
+        size_t size;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            size = state.Size;
+        }
+        state.Recognizers->Resize(size);
+    }
+
+    void Return(EndpointState& state)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        state.InUse--;
+        state.LastUsed = Clock::now();
+    }
+
+    void Record(EndpointState& state, bool warm, std::chrono::milliseconds latency)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (warm)
+        {
+            state.WarmResults++;
+            state.WarmLatency += latency;
+        }
+        else
+        {
+            state.ColdResults++;
+            state.ColdLatency += latency;
+        }
+    }
+
+    void Maintain()
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        auto nextCheck = Clock::now() + m_settings.MaintenanceInterval;
+        while (true)
+        {
+            m_wakeUp.wait_until(lock, nextCheck, [this]() { return m_stopping || !m_closing.empty(); });
+            if (m_stopping)
+            {
+                return;
+            }
+
+            std::vector<std::shared_ptr<EndpointState>> resized;
+            if (Clock::now() >= nextCheck)
+            {
+                nextCheck = Clock::now() + m_settings.MaintenanceInterval;
+                auto now = Clock::now();
+                for (auto endpoint = m_endpoints.begin(); endpoint != m_endpoints.end();)
+                {
+                    auto& state = endpoint->second;
+                    if (state->InUse == 0 && now - state->LastUsed >= m_settings.IdleTimeout)
+                    {
+                        m_evicted++;
+                        m_closing.push_back(std::move(state));
+                        endpoint = m_endpoints.erase(endpoint);
+                        continue;
+                    }
+                    auto size = std::min(std::max(state->PeakInUse, m_settings.MinPoolSize), m_settings.MaxPoolSize);
+                    if (size < state->Size)
+                    {
+                        state->Size = size;
+                        resized.push_back(state);
+                    }
+                    state->PeakInUse = state->InUse;
+                    ++endpoint;
+                }
+            }
+
+            // Closing recognizers takes a while and runs without the lock.
+            std::vector<std::shared_ptr<EndpointState>> closing;
+            closing.swap(m_closing);
+            lock.unlock();
+            for (auto& endpoint : resized)
+            {
+                ApplySize(*endpoint);
+            }
+            resized.clear();
+            closing.clear();
+            lock.lock();
+        }
+    }
+
+    const Factory m_factory;
+    const Settings m_settings;
+
+    std::mutex m_mutex;
+    std::condition_variable m_wakeUp;
+    std::map<std::string, std::shared_ptr<EndpointState>> m_endpoints;
+    // Evicted endpoints, whose pools the maintenance thread destroys.
+    std::vector<std::shared_ptr<EndpointState>> m_closing;
+    uint64_t m_opened = 0;
+    uint64_t m_evicted = 0;
+    bool m_stopping = false;
+    std::thread m_thread;
+};
@@ -0,0 +1,534 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#pragma once
+
+#include <speechapi_cxx.h>
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// Typed view of the JSON of a recognition result in the detailed output format (SpeechServiceResponse_JsonResult):
+// status, offsets, display text and the NBest hypotheses with their words. The JSON is only parsed on the first
+// access, and in a single pass that extracts these fields and skips everything else without building a document.
+// Strings are not copied: they point into the JSON text kept by the view, and are decoded only if they contain
+// escapes when ToString() is called. Scanning strings and skipped values uses memchr, which the C runtimes vectorize.
+// Throws std::runtime_error on the first access if the text is not valid JSON.
+class DetailedResultView final
+{
+public:
+    // A string of the JSON text, valid as long as the view.
+    struct JsonString
+    {
+        const char* Data = nullptr;
+        size_t Size = 0;
+        // The raw text contains escape sequences; ToString() decodes them.
+        bool Escaped = false;
+
+        bool Empty() const
+        {
+            return Size == 0;
+        }
+
+        bool Equals(const char* text) const
+        {
+            return !Escaped && strlen(text) == Size && memcmp(Data, text, Size) == 0;
+        }
+
+        std::string ToString() const
+        {
+            return Escaped ? Unescape(Data, Size) : std::string(Data, Size);
+        }
+    };
+
+    struct Word
+    {
+        JsonString Text;
+        // In ticks of 100 ns, like RecognitionResult::Offset().
+        uint64_t Offset = 0;
+        uint64_t Duration = 0;
+        // Only present with word level confidence, 0 otherwise.
+        double Confidence = 0;
+    };
+
+    struct Hypothesis
+    {
+        double Confidence = 0;
+        JsonString Lexical;
+        JsonString Itn;
+        JsonString MaskedItn;
+        JsonString Display;
+        // Only present with word level timestamps.
+        std::vector<Word> Words;
+    };
+
+    explicit DetailedResultView(std::string json)
+        : m_json(std::move(json))
+    {
+    }
+
+    explicit DetailedResultView(const std::shared_ptr<Microsoft::CognitiveServices::Speech::RecognitionResult>& result)
+        : m_json(result->Properties.GetProperty(Microsoft::CognitiveServices::Speech::PropertyId::SpeechServiceResponse_JsonResult))
+    {
+    }
+
+    DetailedResultView(const DetailedResultView&) = delete;
+    DetailedResultView& operator=(const DetailedResultView&) = delete;
+
+    const std::string& GetJson() const
+    {
+        return m_json;
+    }
+
+    JsonString GetRecognitionStatus() const
+    {
+        return Parsed().Status;
+    }
+
+    uint64_t GetOffset() const
+    {
+        return Parsed().Offset;
+    }
+
+    uint64_t GetDuration() const
+    {
+        return Parsed().Duration;
+    }
+
+    JsonString GetDisplayText() const
+    {
+        return Parsed().DisplayText;
+    }
+
+    // The first hypothesis is the recognition result, not necessarily the one with the highest confidence.
+    const std::vector<Hypothesis>& GetNBest() const
+    {
+        return Parsed().NBest;
+    }
+
+private:
+    // Recursive descent over the text of the view; 'm_end' points at the terminating NUL of the string.
+    class Scanner final
+    {
+    public:
+        Scanner(const char* begin, const char* end) : m_begin(begin), m_position(begin), m_end(end)
+        {
+        }
+
+        // Calls 'member(key)' for each member of an object; 'member' must consume the value.
+        template <class Member>
+        void ReadObject(Member&& member)
+        {
+            Expect('{');
+            if (Peek() == '}')
+            {
+                m_position++;
+                return;
+            }
+            for (;;)
+            {
+                Peek();
+                auto key = ReadString();
+                Expect(':');
+                member(key);
+                if (Peek() == ',')
+                {
+                    m_position++;
+                    continue;
+                }
+                Expect('}');
+                return;
+            }
+        }
+
+        // Calls 'element()' for each element of an array; 'element' must consume the value.
+        template <class Element>
+        void ReadArray(Element&& element)
+        {
+            Expect('[');
+            if (Peek() == ']')
+            {
+                m_position++;
+                return;
+            }
+            for (;;)
+            {
+                element();
+                if (Peek() == ',')
+                {
+                    m_position++;
+                    continue;
+                }
+                Expect(']');
+                return;
+            }
+        }
+
+        JsonString ReadString()
+        {
+            Expect('"');
+            JsonString text;
+            text.Data = m_position;
+            for (;;)
+            {
+                auto quote = static_cast<const char*>(memchr(m_position, '"', m_end - m_position));
+                if (quote == nullptr)
+                {
+                    Fail();
+                }
+                // A quote preceded by an odd number of backslashes is escaped.
+                auto backslashes = quote;
+                while (backslashes > text.Data && backslashes[-1] == '\\')
+                {
+                    backslashes--;
+                }
+                m_position = quote + 1;
+                if ((quote - backslashes) % 2 == 0)
+                {
+                    text.Size = quote - text.Data;
+                    text.Escaped = memchr(text.Data, '\\', text.Size) != nullptr;
+                    return text;
+                }
+            }
+        }
+
+        double ReadNumber()
+        {
+            Peek();
+            bool negative = m_position < m_end && *m_position == '-';
+            if (negative)
+            {
+                m_position++;
+            }
+            if (m_position == m_end || !IsDigit(*m_position))
+            {
+                Fail();
+            }
+            double value = 0;
+            while (m_position < m_end && IsDigit(*m_position))
+            {
+                value = value * 10 + (*m_position++ - '0');
+            }
+            if (m_position < m_end && *m_position == '.')
+            {
+                m_position++;
+                double scale = 0.1;
+                while (m_position < m_end && IsDigit(*m_position))
+                {
+                    value += (*m_position++ - '0') * scale;
+                    scale /= 10;
+                }
+            }
+            if (m_position < m_end && (*m_position == 'e' || *m_position == 'E'))
+            {
+                m_position++;
+                bool negativeExponent = m_position < m_end && *m_position == '-';
+                if (m_position < m_end && (*m_position == '-' || *m_position == '+'))
+                {
+                    m_position++;
+                }
+                int exponent = 0;
+                while (m_position < m_end && IsDigit(*m_position))
+                {
+                    exponent = std::min(exponent * 10 + (*m_position++ - '0'), 400);
+                }
+                value *= Power10(negativeExponent ? -exponent : exponent);
+            }
+            return negative ? -value : value;
+        }
+
+        // Skips over a value of any type.
+        void SkipValue()
+        {
+            switch (Peek())
+            {
+            case '"':
+                ReadString();
+                break;
+            case '{':
+                ReadObject([this](const JsonString&) { SkipValue(); });
+                break;
+            case '[':
+                ReadArray([this]() { SkipValue(); });
+                break;
+            case 't':
+                Literal("true");
+                break;
+            case 'f':
+                Literal("false");
+                break;
+            case 'n':
+                Literal("null");
+                break;
+            default:
+                ReadNumber();
+                break;
+            }
+        }
+
+        // Returns the next character that is not white space, without consuming it.
+        char Peek()
+        {
+            while (m_position < m_end && (*m_position == ' ' || *m_position == '\n' || *m_position == '\r' || *m_position == '\t'))
+            {
+                m_position++;
+            }
+            return m_position < m_end ? *m_position : '\0';
+        }
+
+        void ExpectEnd()
+        {
+            if (Peek() != '\0')
+            {
+                Fail();
+            }
+        }
+
+    private:
+        static bool IsDigit(char c)
+        {
+            return c >= '0' && c <= '9';
+        }
+
+        static double Power10(int exponent)
+        {
+            double value = 1;
+            double base = exponent < 0 ? 0.1 : 10;
+            for (int i = exponent < 0 ? -exponent : exponent; i > 0; i--)
+            {
+                value *= base;
+            }
+            return value;
+        }
+
+        void Expect(char c)
+        {
+            if (Peek() != c)
+            {
+                Fail();
+            }
+            m_position++;
+        }
+
+        void Literal(const char* text)
+        {
+            auto size = strlen(text);
+            if ((size_t)(m_end - m_position) < size || memcmp(m_position, text, size) != 0)
+            {
+                Fail();
+            }
+            m_position += size;
+        }
+
+        [[noreturn]] void Fail()
+        {
+            throw std::runtime_error("Invalid JSON result at offset " + std::to_string(m_position - m_begin) + ".");
+        }
+
+        const char* m_begin;
+        const char* m_position;
+        const char* m_end;
+    };
+
+    struct Fields
+    {
+        JsonString Status;
+        uint64_t Offset = 0;
+        uint64_t Duration = 0;
+        JsonString DisplayText;
+        std::vector<Hypothesis> NBest;
+    };
+
+    const Fields& Parsed() const
+    {
+        std::call_once(m_parsed, [this]() { Parse(); });
+        return m_fields;
+    }
+
+    // When parsing fails, the exception leaves the once flag unset and the next access parses again.
+    void Parse() const
+    {
+        m_fields = Fields();
+        Scanner scanner(m_json.data(), m_json.data() + m_json.size());
+        scanner.ReadObject([&](const JsonString& key)
+        {
+            if (key.Equals("RecognitionStatus"))
+            {
+                m_fields.Status = scanner.ReadString();
+            }
+            else if (key.Equals("Offset"))
+            {
+                m_fields.Offset = (uint64_t)scanner.ReadNumber();
+            }
+            else if (key.Equals("Duration"))
+            {
+                m_fields.Duration = (uint64_t)scanner.ReadNumber();
+            }
+            else if (key.Equals("DisplayText"))
+            {
+                m_fields.DisplayText = scanner.ReadString();
+            }
+            else if (key.Equals("NBest") && scanner.Peek() == '[')
+            {
+                scanner.ReadArray([&]()
+                {
+                    m_fields.NBest.emplace_back();
+                    ParseHypothesis(scanner, m_fields.NBest.back());
+                });
+            }
+            else
+            {
+                scanner.SkipValue();
+            }
+        });
+        scanner.ExpectEnd();
+    }
+
+    static void ParseHypothesis(Scanner& scanner, Hypothesis& hypothesis)
+    {
+        scanner.ReadObject([&](const JsonString& key)
+        {
+            if (key.Equals("Confidence"))
+            {
+                hypothesis.Confidence = scanner.ReadNumber();
+            }
+            else if (key.Equals("Lexical"))
+            {
+                hypothesis.Lexical = scanner.ReadString();
+            }
+            else if (key.Equals("ITN"))
+            {
+                hypothesis.Itn = scanner.ReadString();
+            }
+            else if (key.Equals("MaskedITN"))
+            {
+                hypothesis.MaskedItn = scanner.ReadString();
+            }
+            else if (key.Equals("Display"))
+            {
+                hypothesis.Display = scanner.ReadString();
+            }
+            else if (key.Equals("Words") && scanner.Peek() == '[')
+            {
+                scanner.ReadArray([&]()
+                {
+                    hypothesis.Words.emplace_back();
+                    ParseWord(scanner, hypothesis.Words.back());
+                });
+            }
+            else
+            {
+                scanner.SkipValue();
+            }
+        });
+    }
+
+    static void ParseWord(Scanner& scanner, Word& word)
+    {
+        scanner.ReadObject([&](const JsonString& key)
+        {
+            if (key.Equals("Word"))
+            {
+                word.Text = scanner.ReadString();
+            }
+            else if (key.Equals("Offset"))
+            {
+                word.Offset = (uint64_t)scanner.ReadNumber();
+            }
+            else if (key.Equals("Duration"))
+            {
+                word.Duration = (uint64_t)scanner.ReadNumber();
+            }
+            else if (key.Equals("Confidence"))
+            {
+                word.Confidence = scanner.ReadNumber();
+            }
+            else
+            {
+                scanner.SkipValue();
+            }
+        });
+    }
+
+    // Decodes the escape sequences of a JSON string, \uXXXX (and surrogate pairs) to UTF-8.
+    static std::string Unescape(const char* data, size_t size)
+    {
+        std::string text;
+        text.reserve(size);
+        auto hex = [&](size_t position)
+        {
+            uint32_t value = 0;
+            for (size_t i = position; i < position + 4 && i < size; i++)
+            {
+                auto c = data[i];
+                value = value * 16 + (uint32_t)(c <= '9' ? c - '0' : (c | 0x20) - 'a' + 10);
+            }
+            return value;
+        };
+
+        for (size_t i = 0; i < size; i++)
+        {
+            if (data[i] != '\\' || i + 1 == size)
+            {
+                text += data[i];
+                continue;
+            }
+            auto c = data[++i];
+            switch (c)
+            {
+            case 'b': text += '\b'; break;
+            case 'f': text += '\f'; break;
+            case 'n': text += '\n'; break;
+            case 'r': text += '\r'; break;
+            case 't': text += '\t'; break;
+            case 'u':
+            {
+                auto codePoint = hex(i + 1);
+                i += 4;
+                if (codePoint >= 0xD800 && codePoint < 0xDC00 && i + 6 < size && data[i + 1] == '\\' && data[i + 2] == 'u')
+                {
+                    codePoint = 0x10000 + ((codePoint - 0xD800) << 10) + (hex(i + 3) - 0xDC00);
+                    i += 6;
+                }
+                if (codePoint < 0x80)
+                {
+                    text += (char)codePoint;
+                }
+                else if (codePoint < 0x800)
+                {
+                    text += (char)(0xC0 | (codePoint >> 6));
+                    text += (char)(0x80 | (codePoint & 0x3F));
+                }
+                else if (codePoint < 0x10000)
+                {
+                    text += (char)(0xE0 | (codePoint >> 12));
+                    text += (char)(0x80 | ((codePoint >> 6) & 0x3F));
+                    text += (char)(0x80 | (codePoint & 0x3F));
+                }
+                else
+                {
+                    text += (char)(0xF0 | (codePoint >> 18));
+                    text += (char)(0x80 | ((codePoint >> 12) & 0x3F));
+                    text += (char)(0x80 | ((codePoint >> 6) & 0x3F));
+                    text += (char)(0x80 | (codePoint & 0x3F));
+                }
+                break;
+            }
+            default:
+                // \" \\ \/
+                text += c;
+                break;
+            }
+        }
+        return text;
+    }
+
+    std::string m_json;
+    mutable std::once_flag m_parsed;
+    mutable Fields m_fields;
+};
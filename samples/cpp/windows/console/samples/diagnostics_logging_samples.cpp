@@ -4,8 +4,14 @@
 //
 #include "stdafx.h"
 #include <speechapi_cxx.h>
+#include <fstream>
+#include "async_trace_file_writer.h"
+#include "session_timeline_recorder.h"
+#include "trace_dispatcher.h"
+#include "trace_ring_buffer.h"
 
 using namespace Microsoft::CognitiveServices::Speech;
+using namespace Microsoft::CognitiveServices::Speech::Audio;
 using namespace Microsoft::CognitiveServices::Speech::Diagnostics::Logging;
 
 // Shows how to enabled Speech SDK trace logging to a file. Microsoft may ask you to collect logs
@@ -173,3 +179,153 @@ void DiagnosticsLoggingMemoryLogger()
     // Clear filters if previously set
     MemoryLogger::SetFilters();
 }
+
+// Shows how to keep the latest traces in memory all the time, with little cost for the threads producing them.
+// The EventLogger callback writes each trace line into a fixed-size, lock-free ring buffer, overwriting the
+// oldest line once it is full. Dumping streams the lines straight to the output, without stopping the logging
+// and without first copying them into a vector of strings.
+void DiagnosticsLoggingRingBuffer()
+{
+    // The latest 4096 lines, at most 512 bytes each.
+    static TraceRingBuffer<> traces(4096);
+
+    EventLogger::SetCallback([](std::string message) {
+            traces.Write(message);
+        });
+
+    // Do your Speech SDK calls... for example:
+    auto config = SpeechConfig::FromSubscription("YourSubscriptionKey", "YourServiceRegion");
+    auto recognizer = SpeechRecognizer::FromConfig(config);
+    auto result = recognizer->RecognizeOnceAsync().get();
+
+    // Dumps the traces when something unexpected happens, while logging goes on.
+    if (result->Reason == ResultReason::Canceled)
+    {
+        std::ofstream logFile("speech-sdk-log.txt");
+        auto count = traces.Dump(logFile);
+        std::cout << "Recognition canceled, dumped the latest " << count << " trace lines to speech-sdk-log.txt\n";
+    }
+
+    // Stop logging by setting an empty callback
+    EventLogger::SetCallback();
+
+    std::cout << "Here are the logs we captured:\n";
+    traces.Dump(std::cout);
+    std::cout << traces.GetWrittenCount() << " lines were logged, " << traces.GetDroppedCount() << " lines were dropped.\n";
+}
+
+// Shows how to log traces to a file without slowing down the threads producing them. The EventLogger callback
+// only appends each line to a batch in memory, a background thread writes the batches to the file and rotates
+// it once it grows beyond a size limit, keeping a few older files.
+void DiagnosticsLoggingAsyncFileWriter()
+{
+    AsyncTraceFileWriter::Settings settings;
+    settings.FlushIntervalMs = 1000;
+    settings.MaxFileBytes = 8 * 1024 * 1024;
+    settings.MaxFiles = 3;
+
+    {
+        AsyncTraceFileWriter writer("speech-sdk-log.txt", settings);
+
+        EventLogger::SetCallback([&writer](std::string message) {
+                writer.Write(message);
+            });
+
+        // Do your Speech SDK calls... for example:
+        auto config = SpeechConfig::FromSubscription("YourSubscriptionKey", "YourServiceRegion");
+        auto recognizer = SpeechRecognizer::FromConfig(config);
+        auto result = recognizer->RecognizeOnceAsync().get();
+
+        // Stop logging by setting an empty callback, before the writer goes away
+        EventLogger::SetCallback();
+
+        // Writes the remaining lines, so the statistics include them.
+        writer.Close();
+        auto statistics = writer.GetStatistics();
+        std::cout << statistics.LinesWritten << " lines written in " << statistics.Batches << " batches, "
+            << statistics.LinesDropped << " lines dropped, " << statistics.Rotations << " rotations.\n";
+        if (!writer.GetError().empty())
+        {
+            std::cout << "Logging stopped early: " << writer.GetError() << "\n";
+        }
+    }
+
+    // Now look at speech-sdk-log.txt.
+}
+
+// Shows how to keep a slow consumer of trace lines (for example log shipping) from holding up the SDK. The
+// EventLogger callback only filters the lines by level, samples and rate-limits them, and queues the rest;
+// a dispatcher thread hands them to the consumer.
+void DiagnosticsLoggingDispatchedEvents()
+{
+    std::vector<std::string> messages;
+
+    TraceDispatcher::Settings settings;
+    settings.MinimumLevel = TraceLevel::Info;
+    settings.SampleEvery = 1;
+    settings.MaxLinesPerSecond = 500;
+
+    {
+        // Runs on the dispatcher thread only, so it needs no lock and may take its time.
+        TraceDispatcher dispatcher([&messages](const std::string& message) {
+                messages.push_back(message);
+            }, settings);
+
+        EventLogger::SetCallback([&dispatcher](std::string message) {
+                dispatcher.OnTrace(std::move(message));
+            });
+
+        // Do your Speech SDK calls... for example:
+        auto config = SpeechConfig::FromSubscription("YourSubscriptionKey", "YourServiceRegion");
+        auto recognizer = SpeechRecognizer::FromConfig(config);
+        auto result = recognizer->RecognizeOnceAsync().get();
+
+        // Stop logging by setting an empty callback, before the dispatcher goes away
+        EventLogger::SetCallback();
+
+        auto statistics = dispatcher.GetStatistics();
+        std::cout << statistics.Received << " lines received, " << statistics.FilteredByLevel << " below the level, "
+            << statistics.SampledOut << " sampled out, " << statistics.RateLimited << " rate limited, "
+            << statistics.QueueFull << " dropped with a full queue.\n";
+    }
+
+    // The dispatcher has delivered the queued lines when it is destroyed.
+    std::cout << "Here are the logs we captured:\n";
+    for (std::string message : messages)
+    {
+        std::cout << message;
+    }
+}
+
+// Shows how to export the timeline of recognition sessions, together with the SDK traces, in the Chrome trace
+// format. Open the resulting file in chrome://tracing or https://ui.perfetto.dev to see how long connecting,
+// the first hypothesis, each utterance and the end of the turn took.
+void DiagnosticsLoggingSessionTimeline()
+{
+    SessionTimelineRecorder timeline;
+
+    EventLogger::SetCallback([&timeline](std::string message) {
+            timeline.OnTrace(message);
+        });
+
+    {
+        auto config = SpeechConfig::FromSubscription("YourSubscriptionKey", "YourServiceRegion");
+        auto audioInput = AudioConfig::FromWavFileInput("whatstheweatherlike.wav");
+        auto recognizer = SpeechRecognizer::FromConfig(config, audioInput);
+        timeline.Attach(recognizer);
+
+        std::promise<void> recognitionEnd;
+        recognizer->SessionStopped.Connect([&recognitionEnd](const SessionEventArgs&) { recognitionEnd.set_value(); });
+
+        recognizer->StartContinuousRecognitionAsync().get();
+        recognitionEnd.get_future().get();
+        recognizer->StopContinuousRecognitionAsync().get();
+    }
+
+    // Stop logging by setting an empty callback
+    EventLogger::SetCallback();
+
+    std::ofstream traceFile("session-timeline.json");
+    timeline.Write(traceFile);
+    std::cout << "Wrote the session timeline to session-timeline.json.\n";
+}
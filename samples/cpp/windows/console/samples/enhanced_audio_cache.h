@@ -0,0 +1,217 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#pragma once
+
+#include <speechapi_cxx.h>
+#include <atomic>
+#include <cstdio>
+#include <fstream>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <sys/stat.h>
+#include "file_replace.h"
+#include "wav_file_reader.h"
+
+// A Microsoft Audio Stack configuration as plain values, as the enhancer and the cache key need them.
+// AudioProcessingOptions cannot be read back, so they cannot serve as the key.
+struct MasSettings
+{
+    int Flags = AUDIO_INPUT_PROCESSING_ENABLE_DEFAULT;
+    // A preset geometry, or Custom for the microphones below.
+    Microsoft::CognitiveServices::Speech::Audio::PresetMicrophoneArrayGeometry Preset = Microsoft::CognitiveServices::Speech::Audio::PresetMicrophoneArrayGeometry::Uninitialized;
+    Microsoft::CognitiveServices::Speech::Audio::MicrophoneArrayType ArrayType = Microsoft::CognitiveServices::Speech::Audio::MicrophoneArrayType::Planar;
+    uint16_t BeamformingStartAngle = 0;
+    uint16_t BeamformingEndAngle = 180;
+    std::vector<Microsoft::CognitiveServices::Speech::Audio::MicrophoneCoordinates> Microphones;
+    Microsoft::CognitiveServices::Speech::Audio::SpeakerReferenceChannel Reference = Microsoft::CognitiveServices::Speech::Audio::SpeakerReferenceChannel::None;
+
+    // All values as text, e.g. "flags=0 preset=6 type=1 angles=0-180 mics=0,0,0;40,0,0 reference=1".
+    std::string Describe() const
+    {
+        std::string text = "flags=" + std::to_string(Flags) + " preset=" + std::to_string((int)Preset);
+        if (Preset == Microsoft::CognitiveServices::Speech::Audio::PresetMicrophoneArrayGeometry::Custom)
+        {
+            text += " type=" + std::to_string((int)ArrayType) + " angles=" + std::to_string(BeamformingStartAngle) + "-" + std::to_string(BeamformingEndAngle) + " mics=";
+            for (size_t i = 0; i < Microphones.size(); i++)
+            {
+                text += (i == 0 ? "" : ";") + std::to_string(Microphones[i].X) + "," + std::to_string(Microphones[i].Y) + "," + std::to_string(Microphones[i].Z);
+            }
+        }
+        return text + " reference=" + std::to_string((int)Reference);
+    }
+};
+
+// Runs the Microsoft Audio Stack over a multi-channel WAV file once per configuration, and reuses the enhanced mono
+// audio on later runs, so a sweep over recognition settings does not repeat beamforming, echo cancellation and noise
+// suppression for every run. The enhanced audio is stored next to the source as "<source>.mas-<key>.wav", where the
+// key is a hash of the content of the source and of the settings: editing the file or changing a flag gives another
+// key, and artifacts are never reused for audio they were not made from.
+// The Speech SDK applies the audio stack inside the recognizer and does not hand out the processed audio, so the
+// cache does not enhance anything itself: the Enhancer given to it does, e.g. a run of a standalone audio stack tool.
+// In the sample the enhancer is a placeholder shell command that has to be replaced with such a tool.
+class EnhancedAudioCache final
+{
+public:
+    // Enhances 'source' with 'settings' and writes the result to 'output' as a mono WAV file.
+    using Enhancer = std::function<void(const std::string& source, const MasSettings& settings, const std::string& output)>;
+
+    explicit EnhancedAudioCache(Enhancer enhancer)
+        : m_enhancer(std::move(enhancer))
+    {
+    }
+
+    EnhancedAudioCache(const EnhancedAudioCache&) = delete;
+    EnhancedAudioCache& operator=(const EnhancedAudioCache&) = delete;
+
+    // Returns the path of the enhanced audio of 'source', running the enhancer only if it is not there yet.
+    // 'created' tells whether it ran. Concurrent calls for the same audio wait for one enhancement.
+    // Throws std::runtime_error if the source cannot be read or the enhancer leaves no mono WAV file.
+    std::string GetOrCreate(const std::string& source, const MasSettings& settings, bool* created = nullptr)
+    {
+        auto path = PathFor(source, KeyFor(source, settings));
+        if (created != nullptr)
+        {
+            *created = false;
+        }
+
+        std::shared_ptr<std::mutex> pathMutex;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            auto& entry = m_pathMutexes[path];
+            if (entry == nullptr)
+            {
+                entry = std::make_shared<std::mutex>();
+            }
+            pathMutex = entry;
+        }
+        std::lock_guard<std::mutex> pathLock(*pathMutex);
+        if (std::ifstream(path, std::ios::binary))
+        {
+            ++m_hits;
+            return path;
+        }
+
+        // Writes to a temporary file first, so an interrupted run does not leave an artifact that looks complete.
+        auto temporaryPath = path + ".tmp";
+        std::remove(temporaryPath.c_str());
+        try
+        {
+            m_enhancer(source, settings, temporaryPath);
+            WavFileReader reader(temporaryPath);
+            if (reader.GetFormat().Channels != 1)
+            {
+                throw std::runtime_error("The enhanced audio has " + std::to_string(reader.GetFormat().Channels) + " channels, mono is expected.");
+            }
+        }
+        catch (const std::exception&)
+        {
+            std::remove(temporaryPath.c_str());
+            throw;
+        }
+        if (!MoveFileOver(temporaryPath, path))
+        {
+            std::remove(temporaryPath.c_str());
+            throw std::runtime_error("Cannot store the enhanced audio as " + path);
+        }
+        ++m_misses;
+        if (created != nullptr)
+        {
+            *created = true;
+        }
+        return path;
+    }
+
+    // Returns a 64-bit FNV-1a hash over the bytes of 'source' and the description of 'settings' as 16 hex digits.
+    // The hash of the file is remembered by path, size and modification time, so each file is read once per process.
+    std::string KeyFor(const std::string& source, const MasSettings& settings)
+    {
+        uint64_t hash = ContentHash(source);
+        auto description = std::to_string(settings.Describe().size()) + ":" + settings.Describe();
+        for (unsigned char c : description)
+        {
+            hash = (hash ^ c) * fnvPrime;
+        }
+
+        char key[17];
+        snprintf(key, sizeof(key), "%016llx", (unsigned long long)hash);
+        return key;
+    }
+
+    // "recording.wav" and key "0123..." give "recording.mas-0123....wav".
+    static std::string PathFor(const std::string& source, const std::string& key)
+    {
+        auto base = source;
+        auto extension = base.rfind('.');
+        auto separator = base.find_last_of("/\\");
+        if (extension != std::string::npos && (separator == std::string::npos || extension > separator))
+        {
+            base.erase(extension);
+        }
+        return base + ".mas-" + key + ".wav";
+    }
+
+    uint64_t Hits() const { return m_hits; }
+    uint64_t Misses() const { return m_misses; }
+
+private:
+    struct FileHash
+    {
+        uint64_t Size;
+        int64_t Modified;
+        uint64_t Hash;
+    };
+
+    static constexpr uint64_t fnvOffsetBasis = 14695981039346656037ULL;
+    static constexpr uint64_t fnvPrime = 1099511628211ULL;
+
+    uint64_t ContentHash(const std::string& source)
+    {
+        struct stat status;
+        if (stat(source.c_str(), &status) != 0)
+        {
+            throw std::runtime_error("Cannot open " + source);
+        }
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            auto known = m_fileHashes.find(source);
+            if (known != m_fileHashes.end() && known->second.Size == (uint64_t)status.st_size && known->second.Modified == (int64_t)status.st_mtime)
+            {
+                return known->second.Hash;
+            }
+        }
+
+        std::ifstream file(source, std::ios::binary);
+        if (!file)
+        {
+            throw std::runtime_error("Cannot open " + source);
+        }
+        uint64_t hash = fnvOffsetBasis;
+        std::vector<char> buffer(1 << 16);
+        while (file.read(buffer.data(), buffer.size()) || file.gcount() > 0)
+        {
+            for (std::streamsize i = 0; i < file.gcount(); i++)
+            {
+                hash = (hash ^ (unsigned char)buffer[i]) * fnvPrime;
+            }
+        }
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_fileHashes[source] = { (uint64_t)status.st_size, (int64_t)status.st_mtime, hash };
+        return hash;
+    }
+
+    const Enhancer m_enhancer;
+
+    std::mutex m_mutex;
+    std::map<std::string, std::shared_ptr<std::mutex>> m_pathMutexes;
+    std::map<std::string, FileHash> m_fileHashes;
+    std::atomic<uint64_t> m_hits{ 0 };
+    std::atomic<uint64_t> m_misses{ 0 };
+};
@@ -0,0 +1,32 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#pragma once
+
+#include <cstdio>
+#include <string>
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#endif
+
+// Moves 'from' over 'to' in one step: readers and a crash see either the old or the new 'to', never no file at all.
+// Both must be on the same volume, e.g. a temporary file written next to the target. Returns false on failure, and
+// 'to' is then unchanged.
+inline bool MoveFileOver(const std::string& from, const std::string& to)
+{
+#ifdef _WIN32
+    // std::rename does not replace an existing file on Windows, MOVEFILE_REPLACE_EXISTING does.
+    return MoveFileExA(from.c_str(), to.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+#else
+    // POSIX rename replaces the target atomically.
+    return std::rename(from.c_str(), to.c_str()) == 0;
+#endif
+}
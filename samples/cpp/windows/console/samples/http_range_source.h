@@ -0,0 +1,302 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <functional>
+#include <limits>
+#include <map>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include "wav_file_reader.h"
+
+// Audio source for a WAV file on a web server or in blob storage (e.g. behind a SAS URL), so it can be recognized
+// locally without downloading it first. The header is fetched once; then 'Concurrency' threads fetch blocks of the
+// audio data with HTTP range requests, up to 'MaxBlocksAhead' blocks ahead of Read(), and Read() hands them out in
+// order. Recognition starts as soon as the first block has arrived, and downloading overlaps with recognition.
+// Use it with PullCallback<HttpRangeSource> or ReadAheadAudioCallback, in the format returned by GetFormat().
+class HttpRangeSource final
+{
+public:
+    // Returns the bytes from 'offset' on, 'size' of them or fewer at the end of the file, e.g. with a request with
+    // "Range: bytes=<offset>-<offset + size - 1>", and no bytes for a range past the end (416 Range Not Satisfiable).
+    // Throws on failure, which includes any other status than 206 Partial Content: a server that ignores the range
+    // answers 200 with the whole file.
+    using RangeFetcher = std::function<std::vector<uint8_t>(uint64_t offset, uint32_t size)>;
+
+    struct Settings
+    {
+        uint32_t BlockSize = 256 * 1024;
+        size_t Concurrency = 4;
+        size_t MaxBlocksAhead = 8;
+        // Attempts per block before the stream ends with an error.
+        uint32_t MaxAttempts = 3;
+        // The 'fmt ' and 'data' chunk headers must be within this many bytes from the start of the file.
+        uint32_t HeaderSize = 64 * 1024;
+    };
+
+    struct Statistics
+    {
+        uint64_t Blocks = 0;
+        uint64_t Bytes = 0;
+        uint64_t Retries = 0;
+        // Reads that had to wait for a block, and the longest wait. The wait for the first block is included.
+        uint64_t Stalls = 0;
+        std::chrono::milliseconds MaxStall{ 0 };
+        // Time from the start of the source until the first audio block was there.
+        std::chrono::milliseconds FirstBlock{ 0 };
+    };
+
+    explicit HttpRangeSource(RangeFetcher fetcher)
+        : HttpRangeSource(std::move(fetcher), Settings())
+    {
+    }
+
+    // Fetches and parses the header before returning. Throws std::runtime_error if it is not a WAV header, or what
+    // the fetcher throws.
+    HttpRangeSource(RangeFetcher fetcher, const Settings& settings)
+        : m_fetcher(std::move(fetcher)), m_settings(settings), m_started(Clock::now())
+    {
+        if (m_settings.BlockSize == 0 || m_settings.Concurrency == 0 || m_settings.MaxBlocksAhead < m_settings.Concurrency)
+        {
+            throw std::invalid_argument("The range source needs a block size, and at least as many blocks ahead as fetches in flight.");
+        }
+        ParseHeader(m_fetcher(0, m_settings.HeaderSize));
+        for (size_t i = 0; i < m_settings.Concurrency; i++)
+        {
+            m_threads.emplace_back([this]() { Fetch(); });
+        }
+    }
+
+    HttpRangeSource(const HttpRangeSource&) = delete;
+    HttpRangeSource& operator=(const HttpRangeSource&) = delete;
+
+    ~HttpRangeSource()
+    {
+        Close();
+    }
+
+    const WavFileReader::WAVEFORMAT& GetFormat() const
+    {
+        return m_format;
+    }
+
+    // Copies up to 'size' bytes of the next block, waiting for it if it has not arrived yet.
+    // Returns 0 at the end of the audio, after Close(), or when the next block could not be fetched, see GetError().
+    // The blocks before one that failed are all handed out first.
+    int Read(uint8_t* dataBuffer, uint32_t size)
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        auto ready = [this]() { return m_blocks.count(m_readBlock) > 0 || m_readBlock >= m_endBlock || m_closed; };
+        if (!ready())
+        {
+            auto waitStarted = Clock::now();
+            m_blockArrived.wait(lock, ready);
+            auto wait = std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - waitStarted);
+            m_statistics.Stalls++;
+            m_statistics.MaxStall = std::max(m_statistics.MaxStall, wait);
+        }
+        auto block = m_blocks.find(m_readBlock);
+        if (block == m_blocks.end() || m_closed)
+        {
+            return 0;
+        }
+
+        auto count = (uint32_t)std::min<size_t>(size, block->second.size() - m_readOffset);
+        memcpy(dataBuffer, block->second.data() + m_readOffset, count);
+        m_readOffset += count;
+        if (m_readOffset == block->second.size())
+        {
+            m_blocks.erase(block);
+            m_readBlock++;
+            m_readOffset = 0;
+            m_blockConsumed.notify_all();
+        }
+        return (int)count;
+    }
+
+    // Stops fetching. Blocks in flight are discarded when they arrive.
+    void Close()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_closed = true;
+        }
+        m_blockConsumed.notify_all();
+        m_blockArrived.notify_all();
+        for (auto& thread : m_threads)
+        {
+            if (thread.joinable())
+            {
+                thread.join();
+            }
+        }
+    }
+
+    // The error that ended the stream early, or an empty string.
+    std::string GetError()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_error;
+    }
+
+    Statistics GetStatistics()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_statistics;
+    }
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    void ParseHeader(const std::vector<uint8_t>& header)
+    {
+        if (header.size() < 12 || memcmp(header.data(), "RIFF", 4) != 0 || memcmp(header.data() + 8, "WAVE", 4) != 0)
+        {
+            throw std::runtime_error("Invalid file header, tags 'RIFF' and 'WAVE' are expected.");
+        }
+        bool foundFormatChunk = false;
+        size_t offset = 12;
+        while (offset + 8 <= header.size())
+        {
+            auto chunk = header.data() + offset;
+            uint32_t chunkSize = (uint32_t)chunk[4] | ((uint32_t)chunk[5] << 8) | ((uint32_t)chunk[6] << 16) | ((uint32_t)chunk[7] << 24);
+            if (memcmp(chunk, "fmt ", 4) == 0)
+            {
+                if (chunkSize < sizeof(m_format) || offset + 8 + sizeof(m_format) > header.size())
+                {
+                    throw std::runtime_error("Invalid format chunk.");
+                }
+                memcpy(&m_format, chunk + 8, sizeof(m_format));
+                foundFormatChunk = true;
+            }
+            else if (memcmp(chunk, "data", 4) == 0)
+            {
+                if (!foundFormatChunk)
+                {
+                    throw std::runtime_error("Did not find format chunk before data chunk.");
+                }
+                m_dataOffset = offset + 8;
+                if (chunkSize == 0 || chunkSize == UINT32_MAX)
+                {
+                    // Files written while streaming have a placeholder size: the audio goes up to the end of the file,
+                    // and the first short or empty block ends it.
+                    m_dataSize = 0;
+                    m_endBlock = std::numeric_limits<uint64_t>::max();
+                }
+                else
+                {
+                    m_dataSize = chunkSize;
+                    m_endBlock = ((uint64_t)chunkSize + m_settings.BlockSize - 1) / m_settings.BlockSize;
+                }
+                return;
+            }
+            // Chunks are word aligned, odd sized chunks are followed by a pad byte.
+            offset += 8 + (size_t)chunkSize + (chunkSize & 1);
+        }
+        throw std::runtime_error("Did not find the data chunk in the first " + std::to_string(m_settings.HeaderSize) + " bytes.");
+    }
+
+    void Fetch()
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        while (true)
+        {
+            m_blockConsumed.wait(lock, [this]()
+            {
+                return m_closed || m_nextBlock >= m_endBlock || m_nextBlock < m_readBlock + m_settings.MaxBlocksAhead;
+            });
+            if (m_closed || m_nextBlock >= m_endBlock)
+            {
+                return;
+            }
+            auto index = m_nextBlock++;
+            auto offset = index * m_settings.BlockSize;
+            auto size = m_dataSize == 0 ? m_settings.BlockSize : (uint32_t)std::min<uint64_t>(m_settings.BlockSize, m_dataSize - offset);
+
+            // The request is the slow part and runs without the lock, in parallel with the other threads.
+            lock.unlock();
+            std::vector<uint8_t> data;
+            std::string error;
+            for (uint32_t attempt = 1; attempt <= m_settings.MaxAttempts; attempt++)
+            {
+                try
+                {
+                    data = m_fetcher(m_dataOffset + offset, size);
+                    error.clear();
+                    break;
+                }
+                catch (const std::exception& e)
+                {
+                    error = e.what();
+                    std::lock_guard<std::mutex> retryLock(m_mutex);
+                    m_statistics.Retries += attempt < m_settings.MaxAttempts ? 1 : 0;
+                }
+            }
+            lock.lock();
+
+            // Without a known size, only the end of the file may cut a block short.
+            if (error.empty() && (data.size() > size || (data.size() < size && m_dataSize != 0)))
+            {
+                error = "expected " + std::to_string(size) + " bytes, received " + std::to_string(data.size());
+            }
+            if (!error.empty())
+            {
+                // The stream ends before this block, after the blocks before it that are still in flight. The block
+                // that failed first is the one that ends the stream.
+                if (index < m_endBlock)
+                {
+                    m_endBlock = index;
+                    m_error = "Cannot fetch bytes " + std::to_string(m_dataOffset + offset) + "-: " + error;
+                }
+            }
+            else if (data.empty())
+            {
+                m_endBlock = std::min(m_endBlock, index);
+            }
+            else
+            {
+                if (data.size() < size)
+                {
+                    m_endBlock = std::min(m_endBlock, index + 1);
+                }
+                if (m_statistics.Blocks++ == 0)
+                {
+                    m_statistics.FirstBlock = std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - m_started);
+                }
+                m_statistics.Bytes += data.size();
+                m_blocks[index] = std::move(data);
+            }
+            m_blockArrived.notify_all();
+        }
+    }
+
+    const RangeFetcher m_fetcher;
+    const Settings m_settings;
+    const Clock::time_point m_started;
+    WavFileReader::WAVEFORMAT m_format{};
+    uint64_t m_dataOffset = 0;
+    uint64_t m_dataSize = 0;
+
+    std::mutex m_mutex;
+    std::condition_variable m_blockArrived;
+    std::condition_variable m_blockConsumed;
+    // Blocks that arrived and have not been read completely yet, by index.
+    std::map<uint64_t, std::vector<uint8_t>> m_blocks;
+    uint64_t m_nextBlock = 0;
+    uint64_t m_readBlock = 0;
+    size_t m_readOffset = 0;
+    uint64_t m_endBlock = 0;
+    std::string m_error;
+    bool m_closed = false;
+    Statistics m_statistics;
+    std::vector<std::thread> m_threads;
+};
@@ -7,6 +7,8 @@
 
 // <toplevel>
 #include <speechapi_cxx.h>
+#include "recognition_session_runner.h"
+#include "pattern_automaton.h"
 
 using namespace Microsoft::CognitiveServices::Speech;
 using namespace Microsoft::CognitiveServices::Speech::Audio;
@@ -36,6 +38,10 @@ void IntentRecognitionWithMicrophone()
     recognizer->AddIntent(model, "YourLanguageUnderstandingIntentName2", "id2");
     recognizer->AddIntent(model, "YourLanguageUnderstandingIntentName3", "any-IntentId-here");
 
+    // Opens the connection ahead of recognition, as in SpeechRecognitionWithMicrophone().
+    auto connection = Connection::FromRecognizer(recognizer);
+    connection->Open(false);
+
     std::cout << "Say something..." << std::endl;
 
     // Starts intent recognition, and returns after a single utterance is recognized. The end of a
@@ -153,14 +159,15 @@ void IntentContinuousRecognitionWithFile()
     // and service region (e.g., "westus").
     auto config = SpeechConfig::FromSubscription("YourLanguageUnderstandingSubscriptionKey", "YourLanguageUnderstandingServiceRegion");
 
+    // Runs the event handlers on the shared event dispatch executor instead of the SDK callback thread,
+    // and ends the session on cancellation or session stop.
+    RecognitionSessionRunner session;
+
     // Creates an intent recognizer using file as audio input.
     // Replace with your own audio file name.
     auto audioInput = AudioConfig::FromWavFileInput("whatstheweatherlike.wav");
     auto recognizer = IntentRecognizer::FromConfig(config, audioInput);
 
-    // std::promise for synchronization of recognition end.
-    std::promise<void> recognitionEnd;
-
     // Creates a Language Understanding model using the app id, and adds specific intents from your model
     auto model = LanguageUnderstandingModel::FromAppId("YourLanguageUnderstandingAppId");
     recognizer->AddIntent(model, "YourLanguageUnderstandingIntentName1", "id1");
@@ -168,30 +175,30 @@ void IntentContinuousRecognitionWithFile()
     recognizer->AddIntent(model, "YourLanguageUnderstandingIntentName3", "any-IntentId-here");
 
     // Subscribes to events.
-    recognizer->Recognizing.Connect([](const IntentRecognitionEventArgs& e)
+    session.OnPartial(recognizer->Recognizing, [](const std::shared_ptr<IntentRecognitionResult>& result)
         {
-            std::cout << "Recognizing:" << e.Result->Text << std::endl;
+            std::cout << "Recognizing:" << result->Text << std::endl;
         });
 
-    recognizer->Recognized.Connect([](const IntentRecognitionEventArgs& e)
+    session.OnFinal(recognizer->Recognized, [](const std::shared_ptr<IntentRecognitionResult>& result)
         {
-            if (e.Result->Reason == ResultReason::RecognizedIntent)
+            if (result->Reason == ResultReason::RecognizedIntent)
             {
-                std::cout << "RECOGNIZED: Text=" << e.Result->Text << std::endl;
-                std::cout << "  Intent Id: " << e.Result->IntentId << std::endl;
-                std::cout << "  Intent Service JSON: " << e.Result->Properties.GetProperty(PropertyId::LanguageUnderstandingServiceResponse_JsonResult) << std::endl;
+                std::cout << "RECOGNIZED: Text=" << result->Text << std::endl;
+                std::cout << "  Intent Id: " << result->IntentId << std::endl;
+                std::cout << "  Intent Service JSON: " << result->Properties.GetProperty(PropertyId::LanguageUnderstandingServiceResponse_JsonResult) << std::endl;
             }
-            else if (e.Result->Reason == ResultReason::RecognizedSpeech)
+            else if (result->Reason == ResultReason::RecognizedSpeech)
             {
-                std::cout << "RECOGNIZED: Text=" << e.Result->Text << " (intent could not be recognized)" << std::endl;
+                std::cout << "RECOGNIZED: Text=" << result->Text << " (intent could not be recognized)" << std::endl;
             }
-            else if (e.Result->Reason == ResultReason::NoMatch)
+            else if (result->Reason == ResultReason::NoMatch)
             {
                 std::cout << "NOMATCH: Speech could not be recognized." << std::endl;
             }
         });
 
-    recognizer->Canceled.Connect([&recognitionEnd](const IntentRecognitionCanceledEventArgs& e)
+    session.OnCanceled(recognizer->Canceled, [](const RecognitionSessionRunner::CancellationInfo& e)
         {
             std::cout << "CANCELED: Reason=" << (int)e.Reason << std::endl;
 
@@ -201,24 +208,15 @@ void IntentContinuousRecognitionWithFile()
                 std::cout << "CANCELED: ErrorDetails=" << e.ErrorDetails << std::endl;
                 std::cout << "CANCELED: Did you update the subscription info?" << std::endl;
             }
-
-            recognitionEnd.set_value(); // Notify to stop recognition.
         });
 
-    recognizer->SessionStopped.Connect([&recognitionEnd](const SessionEventArgs& e)
+    session.OnSessionStopped(recognizer->SessionStopped, []()
         {
             std::cout << "Session stopped.";
-            recognitionEnd.set_value(); // Notify to stop recognition.
         });
 
-    // Starts continuous recognition. Uses StopContinuousRecognitionAsync() to stop recognition.
-    recognizer->StartContinuousRecognitionAsync().get();
-
-    // Waits for recognition end.
-    recognitionEnd.get_future().get();
-
-    // Stops recognition.
-    recognizer->StopContinuousRecognitionAsync().get();
+    // Starts continuous recognition, waits for the end of the session and stops recognition.
+    session.RunContinuous(*recognizer);
     // </IntentContinuousRecognitionWithFile>
 }
 
@@ -339,3 +337,74 @@ void IntentRecognitionWithPatternMatchingAndMicrophone()
     }
     // </IntentRecognitionWithPatternMatchingAndMicrophone>
 }
+
+// Intent recognition with patterns compiled ahead of time, matched locally on the recognized text.
+void IntentRecognitionWithCompiledPatterns()
+{
+    // Compiles the patterns once and saves them; later runs (and other processes) only load the compiled file.
+    // In a deployment, compiling is a build step over the full pattern set.
+    const std::string compiledPatternsFile = "patterns.pma";
+    std::shared_ptr<const PatternAutomaton> automaton;
+    try
+    {
+        automaton = PatternAutomaton::Load(compiledPatternsFile);
+    }
+    catch (const std::runtime_error&)
+    {
+        auto model = PatternMatchingModel::FromModelId("YourPatternMatchingModelId");
+        model->Intents.push_back({ {"[Go | Take me] to [floor|level] {floorName}", "Go to parking [{parkingLevel}]",
+            "Go to floor {floorName:1} [and then go to floor {floorName:2}]", "{floorName}"}, "ChangeFloors" });
+        model->Intents.push_back({ {"{action} the doors", "{action} doors", "{action} the door", "{action} door"}, "DoorControl" });
+        model->Entities.push_back({ "floorName" , Intent::EntityType::List, Intent::EntityMatchMode::Strict, {"ground floor", "lobby", "1st", "first", "one", "1", "2nd", "second", "two", "2"}});
+        model->Entities.push_back({ "parkingLevel" , Intent::EntityType::PrebuiltInteger});
+
+        automaton = PatternAutomaton::Compile(*model);
+        automaton->Save(compiledPatternsFile);
+        std::cout << "Compiled the patterns into " << automaton->GetNodeCount() << " nodes, saved to " << compiledPatternsFile << std::endl;
+    }
+
+    // Creates an instance of a speech config with specified subscription key and service region.
+    // Replace with your own subscription key and service region (e.g., "westus").
+    auto config = SpeechConfig::FromSubscription("YourSubscriptionKey", "YourServiceRegion");
+
+    // Plain speech recognition is enough, the intents are matched on the text. The same automaton can be
+    // used by any number of recognizers at the same time.
+    auto recognizer = SpeechRecognizer::FromConfig(config);
+
+    std::cout << "Say something..." << std::endl;
+    auto result = recognizer->RecognizeOnceAsync().get();
+
+    if (result->Reason == ResultReason::RecognizedSpeech)
+    {
+        std::cout << "RECOGNIZED: Text=" << result->Text << std::endl;
+        PatternAutomaton::Match match;
+        if (automaton->Find(result->Text, match))
+        {
+            std::cout << "  Intent Id: " << match.IntentId << std::endl;
+            for (const auto& entity : match.Entities)
+            {
+                std::cout << "  " << entity.first << " = " << entity.second << std::endl;
+            }
+        }
+        else
+        {
+            std::cout << "  (intent could not be recognized)" << std::endl;
+        }
+    }
+    else if (result->Reason == ResultReason::NoMatch)
+    {
+        std::cout << "NOMATCH: Speech could not be recognized." << std::endl;
+    }
+    else if (result->Reason == ResultReason::Canceled)
+    {
+        auto cancellation = CancellationDetails::FromResult(result);
+        std::cout << "CANCELED: Reason=" << (int)cancellation->Reason << std::endl;
+
+        if (cancellation->Reason == CancellationReason::Error)
+        {
+            std::cout << "CANCELED: ErrorCode=" << (int)cancellation->ErrorCode << std::endl;
+            std::cout << "CANCELED: ErrorDetails=" << cancellation->ErrorDetails << std::endl;
+            std::cout << "CANCELED: Did you update the subscription info?" << std::endl;
+        }
+    }
+}
@@ -0,0 +1,52 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#pragma once
+
+#include <speechapi_cxx.h>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+
+// Process-wide cache of keyword recognition models, so that many always-on keyword streams share one
+// loaded KeywordRecognitionModel instead of loading the .table file once per stream. A model is loaded on
+// first use and the cache keeps it loaded until Unload(), so streams that come and go do not reload it.
+// The model is read-only once loaded; the same instance can be passed to StartKeywordRecognitionAsync() of any
+// number of recognizers at the same time.
+class KeywordModelCache final
+{
+public:
+    // Throws like KeywordRecognitionModel::FromFile() if the model cannot be loaded.
+    static std::shared_ptr<Microsoft::CognitiveServices::Speech::KeywordRecognitionModel> Get(const std::string& fileName)
+    {
+        auto& cache = Instance();
+        std::lock_guard<std::mutex> lock(cache.m_mutex);
+        auto& model = cache.m_models[fileName];
+        if (!model)
+        {
+            // Loading under the lock: concurrent first users of the same file wait instead of loading it twice.
+            model = Microsoft::CognitiveServices::Speech::KeywordRecognitionModel::FromFile(fileName);
+        }
+        return model;
+    }
+
+    // Drops the cache's reference; the model is freed once the recognizers and callers holding it let go of it.
+    static void Unload(const std::string& fileName)
+    {
+        auto& cache = Instance();
+        std::lock_guard<std::mutex> lock(cache.m_mutex);
+        cache.m_models.erase(fileName);
+    }
+
+private:
+    static KeywordModelCache& Instance()
+    {
+        static KeywordModelCache cache;
+        return cache;
+    }
+
+    std::mutex m_mutex;
+    std::map<std::string, std::shared_ptr<Microsoft::CognitiveServices::Speech::KeywordRecognitionModel>> m_models;
+};
@@ -0,0 +1,175 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#pragma once
+
+#include <speechapi_cxx.h>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include "detailed_result_view.h"
+
+// Remembers the language each caller speaks, so their sessions skip language identification once it is known.
+// A caller whose language was detected 'ConfirmationsToCommit' times in a row gets recognizers with that single
+// language; everybody else gets the auto-detect config. A committed session whose best hypothesis has a confidence
+// below 'MinConfidence', or that ends with NoMatch, counts as a disagreement: the caller goes back to auto-detect
+// until the language is confirmed again, and the result should be recognized again with auto-detect. A canceled
+// session, e.g. after a network error, says nothing about the language and is left out.
+// Every 'RecheckEvery'-th session of a committed caller also runs auto-detect, to notice a change of language.
+// The confidence check needs detailed results, see SpeechConfig::SetOutputFormat(OutputFormat::Detailed).
+class LanguageDecisionCache final
+{
+public:
+    struct Settings
+    {
+        uint32_t ConfirmationsToCommit = 2;
+        double MinConfidence = 0.5;
+        uint32_t RecheckEvery = 20;
+    };
+
+    struct Statistics
+    {
+        uint64_t CommittedSessions = 0;
+        uint64_t AutoDetectSessions = 0;
+        uint64_t Disagreements = 0;
+    };
+
+    struct Session
+    {
+        std::shared_ptr<Microsoft::CognitiveServices::Speech::SpeechRecognizer> Recognizer;
+        // The language the session was started with, empty when it runs with auto-detect.
+        std::string CommittedLanguage;
+    };
+
+    LanguageDecisionCache()
+        : LanguageDecisionCache(Settings())
+    {
+    }
+
+    explicit LanguageDecisionCache(const Settings& settings)
+        : m_settings(settings)
+    {
+    }
+
+    // Creates the recognizer for a session of 'caller': with the committed language of the caller if there is one,
+    // with 'autoDetectConfig' otherwise.
+    Session CreateRecognizer(const std::string& caller,
+        const std::shared_ptr<Microsoft::CognitiveServices::Speech::SpeechConfig>& config,
+        const std::shared_ptr<Microsoft::CognitiveServices::Speech::AutoDetectSourceLanguageConfig>& autoDetectConfig,
+        const std::shared_ptr<Microsoft::CognitiveServices::Speech::Audio::AudioConfig>& audioInput)
+    {
+        using namespace Microsoft::CognitiveServices::Speech;
+
+        Session session;
+        session.CommittedLanguage = Lookup(caller);
+        session.Recognizer = session.CommittedLanguage.empty()
+            ? SpeechRecognizer::FromConfig(config, autoDetectConfig, audioInput)
+            : SpeechRecognizer::FromConfig(config, session.CommittedLanguage, audioInput);
+        return session;
+    }
+
+    // Learns from the result of a session created by CreateRecognizer(). Returns false when the session was
+    // committed to a language the result disagrees with; the audio should then be recognized again with auto-detect.
+    // Canceled results are ignored and return true.
+    bool Complete(const std::string& caller, const Session& session, const std::shared_ptr<Microsoft::CognitiveServices::Speech::SpeechRecognitionResult>& result)
+    {
+        using namespace Microsoft::CognitiveServices::Speech;
+
+        if (result->Reason == ResultReason::Canceled)
+        {
+            return true;
+        }
+        if (session.CommittedLanguage.empty())
+        {
+            // A NoMatch may still come with the detected language; no language at all teaches nothing.
+            auto language = AutoDetectSourceLanguageResult::FromResult(result)->Language;
+            if (!language.empty())
+            {
+                RecordDetected(caller, language);
+            }
+            return true;
+        }
+
+        auto accepted = true;
+        if (result->Reason == ResultReason::NoMatch)
+        {
+            accepted = false;
+        }
+        else if (result->Reason == ResultReason::RecognizedSpeech)
+        {
+            DetailedResultView detailed(result);
+            const auto& nbest = detailed.GetNBest();
+            accepted = nbest.empty() || nbest[0].Confidence >= m_settings.MinConfidence;
+        }
+        if (!accepted)
+        {
+            RecordDisagreement(caller);
+        }
+        return accepted;
+    }
+
+    // Returns the committed language of 'caller', or an empty string when the session should run with auto-detect.
+    std::string Lookup(const std::string& caller)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto entry = m_callers.find(caller);
+        if (entry != m_callers.end() && entry->second.Confirmations >= m_settings.ConfirmationsToCommit)
+        {
+            if (++entry->second.SessionsSinceCheck < m_settings.RecheckEvery)
+            {
+                m_statistics.CommittedSessions++;
+                return entry->second.Language;
+            }
+            entry->second.SessionsSinceCheck = 0;
+        }
+        m_statistics.AutoDetectSessions++;
+        return std::string();
+    }
+
+    // Records the language detected in an auto-detect session of 'caller'.
+    void RecordDetected(const std::string& caller, const std::string& language)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto& entry = m_callers[caller];
+        if (entry.Language == language)
+        {
+            entry.Confirmations++;
+        }
+        else
+        {
+            entry.Language = language;
+            entry.Confirmations = 1;
+            entry.SessionsSinceCheck = 0;
+        }
+    }
+
+    // Takes back the committed language of 'caller' until auto-detect confirms a language again.
+    void RecordDisagreement(const std::string& caller)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_callers[caller].Confirmations = 0;
+        m_statistics.Disagreements++;
+    }
+
+    Statistics GetStatistics()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_statistics;
+    }
+
+private:
+    struct Entry
+    {
+        std::string Language;
+        uint32_t Confirmations = 0;
+        uint32_t SessionsSinceCheck = 0;
+    };
+
+    const Settings m_settings;
+
+    std::mutex m_mutex;
+    std::map<std::string, Entry> m_callers;
+    Statistics m_statistics;
+};
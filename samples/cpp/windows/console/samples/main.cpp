@@ -5,6 +5,7 @@
 #include "stdafx.h"
 #include <iostream>
 #include <string>
+#include <vector>
 
 using namespace std;
 
@@ -21,14 +22,34 @@ extern void SpeechRecognitionFromMicrophoneWithMASEnabledAndPresetGeometrySpecif
 extern void SpeechContinuousRecognitionFromMultiChannelFileWithMASEnabledAndCustomGeometrySpecified();
 extern void SpeechRecognitionFromPullStreamWithSelectMASEnhancementsEnabled();
 extern void SpeechContinuousRecognitionFromPushStreamWithMASEnabledAndBeamformingAnglesSpecified();
+extern void SpeechContinuousRecognitionBatchWithFiles();
+extern void SpeechContinuousRecognitionWithPacedPushStream();
+extern void SpeechContinuousRecognitionPerChannelWithPullStream();
+extern void SpeechRecognitionWithWarmRecognizerPool();
+extern void SpeechContinuousRecognitionWithFileSharded();
+extern void SpeechContinuousRecognitionWithPullStreamAndResume();
+extern void SpeechContinuousRecognitionWithFormatConversion();
+extern void SpeechContinuousRecognitionWithOpusPushStream();
+extern void SpeechContinuousRecognitionWithMetrics();
+extern void PronunciationAssessmentBatchFromManifest();
+extern void KeywordRecognitionMemoryPerStream();
+extern void SpeechContinuousRecognitionToTranscriptStore();
+extern void SpeechRecognitionSweepWithCachedMASEnhancedAudio();
+extern void SpeechRecognitionWithRegionFailover();
+extern void SpeechRecognitionWithBackgroundTokenRefresh();
+extern void SpeechRecognitionFromBlobWithRangeRequests();
+extern void SpeechRecognitionWithThrottledPartials();
+extern void SpeechRecognitionWithWarmCustomEndpoints();
 
 extern void IntentRecognitionWithMicrophone();
 extern void IntentRecognitionWithPatternMatchingAndMicrophone();
 extern void IntentRecognitionWithLanguage();
 extern void IntentContinuousRecognitionWithFile();
+extern void IntentRecognitionWithCompiledPatterns();
 
 extern void TranslationWithMicrophone();
 extern void TranslationContinuousRecognition();
+extern void TranslationContinuousRecognitionToSpeech();
 
 extern void SpeechSynthesisToSpeaker();
 extern void SpeechSynthesisWithLanguage();
@@ -46,19 +67,30 @@ extern void SpeechSynthesisUsingCustomVoice();
 extern void SpeechSynthesisGetAvailableVoices();
 extern void SpeechSynthesisVisemeEvent();
 extern void SpeechSynthesisBookmarkEvent();
+extern void SpeechSynthesisWithSynthesizerPool();
+extern void SpeechSynthesisWithCache();
+extern void SpeechSynthesisWithSentencePipelining();
+extern void SpeechSynthesisToAudioDataStreamWithForwarding();
+extern void SpeechSynthesisWithAdaptiveOutputFormat();
+extern void SpeechSynthesisOfLongTextToWaveFile();
 
 extern void ConversationWithPullAudioStream();
 extern void ConversationWithPushAudioStream();
 extern void ConversationWithMicrophone();
+extern void ConversationsWithMultiplexedPushAudioStreams();
 
 extern void SpeakerVerificationWithMicrophone();
 extern void SpeakerVerificationWithPushStream();
 extern void SpeakerIdentificationWithPullStream();
 extern void SpeakerIdentificationWithMicrophone();
+extern void SpeakerBulkEnrollment();
+extern void SpeakerIdentificationSharded();
+extern void SpeakerVerificationMultipleProfiles();
 
 // Language Id related tests
 extern void SpeechRecognitionAndLanguageIdWithMicrophone();
 extern void SpeechContinuousRecognitionAndLanguageIdWithMultiLingualFile();
+extern void SpeechRecognitionWithCachedSourceLanguage();
 
 extern void TranslationAndLanguageIdWithMicrophone();
 extern void TranslationRecognitionAndLanguageIdWithMultiLingualFile();
@@ -67,12 +99,23 @@ extern void StandaloneLanguageDetectionWithMicrophone();
 extern void StandaloneLanguageDetectionInSingleshotModeWithFileInput();
 extern void StandaloneLanguageDetectionInContinuousModeWithFileInput();
 extern void StandaloneLanguageDetectionInContinuousModeWithMultiLingualFileInput();
+extern void StandaloneLanguageDetectionForArchiveRouting();
 
 extern void DiagnosticsLoggingFileLoggerWithoutFilter();
 extern void DiagnosticsLoggingFileLoggerWithFilter();
 extern void DiagnosticsLoggingEventLoggerWithoutFilter();
 extern void DiagnosticsLoggingEventLoggerWithFilter();
 extern void DiagnosticsLoggingMemoryLogger();
+extern void DiagnosticsLoggingRingBuffer();
+extern void DiagnosticsLoggingAsyncFileWriter();
+extern void DiagnosticsLoggingDispatchedEvents();
+extern void DiagnosticsLoggingSessionTimeline();
+
+extern int RunBenchmark(const vector<string>& args);
+extern int RunSoakTest(const vector<string>& args);
+extern int RunFootprintBenchmark(const vector<string>& args);
+extern int RunParameterSweep(const vector<string>& args);
+extern int RunFormatBenchmark(const vector<string>& args);
 
 void SpeechSamples()
 {
@@ -97,6 +140,25 @@ void SpeechSamples()
                 "    Microsoft Audio Stack enabled.\n";
         cout << "d.) Speech recognition from push stream with Microsoft Audio Stack enabled and\n"
                 "    beam-forming angles specified.\n";
+        cout << "e.) Speech continuous recognition of a batch of files with concurrent sessions.\n";
+        cout << "f.) Speech recognition using push stream input fed at real-time or faster pace.\n";
+        cout << "g.) Speech continuous recognition of the channels of a multi-channel file in parallel.\n";
+        cout << "h.) Speech recognition of several commands using microphone with a warm recognizer pool.\n";
+        cout << "i.) Speech continuous recognition of a long file in concurrent shards cut at silences.\n";
+        cout << "j.) Speech recognition using pull stream input, resuming from a checkpoint after errors.\n";
+        cout << "k.) Speech continuous recognition of a 44.1 kHz file, converted to 16 kHz mono while streaming.\n";
+        cout << "l.) Speech continuous recognition using push stream input compressed with Opus on the client.\n";
+        cout << "m.) Speech continuous recognition with OpenMetrics counters served over HTTP.\n";
+        cout << "n.) Pronunciation assessment of a batch of files from a manifest, with columnar score output.\n";
+        cout << "o.) Keyword recognition memory per extra stream, with a shared keyword model.\n";
+        cout << "p.) Speech continuous recognition with finals and word timings persisted to a transcript store.\n";
+        cout << "q.) Speech recognition sweep over a multi-channel file enhanced once by Microsoft Audio Stack\n"
+                "    and cached.\n";
+        cout << "r.) Speech recognition in the fastest healthy of several regions, with failover.\n";
+        cout << "s.) Speech recognition with authorization tokens refreshed in the background.\n";
+        cout << "t.) Speech recognition from a blob streamed with HTTP range requests.\n";
+        cout << "u.) Speech recognition with partial results relayed as throttled caption updates.\n";
+        cout << "v.) Speech recognition with customized models of several tenants, from warm recognizers.\n";
         cout << "\nChoice (0 for MAIN MENU): ";
         cout.flush();
 
@@ -148,6 +210,78 @@ void SpeechSamples()
         case 'd':
             SpeechContinuousRecognitionFromPushStreamWithMASEnabledAndBeamformingAnglesSpecified();
             break;
+        case 'E':
+        case 'e':
+            SpeechContinuousRecognitionBatchWithFiles();
+            break;
+        case 'F':
+        case 'f':
+            SpeechContinuousRecognitionWithPacedPushStream();
+            break;
+        case 'G':
+        case 'g':
+            SpeechContinuousRecognitionPerChannelWithPullStream();
+            break;
+        case 'H':
+        case 'h':
+            SpeechRecognitionWithWarmRecognizerPool();
+            break;
+        case 'I':
+        case 'i':
+            SpeechContinuousRecognitionWithFileSharded();
+            break;
+        case 'J':
+        case 'j':
+            SpeechContinuousRecognitionWithPullStreamAndResume();
+            break;
+        case 'K':
+        case 'k':
+            SpeechContinuousRecognitionWithFormatConversion();
+            break;
+        case 'L':
+        case 'l':
+            SpeechContinuousRecognitionWithOpusPushStream();
+            break;
+        case 'M':
+        case 'm':
+            SpeechContinuousRecognitionWithMetrics();
+            break;
+        case 'N':
+        case 'n':
+            PronunciationAssessmentBatchFromManifest();
+            break;
+        case 'O':
+        case 'o':
+            KeywordRecognitionMemoryPerStream();
+            break;
+        case 'P':
+        case 'p':
+            SpeechContinuousRecognitionToTranscriptStore();
+            break;
+        case 'Q':
+        case 'q':
+            SpeechRecognitionSweepWithCachedMASEnhancedAudio();
+            break;
+        case 'R':
+        case 'r':
+            SpeechRecognitionWithRegionFailover();
+            break;
+        case 'S':
+        case 's':
+            SpeechRecognitionWithBackgroundTokenRefresh();
+            break;
+        case 'T':
+        case 't':
+            SpeechRecognitionFromBlobWithRangeRequests();
+            break;
+        case 'U':
+        case 'u':
+            SpeechRecognitionWithThrottledPartials();
+            break;
+        case 'V':
+        case 'v':
+            SpeechRecognitionWithWarmCustomEndpoints();
+            break;
         case '0':
             break;
         }
@@ -162,6 +296,7 @@ void SpeechWithLanguageIdSamples()
         cout << "\nSPEECH RECOGNITION WITH LANGUAGE ID SAMPLES:\n";
         cout << "1.) Speech recognition with microphone input.\n";
         cout << "2.) Speech continuous recognition with multi-lingual file input.\n";
+        cout << "3.) Speech recognition with the source language cached per caller.\n";
         cout << "\nChoice (0 for MAIN MENU): ";
         cout.flush();
 
@@ -176,6 +311,9 @@ void SpeechWithLanguageIdSamples()
         case '2':
             SpeechContinuousRecognitionAndLanguageIdWithMultiLingualFile();
             break;
+        case '3':
+            SpeechRecognitionWithCachedSourceLanguage();
+            break;
         case '0':
             break;
         }
@@ -192,6 +330,7 @@ void IntentSamples()
         cout << "2.) Intent recognition in the specified language.\n";
         cout << "3.) Intent continuous recognition with file input.\n";
         cout << "4.) Intent recognition from default microphone and pattern matching.\n";
+        cout << "5.) Intent recognition from default microphone with patterns compiled ahead of time.\n";
         cout << "\nChoice (0 for MAIN MENU): ";
         cout.flush();
 
@@ -212,6 +351,9 @@ void IntentSamples()
         case '4':
             IntentRecognitionWithPatternMatchingAndMicrophone();
             break;
+        case '5':
+            IntentRecognitionWithCompiledPatterns();
+            break;
         case '0':
             break;
         }
@@ -228,6 +370,7 @@ void TranslationSamples()
         cout << "2.) Translation continuous recognition.\n";
         cout << "3.) Translation with language detection using microphone input.\n";
         cout << "4.) Translation with language detection using multi-lingual file input.\n";
+        cout << "5.) Speech to speech translation, with synthesis overlapped with recognition.\n";
         cout << "\nChoice (0 for MAIN MENU): ";
         cout.flush();
 
@@ -248,6 +391,9 @@ void TranslationSamples()
         case '4':
             TranslationRecognitionAndLanguageIdWithMultiLingualFile();
             break;
+        case '5':
+            TranslationContinuousRecognitionToSpeech();
+            break;
         case '0':
             break;
         }
@@ -276,6 +422,12 @@ void SpeechSynthesisSamples()
         cout << "E.) Speech synthesis get available voices\n";
         cout << "F.) Speech synthesis viseme event.\n";
         cout << "G.) Speech synthesis bookmark event.\n";
+        cout << "H.) Speech synthesis of many texts with a synthesizer pool.\n";
+        cout << "I.) Speech synthesis with a persistent cache.\n";
+        cout << "J.) Speech synthesis of long text, sentence by sentence.\n";
+        cout << "K.) Speech synthesis streamed from audio data stream with time to first byte.\n";
+        cout << "L.) Speech synthesis in the output format chosen for the bandwidth of each client.\n";
+        cout << "M.) Speech synthesis of a long text file, streamed into one wave file.\n";
         cout << "\nChoice (0 for MAIN MENU): ";
         cout.flush();
 
@@ -339,6 +491,30 @@ void SpeechSynthesisSamples()
         case 'g':
             SpeechSynthesisBookmarkEvent();
             break;
+        case 'H':
+        case 'h':
+            SpeechSynthesisWithSynthesizerPool();
+            break;
+        case 'I':
+        case 'i':
+            SpeechSynthesisWithCache();
+            break;
+        case 'J':
+        case 'j':
+            SpeechSynthesisWithSentencePipelining();
+            break;
+        case 'K':
+        case 'k':
+            SpeechSynthesisToAudioDataStreamWithForwarding();
+            break;
+        case 'L':
+        case 'l':
+            SpeechSynthesisWithAdaptiveOutputFormat();
+            break;
+        case 'M':
+        case 'm':
+            SpeechSynthesisOfLongTextToWaveFile();
+            break;
         case '0':
             break;
         }
@@ -354,6 +530,7 @@ void ConversationTranscriberSamples()
         cout << "1.) ConversationTranscriber with pull input audio stream.\n";
         cout << "2.) ConversationTranscriber with push input audio stream.\n";
         cout << "3.) ConversationTranscriber with microphone.\n";
+        cout << "4.) ConversationTranscriber for many conversations with multiplexed push input audio streams.\n";
         cout << "\nChoice (0 for MAIN MENU): ";
         cout.flush();
 
@@ -371,6 +548,9 @@ void ConversationTranscriberSamples()
         case '3':
             ConversationWithMicrophone();
             break;
+        case '4':
+            ConversationsWithMultiplexedPushAudioStreams();
+            break;
         case '0':
             break;
         }
@@ -387,6 +567,9 @@ void SpeakerRecognitionSamples()
         cout << "2.) Speaker verification with push audio stream input.\n";
         cout << "3.) Speaker identification with pull audio stream input.\n";
         cout << "4.) Speaker identification with microphone input.\n";
+        cout << "5.) Speaker bulk enrollment with a profile id manifest.\n";
+        cout << "6.) Speaker identification across sharded profile sets.\n";
+        cout << "7.) Speaker verification of one utterance against several profiles.\n";
         cout << "\nChoice (0 for MAIN MENU): ";
         cout.flush();
 
@@ -411,6 +594,18 @@ void SpeakerRecognitionSamples()
             SpeakerIdentificationWithMicrophone();
             break;
 
+        case '5':
+            SpeakerBulkEnrollment();
+            break;
+
+        case '6':
+            SpeakerIdentificationSharded();
+            break;
+
+        case '7':
+            SpeakerVerificationMultipleProfiles();
+            break;
+
         case '0':
             break;
         }
@@ -427,6 +622,7 @@ void StandaloneLanguageDetectionSamples()
         cout << "2.) Standalone language detection in single-shot mode with file input.\n";
         cout << "3.) Standalone language detection in continuous mode with file input.\n";
         cout << "4.) Standalone language detection in continuous mode with multi-lingual file input.\n";
+        cout << "5.) Standalone language detection of sampled windows across an archive, for routing files.\n";
         cout << "\nChoice (0 for MAIN MENU): ";
         cout.flush();
 
@@ -451,6 +647,10 @@ void StandaloneLanguageDetectionSamples()
             StandaloneLanguageDetectionInContinuousModeWithMultiLingualFileInput();
             break;
 
+        case '5':
+            StandaloneLanguageDetectionForArchiveRouting();
+            break;
+
         case '0':
             break;
         }
@@ -468,6 +668,10 @@ void DiagnosticsLoggingSamples()
         cout << "3.) Trace logging events (without filter).\n";
         cout << "4.) Trace logging events (with filter).\n";
         cout << "5.) Trace logging to memory.\n";
+        cout << "6.) Trace logging events to a lock-free ring buffer.\n";
+        cout << "7.) Trace logging events to a file on a background thread, with rotation.\n";
+        cout << "8.) Trace logging events, sampled and rate limited, on a dispatcher thread.\n";
+        cout << "9.) Session timeline in Chrome trace format.\n";
         cout << "\nChoice (0 for MAIN MENU): ";
         cout.flush();
 
@@ -491,6 +695,18 @@ void DiagnosticsLoggingSamples()
         case '5':
             DiagnosticsLoggingMemoryLogger();
             break;
+        case '6':
+            DiagnosticsLoggingRingBuffer();
+            break;
+        case '7':
+            DiagnosticsLoggingAsyncFileWriter();
+            break;
+        case '8':
+            DiagnosticsLoggingDispatchedEvents();
+            break;
+        case '9':
+            DiagnosticsLoggingSessionTimeline();
+            break;
         case '0':
             break;
         }
@@ -503,6 +719,41 @@ int wmain(int argc, wchar_t **argv)
 int main(int argc, char **argv)
 #endif
 {
+    // Runs the benchmark or the soak test without the interactive menu, e.g. "sample --benchmark --iterations 20"
+    // or "sample --soak --concurrency 8 --rate 2" or "sample --footprint --max-sessions 64"
+    // or "sample --sweep --corpus corpus.tsv --segmentation default,300,600" or "sample --formats --iterations 5".
+    // Options are expected to be plain ASCII.
+    vector<string> args;
+    for (int i = 1; i < argc; i++)
+    {
+        string arg;
+        for (auto c = argv[i]; *c != 0; c++)
+        {
+            arg.push_back((char)*c);
+        }
+        args.push_back(arg);
+    }
+    if (!args.empty() && args[0] == "--benchmark")
+    {
+        return RunBenchmark(vector<string>(args.begin() + 1, args.end()));
+    }
+    if (!args.empty() && args[0] == "--soak")
+    {
+        return RunSoakTest(vector<string>(args.begin() + 1, args.end()));
+    }
+    if (!args.empty() && args[0] == "--footprint")
+    {
+        return RunFootprintBenchmark(vector<string>(args.begin() + 1, args.end()));
+    }
+    if (!args.empty() && args[0] == "--sweep")
+    {
+        return RunParameterSweep(vector<string>(args.begin() + 1, args.end()));
+    }
+    if (!args.empty() && args[0] == "--formats")
+    {
+        return RunFormatBenchmark(vector<string>(args.begin() + 1, args.end()));
+    }
+
     string input;
     do
     {
@@ -0,0 +1,202 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#pragma once
+
+#include <atomic>
+#include <cstring>
+#include <functional>
+#include <ostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#pragma comment(lib, "Ws2_32.lib")
+#else
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+// Minimal HTTP endpoint for metrics scrapers such as Prometheus. Every GET request, whatever its path, is
+// answered with the text written by 'write', as OpenMetrics. Requests are served one at a time on a background
+// thread, which is plenty for a scraper polling every few seconds. Listens on the loopback interface unless
+// 'allInterfaces' is set.
+class MetricsHttpEndpoint final
+{
+public:
+    using Writer = std::function<void(std::ostream& out)>;
+
+    // Throws std::runtime_error if the port cannot be opened.
+    MetricsHttpEndpoint(uint16_t port, Writer write, bool allInterfaces = false)
+        : m_write(std::move(write))
+    {
+#ifdef _WIN32
+        WSADATA data;
+        if (WSAStartup(MAKEWORD(2, 2), &data) != 0)
+        {
+            throw std::runtime_error("Cannot initialize Windows sockets.");
+        }
+#endif
+        m_listener = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+        if (m_listener == invalidSocket)
+        {
+            Cleanup();
+            throw std::runtime_error("Cannot create the metrics socket.");
+        }
+
+        int reuse = 1;
+        setsockopt(m_listener, SOL_SOCKET, SO_REUSEADDR, reinterpret_cast<const char*>(&reuse), sizeof(reuse));
+
+        sockaddr_in address = {};
+        address.sin_family = AF_INET;
+        address.sin_port = htons(port);
+        address.sin_addr.s_addr = htonl(allInterfaces ? INADDR_ANY : INADDR_LOOPBACK);
+        if (bind(m_listener, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 || listen(m_listener, 8) != 0)
+        {
+            Cleanup();
+            throw std::runtime_error("Cannot listen on metrics port " + std::to_string(port) + ".");
+        }
+
+        m_thread = std::thread(&MetricsHttpEndpoint::Serve, this);
+    }
+
+    MetricsHttpEndpoint(const MetricsHttpEndpoint&) = delete;
+    MetricsHttpEndpoint& operator=(const MetricsHttpEndpoint&) = delete;
+
+    ~MetricsHttpEndpoint()
+    {
+        m_stopping = true;
+        m_thread.join();
+        Cleanup();
+    }
+
+private:
+#ifdef _WIN32
+    using Socket = SOCKET;
+    static constexpr Socket invalidSocket = INVALID_SOCKET;
+    static void CloseSocket(Socket s) { closesocket(s); }
+#else
+    using Socket = int;
+    static constexpr Socket invalidSocket = -1;
+    static void CloseSocket(Socket s) { close(s); }
+#endif
+
+#ifdef MSG_NOSIGNAL
+    // A scraper closing the connection early must not end the process with SIGPIPE.
+    static constexpr int sendFlags = MSG_NOSIGNAL;
+#else
+    static constexpr int sendFlags = 0;
+#endif
+
+    // How often the serving thread checks whether it is to stop.
+    static constexpr long pollIntervalMs = 200;
+    // Longest wait for a client to send its request or take the response, so an idle or stalled client cannot hold
+    // up the serving thread, and with it the destructor.
+    static constexpr long clientTimeoutMs = 2000;
+
+    void Cleanup()
+    {
+        if (m_listener != invalidSocket)
+        {
+            CloseSocket(m_listener);
+            m_listener = invalidSocket;
+        }
+#ifdef _WIN32
+        WSACleanup();
+#endif
+    }
+
+    void Serve()
+    {
+        while (!m_stopping)
+        {
+            // Waits with a timeout, so the destructor does not depend on closing the socket to end accept().
+            fd_set readable;
+            FD_ZERO(&readable);
+            FD_SET(m_listener, &readable);
+            timeval timeout = { 0, pollIntervalMs * 1000 };
+            if (select((int)m_listener + 1, &readable, nullptr, nullptr, &timeout) <= 0)
+            {
+                continue;
+            }
+
+            auto client = accept(m_listener, nullptr, nullptr);
+            if (client == invalidSocket)
+            {
+                continue;
+            }
+            SetTimeouts(client);
+            Respond(client);
+            CloseSocket(client);
+        }
+    }
+
+    static void SetTimeouts(Socket client)
+    {
+#ifdef _WIN32
+        DWORD timeout = clientTimeoutMs;
+#else
+        timeval timeout = { clientTimeoutMs / 1000, (clientTimeoutMs % 1000) * 1000 };
+#endif
+        setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, reinterpret_cast<const char*>(&timeout), sizeof(timeout));
+        setsockopt(client, SOL_SOCKET, SO_SNDTIMEO, reinterpret_cast<const char*>(&timeout), sizeof(timeout));
+    }
+
+    void Respond(Socket client)
+    {
+        // Scrapers send small requests; the request line is all that is needed.
+        char request[2048];
+        auto received = recv(client, request, sizeof(request) - 1, 0);
+        if (received <= 0)
+        {
+            return;
+        }
+        request[received] = '\0';
+
+        std::string response;
+        if (strncmp(request, "GET ", 4) == 0)
+        {
+            std::ostringstream body;
+            m_write(body);
+            auto text = body.str();
+            response = "HTTP/1.1 200 OK\r\n"
+                "Content-Type: application/openmetrics-text; version=1.0.0; charset=utf-8\r\n"
+                "Content-Length: " + std::to_string(text.size()) + "\r\n"
+                "Connection: close\r\n\r\n" + text;
+        }
+        else
+        {
+            response = "HTTP/1.1 405 Method Not Allowed\r\nAllow: GET\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+        }
+
+        size_t sent = 0;
+        while (sent < response.size())
+        {
+            auto count = send(client, response.data() + sent, (int)(response.size() - sent), sendFlags);
+            if (count <= 0)
+            {
+                return;
+            }
+            sent += (size_t)count;
+        }
+    }
+
+    Writer m_write;
+    Socket m_listener = invalidSocket;
+    std::atomic<bool> m_stopping{ false };
+    std::thread m_thread;
+};
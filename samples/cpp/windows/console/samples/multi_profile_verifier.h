@@ -0,0 +1,96 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#pragma once
+
+#include <speechapi_cxx.h>
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include "shared_audio_buffer.h"
+
+// Verifies one utterance against several claimed identities. The utterance is loaded once into a
+// SharedAudioBuffer; every check gets its own SpeakerRecognizer reading a pull stream over that buffer,
+// so the file is opened and parsed once whatever the number of profiles. Up to 'maxConcurrent' checks run at once.
+class MultiProfileVerifier final
+{
+public:
+    struct Verification
+    {
+        std::string ProfileId;
+        // The speaker was accepted as the owner of the profile.
+        bool Accepted = false;
+        float Score = 0;
+        // Error details when the check was canceled, empty otherwise.
+        std::string Error;
+    };
+
+    MultiProfileVerifier(std::shared_ptr<Microsoft::CognitiveServices::Speech::SpeechConfig> config, unsigned maxConcurrent = 4)
+        : m_config(std::move(config)), m_maxConcurrent(maxConcurrent)
+    {
+        if (m_maxConcurrent == 0)
+        {
+            throw std::invalid_argument("Concurrency must be at least 1.");
+        }
+    }
+
+    // Returns one verification per profile, in the order of 'profiles'.
+    std::vector<Verification> Verify(const std::shared_ptr<const SharedAudioBuffer>& audio,
+        const std::vector<std::shared_ptr<Microsoft::CognitiveServices::Speech::Speaker::VoiceProfile>>& profiles)
+    {
+        using namespace Microsoft::CognitiveServices::Speech;
+        using namespace Microsoft::CognitiveServices::Speech::Audio;
+        using namespace Microsoft::CognitiveServices::Speech::Speaker;
+
+        // Every slot is written by one worker only, no locking is needed.
+        std::vector<Verification> verifications(profiles.size());
+        std::atomic<size_t> next(0);
+        auto worker = [&]()
+        {
+            for (auto index = next++; index < profiles.size(); index = next++)
+            {
+                auto& verification = verifications[index];
+                verification.ProfileId = profiles[index]->GetId();
+                try
+                {
+                    auto recognizer = SpeakerRecognizer::FromConfig(m_config, AudioConfig::FromStreamInput(audio->CreatePullStream()));
+                    auto result = recognizer->RecognizeOnceAsync(SpeakerVerificationModel::FromProfile(profiles[index])).get();
+                    if (result->Reason == ResultReason::Canceled)
+                    {
+                        verification.Error = SpeakerRecognitionCancellationDetails::FromResult(result)->ErrorDetails;
+                    }
+                    else
+                    {
+                        verification.Accepted = result->Reason == ResultReason::RecognizedSpeaker;
+                        verification.Score = result->GetScore();
+                    }
+                }
+                catch (const std::exception& e)
+                {
+                    verification.Error = e.what();
+                }
+            }
+        };
+
+        std::vector<std::thread> workers;
+        auto count = std::min<size_t>(m_maxConcurrent, profiles.size());
+        for (size_t i = 0; i < count; i++)
+        {
+            workers.emplace_back(worker);
+        }
+        for (auto& t : workers)
+        {
+            t.join();
+        }
+        return verifications;
+    }
+
+private:
+    std::shared_ptr<Microsoft::CognitiveServices::Speech::SpeechConfig> m_config;
+    const unsigned m_maxConcurrent;
+};
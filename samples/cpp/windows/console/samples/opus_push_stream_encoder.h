@@ -0,0 +1,411 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#pragma once
+
+// Needs libopus (https://opus-codec.org). Include only when the samples are built with SPEECH_SAMPLES_WITH_OPUS:
+// the Makefile defines it when libopus is installed, in Visual Studio add it to the preprocessor definitions
+// and link opus.lib (e.g. from vcpkg).
+
+#include <speechapi_cxx.h>
+#include <opus_multistream.h>
+#include <algorithm>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include "wav_file_reader.h"
+
+// Packs Opus packets into Ogg pages (RFC 3533, RFC 7845), the OGG_OPUS container the SDK accepts in
+// AudioStreamFormat::GetCompressedFormat().
+class OggOpusMuxer final
+{
+public:
+    // Opus always counts granule positions at 48 kHz, whatever the input rate.
+    static constexpr uint32_t granuleRate = 48000;
+
+    OggOpusMuxer(uint32_t serialNumber = 0x53504B31)
+        : m_serialNumber(serialNumber)
+    {
+    }
+
+    // Returns the two header pages: the 'OpusHead' identification header and the 'OpusTags' comment header.
+    // 'mapping' is the channel mapping of a multistream encoder, used for mapping families other than 0.
+    std::vector<uint8_t> HeaderPages(uint16_t channels, uint32_t inputSampleRate, uint16_t preSkip,
+        uint8_t mappingFamily, uint8_t streams, uint8_t coupledStreams, const std::vector<uint8_t>& mapping)
+    {
+        std::vector<uint8_t> head{ 'O', 'p', 'u', 's', 'H', 'e', 'a', 'd', 1, (uint8_t)channels };
+        AppendUInt16(head, preSkip);
+        AppendUInt32(head, inputSampleRate);
+        AppendUInt16(head, 0);  // output gain
+        head.push_back(mappingFamily);
+        if (mappingFamily != 0)
+        {
+            head.push_back(streams);
+            head.push_back(coupledStreams);
+            head.insert(head.end(), mapping.begin(), mapping.end());
+        }
+
+        static const char vendor[] = "speech-sdk-samples";
+        std::vector<uint8_t> tags{ 'O', 'p', 'u', 's', 'T', 'a', 'g', 's' };
+        AppendUInt32(tags, sizeof(vendor) - 1);
+        tags.insert(tags.end(), vendor, vendor + sizeof(vendor) - 1);
+        AppendUInt32(tags, 0);  // no user comments
+
+        std::vector<uint8_t> pages;
+        AddPacket(head);
+        AppendPage(pages, 0, beginOfStream);
+        AddPacket(tags);
+        AppendPage(pages, 0, 0);
+        return pages;
+    }
+
+    // Adds an audio packet to the page being built. Returns false when the page has no room left for it,
+    // the page must then be written with Page() first.
+    bool AddPacket(const std::vector<uint8_t>& packet)
+    {
+        return AddPacket(packet.data(), packet.size());
+    }
+
+    bool AddPacket(const uint8_t* packet, size_t size)
+    {
+        // A packet takes one lacing value per 255 bytes, and a last one below 255 (0 if the size is a multiple of 255).
+        size_t segments = size / 255 + 1;
+        if (m_lacing.size() + segments > maxSegments)
+        {
+            return false;
+        }
+        for (size_t i = 0; i + 1 < segments; i++)
+        {
+            m_lacing.push_back(255);
+        }
+        m_lacing.push_back((uint8_t)(size % 255));
+        m_body.insert(m_body.end(), packet, packet + size);
+        return true;
+    }
+
+    // Closes the page being built and appends it to 'output'. 'granulePosition' is the end of the last
+    // packet on the page, in 48 kHz samples including the pre-skip.
+    void Page(std::vector<uint8_t>& output, uint64_t granulePosition, bool endOfStream)
+    {
+        AppendPage(output, granulePosition, endOfStream ? endOfStreamFlag : 0);
+    }
+
+private:
+    static constexpr size_t maxSegments = 255;
+    static constexpr uint8_t beginOfStream = 0x02;
+    static constexpr uint8_t endOfStreamFlag = 0x04;
+
+    static void AppendUInt16(std::vector<uint8_t>& buffer, uint16_t value)
+    {
+        buffer.push_back((uint8_t)value);
+        buffer.push_back((uint8_t)(value >> 8));
+    }
+
+    static void AppendUInt32(std::vector<uint8_t>& buffer, uint32_t value)
+    {
+        for (int i = 0; i < 32; i += 8)
+        {
+            buffer.push_back((uint8_t)(value >> i));
+        }
+    }
+
+    void AppendPage(std::vector<uint8_t>& output, uint64_t granulePosition, uint8_t flags)
+    {
+        auto start = output.size();
+        static const uint8_t capturePattern[] = { 'O', 'g', 'g', 'S', 0 };
+        output.insert(output.end(), capturePattern, capturePattern + sizeof(capturePattern));
+        output.push_back(flags);
+        AppendUInt32(output, (uint32_t)granulePosition);
+        AppendUInt32(output, (uint32_t)(granulePosition >> 32));
+        AppendUInt32(output, m_serialNumber);
+        AppendUInt32(output, m_sequenceNumber++);
+        auto checksumOffset = output.size();
+        AppendUInt32(output, 0);
+        output.push_back((uint8_t)m_lacing.size());
+        output.insert(output.end(), m_lacing.begin(), m_lacing.end());
+        output.insert(output.end(), m_body.begin(), m_body.end());
+
+        // The checksum covers the whole page, with the checksum field set to zero.
+        auto checksum = Crc32(output.data() + start, output.size() - start);
+        for (int i = 0; i < 4; i++)
+        {
+            output[checksumOffset + i] = (uint8_t)(checksum >> (8 * i));
+        }
+
+        m_lacing.clear();
+        m_body.clear();
+    }
+
+    // The Ogg CRC: polynomial 0x04C11DB7, not reflected, zero initial value and no final xor.
+    static uint32_t Crc32(const uint8_t* data, size_t size)
+    {
+        struct Table
+        {
+            uint32_t Entries[256];
+            Table()
+            {
+                for (uint32_t i = 0; i < 256; i++)
+                {
+                    uint32_t r = i << 24;
+                    for (int bit = 0; bit < 8; bit++)
+                    {
+                        r = (r & 0x80000000u) ? (r << 1) ^ 0x04C11DB7u : (r << 1);
+                    }
+                    Entries[i] = r;
+                }
+            }
+        };
+        static const Table table;
+
+        uint32_t crc = 0;
+        for (size_t i = 0; i < size; i++)
+        {
+            crc = (crc << 8) ^ table.Entries[((crc >> 24) ^ data[i]) & 0xFF];
+        }
+        return crc;
+    }
+
+    const uint32_t m_serialNumber;
+    uint32_t m_sequenceNumber = 0;
+    std::vector<uint8_t> m_lacing;
+    std::vector<uint8_t> m_body;
+};
+
+// Compresses 16-bit PCM to OGG/Opus on a background thread and writes the pages to a push stream created
+// with AudioStreamFormat::GetCompressedFormat(AudioStreamContainerFormat::OGG_OPUS). Write() takes PCM in
+// any chunk size, e.g. from WavFileReader::Read() or a capture callback, and only blocks when more than
+// 'MaxQueuedMs' of audio waits for the encoder. Pages are written once they hold 'PageMs' of audio, which
+// bounds the latency added by the encoding. Mono and stereo are coded as one Opus stream; more channels,
+// e.g. of a microphone array, are coded as one stream per channel.
+class OpusPushStreamEncoder final
+{
+public:
+    struct Settings
+    {
+        // 24 kbit/s per channel is about a tenth of 16 kHz, 16-bit PCM (256 kbit/s).
+        int32_t BitratePerChannel = 24000;
+        // Opus frame length, one of 10, 20, 40 or 60.
+        uint32_t FrameMs = 20;
+        uint32_t PageMs = 100;
+        uint32_t MaxQueuedMs = 1000;
+    };
+
+    struct Statistics
+    {
+        uint64_t PcmBytes = 0;
+        uint64_t EncodedBytes = 0;
+        uint64_t Pages = 0;
+    };
+
+    // Throws std::invalid_argument for formats Opus cannot code, std::runtime_error when the encoder fails.
+    OpusPushStreamEncoder(std::shared_ptr<Microsoft::CognitiveServices::Speech::Audio::PushAudioInputStream> pushStream,
+        const WavFileReader::WAVEFORMAT& format)
+        : OpusPushStreamEncoder(std::move(pushStream), format, Settings())
+    {
+    }
+
+    OpusPushStreamEncoder(std::shared_ptr<Microsoft::CognitiveServices::Speech::Audio::PushAudioInputStream> pushStream,
+        const WavFileReader::WAVEFORMAT& format, const Settings& settings)
+        : m_pushStream(std::move(pushStream)), m_channels(format.Channels)
+    {
+        auto rate = format.SamplesPerSec;
+        if (format.BitsPerSample != 16 || format.Channels == 0 || format.Channels > 255 ||
+            (rate != 8000 && rate != 12000 && rate != 16000 && rate != 24000 && rate != 48000))
+        {
+            throw std::invalid_argument("Opus encodes 16-bit PCM at 8, 12, 16, 24 or 48 kHz only.");
+        }
+        if (settings.FrameMs != 10 && settings.FrameMs != 20 && settings.FrameMs != 40 && settings.FrameMs != 60)
+        {
+            throw std::invalid_argument("The Opus frame length must be 10, 20, 40 or 60 ms.");
+        }
+
+        m_frameSamples = rate * settings.FrameMs / 1000;
+        m_frameBytes = m_frameSamples * m_channels * sizeof(int16_t);
+        m_framesPerPage = std::max<uint32_t>(1, settings.PageMs / settings.FrameMs);
+        m_maxQueuedBytes = (size_t)format.AvgBytesPerSec * settings.MaxQueuedMs / 1000;
+        m_granulesPerFrame = OggOpusMuxer::granuleRate / 1000 * settings.FrameMs;
+
+        // Mapping family 0 is a single (coupled for stereo) stream, family 255 codes every channel on its own.
+        uint8_t family = m_channels <= 2 ? 0 : 255;
+        int streams = m_channels <= 2 ? 1 : m_channels;
+        int coupled = m_channels == 2 ? 1 : 0;
+        std::vector<uint8_t> mapping(m_channels);
+        for (uint16_t i = 0; i < m_channels; i++)
+        {
+            mapping[i] = (uint8_t)i;
+        }
+
+        int error = OPUS_OK;
+        m_encoder = opus_multistream_encoder_create((opus_int32)rate, m_channels, streams, coupled, mapping.data(), OPUS_APPLICATION_VOIP, &error);
+        if (error != OPUS_OK || m_encoder == nullptr)
+        {
+            throw std::runtime_error(std::string("Failed to create the Opus encoder: ") + opus_strerror(error));
+        }
+        opus_multistream_encoder_ctl(m_encoder, OPUS_SET_BITRATE(settings.BitratePerChannel * m_channels));
+
+        // The decoder drops the encoder delay at the start, given in 48 kHz samples.
+        opus_int32 lookahead = 0;
+        opus_multistream_encoder_ctl(m_encoder, OPUS_GET_LOOKAHEAD(&lookahead));
+        m_preSkip = (uint16_t)((uint64_t)lookahead * OggOpusMuxer::granuleRate / rate);
+        m_granulePosition = m_preSkip;
+
+        m_output = m_muxer.HeaderPages(m_channels, rate, m_preSkip, family, (uint8_t)streams, (uint8_t)coupled, mapping);
+        WriteOutput();
+
+        m_thread = std::thread([this]() { Encode(); });
+    }
+
+    OpusPushStreamEncoder(const OpusPushStreamEncoder&) = delete;
+    OpusPushStreamEncoder& operator=(const OpusPushStreamEncoder&) = delete;
+
+    ~OpusPushStreamEncoder()
+    {
+        Close();
+        opus_multistream_encoder_destroy(m_encoder);
+    }
+
+    // Queues PCM for encoding. Blocks while the encoder is more than 'MaxQueuedMs' behind.
+    void Write(const uint8_t* data, uint32_t size)
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_queueFreed.wait(lock, [this]() { return m_queue.size() < m_maxQueuedBytes || m_closed; });
+        if (m_closed)
+        {
+            return;
+        }
+        m_queue.insert(m_queue.end(), data, data + size);
+        m_statistics.PcmBytes += size;
+        m_queueFilled.notify_one();
+    }
+
+    // Encodes the audio still queued, pads the last frame with silence, ends the Ogg stream and closes the push stream.
+    void Close()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (m_closed)
+            {
+                return;
+            }
+            m_closed = true;
+        }
+        m_queueFilled.notify_one();
+        m_queueFreed.notify_all();
+        m_thread.join();
+        m_pushStream->Close();
+    }
+
+    Statistics GetStatistics()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_statistics;
+    }
+
+private:
+    void Encode()
+    {
+        std::vector<uint8_t> frame(m_frameBytes);
+        std::vector<int16_t> samples(m_frameSamples * m_channels);
+        // The largest packet Opus produces is 1275 bytes per stream and 20 ms.
+        std::vector<uint8_t> packet(1275 * 3 * m_channels);
+        uint32_t framesOnPage = 0;
+
+        while (true)
+        {
+            size_t count = 0;
+            bool last = false;
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                m_queueFilled.wait(lock, [this]() { return m_queue.size() >= m_frameBytes || m_closed; });
+                // After Close() the rest of the audio is padded with silence to a whole frame.
+                last = m_queue.size() < m_frameBytes;
+                count = std::min(m_queue.size(), m_frameBytes);
+                std::copy(m_queue.begin(), m_queue.begin() + count, frame.begin());
+                m_queue.erase(m_queue.begin(), m_queue.begin() + count);
+                m_queueFreed.notify_one();
+            }
+
+            if (count > 0)
+            {
+                std::fill(frame.begin() + count, frame.end(), 0);
+                // The frame is copied, the input may not be aligned for samples.
+                memcpy(samples.data(), frame.data(), m_frameBytes);
+                auto size = opus_multistream_encode(m_encoder, samples.data(), (int)m_frameSamples, packet.data(), (opus_int32)packet.size());
+                if (size < 0)
+                {
+                    // Encoding errors end the stream, the recognizer then sees the end of the audio.
+                    last = true;
+                }
+                else
+                {
+                    if (!m_muxer.AddPacket(packet.data(), (size_t)size))
+                    {
+                        FlushPage(false);
+                        framesOnPage = 0;
+                        m_muxer.AddPacket(packet.data(), (size_t)size);
+                    }
+                    // The granule position of the last page ends at the real end of the audio, not of the padding.
+                    auto frameBytes = m_channels * sizeof(int16_t);
+                    m_granulePosition += count / frameBytes * m_granulesPerFrame / m_frameSamples;
+                    framesOnPage++;
+                }
+            }
+
+            if (last || framesOnPage >= m_framesPerPage)
+            {
+                FlushPage(last);
+                framesOnPage = 0;
+            }
+            if (last)
+            {
+                return;
+            }
+        }
+    }
+
+    void FlushPage(bool endOfStream)
+    {
+        m_muxer.Page(m_output, m_granulePosition, endOfStream);
+        WriteOutput();
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_statistics.Pages++;
+    }
+
+    void WriteOutput()
+    {
+        m_pushStream->Write(m_output.data(), (uint32_t)m_output.size());
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_statistics.EncodedBytes += m_output.size();
+        m_output.clear();
+    }
+
+    const std::shared_ptr<Microsoft::CognitiveServices::Speech::Audio::PushAudioInputStream> m_pushStream;
+    const uint16_t m_channels;
+    uint32_t m_frameSamples;
+    size_t m_frameBytes;
+    uint32_t m_framesPerPage;
+    size_t m_maxQueuedBytes;
+    // Frame length in 48 kHz samples.
+    uint32_t m_granulesPerFrame;
+    uint16_t m_preSkip;
+
+    OpusMSEncoder* m_encoder = nullptr;
+    OggOpusMuxer m_muxer;
+    std::vector<uint8_t> m_output;
+    uint64_t m_granulePosition = 0;
+
+    std::mutex m_mutex;
+    std::condition_variable m_queueFilled;
+    std::condition_variable m_queueFreed;
+    std::deque<uint8_t> m_queue;
+    bool m_closed = false;
+    Statistics m_statistics;
+    std::thread m_thread;
+};
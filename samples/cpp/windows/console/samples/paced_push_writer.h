@@ -0,0 +1,113 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#pragma once
+
+#include <speechapi_cxx.h>
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <ostream>
+#include <thread>
+#include <vector>
+#include "wav_file_reader.h"
+
+// Writes audio into a push stream at a configurable pace, and measures how long each Write() blocked.
+// A speed of 1 feeds audio as fast as a live source would, N feeds it N times faster, and 0 writes
+// unthrottled. The pace is derived from the AvgBytesPerSec of the WAV format.
+class PacedPushWriter final
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    struct Statistics
+    {
+        uint32_t Writes = 0;
+        uint64_t Bytes = 0;
+        std::chrono::microseconds TotalBlocked{ 0 };
+        std::chrono::microseconds MaxBlocked{ 0 };
+        // How far the writer fell behind its schedule at worst, e.g. because Write() blocked.
+        std::chrono::microseconds MaxLag{ 0 };
+        // Time each Write() call blocked, in call order.
+        std::vector<std::chrono::microseconds> Blocked;
+    };
+
+    PacedPushWriter(std::shared_ptr<Microsoft::CognitiveServices::Speech::Audio::PushAudioInputStream> pushStream,
+        const WavFileReader::WAVEFORMAT& format, double speed = 1.0)
+        : m_pushStream(std::move(pushStream)), m_bytesPerSecond((double)format.AvgBytesPerSec * speed)
+    {
+        if (speed < 0)
+        {
+            throw std::invalid_argument("Speed must not be negative.");
+        }
+        if (speed > 0 && format.AvgBytesPerSec == 0)
+        {
+            throw std::invalid_argument("Pacing requires a format with AvgBytesPerSec set.");
+        }
+    }
+
+    // Waits until the audio is due (unless unthrottled), then writes it and records the time Write() blocked.
+    void Write(const uint8_t* dataBuffer, uint32_t size)
+    {
+        auto now = Clock::now();
+        if (m_statistics.Writes == 0)
+        {
+            m_start = now;
+        }
+
+        if (m_bytesPerSecond > 0)
+        {
+            // The chunk is due once all audio before it would have been played out.
+            auto due = m_start + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(m_statistics.Bytes / m_bytesPerSecond));
+            if (due > now)
+            {
+                std::this_thread::sleep_until(due);
+            }
+            else
+            {
+                auto lag = std::chrono::duration_cast<std::chrono::microseconds>(now - due);
+                m_statistics.MaxLag = std::max(m_statistics.MaxLag, lag);
+            }
+        }
+
+        auto writeStarted = Clock::now();
+        // Write() does not modify the buffer, it only takes a non-const pointer.
+        m_pushStream->Write(const_cast<uint8_t*>(dataBuffer), size);
+        auto blocked = std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - writeStarted);
+
+        m_statistics.Writes++;
+        m_statistics.Bytes += size;
+        m_statistics.TotalBlocked += blocked;
+        m_statistics.MaxBlocked = std::max(m_statistics.MaxBlocked, blocked);
+        m_statistics.Blocked.push_back(blocked);
+    }
+
+    // Time of the first Write(), used as the reference point for first-partial latency.
+    Clock::time_point StartTime() const
+    {
+        return m_start;
+    }
+
+    const Statistics& GetStatistics() const
+    {
+        return m_statistics;
+    }
+
+    void PrintStatistics(std::ostream& out) const
+    {
+        auto writes = std::max<uint32_t>(1, m_statistics.Writes);
+        out << "Push statistics: Writes=" << m_statistics.Writes
+            << " Bytes=" << m_statistics.Bytes
+            << " TotalBlockedUs=" << m_statistics.TotalBlocked.count()
+            << " MeanBlockedUs=" << m_statistics.TotalBlocked.count() / writes
+            << " MaxBlockedUs=" << m_statistics.MaxBlocked.count()
+            << " MaxLagUs=" << m_statistics.MaxLag.count() << std::endl;
+    }
+
+private:
+    std::shared_ptr<Microsoft::CognitiveServices::Speech::Audio::PushAudioInputStream> m_pushStream;
+    const double m_bytesPerSecond;
+    Clock::time_point m_start;
+    Statistics m_statistics;
+};
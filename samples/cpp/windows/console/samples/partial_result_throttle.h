@@ -0,0 +1,202 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+
+// Turns the partial results of a recognizer into caption updates for relaying to many clients, e.g. over websockets.
+// Each Recognizing event repeats the whole hypothesis so far; an update instead says how much of the text the client
+// already has stays (the stable prefix, cut back to a word boundary) and which text follows it, so the bytes sent and
+// rendered grow with the new words rather than with the length of the hypothesis. Partials are coalesced to at most
+// one update per 'Interval', the newest one winning; final results are never coalesced or dropped.
+// The sink is called on a thread of the throttle, one update at a time and in order.
+class PartialResultThrottle final
+{
+public:
+    struct Update
+    {
+        // The client keeps this many bytes of its current caption and appends 'Append' to them.
+        size_t Keep;
+        std::string Append;
+        // The caption is complete; the next update starts a new one, with Keep 0.
+        bool Final;
+    };
+
+    using Sink = std::function<void(const Update&)>;
+
+    struct Settings
+    {
+        std::chrono::milliseconds Interval{ 200 };
+    };
+
+    struct Statistics
+    {
+        uint64_t Partials = 0;
+        // Partials replaced by a newer one before they were sent.
+        uint64_t Coalesced = 0;
+        uint64_t Updates = 0;
+        // Bytes of all partial and final texts, i.e. what relaying every whole hypothesis would send.
+        uint64_t HypothesisBytes = 0;
+        // Bytes of the appended texts of all updates.
+        uint64_t SentBytes = 0;
+    };
+
+    explicit PartialResultThrottle(Sink sink)
+        : PartialResultThrottle(std::move(sink), Settings())
+    {
+    }
+
+    PartialResultThrottle(Sink sink, const Settings& settings)
+        : m_sink(std::move(sink)), m_settings(settings), m_thread([this]() { Run(); })
+    {
+    }
+
+    PartialResultThrottle(const PartialResultThrottle&) = delete;
+    PartialResultThrottle& operator=(const PartialResultThrottle&) = delete;
+
+    // Sends the final results still queued, drops a pending partial, and stops the thread.
+    ~PartialResultThrottle()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stopping = true;
+        }
+        m_wakeUp.notify_one();
+        m_thread.join();
+    }
+
+    // Call with e.Result->Text of Recognizing (or Transcribing) events.
+    void OnPartial(const std::string& text)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_statistics.Partials++;
+        m_statistics.HypothesisBytes += text.size();
+        if (!m_queue.empty() && !m_queue.back().Final)
+        {
+            m_statistics.Coalesced++;
+            m_queue.back().Text = text;
+            return;
+        }
+        m_queue.push_back({ text, false });
+        m_wakeUp.notify_one();
+    }
+
+    // Call with e.Result->Text of Recognized (or Transcribed) events. Supersedes the pending partial, if any.
+    void OnFinal(const std::string& text)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_statistics.HypothesisBytes += text.size();
+        if (!m_queue.empty() && !m_queue.back().Final)
+        {
+            m_statistics.Coalesced++;
+            m_queue.pop_back();
+        }
+        m_queue.push_back({ text, true });
+        m_wakeUp.notify_one();
+    }
+
+    Statistics GetStatistics()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_statistics;
+    }
+
+    // Length of the common prefix of 'sent' and 'hypothesis', cut back to the end of the last word both have
+    // completely, so a client never renders half a word and UTF-8 sequences are never split.
+    static size_t StablePrefix(const std::string& sent, const std::string& hypothesis)
+    {
+        size_t common = 0;
+        while (common < sent.size() && common < hypothesis.size() && sent[common] == hypothesis[common])
+        {
+            common++;
+        }
+        auto wordEnds = [](const std::string& text, size_t position) { return position == text.size() || text[position] == ' '; };
+        if (wordEnds(sent, common) && wordEnds(hypothesis, common))
+        {
+            return common;
+        }
+        while (common > 0 && sent[common - 1] != ' ')
+        {
+            common--;
+        }
+        return common;
+    }
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    struct Entry
+    {
+        std::string Text;
+        bool Final;
+    };
+
+    void Run()
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        auto nextPartial = Clock::now();
+        while (true)
+        {
+            // Sleeps until there is something queued; then a final goes right away, and a partial waits for the
+            // interval to pass.
+            m_wakeUp.wait(lock, [this]() { return m_stopping || !m_queue.empty(); });
+            if (!m_stopping && !m_queue.front().Final)
+            {
+                m_wakeUp.wait_until(lock, nextPartial, [this]()
+                {
+                    return m_stopping || m_queue.empty() || m_queue.front().Final;
+                });
+            }
+            if (m_queue.empty() || (m_stopping && !m_queue.front().Final))
+            {
+                if (m_stopping)
+                {
+                    return;
+                }
+                continue;
+            }
+            if (!m_queue.front().Final && Clock::now() < nextPartial)
+            {
+                continue;
+            }
+
+            auto entry = std::move(m_queue.front());
+            m_queue.pop_front();
+            auto keep = StablePrefix(m_sent, entry.Text);
+            Update update{ keep, entry.Text.substr(keep), entry.Final };
+            m_sent = entry.Final ? std::string() : std::move(entry.Text);
+            m_statistics.Updates++;
+            m_statistics.SentBytes += update.Append.size();
+            if (!update.Final)
+            {
+                nextPartial = Clock::now() + m_settings.Interval;
+            }
+
+            // The sink may be slow (a broadcast); partials and finals keep queueing meanwhile.
+            lock.unlock();
+            m_sink(update);
+            lock.lock();
+        }
+    }
+
+    const Sink m_sink;
+    const Settings m_settings;
+
+    std::mutex m_mutex;
+    std::condition_variable m_wakeUp;
+    // At most one partial, always the last entry.
+    std::deque<Entry> m_queue;
+    // The caption text the client has after the updates sent so far.
+    std::string m_sent;
+    Statistics m_statistics;
+    bool m_stopping = false;
+    std::thread m_thread;
+};
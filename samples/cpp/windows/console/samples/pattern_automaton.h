@@ -0,0 +1,840 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#pragma once
+
+#include <speechapi_cxx.h>
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+// Intent patterns of a PatternMatchingModel ("[Go | Take me] to [floor|level] {floorName}", list, integer and
+// any entities), compiled ahead of time into one word trie and saved to a file. Loading the file reads flat
+// arrays without parsing pattern text, and the loaded automaton is immutable, so one instance can match the
+// results of any number of recognizers at the same time.
+// Matching walks the trie word by word and keeps each (trie node, position) once, so its cost grows with the
+// length of the utterance and the branching of the trie, not with the number of patterns. Like the SDK's
+// pattern matching, a pattern must match the whole utterance; case and punctuation are ignored. When several
+// patterns match, the first in the model wins. List entities are matched strictly, whatever their match mode.
+class PatternAutomaton final
+{
+public:
+    struct Match
+    {
+        std::string IntentId;
+        // Entity values by name as written in the pattern, e.g. "floorName" or "floorName:2".
+        std::map<std::string, std::string> Entities;
+    };
+
+    // Throws std::invalid_argument for a malformed pattern.
+    static std::shared_ptr<const PatternAutomaton> Compile(const Microsoft::CognitiveServices::Speech::Intent::PatternMatchingModel& model)
+    {
+        std::shared_ptr<PatternAutomaton> automaton(new PatternAutomaton());
+        Builder builder(*automaton);
+        for (const auto& entity : model.Entities)
+        {
+            builder.AddEntity(entity);
+        }
+        for (const auto& intent : model.Intents)
+        {
+            for (const auto& phrase : intent.Phrases)
+            {
+                builder.AddPattern(phrase, intent.Id);
+            }
+        }
+        builder.Finish();
+        return automaton;
+    }
+
+    // Throws std::runtime_error if the file cannot be read or is not a compiled automaton.
+    static std::shared_ptr<const PatternAutomaton> Load(const std::string& fileName)
+    {
+        std::ifstream file(fileName, std::ios::binary);
+        if (!file)
+        {
+            throw std::runtime_error("Cannot open " + fileName + ".");
+        }
+        std::vector<char> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+        std::shared_ptr<PatternAutomaton> automaton(new PatternAutomaton());
+        Reader reader{ data.data(), data.data() + data.size() };
+        if (data.size() < 4 || memcmp(data.data(), fileTag, 4) != 0)
+        {
+            throw std::runtime_error(fileName + " is not a compiled pattern file.");
+        }
+        reader.Position += 4;
+        reader.ReadStrings(automaton->m_vocabulary);
+        reader.ReadStrings(automaton->m_intents);
+        automaton->m_entities.resize(reader.ReadUInt32());
+        for (auto& entity : automaton->m_entities)
+        {
+            entity.Type = (Microsoft::CognitiveServices::Speech::Intent::EntityType)reader.ReadUInt32();
+            entity.Root = reader.ReadUInt32();
+        }
+        automaton->m_slots.resize(reader.ReadUInt32());
+        for (auto& slot : automaton->m_slots)
+        {
+            slot.Entity = reader.ReadUInt32();
+            slot.Name = reader.ReadString();
+        }
+        reader.ReadArray(automaton->m_nodes);
+        reader.ReadArray(automaton->m_edges);
+        automaton->Validate();
+        return automaton;
+    }
+
+    void Save(const std::string& fileName) const
+    {
+        std::ofstream file(fileName, std::ios::binary | std::ios::trunc);
+        if (!file)
+        {
+            throw std::runtime_error("Cannot create " + fileName + ".");
+        }
+        file.write(fileTag, 4);
+        WriteStrings(file, m_vocabulary);
+        WriteStrings(file, m_intents);
+        WriteUInt32(file, (uint32_t)m_entities.size());
+        for (const auto& entity : m_entities)
+        {
+            WriteUInt32(file, (uint32_t)entity.Type);
+            WriteUInt32(file, entity.Root);
+        }
+        WriteUInt32(file, (uint32_t)m_slots.size());
+        for (const auto& slot : m_slots)
+        {
+            WriteUInt32(file, slot.Entity);
+            WriteString(file, slot.Name);
+        }
+        WriteArray(file, m_nodes);
+        WriteArray(file, m_edges);
+        if (!file.flush())
+        {
+            throw std::runtime_error("Cannot write " + fileName + ".");
+        }
+    }
+
+    // Returns true and fills 'match' if a pattern matches the whole utterance, e.g. the text of a recognition result.
+    bool Find(const std::string& utterance, Match& match) const
+    {
+        auto words = SplitWords(utterance);
+        auto count = (uint32_t)words.size();
+        std::vector<int64_t> wordIds(count);
+        for (uint32_t i = 0; i < count; i++)
+        {
+            wordIds[i] = WordId(words[i]);
+        }
+
+        // Entity values found so far, as a tree of captures linked to the previous capture of their path.
+        struct Capture
+        {
+            int32_t Previous;
+            uint32_t Slot;
+            uint32_t Begin;
+            uint32_t End;
+        };
+        struct State
+        {
+            uint32_t Node;
+            int32_t Capture;
+        };
+        std::vector<Capture> captures;
+        // Every edge consumes at least one word, so the states of a position are complete once it is reached.
+        std::vector<std::vector<State>> states(count + 1);
+        std::unordered_set<uint64_t> visited;
+        auto enqueue = [&](uint32_t position, uint32_t node, int32_t capture, uint32_t slot, uint32_t begin)
+        {
+            if (visited.insert((uint64_t)node * (count + 1) + position).second)
+            {
+                if (slot != noSlot)
+                {
+                    captures.push_back({ capture, slot, begin, position });
+                    capture = (int32_t)captures.size() - 1;
+                }
+                states[position].push_back({ node, capture });
+            }
+        };
+
+        enqueue(0, 0, -1, noSlot, 0);
+        const Node* best = nullptr;
+        int32_t bestCapture = -1;
+        for (uint32_t position = 0; position <= count; position++)
+        {
+            for (const auto state : states[position])
+            {
+                const auto& node = m_nodes[state.Node];
+                if (position == count)
+                {
+                    if (node.Accept >= 0 && (best == nullptr || node.Priority < best->Priority))
+                    {
+                        best = &node;
+                        bestCapture = state.Capture;
+                    }
+                    continue;
+                }
+
+                auto child = FindWordEdge(node, wordIds[position]);
+                if (child != noNode)
+                {
+                    enqueue(position + 1, child, state.Capture, noSlot, 0);
+                }
+
+                for (auto e = node.FirstSlotEdge; e < node.FirstSlotEdge + node.SlotEdgeCount; e++)
+                {
+                    auto slot = m_edges[e].Label;
+                    auto target = m_edges[e].Child;
+                    const auto& entity = m_entities[m_slots[slot].Entity];
+                    switch (entity.Type)
+                    {
+                    case Microsoft::CognitiveServices::Speech::Intent::EntityType::List:
+                        for (auto phraseNode = entity.Root, end = position; end < count; end++)
+                        {
+                            phraseNode = FindWordEdge(m_nodes[phraseNode], wordIds[end]);
+                            if (phraseNode == noNode)
+                            {
+                                break;
+                            }
+                            if (m_nodes[phraseNode].Accept == phraseEnd)
+                            {
+                                enqueue(end + 1, target, state.Capture, slot, position);
+                            }
+                        }
+                        break;
+
+                    case Microsoft::CognitiveServices::Speech::Intent::EntityType::PrebuiltInteger:
+                        for (uint32_t length = 1; length <= 2 && position + length <= count; length++)
+                        {
+                            std::string value;
+                            if (ParseInteger(words, position, length, value))
+                            {
+                                enqueue(position + length, target, state.Capture, slot, position);
+                            }
+                        }
+                        break;
+
+                    default:
+                        for (auto end = position + 1; end <= count; end++)
+                        {
+                            enqueue(end, target, state.Capture, slot, position);
+                        }
+                        break;
+                    }
+                }
+            }
+        }
+
+        if (best == nullptr)
+        {
+            return false;
+        }
+        match.IntentId = m_intents[best->Accept];
+        match.Entities.clear();
+        for (auto c = bestCapture; c >= 0; c = captures[c].Previous)
+        {
+            const auto& capture = captures[c];
+            const auto& slot = m_slots[capture.Slot];
+            std::string value;
+            if (m_entities[slot.Entity].Type != Microsoft::CognitiveServices::Speech::Intent::EntityType::PrebuiltInteger ||
+                !ParseInteger(words, capture.Begin, capture.End - capture.Begin, value))
+            {
+                value = Join(words, capture.Begin, capture.End);
+            }
+            match.Entities.emplace(slot.Name, value);
+        }
+        return true;
+    }
+
+    size_t GetNodeCount() const
+    {
+        return m_nodes.size();
+    }
+
+private:
+    static constexpr const char* fileTag = "PMA1";
+    static constexpr uint32_t noNode = 0xFFFFFFFF;
+    static constexpr uint32_t noSlot = 0xFFFFFFFF;
+    // Accept value of the last word of a phrase in the trie of a list entity.
+    static constexpr int32_t phraseEnd = -2;
+
+    // Trie node. Word edges are sorted by word id, slot edges follow them in the edge array.
+    struct Node
+    {
+        // Index of the intent accepted here, -1 if none, or phraseEnd.
+        int32_t Accept;
+        // Order of the accepted pattern in the model, the lowest wins.
+        uint32_t Priority;
+        uint32_t FirstWordEdge;
+        uint32_t WordEdgeCount;
+        uint32_t FirstSlotEdge;
+        uint32_t SlotEdgeCount;
+    };
+
+    struct Edge
+    {
+        // Word id or slot index.
+        uint32_t Label;
+        uint32_t Child;
+    };
+
+    struct Entity
+    {
+        Microsoft::CognitiveServices::Speech::Intent::EntityType Type;
+        // Root of the phrase trie of a list entity.
+        uint32_t Root;
+    };
+
+    // An entity reference in the patterns, e.g. "{floorName:1}".
+    struct Slot
+    {
+        uint32_t Entity;
+        std::string Name;
+    };
+
+    // Builds the trie with map-based nodes, then flattens it into the sorted arrays used for matching.
+    class Builder final
+    {
+    public:
+        explicit Builder(PatternAutomaton& automaton) : m_automaton(automaton), m_nodes(1)
+        {
+        }
+
+        void AddEntity(const Microsoft::CognitiveServices::Speech::Intent::PatternMatchingEntity& entity)
+        {
+            auto index = EntityIndex(entity.Id);
+            m_entityTypes[index] = entity.Type;
+            if (entity.Type == Microsoft::CognitiveServices::Speech::Intent::EntityType::List)
+            {
+                for (const auto& phrase : entity.Phrases)
+                {
+                    auto node = m_entityRoots[index];
+                    for (const auto& word : SplitWords(phrase))
+                    {
+                        node = WordChild(node, word);
+                    }
+                    if (node != m_entityRoots[index])
+                    {
+                        m_nodes[node].Accept = phraseEnd;
+                    }
+                }
+            }
+        }
+
+        void AddPattern(const std::string& pattern, const std::string& intentId)
+        {
+            size_t position = 0;
+            auto sequence = ParseSequence(pattern, position, '\0');
+            auto intent = IntentIndex(intentId);
+            for (const auto& tokens : Expand(sequence, 0))
+            {
+                uint32_t node = 0;
+                for (const auto& token : tokens)
+                {
+                    node = token.IsSlot ? SlotChild(node, token.Text) : WordChild(node, token.Text);
+                }
+                if (node != 0 && m_nodes[node].Accept < 0)
+                {
+                    m_nodes[node].Accept = (int32_t)intent;
+                    m_nodes[node].Priority = m_nextPriority;
+                }
+            }
+            m_nextPriority++;
+        }
+
+        void Finish()
+        {
+            auto& vocabulary = m_automaton.m_vocabulary;
+            for (const auto& node : m_nodes)
+            {
+                for (const auto& edge : node.Words)
+                {
+                    vocabulary.push_back(edge.first);
+                }
+            }
+            std::sort(vocabulary.begin(), vocabulary.end());
+            vocabulary.erase(std::unique(vocabulary.begin(), vocabulary.end()), vocabulary.end());
+
+            for (const auto& node : m_nodes)
+            {
+                Node flat{ node.Accept, node.Priority, (uint32_t)m_automaton.m_edges.size(), (uint32_t)node.Words.size(), 0, 0 };
+                // std::map keeps the words sorted, so the word ids come out sorted as well.
+                for (const auto& edge : node.Words)
+                {
+                    m_automaton.m_edges.push_back({ (uint32_t)m_automaton.WordId(edge.first), edge.second });
+                }
+                flat.FirstSlotEdge = (uint32_t)m_automaton.m_edges.size();
+                flat.SlotEdgeCount = (uint32_t)node.Slots.size();
+                for (const auto& edge : node.Slots)
+                {
+                    m_automaton.m_edges.push_back({ edge.first, edge.second });
+                }
+                m_automaton.m_nodes.push_back(flat);
+            }
+
+            for (size_t i = 0; i < m_entityRoots.size(); i++)
+            {
+                m_automaton.m_entities.push_back({ m_entityTypes[i], m_entityRoots[i] });
+            }
+        }
+
+    private:
+        // Patterns with more word sequences than this after expanding the optional groups are rejected.
+        static constexpr size_t maxExpansions = 4096;
+
+        struct BuildNode
+        {
+            int32_t Accept = -1;
+            uint32_t Priority = 0;
+            std::map<std::string, uint32_t> Words;
+            std::map<uint32_t, uint32_t> Slots;
+        };
+
+        struct Token
+        {
+            bool IsSlot;
+            std::string Text;
+        };
+
+        // A word, an entity reference, or a group of alternatives: "[a | b]" (optional) or "(a | b)".
+        struct Element
+        {
+            enum class Kind { Word, Slot, Group };
+
+            Element(Kind type, std::string text = std::string()) : Type(type), Text(std::move(text))
+            {
+            }
+
+            Kind Type;
+            std::string Text;
+            bool Optional = false;
+            std::vector<std::vector<Element>> Alternatives;
+        };
+
+        std::vector<Element> ParseSequence(const std::string& pattern, size_t& position, char closing)
+        {
+            std::vector<Element> sequence;
+            std::string text;
+            auto flushText = [&]()
+            {
+                for (auto& word : SplitWords(text))
+                {
+                    sequence.push_back({ Element::Kind::Word, std::move(word) });
+                }
+                text.clear();
+            };
+
+            while (position < pattern.size())
+            {
+                auto c = pattern[position];
+                if (c == closing || (closing != '\0' && c == '|'))
+                {
+                    break;
+                }
+                position++;
+                if (c == '[' || c == '(')
+                {
+                    flushText();
+                    Element group(Element::Kind::Group);
+                    group.Optional = c == '[';
+                    auto groupClosing = c == '[' ? ']' : ')';
+                    for (;;)
+                    {
+                        group.Alternatives.push_back(ParseSequence(pattern, position, groupClosing));
+                        if (position >= pattern.size())
+                        {
+                            throw std::invalid_argument("Unclosed group in pattern: " + pattern);
+                        }
+                        if (pattern[position++] == groupClosing)
+                        {
+                            break;
+                        }
+                    }
+                    sequence.push_back(std::move(group));
+                }
+                else if (c == '{')
+                {
+                    flushText();
+                    auto end = pattern.find('}', position);
+                    if (end == std::string::npos || end == position)
+                    {
+                        throw std::invalid_argument("Malformed entity in pattern: " + pattern);
+                    }
+                    sequence.push_back({ Element::Kind::Slot, pattern.substr(position, end - position) });
+                    position = end + 1;
+                }
+                else if (c == ']' || c == ')' || c == '}' || c == '|')
+                {
+                    throw std::invalid_argument("Unexpected '" + std::string(1, c) + "' in pattern: " + pattern);
+                }
+                else
+                {
+                    text += c;
+                }
+            }
+            flushText();
+            return sequence;
+        }
+
+        // All the token sequences of a parsed pattern, from element 'first' on.
+        std::vector<std::vector<Token>> Expand(const std::vector<Element>& sequence, size_t first)
+        {
+            if (first == sequence.size())
+            {
+                return { {} };
+            }
+            auto rest = Expand(sequence, first + 1);
+            const auto& element = sequence[first];
+
+            std::vector<std::vector<Token>> heads;
+            if (element.Type == Element::Kind::Group)
+            {
+                for (const auto& alternative : element.Alternatives)
+                {
+                    auto expanded = Expand(alternative, 0);
+                    heads.insert(heads.end(), expanded.begin(), expanded.end());
+                }
+                if (element.Optional)
+                {
+                    heads.push_back({});
+                }
+            }
+            else
+            {
+                heads.push_back({ { element.Type == Element::Kind::Slot, element.Text } });
+            }
+
+            if (heads.size() * rest.size() > maxExpansions)
+            {
+                throw std::invalid_argument("Pattern has too many alternatives.");
+            }
+            std::vector<std::vector<Token>> expansions;
+            for (const auto& head : heads)
+            {
+                for (const auto& tail : rest)
+                {
+                    expansions.push_back(head);
+                    expansions.back().insert(expansions.back().end(), tail.begin(), tail.end());
+                }
+            }
+            return expansions;
+        }
+
+        uint32_t WordChild(uint32_t node, const std::string& word)
+        {
+            auto found = m_nodes[node].Words.find(word);
+            if (found != m_nodes[node].Words.end())
+            {
+                return found->second;
+            }
+            m_nodes.emplace_back();
+            return m_nodes[node].Words[word] = (uint32_t)m_nodes.size() - 1;
+        }
+
+        uint32_t SlotChild(uint32_t node, const std::string& name)
+        {
+            auto slot = SlotIndex(name);
+            auto found = m_nodes[node].Slots.find(slot);
+            if (found != m_nodes[node].Slots.end())
+            {
+                return found->second;
+            }
+            m_nodes.emplace_back();
+            return m_nodes[node].Slots[slot] = (uint32_t)m_nodes.size() - 1;
+        }
+
+        // Entities that are referenced but not declared are Any entities, as in the SDK.
+        uint32_t EntityIndex(const std::string& id)
+        {
+            auto inserted = m_entityIndexes.emplace(id, (uint32_t)m_entityRoots.size());
+            if (inserted.second)
+            {
+                m_nodes.emplace_back();
+                m_entityRoots.push_back((uint32_t)m_nodes.size() - 1);
+                m_entityTypes.push_back(Microsoft::CognitiveServices::Speech::Intent::EntityType::Any);
+            }
+            return inserted.first->second;
+        }
+
+        // "floorName:1" refers to the entity "floorName".
+        uint32_t SlotIndex(const std::string& name)
+        {
+            auto found = m_slotIndexes.find(name);
+            if (found != m_slotIndexes.end())
+            {
+                return found->second;
+            }
+            auto entity = EntityIndex(name.substr(0, name.find(':')));
+            m_automaton.m_slots.push_back({ entity, name });
+            return m_slotIndexes[name] = (uint32_t)m_automaton.m_slots.size() - 1;
+        }
+
+        uint32_t IntentIndex(const std::string& id)
+        {
+            auto inserted = m_intentIndexes.emplace(id, (uint32_t)m_automaton.m_intents.size());
+            if (inserted.second)
+            {
+                m_automaton.m_intents.push_back(id);
+            }
+            return inserted.first->second;
+        }
+
+        PatternAutomaton& m_automaton;
+        std::vector<BuildNode> m_nodes;
+        std::map<std::string, uint32_t> m_entityIndexes;
+        std::vector<uint32_t> m_entityRoots;
+        std::vector<Microsoft::CognitiveServices::Speech::Intent::EntityType> m_entityTypes;
+        std::map<std::string, uint32_t> m_slotIndexes;
+        std::map<std::string, uint32_t> m_intentIndexes;
+        uint32_t m_nextPriority = 0;
+    };
+
+    // Bounds-checked reading of a loaded file.
+    struct Reader
+    {
+        const char* Position;
+        const char* End;
+
+        void Need(size_t size)
+        {
+            if ((size_t)(End - Position) < size)
+            {
+                throw std::runtime_error("Compiled pattern file is truncated.");
+            }
+        }
+
+        uint32_t ReadUInt32()
+        {
+            Need(sizeof(uint32_t));
+            uint32_t value;
+            memcpy(&value, Position, sizeof(value));
+            Position += sizeof(value);
+            return value;
+        }
+
+        std::string ReadString()
+        {
+            auto size = ReadUInt32();
+            Need(size);
+            std::string value(Position, size);
+            Position += size;
+            return value;
+        }
+
+        void ReadStrings(std::vector<std::string>& values)
+        {
+            values.resize(ReadUInt32());
+            for (auto& value : values)
+            {
+                value = ReadString();
+            }
+        }
+
+        template <class T>
+        void ReadArray(std::vector<T>& values)
+        {
+            auto count = ReadUInt32();
+            Need((size_t)count * sizeof(T));
+            values.resize(count);
+            memcpy(values.data(), Position, (size_t)count * sizeof(T));
+            Position += (size_t)count * sizeof(T);
+        }
+    };
+
+    PatternAutomaton() = default;
+
+    // Checks the indexes of a loaded file, so that matching cannot read out of bounds.
+    void Validate() const
+    {
+        auto fail = []() { throw std::runtime_error("Compiled pattern file is corrupt."); };
+        if (m_nodes.empty())
+        {
+            fail();
+        }
+        for (const auto& node : m_nodes)
+        {
+            if ((uint64_t)node.FirstWordEdge + node.WordEdgeCount > m_edges.size() ||
+                (uint64_t)node.FirstSlotEdge + node.SlotEdgeCount > m_edges.size() ||
+                node.Accept >= (int32_t)m_intents.size() || node.Accept < phraseEnd)
+            {
+                fail();
+            }
+            for (auto e = node.FirstSlotEdge; e < node.FirstSlotEdge + node.SlotEdgeCount; e++)
+            {
+                if (m_edges[e].Label >= m_slots.size())
+                {
+                    fail();
+                }
+            }
+        }
+        for (const auto& edge : m_edges)
+        {
+            if (edge.Child >= m_nodes.size())
+            {
+                fail();
+            }
+        }
+        for (const auto& slot : m_slots)
+        {
+            if (slot.Entity >= m_entities.size())
+            {
+                fail();
+            }
+        }
+        for (const auto& entity : m_entities)
+        {
+            if (entity.Root >= m_nodes.size())
+            {
+                fail();
+            }
+        }
+    }
+
+    // Index of the word in the sorted vocabulary, -1 if no pattern contains it.
+    int64_t WordId(const std::string& word) const
+    {
+        auto found = std::lower_bound(m_vocabulary.begin(), m_vocabulary.end(), word);
+        return found != m_vocabulary.end() && *found == word ? found - m_vocabulary.begin() : -1;
+    }
+
+    uint32_t FindWordEdge(const Node& node, int64_t wordId) const
+    {
+        if (wordId < 0)
+        {
+            return noNode;
+        }
+        auto first = m_edges.begin() + node.FirstWordEdge;
+        auto last = first + node.WordEdgeCount;
+        auto found = std::lower_bound(first, last, (uint32_t)wordId, [](const Edge& edge, uint32_t label) { return edge.Label < label; });
+        if (found == last || found->Label != wordId)
+        {
+            return noNode;
+        }
+        return found->Child;
+    }
+
+    // Lower case words; anything but letters, digits and apostrophes separates words.
+    static std::vector<std::string> SplitWords(const std::string& text)
+    {
+        std::vector<std::string> words;
+        std::string word;
+        for (auto c : text)
+        {
+            auto u = (unsigned char)c;
+            if (u >= 0x80 || isalnum(u) || c == '\'')
+            {
+                word += (char)tolower(u);
+            }
+            else if (!word.empty())
+            {
+                words.push_back(std::move(word));
+                word.clear();
+            }
+        }
+        if (!word.empty())
+        {
+            words.push_back(std::move(word));
+        }
+        return words;
+    }
+
+    static std::string Join(const std::vector<std::string>& words, uint32_t begin, uint32_t end)
+    {
+        std::string text;
+        for (auto i = begin; i < end; i++)
+        {
+            text += (i > begin ? " " : "") + words[i];
+        }
+        return text;
+    }
+
+    // Digits, or a number below 100 written as one or two words ("seven", "twenty one").
+    static bool ParseInteger(const std::vector<std::string>& words, uint32_t position, uint32_t length, std::string& value)
+    {
+        static const char* const units[] = { "zero", "one", "two", "three", "four", "five", "six", "seven", "eight", "nine", "ten",
+            "eleven", "twelve", "thirteen", "fourteen", "fifteen", "sixteen", "seventeen", "eighteen", "nineteen" };
+        static const char* const tens[] = { "twenty", "thirty", "forty", "fifty", "sixty", "seventy", "eighty", "ninety" };
+        auto indexOf = [](const char* const* names, size_t count, const std::string& word)
+        {
+            for (size_t i = 0; i < count; i++)
+            {
+                if (word == names[i])
+                {
+                    return (int)i;
+                }
+            }
+            return -1;
+        };
+
+        const auto& first = words[position];
+        if (length == 1 && std::all_of(first.begin(), first.end(), [](char c) { return isdigit((unsigned char)c) != 0; }))
+        {
+            value = first;
+            return true;
+        }
+        auto unit = indexOf(units, 20, first);
+        if (length == 1 && unit >= 0)
+        {
+            value = std::to_string(unit);
+            return true;
+        }
+        auto ten = indexOf(tens, 8, first);
+        if (ten < 0)
+        {
+            return false;
+        }
+        if (length == 1)
+        {
+            value = std::to_string((ten + 2) * 10);
+            return true;
+        }
+        unit = indexOf(units, 10, words[position + 1]);
+        if (unit <= 0)
+        {
+            return false;
+        }
+        value = std::to_string((ten + 2) * 10 + unit);
+        return true;
+    }
+
+    // The arrays are written in host byte order, which is little endian on all supported platforms.
+    template <class T>
+    static void WriteArray(std::ostream& out, const std::vector<T>& values)
+    {
+        WriteUInt32(out, (uint32_t)values.size());
+        out.write(reinterpret_cast<const char*>(values.data()), values.size() * sizeof(T));
+    }
+
+    static void WriteUInt32(std::ostream& out, uint32_t value)
+    {
+        out.write(reinterpret_cast<const char*>(&value), sizeof(value));
+    }
+
+    static void WriteString(std::ostream& out, const std::string& value)
+    {
+        WriteUInt32(out, (uint32_t)value.size());
+        out.write(value.data(), value.size());
+    }
+
+    static void WriteStrings(std::ostream& out, const std::vector<std::string>& values)
+    {
+        WriteUInt32(out, (uint32_t)values.size());
+        for (const auto& value : values)
+        {
+            WriteString(out, value);
+        }
+    }
+
+    std::vector<std::string> m_vocabulary;
+    std::vector<std::string> m_intents;
+    std::vector<Entity> m_entities;
+    std::vector<Slot> m_slots;
+    std::vector<Node> m_nodes;
+    std::vector<Edge> m_edges;
+};
@@ -0,0 +1,239 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#pragma once
+
+#include <speechapi_cxx.h>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Synthesizes long text sentence by sentence, with the next sentences synthesized while the audio of the
+// current one is written out. The audio of all sentences is written in order into one push audio output
+// stream callback, so the time to the first audio depends on the first sentence instead of the whole text.
+// The output format must be headerless (raw PCM or a compressed format), so the audio of the sentences
+// can be concatenated. Riff formats, which are the default, put a header in front of every sentence.
+class PipelinedSynthesizer final
+{
+public:
+    struct Statistics
+    {
+        size_t Sentences = 0;
+        uint64_t Bytes = 0;
+        std::chrono::milliseconds FirstAudio{ 0 };
+        std::chrono::milliseconds Total{ 0 };
+    };
+
+    // Creates 'lookahead' synthesizers, which is how many sentences are synthesized at once at most.
+    PipelinedSynthesizer(const std::shared_ptr<Microsoft::CognitiveServices::Speech::SpeechConfig>& config, size_t lookahead = 3)
+    {
+        using namespace Microsoft::CognitiveServices::Speech;
+
+        auto format = config->GetSpeechSynthesisOutputFormat();
+        if (format.empty() || format.compare(0, 5, "riff-") == 0)
+        {
+            throw std::invalid_argument("Pipelined synthesis requires a headerless output format, e.g. Raw16Khz16BitMonoPcm.");
+        }
+        if (lookahead == 0)
+        {
+            throw std::invalid_argument("Lookahead must be at least one sentence.");
+        }
+
+        for (size_t i = 0; i < lookahead; i++)
+        {
+            auto synthesizer = SpeechSynthesizer::FromConfig(config, nullptr);
+            Connection::FromSpeechSynthesizer(synthesizer)->Open(false);
+            m_synthesizers.push_back(synthesizer);
+        }
+    }
+
+    // Splits plain text after '.', '!', '?' and line breaks. Whitespace between sentences is dropped.
+    static std::vector<std::string> SplitSentences(const std::string& text)
+    {
+        std::vector<std::string> sentences;
+        std::string sentence;
+        auto flush = [&]()
+        {
+            auto begin = sentence.find_first_not_of(" \t\r\n");
+            if (begin != std::string::npos)
+            {
+                sentences.push_back(sentence.substr(begin, sentence.find_last_not_of(" \t\r\n") - begin + 1));
+            }
+            sentence.clear();
+        };
+
+        for (size_t i = 0; i < text.size(); i++)
+        {
+            sentence += text[i];
+            bool end = text[i] == '.' || text[i] == '!' || text[i] == '?';
+            // A full stop ends a sentence only before whitespace, so "3.5" or "e.g." within a word stay together.
+            if ((end && (i + 1 == text.size() || isspace((unsigned char)text[i + 1]))) || text[i] == '\n')
+            {
+                flush();
+            }
+        }
+        flush();
+        return sentences;
+    }
+
+    // Synthesizes 'text' into 'output' and closes it. Throws std::runtime_error when the synthesis
+    // of a sentence is canceled, after the audio of the sentences before it has been written.
+    Statistics Speak(const std::string& text, Microsoft::CognitiveServices::Speech::Audio::PushAudioOutputStreamCallback& output)
+    {
+        auto started = std::chrono::steady_clock::now();
+        Statistics statistics;
+
+        m_output = &output;
+        m_sentences.clear();
+        for (auto& sentence : SplitSentences(text))
+        {
+            m_sentences.emplace_back(new Sentence{ std::move(sentence) });
+        }
+        m_next = 0;
+        m_written = 0;
+        m_firstAudio = std::chrono::steady_clock::time_point();
+        m_error.clear();
+
+        // Each synthesizer takes the next sentence that is not taken yet, so sentence i + lookahead
+        // starts only once one of the sentences before it is complete.
+        std::atomic<size_t> nextSentence(0);
+        std::vector<std::thread> workers;
+        for (auto& synthesizer : m_synthesizers)
+        {
+            workers.emplace_back([this, synthesizer, &nextSentence]()
+            {
+                for (size_t index = nextSentence++; index < m_sentences.size() && !Failed(); index = nextSentence++)
+                {
+                    Synthesize(*synthesizer, index);
+                }
+            });
+        }
+        for (auto& worker : workers)
+        {
+            worker.join();
+        }
+        output.Close();
+
+        statistics.Sentences = m_sentences.size();
+        statistics.Bytes = m_written;
+        if (m_written > 0)
+        {
+            statistics.FirstAudio = std::chrono::duration_cast<std::chrono::milliseconds>(m_firstAudio - started);
+        }
+        statistics.Total = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - started);
+
+        if (!m_error.empty())
+        {
+            throw std::runtime_error(m_error);
+        }
+        return statistics;
+    }
+
+private:
+    struct Sentence
+    {
+        std::string Text;
+        // Audio received while an earlier sentence is still being written out.
+        std::vector<uint8_t> Pending;
+        bool Complete = false;
+    };
+
+    bool Failed()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return !m_error.empty();
+    }
+
+    // Streams the audio of one sentence as the service sends it.
+    void Synthesize(Microsoft::CognitiveServices::Speech::SpeechSynthesizer& synthesizer, size_t index)
+    {
+        using namespace Microsoft::CognitiveServices::Speech;
+
+        auto result = synthesizer.StartSpeakingTextAsync(m_sentences[index]->Text).get();
+        auto stream = AudioDataStream::FromResult(result);
+
+        uint8_t buffer[4096];
+        uint32_t filledSize = 0;
+        while ((filledSize = stream->ReadData(buffer, sizeof(buffer))) > 0)
+        {
+            OnAudio(index, buffer, filledSize);
+        }
+
+        if (stream->GetStatus() == StreamStatus::Canceled)
+        {
+            auto cancellation = SpeechSynthesisCancellationDetails::FromStream(stream);
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (m_error.empty())
+            {
+                m_error = "Synthesis of sentence " + std::to_string(index + 1) + " was canceled: " + cancellation->ErrorDetails;
+            }
+            // Later sentences are not written after a gap.
+            m_next = m_sentences.size();
+            return;
+        }
+        OnComplete(index);
+    }
+
+    // Writes audio of the sentence being played out directly, and holds back audio of later sentences.
+    void OnAudio(size_t index, uint8_t* data, uint32_t size)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (index == m_next)
+        {
+            Write(data, size);
+        }
+        else if (index > m_next)
+        {
+            auto& pending = m_sentences[index]->Pending;
+            pending.insert(pending.end(), data, data + size);
+        }
+    }
+
+    void OnComplete(size_t index)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_sentences[index]->Complete = true;
+
+        // Moves on past all complete sentences, writing the audio each next sentence already has.
+        while (m_next < m_sentences.size() && m_sentences[m_next]->Complete)
+        {
+            if (++m_next < m_sentences.size())
+            {
+                auto& pending = m_sentences[m_next]->Pending;
+                if (!pending.empty())
+                {
+                    Write(pending.data(), (uint32_t)pending.size());
+                }
+                std::vector<uint8_t>().swap(pending);
+            }
+        }
+    }
+
+    // Must be called with the lock held, which also keeps the writes in order.
+    void Write(uint8_t* data, uint32_t size)
+    {
+        if (m_written == 0)
+        {
+            m_firstAudio = std::chrono::steady_clock::now();
+        }
+        m_output->Write(data, size);
+        m_written += size;
+    }
+
+    std::vector<std::shared_ptr<Microsoft::CognitiveServices::Speech::SpeechSynthesizer>> m_synthesizers;
+
+    std::mutex m_mutex;
+    Microsoft::CognitiveServices::Speech::Audio::PushAudioOutputStreamCallback* m_output = nullptr;
+    std::vector<std::unique_ptr<Sentence>> m_sentences;
+    size_t m_next = 0;
+    uint64_t m_written = 0;
+    std::chrono::steady_clock::time_point m_firstAudio;
+    std::string m_error;
+};
@@ -0,0 +1,115 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#pragma once
+
+#include <cstdint>
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#include <tlhelp32.h>
+#elif defined(__APPLE__)
+#include <dirent.h>
+#include <mach/mach.h>
+#else
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <dirent.h>
+#endif
+
+// Number of threads of the process. 0 if it cannot be read.
+inline uint32_t GetThreadCount()
+{
+#ifdef _WIN32
+    auto snapshot = CreateToolhelp32Snapshot(TH32CS_SNAPTHREAD, 0);
+    if (snapshot == INVALID_HANDLE_VALUE)
+    {
+        return 0;
+    }
+    uint32_t count = 0;
+    THREADENTRY32 entry;
+    entry.dwSize = sizeof(entry);
+    for (auto found = Thread32First(snapshot, &entry); found; found = Thread32Next(snapshot, &entry))
+    {
+        if (entry.th32OwnerProcessID == GetCurrentProcessId())
+        {
+            count++;
+        }
+    }
+    CloseHandle(snapshot);
+    return count;
+#elif defined(__APPLE__)
+    thread_act_array_t threads;
+    mach_msg_type_number_t count = 0;
+    if (task_threads(mach_task_self(), &threads, &count) != KERN_SUCCESS)
+    {
+        return 0;
+    }
+    for (mach_msg_type_number_t i = 0; i < count; i++)
+    {
+        mach_port_deallocate(mach_task_self(), threads[i]);
+    }
+    vm_deallocate(mach_task_self(), (vm_address_t)threads, count * sizeof(thread_act_t));
+    return count;
+#else
+    FILE* status = fopen("/proc/self/status", "r");
+    if (status == nullptr)
+    {
+        return 0;
+    }
+    uint32_t count = 0;
+    char line[256];
+    while (fgets(line, sizeof(line), status) != nullptr)
+    {
+        if (strncmp(line, "Threads:", 8) == 0)
+        {
+            count = (uint32_t)strtoul(line + 8, nullptr, 10);
+            break;
+        }
+    }
+    fclose(status);
+    return count;
+#endif
+}
+
+// Number of open handles (Windows) or file descriptors, which includes sockets. 0 if it cannot be read.
+inline uint32_t GetHandleCount()
+{
+#ifdef _WIN32
+    DWORD count = 0;
+    if (!GetProcessHandleCount(GetCurrentProcess(), &count))
+    {
+        return 0;
+    }
+    return count;
+#else
+#ifdef __APPLE__
+    auto directory = opendir("/dev/fd");
+#else
+    auto directory = opendir("/proc/self/fd");
+#endif
+    if (directory == nullptr)
+    {
+        return 0;
+    }
+    uint32_t count = 0;
+    while (auto entry = readdir(directory))
+    {
+        if (entry->d_name[0] != '.')
+        {
+            count++;
+        }
+    }
+    closedir(directory);
+    // The directory being read is one of the descriptors.
+    return count > 0 ? count - 1 : 0;
+#endif
+}
@@ -0,0 +1,407 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#pragma once
+
+#include <speechapi_cxx.h>
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <fstream>
+#include <istream>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include <nlohmann/json.hpp>
+#include "read_ahead_audio_callback.h"
+#include "recognition_session_runner.h"
+
+// Writes per-phoneme pronunciation scores as a compact columnar file for analytics, filled as results arrive.
+// One row per phoneme (words without phonemes, e.g. omissions, get one row with an empty phoneme and a NaN score).
+// Layout, all integers little endian:
+//   file:       "PACF", uint32 version (1), then row groups up to the end of the file
+//   row group:  uint32 rows, then the columns in this order, each stored contiguously:
+//               item (uint32), word_index (uint32), word (string), word_accuracy (float32),
+//               error_type (string), phoneme (string), phoneme_accuracy (float32)
+//   string:     dictionary of the row group: uint32 entries, each uint32 length + bytes; then uint16 codes
+// Words and phonemes repeat a lot, so the dictionaries keep the file small and the numeric columns can be
+// loaded directly, e.g. with numpy.frombuffer().
+class PronunciationColumnWriter final
+{
+public:
+    struct Row
+    {
+        uint32_t Item;
+        uint32_t WordIndex;
+        std::string Word;
+        float WordAccuracy;
+        std::string ErrorType;
+        std::string Phoneme;
+        float PhonemeAccuracy;
+    };
+
+    // Throws std::runtime_error if the file cannot be created.
+    explicit PronunciationColumnWriter(const std::string& fileName)
+        : m_file(fileName, std::ios::binary | std::ios::trunc)
+    {
+        if (!m_file)
+        {
+            throw std::runtime_error("Cannot create " + fileName + ".");
+        }
+        m_file.write("PACF", 4);
+        WriteUInt32(1);
+    }
+
+    PronunciationColumnWriter(const PronunciationColumnWriter&) = delete;
+    PronunciationColumnWriter& operator=(const PronunciationColumnWriter&) = delete;
+
+    ~PronunciationColumnWriter()
+    {
+        Flush();
+    }
+
+    // Adds the rows of one item; they are written when a row group is full or on Flush().
+    void Append(const std::vector<Row>& rows)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for (const auto& row : rows)
+        {
+            m_items.push_back(row.Item);
+            m_wordIndexes.push_back(row.WordIndex);
+            m_words.Add(row.Word);
+            m_wordAccuracies.push_back(row.WordAccuracy);
+            m_errorTypes.Add(row.ErrorType);
+            m_phonemes.Add(row.Phoneme);
+            m_phonemeAccuracies.push_back(row.PhonemeAccuracy);
+            if (m_items.size() == maxRowsPerGroup)
+            {
+                WriteRowGroup();
+            }
+        }
+    }
+
+    // Writes the pending rows as a row group of their own.
+    void Flush()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!m_items.empty())
+        {
+            WriteRowGroup();
+        }
+        m_file.flush();
+    }
+
+private:
+    // Codes of the string columns are 16 bit, a row group cannot have more distinct strings than rows.
+    static constexpr size_t maxRowsPerGroup = 65535;
+
+    class StringColumn final
+    {
+    public:
+        void Add(const std::string& value)
+        {
+            auto inserted = m_codes.emplace(value, (uint16_t)m_entries.size());
+            if (inserted.second)
+            {
+                m_entries.push_back(value);
+            }
+            m_rows.push_back(inserted.first->second);
+        }
+
+        void Write(PronunciationColumnWriter& writer)
+        {
+            writer.WriteUInt32((uint32_t)m_entries.size());
+            for (const auto& entry : m_entries)
+            {
+                writer.WriteUInt32((uint32_t)entry.size());
+                writer.m_file.write(entry.data(), entry.size());
+            }
+            writer.WriteArray(m_rows);
+            m_codes.clear();
+            m_entries.clear();
+            m_rows.clear();
+        }
+
+    private:
+        std::unordered_map<std::string, uint16_t> m_codes;
+        std::vector<std::string> m_entries;
+        std::vector<uint16_t> m_rows;
+    };
+
+    void WriteRowGroup()
+    {
+        WriteUInt32((uint32_t)m_items.size());
+        WriteArray(m_items);
+        WriteArray(m_wordIndexes);
+        m_words.Write(*this);
+        WriteArray(m_wordAccuracies);
+        m_errorTypes.Write(*this);
+        m_phonemes.Write(*this);
+        WriteArray(m_phonemeAccuracies);
+        m_items.clear();
+        m_wordIndexes.clear();
+        m_wordAccuracies.clear();
+        m_phonemeAccuracies.clear();
+    }
+
+    // The columns are written in host byte order, which is little endian on all supported platforms.
+    template <class T>
+    void WriteArray(const std::vector<T>& values)
+    {
+        m_file.write(reinterpret_cast<const char*>(values.data()), values.size() * sizeof(T));
+    }
+
+    void WriteUInt32(uint32_t value)
+    {
+        m_file.write(reinterpret_cast<const char*>(&value), sizeof(value));
+    }
+
+    std::mutex m_mutex;
+    std::ofstream m_file;
+    std::vector<uint32_t> m_items;
+    std::vector<uint32_t> m_wordIndexes;
+    StringColumn m_words;
+    std::vector<float> m_wordAccuracies;
+    StringColumn m_errorTypes;
+    StringColumn m_phonemes;
+    std::vector<float> m_phonemeAccuracies;
+};
+
+// Scores many (audio, reference text) pairs with pronunciation assessment, e.g. all the reading assignments
+// of a class overnight. Up to 'MaxConcurrent' items run at once. Every worker keeps its own
+// PronunciationAssessmentConfig and only changes the reference text per item. A recognizer is still created
+// per item, because its audio input is fixed when it is created. Each item is recognized continuously, so
+// readings with long pauses are scored completely. The words and phonemes go to a PronunciationColumnWriter;
+// a tab-separated summary line per item
+// "<item>\t<audio file>\t<status>\t<accuracy>\t<fluency>\t<completeness>\t<pronunciation>" goes to 'summary'.
+class PronunciationBatchScorer final
+{
+public:
+    struct Item
+    {
+        // 16 kHz, 16-bit mono WAV file.
+        std::string AudioFile;
+        std::string ReferenceText;
+    };
+
+    struct Settings
+    {
+        Microsoft::CognitiveServices::Speech::PronunciationAssessmentGradingSystem GradingSystem = Microsoft::CognitiveServices::Speech::PronunciationAssessmentGradingSystem::HundredMark;
+        bool EnableMiscue = true;
+        unsigned MaxConcurrent = 8;
+    };
+
+    struct Statistics
+    {
+        uint64_t Scored = 0;
+        uint64_t NoSpeech = 0;
+        uint64_t Failed = 0;
+        uint64_t Phonemes = 0;
+    };
+
+    // Reads a manifest of tab-separated "<audio file>\t<reference text>" lines; empty lines are skipped.
+    static std::vector<Item> LoadManifest(std::istream& manifest)
+    {
+        std::vector<Item> items;
+        std::string line;
+        while (std::getline(manifest, line))
+        {
+            if (!line.empty() && line.back() == '\r')
+            {
+                line.pop_back();
+            }
+            if (line.empty())
+            {
+                continue;
+            }
+            auto tab = line.find('\t');
+            if (tab == std::string::npos)
+            {
+                throw std::runtime_error("Manifest line without a reference text: " + line);
+            }
+            items.push_back({ line.substr(0, tab), line.substr(tab + 1) });
+        }
+        return items;
+    }
+
+    PronunciationBatchScorer(std::shared_ptr<Microsoft::CognitiveServices::Speech::SpeechConfig> config, const Settings& settings)
+        : m_config(std::move(config)), m_settings(settings)
+    {
+        if (m_settings.MaxConcurrent == 0)
+        {
+            throw std::invalid_argument("Concurrency must be at least 1.");
+        }
+        // Word and phoneme scores are only in the detailed result.
+        m_config->SetOutputFormat(Microsoft::CognitiveServices::Speech::OutputFormat::Detailed);
+    }
+
+    explicit PronunciationBatchScorer(std::shared_ptr<Microsoft::CognitiveServices::Speech::SpeechConfig> config)
+        : PronunciationBatchScorer(std::move(config), Settings())
+    {
+    }
+
+    Statistics Run(const std::vector<Item>& items, PronunciationColumnWriter& details, std::ostream& summary)
+    {
+        using namespace Microsoft::CognitiveServices::Speech;
+
+        m_statistics = Statistics();
+        std::atomic<size_t> next(0);
+        auto worker = [&]()
+        {
+            auto pronunciationConfig = PronunciationAssessmentConfig::Create("",
+                m_settings.GradingSystem, PronunciationAssessmentGranularity::Phoneme, m_settings.EnableMiscue);
+
+            for (auto index = next++; index < items.size(); index = next++)
+            {
+                Outcome outcome;
+                try
+                {
+                    outcome = Score((uint32_t)index, items[index], *pronunciationConfig);
+                }
+                catch (const std::exception& e)
+                {
+                    outcome.Status = std::string("failed: ") + e.what();
+                }
+
+                details.Append(outcome.Rows);
+
+                std::lock_guard<std::mutex> lock(m_mutex);
+                summary << index << '\t' << items[index].AudioFile << '\t' << outcome.Status << '\t' << outcome.Accuracy << '\t'
+                    << outcome.Fluency << '\t' << outcome.Completeness << '\t' << outcome.Pronunciation << '\n';
+                if (outcome.Words == 0 && outcome.Status == "scored")
+                {
+                    m_statistics.NoSpeech++;
+                }
+                else if (outcome.Status == "scored")
+                {
+                    m_statistics.Scored++;
+                }
+                else
+                {
+                    m_statistics.Failed++;
+                }
+                m_statistics.Phonemes += outcome.Rows.size();
+            }
+        };
+
+        std::vector<std::thread> workers;
+        auto count = std::min<size_t>(m_settings.MaxConcurrent, items.size());
+        for (size_t i = 0; i < count; i++)
+        {
+            workers.emplace_back(worker);
+        }
+        for (auto& t : workers)
+        {
+            t.join();
+        }
+        details.Flush();
+        summary.flush();
+        return m_statistics;
+    }
+
+private:
+    struct Outcome
+    {
+        std::string Status = "scored";
+        // Item scores, the mean of the recognized sentences weighted by their number of words.
+        double Accuracy = 0;
+        double Fluency = 0;
+        double Completeness = 0;
+        double Pronunciation = 0;
+        size_t Words = 0;
+        std::vector<PronunciationColumnWriter::Row> Rows;
+    };
+
+    Outcome Score(uint32_t index, const Item& item, Microsoft::CognitiveServices::Speech::PronunciationAssessmentConfig& pronunciationConfig)
+    {
+        using namespace Microsoft::CognitiveServices::Speech;
+        using namespace Microsoft::CognitiveServices::Speech::Audio;
+
+        Outcome outcome;
+        RecognitionSessionRunner runner;
+        auto pullStream = AudioInputStream::CreatePullStream(CreateReadAheadWavFileCallback(item.AudioFile));
+        auto recognizer = SpeechRecognizer::FromConfig(m_config, AudioConfig::FromStreamInput(pullStream));
+        pronunciationConfig.SetReferenceText(item.ReferenceText);
+        pronunciationConfig.ApplyTo(recognizer);
+
+        // The handlers run one after the other on the runner's strand.
+        runner.OnFinal(recognizer->Recognized, [&outcome, index](std::shared_ptr<SpeechRecognitionResult> result)
+        {
+            if (result->Reason == ResultReason::RecognizedSpeech)
+            {
+                AddSentence(index, result->Properties.GetProperty(PropertyId::SpeechServiceResponse_JsonResult), outcome);
+            }
+        });
+        runner.OnCanceled(recognizer->Canceled, [&outcome](const RecognitionSessionRunner::CancellationInfo& cancellation)
+        {
+            if (cancellation.Reason == CancellationReason::Error)
+            {
+                outcome.Status = "failed: " + cancellation.ErrorDetails;
+            }
+        });
+        runner.OnSessionStopped(recognizer->SessionStopped);
+        runner.RunContinuous(*recognizer);
+
+        if (outcome.Words > 0)
+        {
+            outcome.Accuracy /= outcome.Words;
+            outcome.Fluency /= outcome.Words;
+            outcome.Completeness /= outcome.Words;
+            outcome.Pronunciation /= outcome.Words;
+        }
+        return outcome;
+    }
+
+    // Adds the scores of one recognized sentence, from the best hypothesis of the detailed JSON result.
+    static void AddSentence(uint32_t index, const std::string& json, Outcome& outcome)
+    {
+        auto response = nlohmann::json::parse(json, nullptr, false);
+        if (!response.is_object() || !response["NBest"].is_array() || response["NBest"].empty())
+        {
+            return;
+        }
+        const auto& best = response["NBest"][0];
+        const auto& words = best.value("Words", nlohmann::json::array());
+        const auto& scores = best.value("PronunciationAssessment", nlohmann::json::object());
+
+        auto weight = (double)words.size();
+        outcome.Accuracy += scores.value("AccuracyScore", 0.0) * weight;
+        outcome.Fluency += scores.value("FluencyScore", 0.0) * weight;
+        outcome.Completeness += scores.value("CompletenessScore", 0.0) * weight;
+        outcome.Pronunciation += scores.value("PronScore", 0.0) * weight;
+
+        for (const auto& word : words)
+        {
+            auto wordIndex = (uint32_t)outcome.Words++;
+            auto wordText = word.value("Word", "");
+            const auto& wordScores = word.value("PronunciationAssessment", nlohmann::json::object());
+            auto wordAccuracy = wordScores.value("AccuracyScore", std::numeric_limits<float>::quiet_NaN());
+            auto errorType = wordScores.value("ErrorType", "None");
+
+            const auto& phonemes = word.value("Phonemes", nlohmann::json::array());
+            if (phonemes.empty())
+            {
+                outcome.Rows.push_back({ index, wordIndex, wordText, wordAccuracy, errorType, "", std::numeric_limits<float>::quiet_NaN() });
+            }
+            for (const auto& phoneme : phonemes)
+            {
+                const auto& phonemeScores = phoneme.value("PronunciationAssessment", nlohmann::json::object());
+                outcome.Rows.push_back({ index, wordIndex, wordText, wordAccuracy, errorType, phoneme.value("Phoneme", ""),
+                    phonemeScores.value("AccuracyScore", std::numeric_limits<float>::quiet_NaN()) });
+            }
+        }
+    }
+
+    std::shared_ptr<Microsoft::CognitiveServices::Speech::SpeechConfig> m_config;
+    const Settings m_settings;
+
+    std::mutex m_mutex;
+    Statistics m_statistics;
+};
@@ -0,0 +1,127 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#pragma once
+
+#include <speechapi_cxx.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <memory>
+#include <utility>
+
+// Pull stream callback over any audio source, so every source shares one implementation of the SDK interface.
+// 'Source' is any class with 'int Read(uint8_t*, uint32_t)' returning 0 at the end, and 'void Close()', e.g.
+// WavFileReader, MappedWavFileReader or MemorySource below. The source is a member and its type is known here, so
+// its Read() is called directly and can be inlined; the only virtual call left is the one from the SDK.
+// The statistics are updated with every read and can be taken from any thread while the stream runs.
+template <class Source>
+class PullCallback final : public Microsoft::CognitiveServices::Speech::Audio::PullAudioInputStreamCallback
+{
+public:
+    struct Statistics
+    {
+        uint64_t Reads = 0;
+        uint64_t Bytes = 0;
+        // Reads that returned data, but less than asked for.
+        uint64_t ShortReads = 0;
+        // Time spent in the source, which is where a slow disk or network shows up.
+        std::chrono::microseconds ReadTime{ 0 };
+        std::chrono::microseconds MaxReadTime{ 0 };
+    };
+
+    // Constructs the source from 'args'.
+    template <class... Args>
+    explicit PullCallback(Args&&... args)
+        : m_source(std::forward<Args>(args)...)
+    {
+    }
+
+    PullCallback(const PullCallback&) = delete;
+    PullCallback& operator=(const PullCallback&) = delete;
+
+    int Read(uint8_t* dataBuffer, uint32_t size) override
+    {
+        auto started = std::chrono::steady_clock::now();
+        auto count = m_source.Read(dataBuffer, size);
+        auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - started).count();
+
+        // Only the audio thread of the SDK writes the counters, the atomics are for readers on other threads.
+        m_reads.store(m_reads.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        if (count > 0)
+        {
+            m_bytes.store(m_bytes.load(std::memory_order_relaxed) + count, std::memory_order_relaxed);
+            if ((uint32_t)count < size)
+            {
+                m_shortReads.store(m_shortReads.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+            }
+        }
+        m_readNanoseconds.store(m_readNanoseconds.load(std::memory_order_relaxed) + elapsed, std::memory_order_relaxed);
+        if (elapsed > m_maxReadNanoseconds.load(std::memory_order_relaxed))
+        {
+            m_maxReadNanoseconds.store(elapsed, std::memory_order_relaxed);
+        }
+        return count;
+    }
+
+    void Close() override
+    {
+        m_source.Close();
+    }
+
+    // The source, e.g. to seek before the stream starts. It must not be used while the SDK reads from it.
+    Source& GetSource()
+    {
+        return m_source;
+    }
+
+    Statistics GetStatistics() const
+    {
+        Statistics statistics;
+        statistics.Reads = m_reads.load(std::memory_order_relaxed);
+        statistics.Bytes = m_bytes.load(std::memory_order_relaxed);
+        statistics.ShortReads = m_shortReads.load(std::memory_order_relaxed);
+        statistics.ReadTime = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::nanoseconds(m_readNanoseconds.load(std::memory_order_relaxed)));
+        statistics.MaxReadTime = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::nanoseconds(m_maxReadNanoseconds.load(std::memory_order_relaxed)));
+        return statistics;
+    }
+
+private:
+    Source m_source;
+    std::atomic<uint64_t> m_reads{ 0 };
+    std::atomic<uint64_t> m_bytes{ 0 };
+    std::atomic<uint64_t> m_shortReads{ 0 };
+    std::atomic<int64_t> m_readNanoseconds{ 0 };
+    std::atomic<int64_t> m_maxReadNanoseconds{ 0 };
+};
+
+// A source over a range of bytes in memory, e.g. a mapped file or a buffer shared by several streams.
+// 'owner' is whatever keeps the memory valid, and is held until the source is destroyed.
+class MemorySource final
+{
+public:
+    MemorySource(std::shared_ptr<const void> owner, const uint8_t* begin, const uint8_t* end)
+        : m_owner(std::move(owner)), m_position(begin), m_end(end)
+    {
+    }
+
+    int Read(uint8_t* dataBuffer, uint32_t size)
+    {
+        auto count = (uint32_t)std::min<size_t>(size, m_end - m_position);
+        memcpy(dataBuffer, m_position, count);
+        m_position += count;
+        return (int)count;
+    }
+
+    void Close()
+    {
+        m_position = m_end;
+    }
+
+private:
+    const std::shared_ptr<const void> m_owner;
+    const uint8_t* m_position;
+    const uint8_t* const m_end;
+};
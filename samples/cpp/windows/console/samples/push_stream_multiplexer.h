@@ -0,0 +1,317 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#pragma once
+
+#include <speechapi_cxx.h>
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+#include "audio_chunk_pool.h"
+#include "wav_file_reader.h"
+
+// Audio source that never blocks, e.g. a socket in non-blocking mode or a file read at the pace of a live source.
+class NonBlockingAudioSource
+{
+public:
+    static constexpr int endOfStream = -1;
+
+    virtual ~NonBlockingAudioSource() = default;
+
+    // Format of the audio, used to size the buffer of the stream.
+    virtual WavFileReader::WAVEFORMAT GetFormat() const = 0;
+
+    // Copies up to 'size' bytes of the audio available now into 'dataBuffer' and returns their number,
+    // 0 when no audio is available yet, or endOfStream once the source has ended. Must not wait for audio.
+    virtual int TryRead(uint8_t* dataBuffer, uint32_t size) = 0;
+};
+
+// Reads a WAV file no faster than it plays, standing in for a live source.
+class PacedWavFileSource final : public NonBlockingAudioSource
+{
+public:
+    // Throws like WavFileReader if the file cannot be opened.
+    explicit PacedWavFileSource(const std::string& audioFileName)
+        : m_reader(audioFileName)
+    {
+    }
+
+    WavFileReader::WAVEFORMAT GetFormat() const override
+    {
+        return m_reader.GetFormat();
+    }
+
+    int TryRead(uint8_t* dataBuffer, uint32_t size) override
+    {
+        const auto& format = m_reader.GetFormat();
+        auto now = std::chrono::steady_clock::now();
+        if (!m_started)
+        {
+            m_start = now;
+            m_started = true;
+        }
+
+        // Audio up to now is available, in whole frames.
+        auto elapsed = std::chrono::duration<double>(now - m_start).count();
+        auto due = (uint64_t)(elapsed * format.AvgBytesPerSec);
+        uint32_t blockAlign = format.BlockAlign != 0 ? format.BlockAlign : 1;
+        auto available = due > m_delivered ? due - m_delivered : 0;
+        available = std::min<uint64_t>(available, size);
+        available -= available % blockAlign;
+        if (available == 0)
+        {
+            return 0;
+        }
+
+        auto read = m_reader.Read(dataBuffer, (uint32_t)available);
+        if (read == 0)
+        {
+            return endOfStream;
+        }
+        m_delivered += read;
+        return read;
+    }
+
+private:
+    WavFileReader m_reader;
+    std::chrono::steady_clock::time_point m_start;
+    bool m_started = false;
+    uint64_t m_delivered = 0;
+};
+
+// Feeds many push streams from non-blocking audio sources with a small, fixed pool of threads, instead of one
+// thread blocking on reads per stream. Streams take turns: a thread services the stream at the front of the
+// ready queue, writes at most one buffer of it and puts it at the back, so a busy stream never starves the others.
+// Audio is collected in a buffer per stream and written once 'WriteDurationMs' of it is there, which keeps the
+// number of Write() calls at a few per second per stream. A stream without audio is polled again after
+// 'IdlePollMs'. When its source ends (or throws), the stream gets its last audio and is closed.
+class PushStreamMultiplexer final
+{
+public:
+    struct Settings
+    {
+        uint32_t Threads = 2;
+        uint32_t WriteDurationMs = AudioChunkPool::defaultChunkDurationMs;
+        uint32_t IdlePollMs = 10;
+    };
+
+    struct Statistics
+    {
+        uint64_t Writes = 0;
+        uint64_t Bytes = 0;
+        // Reads that found no audio.
+        uint64_t EmptyPolls = 0;
+        uint32_t FinishedStreams = 0;
+        uint32_t FailedStreams = 0;
+    };
+
+    PushStreamMultiplexer()
+        : PushStreamMultiplexer(Settings())
+    {
+    }
+
+    explicit PushStreamMultiplexer(const Settings& settings)
+        : m_settings(settings)
+    {
+        for (uint32_t i = 0; i < std::max<uint32_t>(1, settings.Threads); i++)
+        {
+            m_threads.emplace_back(&PushStreamMultiplexer::Run, this);
+        }
+    }
+
+    PushStreamMultiplexer(const PushStreamMultiplexer&) = delete;
+    PushStreamMultiplexer& operator=(const PushStreamMultiplexer&) = delete;
+
+    // Stops the threads and closes the push streams whose sources have not ended yet.
+    ~PushStreamMultiplexer()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stopped = true;
+        }
+        m_changed.notify_all();
+        for (auto& thread : m_threads)
+        {
+            thread.join();
+        }
+
+        for (auto& stream : m_ready)
+        {
+            stream->PushStream->Close();
+        }
+        while (!m_idle.empty())
+        {
+            m_idle.top().Target->PushStream->Close();
+            m_idle.pop();
+        }
+    }
+
+    // Starts feeding 'pushStream' from 'source'. The stream is serviced by one thread at a time, so the
+    // source does not need to be thread-safe.
+    void Add(std::shared_ptr<NonBlockingAudioSource> source, std::shared_ptr<Microsoft::CognitiveServices::Speech::Audio::PushAudioInputStream> pushStream)
+    {
+        auto stream = std::make_shared<Stream>();
+        stream->Buffer.resize(AudioChunkPool::ChunkSizeFor(source->GetFormat(), m_settings.WriteDurationMs));
+        stream->Source = std::move(source);
+        stream->PushStream = std::move(pushStream);
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_activeStreams++;
+            m_ready.push_back(std::move(stream));
+        }
+        m_changed.notify_one();
+    }
+
+    // Waits until the sources of all streams added so far have ended.
+    void WaitUntilDone()
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_done.wait(lock, [this] { return m_activeStreams == 0; });
+    }
+
+    Statistics GetStatistics()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_statistics;
+    }
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    struct Stream
+    {
+        std::shared_ptr<NonBlockingAudioSource> Source;
+        std::shared_ptr<Microsoft::CognitiveServices::Speech::Audio::PushAudioInputStream> PushStream;
+        std::vector<uint8_t> Buffer;
+        uint32_t Filled = 0;
+    };
+
+    struct IdleStream
+    {
+        Clock::time_point NextPoll;
+        std::shared_ptr<Stream> Target;
+
+        bool operator>(const IdleStream& other) const
+        {
+            return NextPoll > other.NextPoll;
+        }
+    };
+
+    enum class Outcome { Progress, NoAudio, Ended, Failed };
+
+    void Run()
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        while (!m_stopped)
+        {
+            // Streams whose poll time has come join the back of the ready queue.
+            auto now = Clock::now();
+            while (!m_idle.empty() && m_idle.top().NextPoll <= now)
+            {
+                m_ready.push_back(m_idle.top().Target);
+                m_idle.pop();
+            }
+            if (m_ready.empty())
+            {
+                if (m_idle.empty())
+                {
+                    m_changed.wait(lock);
+                }
+                else
+                {
+                    m_changed.wait_until(lock, m_idle.top().NextPoll);
+                }
+                continue;
+            }
+
+            auto stream = std::move(m_ready.front());
+            m_ready.pop_front();
+            lock.unlock();
+
+            Statistics statistics;
+            auto outcome = Service(*stream, statistics);
+
+            lock.lock();
+            m_statistics.Writes += statistics.Writes;
+            m_statistics.Bytes += statistics.Bytes;
+            m_statistics.EmptyPolls += statistics.EmptyPolls;
+            switch (outcome)
+            {
+            case Outcome::Progress:
+                m_ready.push_back(std::move(stream));
+                break;
+            case Outcome::NoAudio:
+                m_idle.push({ Clock::now() + std::chrono::milliseconds(m_settings.IdlePollMs), std::move(stream) });
+                break;
+            case Outcome::Ended:
+            case Outcome::Failed:
+                (outcome == Outcome::Ended ? m_statistics.FinishedStreams : m_statistics.FailedStreams)++;
+                if (--m_activeStreams == 0)
+                {
+                    m_done.notify_all();
+                }
+                break;
+            }
+        }
+    }
+
+    // Reads what the source has now into the buffer of the stream, writes the buffer once it is full.
+    static Outcome Service(Stream& stream, Statistics& statistics)
+    {
+        auto outcome = Outcome::Progress;
+        try
+        {
+            auto read = stream.Source->TryRead(stream.Buffer.data() + stream.Filled, (uint32_t)stream.Buffer.size() - stream.Filled);
+            if (read == NonBlockingAudioSource::endOfStream)
+            {
+                outcome = Outcome::Ended;
+            }
+            else if (read == 0)
+            {
+                statistics.EmptyPolls++;
+                outcome = Outcome::NoAudio;
+            }
+            else
+            {
+                stream.Filled += read;
+            }
+        }
+        catch (const std::exception&)
+        {
+            outcome = Outcome::Failed;
+        }
+
+        if (stream.Filled == stream.Buffer.size() || ((outcome == Outcome::Ended || outcome == Outcome::Failed) && stream.Filled > 0))
+        {
+            stream.PushStream->Write(stream.Buffer.data(), stream.Filled);
+            statistics.Writes++;
+            statistics.Bytes += stream.Filled;
+            stream.Filled = 0;
+        }
+        if (outcome == Outcome::Ended || outcome == Outcome::Failed)
+        {
+            stream.PushStream->Close();
+        }
+        return outcome;
+    }
+
+    const Settings m_settings;
+
+    std::mutex m_mutex;
+    std::condition_variable m_changed;
+    std::condition_variable m_done;
+    std::deque<std::shared_ptr<Stream>> m_ready;
+    std::priority_queue<IdleStream, std::vector<IdleStream>, std::greater<IdleStream>> m_idle;
+    uint32_t m_activeStreams = 0;
+    bool m_stopped = false;
+    Statistics m_statistics;
+    std::vector<std::thread> m_threads;
+};
@@ -0,0 +1,198 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#pragma once
+
+#include <speechapi_cxx.h>
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include "audio_chunk_pool.h"
+#include "wav_file_reader.h"
+
+// Pull stream callback that reads its source ahead on a background I/O thread, into a ring of buffers.
+// Read() is called on the audio thread of the SDK and is served from memory, so a slow disk or network
+// share only delays the I/O thread. Read() waits only when the ring has run empty, which is counted as
+// an underrun. 'Source' is any class with 'int Read(uint8_t*, uint32_t)' returning 0 at the end, and 'void Close()',
+// e.g. WavFileReader.
+template <class Source>
+class ReadAheadAudioCallback final : public Microsoft::CognitiveServices::Speech::Audio::PullAudioInputStreamCallback
+{
+public:
+    struct Statistics
+    {
+        uint64_t Reads = 0;
+        uint64_t Bytes = 0;
+        // Reads that found the ring empty and had to wait for the I/O thread. The wait for the very first
+        // buffer is not an underrun, the stream had not started yet.
+        uint64_t Underruns = 0;
+        std::chrono::microseconds UnderrunWait{ 0 };
+        std::chrono::microseconds MaxUnderrunWait{ 0 };
+    };
+
+    // Reads 'source' in blocks of 'bufferSize' bytes, keeping up to 'bufferCount' blocks ahead of Read().
+    ReadAheadAudioCallback(std::unique_ptr<Source> source, uint32_t bufferSize, size_t bufferCount = 4)
+        : m_source(std::move(source))
+    {
+        if (!m_source || bufferSize == 0 || bufferCount < 2)
+        {
+            throw std::invalid_argument("Read-ahead needs a source and at least two buffers.");
+        }
+        m_buffers.resize(bufferCount);
+        for (auto& buffer : m_buffers)
+        {
+            buffer.Data.resize(bufferSize);
+        }
+        m_thread = std::thread([this]() { Fill(); });
+    }
+
+    ReadAheadAudioCallback(const ReadAheadAudioCallback&) = delete;
+    ReadAheadAudioCallback& operator=(const ReadAheadAudioCallback&) = delete;
+
+    ~ReadAheadAudioCallback()
+    {
+        Stop();
+    }
+
+    // Copies up to 'size' bytes from the buffers read ahead. Waits only when none is ready yet.
+    // Returns 0 at the end of the source or after Close().
+    int Read(uint8_t* dataBuffer, uint32_t size) override
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_statistics.Reads++;
+        if (m_filled == 0 && !m_endOfSource && !m_closed)
+        {
+            auto waitStarted = std::chrono::steady_clock::now();
+            m_bufferFilled.wait(lock, [this]() { return m_filled > 0 || m_endOfSource || m_closed; });
+            if (m_started)
+            {
+                auto wait = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - waitStarted);
+                m_statistics.Underruns++;
+                m_statistics.UnderrunWait += wait;
+                m_statistics.MaxUnderrunWait = std::max(m_statistics.MaxUnderrunWait, wait);
+            }
+        }
+        m_started = true;
+
+        uint32_t copied = 0;
+        while (m_filled > 0 && copied < size && !m_closed)
+        {
+            // The I/O thread does not touch filled buffers, so they are copied without the lock.
+            auto& buffer = m_buffers[m_readIndex];
+            auto count = std::min(size - copied, buffer.Size - m_readOffset);
+            lock.unlock();
+            memcpy(dataBuffer + copied, buffer.Data.data() + m_readOffset, count);
+            lock.lock();
+
+            copied += count;
+            m_readOffset += count;
+            if (m_readOffset == buffer.Size)
+            {
+                m_readOffset = 0;
+                m_readIndex = (m_readIndex + 1) % m_buffers.size();
+                m_filled--;
+                m_bufferFreed.notify_one();
+            }
+        }
+        m_statistics.Bytes += copied;
+        return (int)copied;
+    }
+
+    // Stops reading ahead and closes the source.
+    void Close() override
+    {
+        Stop();
+    }
+
+    Statistics GetStatistics()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_statistics;
+    }
+
+private:
+    struct Buffer
+    {
+        std::vector<uint8_t> Data;
+        uint32_t Size = 0;
+    };
+
+    void Fill()
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        while (true)
+        {
+            m_bufferFreed.wait(lock, [this]() { return m_filled < m_buffers.size() || m_closed; });
+            if (m_closed)
+            {
+                return;
+            }
+
+            // Read() does not touch free buffers, so the source is read without the lock.
+            auto& buffer = m_buffers[m_writeIndex];
+            lock.unlock();
+            auto count = m_source->Read(buffer.Data.data(), (uint32_t)buffer.Data.size());
+            lock.lock();
+
+            if (count <= 0)
+            {
+                m_endOfSource = true;
+                m_bufferFilled.notify_one();
+                return;
+            }
+            buffer.Size = (uint32_t)count;
+            m_writeIndex = (m_writeIndex + 1) % m_buffers.size();
+            m_filled++;
+            m_bufferFilled.notify_one();
+        }
+    }
+
+    void Stop()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (m_closed)
+            {
+                return;
+            }
+            m_closed = true;
+        }
+        m_bufferFreed.notify_one();
+        m_bufferFilled.notify_all();
+        m_thread.join();
+        m_source->Close();
+    }
+
+    std::unique_ptr<Source> m_source;
+    std::vector<Buffer> m_buffers;
+
+    std::mutex m_mutex;
+    std::condition_variable m_bufferFilled;
+    std::condition_variable m_bufferFreed;
+    size_t m_readIndex = 0;
+    uint32_t m_readOffset = 0;
+    size_t m_writeIndex = 0;
+    size_t m_filled = 0;
+    bool m_endOfSource = false;
+    bool m_closed = false;
+    bool m_started = false;
+    Statistics m_statistics;
+    std::thread m_thread;
+};
+
+// Creates a read-ahead callback for a wav file, with buffers of 100 ms of audio.
+// Throws std::invalid_argument or std::runtime_error when the file cannot be opened.
+inline std::shared_ptr<ReadAheadAudioCallback<WavFileReader>> CreateReadAheadWavFileCallback(const std::string& audioFileName, size_t bufferCount = 4)
+{
+    auto reader = std::unique_ptr<WavFileReader>(new WavFileReader(audioFileName));
+    auto bufferSize = AudioChunkPool::ChunkSizeFor(reader->GetFormat());
+    return std::make_shared<ReadAheadAudioCallback<WavFileReader>>(std::move(reader), bufferSize, bufferCount);
+}
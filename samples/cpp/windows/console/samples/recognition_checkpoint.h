@@ -0,0 +1,83 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#pragma once
+
+#include <cstdio>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include "file_replace.h"
+
+// Remembers in a file how far into the audio a continuous recognition has produced final results, so
+// a session that is restarted after an error continues there instead of recognizing the audio again.
+// The position is the end (Offset() + Duration()) of the last final result, in ticks of 100 nanoseconds
+// from the start of the audio.
+class RecognitionCheckpoint final
+{
+public:
+    explicit RecognitionCheckpoint(const std::string& fileName)
+        : m_fileName(fileName)
+    {
+    }
+
+    // Returns the saved position, or 0 when there is no checkpoint.
+    uint64_t Load()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        std::ifstream file(m_fileName);
+        std::string header;
+        uint64_t position = 0;
+        if (!(file >> header >> position) || header != fileHeader)
+        {
+            return 0;
+        }
+        m_saved = position;
+        return position;
+    }
+
+    // Saves 'position' if it is past the saved one.
+    void Save(uint64_t position)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (position <= m_saved)
+        {
+            return;
+        }
+
+        // Writes to a temporary file first and moves it over the checkpoint, so a crash while saving leaves
+        // either the old or the new checkpoint.
+        auto temporaryName = m_fileName + ".tmp";
+        {
+            std::ofstream file(temporaryName, std::ios::trunc);
+            file << fileHeader << ' ' << position << '\n';
+            file.close();
+            if (file.fail())
+            {
+                return;
+            }
+        }
+        if (!MoveFileOver(temporaryName, m_fileName))
+        {
+            std::remove(temporaryName.c_str());
+            return;
+        }
+        m_saved = position;
+    }
+
+    // Removes the checkpoint, after the whole audio has been recognized.
+    void Clear()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        std::remove(m_fileName.c_str());
+        m_saved = 0;
+    }
+
+private:
+    static constexpr const char* fileHeader = "checkpoint-v1";
+
+    const std::string m_fileName;
+    std::mutex m_mutex;
+    uint64_t m_saved = 0;
+};
@@ -0,0 +1,206 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#pragma once
+
+#include <speechapi_cxx.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <map>
+#include <mutex>
+#include <ostream>
+#include <stdexcept>
+#include <vector>
+
+// Measures end-to-end latency of continuous recognition from the recognizer events.
+// Results are correlated by Offset(), which is the same for all Recognizing and Recognized events of one utterance.
+// The following latencies are recorded:
+//  - FirstPartial: from pushing the audio covered by the first partial result of an utterance until that result arrives.
+//  - PartialToFinal: from the last partial result of an utterance until its final result arrives.
+//  - FinalToStopped: from the last final result until SessionStopped.
+// To relate results to pushed audio, call OnAudioPushed() after every write. Without that, the time of
+// OnAudioStart() is used as the push time of all audio, which matches file input read faster than real time.
+class RecognitionLatencyTracker final
+{
+public:
+    using Clock = std::chrono::steady_clock;
+    using Milliseconds = std::chrono::duration<double, std::milli>;
+
+    // 'avgBytesPerSec' converts pushed bytes into audio time and is only needed with OnAudioPushed().
+    explicit RecognitionLatencyTracker(uint32_t avgBytesPerSec = 0)
+        : m_avgBytesPerSec(avgBytesPerSec)
+    {
+    }
+
+    // Subscribes to the Recognizing, Recognized and SessionStopped events of the recognizer.
+    // The tracker must outlive the recognizer.
+    template <class RecognizerType>
+    void Attach(const std::shared_ptr<RecognizerType>& recognizer)
+    {
+        recognizer->Recognizing.Connect([this](const auto& e) { OnPartial(e.Result->Offset(), e.Result->Duration()); });
+        recognizer->Recognized.Connect([this](const auto& e) { OnFinal(e.Result->Offset()); });
+        recognizer->SessionStopped.Connect([this](const Microsoft::CognitiveServices::Speech::SessionEventArgs&) { OnSessionStopped(); });
+    }
+
+    // Marks the time the first audio was made available to the recognizer.
+    void OnAudioStart()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!m_started)
+        {
+            m_start = Clock::now();
+            m_started = true;
+        }
+    }
+
+    // Records that 'size' more bytes of audio have been pushed into the stream.
+    void OnAudioPushed(uint32_t size)
+    {
+        if (m_avgBytesPerSec == 0)
+        {
+            throw std::logic_error("OnAudioPushed() requires the bytes per second of the audio format.");
+        }
+
+        auto now = Clock::now();
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!m_started)
+        {
+            m_start = now;
+            m_started = true;
+        }
+        m_pushedBytes += size;
+        m_pushed.push_back({ m_pushedBytes * ticksPerSecond / m_avgBytesPerSec, now });
+    }
+
+    void OnPartial(uint64_t offset, uint64_t duration)
+    {
+        auto now = Clock::now();
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto& utterance = m_utterances[offset];
+        if (utterance.Partials++ == 0)
+        {
+            m_firstPartial.push_back(now - PushTimeOf(offset + duration));
+        }
+        utterance.LastPartial = now;
+    }
+
+    void OnFinal(uint64_t offset)
+    {
+        auto now = Clock::now();
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto utterance = m_utterances.find(offset);
+        if (utterance != m_utterances.end())
+        {
+            if (utterance->second.Partials > 0)
+            {
+                m_partialToFinal.push_back(now - utterance->second.LastPartial);
+            }
+            m_utterances.erase(utterance);
+        }
+        m_lastFinal = now;
+        m_finals++;
+    }
+
+    void OnSessionStopped()
+    {
+        auto now = Clock::now();
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_finals > 0)
+        {
+            m_finalToStopped.push_back(now - m_lastFinal);
+        }
+    }
+
+    // Returns the 'percentile' (0-100) of the samples using the nearest-rank method, or 0 when there are none.
+    static Milliseconds Percentile(std::vector<Clock::duration> samples, double percentile)
+    {
+        if (samples.empty())
+        {
+            return Milliseconds(0);
+        }
+        std::sort(samples.begin(), samples.end());
+        auto rank = (size_t)std::ceil(percentile / 100.0 * samples.size());
+        return samples[std::min(samples.size(), std::max<size_t>(rank, 1)) - 1];
+    }
+
+    // Prints count, p50, p95 and p99 of each latency.
+    void Report(std::ostream& out) const
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        out << "Latency (ms):" << std::endl;
+        ReportLine(out, "FirstPartial", m_firstPartial);
+        ReportLine(out, "PartialToFinal", m_partialToFinal);
+        ReportLine(out, "FinalToStopped", m_finalToStopped);
+    }
+
+    std::vector<Clock::duration> FirstPartialLatencies() const
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_firstPartial;
+    }
+
+    std::vector<Clock::duration> PartialToFinalLatencies() const
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_partialToFinal;
+    }
+
+    std::vector<Clock::duration> FinalToStoppedLatencies() const
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_finalToStopped;
+    }
+
+private:
+    // Offsets and durations are reported in ticks of 100 nanoseconds.
+    static constexpr uint64_t ticksPerSecond = 10000000;
+
+    struct Utterance
+    {
+        uint32_t Partials = 0;
+        Clock::time_point LastPartial;
+    };
+
+    struct PushedAudio
+    {
+        uint64_t EndTicks;         // audio time pushed so far, including this write.
+        Clock::time_point Time;
+    };
+
+    // Returns when the audio up to 'ticks' was pushed. Must be called with the lock held.
+    Clock::time_point PushTimeOf(uint64_t ticks) const
+    {
+        auto pushed = std::lower_bound(m_pushed.begin(), m_pushed.end(), ticks,
+            [](const PushedAudio& audio, uint64_t value) { return audio.EndTicks < value; });
+        if (pushed != m_pushed.end())
+        {
+            return pushed->Time;
+        }
+        return m_pushed.empty() ? m_start : m_pushed.back().Time;
+    }
+
+    static void ReportLine(std::ostream& out, const char* name, const std::vector<Clock::duration>& samples)
+    {
+        out << "  " << name << ": count=" << samples.size()
+            << " p50=" << Percentile(samples, 50).count()
+            << " p95=" << Percentile(samples, 95).count()
+            << " p99=" << Percentile(samples, 99).count() << std::endl;
+    }
+
+    const uint32_t m_avgBytesPerSec;
+
+    mutable std::mutex m_mutex;
+    bool m_started = false;
+    Clock::time_point m_start;
+    uint64_t m_pushedBytes = 0;
+    std::vector<PushedAudio> m_pushed;
+    std::map<uint64_t, Utterance> m_utterances;
+    Clock::time_point m_lastFinal;
+    uint32_t m_finals = 0;
+
+    std::vector<Clock::duration> m_firstPartial;
+    std::vector<Clock::duration> m_partialToFinal;
+    std::vector<Clock::duration> m_finalToStopped;
+};
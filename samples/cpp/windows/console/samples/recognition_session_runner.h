@@ -0,0 +1,360 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#pragma once
+
+#include <speechapi_cxx.h>
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Small pool of worker threads that runs event handlers away from the SDK callback threads.
+// Handlers are posted to strands: the handlers of one strand run one after the other in posting order,
+// the handlers of different strands run in parallel on the workers. Each strand has a bounded queue.
+// When it is full, a droppable handler (a partial result) is dropped, while handlers that must not be
+// lost (final results, cancellation, end of session) are always queued.
+class EventDispatchExecutor final
+{
+public:
+    enum class QueuePolicy
+    {
+        // Drops the partial result being posted.
+        DropNewestPartial,
+        // Drops the oldest queued partial result, so the latest partial results get through.
+        DropOldestPartial,
+    };
+
+    class Strand final : public std::enable_shared_from_this<Strand>
+    {
+    public:
+        struct Statistics
+        {
+            uint64_t Posted = 0;
+            uint64_t Dropped = 0;
+            size_t MaxQueued = 0;
+        };
+
+        Strand(EventDispatchExecutor& executor, size_t capacity, QueuePolicy policy)
+            : m_executor(executor), m_capacity(std::max<size_t>(1, capacity)), m_policy(policy)
+        {
+        }
+
+        // Queues 'handler'. Returns false when it was dropped.
+        bool Post(bool droppable, std::function<void()> handler)
+        {
+            bool schedule = false;
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_statistics.Posted++;
+                if (m_handlers.size() >= m_capacity && !MakeRoom(droppable))
+                {
+                    m_statistics.Dropped++;
+                    return false;
+                }
+                m_handlers.push_back(Handler{ droppable, std::move(handler) });
+                m_statistics.MaxQueued = std::max(m_statistics.MaxQueued, m_handlers.size());
+                schedule = !m_scheduled;
+                m_scheduled = true;
+            }
+            if (schedule)
+            {
+                m_executor.Schedule(shared_from_this());
+            }
+            return true;
+        }
+
+        // Waits until all handlers posted so far have run.
+        void Drain()
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_drained.wait(lock, [this]() { return !m_scheduled; });
+        }
+
+        Statistics GetStatistics()
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            return m_statistics;
+        }
+
+    private:
+        friend class EventDispatchExecutor;
+
+        // A worker runs at most this many handlers of a strand in a row, so busy strands do not starve others.
+        static constexpr int handlersPerTurn = 16;
+
+        struct Handler
+        {
+            bool Droppable;
+            std::function<void()> Run;
+        };
+
+        // Frees a slot for a new handler. Must be called with the lock held.
+        bool MakeRoom(bool droppable)
+        {
+            if (!droppable)
+            {
+                // Handlers that must not be lost go beyond the capacity.
+                return true;
+            }
+            if (m_policy == QueuePolicy::DropOldestPartial)
+            {
+                auto oldest = std::find_if(m_handlers.begin(), m_handlers.end(), [](const Handler& handler) { return handler.Droppable; });
+                if (oldest != m_handlers.end())
+                {
+                    m_handlers.erase(oldest);
+                    m_statistics.Dropped++;
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        // Runs queued handlers on a worker, and schedules the strand again when there are more.
+        void RunTurn()
+        {
+            for (int i = 0; i < handlersPerTurn; i++)
+            {
+                Handler handler;
+                {
+                    std::lock_guard<std::mutex> lock(m_mutex);
+                    if (m_handlers.empty())
+                    {
+                        break;
+                    }
+                    handler = std::move(m_handlers.front());
+                    m_handlers.pop_front();
+                }
+
+                try
+                {
+                    handler.Run();
+                }
+                catch (const std::exception&)
+                {
+                    // A failing handler must not take down the worker, which serves other sessions too.
+                }
+            }
+
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                if (m_handlers.empty())
+                {
+                    m_scheduled = false;
+                    m_drained.notify_all();
+                    return;
+                }
+            }
+            m_executor.Schedule(shared_from_this());
+        }
+
+        EventDispatchExecutor& m_executor;
+        const size_t m_capacity;
+        const QueuePolicy m_policy;
+
+        std::mutex m_mutex;
+        std::condition_variable m_drained;
+        std::deque<Handler> m_handlers;
+        // True while the strand has handlers queued or running.
+        bool m_scheduled = false;
+        Statistics m_statistics;
+    };
+
+    explicit EventDispatchExecutor(size_t workers = 2)
+    {
+        for (size_t i = 0; i < std::max<size_t>(1, workers); i++)
+        {
+            m_workers.emplace_back([this]() { Work(); });
+        }
+    }
+
+    EventDispatchExecutor(const EventDispatchExecutor&) = delete;
+    EventDispatchExecutor& operator=(const EventDispatchExecutor&) = delete;
+
+    // Runs the handlers already posted, then stops the workers.
+    ~EventDispatchExecutor()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stopping = true;
+        }
+        m_ready.notify_all();
+        for (auto& worker : m_workers)
+        {
+            worker.join();
+        }
+    }
+
+    std::shared_ptr<Strand> CreateStrand(size_t capacity, QueuePolicy policy = QueuePolicy::DropOldestPartial)
+    {
+        return std::make_shared<Strand>(*this, capacity, policy);
+    }
+
+private:
+    void Schedule(std::shared_ptr<Strand> strand)
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_strands.push_back(std::move(strand));
+        }
+        m_ready.notify_one();
+    }
+
+    void Work()
+    {
+        while (true)
+        {
+            std::shared_ptr<Strand> strand;
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                m_ready.wait(lock, [this]() { return m_stopping || !m_strands.empty(); });
+                if (m_strands.empty())
+                {
+                    return;
+                }
+                strand = std::move(m_strands.front());
+                m_strands.pop_front();
+            }
+            strand->RunTurn();
+        }
+    }
+
+    std::mutex m_mutex;
+    std::condition_variable m_ready;
+    std::deque<std::shared_ptr<Strand>> m_strands;
+    bool m_stopping = false;
+    std::vector<std::thread> m_workers;
+};
+
+// Executor shared by all sessions of the process.
+inline EventDispatchExecutor& SharedEventDispatchExecutor()
+{
+    static EventDispatchExecutor executor(2);
+    return executor;
+}
+
+// Runs a continuous recognition session with its event handlers on an EventDispatchExecutor, so slow
+// handlers cannot stall the SDK callback threads, and takes care of waiting for the end of the session.
+// The SDK event arguments are only valid during the callback, so handlers receive the result (a shared
+// pointer) or, for cancellation, a copy of the cancellation details.
+// The session ends after a Canceled or SessionStopped event, once their handlers have run.
+// Declare the runner before the recognizer or transcriber it serves: locals are destroyed in reverse order, so the
+// recognizer and its callbacks are gone before the runner is.
+class RecognitionSessionRunner final
+{
+public:
+    struct CancellationInfo
+    {
+        Microsoft::CognitiveServices::Speech::CancellationReason Reason;
+        Microsoft::CognitiveServices::Speech::CancellationErrorCode ErrorCode;
+        std::string ErrorDetails;
+    };
+
+    explicit RecognitionSessionRunner(EventDispatchExecutor& executor = SharedEventDispatchExecutor(), size_t capacity = 64,
+        EventDispatchExecutor::QueuePolicy policy = EventDispatchExecutor::QueuePolicy::DropOldestPartial)
+        : m_strand(executor.CreateStrand(capacity, policy))
+    {
+    }
+
+    RecognitionSessionRunner(const RecognitionSessionRunner&) = delete;
+    RecognitionSessionRunner& operator=(const RecognitionSessionRunner&) = delete;
+
+    ~RecognitionSessionRunner()
+    {
+        m_strand->Drain();
+    }
+
+    // Handles partial results (Recognizing, Transcribing), which are dropped when the handlers fall behind.
+    template <class EventArgs, class Handler>
+    void OnPartial(Microsoft::CognitiveServices::Speech::EventSignal<const EventArgs&>& signal, Handler handler)
+    {
+        signal.Connect([this, handler](const EventArgs& e)
+        {
+            auto result = e.Result;
+            m_strand->Post(true, [handler, result]() { handler(result); });
+        });
+    }
+
+    // Handles final results (Recognized, Transcribed), which are never dropped.
+    template <class EventArgs, class Handler>
+    void OnFinal(Microsoft::CognitiveServices::Speech::EventSignal<const EventArgs&>& signal, Handler handler)
+    {
+        signal.Connect([this, handler](const EventArgs& e)
+        {
+            auto result = e.Result;
+            m_strand->Post(false, [handler, result]() { handler(result); });
+        });
+    }
+
+    // Handles cancellation, which ends the session.
+    template <class EventArgs>
+    void OnCanceled(Microsoft::CognitiveServices::Speech::EventSignal<const EventArgs&>& signal, std::function<void(const CancellationInfo&)> handler)
+    {
+        signal.Connect([this, handler](const EventArgs& e)
+        {
+            CancellationInfo cancellation{ e.Reason, e.ErrorCode, e.ErrorDetails };
+            m_strand->Post(false, [this, handler, cancellation]()
+            {
+                handler(cancellation);
+                End();
+            });
+        });
+    }
+
+    // Handles the end of the session.
+    void OnSessionStopped(Microsoft::CognitiveServices::Speech::EventSignal<const Microsoft::CognitiveServices::Speech::SessionEventArgs&>& signal,
+        std::function<void()> handler = nullptr)
+    {
+        signal.Connect([this, handler](const Microsoft::CognitiveServices::Speech::SessionEventArgs&)
+        {
+            m_strand->Post(false, [this, handler]()
+            {
+                if (handler)
+                {
+                    handler();
+                }
+                End();
+            });
+        });
+    }
+
+    // Waits for the end of the session.
+    void Wait()
+    {
+        m_endFuture.wait();
+    }
+
+    // Starts continuous recognition, waits for the end of the session and stops the recognition.
+    template <class Recognizer>
+    void RunContinuous(Recognizer& recognizer)
+    {
+        recognizer.StartContinuousRecognitionAsync().get();
+        Wait();
+        recognizer.StopContinuousRecognitionAsync().get();
+    }
+
+    EventDispatchExecutor::Strand::Statistics GetStatistics()
+    {
+        return m_strand->GetStatistics();
+    }
+
+private:
+    // Canceled is usually followed by SessionStopped, the session ends with the first of them.
+    void End()
+    {
+        std::call_once(m_endOnce, [this]() { m_end.set_value(); });
+    }
+
+    std::shared_ptr<EventDispatchExecutor::Strand> m_strand;
+    std::promise<void> m_end;
+    std::shared_future<void> m_endFuture{ m_end.get_future() };
+    std::once_flag m_endOnce;
+};
@@ -0,0 +1,351 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#pragma once
+
+#include <speechapi_cxx.h>
+#include <chrono>
+#include <condition_variable>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Picks the region (or custom endpoint) new sessions connect to, out of several deployments of the service.
+// A background thread probes every target each 'ProbeInterval' by opening a connection without sending audio, and
+// keeps a moving average of the time to connect and of the share of failed attempts. Select() returns the config of
+// the fastest healthy target, so a session starts against the nearest region without a config change.
+// A target is unhealthy while its error rate is above 'MaxErrorRate', and for 'Cooldown' after a session or probe
+// failed to reach it; sessions that get such an error should call ReportFailure() and start again with Select(),
+// which then fails over to the next target. When no target is healthy, the one that failed least recently is tried.
+class RegionSelector final
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    struct Target
+    {
+        // Name used in reports, e.g. "westeurope".
+        std::string Name;
+        std::string SubscriptionKey;
+        // The region of the key, or an empty string when 'Endpoint' is given.
+        std::string Region;
+        // A custom endpoint URL, e.g. of a container, used instead of the region when not empty.
+        std::string Endpoint;
+    };
+
+    struct Settings
+    {
+        std::chrono::seconds ProbeInterval{ 60 };
+        std::chrono::milliseconds ProbeTimeout{ 5000 };
+        // Weight of the newest sample in the moving averages.
+        double Smoothing = 0.3;
+        double MaxErrorRate = 0.5;
+        std::chrono::seconds Cooldown{ 30 };
+    };
+
+    struct Choice
+    {
+        std::string Name;
+        std::shared_ptr<Microsoft::CognitiveServices::Speech::SpeechConfig> Config;
+    };
+
+    struct TargetStatus
+    {
+        std::string Name;
+        // Moving average of the time to connect, zero until the target was reached once.
+        std::chrono::milliseconds ConnectTime{ 0 };
+        double ErrorRate = 0;
+        bool Healthy = true;
+        uint64_t Selections = 0;
+        uint64_t Failures = 0;
+    };
+
+    RegionSelector(const std::vector<Target>& targets)
+        : RegionSelector(targets, Settings())
+    {
+    }
+
+    // Starts probing all targets right away. Until the first probes are done, Select() prefers the targets in the
+    // order given, so the first one should be the home region.
+    RegionSelector(const std::vector<Target>& targets, const Settings& settings)
+        : m_settings(settings)
+    {
+        if (targets.empty())
+        {
+            throw std::invalid_argument("The region selector needs at least one target.");
+        }
+        for (const auto& target : targets)
+        {
+            TargetState state;
+            state.Settings = target;
+            state.Status.Name = target.Name;
+            m_targets.push_back(state);
+        }
+        m_thread = std::thread([this]() { ProbeLoop(); });
+    }
+
+    RegionSelector(const RegionSelector&) = delete;
+    RegionSelector& operator=(const RegionSelector&) = delete;
+
+    ~RegionSelector()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stopping = true;
+        }
+        m_wakeUp.notify_one();
+        m_thread.join();
+    }
+
+    // Returns a new config for the fastest healthy target; set the language and other options on it as usual.
+    Choice Select()
+    {
+        TargetState* chosen = nullptr;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            auto now = Clock::now();
+            for (auto& candidate : m_targets)
+            {
+                if (chosen == nullptr || Ranks(candidate, *chosen, now))
+                {
+                    chosen = &candidate;
+                }
+            }
+            chosen->Status.Selections++;
+        }
+        return { chosen->Settings.Name, CreateConfig(chosen->Settings) };
+    }
+
+    // Records a session that connected to 'name', with the time it took when known.
+    void ReportSuccess(const std::string& name, std::chrono::milliseconds connectTime = std::chrono::milliseconds(0))
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (auto target = Find(name))
+        {
+            Record(*target, true, connectTime);
+        }
+    }
+
+    // Records a session of 'name' canceled with 'errorCode'. Returns true if the error is one another region may not
+    // have, i.e. the session should be started again with Select(); errors of the request itself, like a wrong key,
+    // return false and do not count against the target.
+    bool ReportFailure(const std::string& name, Microsoft::CognitiveServices::Speech::CancellationErrorCode errorCode)
+    {
+        if (!IsFailoverError(errorCode))
+        {
+            return false;
+        }
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (auto target = Find(name))
+        {
+            Record(*target, false, std::chrono::milliseconds(0));
+        }
+        return true;
+    }
+
+    static bool IsFailoverError(Microsoft::CognitiveServices::Speech::CancellationErrorCode errorCode)
+    {
+        using Microsoft::CognitiveServices::Speech::CancellationErrorCode;
+
+        switch (errorCode)
+        {
+        case CancellationErrorCode::ConnectionFailure:
+        case CancellationErrorCode::ServiceTimeout:
+        case CancellationErrorCode::ServiceUnavailable:
+        case CancellationErrorCode::ServiceError:
+        case CancellationErrorCode::TooManyRequests:
+            return true;
+        default:
+            return false;
+        }
+    }
+
+    // Probes all targets now, in parallel, and returns when all probes are done.
+    void ProbeNow()
+    {
+        std::vector<Target> targets;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            for (const auto& target : m_targets)
+            {
+                targets.push_back(target.Settings);
+            }
+        }
+
+        std::vector<std::future<std::chrono::milliseconds>> probes;
+        for (const auto& target : targets)
+        {
+            probes.push_back(std::async(std::launch::async, [this, target]() { return Probe(target); }));
+        }
+        for (size_t i = 0; i < probes.size(); i++)
+        {
+            // A negative time means the target could not be reached.
+            auto connectTime = probes[i].get();
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (auto target = Find(targets[i].Name))
+            {
+                Record(*target, connectTime.count() >= 0, connectTime);
+            }
+        }
+    }
+
+    std::vector<TargetStatus> GetStatus()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto now = Clock::now();
+        std::vector<TargetStatus> status;
+        for (auto& target : m_targets)
+        {
+            target.Status.Healthy = IsHealthy(target, now);
+            status.push_back(target.Status);
+        }
+        return status;
+    }
+
+private:
+    struct TargetState
+    {
+        Target Settings;
+        TargetStatus Status;
+        bool Reached = false;
+        Clock::time_point LastFailure;
+        bool Failed = false;
+    };
+
+    static std::shared_ptr<Microsoft::CognitiveServices::Speech::SpeechConfig> CreateConfig(const Target& target)
+    {
+        using Microsoft::CognitiveServices::Speech::SpeechConfig;
+
+        if (!target.Endpoint.empty())
+        {
+            return SpeechConfig::FromEndpoint(target.Endpoint, target.SubscriptionKey);
+        }
+        return SpeechConfig::FromSubscription(target.SubscriptionKey, target.Region);
+    }
+
+    // Opens a connection to 'target' and returns the time it took, or -1 ms if it failed or timed out.
+    std::chrono::milliseconds Probe(const Target& target)
+    {
+        using namespace Microsoft::CognitiveServices::Speech;
+        using namespace Microsoft::CognitiveServices::Speech::Audio;
+
+        try
+        {
+            // No audio is pushed, so the probe costs a handshake and no recognition.
+            auto recognizer = SpeechRecognizer::FromConfig(CreateConfig(target), AudioConfig::FromStreamInput(AudioInputStream::CreatePushStream()));
+            auto connection = Connection::FromRecognizer(recognizer);
+
+            auto outcome = std::make_shared<std::promise<bool>>();
+            auto settled = std::make_shared<std::once_flag>();
+            connection->Connected.Connect([outcome, settled](const ConnectionEventArgs&)
+            {
+                std::call_once(*settled, [&outcome]() { outcome->set_value(true); });
+            });
+            recognizer->Canceled.Connect([outcome, settled](const SpeechRecognitionCanceledEventArgs&)
+            {
+                std::call_once(*settled, [&outcome]() { outcome->set_value(false); });
+            });
+
+            auto reached = outcome->get_future();
+            auto started = Clock::now();
+            connection->Open(false);
+            auto connected = reached.wait_for(m_settings.ProbeTimeout) == std::future_status::ready && reached.get();
+            auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - started);
+            connection->Close();
+            return connected ? elapsed : std::chrono::milliseconds(-1);
+        }
+        catch (const std::exception&)
+        {
+            return std::chrono::milliseconds(-1);
+        }
+    }
+
+    void ProbeLoop()
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        while (!m_stopping)
+        {
+            lock.unlock();
+            ProbeNow();
+            lock.lock();
+            m_wakeUp.wait_for(lock, m_settings.ProbeInterval, [this]() { return m_stopping; });
+        }
+    }
+
+    // Must be called with the lock held.
+    void Record(TargetState& target, bool succeeded, std::chrono::milliseconds connectTime)
+    {
+        auto smoothing = m_settings.Smoothing;
+        target.Status.ErrorRate = (1 - smoothing) * target.Status.ErrorRate + (succeeded ? 0.0 : smoothing);
+        if (!succeeded)
+        {
+            target.Status.Failures++;
+            target.Failed = true;
+            target.LastFailure = Clock::now();
+            return;
+        }
+        if (connectTime.count() > 0)
+        {
+            target.Status.ConnectTime = !target.Reached
+                ? connectTime
+                : std::chrono::milliseconds((int64_t)((1 - smoothing) * target.Status.ConnectTime.count() + smoothing * connectTime.count()));
+            target.Reached = true;
+        }
+    }
+
+    bool IsHealthy(const TargetState& target, Clock::time_point now) const
+    {
+        if (target.Status.ErrorRate > m_settings.MaxErrorRate)
+        {
+            return false;
+        }
+        return !target.Failed || now - target.LastFailure >= m_settings.Cooldown;
+    }
+
+    // Whether 'candidate' is a better choice than 'best': healthy first, then reached ones by connect time, then the
+    // order given. Among unhealthy targets the one that failed least recently comes first.
+    bool Ranks(const TargetState& candidate, const TargetState& best, Clock::time_point now) const
+    {
+        auto candidateHealthy = IsHealthy(candidate, now);
+        auto bestHealthy = IsHealthy(best, now);
+        if (candidateHealthy != bestHealthy)
+        {
+            return candidateHealthy;
+        }
+        if (!candidateHealthy)
+        {
+            return candidate.LastFailure < best.LastFailure;
+        }
+        if (candidate.Reached != best.Reached)
+        {
+            return candidate.Reached;
+        }
+        return candidate.Reached && candidate.Status.ConnectTime < best.Status.ConnectTime;
+    }
+
+    // Must be called with the lock held.
+    TargetState* Find(const std::string& name)
+    {
+        for (auto& target : m_targets)
+        {
+            if (target.Settings.Name == name)
+            {
+                return &target;
+            }
+        }
+        return nullptr;
+    }
+
+    const Settings m_settings;
+
+    std::mutex m_mutex;
+    std::condition_variable m_wakeUp;
+    std::vector<TargetState> m_targets;
+    bool m_stopping = false;
+    std::thread m_thread;
+};
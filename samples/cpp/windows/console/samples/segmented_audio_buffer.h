@@ -0,0 +1,127 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#pragma once
+
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <ostream>
+#include <stdexcept>
+#include <vector>
+
+// Append-only audio buffer made of fixed-size blocks. Appending never reallocates or moves data that is
+// already stored, so the cost per appended byte stays constant even for hours of audio. The contents are
+// read back as a list of segments (scatter-gather), or copied out in one piece when needed.
+class SegmentedAudioBuffer final
+{
+public:
+    // Default block size. 64 KB is about two seconds of 16 kHz 16-bit mono audio.
+    static constexpr size_t defaultBlockSize = 64 * 1024;
+
+    // A contiguous part of the buffer contents.
+    struct Segment
+    {
+        const uint8_t* Data;
+        size_t Size;
+    };
+
+    // 'capacityHint' bytes are allocated up front, so appending up to that much does not allocate at all.
+    explicit SegmentedAudioBuffer(size_t capacityHint = 0, size_t blockSize = defaultBlockSize)
+        : m_blockSize(blockSize)
+    {
+        if (blockSize == 0)
+        {
+            throw std::invalid_argument("Block size must be larger than zero.");
+        }
+        Reserve(capacityHint);
+    }
+
+    SegmentedAudioBuffer(const SegmentedAudioBuffer&) = delete;
+    SegmentedAudioBuffer& operator=(const SegmentedAudioBuffer&) = delete;
+
+    // Makes sure that 'capacity' bytes in total can be stored without allocating.
+    void Reserve(size_t capacity)
+    {
+        size_t blocks = (capacity + m_blockSize - 1) / m_blockSize;
+        m_blocks.reserve(blocks);
+        while (m_blocks.size() < blocks)
+        {
+            m_blocks.emplace_back(new uint8_t[m_blockSize]);
+        }
+    }
+
+    void Append(const uint8_t* data, size_t size)
+    {
+        while (size > 0)
+        {
+            size_t block = m_size / m_blockSize;
+            size_t offset = m_size % m_blockSize;
+            if (block == m_blocks.size())
+            {
+                m_blocks.emplace_back(new uint8_t[m_blockSize]);
+            }
+
+            size_t count = std::min(size, m_blockSize - offset);
+            memcpy(m_blocks[block].get() + offset, data, count);
+            m_size += count;
+            data += count;
+            size -= count;
+        }
+    }
+
+    size_t Size() const
+    {
+        return m_size;
+    }
+
+    // Bytes that can be stored without allocating.
+    size_t Capacity() const
+    {
+        return m_blocks.size() * m_blockSize;
+    }
+
+    // Returns the contents in order. The segments stay valid until the buffer is cleared or destroyed.
+    std::vector<Segment> Segments() const
+    {
+        std::vector<Segment> segments;
+        segments.reserve((m_size + m_blockSize - 1) / m_blockSize);
+        for (size_t offset = 0; offset < m_size; offset += m_blockSize)
+        {
+            segments.push_back({ m_blocks[offset / m_blockSize].get(), std::min(m_blockSize, m_size - offset) });
+        }
+        return segments;
+    }
+
+    // Copies the contents into one contiguous vector.
+    std::vector<uint8_t> ToVector() const
+    {
+        std::vector<uint8_t> data;
+        data.reserve(m_size);
+        for (const auto& segment : Segments())
+        {
+            data.insert(data.end(), segment.Data, segment.Data + segment.Size);
+        }
+        return data;
+    }
+
+    void WriteTo(std::ostream& out) const
+    {
+        for (const auto& segment : Segments())
+        {
+            out.write(reinterpret_cast<const char*>(segment.Data), segment.Size);
+        }
+    }
+
+    // Empties the buffer, keeping the allocated blocks for reuse.
+    void Clear()
+    {
+        m_size = 0;
+    }
+
+private:
+    const size_t m_blockSize;
+    std::vector<std::unique_ptr<uint8_t[]>> m_blocks;
+    size_t m_size = 0;
+};
@@ -0,0 +1,384 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#pragma once
+
+#include <speechapi_cxx.h>
+#include <nlohmann/json.hpp>
+#include <algorithm>
+#include <chrono>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// Collects the events of recognizers and synthesizers, and optionally the SDK trace lines, into a timeline of
+// spans per session, written in the Chrome trace event format. The file can be opened in chrome://tracing or
+// https://ui.perfetto.dev to see where a slow session spent its time. Each session gets its own track with:
+//  - "session": SessionStarted to SessionStopped (a whole synthesis for synthesizers).
+//  - "connect": SessionStarted to Connected.
+//  - "first hypothesis": SessionStarted to the first Recognizing event ("first audio chunk" for synthesizers).
+//  - "utterance": first Recognizing to Recognized of each utterance, with the text and offset of the result.
+//  - "turn end": the last Recognized to SessionStopped.
+// Cancellations are instant events with the reason and error. SDK trace lines passed to OnTrace() are instant
+// events on a track of their own, so they line up with the sessions.
+class SessionTimelineRecorder final
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    // Trace lines recorded at most, so a long run with verbose logging does not fill the memory.
+    explicit SessionTimelineRecorder(size_t maxTraceLines = 100000)
+        : m_maxTraceLines(maxTraceLines), m_start(Clock::now())
+    {
+    }
+
+    SessionTimelineRecorder(const SessionTimelineRecorder&) = delete;
+    SessionTimelineRecorder& operator=(const SessionTimelineRecorder&) = delete;
+
+    // Subscribes to the session, recognition and connection events of the recognizer.
+    // The recorder must outlive the recognizer.
+    template <class RecognizerType>
+    void Attach(const std::shared_ptr<RecognizerType>& recognizer)
+    {
+        using namespace Microsoft::CognitiveServices::Speech;
+
+        // Connection events carry no session id, they belong to the session the recognizer is running.
+        auto current = std::make_shared<std::string>();
+        recognizer->SessionStarted.Connect([this, current](const SessionEventArgs& e)
+        {
+            auto now = Clock::now();
+            std::lock_guard<std::mutex> lock(m_mutex);
+            *current = e.SessionId;
+            OpenSession(e.SessionId, now);
+        });
+        recognizer->SessionStopped.Connect([this](const SessionEventArgs& e)
+        {
+            auto now = Clock::now();
+            std::lock_guard<std::mutex> lock(m_mutex);
+            CloseSession(e.SessionId, now, "turn end");
+        });
+        recognizer->Recognizing.Connect([this](const auto& e)
+        {
+            auto now = Clock::now();
+            std::lock_guard<std::mutex> lock(m_mutex);
+            OnHypothesis(e.SessionId, now, "first hypothesis");
+        });
+        recognizer->Recognized.Connect([this](const auto& e)
+        {
+            auto now = Clock::now();
+            nlohmann::json args;
+            args["reason"] = (int)e.Result->Reason;
+            args["text"] = e.Result->Text;
+            args["offset_ms"] = e.Result->Offset() / 10000;
+            args["duration_ms"] = e.Result->Duration() / 10000;
+            std::lock_guard<std::mutex> lock(m_mutex);
+            OnFinal(e.SessionId, now, std::move(args));
+        });
+        recognizer->Canceled.Connect([this](const auto& e)
+        {
+            auto now = Clock::now();
+            nlohmann::json args;
+            args["reason"] = (int)e.Reason;
+            args["error_code"] = (int)e.ErrorCode;
+            args["error_details"] = e.ErrorDetails;
+            std::lock_guard<std::mutex> lock(m_mutex);
+            Instant("canceled", SessionOf(e.SessionId, now).Track, now, std::move(args));
+        });
+
+        auto connection = Connection::FromRecognizer(recognizer);
+        connection->Connected.Connect([this, current](const ConnectionEventArgs&)
+        {
+            auto now = Clock::now();
+            std::lock_guard<std::mutex> lock(m_mutex);
+            auto session = m_sessions.find(*current);
+            if (session != m_sessions.end() && !session->second.Connected)
+            {
+                session->second.Connected = true;
+                Span("connect", session->second.Track, session->second.Start, now);
+            }
+        });
+        connection->Disconnected.Connect([this, current](const ConnectionEventArgs&)
+        {
+            auto now = Clock::now();
+            std::lock_guard<std::mutex> lock(m_mutex);
+            Instant("disconnected", TrackOf(*current), now);
+        });
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_connections.push_back(connection);
+    }
+
+    // Subscribes to the synthesis events of the synthesizer, one session per synthesis result.
+    // The recorder must outlive the synthesizer.
+    void Attach(Microsoft::CognitiveServices::Speech::SpeechSynthesizer& synthesizer)
+    {
+        using namespace Microsoft::CognitiveServices::Speech;
+
+        synthesizer.SynthesisStarted.Connect([this](const SpeechSynthesisEventArgs& e)
+        {
+            auto now = Clock::now();
+            std::lock_guard<std::mutex> lock(m_mutex);
+            OpenSession(e.Result->ResultId, now);
+        });
+        synthesizer.Synthesizing.Connect([this](const SpeechSynthesisEventArgs& e)
+        {
+            auto now = Clock::now();
+            std::lock_guard<std::mutex> lock(m_mutex);
+            auto& session = SessionOf(e.Result->ResultId, now);
+            if (!session.Hypothesis)
+            {
+                session.Hypothesis = true;
+                Span("first audio chunk", session.Track, session.Start, now);
+            }
+        });
+        synthesizer.SynthesisCompleted.Connect([this](const SpeechSynthesisEventArgs& e)
+        {
+            auto now = Clock::now();
+            std::lock_guard<std::mutex> lock(m_mutex);
+            CloseSession(e.Result->ResultId, now, nullptr);
+        });
+        synthesizer.SynthesisCanceled.Connect([this](const SpeechSynthesisEventArgs& e)
+        {
+            auto now = Clock::now();
+            auto cancellation = SpeechSynthesisCancellationDetails::FromResult(e.Result);
+            nlohmann::json args;
+            args["reason"] = (int)cancellation->Reason;
+            args["error_code"] = (int)cancellation->ErrorCode;
+            args["error_details"] = cancellation->ErrorDetails;
+            std::lock_guard<std::mutex> lock(m_mutex);
+            Instant("canceled", SessionOf(e.Result->ResultId, now).Track, now, std::move(args));
+            CloseSession(e.Result->ResultId, now, nullptr);
+        });
+    }
+
+    // Records an SDK trace line, e.g. from an EventLogger callback.
+    void OnTrace(const std::string& line)
+    {
+        auto now = Clock::now();
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_traceLines >= m_maxTraceLines)
+        {
+            return;
+        }
+        m_traceLines++;
+        nlohmann::json args;
+        args["line"] = line;
+        // The start of the line names the event in the viewer, the whole line is in its arguments.
+        // Cut before a UTF-8 continuation byte would split a character.
+        size_t length = std::min<size_t>(line.size(), 80);
+        while (length < line.size() && length > 0 && (static_cast<unsigned char>(line[length]) & 0xC0) == 0x80)
+        {
+            length--;
+        }
+        auto name = line.substr(0, length);
+        while (!name.empty() && (name.back() == '\n' || name.back() == '\r'))
+        {
+            name.pop_back();
+        }
+        Instant(name, sdkTrack, now, std::move(args));
+    }
+
+    // Records an application event, e.g. "first audio pushed", on the track of the session (or the SDK track).
+    void Mark(const std::string& name, const std::string& sessionId = std::string())
+    {
+        auto now = Clock::now();
+        std::lock_guard<std::mutex> lock(m_mutex);
+        Instant(name, TrackOf(sessionId), now);
+    }
+
+    // Writes the timeline as a Chrome trace JSON object. Sessions still running end at the time of writing.
+    void Write(std::ostream& out)
+    {
+        auto now = Clock::now();
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        auto events = nlohmann::json::array();
+        events.push_back(TrackName(sdkTrack, "SDK traces"));
+        for (const auto& session : m_sessions)
+        {
+            events.push_back(TrackName(session.second.Track, "session " + session.first));
+            if (session.second.Open)
+            {
+                events.push_back(ToJson(Event{ "session (running)", 'X', session.second.Start, now, session.second.Track, nullptr }));
+            }
+        }
+        for (const auto& event : m_events)
+        {
+            events.push_back(ToJson(event));
+        }
+
+        nlohmann::json trace;
+        trace["traceEvents"] = std::move(events);
+        trace["displayTimeUnit"] = "ms";
+        // Trace lines are not guaranteed to be valid UTF-8; invalid bytes are replaced instead of throwing.
+        out << trace.dump(-1, ' ', false, nlohmann::json::error_handler_t::replace) << std::endl;
+    }
+
+private:
+    // Track of the SDK trace lines, the sessions are numbered from 1.
+    static constexpr uint32_t sdkTrack = 0;
+
+    struct Session
+    {
+        uint32_t Track = 0;
+        Clock::time_point Start;
+        bool Open = false;
+        bool Connected = false;
+        bool Hypothesis = false;
+        // First Recognizing event of the utterance in progress, if there is one.
+        bool InUtterance = false;
+        Clock::time_point UtteranceStart;
+        bool HasFinal = false;
+        Clock::time_point LastFinal;
+    };
+
+    struct Event
+    {
+        std::string Name;
+        // 'X' for spans, 'i' for instants.
+        char Phase;
+        Clock::time_point Begin;
+        Clock::time_point End;
+        uint32_t Track;
+        nlohmann::json Args;
+    };
+
+    // Returns the session, creating it if its start was not seen (e.g. attached late). Must be called with the lock held.
+    Session& SessionOf(const std::string& id, Clock::time_point now)
+    {
+        auto& session = m_sessions[id];
+        if (session.Track == 0)
+        {
+            session.Track = m_nextTrack++;
+            session.Start = now;
+            session.Open = true;
+        }
+        return session;
+    }
+
+    // Returns the track of a session, or the SDK track for unknown sessions. Must be called with the lock held.
+    uint32_t TrackOf(const std::string& id) const
+    {
+        auto session = m_sessions.find(id);
+        if (session == m_sessions.end())
+        {
+            return sdkTrack;
+        }
+        return session->second.Track;
+    }
+
+    void OpenSession(const std::string& id, Clock::time_point now)
+    {
+        SessionOf(id, now);
+    }
+
+    void CloseSession(const std::string& id, Clock::time_point now, const char* tailName)
+    {
+        auto& session = SessionOf(id, now);
+        if (!session.Open)
+        {
+            return;
+        }
+        session.Open = false;
+        if (tailName != nullptr && session.HasFinal)
+        {
+            Span(tailName, session.Track, session.LastFinal, now);
+        }
+        Span("session", session.Track, session.Start, now);
+    }
+
+    void OnHypothesis(const std::string& id, Clock::time_point now, const char* firstName)
+    {
+        auto& session = SessionOf(id, now);
+        if (!session.Hypothesis)
+        {
+            session.Hypothesis = true;
+            Span(firstName, session.Track, session.Start, now);
+        }
+        if (!session.InUtterance)
+        {
+            session.InUtterance = true;
+            session.UtteranceStart = now;
+        }
+    }
+
+    void OnFinal(const std::string& id, Clock::time_point now, nlohmann::json args)
+    {
+        auto& session = SessionOf(id, now);
+        if (session.InUtterance)
+        {
+            m_events.push_back(Event{ "utterance", 'X', session.UtteranceStart, now, session.Track, std::move(args) });
+            session.InUtterance = false;
+        }
+        else
+        {
+            // A final result without partial results, e.g. NoMatch.
+            Instant("final", session.Track, now, std::move(args));
+        }
+        session.HasFinal = true;
+        session.LastFinal = now;
+    }
+
+    void Span(const std::string& name, uint32_t track, Clock::time_point begin, Clock::time_point end)
+    {
+        m_events.push_back(Event{ name, 'X', begin, end, track, nullptr });
+    }
+
+    void Instant(const std::string& name, uint32_t track, Clock::time_point time, nlohmann::json args = nullptr)
+    {
+        m_events.push_back(Event{ name, 'i', time, time, track, std::move(args) });
+    }
+
+    int64_t Microseconds(Clock::time_point time) const
+    {
+        return std::chrono::duration_cast<std::chrono::microseconds>(time - m_start).count();
+    }
+
+    nlohmann::json ToJson(const Event& event) const
+    {
+        nlohmann::json json;
+        json["name"] = event.Name;
+        json["ph"] = std::string(1, event.Phase);
+        json["ts"] = Microseconds(event.Begin);
+        if (event.Phase == 'X')
+        {
+            json["dur"] = Microseconds(event.End) - Microseconds(event.Begin);
+        }
+        else
+        {
+            // Instants are drawn on their track only.
+            json["s"] = "t";
+        }
+        json["pid"] = 1;
+        json["tid"] = event.Track;
+        if (!event.Args.is_null())
+        {
+            json["args"] = event.Args;
+        }
+        return json;
+    }
+
+    static nlohmann::json TrackName(uint32_t track, const std::string& name)
+    {
+        nlohmann::json json;
+        json["name"] = "thread_name";
+        json["ph"] = "M";
+        json["pid"] = 1;
+        json["tid"] = track;
+        json["args"]["name"] = name;
+        return json;
+    }
+
+    const size_t m_maxTraceLines;
+    const Clock::time_point m_start;
+
+    std::mutex m_mutex;
+    std::map<std::string, Session> m_sessions;
+    std::vector<Event> m_events;
+    std::vector<std::shared_ptr<Microsoft::CognitiveServices::Speech::Connection>> m_connections;
+    uint32_t m_nextTrack = 1;
+    size_t m_traceLines = 0;
+};
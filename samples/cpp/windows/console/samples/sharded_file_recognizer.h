@@ -0,0 +1,237 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#pragma once
+
+#include <speechapi_cxx.h>
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include "pull_callback.h"
+#include "recognition_session_runner.h"
+#include "wav_file_reader.h"
+
+// Finds cut points in 16-bit PCM audio where the signal is quiet, so shards of a long recording can be
+// recognized on their own without splitting a word.
+class SilenceFinder final
+{
+public:
+    // Energy is measured over windows of this length.
+    static constexpr uint32_t windowMs = 20;
+    // A cut is placed in the middle of the quietest stretch of this many consecutive windows.
+    static constexpr uint32_t quietWindows = 15;
+
+    // Returns the frames at which to cut 'frames' frames of 'samples' into at most 'shardCount' shards.
+    // Every ideal cut point (an equal split) is moved to the quietest stretch within 'searchRadiusMs' of it.
+    // The result starts with 0 and ends with 'frames'; shards shorter than 'minShardMs' are not cut.
+    static std::vector<size_t> FindCuts(const int16_t* samples, size_t frames, uint16_t channels, uint32_t samplesPerSec,
+        size_t shardCount, uint32_t searchRadiusMs = 30000, uint32_t minShardMs = 10000)
+    {
+        std::vector<size_t> cuts{ 0 };
+        size_t windowFrames = std::max<size_t>(1, (size_t)samplesPerSec * windowMs / 1000);
+        size_t minShardFrames = (size_t)samplesPerSec * minShardMs / 1000;
+        if (shardCount > 1 && frames > minShardFrames)
+        {
+            shardCount = std::min(shardCount, std::max<size_t>(1, frames / std::max<size_t>(1, minShardFrames)));
+            auto energies = WindowEnergies(samples, frames, channels, windowFrames);
+            size_t searchRadius = (size_t)samplesPerSec * searchRadiusMs / 1000 / windowFrames;
+
+            for (size_t shard = 1; shard < shardCount; shard++)
+            {
+                size_t ideal = frames / shardCount * shard / windowFrames;
+                size_t first = ideal > searchRadius ? ideal - searchRadius : 0;
+                size_t last = std::min(energies.size(), ideal + searchRadius + 1);
+                auto cut = QuietestStretch(energies, first, last) * windowFrames;
+
+                // Keeps the shards apart by at least the minimum length.
+                if (cut >= cuts.back() + minShardFrames && cut + minShardFrames <= frames)
+                {
+                    cuts.push_back(cut);
+                }
+            }
+        }
+        cuts.push_back(frames);
+        return cuts;
+    }
+
+private:
+    // Returns the sum of squares of every window, over all channels.
+    static std::vector<uint64_t> WindowEnergies(const int16_t* samples, size_t frames, uint16_t channels, size_t windowFrames)
+    {
+        std::vector<uint64_t> energies((frames + windowFrames - 1) / windowFrames);
+        for (size_t window = 0; window < energies.size(); window++)
+        {
+            auto begin = samples + window * windowFrames * channels;
+            auto end = samples + std::min(frames, (window + 1) * windowFrames) * channels;
+            uint64_t energy = 0;
+            for (auto sample = begin; sample != end; ++sample)
+            {
+                energy += (uint64_t)((int32_t)*sample * *sample);
+            }
+            energies[window] = energy;
+        }
+        return energies;
+    }
+
+    // Returns the window in the middle of the quietest stretch of windows in [first, last).
+    static size_t QuietestStretch(const std::vector<uint64_t>& energies, size_t first, size_t last)
+    {
+        auto length = std::min<size_t>(quietWindows, last - first);
+        if (length == 0)
+        {
+            return first;
+        }
+
+        uint64_t sum = 0;
+        for (size_t window = first; window < first + length; window++)
+        {
+            sum += energies[window];
+        }
+        auto best = sum;
+        auto bestStart = first;
+        for (size_t start = first + 1; start + length <= last; start++)
+        {
+            sum += energies[start + length - 1] - energies[start - 1];
+            if (sum < best)
+            {
+                best = sum;
+                bestStart = start;
+            }
+        }
+        return bestStart + length / 2;
+    }
+};
+
+// Recognizes a long WAV file faster than real time by cutting it at silences into shards that are
+// recognized concurrently, each over its own pull stream. The final results of all shards are merged
+// into one transcript, with their offsets rebased from the start of the shard onto the start of the file.
+class ShardedFileRecognizer final
+{
+public:
+    struct Segment
+    {
+        std::string Text;
+        // In ticks of 100 nanoseconds from the start of the file.
+        uint64_t Offset;
+        uint64_t Duration;
+        size_t Shard;
+    };
+
+    struct Transcript
+    {
+        // Ordered by offset.
+        std::vector<Segment> Segments;
+        size_t ShardCount = 0;
+        // Error details of the shards that were canceled, empty when all shards completed.
+        std::vector<std::string> Errors;
+    };
+
+    // Recognizes 'audioFileName' in at most 'shardCount' concurrent sessions.
+    // Throws std::invalid_argument when the file is not 16-bit PCM.
+    static Transcript Recognize(const std::shared_ptr<Microsoft::CognitiveServices::Speech::SpeechConfig>& config, const std::string& audioFileName,
+        size_t shardCount)
+    {
+        using namespace Microsoft::CognitiveServices::Speech;
+
+        // The mapping is shared by all shards, each stream only reads its own range of it.
+        auto reader = std::make_shared<MappedWavFileReader>(audioFileName);
+        const auto& format = reader->GetFormat();
+        if (format.BitsPerSample != 16 || format.Channels == 0 || format.BlockAlign != format.Channels * 2)
+        {
+            throw std::invalid_argument("Only 16-bit PCM audio can be sharded.");
+        }
+
+        auto frames = (size_t)reader->Size() / format.BlockAlign;
+        auto cuts = SilenceFinder::FindCuts(reinterpret_cast<const int16_t*>(reader->Data()), frames, format.Channels, format.SamplesPerSec, shardCount);
+
+        Transcript transcript;
+        transcript.ShardCount = cuts.size() - 1;
+        std::mutex transcriptMutex;
+
+        std::vector<std::thread> workers;
+        for (size_t shard = 0; shard + 1 < cuts.size(); shard++)
+        {
+            const uint8_t* begin = reader->Data() + cuts[shard] * format.BlockAlign;
+            const uint8_t* end = reader->Data() + cuts[shard + 1] * format.BlockAlign;
+            uint64_t shardOffset = (uint64_t)cuts[shard] * ticksPerSecond / format.SamplesPerSec;
+
+            workers.emplace_back([&, shard, begin, end, shardOffset]()
+            {
+                std::vector<Segment> segments;
+                std::string error;
+                try
+                {
+                    error = RecognizeShard(config, reader, begin, end, [&](const SpeechRecognitionResult& result)
+                    {
+                        segments.push_back(Segment{ result.Text, shardOffset + result.Offset(), result.Duration(), shard });
+                    });
+                }
+                catch (const std::exception& e)
+                {
+                    error = e.what();
+                }
+
+                std::lock_guard<std::mutex> lock(transcriptMutex);
+                transcript.Segments.insert(transcript.Segments.end(), segments.begin(), segments.end());
+                if (!error.empty())
+                {
+                    transcript.Errors.push_back("Shard " + std::to_string(shard) + ": " + error);
+                }
+            });
+        }
+        for (auto& worker : workers)
+        {
+            worker.join();
+        }
+
+        std::sort(transcript.Segments.begin(), transcript.Segments.end(), [](const Segment& a, const Segment& b) { return a.Offset < b.Offset; });
+        return transcript;
+    }
+
+private:
+    static constexpr uint64_t ticksPerSecond = 10000000;
+
+    // Runs one shard through continuous recognition. Returns the error details when it was canceled.
+    template <class OnRecognized>
+    static std::string RecognizeShard(const std::shared_ptr<Microsoft::CognitiveServices::Speech::SpeechConfig>& config,
+        const std::shared_ptr<MappedWavFileReader>& reader, const uint8_t* begin, const uint8_t* end, OnRecognized onRecognized)
+    {
+        using namespace Microsoft::CognitiveServices::Speech;
+        using namespace Microsoft::CognitiveServices::Speech::Audio;
+
+        const auto& format = reader->GetFormat();
+        auto stream = AudioInputStream::CreatePullStream(
+            AudioStreamFormat::GetWaveFormatPCM(format.SamplesPerSec, format.BitsPerSample, (uint8_t)format.Channels),
+            std::make_shared<PullCallback<MemorySource>>(reader, begin, end));
+
+        std::string error;
+        RecognitionSessionRunner session;
+        auto recognizer = SpeechRecognizer::FromConfig(config, AudioConfig::FromStreamInput(stream));
+
+        // Handlers of one session run one after the other, so the results need no lock.
+        session.OnFinal(recognizer->Recognized, [&onRecognized](const std::shared_ptr<SpeechRecognitionResult>& result)
+        {
+            if (result->Reason == ResultReason::RecognizedSpeech && !result->Text.empty())
+            {
+                onRecognized(*result);
+            }
+        });
+        session.OnCanceled(recognizer->Canceled, [&error](const RecognitionSessionRunner::CancellationInfo& e)
+        {
+            if (e.Reason == CancellationReason::Error)
+            {
+                error = e.ErrorDetails;
+            }
+        });
+        session.OnSessionStopped(recognizer->SessionStopped);
+
+        session.RunContinuous(*recognizer);
+        return error;
+    }
+};
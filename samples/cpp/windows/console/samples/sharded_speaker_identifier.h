@@ -0,0 +1,179 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#pragma once
+
+#include <speechapi_cxx.h>
+#include <algorithm>
+#include <atomic>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include <nlohmann/json.hpp>
+#include "shared_audio_buffer.h"
+
+// Speaker identification against more voice profiles than one SpeakerIdentificationModel can hold.
+// The profiles are split into shards of at most 'ProfilesPerShard', with one model per shard built up front.
+// Identify() streams the same SharedAudioBuffer to one recognizer per shard, up to 'MaxConcurrent' at once,
+// and merges the candidates of all shards by score into a global top-k. Besides the best profile of
+// each shard (ProfileId and GetScore() of the result), the ranking in the raw service response is used when present.
+class ShardedSpeakerIdentifier final
+{
+public:
+    struct Settings
+    {
+        // The service limit of profiles per identification model.
+        size_t ProfilesPerShard = 50;
+        unsigned MaxConcurrent = 8;
+    };
+
+    struct Candidate
+    {
+        std::string ProfileId;
+        float Score;
+    };
+
+    struct Result
+    {
+        // Best candidates first, at most 'topK'.
+        std::vector<Candidate> Candidates;
+        // Shards that were canceled, with the error details of each; their profiles were not scored.
+        std::vector<std::string> Errors;
+    };
+
+    ShardedSpeakerIdentifier(std::shared_ptr<Microsoft::CognitiveServices::Speech::SpeechConfig> config,
+        const std::vector<std::shared_ptr<Microsoft::CognitiveServices::Speech::Speaker::VoiceProfile>>& profiles, const Settings& settings)
+        : m_config(std::move(config)), m_settings(settings)
+    {
+        using namespace Microsoft::CognitiveServices::Speech::Speaker;
+        if (m_settings.ProfilesPerShard == 0 || m_settings.MaxConcurrent == 0)
+        {
+            throw std::invalid_argument("Shard size and concurrency must be at least 1.");
+        }
+
+        for (size_t first = 0; first < profiles.size(); first += m_settings.ProfilesPerShard)
+        {
+            auto last = std::min(profiles.size(), first + m_settings.ProfilesPerShard);
+            std::vector<std::shared_ptr<VoiceProfile>> shard(profiles.begin() + first, profiles.begin() + last);
+            m_models.push_back(SpeakerIdentificationModel::FromProfiles(shard));
+        }
+    }
+
+    ShardedSpeakerIdentifier(std::shared_ptr<Microsoft::CognitiveServices::Speech::SpeechConfig> config,
+        const std::vector<std::shared_ptr<Microsoft::CognitiveServices::Speech::Speaker::VoiceProfile>>& profiles)
+        : ShardedSpeakerIdentifier(std::move(config), profiles, Settings())
+    {
+    }
+
+    size_t GetShardCount() const
+    {
+        return m_models.size();
+    }
+
+    // Scores the audio against all shards and returns the 'topK' best profiles.
+    Result Identify(const std::shared_ptr<const SharedAudioBuffer>& audio, size_t topK)
+    {
+        using namespace Microsoft::CognitiveServices::Speech;
+        using namespace Microsoft::CognitiveServices::Speech::Audio;
+        using namespace Microsoft::CognitiveServices::Speech::Speaker;
+
+        std::mutex mutex;
+        // The best score of every profile; a profile appears in one shard only, but may be reported twice by it.
+        std::map<std::string, float> scores;
+        Result merged;
+
+        std::atomic<size_t> next(0);
+        auto worker = [&]()
+        {
+            for (auto index = next++; index < m_models.size(); index = next++)
+            {
+                std::vector<Candidate> candidates;
+                std::string error;
+                try
+                {
+                    auto recognizer = SpeakerRecognizer::FromConfig(m_config, AudioConfig::FromStreamInput(audio->CreatePullStream()));
+                    auto result = recognizer->RecognizeOnceAsync(m_models[index]).get();
+                    if (result->Reason == ResultReason::RecognizedSpeakers)
+                    {
+                        candidates.push_back({ result->ProfileId, result->GetScore() });
+                        AddRanking(result->Properties.GetProperty(PropertyId::SpeechServiceResponse_JsonResult), candidates);
+                    }
+                    else if (result->Reason == ResultReason::Canceled)
+                    {
+                        error = SpeakerRecognitionCancellationDetails::FromResult(result)->ErrorDetails;
+                    }
+                }
+                catch (const std::exception& e)
+                {
+                    error = e.what();
+                }
+
+                std::lock_guard<std::mutex> lock(mutex);
+                if (!error.empty())
+                {
+                    merged.Errors.push_back("shard " + std::to_string(index) + ": " + error);
+                }
+                for (const auto& candidate : candidates)
+                {
+                    auto inserted = scores.emplace(candidate.ProfileId, candidate.Score);
+                    inserted.first->second = std::max(inserted.first->second, candidate.Score);
+                }
+            }
+        };
+
+        std::vector<std::thread> workers;
+        auto count = std::min<size_t>(m_settings.MaxConcurrent, m_models.size());
+        for (size_t i = 0; i < count; i++)
+        {
+            workers.emplace_back(worker);
+        }
+        for (auto& t : workers)
+        {
+            t.join();
+        }
+
+        for (const auto& score : scores)
+        {
+            merged.Candidates.push_back({ score.first, score.second });
+        }
+        auto kept = std::min(topK, merged.Candidates.size());
+        std::partial_sort(merged.Candidates.begin(), merged.Candidates.begin() + kept, merged.Candidates.end(),
+            [](const Candidate& a, const Candidate& b) { return a.Score > b.Score; });
+        merged.Candidates.resize(kept);
+        return merged;
+    }
+
+private:
+    // Adds the runners-up from the "profilesRanking" array of a raw identification response, if there is one.
+    static void AddRanking(const std::string& json, std::vector<Candidate>& candidates)
+    {
+        auto response = nlohmann::json::parse(json, nullptr, false);
+        if (!response.is_object())
+        {
+            return;
+        }
+        auto ranking = response.find("profilesRanking");
+        if (ranking == response.end() || !ranking->is_array())
+        {
+            return;
+        }
+        for (const auto& entry : *ranking)
+        {
+            auto id = entry.find("profileId");
+            auto score = entry.find("score");
+            if (id != entry.end() && id->is_string() && score != entry.end() && score->is_number())
+            {
+                candidates.push_back({ id->get<std::string>(), score->get<float>() });
+            }
+        }
+    }
+
+    std::shared_ptr<Microsoft::CognitiveServices::Speech::SpeechConfig> m_config;
+    const Settings m_settings;
+    std::vector<std::shared_ptr<Microsoft::CognitiveServices::Speech::Speaker::SpeakerIdentificationModel>> m_models;
+};
@@ -0,0 +1,89 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#pragma once
+
+#include <speechapi_cxx.h>
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+#include "pull_callback.h"
+#include "wav_file_reader.h"
+
+// PCM audio that is read (or decoded) once and then streamed to any number of recognizers at the same time.
+// Every pull stream returned by CreatePullStream() reads the same immutable bytes with a position of its own,
+// so giving one utterance to N recognizers costs N small callbacks instead of N reads of the file.
+// The buffer stays alive as long as one of its streams does.
+class SharedAudioBuffer final : public std::enable_shared_from_this<SharedAudioBuffer>
+{
+public:
+    // Maps the wav file; its audio is not copied at all.
+    // Throws std::invalid_argument or std::runtime_error when the file cannot be opened.
+    static std::shared_ptr<const SharedAudioBuffer> FromWavFile(const std::string& audioFileName)
+    {
+        std::shared_ptr<SharedAudioBuffer> buffer(new SharedAudioBuffer());
+        buffer->m_mapped.reset(new MappedWavFileReader(audioFileName));
+        buffer->m_format = buffer->m_mapped->GetFormat();
+        buffer->m_data = buffer->m_mapped->Data();
+        buffer->m_size = buffer->m_mapped->Size();
+        return buffer;
+    }
+
+    // Takes over PCM audio that has been decoded elsewhere.
+    static std::shared_ptr<const SharedAudioBuffer> FromPcm(std::vector<uint8_t>&& pcm, const WavFileReader::WAVEFORMAT& format)
+    {
+        std::shared_ptr<SharedAudioBuffer> buffer(new SharedAudioBuffer());
+        buffer->m_owned = std::move(pcm);
+        buffer->m_format = format;
+        buffer->m_data = buffer->m_owned.data();
+        buffer->m_size = buffer->m_owned.size();
+        return buffer;
+    }
+
+    SharedAudioBuffer(const SharedAudioBuffer&) = delete;
+    SharedAudioBuffer& operator=(const SharedAudioBuffer&) = delete;
+
+    const uint8_t* Data() const
+    {
+        return m_data;
+    }
+
+    size_t Size() const
+    {
+        return m_size;
+    }
+
+    const WavFileReader::WAVEFORMAT& GetFormat() const
+    {
+        return m_format;
+    }
+
+    // Returns a new pull stream over the whole buffer, in the format of the audio.
+    std::shared_ptr<Microsoft::CognitiveServices::Speech::Audio::PullAudioInputStream> CreatePullStream() const
+    {
+        return CreatePullStream(0, m_size);
+    }
+
+    // Returns a new pull stream over 'size' bytes from 'offset', limited to the end of the buffer.
+    // The offset should be a multiple of BlockAlign, so the stream starts on a whole frame.
+    std::shared_ptr<Microsoft::CognitiveServices::Speech::Audio::PullAudioInputStream> CreatePullStream(size_t offset, size_t size) const
+    {
+        using namespace Microsoft::CognitiveServices::Speech::Audio;
+        offset = std::min(offset, m_size);
+        size = std::min(size, m_size - offset);
+        auto format = AudioStreamFormat::GetWaveFormatPCM(m_format.SamplesPerSec, (uint8_t)m_format.BitsPerSample, (uint8_t)m_format.Channels);
+        return AudioInputStream::CreatePullStream(format, std::make_shared<PullCallback<MemorySource>>(shared_from_this(), m_data + offset, m_data + offset + size));
+    }
+
+private:
+    SharedAudioBuffer() = default;
+
+    std::unique_ptr<MappedWavFileReader> m_mapped;
+    std::vector<uint8_t> m_owned;
+    WavFileReader::WAVEFORMAT m_format{};
+    const uint8_t* m_data = nullptr;
+    size_t m_size = 0;
+};
@@ -0,0 +1,311 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+#include "wav_file_reader.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define FRAME_FEATURES_SSE2
+#endif
+
+// Energy and zero crossings of a frame of 16-bit mono PCM, the features of a simple voice activity detector.
+struct FrameFeatures
+{
+    // Sum of the squares of the samples.
+    uint64_t Energy = 0;
+    // Number of sign changes between neighbouring samples.
+    uint32_t ZeroCrossings = 0;
+
+    static FrameFeatures Compute(const int16_t* samples, size_t count)
+    {
+        FrameFeatures features;
+        size_t i = 0;
+#if defined(FRAME_FEATURES_SSE2)
+        // 8 samples per step. _mm_madd_epi16 adds up pairs of squares into 32-bit lanes, which are widened
+        // to 64 bits after every step, so long frames of loud audio do not overflow. The sign masks of a
+        // sample and its successor differ in exactly the lanes with a zero crossing.
+        auto zero = _mm_setzero_si128();
+        auto energy = _mm_setzero_si128();
+        auto crossings = _mm_setzero_si128();
+        for (; i + 9 <= count; i += 8)
+        {
+            auto current = _mm_loadu_si128(reinterpret_cast<const __m128i*>(samples + i));
+            auto next = _mm_loadu_si128(reinterpret_cast<const __m128i*>(samples + i + 1));
+
+            auto squares = _mm_madd_epi16(current, current);
+            energy = _mm_add_epi64(energy, _mm_unpacklo_epi32(squares, zero));
+            energy = _mm_add_epi64(energy, _mm_unpackhi_epi32(squares, zero));
+
+            auto changed = _mm_xor_si128(_mm_srai_epi16(current, 15), _mm_srai_epi16(next, 15));
+            crossings = _mm_sub_epi16(crossings, changed);
+
+            // The 16-bit crossing counters are folded into the total before they can overflow.
+            if (((i / 8) & 0x0fff) == 0x0fff)
+            {
+                features.ZeroCrossings += HorizontalSum16(crossings);
+                crossings = _mm_setzero_si128();
+            }
+        }
+        uint64_t lanes[2];
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(lanes), energy);
+        features.Energy = lanes[0] + lanes[1];
+        features.ZeroCrossings += HorizontalSum16(crossings);
+#endif
+        for (; i < count; i++)
+        {
+            features.Energy += (uint64_t)((int32_t)samples[i] * samples[i]);
+            if (i + 1 < count && ((samples[i] < 0) != (samples[i + 1] < 0)))
+            {
+                features.ZeroCrossings++;
+            }
+        }
+        return features;
+    }
+
+private:
+#if defined(FRAME_FEATURES_SSE2)
+    static uint32_t HorizontalSum16(__m128i values)
+    {
+        uint16_t lanes[8];
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(lanes), values);
+        uint32_t sum = 0;
+        for (auto lane : lanes)
+        {
+            sum += lane;
+        }
+        return sum;
+    }
+#endif
+};
+
+// Drops long silences from 16-bit mono PCM before it is sent to the service, e.g. between PushAudioInputStream::Write()
+// and the file reader. Frames of 20 ms are classified by energy, plus zero crossings for quiet fricatives. Silences
+// up to 'maxSilenceMs' are sent unchanged, so the service still detects the end of utterances. Of longer silences
+// only the first and last 'keptSilenceMs' are sent. The offsets of results refer to the audio sent, MapToOriginal()
+// maps them back to the timeline of the input.
+class SilenceSkipper final
+{
+public:
+    struct Settings
+    {
+        // Frames below this level (in dB relative to full scale) are silence.
+        double SpeechLevelDb = -45;
+        // Frames up to 10 dB below the speech level still count as speech with many zero crossings (e.g. "s").
+        double FricativeZeroCrossingRate = 0.3;
+        uint32_t MaxSilenceMs = 600;
+        uint32_t KeptSilenceMs = 200;
+    };
+
+    struct Statistics
+    {
+        uint64_t BytesIn = 0;
+        uint64_t BytesSent = 0;
+        uint32_t SkippedSilences = 0;
+    };
+
+    // Throws std::invalid_argument for audio other than 16-bit mono PCM, or a format whose byte rate does not match.
+    explicit SilenceSkipper(const WavFileReader::WAVEFORMAT& format)
+        : SilenceSkipper(format, Settings())
+    {
+    }
+
+    SilenceSkipper(const WavFileReader::WAVEFORMAT& format, const Settings& settings)
+        : m_bytesPerSec(format.AvgBytesPerSec)
+    {
+        if (format.BitsPerSample != 16 || format.Channels != 1 || format.SamplesPerSec == 0)
+        {
+            throw std::invalid_argument("Silence can only be skipped in 16-bit mono PCM audio.");
+        }
+        // Offsets are mapped with the byte rate, a header with a wrong one (e.g. 0) would map them wrongly or divide by zero.
+        if (format.AvgBytesPerSec != format.SamplesPerSec * sizeof(int16_t))
+        {
+            throw std::invalid_argument("The byte rate of the audio does not match 16-bit mono PCM at its sample rate.");
+        }
+        if (settings.KeptSilenceMs * 2 > settings.MaxSilenceMs)
+        {
+            throw std::invalid_argument("The kept silence must be at most half the maximum silence.");
+        }
+
+        m_frameSamples = format.SamplesPerSec * frameMs / 1000;
+        m_frameBytes = m_frameSamples * sizeof(int16_t);
+        m_frame.reserve(m_frameBytes);
+        m_samples.resize(m_frameSamples);
+        m_keptFrames = settings.KeptSilenceMs / frameMs;
+        m_maxSilenceFrames = settings.MaxSilenceMs / frameMs;
+
+        // Energy of a frame whose RMS level equals the threshold.
+        auto rms = 32768.0 * std::pow(10.0, settings.SpeechLevelDb / 20);
+        m_speechEnergy = (uint64_t)(rms * rms * m_frameSamples);
+        m_fricativeEnergy = m_speechEnergy / 10;
+        m_fricativeCrossings = (uint32_t)(settings.FricativeZeroCrossingRate * m_frameSamples);
+    }
+
+    // Passes the audio that is to be sent to 'write', a callable taking (const uint8_t* data, uint32_t size).
+    template <class Writer>
+    void Process(const uint8_t* data, uint32_t size, Writer&& write)
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_statistics.BytesIn += size;
+        }
+        while (size > 0)
+        {
+            // Collects whole frames, the audio is sent frame by frame.
+            auto count = (uint32_t)std::min<size_t>(m_frameBytes - m_frame.size(), size);
+            m_frame.insert(m_frame.end(), data, data + count);
+            data += count;
+            size -= count;
+
+            if (m_frame.size() == m_frameBytes)
+            {
+                OnFrame(write);
+                m_frame.clear();
+            }
+        }
+    }
+
+    // Sends the audio held back at the end of the input.
+    template <class Writer>
+    void Flush(Writer&& write)
+    {
+        if (!m_frame.empty())
+        {
+            m_held.push_back(m_frame);
+            m_frame.clear();
+        }
+        SendHeld(write);
+    }
+
+    // Maps an offset in the audio sent (in ticks of 100 nanoseconds) to the same position in the input.
+    uint64_t MapToOriginal(uint64_t sentTicks)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto gap = std::upper_bound(m_gaps.begin(), m_gaps.end(), sentTicks, [](uint64_t ticks, const Gap& g) { return ticks < g.SentTicks; });
+        if (gap == m_gaps.begin())
+        {
+            return sentTicks;
+        }
+        --gap;
+        return sentTicks + gap->SkippedTicks;
+    }
+
+    Statistics GetStatistics()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_statistics;
+    }
+
+private:
+    static constexpr uint32_t frameMs = 20;
+    static constexpr uint64_t ticksPerSecond = 10000000;
+
+    // From 'SentTicks' in the audio sent on, offsets lag behind the input by 'SkippedTicks' in total.
+    struct Gap
+    {
+        uint64_t SentTicks;
+        uint64_t SkippedTicks;
+    };
+
+    bool IsSpeech(const FrameFeatures& features) const
+    {
+        return features.Energy >= m_speechEnergy ||
+            (features.Energy >= m_fricativeEnergy && features.ZeroCrossings >= m_fricativeCrossings);
+    }
+
+    template <class Writer>
+    void OnFrame(Writer& write)
+    {
+        // The frame is copied, the input may split samples or not be aligned for them.
+        memcpy(m_samples.data(), m_frame.data(), m_frameBytes);
+        auto features = FrameFeatures::Compute(m_samples.data(), m_samples.size());
+        if (IsSpeech(features))
+        {
+            SendHeld(write);
+            Send(m_frame, write);
+            return;
+        }
+
+        // Silence is held back until it is clear whether it is long enough to be shortened.
+        m_held.push_back(m_frame);
+        if (m_skipping || m_held.size() > m_maxSilenceFrames)
+        {
+            // Long silence: sends its start, then keeps only the last frames before the next speech.
+            if (!m_skipping)
+            {
+                for (uint32_t i = 0; i < m_keptFrames; i++)
+                {
+                    Send(m_held.front(), write);
+                    m_held.pop_front();
+                }
+                m_skipping = true;
+            }
+            while (m_held.size() > m_keptFrames)
+            {
+                m_held.pop_front();
+                m_skippedBytes += m_frameBytes;
+            }
+        }
+    }
+
+    template <class Writer>
+    void SendHeld(Writer& write)
+    {
+        if (m_skipping)
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            auto skippedTicks = (m_gaps.empty() ? 0 : m_gaps.back().SkippedTicks) + ToTicks(m_skippedBytes);
+            m_gaps.push_back(Gap{ ToTicks(m_statistics.BytesSent), skippedTicks });
+            m_statistics.SkippedSilences++;
+            m_skippedBytes = 0;
+            m_skipping = false;
+        }
+        for (const auto& frame : m_held)
+        {
+            Send(frame, write);
+        }
+        m_held.clear();
+    }
+
+    template <class Writer>
+    void Send(const std::vector<uint8_t>& frame, Writer& write)
+    {
+        auto size = (uint32_t)frame.size();
+        write(frame.data(), size);
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_statistics.BytesSent += size;
+    }
+
+    uint64_t ToTicks(uint64_t bytes) const
+    {
+        return bytes * ticksPerSecond / m_bytesPerSec;
+    }
+
+    const uint32_t m_bytesPerSec;
+    size_t m_frameSamples;
+    size_t m_frameBytes;
+    uint32_t m_keptFrames;
+    uint32_t m_maxSilenceFrames;
+    uint64_t m_speechEnergy;
+    uint64_t m_fricativeEnergy;
+    uint32_t m_fricativeCrossings;
+
+    std::vector<uint8_t> m_frame;
+    std::vector<int16_t> m_samples;
+    std::deque<std::vector<uint8_t>> m_held;
+    bool m_skipping = false;
+    uint64_t m_skippedBytes = 0;
+
+    std::mutex m_mutex;
+    std::vector<Gap> m_gaps;
+    Statistics m_statistics;
+};
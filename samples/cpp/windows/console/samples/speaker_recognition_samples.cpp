@@ -6,10 +6,16 @@
 #include "stdafx.h"
 
 // <toplevel>
+#include <fstream>
 #include <string>
 #include <vector>
 #include <speechapi_cxx.h>
 #include "wav_file_reader.h"
+#include "audio_chunk_pool.h"
+#include "read_ahead_audio_callback.h"
+#include "voice_profile_bulk_enroller.h"
+#include "sharded_speaker_identifier.h"
+#include "multi_profile_verifier.h"
 
 using namespace std;
 using namespace Microsoft::CognitiveServices::Speech;
@@ -19,36 +25,6 @@ using namespace Microsoft::CognitiveServices::Speech::Speaker;
 
 const string audioDirName{ "..\\..\\..\\..\\..\\SampleData\\audiofiles\\" };
 
-// AudioInputFromFileCallback implements PullAudioInputStreamCallback interface, and uses a wav file as source
-class AudioInputFromFileCallback final : public PullAudioInputStreamCallback
-{
-public:
-    // Constructor that creates an input stream from a file.
-    AudioInputFromFileCallback(const string& audioFileName)
-        : m_reader(audioFileName)
-    {
-    }
-
-    // Implements AudioInputStream::Read() which is called to get data from the audio stream.
-    // It copies data available in the stream to 'dataBuffer', but no more than 'size' bytes.
-    // If the data available is less than 'size' bytes, it is allowed to just return the amount of data that is currently available.
-    // If there is no data, this function must wait until data is available.
-    // It returns the number of bytes that have been copied in 'dataBuffer'.
-    // It returns 0 to indicate that the stream reaches end or is closed.
-    int Read(uint8_t* dataBuffer, uint32_t size) override
-    {
-        return m_reader.Read(dataBuffer, size);
-    }
-    // Implements AudioInputStream::Close() which is called when the stream needs to be closed.
-    void Close() override
-    {
-        m_reader.Close();
-    }
-
-private:
-    WavFileReader m_reader;
-};
-
 // helper functions
 shared_ptr<VoiceProfile> VoiceProfileEnrollmentWithMicrophone(const shared_ptr<VoiceProfileClient>& client);
 void VerifyVoiceProfileFromMicrophone(const shared_ptr<SpeechConfig>& config, const shared_ptr<VoiceProfile>& profile);
@@ -225,6 +201,110 @@ void SpeakerIdentificationWithMicrophone()
     }
 }
 
+// Bulk enrollment of many speakers, as when onboarding a customer, with the profile ids written to a manifest.
+void SpeakerBulkEnrollment()
+{
+    // Creates an instance of a speech config with specified subscription key and service region.
+    // Replace with your own subscription key and service region (e.g., "westus").
+    auto config = SpeechConfig::FromSubscription("YourSubscriptionKey", "YourServiceRegion");
+
+    // One VoiceProfileClient serves all concurrent enrollments.
+    auto client = VoiceProfileClient::FromConfig(config);
+
+    // Each speaker comes with the audio files to enroll from, used in turn until the profile is enrolled.
+    // In a real onboarding this list is read from the archive index of the customer.
+    vector<VoiceProfileBulkEnroller::Speaker> speakers{
+        { "speaker-1", { audioDirName + "TalkForAFewSeconds16.wav" } },
+        { "speaker-2", { audioDirName + "neuralActivationPhrase.wav", audioDirName + "wikipediaOcelot.wav" } },
+        { "speaker-3", { audioDirName + "speechService.wav", audioDirName + "wikipediaOcelot.wav" } },
+    };
+
+    VoiceProfileBulkEnroller::Settings settings;
+    settings.MaxConcurrent = 4;
+    VoiceProfileBulkEnroller enroller(client, settings);
+
+    // The manifest is appended to, lines are complete as soon as a speaker is done.
+    ofstream manifest("voice_profiles.tsv", ios::app);
+    if (!manifest)
+    {
+        cout << "Cannot open the manifest file." << endl;
+        return;
+    }
+
+    auto statistics = enroller.Run(speakers, manifest);
+    cout << "Enrolled " << statistics.Enrolled << ", incomplete " << statistics.Incomplete << ", failed " << statistics.Failed
+        << ", retries " << statistics.Retries << ". Profile ids are in voice_profiles.tsv." << endl;
+}
+
+// Speaker identification against a profile set split into shards, with the audio read once for all shards.
+void SpeakerIdentificationSharded()
+{
+    // Creates an instance of a speech config with specified subscription key and service region.
+    // Replace with your own subscription key and service region (e.g., "westus").
+    auto config = SpeechConfig::FromSubscription("YourSubscriptionKey", "YourServiceRegion");
+
+    // Creates a VoiceProfileClient to create voice profiles and train voice profiles.
+    auto client = VoiceProfileClient::FromConfig(config);
+
+    // Creates and trains three voice profiles. Real candidate sets are usually existing profiles, loaded with VoiceProfile::FromId().
+    vector<shared_ptr<VoiceProfile>> profiles{
+        VoiceProfileEnrollmentWithPullStream(client, audioDirName + "TalkForAFewSeconds16.wav"),
+        VoiceProfileEnrollmentWithPullStream(client, audioDirName + "neuralActivationPhrase.wav"),
+        VoiceProfileEnrollmentWithPullStream(client, audioDirName + "speechService.wav"),
+    };
+
+    // Shards of one profile each, to show the merging with a small set. The default is the service limit of 50.
+    ShardedSpeakerIdentifier::Settings settings;
+    settings.ProfilesPerShard = 1;
+    ShardedSpeakerIdentifier identifier(config, profiles, settings);
+
+    auto audio = SharedAudioBuffer::FromWavFile(audioDirName + "wikipediaOcelot.wav");
+    auto result = identifier.Identify(audio, 2);
+
+    cout << "Scored against " << identifier.GetShardCount() << " shards." << endl;
+    for (const auto& candidate : result.Candidates)
+    {
+        cout << "Profile " << candidate.ProfileId << " with similarity score " << candidate.Score << endl;
+    }
+    for (const auto& error : result.Errors)
+    {
+        cout << "CANCELED: " << error << endl;
+    }
+}
+
+// Speaker verification of one utterance against several claimed identities, with the audio read once.
+void SpeakerVerificationMultipleProfiles()
+{
+    // Creates an instance of a speech config with specified subscription key and service region.
+    // Replace with your own subscription key and service region (e.g., "westus").
+    auto config = SpeechConfig::FromSubscription("YourSubscriptionKey", "YourServiceRegion");
+
+    // The claimed identities, enrolled earlier e.g. as in SpeakerVerificationWithPushStream().
+    // Replace with your own voice profile ids.
+    vector<shared_ptr<VoiceProfile>> profiles{
+        VoiceProfile::FromId("YourVoiceProfileId1", VoiceProfileType::TextDependentVerification),
+        VoiceProfile::FromId("YourVoiceProfileId2", VoiceProfileType::TextDependentVerification),
+        VoiceProfile::FromId("YourVoiceProfileId3", VoiceProfileType::TextDependentVerification),
+    };
+
+    // Loads the utterance once; all checks stream from this buffer.
+    auto audio = SharedAudioBuffer::FromWavFile(audioDirName + "myVoiceIsMyPassportVerifyMe04.wav");
+
+    MultiProfileVerifier verifier(config);
+    for (const auto& verification : verifier.Verify(audio, profiles))
+    {
+        if (!verification.Error.empty())
+        {
+            cout << "CANCELED: profile " << verification.ProfileId << ", ErrorDetails=" << verification.Error << endl;
+        }
+        else
+        {
+            cout << "Profile " << verification.ProfileId << (verification.Accepted ? " accepted" : " rejected")
+                << " with score " << verification.Score << endl;
+        }
+    }
+}
+
 // helper function for speaker verification.
 void VerifyVoiceProfileFromMicrophone(const shared_ptr<SpeechConfig>& config, const shared_ptr<VoiceProfile>& profile)
 {
@@ -263,15 +343,16 @@ int PushData(const string& filename, shared_ptr<PushAudioInputStream>& pushStrea
 {
     try
     {
-        WavFileReader reader(filename);
+        MappedWavFileReader reader(filename);
 
-        vector<uint8_t> buffer(1000);
-        // Read data and push them into the stream
-        int readSamples = 0;
-        while ((readSamples = reader.Read(buffer.data(), (uint32_t)buffer.size())) != 0)
+        // Push slices of 100 ms of audio, aligned to whole frames, into the stream
+        auto chunkSize = AudioChunkPool::ChunkSizeFor(reader.GetFormat());
+        const uint8_t* slice = nullptr;
+        uint32_t sliceSize = 0;
+        while ((sliceSize = reader.Next(&slice, chunkSize)) != 0)
         {
-            // Push a buffer into the stream
-            pushStream->Write(buffer.data(), readSamples);
+            // Write() does not modify the buffer, it only takes a non-const pointer.
+            pushStream->Write(const_cast<uint8_t*>(slice), sliceSize);
         }
 
         // Close the push stream.
@@ -340,7 +421,7 @@ shared_ptr<VoiceProfile> VoiceProfileEnrollmentWithPullStream (const shared_ptr<
     // Creates a callback that will read audio data from a WAV file.
     // Currently, the only supported WAV format is mono(single channel), 16 kHZ sample rate, 16 bits per sample.
     // Replace with your own audio file name.
-    auto callback = make_shared<AudioInputFromFileCallback>(filename);
+    auto callback = CreateReadAheadWavFileCallback(filename);
     auto pullStream = AudioInputStream::CreatePullStream(callback);
 
     // Creates an audio config object from stream input;
@@ -379,7 +460,7 @@ shared_ptr<VoiceProfile> VoiceProfileEnrollmentWithPullStream (const shared_ptr<
 void VoiceProfileIdentificationWithPullStream(const shared_ptr<SpeechConfig>& config, const vector<shared_ptr<VoiceProfile>>& profiles)
 {
     // Create a callback that will be called by the Speech SDK during identification, aka SpeakerRecognizer::RecognizeOnceAsync.
-    auto callback = make_shared<AudioInputFromFileCallback>(audioDirName + "wikipediaOcelot.wav");
+    auto callback = CreateReadAheadWavFileCallback(audioDirName + "wikipediaOcelot.wav");
     auto pullStream = AudioInputStream::CreatePullStream(callback);
 
     // Creates an audio config object from stream input;
@@ -0,0 +1,309 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#pragma once
+
+#include <speechapi_cxx.h>
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// Latency histogram with fixed bucket bounds, updated without locks.
+class LatencyHistogram final
+{
+public:
+    // Upper bounds of the buckets in milliseconds; a last bucket takes everything above.
+    explicit LatencyHistogram(std::vector<double> boundsMs = { 50, 100, 250, 500, 1000, 2500, 5000, 10000 })
+        : m_boundsMs(std::move(boundsMs)), m_counts(new std::atomic<uint64_t>[m_boundsMs.size() + 1])
+    {
+        for (size_t i = 0; i <= m_boundsMs.size(); i++)
+        {
+            m_counts[i] = 0;
+        }
+    }
+
+    void Observe(std::chrono::steady_clock::duration latency)
+    {
+        auto ms = std::chrono::duration<double, std::milli>(latency).count();
+        size_t bucket = 0;
+        while (bucket < m_boundsMs.size() && ms > m_boundsMs[bucket])
+        {
+            bucket++;
+        }
+        m_counts[bucket].fetch_add(1, std::memory_order_relaxed);
+        m_sumUs.fetch_add((uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(latency).count(), std::memory_order_relaxed);
+    }
+
+    // Writes the histogram in OpenMetrics text format, in seconds as the format recommends.
+    void Write(std::ostream& out, const char* name, const char* help) const
+    {
+        out << "# TYPE " << name << " histogram\n";
+        out << "# UNIT " << name << " seconds\n";
+        out << "# HELP " << name << " " << help << "\n";
+        uint64_t cumulative = 0;
+        for (size_t i = 0; i <= m_boundsMs.size(); i++)
+        {
+            cumulative += m_counts[i].load(std::memory_order_relaxed);
+            out << name << "_bucket{le=\"";
+            if (i < m_boundsMs.size())
+            {
+                out << m_boundsMs[i] / 1000;
+            }
+            else
+            {
+                out << "+Inf";
+            }
+            out << "\"} " << cumulative << "\n";
+        }
+        out << name << "_sum " << m_sumUs.load(std::memory_order_relaxed) / 1e6 << "\n";
+        out << name << "_count " << cumulative << "\n";
+    }
+
+private:
+    const std::vector<double> m_boundsMs;
+    std::unique_ptr<std::atomic<uint64_t>[]> m_counts;
+    std::atomic<uint64_t> m_sumUs{ 0 };
+};
+
+// Counters and latency histograms of recognizers and synthesizers, written in the OpenMetrics text format
+// (e.g. served by MetricsHttpEndpoint in metrics_http_endpoint.h and scraped by Prometheus). Attach() hooks the
+// events; audio bytes are counted through CountingPullCallback / CountingPushOutputCallback, or CountAudioIn()
+// after writing to a push stream. Rates such as partial results per second are derived from the counters by
+// the scraper, e.g. rate(speech_partial_results_total[1m]).
+class SpeechMetrics final
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    SpeechMetrics() = default;
+    SpeechMetrics(const SpeechMetrics&) = delete;
+    SpeechMetrics& operator=(const SpeechMetrics&) = delete;
+
+    // Subscribes to the session and recognition events of the recognizer. The metrics must outlive the recognizer.
+    template <class RecognizerType>
+    void Attach(const std::shared_ptr<RecognizerType>& recognizer)
+    {
+        using namespace Microsoft::CognitiveServices::Speech;
+
+        recognizer->SessionStarted.Connect([this](const SessionEventArgs& e)
+        {
+            m_recognitionSessions.fetch_add(1, std::memory_order_relaxed);
+            m_activeSessions.fetch_add(1, std::memory_order_relaxed);
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_pendingFirstPartial[e.SessionId] = Clock::now();
+        });
+        recognizer->SessionStopped.Connect([this](const SessionEventArgs& e)
+        {
+            m_activeSessions.fetch_sub(1, std::memory_order_relaxed);
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_pendingFirstPartial.erase(e.SessionId);
+        });
+        recognizer->Recognizing.Connect([this](const auto& e)
+        {
+            m_partials.fetch_add(1, std::memory_order_relaxed);
+            auto now = Clock::now();
+            std::lock_guard<std::mutex> lock(m_mutex);
+            auto pending = m_pendingFirstPartial.find(e.SessionId);
+            if (pending != m_pendingFirstPartial.end())
+            {
+                m_firstPartialLatency.Observe(now - pending->second);
+                m_pendingFirstPartial.erase(pending);
+            }
+        });
+        recognizer->Recognized.Connect([this](const auto&)
+        {
+            m_finals.fetch_add(1, std::memory_order_relaxed);
+        });
+        recognizer->Canceled.Connect([this](const auto& e)
+        {
+            CountCancellation(e.Reason, e.ErrorCode);
+        });
+    }
+
+    // Subscribes to the synthesis events of the synthesizer. The metrics must outlive the synthesizer.
+    void Attach(Microsoft::CognitiveServices::Speech::SpeechSynthesizer& synthesizer)
+    {
+        using namespace Microsoft::CognitiveServices::Speech;
+
+        synthesizer.SynthesisStarted.Connect([this](const SpeechSynthesisEventArgs& e)
+        {
+            m_syntheses.fetch_add(1, std::memory_order_relaxed);
+            m_activeSessions.fetch_add(1, std::memory_order_relaxed);
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_pendingFirstByte[e.Result->ResultId] = Clock::now();
+        });
+        synthesizer.Synthesizing.Connect([this](const SpeechSynthesisEventArgs& e)
+        {
+            auto now = Clock::now();
+            std::lock_guard<std::mutex> lock(m_mutex);
+            auto pending = m_pendingFirstByte.find(e.Result->ResultId);
+            if (pending != m_pendingFirstByte.end())
+            {
+                m_firstByteLatency.Observe(now - pending->second);
+                m_pendingFirstByte.erase(pending);
+            }
+        });
+        synthesizer.SynthesisCompleted.Connect([this](const SpeechSynthesisEventArgs& e)
+        {
+            m_activeSessions.fetch_sub(1, std::memory_order_relaxed);
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_pendingFirstByte.erase(e.Result->ResultId);
+        });
+        synthesizer.SynthesisCanceled.Connect([this](const SpeechSynthesisEventArgs& e)
+        {
+            m_activeSessions.fetch_sub(1, std::memory_order_relaxed);
+            auto cancellation = SpeechSynthesisCancellationDetails::FromResult(e.Result);
+            CountCancellation(cancellation->Reason, cancellation->ErrorCode);
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_pendingFirstByte.erase(e.Result->ResultId);
+        });
+    }
+
+    // Counts audio sent to a recognizer.
+    void CountAudioIn(uint64_t bytes)
+    {
+        m_bytesIn.fetch_add(bytes, std::memory_order_relaxed);
+    }
+
+    // Counts audio received from a synthesizer.
+    void CountAudioOut(uint64_t bytes)
+    {
+        m_bytesOut.fetch_add(bytes, std::memory_order_relaxed);
+    }
+
+    // Writes all metrics in the OpenMetrics text format, ending with "# EOF".
+    void Write(std::ostream& out) const
+    {
+        WriteCounter(out, "speech_audio_in_bytes", "Audio bytes sent to recognizers.", m_bytesIn);
+        WriteCounter(out, "speech_audio_out_bytes", "Audio bytes received from synthesizers.", m_bytesOut);
+        WriteCounter(out, "speech_recognition_sessions", "Recognition sessions started.", m_recognitionSessions);
+        WriteCounter(out, "speech_syntheses", "Syntheses started.", m_syntheses);
+
+        out << "# TYPE speech_active_sessions gauge\n";
+        out << "# HELP speech_active_sessions Recognition sessions and syntheses in progress.\n";
+        out << "speech_active_sessions " << m_activeSessions.load(std::memory_order_relaxed) << "\n";
+
+        WriteCounter(out, "speech_partial_results", "Partial recognition results (Recognizing events).", m_partials);
+        WriteCounter(out, "speech_final_results", "Final recognition results (Recognized events).", m_finals);
+
+        out << "# TYPE speech_cancellations counter\n";
+        out << "# HELP speech_cancellations Canceled recognitions and syntheses, by CancellationErrorCode.\n";
+        for (size_t code = 0; code < errorCodeCount; code++)
+        {
+            out << "speech_cancellations_total{error_code=\"" << ErrorCodeName(code) << "\"} "
+                << m_cancellations[code].load(std::memory_order_relaxed) << "\n";
+        }
+
+        m_firstPartialLatency.Write(out, "speech_first_partial_latency_seconds", "Time from SessionStarted to the first partial result.");
+        m_firstByteLatency.Write(out, "speech_synthesis_first_byte_latency_seconds", "Time from SynthesisStarted to the first audio chunk.");
+        out << "# EOF\n";
+    }
+
+private:
+    // The CancellationErrorCode values, and one count for codes added to the SDK later.
+    static constexpr size_t errorCodeCount = 11;
+
+    static const char* ErrorCodeName(size_t code)
+    {
+        static const char* const names[errorCodeCount] =
+        {
+            "NoError", "AuthenticationFailure", "BadRequest", "TooManyRequests", "Forbidden", "ConnectionFailure",
+            "ServiceTimeout", "ServiceError", "ServiceUnavailable", "RuntimeError", "Other"
+        };
+        return names[code];
+    }
+
+    void CountCancellation(Microsoft::CognitiveServices::Speech::CancellationReason reason, Microsoft::CognitiveServices::Speech::CancellationErrorCode errorCode)
+    {
+        // Canceled at the end of the stream is how a recognition of a stream ends, not a failure.
+        if (reason == Microsoft::CognitiveServices::Speech::CancellationReason::EndOfStream)
+        {
+            return;
+        }
+        auto code = (size_t)errorCode;
+        m_cancellations[code < errorCodeCount - 1 ? code : errorCodeCount - 1].fetch_add(1, std::memory_order_relaxed);
+    }
+
+    static void WriteCounter(std::ostream& out, const char* name, const char* help, const std::atomic<uint64_t>& value)
+    {
+        out << "# TYPE " << name << " counter\n";
+        out << "# HELP " << name << " " << help << "\n";
+        out << name << "_total " << value.load(std::memory_order_relaxed) << "\n";
+    }
+
+    std::atomic<uint64_t> m_bytesIn{ 0 };
+    std::atomic<uint64_t> m_bytesOut{ 0 };
+    std::atomic<uint64_t> m_recognitionSessions{ 0 };
+    std::atomic<uint64_t> m_syntheses{ 0 };
+    std::atomic<int64_t> m_activeSessions{ 0 };
+    std::atomic<uint64_t> m_partials{ 0 };
+    std::atomic<uint64_t> m_finals{ 0 };
+    std::atomic<uint64_t> m_cancellations[errorCodeCount] = {};
+
+    LatencyHistogram m_firstPartialLatency;
+    LatencyHistogram m_firstByteLatency;
+
+    std::mutex m_mutex;
+    std::map<std::string, Clock::time_point> m_pendingFirstPartial;
+    std::map<std::string, Clock::time_point> m_pendingFirstByte;
+};
+
+// Pull stream callback that counts the audio read from another callback as sent to recognizers.
+class CountingPullCallback final : public Microsoft::CognitiveServices::Speech::Audio::PullAudioInputStreamCallback
+{
+public:
+    CountingPullCallback(std::shared_ptr<Microsoft::CognitiveServices::Speech::Audio::PullAudioInputStreamCallback> inner, SpeechMetrics& metrics)
+        : m_inner(std::move(inner)), m_metrics(metrics)
+    {
+    }
+
+    int Read(uint8_t* dataBuffer, uint32_t size) override
+    {
+        auto count = m_inner->Read(dataBuffer, size);
+        if (count > 0)
+        {
+            m_metrics.CountAudioIn((uint64_t)count);
+        }
+        return count;
+    }
+
+    void Close() override
+    {
+        m_inner->Close();
+    }
+
+private:
+    std::shared_ptr<Microsoft::CognitiveServices::Speech::Audio::PullAudioInputStreamCallback> m_inner;
+    SpeechMetrics& m_metrics;
+};
+
+// Push output stream callback that counts the audio a synthesizer writes to another callback.
+class CountingPushOutputCallback final : public Microsoft::CognitiveServices::Speech::Audio::PushAudioOutputStreamCallback
+{
+public:
+    CountingPushOutputCallback(std::shared_ptr<Microsoft::CognitiveServices::Speech::Audio::PushAudioOutputStreamCallback> inner, SpeechMetrics& metrics)
+        : m_inner(std::move(inner)), m_metrics(metrics)
+    {
+    }
+
+    int Write(uint8_t* dataBuffer, uint32_t size) override
+    {
+        m_metrics.CountAudioOut(size);
+        return m_inner->Write(dataBuffer, size);
+    }
+
+    void Close() override
+    {
+        m_inner->Close();
+    }
+
+private:
+    std::shared_ptr<Microsoft::CognitiveServices::Speech::Audio::PushAudioOutputStreamCallback> m_inner;
+    SpeechMetrics& m_metrics;
+};
@@ -7,9 +7,41 @@
 
 // <toplevel>
 #include <speechapi_cxx.h>
-#include <nlohmann/json.hpp>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
 #include <fstream>
+#include <mutex>
 #include "wav_file_reader.h"
+#include "audio_chunk_pool.h"
+#include "paced_push_writer.h"
+#include "recognition_latency_tracker.h"
+#include "recognition_session_runner.h"
+#include "wav_channel_splitter.h"
+#include "warm_recognizer_pool.h"
+#include "custom_endpoint_recognizer_pools.h"
+#include "sharded_file_recognizer.h"
+#include "recognition_checkpoint.h"
+#include "read_ahead_audio_callback.h"
+#include "pull_callback.h"
+#include "http_range_source.h"
+#include "partial_result_throttle.h"
+#include "silence_skipper.h"
+#include "audio_format_converter.h"
+#include "speech_metrics.h"
+#include "metrics_http_endpoint.h"
+#include "pronunciation_batch_scorer.h"
+#include "keyword_model_cache.h"
+#include "process_memory.h"
+#include "detailed_result_view.h"
+#include "transcript_store.h"
+#include "language_decision_cache.h"
+#include "enhanced_audio_cache.h"
+#include "region_selector.h"
+#include "authorization_token_manager.h"
+#if defined(SPEECH_SAMPLES_WITH_OPUS)
+#include "opus_push_stream_encoder.h"
+#endif
 
 using namespace std;
 using namespace Microsoft::CognitiveServices::Speech;
@@ -26,6 +58,12 @@ void SpeechRecognitionWithMicrophone()
 
     // Creates a speech recognizer using microphone as audio input. The default language is "en-us".
     auto recognizer = SpeechRecognizer::FromConfig(config);
+
+    // Opens the connection to the service now, so TLS and websocket setup overlap with the user starting
+    // to speak instead of delaying the result of RecognizeOnceAsync().
+    auto connection = Connection::FromRecognizer(recognizer);
+    connection->Open(false);
+
     cout << "Say something...\n";
 
     // Starts speech recognition, and returns after a single utterance is recognized. The end of a
@@ -60,6 +98,53 @@ void SpeechRecognitionWithMicrophone()
     // </SpeechRecognitionWithMicrophone>
 }
 
+// Speech recognition of several voice commands using microphone, with recognizers from a warm pool.
+void SpeechRecognitionWithWarmRecognizerPool()
+{
+    // Creates an instance of a speech config with specified subscription key and service region.
+    // Replace with your own subscription key and service region (e.g., "westus").
+    auto config = SpeechConfig::FromSubscription("YourSubscriptionKey", "YourServiceRegion");
+
+    // Two recognizers are connected now, before the first command is spoken.
+    WarmRecognizerPool<SpeechRecognizer> pool([config]() { return SpeechRecognizer::FromConfig(config); }, 2);
+
+    const int commandCount = 3;
+    for (int i = 0; i < commandCount; i++)
+    {
+        auto recognizer = pool.Acquire();
+        cout << "Say a command (" << i + 1 << " of " << commandCount << ")...\n";
+
+        auto result = recognizer->RecognizeOnceAsync().get();
+        if (result->Reason == ResultReason::RecognizedSpeech)
+        {
+            cout << "RECOGNIZED: Text=" << result->Text << std::endl;
+        }
+        else if (result->Reason == ResultReason::NoMatch)
+        {
+            cout << "NOMATCH: Speech could not be recognized." << std::endl;
+        }
+        else if (result->Reason == ResultReason::Canceled)
+        {
+            auto cancellation = CancellationDetails::FromResult(result);
+            cout << "CANCELED: Reason=" << (int)cancellation->Reason << std::endl;
+
+            if (cancellation->Reason == CancellationReason::Error)
+            {
+                cout << "CANCELED: ErrorCode=" << (int)cancellation->ErrorCode << std::endl;
+                cout << "CANCELED: ErrorDetails=" << cancellation->ErrorDetails << std::endl;
+                cout << "CANCELED: Did you update the subscription info?" << std::endl;
+            }
+
+            // A recognizer that failed is not handed out again, the pool replaces it.
+            recognizer.Discard();
+        }
+    }
+
+    auto statistics = pool.GetStatistics();
+    cout << "Warm leases: " << statistics.WarmLeases << ", cold leases: " << statistics.ColdLeases
+         << ", reconnects: " << statistics.Reconnects << std::endl;
+}
+
 
 // Speech recognition in the specified language, using microphone, and requesting detailed output format.
 void SpeechRecognitionWithLanguageAndUsingDetailedOutputFormat()
@@ -100,31 +185,27 @@ void SpeechRecognitionWithLanguageAndUsingDetailedOutputFormat()
         cout << "Offset: " << result->Offset() << std::endl
              << "Duration: " << result->Duration() << std::endl;
 
-        // Get access to the JSON string that includes detailed speech recognition results
-        string jsonString = result->Properties.GetProperty(PropertyId::SpeechServiceResponse_JsonResult);
-        // cout << "  Speech Service JSON: " << jsonString << std::endl;
+        // Get access to the detailed speech recognition results. The view parses the JSON string
+        // (PropertyId::SpeechServiceResponse_JsonResult) on first access, without copying its strings.
+        DetailedResultView detailedResult(result);
+        // cout << "  Speech Service JSON: " << detailedResult.GetJson() << std::endl;
 
-        // Extract the "NBest" array of recognition results from the JSON.
+        // Go through the "NBest" array of recognition results.
         // Note that the first cell in the NBest array corresponds to the recognition results 
         // (NOT the cell with the highest confidence number!)
-        auto jsonResult = nlohmann::json::parse(jsonString);
-        auto nbestArray = jsonResult["NBest"];
-        for (int i = 0; i < nbestArray.size(); i++)
+        for (const auto& nbestItem : detailedResult.GetNBest())
         {
-            auto nbestItem = nbestArray[i];
-            cout << "\tConfidence: " << nbestItem["Confidence"] << std::endl;
-            cout << "\tLexical: " << nbestItem["Lexical"] << std::endl;
-            cout << "\tITN: " <<  nbestItem["ITN"] << std::endl; // ITN stands for Inverse Text Normalization
-            cout << "\tMaskedITN: " << nbestItem["MaskedITN"] << std::endl;
-            cout << "\tDisplay: " << nbestItem["Display"] << std::endl;
+            cout << "\tConfidence: " << nbestItem.Confidence << std::endl;
+            cout << "\tLexical: " << nbestItem.Lexical.ToString() << std::endl;
+            cout << "\tITN: " << nbestItem.Itn.ToString() << std::endl; // ITN stands for Inverse Text Normalization
+            cout << "\tMaskedITN: " << nbestItem.MaskedItn.ToString() << std::endl;
+            cout << "\tDisplay: " << nbestItem.Display.ToString() << std::endl;
 
             // Word-level timing
-            auto wordsArray = nbestItem["Words"];
             cout << "\t\tWord | Offset | Duration" << std::endl;
-            for (int j = 0; j < wordsArray.size(); j++)
+            for (const auto& wordItem : nbestItem.Words)
             {
-                auto wordItem = wordsArray[j];
-                cout << "\t\t" << wordItem["Word"] << " " << wordItem["Offset"] << " " << wordItem["Duration"] << std::endl;
+                cout << "\t\t" << wordItem.Text.ToString() << " " << wordItem.Offset << " " << wordItem.Duration << std::endl;
             }
         }
     }
@@ -153,10 +234,14 @@ void SpeechContinuousRecognitionWithFile()
     // Replace with your own subscription key and service region (e.g., "westus").
     auto config = SpeechConfig::FromSubscription("YourSubscriptionKey", "YourServiceRegion");
 
+    // Measures recognition latency. The file is read faster than real time, so latency is relative to the start.
+    RecognitionLatencyTracker latencyTracker;
+
     // Creates a speech recognizer using file as audio input.
     // Replace with your own audio file name.
     auto audioInput = AudioConfig::FromWavFileInput("whatstheweatherlike.wav");
     auto recognizer = SpeechRecognizer::FromConfig(config, audioInput);
+    latencyTracker.Attach(recognizer);
 
     // promise for synchronization of recognition end.
     promise<void> recognitionEnd;
@@ -202,6 +287,7 @@ void SpeechContinuousRecognitionWithFile()
     });
 
     // Starts continuous recognition. Uses StopContinuousRecognitionAsync() to stop recognition.
+    latencyTracker.OnAudioStart();
     recognizer->StartContinuousRecognitionAsync().get();
 
     // Waits for recognition end.
@@ -209,9 +295,48 @@ void SpeechContinuousRecognitionWithFile()
 
     // Stops recognition.
     recognizer->StopContinuousRecognitionAsync().get();
+
+    latencyTracker.Report(cout);
     // </SpeechContinuousRecognitionWithFile>
 }
 
+// Speech continuous recognition of a long file, cut at silences into shards that are recognized concurrently.
+void SpeechContinuousRecognitionWithFileSharded()
+{
+    // Creates an instance of a speech config with specified subscription key and service region.
+    // Replace with your own subscription key and service region (e.g., "westus").
+    auto config = SpeechConfig::FromSubscription("YourSubscriptionKey", "YourServiceRegion");
+
+    // Replace with your own audio file name. Shards are at least 10 seconds long, so a short file
+    // is recognized in a single shard.
+    const size_t shardCount = 4;
+    auto started = chrono::steady_clock::now();
+    ShardedFileRecognizer::Transcript transcript;
+    try
+    {
+        transcript = ShardedFileRecognizer::Recognize(config, "whatstheweatherlike.wav", shardCount);
+    }
+    catch (const exception& e)
+    {
+        cout << "Exit due to exception: " << e.what() << endl;
+        return;
+    }
+    auto elapsed = chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - started);
+
+    for (const auto& segment : transcript.Segments)
+    {
+        cout << "RECOGNIZED: Text=" << segment.Text << "\n"
+             << "  Offset=" << segment.Offset << "\n"
+             << "  Duration=" << segment.Duration << "\n"
+             << "  Shard=" << segment.Shard << std::endl;
+    }
+    for (const auto& error : transcript.Errors)
+    {
+        cout << "CANCELED: " << error << std::endl;
+    }
+    cout << "Recognized " << transcript.ShardCount << " shards in " << elapsed.count() << " ms." << std::endl;
+}
+
 // Speech recognition using a customized model.
 void SpeechRecognitionUsingCustomizedModel()
 {
@@ -262,38 +387,9 @@ void SpeechRecognitionUsingCustomizedModel()
 
 void SpeechContinuousRecognitionWithPullStream()
 {
-    // First, define your own pull audio input stream callback class that implements the
-    // PullAudioInputStreamCallback interface. The sample here illustrates how to define such
-    // a callback that reads audio data from a wav file.
-    // AudioInputFromFileCallback implements PullAudioInputStreamCallback interface, and uses a wav file as source
-    class AudioInputFromFileCallback final : public PullAudioInputStreamCallback
-    {
-    public:
-        // Constructor that creates an input stream from a file.
-        AudioInputFromFileCallback(const string& audioFileName)
-            : m_reader(audioFileName)
-        {
-        }
-
-        // Implements AudioInputStream::Read() which is called to get data from the audio stream.
-        // It copies data available in the stream to 'dataBuffer', but no more than 'size' bytes.
-        // If the data available is less than 'size' bytes, it is allowed to just return the amount of data that is currently available.
-        // If there is no data, this function must wait until data is available.
-        // It returns the number of bytes that have been copied in 'dataBuffer'.
-        // It returns 0 to indicate that the stream reaches end or is closed.
-        int Read(uint8_t* dataBuffer, uint32_t size) override
-        {
-            return m_reader.Read(dataBuffer, size);
-        }
-        // Implements AudioInputStream::Close() which is called when the stream needs to be closed.
-        void Close() override
-        {
-            m_reader.Close();
-        }
-
-    private:
-        WavFileReader m_reader;
-    };
+    // A pull stream gets its audio from a callback that implements the PullAudioInputStreamCallback interface.
+    // The callback here, ReadAheadAudioCallback in read_ahead_audio_callback.h, reads a wav file ahead on a
+    // background thread, so the audio thread of the SDK never waits for the disk.
 
     // Creates an instance of a speech config with specified subscription key and service region.
     // Replace with your own subscription key and service region (e.g., "westus").
@@ -301,38 +397,40 @@ void SpeechContinuousRecognitionWithPullStream()
 
     // Creates a callback that will read audio data from a WAV file.
     // Currently, the only supported WAV format is mono(single channel), 16 kHZ sample rate, 16 bits per sample.
+    // Other formats can be converted while streaming, see SpeechContinuousRecognitionWithFormatConversion().
     // Replace with your own audio file name.
-    auto callback = make_shared<AudioInputFromFileCallback>("whatstheweatherlike.wav");
+    auto callback = CreateReadAheadWavFileCallback("whatstheweatherlike.wav");
     auto pullStream = AudioInputStream::CreatePullStream(callback);
 
+    // Runs the event handlers on the shared event dispatch executor instead of the SDK callback thread,
+    // and ends the session on cancellation or session stop.
+    RecognitionSessionRunner session;
+
     // Creates a speech recognizer from stream input;
     auto audioInput = AudioConfig::FromStreamInput(pullStream);
     auto recognizer = SpeechRecognizer::FromConfig(config, audioInput);
 
-    // promise for synchronization of recognition end.
-    promise<void> recognitionEnd;
-
     // Subscribes to events.
-    recognizer->Recognizing.Connect([](const SpeechRecognitionEventArgs& e)
+    session.OnPartial(recognizer->Recognizing, [](const shared_ptr<SpeechRecognitionResult>& result)
     {
-        cout << "Recognizing:" << e.Result->Text << std::endl;
+        cout << "Recognizing:" << result->Text << std::endl;
     });
 
-    recognizer->Recognized.Connect([] (const SpeechRecognitionEventArgs& e)
+    session.OnFinal(recognizer->Recognized, [](const shared_ptr<SpeechRecognitionResult>& result)
     {
-        if (e.Result->Reason == ResultReason::RecognizedSpeech)
+        if (result->Reason == ResultReason::RecognizedSpeech)
         {
-            cout << "RECOGNIZED: Text=" << e.Result->Text << std::endl
-                 << "  Offset=" << e.Result->Offset() << std::endl
-                 << "  Duration=" << e.Result->Duration() << std::endl;
+            cout << "RECOGNIZED: Text=" << result->Text << std::endl
+                 << "  Offset=" << result->Offset() << std::endl
+                 << "  Duration=" << result->Duration() << std::endl;
         }
-        else if (e.Result->Reason == ResultReason::NoMatch)
+        else if (result->Reason == ResultReason::NoMatch)
         {
             cout << "NOMATCH: Speech could not be recognized." << std::endl;
         }
     });
 
-    recognizer->Canceled.Connect([&recognitionEnd](const SpeechRecognitionCanceledEventArgs& e)
+    session.OnCanceled(recognizer->Canceled, [](const RecognitionSessionRunner::CancellationInfo& e)
     {
         switch (e.Reason)
         {
@@ -343,7 +441,6 @@ void SpeechContinuousRecognitionWithPullStream()
         case CancellationReason::Error:
             cout << "CANCELED: ErrorCode=" << (int)e.ErrorCode << std::endl;
             cout << "CANCELED: ErrorDetails=" << e.ErrorDetails << std::endl;
-            recognitionEnd.set_value();
             break;
 
         default:
@@ -351,20 +448,223 @@ void SpeechContinuousRecognitionWithPullStream()
         }
     });
 
-    recognizer->SessionStopped.Connect([&recognitionEnd](const SessionEventArgs& e)
+    session.OnSessionStopped(recognizer->SessionStopped, []()
     {
         cout << "Session stopped.";
-        recognitionEnd.set_value(); // Notify to stop recognition.
     });
 
-    // Starts continuous recognition. Uses StopContinuousRecognitionAsync() to stop recognition.
-    recognizer->StartContinuousRecognitionAsync().wait();
+    // Starts continuous recognition, waits for the end of the session and stops recognition.
+    session.RunContinuous(*recognizer);
 
-    // Waits for recognition end.
-    recognitionEnd.get_future().wait();
+    auto statistics = callback->GetStatistics();
+    cout << "Audio reads: " << statistics.Reads << ", underruns: " << statistics.Underruns
+         << ", longest underrun: " << statistics.MaxUnderrunWait.count() << " us" << std::endl;
+}
 
-    // Stops recognition.
-    recognizer->StopContinuousRecognitionAsync().wait();
+// Speech continuous recognition using pull input stream, resuming from a checkpoint after errors.
+void SpeechContinuousRecognitionWithPullStreamAndResume()
+{
+    // Creates an instance of a speech config with specified subscription key and service region.
+    // Replace with your own subscription key and service region (e.g., "westus").
+    auto config = SpeechConfig::FromSubscription("YourSubscriptionKey", "YourServiceRegion");
+
+    // Replace with your own audio file name. The checkpoint is kept next to it.
+    const string audioFileName = "whatstheweatherlike.wav";
+    RecognitionCheckpoint checkpoint(audioFileName + ".checkpoint");
+
+    const int maxAttempts = 3;
+    for (int attempt = 1; attempt <= maxAttempts; attempt++)
+    {
+        // Reads the wav file from the checkpoint on. SeekToTime() tells where reading actually starts.
+        shared_ptr<PullCallback<WavFileReader>> callback;
+        uint64_t start = 0;
+        try
+        {
+            callback = make_shared<PullCallback<WavFileReader>>(audioFileName);
+            start = callback->GetSource().SeekToTime(checkpoint.Load());
+        }
+        catch (const exception& e)
+        {
+            cout << "Exit due to exception: " << e.what() << endl;
+            return;
+        }
+
+        // Offsets of the results are relative to the start of the stream, which is the resume position.
+        if (start > 0)
+        {
+            cout << "Resuming at " << start / 10000 << " ms." << std::endl;
+        }
+
+        bool failed = false;
+        RecognitionSessionRunner session;
+        auto pullStream = AudioInputStream::CreatePullStream(callback);
+        auto recognizer = SpeechRecognizer::FromConfig(config, AudioConfig::FromStreamInput(pullStream));
+
+        session.OnFinal(recognizer->Recognized, [&checkpoint, start](const shared_ptr<SpeechRecognitionResult>& result)
+        {
+            if (result->Reason == ResultReason::RecognizedSpeech)
+            {
+                cout << "RECOGNIZED: Text=" << result->Text << std::endl
+                     << "  Offset=" << start + result->Offset() << std::endl
+                     << "  Duration=" << result->Duration() << std::endl;
+            }
+            // NoMatch results cover audio that has been processed too.
+            checkpoint.Save(start + result->Offset() + result->Duration());
+        });
+
+        session.OnCanceled(recognizer->Canceled, [&failed](const RecognitionSessionRunner::CancellationInfo& e)
+        {
+            if (e.Reason == CancellationReason::Error)
+            {
+                cout << "CANCELED: ErrorCode=" << (int)e.ErrorCode << std::endl;
+                cout << "CANCELED: ErrorDetails=" << e.ErrorDetails << std::endl;
+                failed = true;
+            }
+        });
+
+        session.OnSessionStopped(recognizer->SessionStopped);
+        session.RunContinuous(*recognizer);
+
+        if (!failed)
+        {
+            // Done, the next run starts from the beginning again.
+            checkpoint.Clear();
+            cout << "Recognition completed." << std::endl;
+            return;
+        }
+    }
+    cout << "Recognition failed " << maxAttempts << " times, run again to resume from the checkpoint." << std::endl;
+}
+
+// Speech continuous recognition from a wav file in any PCM format, converted to 16 kHz mono while streaming.
+void SpeechContinuousRecognitionWithFormatConversion()
+{
+    // Creates an instance of a speech config with specified subscription key and service region.
+    // Replace with your own subscription key and service region (e.g., "westus").
+    auto config = SpeechConfig::FromSubscription("YourSubscriptionKey", "YourServiceRegion");
+
+    // The file is recorded at 44.1 kHz. ConvertingWavFileReader in audio_format_converter.h downmixes, resamples
+    // and requantizes it to 16 kHz, 16-bit mono on the read-ahead thread, so no separate conversion pass is needed.
+    // Replace with your own audio file name.
+    unique_ptr<ConvertingWavFileReader> reader;
+    try
+    {
+        reader.reset(new ConvertingWavFileReader("en-us_zh-cn.wav"));
+    }
+    catch (const exception& e)
+    {
+        cout << "Cannot convert the audio file: " << e.what() << std::endl;
+        return;
+    }
+    const auto& inputFormat = reader->GetInputFormat();
+    cout << "Converting " << inputFormat.SamplesPerSec << " Hz, " << inputFormat.BitsPerSample << "-bit audio with "
+         << inputFormat.Channels << " channel(s) to 16 kHz, 16-bit mono." << std::endl;
+
+    auto bufferSize = AudioChunkPool::ChunkSizeFor(reader->GetFormat());
+    auto callback = make_shared<ReadAheadAudioCallback<ConvertingWavFileReader>>(std::move(reader), bufferSize);
+    auto pullStream = AudioInputStream::CreatePullStream(AudioStreamFormat::GetWaveFormatPCM(16000, 16, 1), callback);
+
+    RecognitionSessionRunner session;
+    auto recognizer = SpeechRecognizer::FromConfig(config, AudioConfig::FromStreamInput(pullStream));
+
+    // The converter keeps the timeline of the file, so offsets refer to the original audio.
+    session.OnFinal(recognizer->Recognized, [](const shared_ptr<SpeechRecognitionResult>& result)
+    {
+        if (result->Reason == ResultReason::RecognizedSpeech)
+        {
+            cout << "RECOGNIZED: Text=" << result->Text << std::endl
+                 << "  Offset=" << result->Offset() << std::endl
+                 << "  Duration=" << result->Duration() << std::endl;
+        }
+        else if (result->Reason == ResultReason::NoMatch)
+        {
+            cout << "NOMATCH: Speech could not be recognized." << std::endl;
+        }
+    });
+
+    session.OnCanceled(recognizer->Canceled, [](const RecognitionSessionRunner::CancellationInfo& e)
+    {
+        if (e.Reason == CancellationReason::Error)
+        {
+            cout << "CANCELED: ErrorCode=" << (int)e.ErrorCode << std::endl;
+            cout << "CANCELED: ErrorDetails=" << e.ErrorDetails << std::endl;
+        }
+    });
+
+    session.OnSessionStopped(recognizer->SessionStopped, []()
+    {
+        cout << "Session stopped." << std::endl;
+    });
+
+    session.RunContinuous(*recognizer);
+}
+
+// Speech continuous recognition using a push stream of Opus compressed audio, encoded on the client.
+void SpeechContinuousRecognitionWithOpusPushStream()
+{
+#if defined(SPEECH_SAMPLES_WITH_OPUS)
+    // Creates an instance of a speech config with specified subscription key and service region.
+    // Replace with your own subscription key and service region (e.g., "westus").
+    auto config = SpeechConfig::FromSubscription("YourSubscriptionKey", "YourServiceRegion");
+
+    // Replace with your own audio file name.
+    WavFileReader reader("whatstheweatherlike.wav");
+
+    // The push stream takes OGG/Opus instead of PCM. The SDK decodes it with GStreamer, see
+    // https://docs.microsoft.com/azure/cognitive-services/speech-service/how-to-use-codec-compressed-audio-input-streams
+    auto pushStream = AudioInputStream::CreatePushStream(AudioStreamFormat::GetCompressedFormat(AudioStreamContainerFormat::OGG_OPUS));
+
+    RecognitionSessionRunner session;
+    auto recognizer = SpeechRecognizer::FromConfig(config, AudioConfig::FromStreamInput(pushStream));
+
+    session.OnFinal(recognizer->Recognized, [](const shared_ptr<SpeechRecognitionResult>& result)
+    {
+        if (result->Reason == ResultReason::RecognizedSpeech)
+        {
+            cout << "RECOGNIZED: Text=" << result->Text << std::endl;
+        }
+        else if (result->Reason == ResultReason::NoMatch)
+        {
+            cout << "NOMATCH: Speech could not be recognized." << std::endl;
+        }
+    });
+
+    session.OnCanceled(recognizer->Canceled, [](const RecognitionSessionRunner::CancellationInfo& e)
+    {
+        if (e.Reason == CancellationReason::Error)
+        {
+            cout << "CANCELED: ErrorCode=" << (int)e.ErrorCode << std::endl;
+            cout << "CANCELED: ErrorDetails=" << e.ErrorDetails << std::endl;
+        }
+    });
+
+    session.OnSessionStopped(recognizer->SessionStopped, []()
+    {
+        cout << "Session stopped." << std::endl;
+    });
+
+    // Starts continuous recognition, then pushes the file through the encoder. The encoder writes the
+    // compressed pages to the push stream on its own thread, and closes the stream at the end.
+    recognizer->StartContinuousRecognitionAsync().get();
+
+    OpusPushStreamEncoder encoder(pushStream, reader.GetFormat());
+    AudioChunkPool pool(reader.GetFormat());
+    auto buffer = pool.Acquire();
+    int readBytes = 0;
+    while ((readBytes = reader.Read(buffer->data(), (uint32_t)buffer->size())) != 0)
+    {
+        encoder.Write(buffer->data(), (uint32_t)readBytes);
+    }
+    encoder.Close();
+
+    session.Wait();
+    recognizer->StopContinuousRecognitionAsync().get();
+
+    auto statistics = encoder.GetStatistics();
+    cout << "Pushed " << statistics.EncodedBytes << " bytes of Opus for " << statistics.PcmBytes << " bytes of PCM." << std::endl;
+#else
+    cout << "This sample needs libopus, build the samples with SPEECH_SAMPLES_WITH_OPUS defined." << std::endl;
+#endif
 }
 
 void SpeechContinuousRecognitionWithPushStream()
@@ -373,12 +673,25 @@ void SpeechContinuousRecognitionWithPushStream()
     // Replace with your own subscription key and service region (e.g., "westus").
     auto config = SpeechConfig::FromSubscription("YourSubscriptionKey", "YourServiceRegion");
 
+    // Maps the file into memory, so the audio data can be pushed without copying it into an intermediate buffer.
+    MappedWavFileReader reader("whatstheweatherlike.wav");
+
+    // Measures recognition latency, relative to when the audio was pushed.
+    RecognitionLatencyTracker latencyTracker(reader.GetFormat().AvgBytesPerSec);
+
+    // Set to true to drop long silences before the audio is pushed. Offsets of the results then refer to the
+    // audio pushed, and are mapped back to the file with MapToOriginal(). Off by default, so the whole file is
+    // pushed as before.
+    const bool skipSilence = false;
+    SilenceSkipper silenceSkipper(reader.GetFormat());
+
     // Creates a push stream
     auto pushStream = AudioInputStream::CreatePushStream();
 
     // Creates a speech recognizer from stream input;
     auto audioInput = AudioConfig::FromStreamInput(pushStream);
     auto recognizer = SpeechRecognizer::FromConfig(config, audioInput);
+    latencyTracker.Attach(recognizer);
 
     // promise for synchronization of recognition end.
     promise<void> recognitionEnd;
@@ -389,12 +702,12 @@ void SpeechContinuousRecognitionWithPushStream()
         cout << "Recognizing:" << e.Result->Text << std::endl;
     });
 
-    recognizer->Recognized.Connect([](const SpeechRecognitionEventArgs& e)
+    recognizer->Recognized.Connect([&silenceSkipper](const SpeechRecognitionEventArgs& e)
     {
         if (e.Result->Reason == ResultReason::RecognizedSpeech)
         {
             cout << "RECOGNIZED: Text=" << e.Result->Text << std::endl
-                << "  Offset=" << e.Result->Offset() << std::endl
+                << "  Offset=" << silenceSkipper.MapToOriginal(e.Result->Offset()) << std::endl
                 << "  Duration=" << e.Result->Duration() << std::endl;
         }
         else if (e.Result->Reason == ResultReason::NoMatch)
@@ -429,19 +742,36 @@ void SpeechContinuousRecognitionWithPushStream()
         recognitionEnd.set_value(); // Notify to stop recognition.
     });
 
-    WavFileReader reader("whatstheweatherlike.wav");
-
-    vector<uint8_t> buffer(1000);
-
     // Starts continuous recognition. Uses StopContinuousRecognitionAsync() to stop recognition.
     recognizer->StartContinuousRecognitionAsync().wait();
 
-    // Read data and push them into the stream
-    int readSamples = 0;
-    while((readSamples = reader.Read(buffer.data(), (uint32_t)buffer.size())) != 0)
+    // Push slices of 100 ms of audio, aligned to whole frames, into the stream
+    auto chunkSize = AudioChunkPool::ChunkSizeFor(reader.GetFormat());
+    const uint8_t* slice = nullptr;
+    uint32_t sliceSize = 0;
+    auto write = [&](const uint8_t* data, uint32_t size)
     {
-        // Push a buffer into the stream
-        pushStream->Write(buffer.data(), readSamples);
+        // Write() does not modify the buffer, it only takes a non-const pointer.
+        pushStream->Write(const_cast<uint8_t*>(data), size);
+        latencyTracker.OnAudioPushed(size);
+    };
+    while ((sliceSize = reader.Next(&slice, chunkSize)) != 0)
+    {
+        if (skipSilence)
+        {
+            silenceSkipper.Process(slice, sliceSize, write);
+        }
+        else
+        {
+            write(slice, sliceSize);
+        }
+    }
+    if (skipSilence)
+    {
+        silenceSkipper.Flush(write);
+        auto statistics = silenceSkipper.GetStatistics();
+        cout << "Pushed " << statistics.BytesSent << " of " << statistics.BytesIn << " bytes, skipped "
+             << statistics.SkippedSilences << " silences." << std::endl;
     }
 
     // Close the push stream.
@@ -452,43 +782,233 @@ void SpeechContinuousRecognitionWithPushStream()
 
     // Stops recognition.
     recognizer->StopContinuousRecognitionAsync().get();
+
+    latencyTracker.Report(cout);
 }
 
-// Keyword-triggered speech recognition using microphone.
-void KeywordTriggeredSpeechRecognitionWithMicrophone()
+// Speech recognition using push stream input, fed at a configurable pace to mimic a live audio source.
+void SpeechContinuousRecognitionWithPacedPushStream()
 {
+    cout << "Enter the feed speed (1 for real time, N for N times real time, 0 for unthrottled; empty for 1): ";
+    string input;
+    getline(cin, input);
+    double speed = 1.0;
+    try
+    {
+        speed = input.empty() ? 1.0 : stod(input);
+    }
+    catch (const exception&)
+    {
+        cout << "Invalid speed, using real time." << std::endl;
+    }
+
     // Creates an instance of a speech config with specified subscription key and service region.
     // Replace with your own subscription key and service region (e.g., "westus").
     auto config = SpeechConfig::FromSubscription("YourSubscriptionKey", "YourServiceRegion");
 
-    // Creates a speech recognizer using microphone as audio input. The default language is "en-us".
-    auto recognizer = SpeechRecognizer::FromConfig(config);
+    MappedWavFileReader reader("whatstheweatherlike.wav");
 
-    // Promise for synchronization of recognition end.
+    // Measures recognition latency, relative to when the audio was pushed.
+    RecognitionLatencyTracker latencyTracker(reader.GetFormat().AvgBytesPerSec);
+
+    // Creates a push stream
+    auto pushStream = AudioInputStream::CreatePushStream();
+    PacedPushWriter writer(pushStream, reader.GetFormat(), speed);
+
+    // Creates a speech recognizer from stream input;
+    auto audioInput = AudioConfig::FromStreamInput(pushStream);
+    auto recognizer = SpeechRecognizer::FromConfig(config, audioInput);
+    latencyTracker.Attach(recognizer);
+
+    // promise for synchronization of recognition end.
     promise<void> recognitionEnd;
 
+    // Measures the time from the first audio write to the first partial result.
+    once_flag firstPartial;
+
     // Subscribes to events.
-    recognizer->Recognizing.Connect([] (const SpeechRecognitionEventArgs& e)
+    recognizer->Recognizing.Connect([&writer, &firstPartial](const SpeechRecognitionEventArgs& e)
     {
-        if (e.Result->Reason == ResultReason::RecognizingSpeech)
-        {
-            cout << "RECOGNIZING: Text=" << e.Result->Text << std::endl;
-        }
-        else if (e.Result->Reason == ResultReason::RecognizingKeyword)
+        call_once(firstPartial, [&writer]
         {
-            cout << "RECOGNIZING KEYWORD: Text=" << e.Result->Text << std::endl;
-        }
+            auto latency = chrono::duration_cast<chrono::milliseconds>(PacedPushWriter::Clock::now() - writer.StartTime());
+            cout << "First partial result after " << latency.count() << " ms." << std::endl;
+        });
+        cout << "Recognizing:" << e.Result->Text << std::endl;
     });
 
-    recognizer->Recognized.Connect([] (const SpeechRecognitionEventArgs& e)
+    recognizer->Recognized.Connect([](const SpeechRecognitionEventArgs& e)
     {
-        if (e.Result->Reason == ResultReason::RecognizedKeyword)
+        if (e.Result->Reason == ResultReason::RecognizedSpeech)
         {
-            cout << "RECOGNIZED KEYWORD: Text=" << e.Result->Text << std::endl;
+            cout << "RECOGNIZED: Text=" << e.Result->Text << std::endl
+                << "  Offset=" << e.Result->Offset() << std::endl
+                << "  Duration=" << e.Result->Duration() << std::endl;
         }
-        else if (e.Result->Reason == ResultReason::RecognizedSpeech)
+        else if (e.Result->Reason == ResultReason::NoMatch)
         {
-            cout << "RECOGNIZED: Text=" << e.Result->Text << std::endl;
+            cout << "NOMATCH: Speech could not be recognized." << std::endl;
+        }
+    });
+
+    // Both Canceled and SessionStopped can signal the end, only the first one completes the promise.
+    once_flag recognitionEndSignaled;
+
+    recognizer->Canceled.Connect([&recognitionEnd, &recognitionEndSignaled](const SpeechRecognitionCanceledEventArgs& e)
+    {
+        cout << "CANCELED: Reason=" << (int)e.Reason << std::endl;
+
+        if (e.Reason == CancellationReason::Error)
+        {
+            cout << "CANCELED: ErrorCode=" << (int)e.ErrorCode << "\n"
+                 << "CANCELED: ErrorDetails=" << e.ErrorDetails << "\n"
+                 << "CANCELED: Did you update the subscription info?" << std::endl;
+
+            call_once(recognitionEndSignaled, [&recognitionEnd] { recognitionEnd.set_value(); }); // Notify to stop recognition.
+        }
+    });
+
+    recognizer->SessionStopped.Connect([&recognitionEnd, &recognitionEndSignaled](const SessionEventArgs& e)
+    {
+        cout << "Session stopped." << std::endl;
+        call_once(recognitionEndSignaled, [&recognitionEnd] { recognitionEnd.set_value(); }); // Notify to stop recognition.
+    });
+
+    // Starts continuous recognition. Uses StopContinuousRecognitionAsync() to stop recognition.
+    recognizer->StartContinuousRecognitionAsync().wait();
+
+    // Push slices of 100 ms of audio into the stream, each one when it is due.
+    auto chunkSize = AudioChunkPool::ChunkSizeFor(reader.GetFormat());
+    const uint8_t* slice = nullptr;
+    uint32_t sliceSize = 0;
+    while ((sliceSize = reader.Next(&slice, chunkSize)) != 0)
+    {
+        writer.Write(slice, sliceSize);
+        latencyTracker.OnAudioPushed(sliceSize);
+    }
+
+    // Close the push stream.
+    pushStream->Close();
+    writer.PrintStatistics(cout);
+
+    // Waits for recognition end.
+    recognitionEnd.get_future().get();
+
+    // Stops recognition.
+    recognizer->StopContinuousRecognitionAsync().get();
+
+    latencyTracker.Report(cout);
+}
+
+// Speech continuous recognition of the channels of a multi-channel file, with one recognizer per channel.
+void SpeechContinuousRecognitionPerChannelWithPullStream()
+{
+    // Creates an instance of a speech config with specified subscription key and service region.
+    // Replace with your own subscription key and service region (e.g., "westus").
+    auto config = SpeechConfig::FromSubscription("YourSubscriptionKey", "YourServiceRegion");
+
+    // The file is read once and split into mono streams, one per channel.
+    // Replace with your own audio file name and channels, e.g. a stereo call center recording with the agent
+    // on channel 0 and the customer on channel 1. The file must hold 16-bit PCM audio.
+    shared_ptr<MultiChannelWavSplitter> splitter;
+    try
+    {
+        splitter = MultiChannelWavSplitter::Open("katiesteve.wav", { 0, 1 });
+    }
+    catch (const exception& e)
+    {
+        cout << "Exit due to exception: " << e.what() << endl;
+        return;
+    }
+
+    // One session per channel. They are created before the recognizers, so they outlive the recognizer callbacks.
+    vector<unique_ptr<RecognitionSessionRunner>> sessions;
+    vector<shared_ptr<SpeechRecognizer>> recognizers;
+    for (size_t i = 0; i < splitter->GetStreamCount(); i++)
+    {
+        sessions.push_back(make_unique<RecognitionSessionRunner>());
+    }
+
+    for (size_t i = 0; i < splitter->GetStreamCount(); i++)
+    {
+        auto channel = splitter->GetChannel(i);
+        auto pullStream = AudioInputStream::CreatePullStream(splitter->GetStreamFormat(), splitter->GetStreamCallback(i));
+        auto recognizer = SpeechRecognizer::FromConfig(config, AudioConfig::FromStreamInput(pullStream));
+        auto& session = *sessions[i];
+
+        session.OnFinal(recognizer->Recognized, [channel](const shared_ptr<SpeechRecognitionResult>& result)
+        {
+            if (result->Reason == ResultReason::RecognizedSpeech)
+            {
+                cout << "[channel " << channel << "] RECOGNIZED: Text=" << result->Text << std::endl
+                     << "  Offset=" << result->Offset() << std::endl;
+            }
+        });
+
+        session.OnCanceled(recognizer->Canceled, [channel](const RecognitionSessionRunner::CancellationInfo& e)
+        {
+            if (e.Reason == CancellationReason::Error)
+            {
+                cout << "[channel " << channel << "] CANCELED: ErrorCode=" << (int)e.ErrorCode << std::endl;
+                cout << "[channel " << channel << "] CANCELED: ErrorDetails=" << e.ErrorDetails << std::endl;
+            }
+        });
+
+        session.OnSessionStopped(recognizer->SessionStopped);
+        recognizers.push_back(recognizer);
+    }
+
+    // All channels are recognized in parallel.
+    for (auto& recognizer : recognizers)
+    {
+        recognizer->StartContinuousRecognitionAsync().get();
+    }
+    for (auto& session : sessions)
+    {
+        session->Wait();
+    }
+    for (auto& recognizer : recognizers)
+    {
+        recognizer->StopContinuousRecognitionAsync().get();
+    }
+    cout << "Recognized " << recognizers.size() << " channels." << std::endl;
+}
+
+// Keyword-triggered speech recognition using microphone.
+void KeywordTriggeredSpeechRecognitionWithMicrophone()
+{
+    // Creates an instance of a speech config with specified subscription key and service region.
+    // Replace with your own subscription key and service region (e.g., "westus").
+    auto config = SpeechConfig::FromSubscription("YourSubscriptionKey", "YourServiceRegion");
+
+    // Creates a speech recognizer using microphone as audio input. The default language is "en-us".
+    auto recognizer = SpeechRecognizer::FromConfig(config);
+
+    // Promise for synchronization of recognition end.
+    promise<void> recognitionEnd;
+
+    // Subscribes to events.
+    recognizer->Recognizing.Connect([] (const SpeechRecognitionEventArgs& e)
+    {
+        if (e.Result->Reason == ResultReason::RecognizingSpeech)
+        {
+            cout << "RECOGNIZING: Text=" << e.Result->Text << std::endl;
+        }
+        else if (e.Result->Reason == ResultReason::RecognizingKeyword)
+        {
+            cout << "RECOGNIZING KEYWORD: Text=" << e.Result->Text << std::endl;
+        }
+    });
+
+    recognizer->Recognized.Connect([] (const SpeechRecognitionEventArgs& e)
+    {
+        if (e.Result->Reason == ResultReason::RecognizedKeyword)
+        {
+            cout << "RECOGNIZED KEYWORD: Text=" << e.Result->Text << std::endl;
+        }
+        else if (e.Result->Reason == ResultReason::RecognizedSpeech)
+        {
+            cout << "RECOGNIZED: Text=" << e.Result->Text << std::endl;
         }
         else if (e.Result->Reason == ResultReason::NoMatch)
         {
@@ -540,6 +1060,64 @@ void KeywordTriggeredSpeechRecognitionWithMicrophone()
     recognizer->StopKeywordRecognitionAsync().get();
 }
 
+// Resident memory per extra always-on keyword stream, with one shared keyword model and with a model loaded per stream.
+void KeywordRecognitionMemoryPerStream()
+{
+    // Creates an instance of a speech config with specified subscription key and service region.
+    // Replace with your own subscription key and service region (e.g., "westus").
+    auto config = SpeechConfig::FromSubscription("YourSubscriptionKey", "YourServiceRegion");
+
+    // Update this to point to the location of your keyword recognition model.
+    const string modelFile = "YourKeywordRecognitionModelFile.table";
+    const size_t streamCount = 64;
+
+    for (bool shared : { true, false })
+    {
+        cout << (shared ? "Shared keyword model:" : "Keyword model loaded per stream:") << endl;
+
+        // The streams stay idle; push streams without data keep them waiting for the keyword like a quiet room.
+        // The models are held as long as the streams run, in both passes.
+        vector<shared_ptr<KeywordRecognitionModel>> models;
+        vector<shared_ptr<PushAudioInputStream>> streams;
+        vector<shared_ptr<SpeechRecognizer>> recognizers;
+        uint64_t firstStreamBytes = 0;
+        for (size_t count = 1; count <= streamCount; count++)
+        {
+            models.push_back(shared ? KeywordModelCache::Get(modelFile) : KeywordRecognitionModel::FromFile(modelFile));
+            auto model = models.back();
+            streams.push_back(AudioInputStream::CreatePushStream());
+            recognizers.push_back(SpeechRecognizer::FromConfig(config, AudioConfig::FromStreamInput(streams.back())));
+            recognizers.back()->StartKeywordRecognitionAsync(model).get();
+
+            // Reports at 1, 2, 4, ... streams, after giving the recognizers a moment to settle.
+            if ((count & (count - 1)) == 0)
+            {
+                this_thread::sleep_for(chrono::milliseconds(500));
+                auto residentBytes = GetResidentSetSize();
+                if (count == 1)
+                {
+                    firstStreamBytes = residentBytes;
+                }
+                cout << "  " << count << " streams: resident " << residentBytes / 1024 << " KB";
+                if (count > 1)
+                {
+                    cout << ", " << (int64_t)(residentBytes - firstStreamBytes) / (int64_t)(count - 1) / 1024 << " KB per extra stream";
+                }
+                cout << endl;
+            }
+        }
+
+        for (auto& recognizer : recognizers)
+        {
+            recognizer->StopKeywordRecognitionAsync().get();
+        }
+        if (shared)
+        {
+            KeywordModelCache::Unload(modelFile);
+        }
+    }
+}
+
 // Speech recognition with auto detection for source language
 void SpeechRecognitionWithSourceLanguageAutoDetection()
 {
@@ -600,6 +1178,70 @@ void SpeechRecognitionWithSourceLanguageAutoDetection()
     }
 }
 
+// Speech recognition with the source language remembered per caller: once a caller's language is confirmed,
+// their sessions start with that language and skip language identification.
+void SpeechRecognitionWithCachedSourceLanguage()
+{
+    // Creates an instance of a speech config with specified subscription key and service region.
+    // Replace with your own subscription key and service region (e.g., "westus").
+    auto speechConfig = SpeechConfig::FromSubscription("YourSubscriptionKey", "YourServiceRegion");
+
+    // The confidence of detailed results tells whether a session committed to a language heard that language.
+    speechConfig->SetOutputFormat(OutputFormat::Detailed);
+
+    // Replace the languages with your languages in BCP-47 format, e.g. fr-FR.
+    auto autoDetectSourceLanguageConfig = AutoDetectSourceLanguageConfig::FromLanguages({ "en-US", "de-DE" });
+
+    // One cache for all sessions of the process, keyed by caller, e.g. the phone number or the user id.
+    LanguageDecisionCache cache;
+
+    // Replace with the calls of your callers; here one caller calls a few times.
+    const string caller = "caller-0001";
+    const string audioFile = "whatstheweatherlike.wav";
+
+    for (int call = 0; call < 4; call++)
+    {
+        auto started = chrono::steady_clock::now();
+        auto session = cache.CreateRecognizer(caller, speechConfig, autoDetectSourceLanguageConfig, AudioConfig::FromWavFileInput(audioFile));
+        auto result = session.Recognizer->RecognizeOnceAsync().get();
+
+        if (!cache.Complete(caller, session, result))
+        {
+            // The committed language did not fit; the caller is back on auto-detect, so this recognizes with it.
+            cout << "Call " << call << ": the result does not match " << session.CommittedLanguage << ", recognizing again." << std::endl;
+            session = cache.CreateRecognizer(caller, speechConfig, autoDetectSourceLanguageConfig, AudioConfig::FromWavFileInput(audioFile));
+            result = session.Recognizer->RecognizeOnceAsync().get();
+            cache.Complete(caller, session, result);
+        }
+        auto elapsed = chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - started);
+
+        if (result->Reason == ResultReason::RecognizedSpeech)
+        {
+            cout << "Call " << call << " (" << (session.CommittedLanguage.empty() ? "auto-detect" : session.CommittedLanguage) << ", "
+                 << elapsed.count() << " ms): Text=" << result->Text << std::endl;
+        }
+        else if (result->Reason == ResultReason::NoMatch)
+        {
+            cout << "Call " << call << ": NOMATCH: Speech could not be recognized." << std::endl;
+        }
+        else if (result->Reason == ResultReason::Canceled)
+        {
+            auto cancellation = CancellationDetails::FromResult(result);
+            cout << "CANCELED: Reason=" << (int)cancellation->Reason << std::endl;
+            if (cancellation->Reason == CancellationReason::Error)
+            {
+                cout << "CANCELED: ErrorCode=" << (int)cancellation->ErrorCode << std::endl;
+                cout << "CANCELED: ErrorDetails=" << cancellation->ErrorDetails << std::endl;
+            }
+            break;
+        }
+    }
+
+    auto statistics = cache.GetStatistics();
+    cout << "Sessions with a committed language: " << statistics.CommittedSessions << ", with auto-detect: "
+         << statistics.AutoDetectSessions << ", disagreements: " << statistics.Disagreements << std::endl;
+}
+
 // Speech recognition with auto detection for source language and using customized model
 void SpeechRecognitionWithSourceLanguageAutoDetectionUsingCustomizedModel()
 {
@@ -740,6 +1382,38 @@ void PronunciationAssessmentWithMicrophone()
     }
 }
 
+// Pronunciation assessment of a batch of (audio, reference text) pairs, with word and phoneme scores
+// written to a columnar file.
+void PronunciationAssessmentBatchFromManifest()
+{
+    // Creates an instance of a speech config with specified subscription key and service region.
+    // Replace with your own subscription key and service region (e.g., "westus").
+    // Note: The pronunciation assessment feature is currently only available on en-US language.
+    auto config = SpeechConfig::FromSubscription("YourSubscriptionKey", "YourServiceRegion");
+    config->SetProperty(PropertyId::SpeechServiceConnection_EndSilenceTimeoutMs, "3000");
+
+    // Each line of the manifest is "<wav file>\t<reference text>", e.g. "whatstheweatherlike.wav\tWhat's the weather like?".
+    ifstream manifest("pronunciation_manifest.tsv");
+    if (!manifest)
+    {
+        cout << "Cannot open pronunciation_manifest.tsv." << endl;
+        return;
+    }
+    auto items = PronunciationBatchScorer::LoadManifest(manifest);
+
+    PronunciationColumnWriter details("pronunciation_scores.pacf");
+    ofstream summary("pronunciation_summary.tsv");
+
+    PronunciationBatchScorer::Settings settings;
+    settings.MaxConcurrent = 4;
+    PronunciationBatchScorer scorer(config, settings);
+    auto statistics = scorer.Run(items, details, summary);
+
+    cout << "Scored " << statistics.Scored << " items (" << statistics.Phonemes << " phonemes), " << statistics.NoSpeech
+        << " without speech, " << statistics.Failed << " failed." << endl;
+    cout << "Item scores are in pronunciation_summary.tsv, word and phoneme scores in pronunciation_scores.pacf." << endl;
+}
+
 #pragma region Language Detection related samples
 
 void SpeechRecognitionAndLanguageIdWithMicrophone()
@@ -1067,38 +1741,7 @@ void SpeechContinuousRecognitionFromMultiChannelFileWithMASEnabledAndCustomGeome
 // Speech recognition from pull stream with custom set of enhancements from Microsoft Audio Stack enabled.
 void SpeechRecognitionFromPullStreamWithSelectMASEnhancementsEnabled()
 {
-    // First, define your own pull audio input stream callback class that implements the
-    // PullAudioInputStreamCallback interface. The sample here illustrates how to define such
-    // a callback that reads audio data from a wav file.
-    // AudioInputFromFileCallback implements PullAudioInputStreamCallback interface, and uses a wav file as source
-    class AudioInputFromFileCallback final : public PullAudioInputStreamCallback
-    {
-    public:
-        // Constructor that creates an input stream from a file.
-        AudioInputFromFileCallback(const string& audioFileName)
-            : m_reader(audioFileName)
-        {
-        }
-
-        // Implements AudioInputStream::Read() which is called to get data from the audio stream.
-        // It copies data available in the stream to 'dataBuffer', but no more than 'size' bytes.
-        // If the data available is less than 'size' bytes, it is allowed to just return the amount of data that is currently available.
-        // If there is no data, this function must wait until data is available.
-        // It returns the number of bytes that have been copied in 'dataBuffer'.
-        // It returns 0 to indicate that the stream reaches end or is closed.
-        int Read(uint8_t* dataBuffer, uint32_t size) override
-        {
-            return m_reader.Read(dataBuffer, size);
-        }
-        // Implements AudioInputStream::Close() which is called when the stream needs to be closed.
-        void Close() override
-        {
-            m_reader.Close();
-        }
-
-    private:
-        WavFileReader m_reader;
-    };
+    // Reads the wav file ahead with ReadAheadAudioCallback, see SpeechContinuousRecognitionWithPullStream().
 
     // Creates an instance of a speech config with specified subscription key and service region.
     // Replace with your own subscription key and service region (e.g., "westus").
@@ -1109,7 +1752,7 @@ void SpeechRecognitionFromPullStreamWithSelectMASEnhancementsEnabled()
     // formats are supported: 32-bit IEEE little endian float, 32-bit little endian signed int, 24-bit little endian signed int,
     // 16-bit little endian signed int, and 8-bit signed int.
     // Replace with your own audio file name.
-    auto callback = make_shared<AudioInputFromFileCallback>("whatstheweatherlike.wav");
+    auto callback = CreateReadAheadWavFileCallback("whatstheweatherlike.wav");
     auto pullStream = AudioInputStream::CreatePullStream(callback);
 
     // Creates an instance of audio config with pull stream as audio input and with audio processing options specified.
@@ -1228,17 +1871,19 @@ void SpeechContinuousRecognitionFromPushStreamWithMASEnabledAndBeamformingAngles
 
     WavFileReader reader("katiesteve.wav");
 
-    vector<uint8_t> buffer(1024);
+    // Takes a buffer holding 100 ms of audio, so that samples of the 8 channels are never split across writes.
+    AudioChunkPool pool(reader.GetFormat());
+    auto buffer = pool.Acquire();
 
     // Starts continuous recognition. Uses StopContinuousRecognitionAsync() to stop recognition.
     recognizer->StartContinuousRecognitionAsync().wait();
 
     // Read data and push them into the stream
     int readSamples = 0;
-    while((readSamples = reader.Read(buffer.data(), (uint32_t)buffer.size())) != 0)
+    while((readSamples = reader.Read(buffer->data(), (uint32_t)buffer->size())) != 0)
     {
         // Push a buffer into the stream
-        pushStream->Write(buffer.data(), readSamples);
+        pushStream->Write(buffer->data(), readSamples);
     }
 
     // Close the push stream.
@@ -1250,3 +1895,593 @@ void SpeechContinuousRecognitionFromPushStreamWithMASEnabledAndBeamformingAngles
     // Stops recognition.
     recognizer->StopContinuousRecognitionAsync().get();
 }
+
+// Speech continuous recognition with OpenMetrics counters and histograms served over HTTP, e.g. for Prometheus.
+void SpeechContinuousRecognitionWithMetrics()
+{
+    // Creates an instance of a speech config with specified subscription key and service region.
+    // Replace with your own subscription key and service region (e.g., "westus").
+    auto config = SpeechConfig::FromSubscription("YourSubscriptionKey", "YourServiceRegion");
+
+    // The metrics outlive the recognizer and the endpoint. While the sample runs, see http://localhost:9464/metrics.
+    SpeechMetrics metrics;
+    unique_ptr<MetricsHttpEndpoint> endpoint;
+    try
+    {
+        endpoint.reset(new MetricsHttpEndpoint(9464, [&metrics](std::ostream& out) { metrics.Write(out); }));
+    }
+    catch (const exception& e)
+    {
+        cout << e.what() << " The metrics are printed at the end only." << std::endl;
+    }
+
+    // Replace with your own audio file name. The counting callback adds the audio read to the bytes in.
+    auto callback = make_shared<CountingPullCallback>(CreateReadAheadWavFileCallback("whatstheweatherlike.wav"), metrics);
+    auto pullStream = AudioInputStream::CreatePullStream(AudioStreamFormat::GetWaveFormatPCM(16000, 16, 1), callback);
+
+    RecognitionSessionRunner session;
+    auto recognizer = SpeechRecognizer::FromConfig(config, AudioConfig::FromStreamInput(pullStream));
+    metrics.Attach(recognizer);
+
+    session.OnFinal(recognizer->Recognized, [](const shared_ptr<SpeechRecognitionResult>& result)
+    {
+        if (result->Reason == ResultReason::RecognizedSpeech)
+        {
+            cout << "RECOGNIZED: Text=" << result->Text << std::endl;
+        }
+    });
+
+    session.OnCanceled(recognizer->Canceled, [](const RecognitionSessionRunner::CancellationInfo& e)
+    {
+        if (e.Reason == CancellationReason::Error)
+        {
+            cout << "CANCELED: ErrorCode=" << (int)e.ErrorCode << std::endl;
+            cout << "CANCELED: ErrorDetails=" << e.ErrorDetails << std::endl;
+        }
+    });
+
+    session.RunContinuous(*recognizer);
+
+    cout << "Metrics:" << std::endl;
+    metrics.Write(cout);
+}
+
+// Speech continuous recognition with the final results and their word timings persisted to a transcript store,
+// an append-only columnar file for search indexing.
+void SpeechContinuousRecognitionToTranscriptStore()
+{
+    // Creates an instance of a speech config with specified subscription key and service region.
+    // Replace with your own subscription key and service region (e.g., "westus").
+    auto config = SpeechConfig::FromSubscription("YourSubscriptionKey", "YourServiceRegion");
+
+    // The store keeps the words of the finals, their timings are only in the results when requested.
+    config->RequestWordLevelTimestamps();
+
+    // Replace with your own audio file name and the id of the call it holds.
+    const string audioFile = "whatstheweatherlike.wav";
+    const string callId = "call-0001";
+    const string storeFile = "transcripts.tsg";
+
+    {
+        unique_ptr<TranscriptStoreWriter> store;
+        try
+        {
+            store = make_unique<TranscriptStoreWriter>(storeFile);
+        }
+        catch (const exception& e)
+        {
+            cout << e.what() << std::endl;
+            return;
+        }
+
+        RecognitionSessionRunner session;
+        auto recognizer = SpeechRecognizer::FromConfig(config, AudioConfig::FromWavFileInput(audioFile));
+
+        // Append() only copies the result into memory; the store writes it from its own thread.
+        session.OnFinal(recognizer->Recognized, [&store, &callId](const shared_ptr<SpeechRecognitionResult>& result)
+        {
+            if (result->Reason == ResultReason::RecognizedSpeech)
+            {
+                cout << "RECOGNIZED: Text=" << result->Text << std::endl;
+                store->Append(callId, result);
+            }
+        });
+
+        session.OnCanceled(recognizer->Canceled, [](const RecognitionSessionRunner::CancellationInfo& e)
+        {
+            if (e.Reason == CancellationReason::Error)
+            {
+                cout << "CANCELED: ErrorCode=" << (int)e.ErrorCode << std::endl;
+                cout << "CANCELED: ErrorDetails=" << e.ErrorDetails << std::endl;
+            }
+        });
+
+        session.RunContinuous(*recognizer);
+
+        // Writes what is left in memory.
+        store->Close();
+        auto statistics = store->GetStatistics();
+        cout << "Stored " << statistics.Utterances << " utterances in " << statistics.Segments << " segments." << std::endl;
+        if (!store->GetError().empty())
+        {
+            cout << statistics.LostUtterances << " utterances were lost: " << store->GetError() << std::endl;
+        }
+    }
+
+    // Reads the store back. An indexer would map the file instead; the segments are used in place either way.
+    ifstream file(storeFile, ios::binary);
+    vector<uint64_t> bytes;
+    file.seekg(0, ios::end);
+    auto size = (size_t)file.tellg();
+    bytes.resize((size + sizeof(uint64_t) - 1) / sizeof(uint64_t));
+    file.seekg(0);
+    file.read(reinterpret_cast<char*>(bytes.data()), size);
+
+    auto data = reinterpret_cast<const uint8_t*>(bytes.data());
+    for (size_t position = 0; position < size;)
+    {
+        try
+        {
+            TranscriptSegmentView segment(data + position, size - position);
+            const auto& header = segment.GetHeader();
+            cout << "Segment at " << position << ": " << header.Utterances << " utterances, " << header.Words << " words, "
+                 << header.Strings << " strings, ticks " << header.MinOffset << " to " << header.MaxEnd << std::endl;
+
+            // Word ids are sorted string ranks, so a lookup is a binary search and a scan of one integer column.
+            auto weather = segment.FindString("weather");
+            auto wordTexts = segment.Column<uint32_t>(TranscriptStoreFormat::WordText);
+            auto wordOffsets = segment.Column<uint64_t>(TranscriptStoreFormat::WordOffset);
+            for (uint32_t word = 0; weather >= 0 && word < header.Words; word++)
+            {
+                if (wordTexts[word] == weather)
+                {
+                    cout << "  \"weather\" at " << wordOffsets[word] << std::endl;
+                }
+            }
+            position += (size_t)header.SegmentBytes;
+        }
+        catch (const exception& e)
+        {
+            cout << "Cannot read the transcript store at " << position << ": " << e.what() << std::endl;
+            break;
+        }
+    }
+}
+
+// Speech recognition of a multi-channel file with several recognition settings, enhancing the file with the
+// Microsoft Audio Stack once and recognizing the cached enhanced mono audio in every run.
+void SpeechRecognitionSweepWithCachedMASEnhancedAudio()
+{
+    // Creates an instance of a speech config with specified subscription key and service region.
+    // Replace with your own subscription key and service region (e.g., "westus").
+    auto config = SpeechConfig::FromSubscription("YourSubscriptionKey", "YourServiceRegion");
+
+    // The geometry of SpeechContinuousRecognitionFromMultiChannelFileWithMASEnabledAndCustomGeometrySpecified.
+    MasSettings mas;
+    mas.Preset = PresetMicrophoneArrayGeometry::Custom;
+    mas.Microphones = { { 0, 0, 0 }, { 40, 0, 0 }, { 20, -35, 0 }, { -20, -35, 0 }, { -40, 0, 0 }, { -20, 35, 0 }, { 20, 35, 0 } };
+    mas.Reference = SpeakerReferenceChannel::LastChannel;
+
+    // A placeholder: the SDK does not hand out the audio its audio stack processed, so the enhancement is an external
+    // command. Replace it with your own tool that runs the Microsoft Audio Stack offline. It is called as
+    // <tool> <source> <output> "<settings>" and writes the enhanced audio as a mono WAV file to <output>.
+    const string enhancerCommand = "YourMasToolCommand";
+    EnhancedAudioCache cache([&enhancerCommand](const string& source, const MasSettings& settings, const string& output)
+    {
+        auto command = enhancerCommand + " \"" + source + "\" \"" + output + "\" \"" + settings.Describe() + "\"";
+        if (system(command.c_str()) != 0)
+        {
+            throw runtime_error("The enhancer failed: " + command);
+        }
+    });
+
+    // Replace with your own audio file name.
+    const string audioFile = "katiesteve.wav";
+
+    // The settings swept; only the first run pays for the enhancement, later runs and later sweeps read the
+    // file written next to the source.
+    const vector<string> segmentationSilenceTimeouts = { "300", "500", "1000" };
+    for (const auto& timeout : segmentationSilenceTimeouts)
+    {
+        shared_ptr<AudioConfig> audioInput;
+        try
+        {
+            bool created = false;
+            auto enhancedFile = cache.GetOrCreate(audioFile, mas, &created);
+            cout << (created ? "Enhanced " : "Reusing ") << enhancedFile << std::endl;
+            audioInput = AudioConfig::FromWavFileInput(enhancedFile);
+        }
+        catch (const exception& e)
+        {
+            cout << e.what() << std::endl;
+            return;
+        }
+
+        config->SetProperty(PropertyId::Speech_SegmentationSilenceTimeoutMs, timeout);
+        auto recognizer = SpeechRecognizer::FromConfig(config, audioInput);
+
+        RecognitionSessionRunner session;
+        session.OnFinal(recognizer->Recognized, [&timeout](const shared_ptr<SpeechRecognitionResult>& result)
+        {
+            if (result->Reason == ResultReason::RecognizedSpeech)
+            {
+                cout << "  [" << timeout << " ms] RECOGNIZED: Text=" << result->Text << std::endl;
+            }
+        });
+        session.OnCanceled(recognizer->Canceled, [](const RecognitionSessionRunner::CancellationInfo& e)
+        {
+            if (e.Reason == CancellationReason::Error)
+            {
+                cout << "CANCELED: ErrorCode=" << (int)e.ErrorCode << std::endl;
+                cout << "CANCELED: ErrorDetails=" << e.ErrorDetails << std::endl;
+            }
+        });
+        session.RunContinuous(*recognizer);
+    }
+
+    cout << "Enhanced " << cache.Misses() << " time(s), reused " << cache.Hits() << " time(s)." << std::endl;
+}
+
+// Speech recognition against the fastest healthy of several regions, failing over to another region when a session
+// cannot reach the service.
+void SpeechRecognitionWithRegionFailover()
+{
+    // Replace with your own subscription keys and their regions, the home region first. A container or other
+    // custom endpoint can be given as Endpoint instead of a region.
+    RegionSelector selector({
+        { "westus", "YourSubscriptionKeyForWestUs", "westus", "" },
+        { "westeurope", "YourSubscriptionKeyForWestEurope", "westeurope", "" },
+        { "southeastasia", "YourSubscriptionKeyForSoutheastAsia", "southeastasia", "" },
+    });
+
+    // Waits for the first probes, so the first session already goes to the nearest region. A service would not
+    // wait and start in the home region instead.
+    selector.ProbeNow();
+
+    // Replace with your own audio file name.
+    const string audioFile = "whatstheweatherlike.wav";
+    const int sessions = 3;
+    const int maxAttempts = 3;
+    for (int i = 0; i < sessions; i++)
+    {
+        for (int attempt = 1; attempt <= maxAttempts; attempt++)
+        {
+            auto choice = selector.Select();
+            auto recognizer = SpeechRecognizer::FromConfig(choice.Config, AudioConfig::FromWavFileInput(audioFile));
+
+            auto started = chrono::steady_clock::now();
+            auto result = recognizer->RecognizeOnceAsync().get();
+            if (result->Reason != ResultReason::Canceled)
+            {
+                // The time to the result includes the recognition, it is only a rough stand-in for the connect time.
+                selector.ReportSuccess(choice.Name);
+                cout << "Session " << i + 1 << " in " << choice.Name << " after "
+                     << chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - started).count() << " ms: "
+                     << (result->Reason == ResultReason::RecognizedSpeech ? result->Text : "(no match)") << std::endl;
+                break;
+            }
+
+            auto cancellation = CancellationDetails::FromResult(result);
+            if (cancellation->Reason != CancellationReason::Error)
+            {
+                break;
+            }
+            cout << "Session " << i + 1 << " in " << choice.Name << " CANCELED: ErrorCode=" << (int)cancellation->ErrorCode
+                 << " ErrorDetails=" << cancellation->ErrorDetails << std::endl;
+            if (!selector.ReportFailure(choice.Name, cancellation->ErrorCode))
+            {
+                // Another region would fail the same way, e.g. with a wrong key.
+                cout << "CANCELED: Did you update the subscription info?" << std::endl;
+                break;
+            }
+        }
+    }
+
+    for (const auto& status : selector.GetStatus())
+    {
+        cout << status.Name << ": connect " << status.ConnectTime.count() << " ms, error rate " << status.ErrorRate
+             << (status.Healthy ? ", healthy" : ", unhealthy") << ", " << status.Selections << " session(s)" << std::endl;
+    }
+}
+
+// Speech recognition with authorization tokens that are refreshed in the background, so no session start waits for
+// the token service and a long-running recognizer keeps working after its first token expired.
+void SpeechRecognitionWithBackgroundTokenRefresh()
+{
+    // Replace with your own subscription key and service region (e.g., "westus"). The key stays on the machine that
+    // fetches tokens; an application would get the tokens from its own token service instead.
+    const string subscriptionKey = "YourSubscriptionKey";
+    const string region = "YourServiceRegion";
+
+    // Fetches a token from the issueToken endpoint of the region with curl, which stands in for the HTTP client
+    // of the application.
+    auto fetchToken = [subscriptionKey, region]()
+    {
+        auto command = "curl -s -f -X POST -H \"Content-Length: 0\" -H \"Ocp-Apim-Subscription-Key: " + subscriptionKey +
+            "\" https://" + region + ".api.cognitive.microsoft.com/sts/v1.0/issueToken";
+#ifdef _WIN32
+        auto pipe = _popen(command.c_str(), "r");
+#else
+        auto pipe = popen(command.c_str(), "r");
+#endif
+        if (pipe == nullptr)
+        {
+            throw runtime_error("Cannot run curl.");
+        }
+        string token;
+        char buffer[1024];
+        size_t read;
+        while ((read = fread(buffer, 1, sizeof(buffer), pipe)) > 0)
+        {
+            token.append(buffer, read);
+        }
+#ifdef _WIN32
+        auto status = _pclose(pipe);
+#else
+        auto status = pclose(pipe);
+#endif
+        if (status != 0 || token.empty())
+        {
+            throw runtime_error("Cannot get a token, did you update the subscription info?");
+        }
+        return token;
+    };
+
+    unique_ptr<AuthorizationTokenManager> tokens;
+    try
+    {
+        tokens = make_unique<AuthorizationTokenManager>(fetchToken);
+    }
+    catch (const exception& e)
+    {
+        cout << e.what() << std::endl;
+        return;
+    }
+
+    // Short sessions: each starts from the cached token, without a round trip to the token service.
+    for (int i = 0; i < 3; i++)
+    {
+        auto started = chrono::steady_clock::now();
+        auto recognizer = SpeechRecognizer::FromConfig(tokens->CreateConfig(region), AudioConfig::FromWavFileInput("whatstheweatherlike.wav"));
+        auto result = recognizer->RecognizeOnceAsync().get();
+        cout << "Session " << i + 1 << " took " << chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - started).count()
+             << " ms: " << (result->Reason == ResultReason::RecognizedSpeech ? result->Text : "(no result)") << std::endl;
+    }
+
+    // A long session: the recognizer is tracked, so it gets every new token and can reconnect after an hour.
+    auto recognizer = SpeechRecognizer::FromConfig(tokens->CreateConfig(region), AudioConfig::FromDefaultMicrophoneInput());
+    tokens->Track(recognizer);
+
+    RecognitionSessionRunner session;
+    session.OnFinal(recognizer->Recognized, [](const shared_ptr<SpeechRecognitionResult>& result)
+    {
+        if (result->Reason == ResultReason::RecognizedSpeech)
+        {
+            cout << "RECOGNIZED: Text=" << result->Text << std::endl;
+        }
+    });
+    session.OnCanceled(recognizer->Canceled, [](const RecognitionSessionRunner::CancellationInfo& e)
+    {
+        if (e.Reason == CancellationReason::Error)
+        {
+            cout << "CANCELED: ErrorCode=" << (int)e.ErrorCode << std::endl;
+            cout << "CANCELED: ErrorDetails=" << e.ErrorDetails << std::endl;
+        }
+    });
+
+    cout << "Say something, press Enter to stop..." << std::endl;
+    recognizer->StartContinuousRecognitionAsync().get();
+    cin.ignore();
+    recognizer->StopContinuousRecognitionAsync().get();
+
+    auto statistics = tokens->GetStatistics();
+    cout << "Token refreshes: " << statistics.Refreshes << ", failed: " << statistics.FailedRefreshes
+         << ", updates of live recognizers: " << statistics.Updates << std::endl;
+}
+
+// Speech recognition from a WAV file in blob storage, streamed with HTTP range requests while it is recognized, so
+// recognition starts on the first block instead of after the download.
+void SpeechRecognitionFromBlobWithRangeRequests()
+{
+    // Replace with your own subscription key and service region (e.g., "westus").
+    auto config = SpeechConfig::FromSubscription("YourSubscriptionKey", "YourServiceRegion");
+
+    // Replace with the URL of your file, e.g. a blob with a SAS token.
+    const string audioUrl = "YourAudioFileUrl";
+
+    // Fetches a range of the file with curl, which stands in for the HTTP client of the application. curl appends the
+    // HTTP status to the body, so the fetch can tell a range (206) from a whole file sent by a server that ignores it.
+    auto fetchRange = [audioUrl](uint64_t offset, uint32_t size)
+    {
+        auto command = "curl -s -w \"%{http_code}\" -r " + to_string(offset) + "-" + to_string(offset + size - 1) + " \"" + audioUrl + "\"";
+#ifdef _WIN32
+        auto pipe = _popen(command.c_str(), "rb");
+#else
+        auto pipe = popen(command.c_str(), "r");
+#endif
+        if (pipe == nullptr)
+        {
+            throw runtime_error("Cannot run curl.");
+        }
+        vector<uint8_t> data;
+        uint8_t buffer[64 * 1024];
+        size_t read;
+        while ((read = fread(buffer, 1, sizeof(buffer), pipe)) > 0)
+        {
+            data.insert(data.end(), buffer, buffer + read);
+        }
+#ifdef _WIN32
+        auto exitCode = _pclose(pipe);
+#else
+        auto exitCode = pclose(pipe);
+#endif
+        auto status = data.size() >= 3 ? string(data.end() - 3, data.end()) : string();
+        data.resize(data.size() - status.size());
+        if (exitCode != 0 || (status != "206" && status != "416"))
+        {
+            throw runtime_error("Cannot download bytes " + to_string(offset) + "- of " + audioUrl + ", HTTP status " + status);
+        }
+        // A range that starts past the end of the file is not satisfiable, and there are no more bytes.
+        if (status == "416")
+        {
+            data.clear();
+        }
+        return data;
+    };
+
+    shared_ptr<PullCallback<HttpRangeSource>> callback;
+    try
+    {
+        callback = make_shared<PullCallback<HttpRangeSource>>(fetchRange);
+    }
+    catch (const exception& e)
+    {
+        cout << "Exit due to exception: " << e.what() << endl;
+        return;
+    }
+    auto& source = callback->GetSource();
+    const auto& format = source.GetFormat();
+    auto pullStream = AudioInputStream::CreatePullStream(
+        AudioStreamFormat::GetWaveFormatPCM(format.SamplesPerSec, (uint8_t)format.BitsPerSample, (uint8_t)format.Channels), callback);
+
+    RecognitionSessionRunner session;
+    auto recognizer = SpeechRecognizer::FromConfig(config, AudioConfig::FromStreamInput(pullStream));
+    session.OnFinal(recognizer->Recognized, [](const shared_ptr<SpeechRecognitionResult>& result)
+    {
+        if (result->Reason == ResultReason::RecognizedSpeech)
+        {
+            cout << "RECOGNIZED: Text=" << result->Text << std::endl;
+        }
+    });
+    session.OnCanceled(recognizer->Canceled, [](const RecognitionSessionRunner::CancellationInfo& e)
+    {
+        if (e.Reason == CancellationReason::Error)
+        {
+            cout << "CANCELED: ErrorCode=" << (int)e.ErrorCode << std::endl;
+            cout << "CANCELED: ErrorDetails=" << e.ErrorDetails << std::endl;
+        }
+    });
+    session.OnSessionStopped(recognizer->SessionStopped);
+    session.RunContinuous(*recognizer);
+
+    if (!source.GetError().empty())
+    {
+        cout << "The download ended early: " << source.GetError() << std::endl;
+    }
+    auto statistics = source.GetStatistics();
+    cout << "Downloaded " << statistics.Bytes << " bytes in " << statistics.Blocks << " blocks, first block after "
+         << statistics.FirstBlock.count() << " ms, " << statistics.Retries << " retries, " << statistics.Stalls
+         << " waits for the network, longest " << statistics.MaxStall.count() << " ms" << std::endl;
+}
+
+// Continuous speech recognition from a file, with the partial results turned into caption updates as a live-caption
+// relay would send them: only the words after the stable prefix, and at most one partial update per interval.
+void SpeechRecognitionWithThrottledPartials()
+{
+    // Replace with your own subscription key and service region (e.g., "westus").
+    auto config = SpeechConfig::FromSubscription("YourSubscriptionKey", "YourServiceRegion");
+
+    // Stands in for broadcasting the update to the viewers; the caption is what each of them renders.
+    string caption;
+    PartialResultThrottle::Settings settings;
+    settings.Interval = chrono::milliseconds(250);
+    PartialResultThrottle throttle([&caption](const PartialResultThrottle::Update& update)
+    {
+        caption = caption.substr(0, update.Keep) + update.Append;
+        cout << (update.Final ? "CAPTION: " : "caption: ") << caption << "  (keep " << update.Keep << ", send \"" << update.Append << "\")" << std::endl;
+        if (update.Final)
+        {
+            caption.clear();
+        }
+    }, settings);
+
+    // Replace with your own audio file name.
+    auto recognizer = SpeechRecognizer::FromConfig(config, AudioConfig::FromWavFileInput("whatstheweatherlike.wav"));
+    promise<void> recognitionEnd;
+
+    recognizer->Recognizing.Connect([&throttle](const SpeechRecognitionEventArgs& e)
+    {
+        throttle.OnPartial(e.Result->Text);
+    });
+    recognizer->Recognized.Connect([&throttle](const SpeechRecognitionEventArgs& e)
+    {
+        if (e.Result->Reason == ResultReason::RecognizedSpeech)
+        {
+            throttle.OnFinal(e.Result->Text);
+        }
+    });
+    recognizer->Canceled.Connect([&recognitionEnd](const SpeechRecognitionCanceledEventArgs& e)
+    {
+        if (e.Reason == CancellationReason::Error)
+        {
+            cout << "CANCELED: ErrorCode=" << (int)e.ErrorCode << "\n"
+                 << "CANCELED: ErrorDetails=" << e.ErrorDetails << std::endl;
+            recognitionEnd.set_value();
+        }
+    });
+    recognizer->SessionStopped.Connect([&recognitionEnd](const SessionEventArgs&)
+    {
+        recognitionEnd.set_value();
+    });
+
+    recognizer->StartContinuousRecognitionAsync().get();
+    recognitionEnd.get_future().get();
+    recognizer->StopContinuousRecognitionAsync().get();
+
+    auto statistics = throttle.GetStatistics();
+    cout << statistics.Partials << " partials (" << statistics.Coalesced << " coalesced) sent as " << statistics.Updates
+         << " updates: " << statistics.SentBytes << " bytes instead of " << statistics.HypothesisBytes << std::endl;
+}
+
+// Speech recognition for several tenants with their own customized models, from warm recognizers kept per endpoint,
+// comparing the latency of requests that found a warm recognizer with those that had to connect first.
+void SpeechRecognitionWithWarmCustomEndpoints()
+{
+    // Replace with your own subscription key and service region (e.g., "westus").
+    const string subscriptionKey = "YourSubscriptionKey";
+    const string region = "YourServiceRegion";
+
+    // Each recognizer reads the file once, so leases discard it after use and the pool connects a new one.
+    // Replace with your own audio file name.
+    CustomEndpointRecognizerPools<SpeechRecognizer>::Settings settings;
+    settings.MaxPoolSize = 2;
+    settings.IdleTimeout = chrono::seconds(120);
+    CustomEndpointRecognizerPools<SpeechRecognizer> pools([subscriptionKey, region](const string& endpointId)
+    {
+        auto config = SpeechConfig::FromSubscription(subscriptionKey, region);
+        config->SetEndpointId(endpointId);
+        return SpeechRecognizer::FromConfig(config, AudioConfig::FromWavFileInput("whatstheweatherlike.wav"));
+    }, settings);
+
+    // Replace with the CRIS endpoint IDs of your tenants, in the order their requests arrive.
+    const vector<string> requests{ "YourEndpointId1", "YourEndpointId2", "YourEndpointId1", "YourEndpointId1", "YourEndpointId2" };
+    for (const auto& endpointId : requests)
+    {
+        auto recognizer = pools.Acquire(endpointId);
+        auto started = chrono::steady_clock::now();
+        auto result = recognizer->RecognizeOnceAsync().get();
+        auto latency = chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - started);
+        recognizer.Discard();
+
+        if (result->Reason == ResultReason::RecognizedSpeech)
+        {
+            recognizer.RecordFirstResult(latency);
+            cout << endpointId << (recognizer.IsWarm() ? " (warm): " : " (cold): ") << latency.count() << " ms, RECOGNIZED: Text=" << result->Text << std::endl;
+        }
+        else if (result->Reason == ResultReason::Canceled)
+        {
+            auto cancellation = CancellationDetails::FromResult(result);
+            cout << endpointId << ": CANCELED: ErrorCode=" << (int)cancellation->ErrorCode << std::endl;
+            cout << "CANCELED: ErrorDetails=" << cancellation->ErrorDetails << std::endl;
+        }
+
+        // Gives the pool time to connect the replacement, as the gap between requests of a real service would.
+        this_thread::sleep_for(chrono::seconds(1));
+    }
+
+    for (const auto& endpoint : pools.GetStatistics().Endpoints)
+    {
+        cout << endpoint.EndpointId << ": " << endpoint.WarmLeases << " warm leases, mean " << endpoint.WarmFirstResult.count() << " ms; "
+             << endpoint.ColdLeases << " cold leases, mean " << endpoint.ColdFirstResult.count() << " ms" << std::endl;
+    }
+}
@@ -0,0 +1,284 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#pragma once
+
+#include <speechapi_cxx.h>
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <fstream>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "file_replace.h"
+
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#endif
+
+// Cache of synthesized audio, keyed by a hash of everything that determines the audio: the text or SSML
+// (which carries any prosody settings), the voice, the language, the output format and the service endpoint.
+// Recently used audio is kept in memory up to a byte budget, in front of a directory of audio files that
+// survives restarts. A hit therefore costs a map lookup, or one file read after a restart, instead of a
+// round trip to the service.
+class SpeechSynthesisCache final
+{
+public:
+    using Audio = std::shared_ptr<const std::vector<uint8_t>>;
+
+    // Audio is stored as files in 'directory', which is created if needed. At most 'maxMemoryBytes' of
+    // audio is kept in memory, the least recently used audio is dropped first.
+    explicit SpeechSynthesisCache(const std::string& directory, size_t maxMemoryBytes = 64 * 1024 * 1024)
+        : m_directory(directory), m_maxMemoryBytes(maxMemoryBytes)
+    {
+#ifdef _WIN32
+        _mkdir(directory.c_str());
+#else
+        mkdir(directory.c_str(), 0755);
+#endif
+    }
+
+    SpeechSynthesisCache(const SpeechSynthesisCache&) = delete;
+    SpeechSynthesisCache& operator=(const SpeechSynthesisCache&) = delete;
+
+    // Returns the key of synthesizing 'input' with the voice, language, output format and endpoint of 'config'.
+    // A config created from a region rather than an endpoint URL is told apart by its region.
+    static std::string KeyFor(const Microsoft::CognitiveServices::Speech::SpeechConfig& config, const std::string& input, bool isSsml)
+    {
+        using Microsoft::CognitiveServices::Speech::PropertyId;
+        auto endpoint = config.GetProperty(PropertyId::SpeechServiceConnection_Endpoint);
+        return KeyFor(input, isSsml,
+            config.GetProperty(PropertyId::SpeechServiceConnection_SynthVoice),
+            config.GetProperty(PropertyId::SpeechServiceConnection_SynthLanguage),
+            config.GetProperty(PropertyId::SpeechServiceConnection_SynthOutputFormat),
+            endpoint.empty() ? config.GetProperty(PropertyId::SpeechServiceConnection_Region) : endpoint);
+    }
+
+    // Returns a 64-bit FNV-1a hash over all inputs as 16 hex digits. Inputs are length-prefixed, so
+    // different combinations cannot produce the same sequence of hashed bytes.
+    static std::string KeyFor(const std::string& input, bool isSsml, const std::string& voice, const std::string& language,
+        const std::string& outputFormat, const std::string& endpoint)
+    {
+        uint64_t hash = 14695981039346656037ULL;
+        auto mixBytes = [&hash](const std::string& bytes)
+        {
+            for (unsigned char c : bytes)
+            {
+                hash = (hash ^ c) * 1099511628211ULL;
+            }
+        };
+        auto mix = [&mixBytes](const std::string& value)
+        {
+            mixBytes(std::to_string(value.size()) + ":");
+            mixBytes(value);
+        };
+        mix(isSsml ? "ssml" : "text");
+        mix(input);
+        mix(voice);
+        mix(language);
+        mix(outputFormat);
+        mix(endpoint);
+
+        char key[17];
+        snprintf(key, sizeof(key), "%016llx", (unsigned long long)hash);
+        return key;
+    }
+
+    // Returns the cached audio, or nullptr on a miss.
+    Audio Find(const std::string& key)
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            auto entry = m_entries.find(key);
+            if (entry != m_entries.end())
+            {
+                // Moves the entry to the front of the LRU list.
+                m_lru.splice(m_lru.begin(), m_lru, entry->second);
+                return entry->second->second;
+            }
+        }
+
+        std::ifstream file(PathOf(key), std::ios::binary | std::ios::ate);
+        if (!file)
+        {
+            return nullptr;
+        }
+        auto data = std::make_shared<std::vector<uint8_t>>((size_t)file.tellg());
+        file.seekg(0);
+        if (!file.read(reinterpret_cast<char*>(data->data()), data->size()))
+        {
+            return nullptr;
+        }
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        Insert(key, data);
+        return data;
+    }
+
+    // Stores the audio in memory, and on disk if it can be written; a failed write only costs the disk copy.
+    void Store(const std::string& key, Audio audio)
+    {
+        // Writes to a temporary file first, so a concurrent Find() never reads a partly written file. Every write has
+        // its own temporary file, so concurrent stores of the same key, also from other processes, do not mix.
+        auto path = PathOf(key);
+        auto temporaryPath = path + "." + UniqueSuffix() + ".tmp";
+        bool written;
+        {
+            std::ofstream file(temporaryPath, std::ios::binary | std::ios::trunc);
+            file.write(reinterpret_cast<const char*>(audio->data()), audio->size());
+            file.close();
+            written = !file.fail();
+        }
+        if (!written || !MoveFileOver(temporaryPath, path))
+        {
+            std::remove(temporaryPath.c_str());
+        }
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        Insert(key, std::move(audio));
+    }
+
+    // Returns the cached audio of 'input', synthesizing and storing it on a miss.
+    // 'config' must be the config 'synthesizer' was created from. Canceled syntheses are not cached
+    // and return nullptr, with the result in 'failed'.
+    Audio Speak(Microsoft::CognitiveServices::Speech::SpeechSynthesizer& synthesizer,
+        const Microsoft::CognitiveServices::Speech::SpeechConfig& config,
+        const std::string& input, bool isSsml,
+        std::shared_ptr<Microsoft::CognitiveServices::Speech::SpeechSynthesisResult>* failed = nullptr)
+    {
+        using Microsoft::CognitiveServices::Speech::ResultReason;
+
+        auto key = KeyFor(config, input, isSsml);
+        if (auto audio = Find(key))
+        {
+            return audio;
+        }
+
+        auto result = isSsml ? synthesizer.SpeakSsmlAsync(input).get() : synthesizer.SpeakTextAsync(input).get();
+        if (result->Reason != ResultReason::SynthesizingAudioCompleted)
+        {
+            if (failed != nullptr)
+            {
+                *failed = result;
+            }
+            return nullptr;
+        }
+
+        Audio audio = result->GetAudioData();
+        Store(key, audio);
+        return audio;
+    }
+
+    // Writes the audio to a push audio output stream callback in chunks of 'chunkSize', the way a
+    // synthesizer writing to a push stream would, and closes it.
+    static void Replay(const Audio& audio, Microsoft::CognitiveServices::Speech::Audio::PushAudioOutputStreamCallback& callback, uint32_t chunkSize = 4096)
+    {
+        std::vector<uint8_t> chunk(chunkSize);
+        for (size_t offset = 0; offset < audio->size(); offset += chunkSize)
+        {
+            auto size = (uint32_t)std::min<size_t>(chunkSize, audio->size() - offset);
+            // Write() takes a mutable buffer, so the chunk is copied out of the shared audio.
+            std::copy(audio->begin() + offset, audio->begin() + offset + size, chunk.begin());
+            callback.Write(chunk.data(), size);
+        }
+        callback.Close();
+    }
+
+    // Reads cached audio with the same calls as AudioDataStream, for code consuming a data stream.
+    // The SDK only creates AudioDataStream instances from synthesis results, so cached audio cannot be one.
+    class Stream final
+    {
+    public:
+        explicit Stream(Audio audio) : m_audio(std::move(audio)) {}
+
+        bool CanReadData(uint32_t bytesRequested) const
+        {
+            return m_position + bytesRequested <= m_audio->size();
+        }
+
+        uint32_t ReadData(uint8_t* buffer, uint32_t bufferSize)
+        {
+            auto size = (uint32_t)std::min<size_t>(bufferSize, m_audio->size() - m_position);
+            std::copy(m_audio->begin() + m_position, m_audio->begin() + m_position + size, buffer);
+            m_position += size;
+            return size;
+        }
+
+        void SetPosition(uint32_t pos)
+        {
+            m_position = std::min<size_t>(pos, m_audio->size());
+        }
+
+        uint32_t GetPosition() const
+        {
+            return (uint32_t)m_position;
+        }
+
+    private:
+        Audio m_audio;
+        size_t m_position = 0;
+    };
+
+private:
+    using Entry = std::pair<std::string, Audio>;
+
+    std::string PathOf(const std::string& key) const
+    {
+        return m_directory + "/" + key + ".audio";
+    }
+
+    // A random number per process and a counter, unique across the threads and processes sharing the directory.
+    static std::string UniqueSuffix()
+    {
+        static const uint64_t process = (uint64_t)std::random_device{}() << 32 | std::random_device{}();
+        static std::atomic<uint64_t> counter{ 0 };
+        char suffix[40];
+        snprintf(suffix, sizeof(suffix), "%016llx-%llu", (unsigned long long)process, (unsigned long long)counter++);
+        return suffix;
+    }
+
+    // Must be called with the lock held.
+    void Insert(const std::string& key, Audio audio)
+    {
+        auto existing = m_entries.find(key);
+        if (existing != m_entries.end())
+        {
+            m_memoryBytes -= existing->second->second->size();
+            m_lru.erase(existing->second);
+            m_entries.erase(existing);
+        }
+
+        // Audio larger than the whole budget is only kept on disk.
+        if (audio->size() > m_maxMemoryBytes)
+        {
+            return;
+        }
+
+        m_memoryBytes += audio->size();
+        m_lru.emplace_front(key, std::move(audio));
+        m_entries[key] = m_lru.begin();
+
+        while (m_memoryBytes > m_maxMemoryBytes)
+        {
+            m_memoryBytes -= m_lru.back().second->size();
+            m_entries.erase(m_lru.back().first);
+            m_lru.pop_back();
+        }
+    }
+
+    const std::string m_directory;
+    const size_t m_maxMemoryBytes;
+
+    std::mutex m_mutex;
+    std::list<Entry> m_lru;
+    std::unordered_map<std::string, std::list<Entry>::iterator> m_entries;
+    size_t m_memoryBytes = 0;
+};
@@ -5,8 +5,20 @@
 
 #include "stdafx.h"
 
+// Comes first, since winsock2.h must be included before anything that includes windows.h.
+#include "audio_stream_forwarder.h"
 #include <speechapi_cxx.h>
+#include <chrono>
 #include <fstream>
+#include "pipelined_synthesizer.h"
+#include "process_memory.h"
+#include "segmented_audio_buffer.h"
+#include "speech_synthesis_cache.h"
+#include "speech_synthesizer_pool.h"
+#include "streaming_wav_file_writer.h"
+#include "synthesis_event_recorder.h"
+#include "synthesis_format_selector.h"
+#include "voice_catalog.h"
 
 using namespace std;
 using namespace Microsoft::CognitiveServices::Speech;
@@ -375,14 +387,20 @@ void SpeechSynthesisToPushAudioOutputStream()
 {
     // First, defines push audio output stream callback class that implements the
     // PushAudioOutputStreamCallback interface. The sample here illustrates how to define such
-    // a callback that writes audio data to a byte vector.
+    // a callback that writes audio data to a segmented buffer, which never reallocates or moves
+    // the audio already received, so long renders (e.g. audiobooks) are collected at a constant
+    // cost per chunk.
     // PushAudioOutputStreamSampleCallback implements PushAudioOutputStreamCallback interface
     class PushAudioOutputStreamSampleCallback : public PushAudioOutputStreamCallback
     {
     public:
-        PushAudioOutputStreamSampleCallback()
+        /// <summary>
+        /// Creates the callback.
+        /// </summary>
+        /// <param name="capacityHint">Expected audio size in bytes, allocated up front.</param>
+        PushAudioOutputStreamSampleCallback(size_t capacityHint = 0)
+            : m_audioData(capacityHint)
         {
-            m_audioData = std::make_shared<std::vector<uint8_t>>();
         }
 
         /// <summary>
@@ -393,11 +411,9 @@ void SpeechSynthesisToPushAudioOutputStream()
         /// <returns>Tell synthesizer how many bytes are received.</returns>
         int Write(uint8_t* dataBuffer, uint32_t size) override
         {
-            auto oldSize = m_audioData->size();
-            m_audioData->resize(oldSize + size);
-            memcpy(m_audioData->data() + oldSize, dataBuffer, size);
-
-            cout << size << " bytes received." << endl;
+            // Runs on the synthesizer thread, so it only stores the chunk and does no console output.
+            m_audioData.Append(dataBuffer, size);
+            m_chunks++;
 
             return size;
         }
@@ -416,20 +432,30 @@ void SpeechSynthesisToPushAudioOutputStream()
         /// <returns>The received audio data size</returns>
         size_t GetAudioSize()
         {
-            return m_audioData->size();
+            return m_audioData.Size();
+        }
+
+        /// <summary>
+        /// Gets the number of audio chunks received
+        /// </summary>
+        /// <returns>The number of audio chunks received</returns>
+        size_t GetChunkCount()
+        {
+            return m_chunks;
         }
 
         /// <summary>
         /// Gets the received audio data
         /// </summary>
-        /// <returns>The received audio data in byte vector</returns>
-        std::shared_ptr<std::vector<uint8_t>> GetAudioData()
+        /// <returns>The received audio data, readable as a list of segments</returns>
+        const SegmentedAudioBuffer& GetAudioData()
         {
             return m_audioData;
         }
 
     private:
-        std::shared_ptr<std::vector<uint8_t>> m_audioData;
+        SegmentedAudioBuffer m_audioData;
+        size_t m_chunks = 0;
     };
 
     // Creates an instance of a speech config with specified subscription key and service region.
@@ -437,7 +463,8 @@ void SpeechSynthesisToPushAudioOutputStream()
     auto config = SpeechConfig::FromSubscription("YourSubscriptionKey", "YourServiceRegion");
 
     // Creates an instance of the callback class inherited from PushAudioOutputStreamCallback.
-    auto callback = std::make_shared<PushAudioOutputStreamSampleCallback>();
+    // The capacity hint allocates room for one minute of the default output format (16 kHz 16-bit mono) up front.
+    auto callback = std::make_shared<PushAudioOutputStreamSampleCallback>(60 * 32000);
 
     // Creates an audio out stream from the callback.
     auto stream = AudioOutputStream::CreatePushStream(callback);
@@ -479,7 +506,7 @@ void SpeechSynthesisToPushAudioOutputStream()
         }
     }
 
-    cout << "Totally " << callback->GetAudioSize() << " bytes received." << endl;
+    cout << "Totally " << callback->GetAudioSize() << " bytes received in " << callback->GetChunkCount() << " chunks." << endl;
 }
 
 // Gets synthesized audio data from result.
@@ -665,6 +692,18 @@ void SpeechSynthesisEvents()
     }
 }
 
+// Prints the event counts and timing of a synthesis event recorder.
+static void PrintSynthesisEventStatistics(const SynthesisEventRecorder& recorder)
+{
+    auto statistics = recorder.GetStatistics();
+    cout << "Events: word boundaries=" << statistics.WordBoundaries
+        << ", visemes=" << statistics.Visemes
+        << ", bookmarks=" << statistics.Bookmarks
+        << ", dropped=" << statistics.Dropped
+        << ", max handler time=" << statistics.MaxHandlerTime.count() << "us"
+        << ", max delivery delay=" << statistics.MaxDeliveryDelay.count() << "us" << endl;
+}
+
 // Speech synthesis word boundary event.
 void SpeechSynthesisWordBoundaryEvent()
 {
@@ -672,21 +711,24 @@ void SpeechSynthesisWordBoundaryEvent()
     // Replace with your own subscription key and service region (e.g., "westus").
     auto config = SpeechConfig::FromSubscription("YourSubscriptionKey", "YourServiceRegion");
 
+    // Records the word boundary events on the SDK callback thread, and prints them from a background thread.
+    // Printing in the event handler itself would hold up the synthesizer on console output.
+    SynthesisEventRecorder recorder([](const SynthesisEvent& e)
+    {
+        cout << "Word boundary event received. "
+            // The unit of e.AudioOffset is tick (1 tick = 100 nanoseconds), divide by 10,000 to convert to milliseconds.
+            << "Audio offset: " << (e.AudioOffset + 5000) / 10000 << "ms, "
+            << "text offset: " << e.TextOffset << ", "
+            << "word length: " << e.WordLength << ".\n";
+    });
+
     // Creates a speech synthesizer with a null output stream.
     // This means the audio output data will not be written to any stream.
     // You can just get the audio from the result.
     auto synthesizer = SpeechSynthesizer::FromConfig(config, nullptr);
 
     // Subscribes to word boundary event
-    synthesizer->WordBoundary += [](const SpeechSynthesisWordBoundaryEventArgs& e)
-    {
-        cout << "Word boundary event received. "
-            // The unit of e.AudioOffset is tick (1 tick = 100 nanoseconds), divide by 10,000 to convert to milliseconds.
-            << "Audio offset: " << (e.AudioOffset + 5000) / 10000 << "ms, "
-            << "text offset: " << e.TextOffset << ", "
-            << "word length: " << e.WordLength << "."
-            << endl;
-    };
+    recorder.Attach(*synthesizer, { SynthesisEvent::Kind::WordBoundary });
 
     while (true)
     {
@@ -702,12 +744,16 @@ void SpeechSynthesisWordBoundaryEvent()
 
         auto result = synthesizer->SpeakTextAsync(text).get();
 
+        // Prints the remaining events before the result.
+        recorder.Flush();
+
         // Checks result.
         if (result->Reason == ResultReason::SynthesizingAudioCompleted)
         {
             cout << "Speech synthesized for text [" << text << "]" << std::endl;
             auto audioData = result->GetAudioData();
             cout << audioData->size() << " bytes of audio data received for text [" << text << "]" << endl;
+            PrintSynthesisEventStatistics(recorder);
         }
         else if (result->Reason == ResultReason::Canceled)
         {
@@ -731,19 +777,23 @@ void SpeechSynthesisVisemeEvent()
     // Replace with your own subscription key and service region (e.g., "westus").
     auto config = SpeechConfig::FromSubscription("YourSubscriptionKey", "YourServiceRegion");
 
+    // Records the viseme events on the SDK callback thread, and prints them from a background thread.
+    // A long text produces thousands of visemes, printing each in the event handler would slow down the synthesizer.
+    SynthesisEventRecorder recorder([](const SynthesisEvent& e)
+    {
+        cout << "viseme event received. "
+            // The unit of e.AudioOffset is tick (1 tick = 100 nanoseconds), divide by 10,000 to convert to milliseconds.
+            << "Audio offset: " << e.AudioOffset / 10000 << "ms, "
+            << "viseme id: " << e.VisemeId << ".\n";
+    });
+
     // Creates a speech synthesizer with a null output stream.
     // This means the audio output data will not be written to any stream.
     // You can just get the audio from the result.
     auto synthesizer = SpeechSynthesizer::FromConfig(config, nullptr);
 
     // Subscribes to viseme received event
-    synthesizer->VisemeReceived += [](const SpeechSynthesisVisemeEventArgs& e)
-    {
-        cout << "viseme event received. "
-            // The unit of e.AudioOffset is tick (1 tick = 100 nanoseconds), divide by 10,000 to convert to milliseconds.
-            << "Audio offset: " << e.AudioOffset / 10000 << "ms, "
-            << "viseme id: " << e.VisemeId << "." << endl;
-    };
+    recorder.Attach(*synthesizer, { SynthesisEvent::Kind::Viseme });
 
     while (true)
     {
@@ -759,12 +809,16 @@ void SpeechSynthesisVisemeEvent()
 
         auto result = synthesizer->SpeakTextAsync(text).get();
 
+        // Prints the remaining events before the result.
+        recorder.Flush();
+
         // Checks result.
         if (result->Reason == ResultReason::SynthesizingAudioCompleted)
         {
             cout << "Speech synthesized for text [" << text << "]" << std::endl;
             const auto audioData = result->GetAudioData();
             cout << audioData->size() << " bytes of audio data received for text [" << text << "]" << endl;
+            PrintSynthesisEventStatistics(recorder);
         }
         else if (result->Reason == ResultReason::Canceled)
         {
@@ -788,19 +842,22 @@ void SpeechSynthesisBookmarkEvent()
     // Replace with your own subscription key and service region (e.g., "westus").
     auto config = SpeechConfig::FromSubscription("YourSubscriptionKey", "YourServiceRegion");
 
+    // Records the bookmark events on the SDK callback thread, and prints them from a background thread.
+    SynthesisEventRecorder recorder([](const SynthesisEvent& e)
+    {
+        cout << "bookmark reached. "
+            // The unit of e.AudioOffset is tick (1 tick = 100 nanoseconds), divide by 10,000 to convert to milliseconds.
+            << "Audio offset: " << e.AudioOffset / 10000 << "ms, "
+            << "Bookmark text: " << e.Text << ".\n";
+    });
+
     // Creates a speech synthesizer with a null output stream.
     // This means the audio output data will not be written to any stream.
     // You can just get the audio from the result.
     auto synthesizer = SpeechSynthesizer::FromConfig(config, nullptr);
 
     // Subscribes to bookmark reached event
-    synthesizer->BookmarkReached += [](const SpeechSynthesisBookmarkEventArgs& e)
-    {
-        cout << "bookmark reached. "
-            // The unit of e.AudioOffset is tick (1 tick = 100 nanoseconds), divide by 10,000 to convert to milliseconds.
-            << "Audio offset: " << e.AudioOffset / 10000 << "ms, "
-            << "Bookmark text: " << e.Text << "." << endl;
-    };
+    recorder.Attach(*synthesizer, { SynthesisEvent::Kind::Bookmark });
 
     // Bookmark tag is needed in the SSML, e.g.
     const auto ssml = "<speak version='1.0' xml:lang='en-US' xmlns='http://www.w3.org/2001/10/synthesis' xmlns:mstts='http://www.w3.org/2001/mstts'><voice name='Microsoft Server Speech Text to Speech Voice (en-US, AriaNeural)'><bookmark mark='bookmark_one'/> one. <bookmark mark='bookmark_two'/> two. three. four.</voice></speak>";
@@ -810,10 +867,14 @@ void SpeechSynthesisBookmarkEvent()
     getline(cin, text);
     const auto result = synthesizer->SpeakSsmlAsync(ssml).get();
 
+    // Prints the remaining events before the result.
+    recorder.Flush();
+
     // Checks result.
     if (result->Reason == ResultReason::SynthesizingAudioCompleted)
     {
         cout << "Speech synthesized." << std::endl;
+        PrintSynthesisEventStatistics(recorder);
     }
     else if (result->Reason == ResultReason::Canceled)
     {
@@ -879,28 +940,453 @@ void SpeechSynthesisGetAvailableVoices()
     // Replace with your own subscription key and service region (e.g., "westus").
     const auto speechConfig = SpeechConfig::FromSubscription("YourSubscriptionKey", "YourServiceRegion");
 
-    // Creates a speech synthesizer.
-    auto synthesizer = SpeechSynthesizer::FromConfig(speechConfig, nullptr);
+    // Keeps the voice list in a file for a day, so only the first start of the day waits for the service.
+    VoiceCatalog catalog(speechConfig, "voices.tsv");
 
     cout << "Enter a locale in BCP-47 format (e.g. en-US) that you want to get the voices of, or enter empty to get voices in all locales." << std::endl;
     cout << "> ";
     std::string text;
     getline(cin, text);
 
-    const auto result = synthesizer->GetVoicesAsync(text).get();
-
-    // Checks result.
-    if (result->Reason == ResultReason::VoicesListRetrieved)
+    try
     {
+        const auto voices = catalog.FindByLocale(text);
         cout << "Voices successfully retrieved, they are:" << std::endl;
-        for (const auto& voice : result->Voices)
+        for (const auto& voice : voices)
         {
-            cout << voice->Name << endl;
+            cout << voice.Name << endl;
         }
     }
-    else if (result->Reason == ResultReason::Canceled)
+    catch (const std::runtime_error& e)
     {
-        cout << "CANCELED: ErrorDetails=[" << result->ErrorDetails << "]" << std::endl;
+        cout << "CANCELED: ErrorDetails=[" << e.what() << "]" << std::endl;
         cout << "CANCELED: Did you update the subscription info?" << std::endl;
     }
 }
+
+// Speech synthesis of many prompts with a pool of warm synthesizers.
+void SpeechSynthesisWithSynthesizerPool()
+{
+    // Creates an instance of a speech config with specified subscription key and service region.
+    // Replace with your own subscription key and service region (e.g., "westus").
+    auto config = SpeechConfig::FromSubscription("YourSubscriptionKey", "YourServiceRegion");
+
+    // Creates and connects the synthesizers up front.
+    SpeechSynthesizerPool pool(config, 4);
+
+    // Receives the prompts from console input, one per line.
+    cout << "Enter the texts that you want to synthesize, one per line, and an empty text to start." << std::endl;
+    std::vector<std::string> texts;
+    while (true)
+    {
+        cout << "> ";
+        std::string text;
+        getline(cin, text);
+        if (text.empty())
+        {
+            break;
+        }
+        texts.push_back(text);
+    }
+
+    auto started = std::chrono::steady_clock::now();
+
+    // Submits all prompts at once, they are synthesized by up to pool.Size() synthesizers concurrently.
+    std::vector<SpeechSynthesizerPool::ResultFuture> results;
+    for (const auto& text : texts)
+    {
+        results.push_back(pool.SpeakTextAsync(text));
+    }
+
+    // Waits for the results in submission order.
+    for (size_t i = 0; i < results.size(); i++)
+    {
+        auto result = results[i].get();
+
+        // Checks result.
+        if (result->Reason == ResultReason::SynthesizingAudioCompleted)
+        {
+            cout << "Speech synthesized for text [" << texts[i] << "], " << result->GetAudioLength() << " bytes of audio." << std::endl;
+        }
+        else if (result->Reason == ResultReason::Canceled)
+        {
+            auto cancellation = SpeechSynthesisCancellationDetails::FromResult(result);
+            cout << "CANCELED: Reason=" << (int)cancellation->Reason << std::endl;
+
+            if (cancellation->Reason == CancellationReason::Error)
+            {
+                cout << "CANCELED: ErrorCode=" << (int)cancellation->ErrorCode << std::endl;
+                cout << "CANCELED: ErrorDetails=[" << cancellation->ErrorDetails << "]" << std::endl;
+                cout << "CANCELED: Did you update the subscription info?" << std::endl;
+            }
+        }
+    }
+
+    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - started);
+    cout << "Synthesized " << results.size() << " texts with " << pool.Size() << " synthesizers in " << elapsed.count() << " ms." << std::endl;
+}
+
+// Speech synthesis with a persistent cache of synthesized audio.
+void SpeechSynthesisWithCache()
+{
+    // Creates an instance of a speech config with specified subscription key and service region.
+    // Replace with your own subscription key and service region (e.g., "westus").
+    auto config = SpeechConfig::FromSubscription("YourSubscriptionKey", "YourServiceRegion");
+
+    // Creates a speech synthesizer with a null output stream, the audio is taken from the result.
+    auto synthesizer = SpeechSynthesizer::FromConfig(config, nullptr);
+
+    // Synthesized audio is kept in memory and in the synthesis_cache directory, so repeated texts
+    // are not synthesized again, also not after a restart of the sample.
+    SpeechSynthesisCache cache("synthesis_cache");
+
+    while (true)
+    {
+        // Receives a text from console input and synthesizes it, or takes it from the cache.
+        cout << "Enter some text that you want to synthesize, or enter empty text to exit." << std::endl;
+        cout << "> ";
+        std::string text;
+        getline(cin, text);
+        if (text.empty())
+        {
+            break;
+        }
+
+        auto started = std::chrono::steady_clock::now();
+        bool cached = cache.Find(SpeechSynthesisCache::KeyFor(*config, text, false)) != nullptr;
+        std::shared_ptr<SpeechSynthesisResult> failed;
+        auto audio = cache.Speak(*synthesizer, *config, text, false, &failed);
+        auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - started);
+
+        if (audio)
+        {
+            cout << "Speech " << (cached ? "taken from the cache" : "synthesized") << " for text [" << text << "] in "
+                << elapsed.count() << " us, " << audio->size() << " bytes of audio." << std::endl;
+
+            // Reads the audio the same way as from an audio data stream.
+            SpeechSynthesisCache::Stream stream(audio);
+            uint8_t buffer[16000];
+            uint32_t totalSize = 0;
+            uint32_t filledSize = 0;
+            while ((filledSize = stream.ReadData(buffer, sizeof(buffer))) > 0)
+            {
+                totalSize += filledSize;
+            }
+            cout << totalSize << " bytes read." << endl;
+        }
+        else
+        {
+            auto cancellation = SpeechSynthesisCancellationDetails::FromResult(failed);
+            cout << "CANCELED: Reason=" << (int)cancellation->Reason << std::endl;
+
+            if (cancellation->Reason == CancellationReason::Error)
+            {
+                cout << "CANCELED: ErrorCode=" << (int)cancellation->ErrorCode << std::endl;
+                cout << "CANCELED: ErrorDetails=[" << cancellation->ErrorDetails << "]" << std::endl;
+                cout << "CANCELED: Did you update the subscription info?" << std::endl;
+            }
+        }
+    }
+}
+
+// Speech synthesis of long text, sentence by sentence, into one push audio output stream.
+void SpeechSynthesisWithSentencePipelining()
+{
+    // Writes the stitched audio of all sentences to a file, as raw 16 kHz 16-bit mono PCM.
+    class RawFileOutputCallback : public PushAudioOutputStreamCallback
+    {
+    public:
+        RawFileOutputCallback(const std::string& fileName)
+            : m_file(fileName, std::ios::binary | std::ios::trunc)
+        {
+        }
+
+        int Write(uint8_t* dataBuffer, uint32_t size) override
+        {
+            m_file.write(reinterpret_cast<const char*>(dataBuffer), size);
+            return size;
+        }
+
+        void Close() override
+        {
+            m_file.close();
+        }
+
+    private:
+        std::ofstream m_file;
+    };
+
+    // Creates an instance of a speech config with specified subscription key and service region.
+    // Replace with your own subscription key and service region (e.g., "westus").
+    auto config = SpeechConfig::FromSubscription("YourSubscriptionKey", "YourServiceRegion");
+
+    // The audio of the sentences is concatenated, so it needs a format without a header.
+    config->SetSpeechSynthesisOutputFormat(SpeechSynthesisOutputFormat::Raw16Khz16BitMonoPcm);
+
+    // Up to three sentences are synthesized at once.
+    PipelinedSynthesizer synthesizer(config, 3);
+
+    while (true)
+    {
+        // Receives a text from console input and synthesizes it sentence by sentence.
+        cout << "Enter some long text that you want to synthesize, or enter empty text to exit." << std::endl;
+        cout << "> ";
+        std::string text;
+        getline(cin, text);
+        if (text.empty())
+        {
+            break;
+        }
+
+        auto fileName = "outputaudio.pcm";
+        RawFileOutputCallback output(fileName);
+        try
+        {
+            auto statistics = synthesizer.Speak(text, output);
+            cout << "Speech synthesized for " << statistics.Sentences << " sentences, and the audio was saved to [" << fileName << "]" << std::endl;
+            cout << "First audio after " << statistics.FirstAudio.count() << " ms, " << statistics.Bytes << " bytes in "
+                << statistics.Total.count() << " ms." << std::endl;
+        }
+        catch (const std::runtime_error& e)
+        {
+            cout << "CANCELED: " << e.what() << std::endl;
+            cout << "CANCELED: Did you update the subscription info?" << std::endl;
+        }
+    }
+}
+
+// Speech synthesis streamed from an audio data stream as the audio arrives, e.g. to a voice bot.
+void SpeechSynthesisToAudioDataStreamWithForwarding()
+{
+    // Creates an instance of a speech config with specified subscription key and service region.
+    // Replace with your own subscription key and service region (e.g., "westus").
+    auto config = SpeechConfig::FromSubscription("YourSubscriptionKey", "YourServiceRegion");
+
+    // Raw audio can be played by the receiver as it comes in, without waiting for a header.
+    config->SetSpeechSynthesisOutputFormat(SpeechSynthesisOutputFormat::Raw16Khz16BitMonoPcm);
+
+    // Creates a speech synthesizer with a null output stream, the audio is read from an audio data stream.
+    auto synthesizer = SpeechSynthesizer::FromConfig(config, nullptr);
+
+    // Opens the connection up front, so the first synthesis does not pay for the connection setup.
+    Connection::FromSpeechSynthesizer(synthesizer)->Open(false);
+
+    // Forwards the audio to a TCP endpoint, or only measures it when no endpoint is given.
+    cout << "Enter the host and port (e.g. localhost:9000) to send the audio to, or enter empty to discard it." << std::endl;
+    cout << "> ";
+    std::string endpoint;
+    getline(cin, endpoint);
+
+    std::unique_ptr<TcpAudioSink> socket;
+    if (!endpoint.empty())
+    {
+        auto separator = endpoint.rfind(':');
+        if (separator == std::string::npos)
+        {
+            cout << "The endpoint must be given as host:port." << std::endl;
+            return;
+        }
+        try
+        {
+            socket.reset(new TcpAudioSink(endpoint.substr(0, separator), endpoint.substr(separator + 1)));
+        }
+        catch (const std::runtime_error& e)
+        {
+            cout << e.what() << std::endl;
+            return;
+        }
+    }
+
+    while (true)
+    {
+        // Receives a text from console input and synthesize it to the audio data stream.
+        cout << "Enter some text that you want to synthesize, or enter empty text to exit." << std::endl;
+        cout << "> ";
+        std::string text;
+        getline(cin, text);
+        if (text.empty())
+        {
+            break;
+        }
+
+        AudioStreamForwarder::Statistics statistics;
+        auto stream = AudioStreamForwarder::Forward(*synthesizer, text,
+            [&socket](const uint8_t* data, uint32_t size) { return !socket || socket->Send(data, size); },
+            statistics);
+
+        // Checks result.
+        if (stream->GetStatus() == StreamStatus::Canceled)
+        {
+            auto cancellation = SpeechSynthesisCancellationDetails::FromStream(stream);
+            cout << "CANCELED: Reason=" << (int)cancellation->Reason << std::endl;
+
+            if (cancellation->Reason == CancellationReason::Error)
+            {
+                cout << "CANCELED: ErrorCode=" << (int)cancellation->ErrorCode << std::endl;
+                cout << "CANCELED: ErrorDetails=[" << cancellation->ErrorDetails << "]" << std::endl;
+                cout << "CANCELED: Did you update the subscription info?" << std::endl;
+            }
+        }
+        else
+        {
+            cout << "Speech synthesized for text [" << text << "]: time to first byte " << statistics.FirstByte.count() / 1000.0
+                << " ms, " << statistics.Bytes << " bytes in " << statistics.Chunks << " chunks, total "
+                << statistics.Total.count() / 1000.0 << " ms." << std::endl;
+        }
+    }
+}
+
+// Speech synthesis for clients on links of different bandwidth, each in the output format chosen for its link:
+// compact MP3 or Opus for slow links, PCM that needs no decoding for fast ones.
+void SpeechSynthesisWithAdaptiveOutputFormat()
+{
+    // Creates an instance of a speech config with specified subscription key and service region.
+    // Replace with your own subscription key and service region (e.g., "westus").
+    auto config = SpeechConfig::FromSubscription("YourSubscriptionKey", "YourServiceRegion");
+
+    // Uses the measurements of "sample --formats" if there are any, else measures the formats now.
+    vector<SynthesisFormatSelector::Candidate> measured;
+    try
+    {
+        ifstream report("format_report.json");
+        if (report)
+        {
+            measured = SynthesisFormatSelector::FromJson(nlohmann::json::parse(report).at("formats"));
+        }
+        if (measured.empty())
+        {
+            cout << "Measuring the synthesis output formats..." << std::endl;
+            measured = SynthesisFormatSelector::Measure(config, SynthesisFormatSelector::DefaultCandidates(), "What's the weather like?", 1);
+        }
+    }
+    catch (const exception& e)
+    {
+        cout << "Exit due to exception: " << e.what() << endl;
+        return;
+    }
+    SynthesisFormatSelector selector(measured);
+
+    // Replace with the bandwidth measured for each client, e.g. from how fast its previous responses were delivered.
+    const vector<pair<string, double>> clients{ { "mobile", 12000 }, { "broadband", 250000 }, { "lan", 10000000 } };
+    const string text = "What's the weather like?";
+    for (const auto& client : clients)
+    {
+        // A config per client, since the output format is a property of the config.
+        auto clientConfig = SpeechConfig::FromSubscription("YourSubscriptionKey", "YourServiceRegion");
+        const auto& format = selector.Apply(*clientConfig, client.second);
+        auto synthesizer = SpeechSynthesizer::FromConfig(clientConfig, nullptr);
+        auto result = synthesizer->SpeakTextAsync(text).get();
+        if (result->Reason == ResultReason::Canceled)
+        {
+            auto cancellation = SpeechSynthesisCancellationDetails::FromResult(result);
+            cout << "CANCELED: ErrorCode=" << (int)cancellation->ErrorCode << std::endl;
+            cout << "CANCELED: ErrorDetails=[" << cancellation->ErrorDetails << "]" << std::endl;
+            return;
+        }
+
+        // The extension is the last part of the format name, e.g. "mp3" or "opus".
+        auto fileName = "outputaudio_" + client.first + "." + format.Name.substr(format.Name.rfind('-') + 1);
+        auto audioData = result->GetAudioData();
+        ofstream(fileName, ios_base::binary).write((const char*)audioData->data(), audioData->size());
+        cout << client.first << " (" << (uint64_t)client.second << " bytes/s): " << format.Name << ", "
+             << audioData->size() << " bytes saved to [" << fileName << "]" << std::endl;
+    }
+}
+
+// Speech synthesis of a long text file, e.g. an audiobook, paragraph by paragraph into one WAV file that is written
+// while the audio is produced, so memory does not grow with the length of the audio.
+void SpeechSynthesisOfLongTextToWaveFile()
+{
+    // Creates an instance of a speech config with specified subscription key and service region.
+    // Replace with your own subscription key and service region (e.g., "westus").
+    auto config = SpeechConfig::FromSubscription("YourSubscriptionKey", "YourServiceRegion");
+    const string voice = "en-US-JennyNeural";
+
+    // The audio of the paragraphs is concatenated, so it needs a format without a header; the writer adds one.
+    config->SetSpeechSynthesisOutputFormat(SpeechSynthesisOutputFormat::Raw24Khz16BitMonoPcm);
+
+    cout << "Enter the name of a text file to synthesize, with paragraphs separated by empty lines." << std::endl;
+    cout << "> ";
+    std::string textFileName;
+    getline(cin, textFileName);
+    ifstream textFile(textFileName);
+    if (!textFile)
+    {
+        cout << "Cannot open [" << textFileName << "]" << std::endl;
+        return;
+    }
+
+    auto fileName = "outputaudio_long.wav";
+    shared_ptr<StreamingWavFileWriter> writer;
+    try
+    {
+        writer = make_shared<StreamingWavFileWriter>(fileName, 24000, 16, 1);
+    }
+    catch (const exception& e)
+    {
+        cout << "Exit due to exception: " << e.what() << endl;
+        return;
+    }
+    auto synthesizer = SpeechSynthesizer::FromConfig(config, AudioConfig::FromStreamOutput(AudioOutputStream::CreatePushStream(writer)));
+
+    // Synthesizes one paragraph per SpeakSsmlAsync(), so at most one paragraph of audio is held by its result.
+    auto speak = [&synthesizer, &voice](const string& paragraph)
+    {
+        string ssml = "<speak version='1.0' xmlns='http://www.w3.org/2001/10/synthesis' xml:lang='en-US'><voice name='" + voice + "'>";
+        for (auto c : paragraph)
+        {
+            switch (c)
+            {
+            case '&': ssml += "&amp;"; break;
+            case '<': ssml += "&lt;"; break;
+            case '>': ssml += "&gt;"; break;
+            default: ssml += c; break;
+            }
+        }
+        auto result = synthesizer->SpeakSsmlAsync(ssml + "</voice></speak>").get();
+        if (result->Reason == ResultReason::Canceled)
+        {
+            auto cancellation = SpeechSynthesisCancellationDetails::FromResult(result);
+            cout << "CANCELED: ErrorCode=" << (int)cancellation->ErrorCode << std::endl;
+            cout << "CANCELED: ErrorDetails=[" << cancellation->ErrorDetails << "]" << std::endl;
+            return false;
+        }
+        return true;
+    };
+
+    size_t paragraphs = 0;
+    string paragraph;
+    string line;
+    bool completed = true;
+    while (completed && getline(textFile, line))
+    {
+        if (line.find_first_not_of(" \t\r") != string::npos)
+        {
+            paragraph += (paragraph.empty() ? "" : " ") + line;
+            continue;
+        }
+        if (!paragraph.empty())
+        {
+            completed = speak(paragraph);
+            paragraph.clear();
+            cout << "Paragraph " << ++paragraphs << ": " << writer->GetStatistics().DataBytes << " bytes of audio, peak memory "
+                 << GetPeakResidentSetSize() / (1024 * 1024) << " MB" << std::endl;
+        }
+    }
+    if (completed && !paragraph.empty())
+    {
+        completed = speak(paragraph);
+        paragraphs++;
+    }
+
+    try
+    {
+        auto statistics = writer->Finish();
+        cout << "Speech synthesized for " << paragraphs << " paragraphs, " << statistics.DataBytes << " bytes of audio saved to ["
+             << fileName << "]" << (statistics.Rf64 ? " as RF64" : "") << " in " << statistics.FileWrites << " writes." << std::endl;
+    }
+    catch (const exception& e)
+    {
+        cout << "Exit due to exception: " << e.what() << endl;
+    }
+}
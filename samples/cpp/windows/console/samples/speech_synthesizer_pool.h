@@ -0,0 +1,148 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#pragma once
+
+#include <speechapi_cxx.h>
+#include <condition_variable>
+#include <deque>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Pool of speech synthesizers that are connected up front and kept warm, so a queue of prompts is
+// synthesized by several synthesizers at once instead of one round trip after the other.
+// Jobs are handed out in submission order to the next idle synthesizer. Each call returns a future of
+// the result, so waiting on the futures in the order they were returned yields the results in submission order.
+// The synthesizers have no audio output, the audio is taken from the results.
+class SpeechSynthesizerPool final
+{
+public:
+    using ResultFuture = std::future<std::shared_ptr<Microsoft::CognitiveServices::Speech::SpeechSynthesisResult>>;
+
+    SpeechSynthesizerPool(const std::shared_ptr<Microsoft::CognitiveServices::Speech::SpeechConfig>& config, size_t size)
+    {
+        using namespace Microsoft::CognitiveServices::Speech;
+
+        if (size == 0)
+        {
+            throw std::invalid_argument("The pool needs at least one synthesizer.");
+        }
+
+        for (size_t i = 0; i < size; i++)
+        {
+            auto synthesizer = SpeechSynthesizer::FromConfig(config, nullptr);
+
+            // Opens the connection now, so the first job does not pay for connection setup.
+            auto connection = Connection::FromSpeechSynthesizer(synthesizer);
+            connection->Open(false);
+
+            m_synthesizers.push_back(synthesizer);
+            m_connections.push_back(connection);
+        }
+
+        // Workers start after all synthesizers exist, so a failing connection does not leave threads behind.
+        for (auto& synthesizer : m_synthesizers)
+        {
+            m_workers.emplace_back([this, synthesizer]() { Worker(synthesizer); });
+        }
+    }
+
+    SpeechSynthesizerPool(const SpeechSynthesizerPool&) = delete;
+    SpeechSynthesizerPool& operator=(const SpeechSynthesizerPool&) = delete;
+
+    // Finishes the jobs already submitted, then closes the synthesizers.
+    ~SpeechSynthesizerPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stopping = true;
+        }
+        m_jobAvailable.notify_all();
+        for (auto& worker : m_workers)
+        {
+            worker.join();
+        }
+    }
+
+    ResultFuture SpeakTextAsync(const std::string& text)
+    {
+        return Enqueue(text, false);
+    }
+
+    ResultFuture SpeakSsmlAsync(const std::string& ssml)
+    {
+        return Enqueue(ssml, true);
+    }
+
+    size_t Size() const
+    {
+        return m_synthesizers.size();
+    }
+
+private:
+    struct Job
+    {
+        std::string Input;
+        bool IsSsml;
+        std::promise<std::shared_ptr<Microsoft::CognitiveServices::Speech::SpeechSynthesisResult>> Result;
+    };
+
+    ResultFuture Enqueue(const std::string& input, bool isSsml)
+    {
+        Job job{ input, isSsml, {} };
+        auto future = job.Result.get_future();
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (m_stopping)
+            {
+                throw std::logic_error("The synthesizer pool is shutting down.");
+            }
+            m_jobs.push_back(std::move(job));
+        }
+        m_jobAvailable.notify_one();
+        return future;
+    }
+
+    void Worker(std::shared_ptr<Microsoft::CognitiveServices::Speech::SpeechSynthesizer> synthesizer)
+    {
+        while (true)
+        {
+            Job job;
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                m_jobAvailable.wait(lock, [this]() { return m_stopping || !m_jobs.empty(); });
+                if (m_jobs.empty())
+                {
+                    return;
+                }
+                job = std::move(m_jobs.front());
+                m_jobs.pop_front();
+            }
+
+            try
+            {
+                auto result = job.IsSsml ? synthesizer->SpeakSsmlAsync(job.Input).get() : synthesizer->SpeakTextAsync(job.Input).get();
+                job.Result.set_value(result);
+            }
+            catch (...)
+            {
+                job.Result.set_exception(std::current_exception());
+            }
+        }
+    }
+
+    std::vector<std::shared_ptr<Microsoft::CognitiveServices::Speech::SpeechSynthesizer>> m_synthesizers;
+    std::vector<std::shared_ptr<Microsoft::CognitiveServices::Speech::Connection>> m_connections;
+    std::vector<std::thread> m_workers;
+
+    std::mutex m_mutex;
+    std::condition_variable m_jobAvailable;
+    std::deque<Job> m_jobs;
+    bool m_stopping = false;
+};
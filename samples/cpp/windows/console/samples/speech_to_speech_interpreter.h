@@ -0,0 +1,264 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#pragma once
+
+#include <speechapi_cxx.h>
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Speaks the final translations of a translation recognizer while it goes on recognizing, with one lane per target
+// language. Each lane has its own connected synthesizer and thread, so the translation of an utterance is being
+// synthesized while the next utterance is recognized, and a slow language does not hold back the others. Within a
+// lane the utterances are spoken in the order they were recognized, one after the other into the output of the lane.
+// The output format must be headerless (raw PCM or a compressed format), so the audio of the utterances can be
+// concatenated in one stream.
+class SpeechToSpeechInterpreter final
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    struct Lane
+    {
+        // Target language as in the translations of the results, e.g. "de".
+        std::string Language;
+        // Voice name, e.g. "de-DE-KatjaNeural". Its locale goes into the SSML.
+        std::string Voice;
+        // Receives the audio of the lane and is closed by Finish().
+        std::shared_ptr<Microsoft::CognitiveServices::Speech::Audio::PushAudioOutputStreamCallback> Output;
+    };
+
+    struct Statistics
+    {
+        std::string Language;
+        uint32_t Utterances = 0;
+        uint32_t Failures = 0;
+        uint64_t Bytes = 0;
+        // From the final translation to the first audio of it: the delay the lane adds to the interpretation,
+        // including the time the utterance waited for the ones before it.
+        std::chrono::milliseconds MeanDelay{ 0 };
+        std::chrono::milliseconds MaxDelay{ 0 };
+    };
+
+    // Connects one synthesizer per lane. Throws std::invalid_argument for a Riff output format, which puts a
+    // header in front of every utterance.
+    SpeechToSpeechInterpreter(const std::shared_ptr<Microsoft::CognitiveServices::Speech::SpeechConfig>& synthesisConfig, const std::vector<Lane>& lanes)
+    {
+        using namespace Microsoft::CognitiveServices::Speech;
+
+        auto format = synthesisConfig->GetSpeechSynthesisOutputFormat();
+        if (format.empty() || format.compare(0, 5, "riff-") == 0)
+        {
+            throw std::invalid_argument("Speech to speech interpretation requires a headerless output format, e.g. Raw16Khz16BitMonoPcm.");
+        }
+
+        for (const auto& lane : lanes)
+        {
+            auto state = std::make_unique<LaneState>();
+            state->Settings = lane;
+            state->Totals.Language = lane.Language;
+            state->Synthesizer = SpeechSynthesizer::FromConfig(synthesisConfig, nullptr);
+            Connection::FromSpeechSynthesizer(state->Synthesizer)->Open(false);
+            m_lanes[lane.Language] = std::move(state);
+        }
+        for (auto& lane : m_lanes)
+        {
+            auto state = lane.second.get();
+            state->Thread = std::thread([state]() { Run(*state); });
+        }
+    }
+
+    SpeechToSpeechInterpreter(const SpeechToSpeechInterpreter&) = delete;
+    SpeechToSpeechInterpreter& operator=(const SpeechToSpeechInterpreter&) = delete;
+
+    ~SpeechToSpeechInterpreter()
+    {
+        Finish();
+    }
+
+    // Speaks the translations of every final result of 'recognizer' into the lanes of their languages.
+    // The interpreter must outlive the recognizer callbacks.
+    void Attach(Microsoft::CognitiveServices::Speech::Translation::TranslationRecognizer& recognizer)
+    {
+        using namespace Microsoft::CognitiveServices::Speech;
+        using namespace Microsoft::CognitiveServices::Speech::Translation;
+
+        recognizer.Recognized.Connect([this](const TranslationRecognitionEventArgs& e)
+        {
+            if (e.Result->Reason == ResultReason::TranslatedSpeech)
+            {
+                for (const auto& translation : e.Result->Translations)
+                {
+                    Speak(translation.first, translation.second);
+                }
+            }
+        });
+    }
+
+    // Queues 'text' in the lane of 'language' and returns right away. Text for a language without a lane is ignored.
+    void Speak(const std::string& language, const std::string& text)
+    {
+        auto lane = m_lanes.find(language);
+        if (lane == m_lanes.end() || text.empty())
+        {
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> lock(lane->second->Mutex);
+            lane->second->Queue.push_back({ text, Clock::now() });
+        }
+        lane->second->Changed.notify_one();
+    }
+
+    // Waits until the queued utterances are spoken and closes the outputs of the lanes.
+    void Finish()
+    {
+        for (auto& lane : m_lanes)
+        {
+            {
+                std::lock_guard<std::mutex> lock(lane.second->Mutex);
+                lane.second->Finishing = true;
+            }
+            lane.second->Changed.notify_one();
+        }
+        for (auto& lane : m_lanes)
+        {
+            if (lane.second->Thread.joinable())
+            {
+                lane.second->Thread.join();
+            }
+        }
+    }
+
+    std::vector<Statistics> GetStatistics()
+    {
+        std::vector<Statistics> statistics;
+        for (auto& lane : m_lanes)
+        {
+            std::lock_guard<std::mutex> lock(lane.second->Mutex);
+            statistics.push_back(lane.second->Totals);
+        }
+        return statistics;
+    }
+
+private:
+    struct Utterance
+    {
+        std::string Text;
+        Clock::time_point Queued;
+    };
+
+    struct LaneState
+    {
+        Lane Settings;
+        std::shared_ptr<Microsoft::CognitiveServices::Speech::SpeechSynthesizer> Synthesizer;
+        std::mutex Mutex;
+        std::condition_variable Changed;
+        std::deque<Utterance> Queue;
+        bool Finishing = false;
+        Statistics Totals;
+        std::chrono::milliseconds TotalDelay{ 0 };
+        std::thread Thread;
+    };
+
+    static void Run(LaneState& lane)
+    {
+        std::unique_lock<std::mutex> lock(lane.Mutex);
+        for (;;)
+        {
+            lane.Changed.wait(lock, [&lane] { return lane.Finishing || !lane.Queue.empty(); });
+            if (lane.Queue.empty())
+            {
+                break;
+            }
+            auto utterance = std::move(lane.Queue.front());
+            lane.Queue.pop_front();
+            lock.unlock();
+
+            uint64_t bytes = 0;
+            Clock::time_point firstAudio;
+            auto completed = false;
+            try
+            {
+                completed = Synthesize(lane, utterance.Text, bytes, firstAudio);
+            }
+            catch (const std::exception&)
+            {
+                // Counted as a failure, the lane goes on with the next utterance.
+            }
+
+            lock.lock();
+            lane.Totals.Bytes += bytes;
+            if (!completed)
+            {
+                lane.Totals.Failures++;
+            }
+            if (bytes > 0)
+            {
+                auto delay = std::chrono::duration_cast<std::chrono::milliseconds>(firstAudio - utterance.Queued);
+                lane.Totals.Utterances++;
+                lane.TotalDelay += delay;
+                lane.Totals.MeanDelay = lane.TotalDelay / lane.Totals.Utterances;
+                lane.Totals.MaxDelay = std::max(lane.Totals.MaxDelay, delay);
+            }
+        }
+        lock.unlock();
+        lane.Settings.Output->Close();
+    }
+
+    // Streams the audio into the output of the lane as the service sends it. Returns false if the synthesis was canceled.
+    static bool Synthesize(LaneState& lane, const std::string& text, uint64_t& bytes, Clock::time_point& firstAudio)
+    {
+        using namespace Microsoft::CognitiveServices::Speech;
+
+        auto result = lane.Synthesizer->StartSpeakingSsmlAsync(BuildSsml(lane.Settings.Voice, text)).get();
+        auto stream = AudioDataStream::FromResult(result);
+
+        uint8_t buffer[4096];
+        uint32_t filledSize = 0;
+        while ((filledSize = stream->ReadData(buffer, sizeof(buffer))) > 0)
+        {
+            if (bytes == 0)
+            {
+                firstAudio = Clock::now();
+            }
+            lane.Settings.Output->Write(buffer, filledSize);
+            bytes += filledSize;
+        }
+        return stream->GetStatus() != StreamStatus::Canceled;
+    }
+
+    static std::string BuildSsml(const std::string& voice, const std::string& text)
+    {
+        // The locale is the start of the voice name, e.g. "de-DE" of "de-DE-KatjaNeural".
+        auto localeEnd = voice.find('-', voice.find('-') + 1);
+        auto locale = localeEnd == std::string::npos ? voice : voice.substr(0, localeEnd);
+
+        std::string ssml = "<speak version='1.0' xmlns='http://www.w3.org/2001/10/synthesis' xml:lang='" + locale + "'><voice name='" + voice + "'>";
+        for (auto c : text)
+        {
+            switch (c)
+            {
+            case '&': ssml += "&amp;"; break;
+            case '<': ssml += "&lt;"; break;
+            case '>': ssml += "&gt;"; break;
+            case '\'': ssml += "&apos;"; break;
+            case '"': ssml += "&quot;"; break;
+            default: ssml += c; break;
+            }
+        }
+        return ssml + "</voice></speak>";
+    }
+
+    std::map<std::string, std::unique_ptr<LaneState>> m_lanes;
+};
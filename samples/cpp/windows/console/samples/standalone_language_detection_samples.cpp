@@ -7,8 +7,10 @@
 
 // <toplevel>
 #include <speechapi_cxx.h>
+#include <chrono>
 #include <fstream>
 #include "wav_file_reader.h"
+#include "archive_language_router.h"
 
 using namespace std;
 using namespace Microsoft::CognitiveServices::Speech;
@@ -252,3 +254,67 @@ void StandaloneLanguageDetectionInContinuousModeWithMultiLingualFileInput()
     recognizer->StopContinuousRecognitionAsync().get();
     // </StandaloneLanguageDetectionInContinuousModeWithMultiLingualFileInput>
 }
+
+// Standalone language detection over an archive of files, sampling windows of each file concurrently to route
+// whole files to the transcription queue of their language.
+void StandaloneLanguageDetectionForArchiveRouting()
+{
+    // Creates an instance of a speech config with specified subscription key and service region.
+    // Replace with your own subscription key and service region (e.g., "westus").
+    auto config = SpeechConfig::FromSubscription("YourSubscriptionKey", "YourServiceRegion");
+
+    // Each window is classified once, so latency matters less than accuracy.
+    config->SetProperty(PropertyId::SpeechServiceConnection_SingleLanguageIdPriority, "Accuracy");
+    auto autoDetectSourceLanguageConfig = AutoDetectSourceLanguageConfig::FromLanguages({ "en-US", "zh-CN" });
+
+    // Replace with the files of your archive.
+    const vector<string> files = { "en-us_zh-cn.wav", "whatstheweatherlike.wav", "LanguageDetection_enUS.wav" };
+    const string cacheFile = "language_verdicts.tsv";
+
+    ArchiveLanguageRouter::Settings settings;
+    settings.WindowMs = 4000;
+    settings.WindowsPerFile = 4;
+    settings.MaxConcurrent = 8;
+    ArchiveLanguageRouter router(config, autoDetectSourceLanguageConfig, settings);
+
+    // Files routed by an earlier run are not sampled again.
+    {
+        ifstream cache(cacheFile);
+        router.LoadCache(cache);
+    }
+
+    auto started = chrono::steady_clock::now();
+    auto verdicts = router.Classify(files);
+    auto elapsed = chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - started);
+
+    for (const auto& verdict : verdicts)
+    {
+        cout << verdict.File << ": ";
+        if (!verdict.Error.empty())
+        {
+            cout << "ERROR " << verdict.Error << std::endl;
+            continue;
+        }
+        cout << verdict.Queue() << (verdict.Cached ? " (cached)" : "") << ", windows";
+        for (const auto& language : verdict.Windows)
+        {
+            cout << " " << language.first << "=" << language.second;
+        }
+        cout << std::endl;
+    }
+    cout << "Classified " << files.size() << " files in " << elapsed.count() << " ms." << std::endl;
+
+    // Writes one queue file per language, for the transcription workers of that language.
+    for (const auto& queue : ArchiveLanguageRouter::GroupByQueue(verdicts))
+    {
+        ofstream out("queue_" + queue.first + ".txt");
+        for (const auto& file : queue.second)
+        {
+            out << file << '\n';
+        }
+        cout << "Queue " << queue.first << ": " << queue.second.size() << " file(s)" << std::endl;
+    }
+
+    ofstream cache(cacheFile);
+    router.SaveCache(cache);
+}
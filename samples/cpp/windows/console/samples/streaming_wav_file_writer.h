@@ -0,0 +1,214 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#pragma once
+
+#include <speechapi_cxx.h>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// Writes the audio of a synthesizer to a WAV file while it is produced, through a fixed-size buffer, so memory stays
+// flat whatever the length of the audio; e.g. a multi-hour audiobook. Use it with
+// AudioOutputStream::CreatePushStream() and a raw PCM output format (e.g. Raw24Khz16BitMonoPcm), and synthesize the
+// text in pieces with as many SpeakSsmlAsync() calls as needed: their audio is concatenated into the one file.
+// The header is written with sizes of zero and patched by Finish(). A 28-byte 'JUNK' chunk after the RIFF header
+// reserves the room of a 'ds64' chunk, so audio beyond the 4 GB RIFF limit is finished as an RF64 file in place.
+class StreamingWavFileWriter final : public Microsoft::CognitiveServices::Speech::Audio::PushAudioOutputStreamCallback
+{
+public:
+    struct Statistics
+    {
+        uint64_t DataBytes = 0;
+        // Writes to the file, each of 'bufferSize' bytes except the last.
+        uint64_t FileWrites = 0;
+        bool Rf64 = false;
+    };
+
+    // Creates (or truncates) the file and writes the placeholder header. Throws std::runtime_error if the file cannot
+    // be written.
+    StreamingWavFileWriter(const std::string& fileName, uint32_t samplesPerSecond, uint16_t bitsPerSample, uint16_t channels,
+        size_t bufferSize = 64 * 1024)
+        : m_fileName(fileName), m_samplesPerSecond(samplesPerSecond), m_bitsPerSample(bitsPerSample), m_channels(channels),
+          m_file(fileName, std::ios::binary | std::ios::trunc)
+    {
+        if (bufferSize == 0 || bitsPerSample % 8 != 0 || channels == 0)
+        {
+            throw std::invalid_argument("The WAV writer needs a buffer and whole-byte samples of at least one channel.");
+        }
+        m_buffer.reserve(bufferSize);
+        WriteHeader(0);
+        if (!m_file)
+        {
+            throw std::runtime_error("Cannot write " + m_fileName);
+        }
+    }
+
+    StreamingWavFileWriter(const StreamingWavFileWriter&) = delete;
+    StreamingWavFileWriter& operator=(const StreamingWavFileWriter&) = delete;
+
+    ~StreamingWavFileWriter()
+    {
+        try
+        {
+            Finish();
+        }
+        catch (const std::exception&)
+        {
+            // The error was reported by Finish() if it was called; a destructor cannot report it.
+        }
+    }
+
+    // Called by the SDK with each chunk of audio as it is synthesized.
+    int Write(uint8_t* dataBuffer, uint32_t size) override
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_finished)
+        {
+            return 0;
+        }
+        auto position = dataBuffer;
+        auto remaining = (size_t)size;
+        while (remaining > 0)
+        {
+            auto count = std::min(remaining, m_buffer.capacity() - m_buffer.size());
+            m_buffer.insert(m_buffer.end(), position, position + count);
+            position += count;
+            remaining -= count;
+            if (m_buffer.size() == m_buffer.capacity())
+            {
+                Flush();
+            }
+        }
+        m_statistics.DataBytes += size;
+        return (int)size;
+    }
+
+    // Called by the SDK when the synthesizer releases the stream. Writes the buffer out; the file stays open for
+    // more audio until Finish().
+    void Close() override
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!m_finished)
+        {
+            Flush();
+        }
+    }
+
+    // Writes the rest of the audio, patches the header with the final sizes (as RF64 when needed) and closes the
+    // file. Call it after the last synthesis has completed; later calls do nothing, later audio is dropped.
+    // Throws std::runtime_error if writing the file failed at any point.
+    Statistics Finish()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!m_finished)
+        {
+            m_finished = true;
+            Flush();
+            // Chunks are word aligned, an odd sized data chunk is followed by a pad byte.
+            if (m_statistics.DataBytes % 2 != 0)
+            {
+                m_file.put(0);
+            }
+            m_file.seekp(0);
+            WriteHeader(m_statistics.DataBytes);
+            m_file.close();
+            if (m_file.fail())
+            {
+                m_failed = true;
+            }
+        }
+        if (m_failed)
+        {
+            throw std::runtime_error("Cannot write " + m_fileName);
+        }
+        return m_statistics;
+    }
+
+    Statistics GetStatistics()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_statistics;
+    }
+
+private:
+    // RIFF header, 'JUNK' or 'ds64' chunk, 'fmt ' chunk and the header of the 'data' chunk.
+    static constexpr size_t headerSize = 12 + 8 + 28 + 8 + 16 + 8;
+
+    void Flush()
+    {
+        if (!m_buffer.empty())
+        {
+            m_file.write(reinterpret_cast<const char*>(m_buffer.data()), (std::streamsize)m_buffer.size());
+            m_statistics.FileWrites++;
+            m_buffer.clear();
+        }
+        if (m_file.fail())
+        {
+            m_failed = true;
+        }
+    }
+
+    void WriteHeader(uint64_t dataBytes)
+    {
+        uint8_t header[headerSize];
+        auto position = header;
+        auto put = [&position](uint64_t value, size_t bytes)
+        {
+            for (size_t i = 0; i < bytes; i++)
+            {
+                *position++ = (uint8_t)(value >> (8 * i));
+            }
+        };
+        auto tag = [&position](const char* name)
+        {
+            memcpy(position, name, 4);
+            position += 4;
+        };
+
+        auto riffBytes = headerSize - 8 + dataBytes + dataBytes % 2;
+        m_statistics.Rf64 = riffBytes > UINT32_MAX;
+        auto blockAlign = (uint16_t)(m_channels * m_bitsPerSample / 8);
+
+        tag(m_statistics.Rf64 ? "RF64" : "RIFF");
+        put(m_statistics.Rf64 ? UINT32_MAX : riffBytes, 4);
+        tag("WAVE");
+        // The 'ds64' chunk (EBU Tech 3306) has the 64-bit sizes and an empty table of other chunk sizes.
+        tag(m_statistics.Rf64 ? "ds64" : "JUNK");
+        put(28, 4);
+        put(m_statistics.Rf64 ? riffBytes : 0, 8);
+        put(m_statistics.Rf64 ? dataBytes : 0, 8);
+        put(m_statistics.Rf64 ? dataBytes / blockAlign : 0, 8);
+        put(0, 4);
+        tag("fmt ");
+        put(16, 4);
+        put(1, 2); // PCM
+        put(m_channels, 2);
+        put(m_samplesPerSecond, 4);
+        put((uint64_t)m_samplesPerSecond * blockAlign, 4);
+        put(blockAlign, 2);
+        put(m_bitsPerSample, 2);
+        tag("data");
+        put(m_statistics.Rf64 ? UINT32_MAX : dataBytes, 4);
+        m_file.write(reinterpret_cast<const char*>(header), sizeof(header));
+    }
+
+    const std::string m_fileName;
+    const uint32_t m_samplesPerSecond;
+    const uint16_t m_bitsPerSample;
+    const uint16_t m_channels;
+
+    std::mutex m_mutex;
+    std::ofstream m_file;
+    // Filled up to its capacity, then written to the file in one piece.
+    std::vector<uint8_t> m_buffer;
+    Statistics m_statistics;
+    bool m_finished = false;
+    bool m_failed = false;
+};
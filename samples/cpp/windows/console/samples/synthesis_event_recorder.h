@@ -0,0 +1,268 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#pragma once
+
+#include <speechapi_cxx.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <functional>
+#include <initializer_list>
+#include <memory>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+// A word boundary, viseme or bookmark event of a synthesizer, copied into a fixed-size slot.
+struct SynthesisEvent
+{
+    enum class Kind : uint8_t { WordBoundary, Viseme, Bookmark };
+
+    Kind Type;
+    // In ticks of 100 nanoseconds from the start of the audio.
+    uint64_t AudioOffset;
+    // Word boundary only.
+    uint32_t TextOffset;
+    uint32_t WordLength;
+    // Viseme only.
+    uint32_t VisemeId;
+    // When the event was received, relative to the creation of the recorder.
+    std::chrono::steady_clock::duration Received;
+    // Bookmark only, truncated to fit.
+    char Text[40];
+};
+
+// Bounded ring of events for exactly one producer thread and one consumer thread, without locks.
+// The producer never blocks: when the ring is full, TryPush() fails and the caller drops the event.
+template <class T>
+class SingleProducerRing final
+{
+public:
+    // 'capacity' is rounded up to a power of two.
+    explicit SingleProducerRing(size_t capacity)
+    {
+        size_t size = 1;
+        while (size < capacity)
+        {
+            size *= 2;
+        }
+        m_slots.resize(size);
+        m_mask = size - 1;
+    }
+
+    bool TryPush(const T& value)
+    {
+        auto tail = m_tail.load(std::memory_order_relaxed);
+        if (tail - m_head.load(std::memory_order_acquire) == m_slots.size())
+        {
+            return false;
+        }
+        m_slots[tail & m_mask] = value;
+        m_tail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool TryPop(T& value)
+    {
+        auto head = m_head.load(std::memory_order_relaxed);
+        if (head == m_tail.load(std::memory_order_acquire))
+        {
+            return false;
+        }
+        value = m_slots[head & m_mask];
+        m_head.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool Empty() const
+    {
+        return m_head.load(std::memory_order_acquire) == m_tail.load(std::memory_order_acquire);
+    }
+
+private:
+    std::vector<T> m_slots;
+    size_t m_mask;
+    // Head and tail only grow, their difference is the number of queued values.
+    // They are on separate cache lines, so producer and consumer do not slow each other down.
+    alignas(64) std::atomic<size_t> m_head{ 0 };
+    alignas(64) std::atomic<size_t> m_tail{ 0 };
+};
+
+// Records word boundary, viseme and bookmark events of a synthesizer without doing any I/O on the SDK
+// callback thread. The handlers only copy the event into a preallocated ring. A background thread
+// hands the events to the consumer, e.g. for lip sync or an alignment export. The synthesizer raises
+// its events on one thread, which makes it the single producer of the ring.
+class SynthesisEventRecorder final
+{
+public:
+    using Clock = std::chrono::steady_clock;
+    using Consumer = std::function<void(const SynthesisEvent&)>;
+
+    struct Statistics
+    {
+        uint64_t WordBoundaries = 0;
+        uint64_t Visemes = 0;
+        uint64_t Bookmarks = 0;
+        // Events lost because the consumer fell behind by more than the ring capacity.
+        uint64_t Dropped = 0;
+        // Longest time an event handler took on the callback thread.
+        std::chrono::microseconds MaxHandlerTime{ 0 };
+        // Longest time from receiving an event until the consumer got it.
+        std::chrono::microseconds MaxDeliveryDelay{ 0 };
+    };
+
+    SynthesisEventRecorder(Consumer consumer, size_t capacity = 8192)
+        : m_consumer(std::move(consumer)), m_ring(capacity), m_start(Clock::now())
+    {
+        if (!m_consumer)
+        {
+            throw std::invalid_argument("The recorder needs a consumer.");
+        }
+        m_thread = std::thread([this]() { Consume(); });
+    }
+
+    SynthesisEventRecorder(const SynthesisEventRecorder&) = delete;
+    SynthesisEventRecorder& operator=(const SynthesisEventRecorder&) = delete;
+
+    // Delivers the remaining events and stops the consumer thread.
+    ~SynthesisEventRecorder()
+    {
+        m_stopping = true;
+        m_thread.join();
+    }
+
+    // Subscribes to the events of the given kinds, the consumer gets only those. Subscribing to an event also
+    // has the service send it, so kinds nobody consumes are left out. The recorder must outlive the synthesizer,
+    // whose event handlers write into it: declare the recorder first, so the synthesizer is destroyed before it.
+    void Attach(Microsoft::CognitiveServices::Speech::SpeechSynthesizer& synthesizer, std::initializer_list<SynthesisEvent::Kind> kinds)
+    {
+        using namespace Microsoft::CognitiveServices::Speech;
+
+        auto wanted = [&kinds](SynthesisEvent::Kind kind) { return std::find(kinds.begin(), kinds.end(), kind) != kinds.end(); };
+        if (wanted(SynthesisEvent::Kind::WordBoundary))
+        {
+            synthesizer.WordBoundary.Connect([this](const SpeechSynthesisWordBoundaryEventArgs& e)
+            {
+                auto received = Clock::now();
+                SynthesisEvent event = {};
+                event.Type = SynthesisEvent::Kind::WordBoundary;
+                event.AudioOffset = e.AudioOffset;
+                event.TextOffset = e.TextOffset;
+                event.WordLength = e.WordLength;
+                Record(event, received, m_wordBoundaries);
+            });
+        }
+        if (wanted(SynthesisEvent::Kind::Viseme))
+        {
+            synthesizer.VisemeReceived.Connect([this](const SpeechSynthesisVisemeEventArgs& e)
+            {
+                auto received = Clock::now();
+                SynthesisEvent event = {};
+                event.Type = SynthesisEvent::Kind::Viseme;
+                event.AudioOffset = e.AudioOffset;
+                event.VisemeId = e.VisemeId;
+                Record(event, received, m_visemes);
+            });
+        }
+        if (wanted(SynthesisEvent::Kind::Bookmark))
+        {
+            synthesizer.BookmarkReached.Connect([this](const SpeechSynthesisBookmarkEventArgs& e)
+            {
+                auto received = Clock::now();
+                SynthesisEvent event = {};
+                event.Type = SynthesisEvent::Kind::Bookmark;
+                event.AudioOffset = e.AudioOffset;
+                strncpy(event.Text, e.Text.c_str(), sizeof(event.Text) - 1);
+                Record(event, received, m_bookmarks);
+            });
+        }
+    }
+
+    // Waits until the consumer has been given all events recorded so far.
+    void Flush() const
+    {
+        while (!m_ring.Empty() || m_delivering)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+
+    Statistics GetStatistics() const
+    {
+        Statistics statistics;
+        statistics.WordBoundaries = m_wordBoundaries;
+        statistics.Visemes = m_visemes;
+        statistics.Bookmarks = m_bookmarks;
+        statistics.Dropped = m_dropped;
+        statistics.MaxHandlerTime = std::chrono::microseconds(m_maxHandlerTime.load());
+        statistics.MaxDeliveryDelay = std::chrono::microseconds(m_maxDeliveryDelay.load());
+        return statistics;
+    }
+
+private:
+    // How long the consumer thread sleeps when there are no events.
+    static constexpr int idleWaitMs = 2;
+
+    void Record(SynthesisEvent& event, Clock::time_point received, std::atomic<uint64_t>& count)
+    {
+        event.Received = received - m_start;
+        if (m_ring.TryPush(event))
+        {
+            count++;
+        }
+        else
+        {
+            m_dropped++;
+        }
+        UpdateMax(m_maxHandlerTime, std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - received).count());
+    }
+
+    void Consume()
+    {
+        SynthesisEvent event;
+        while (true)
+        {
+            m_delivering = true;
+            while (m_ring.TryPop(event))
+            {
+                auto delay = Clock::now() - m_start - event.Received;
+                UpdateMax(m_maxDeliveryDelay, std::chrono::duration_cast<std::chrono::microseconds>(delay).count());
+                m_consumer(event);
+            }
+            m_delivering = false;
+
+            // Checks the ring once more after stopping, for events recorded right before.
+            if (m_stopping && m_ring.Empty())
+            {
+                return;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(idleWaitMs));
+        }
+    }
+
+    static void UpdateMax(std::atomic<int64_t>& maximum, int64_t value)
+    {
+        auto current = maximum.load();
+        while (value > current && !maximum.compare_exchange_weak(current, value))
+        {
+        }
+    }
+
+    const Consumer m_consumer;
+    SingleProducerRing<SynthesisEvent> m_ring;
+    const Clock::time_point m_start;
+
+    std::atomic<uint64_t> m_wordBoundaries{ 0 };
+    std::atomic<uint64_t> m_visemes{ 0 };
+    std::atomic<uint64_t> m_bookmarks{ 0 };
+    std::atomic<uint64_t> m_dropped{ 0 };
+    std::atomic<int64_t> m_maxHandlerTime{ 0 };
+    std::atomic<int64_t> m_maxDeliveryDelay{ 0 };
+
+    std::atomic<bool> m_delivering{ false };
+    std::atomic<bool> m_stopping{ false };
+    std::thread m_thread;
+};
@@ -0,0 +1,265 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#pragma once
+
+#include <speechapi_cxx.h>
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <nlohmann/json.hpp>
+
+// Chooses the synthesis output format for each client from measurements instead of hardcoding one: raw PCM needs
+// no decoding on the client but takes 32-96 KB per second of audio, MP3 and Opus (in Ogg or WebM) take a fraction of
+// that. Measure() synthesizes a text in every candidate format and records its time to first byte and bytes per
+// second of audio; Choose() then picks, for the bandwidth measured to a client, PCM if it fits the link, else the
+// best compressed format that fits, else the most compact one.
+class SynthesisFormatSelector final
+{
+public:
+    struct Candidate
+    {
+        // The format name used by the service, e.g. "audio-24khz-48kbitrate-mono-mp3".
+        std::string Name;
+        Microsoft::CognitiveServices::Speech::SpeechSynthesisOutputFormat Format;
+        // Bytes per second of raw PCM, which needs no decoding; 0 for compressed formats.
+        uint32_t PcmBytesPerSecond;
+
+        // Measured by Measure().
+        double BytesPerSecond = 0;
+        std::chrono::milliseconds FirstByte{ 0 };
+        // CPU time the client spends decoding a second of audio, in milliseconds, as measured on the client;
+        // 0 for PCM, negative when not known.
+        double DecodeCost = -1;
+    };
+
+    struct Settings
+    {
+        // A format fits a link when its bytes per second times the headroom are within the bandwidth, so delivery
+        // keeps ahead of playback when the bandwidth varies.
+        double Headroom = 1.5;
+        // Formats known to cost the client more decoding time than this are not chosen while another one fits;
+        // 0 for no limit.
+        double MaxDecodeCost = 0;
+    };
+
+    // The PCM, MP3 and Opus formats of 16 and 24 kHz mono, from the largest to the most compact.
+    static std::vector<Candidate> DefaultCandidates()
+    {
+        using Microsoft::CognitiveServices::Speech::SpeechSynthesisOutputFormat;
+        return
+        {
+            { "raw-24khz-16bit-mono-pcm", SpeechSynthesisOutputFormat::Raw24Khz16BitMonoPcm, 48000 },
+            { "raw-16khz-16bit-mono-pcm", SpeechSynthesisOutputFormat::Raw16Khz16BitMonoPcm, 32000 },
+            { "audio-24khz-160kbitrate-mono-mp3", SpeechSynthesisOutputFormat::Audio24Khz160KBitRateMonoMp3, 0 },
+            { "audio-24khz-96kbitrate-mono-mp3", SpeechSynthesisOutputFormat::Audio24Khz96KBitRateMonoMp3, 0 },
+            { "audio-24khz-48kbitrate-mono-mp3", SpeechSynthesisOutputFormat::Audio24Khz48KBitRateMonoMp3, 0 },
+            { "audio-16khz-32kbitrate-mono-mp3", SpeechSynthesisOutputFormat::Audio16Khz32KBitRateMonoMp3, 0 },
+            { "ogg-24khz-16bit-mono-opus", SpeechSynthesisOutputFormat::Ogg24Khz16BitMonoOpus, 0 },
+            { "ogg-16khz-16bit-mono-opus", SpeechSynthesisOutputFormat::Ogg16Khz16BitMonoOpus, 0 },
+            { "webm-24khz-16bit-mono-opus", SpeechSynthesisOutputFormat::Webm24Khz16BitMonoOpus, 0 },
+            { "webm-24khz-16bit-24kbps-mono-opus", SpeechSynthesisOutputFormat::Webm24Khz16Bit24KbpsMonoOpus, 0 },
+            { "webm-16khz-16bit-mono-opus", SpeechSynthesisOutputFormat::Webm16Khz16BitMonoOpus, 0 },
+        };
+    }
+
+    // Synthesizes 'text' 'iterations' times in each candidate format with 'config' (whose output format is
+    // changed) and records the median time to first byte and the bytes per second of audio. The audio duration is
+    // taken from the first PCM candidate, or from an extra synthesis to PCM if there is none.
+    // Throws std::runtime_error if a synthesis is canceled.
+    static std::vector<Candidate> Measure(const std::shared_ptr<Microsoft::CognitiveServices::Speech::SpeechConfig>& config,
+        std::vector<Candidate> candidates, const std::string& text, uint32_t iterations = 3)
+    {
+        using Microsoft::CognitiveServices::Speech::SpeechSynthesisOutputFormat;
+
+        iterations = std::max<uint32_t>(iterations, 1);
+        double audioSeconds = 0;
+        auto pcm = std::find_if(candidates.begin(), candidates.end(), [](const Candidate& candidate) { return candidate.PcmBytesPerSecond > 0; });
+        if (pcm == candidates.end())
+        {
+            config->SetSpeechSynthesisOutputFormat(SpeechSynthesisOutputFormat::Raw16Khz16BitMonoPcm);
+            audioSeconds = Synthesize(config, text).Bytes / 32000.0;
+        }
+
+        for (auto& candidate : candidates)
+        {
+            config->SetSpeechSynthesisOutputFormat(candidate.Format);
+            std::vector<std::chrono::milliseconds> firstBytes;
+            std::vector<uint64_t> sizes;
+            for (uint32_t i = 0; i < iterations; i++)
+            {
+                auto delivery = Synthesize(config, text);
+                firstBytes.push_back(delivery.FirstByte);
+                sizes.push_back(delivery.Bytes);
+            }
+            std::sort(firstBytes.begin(), firstBytes.end());
+            std::sort(sizes.begin(), sizes.end());
+            candidate.FirstByte = firstBytes[firstBytes.size() / 2];
+            if (audioSeconds == 0 && candidate.PcmBytesPerSecond > 0)
+            {
+                audioSeconds = (double)sizes[sizes.size() / 2] / candidate.PcmBytesPerSecond;
+            }
+            if (candidate.PcmBytesPerSecond > 0)
+            {
+                candidate.DecodeCost = 0;
+            }
+            candidate.BytesPerSecond = (double)sizes[sizes.size() / 2];
+        }
+        for (auto& candidate : candidates)
+        {
+            candidate.BytesPerSecond /= std::max(audioSeconds, 0.001);
+        }
+        return candidates;
+    }
+
+    explicit SynthesisFormatSelector(std::vector<Candidate> measured)
+        : SynthesisFormatSelector(std::move(measured), Settings())
+    {
+    }
+
+    // 'measured' as returned by Measure() or FromJson(). Throws std::invalid_argument if it is empty.
+    SynthesisFormatSelector(std::vector<Candidate> measured, const Settings& settings)
+        : m_candidates(std::move(measured)), m_settings(settings)
+    {
+        if (m_candidates.empty())
+        {
+            throw std::invalid_argument("The format selector needs at least one measured format.");
+        }
+    }
+
+    const std::vector<Candidate>& Candidates() const
+    {
+        return m_candidates;
+    }
+
+    // Returns the format for a client with 'bandwidth' bytes per second, e.g. measured from the delivery of its
+    // previous responses: PCM if one fits (the fastest to start), else the compressed format of the highest bitrate
+    // that fits, else the most compact format.
+    const Candidate& Choose(double bandwidth) const
+    {
+        const Candidate* best = nullptr;
+        for (const auto& candidate : m_candidates)
+        {
+            if (candidate.BytesPerSecond * m_settings.Headroom > bandwidth ||
+                (m_settings.MaxDecodeCost > 0 && candidate.DecodeCost > m_settings.MaxDecodeCost))
+            {
+                continue;
+            }
+            if (best == nullptr || Better(candidate, *best))
+            {
+                best = &candidate;
+            }
+        }
+        if (best == nullptr)
+        {
+            best = &*std::min_element(m_candidates.begin(), m_candidates.end(), [](const Candidate& a, const Candidate& b)
+            {
+                return a.BytesPerSecond < b.BytesPerSecond;
+            });
+        }
+        return *best;
+    }
+
+    // Sets the format chosen for 'bandwidth' on 'config', for the synthesizers of that client.
+    const Candidate& Apply(Microsoft::CognitiveServices::Speech::SpeechConfig& config, double bandwidth) const
+    {
+        const auto& chosen = Choose(bandwidth);
+        config.SetSpeechSynthesisOutputFormat(chosen.Format);
+        return chosen;
+    }
+
+    static nlohmann::json ToJson(const std::vector<Candidate>& candidates)
+    {
+        auto formats = nlohmann::json::array();
+        for (const auto& candidate : candidates)
+        {
+            formats.push_back({
+                { "name", candidate.Name },
+                { "pcm", candidate.PcmBytesPerSecond > 0 },
+                { "bytesPerSecond", candidate.BytesPerSecond },
+                { "firstByteMs", candidate.FirstByte.count() },
+                { "decodeCostMsPerSecond", candidate.DecodeCost } });
+        }
+        return formats;
+    }
+
+    // Reads the measurements written by ToJson(), e.g. from a benchmark report. Formats that are not among the
+    // default candidates are skipped.
+    static std::vector<Candidate> FromJson(const nlohmann::json& formats)
+    {
+        auto known = DefaultCandidates();
+        std::vector<Candidate> candidates;
+        for (const auto& format : formats)
+        {
+            auto name = format.at("name").get<std::string>();
+            auto candidate = std::find_if(known.begin(), known.end(), [&name](const Candidate& c) { return c.Name == name; });
+            if (candidate != known.end())
+            {
+                candidate->BytesPerSecond = format.at("bytesPerSecond").get<double>();
+                candidate->FirstByte = std::chrono::milliseconds(format.at("firstByteMs").get<int64_t>());
+                candidate->DecodeCost = format.value("decodeCostMsPerSecond", -1.0);
+                candidates.push_back(*candidate);
+            }
+        }
+        return candidates;
+    }
+
+private:
+    struct Delivery
+    {
+        std::chrono::milliseconds FirstByte;
+        uint64_t Bytes;
+    };
+
+    static Delivery Synthesize(const std::shared_ptr<Microsoft::CognitiveServices::Speech::SpeechConfig>& config, const std::string& text)
+    {
+        using namespace Microsoft::CognitiveServices::Speech;
+
+        auto started = std::chrono::steady_clock::now();
+        auto synthesizer = SpeechSynthesizer::FromConfig(config, nullptr);
+        auto result = synthesizer->StartSpeakingTextAsync(text).get();
+        auto stream = AudioDataStream::FromResult(result);
+        Delivery delivery{ std::chrono::milliseconds(0), 0 };
+        std::vector<uint8_t> buffer(16000);
+        uint32_t filled;
+        while ((filled = stream->ReadData(buffer.data(), (uint32_t)buffer.size())) > 0)
+        {
+            if (delivery.Bytes == 0)
+            {
+                delivery.FirstByte = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - started);
+            }
+            delivery.Bytes += filled;
+        }
+        if (stream->GetStatus() == StreamStatus::Canceled)
+        {
+            throw std::runtime_error("Synthesis canceled: " + SpeechSynthesisCancellationDetails::FromStream(stream)->ErrorDetails);
+        }
+        return delivery;
+    }
+
+    // PCM before compressed formats, then the higher bitrate, then the cheaper decoding, then the faster first byte.
+    static bool Better(const Candidate& a, const Candidate& b)
+    {
+        if ((a.PcmBytesPerSecond > 0) != (b.PcmBytesPerSecond > 0))
+        {
+            return a.PcmBytesPerSecond > 0;
+        }
+        if (a.BytesPerSecond != b.BytesPerSecond)
+        {
+            return a.BytesPerSecond > b.BytesPerSecond;
+        }
+        auto cost = [](const Candidate& c) { return c.DecodeCost < 0 ? 1e9 : c.DecodeCost; };
+        if (cost(a) != cost(b))
+        {
+            return cost(a) < cost(b);
+        }
+        return a.FirstByte < b.FirstByte;
+    }
+
+    const std::vector<Candidate> m_candidates;
+    const Settings m_settings;
+};
@@ -0,0 +1,207 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+
+// Level of an SDK trace line.
+enum class TraceLevel
+{
+    Error,
+    Warning,
+    Info,
+    Verbose
+};
+
+// Sits between the EventLogger callback and a consumer of trace lines (e.g. log shipping), so a slow or bursty
+// consumer cannot hold up the SDK threads producing the traces. Lines are first filtered by level, then sampled
+// (1 in 'SampleEvery'), then limited to 'MaxLinesPerSecond', all on the producing thread with a few atomic
+// operations and a look at the level marker of the line. The remaining lines are queued and handed to the consumer on a dedicated dispatcher thread; when the
+// consumer falls behind by 'MaxQueuedLines', new lines are dropped.
+class TraceDispatcher final
+{
+public:
+    struct Settings
+    {
+        TraceLevel MinimumLevel = TraceLevel::Info;
+        // Passes every Nth line, 1 for all lines.
+        uint32_t SampleEvery = 1;
+        // 0 for no limit.
+        uint32_t MaxLinesPerSecond = 1000;
+        size_t MaxQueuedLines = 10000;
+    };
+
+    struct Statistics
+    {
+        uint64_t Received = 0;
+        uint64_t FilteredByLevel = 0;
+        uint64_t SampledOut = 0;
+        uint64_t RateLimited = 0;
+        uint64_t QueueFull = 0;
+        uint64_t Delivered = 0;
+    };
+
+    using Consumer = std::function<void(const std::string& line)>;
+
+    explicit TraceDispatcher(Consumer consumer)
+        : TraceDispatcher(std::move(consumer), Settings())
+    {
+    }
+
+    TraceDispatcher(Consumer consumer, const Settings& settings)
+        : m_consumer(std::move(consumer)), m_settings(settings)
+    {
+        if (m_settings.SampleEvery == 0)
+        {
+            m_settings.SampleEvery = 1;
+        }
+        m_windowStart = std::chrono::steady_clock::now();
+        m_thread = std::thread(&TraceDispatcher::Run, this);
+    }
+
+    TraceDispatcher(const TraceDispatcher&) = delete;
+    TraceDispatcher& operator=(const TraceDispatcher&) = delete;
+
+    // Delivers the lines still queued, then stops the dispatcher thread.
+    ~TraceDispatcher()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stopped = true;
+        }
+        m_wakeUp.notify_one();
+        m_thread.join();
+    }
+
+    // To be called from the EventLogger callback, e.g. EventLogger::SetCallback([&](std::string line) { dispatcher.OnTrace(std::move(line)); }).
+    void OnTrace(std::string&& line)
+    {
+        m_received.fetch_add(1, std::memory_order_relaxed);
+        if (LevelOf(line) > m_settings.MinimumLevel)
+        {
+            m_filteredByLevel.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        if (m_settings.SampleEvery > 1 && m_sampleCounter.fetch_add(1, std::memory_order_relaxed) % m_settings.SampleEvery != 0)
+        {
+            m_sampledOut.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (m_settings.MaxLinesPerSecond != 0)
+            {
+                // Fixed one-second windows: cheap, and bursts are still limited to twice the rate at the window edges.
+                auto now = std::chrono::steady_clock::now();
+                if (now - m_windowStart >= std::chrono::seconds(1))
+                {
+                    m_windowStart = now;
+                    m_windowLines = 0;
+                }
+                if (m_windowLines >= m_settings.MaxLinesPerSecond)
+                {
+                    m_statistics.RateLimited++;
+                    return;
+                }
+                m_windowLines++;
+            }
+            if (m_queue.size() >= m_settings.MaxQueuedLines)
+            {
+                m_statistics.QueueFull++;
+                return;
+            }
+            m_queue.push_back(std::move(line));
+        }
+        m_wakeUp.notify_one();
+    }
+
+    Statistics GetStatistics()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto statistics = m_statistics;
+        statistics.Received = m_received.load(std::memory_order_relaxed);
+        statistics.FilteredByLevel = m_filteredByLevel.load(std::memory_order_relaxed);
+        statistics.SampledOut = m_sampledOut.load(std::memory_order_relaxed);
+        return statistics;
+    }
+
+    // Reads the level from the marker near the start of an SDK trace line (e.g. "SPX_TRACE_INFO:",
+    // "SPX_DBG_TRACE_VERBOSE:"). Lines without a marker count as Info.
+    static TraceLevel LevelOf(const std::string& line)
+    {
+        static const char marker[] = "TRACE_";
+        static const size_t searchedPrefix = 96;
+        auto end = line.begin() + std::min(line.size(), searchedPrefix);
+        auto found = std::search(line.begin(), end, marker, marker + sizeof(marker) - 1);
+        if (end - found <= (ptrdiff_t)(sizeof(marker) - 1))
+        {
+            return TraceLevel::Info;
+        }
+        switch (found[sizeof(marker) - 1])
+        {
+        case 'E':
+            return TraceLevel::Error;
+        case 'W':
+            return TraceLevel::Warning;
+        case 'V':
+            return TraceLevel::Verbose;
+        default:
+            return TraceLevel::Info;
+        }
+    }
+
+private:
+    void Run()
+    {
+        std::deque<std::string> lines;
+        std::unique_lock<std::mutex> lock(m_mutex);
+        for (;;)
+        {
+            m_wakeUp.wait(lock, [this] { return m_stopped || !m_queue.empty(); });
+            if (m_queue.empty())
+            {
+                break;
+            }
+
+            // The consumer runs without the lock, producers go on queueing meanwhile.
+            lines.swap(m_queue);
+            lock.unlock();
+            for (const auto& line : lines)
+            {
+                m_consumer(line);
+            }
+            auto delivered = lines.size();
+            lines.clear();
+            lock.lock();
+            m_statistics.Delivered += delivered;
+        }
+    }
+
+    Consumer m_consumer;
+    Settings m_settings;
+
+    std::atomic<uint64_t> m_received{ 0 };
+    std::atomic<uint64_t> m_filteredByLevel{ 0 };
+    std::atomic<uint64_t> m_sampledOut{ 0 };
+    std::atomic<uint64_t> m_sampleCounter{ 0 };
+
+    std::mutex m_mutex;
+    std::condition_variable m_wakeUp;
+    std::deque<std::string> m_queue;
+    std::chrono::steady_clock::time_point m_windowStart;
+    uint32_t m_windowLines = 0;
+    bool m_stopped = false;
+    Statistics m_statistics;
+    std::thread m_thread;
+};
@@ -0,0 +1,128 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#pragma once
+
+#include <atomic>
+#include <cstring>
+#include <memory>
+#include <ostream>
+#include <string>
+
+// Fixed-capacity, lock-free store of the latest trace lines, for traces that stay on in production. Any number of
+// threads may Write() at once (e.g. from an EventLogger callback) without locking or allocating; the newest line
+// overwrites the oldest one. Lines longer than 'entrySize' are truncated. Visit() streams the stored lines out
+// oldest first, without stopping the writers and without copying the buffer, so an incident dump does not add
+// to the load of a process that is already in trouble.
+template <size_t entrySize = 512>
+class TraceRingBuffer final
+{
+public:
+    // 'capacity' is rounded up to a power of two.
+    explicit TraceRingBuffer(size_t capacity = 4096)
+    {
+        m_capacity = 1;
+        while (m_capacity < capacity)
+        {
+            m_capacity *= 2;
+        }
+        m_entries.reset(new Entry[m_capacity]);
+    }
+
+    TraceRingBuffer(const TraceRingBuffer&) = delete;
+    TraceRingBuffer& operator=(const TraceRingBuffer&) = delete;
+
+    void Write(const char* text, size_t length)
+    {
+        auto ticket = m_next.fetch_add(1, std::memory_order_relaxed);
+        auto& entry = m_entries[ticket & (m_capacity - 1)];
+
+        // The sequence of an entry is odd while it is written, and 2 * (ticket + 1) once line 'ticket' is complete.
+        // A writer that is a whole lap ahead of a stalled one drops its line rather than waiting.
+        auto sequence = entry.Sequence.load(std::memory_order_relaxed);
+        if ((sequence & 1) != 0 || sequence > 2 * ticket ||
+            !entry.Sequence.compare_exchange_strong(sequence, 2 * ticket + 1, std::memory_order_relaxed))
+        {
+            m_dropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        std::atomic_thread_fence(std::memory_order_release);
+
+        entry.Length = (uint32_t)(length < entrySize ? length : entrySize);
+        memcpy(entry.Text, text, entry.Length);
+
+        entry.Sequence.store(2 * ticket + 2, std::memory_order_release);
+    }
+
+    void Write(const std::string& text)
+    {
+        Write(text.data(), text.size());
+    }
+
+    // Calls 'visit' with (const char* text, size_t length) for each stored line, oldest first, and returns the
+    // number of lines visited. Lines overwritten or being written while they are visited are skipped. 'visit'
+    // must not keep the pointer, it is valid for the call only.
+    template <class Visitor>
+    size_t Visit(Visitor&& visit) const
+    {
+        auto end = m_next.load(std::memory_order_acquire);
+        auto begin = end > m_capacity ? end - m_capacity : 0;
+
+        char text[entrySize];
+        size_t visited = 0;
+        for (auto ticket = begin; ticket < end; ticket++)
+        {
+            const auto& entry = m_entries[ticket & (m_capacity - 1)];
+            auto sequence = entry.Sequence.load(std::memory_order_acquire);
+            if (sequence != 2 * ticket + 2)
+            {
+                continue;
+            }
+
+            // The line is copied out and checked again, so 'visit' never sees a line that is torn by a writer.
+            auto length = entry.Length;
+            memcpy(text, entry.Text, length);
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (entry.Sequence.load(std::memory_order_relaxed) != sequence)
+            {
+                continue;
+            }
+
+            visit(static_cast<const char*>(text), static_cast<size_t>(length));
+            visited++;
+        }
+        return visited;
+    }
+
+    // Writes the stored lines to 'out', oldest first.
+    size_t Dump(std::ostream& out) const
+    {
+        return Visit([&out](const char* text, size_t length) { out.write(text, length); });
+    }
+
+    // Number of lines written so far, including those already overwritten.
+    uint64_t GetWrittenCount() const
+    {
+        return m_next.load(std::memory_order_relaxed);
+    }
+
+    // Number of lines dropped because their entry was still being written.
+    uint64_t GetDroppedCount() const
+    {
+        return m_dropped.load(std::memory_order_relaxed);
+    }
+
+private:
+    struct Entry
+    {
+        std::atomic<uint64_t> Sequence{ 0 };
+        uint32_t Length = 0;
+        char Text[entrySize];
+    };
+
+    size_t m_capacity;
+    std::unique_ptr<Entry[]> m_entries;
+    std::atomic<uint64_t> m_next{ 0 };
+    std::atomic<uint64_t> m_dropped{ 0 };
+};
@@ -0,0 +1,514 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#pragma once
+
+#include <speechapi_cxx.h>
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include "detailed_result_view.h"
+
+// Layout of the transcript store files written by TranscriptStoreWriter and read by TranscriptSegmentView.
+// A file is a sequence of self-contained segments, each starting with a TranscriptSegmentHeader. Segment sizes
+// and column offsets are multiples of 8, so a reader can map the file and use the columns in place.
+// Integers are little endian.
+namespace TranscriptStoreFormat
+{
+    enum Column
+    {
+        // uint32[strings + 1]: offsets of the strings in StringBytes, the last one is the size of StringBytes.
+        StringOffsets,
+        // UTF-8 bytes of the strings, sorted and without terminators. Calls and words are ids into these strings.
+        StringBytes,
+        // Utterance columns, sorted by call, then offset: the time index of the segment.
+        UtteranceCall,        // uint32 string id
+        UtteranceOffset,      // uint64 ticks of 100 ns from the start of the call audio
+        UtteranceDuration,    // uint64 ticks
+        UtteranceText,        // uint32 string id of the display text
+        UtteranceFirstWord,   // uint32 index into the word columns
+        UtteranceWordCount,   // uint32
+        // Word columns, the words of each utterance one after the other.
+        WordText,             // uint32 string id
+        WordOffset,           // uint64 ticks
+        WordDuration,         // uint64 ticks
+        WordConfidence,       // float32, 0 without word level confidence
+        ColumnCount
+    };
+
+    const char segmentTag[4] = { 'T', 'S', 'G', '1' };
+}
+
+struct TranscriptSegmentHeader
+{
+    char Tag[4];
+    uint32_t HeaderBytes;
+    // Size of the segment including this header; the next segment starts right after it.
+    uint64_t SegmentBytes;
+    uint32_t Utterances;
+    uint32_t Words;
+    uint32_t Strings;
+    uint32_t Reserved;
+    // Time range of the utterances of the segment, in ticks, to skip segments without reading their columns.
+    uint64_t MinOffset;
+    uint64_t MaxEnd;
+    // Offsets of the columns from the start of the segment.
+    uint64_t ColumnOffsets[TranscriptStoreFormat::ColumnCount];
+};
+static_assert(sizeof(TranscriptSegmentHeader) == 48 + 8 * TranscriptStoreFormat::ColumnCount, "unexpected size of TranscriptSegmentHeader");
+
+// Persists final recognition results with their word timings, for search indexing across many calls.
+// Append() copies the result into an in-memory batch; a background thread turns the batch into a segment
+// (strings interned, columns laid out, utterances sorted by call and time) and appends it to the file when
+// 'FlushIntervalMs' has passed or 'MaxBatchWords' words are waiting. The file is opened for appending, so
+// several runs add to the same store. Append() waits when 'MaxQueuedWords' are waiting, finals are never dropped
+// while the file can be written. After a failed write the writer stops writing, so the file ends with the last
+// complete segment; the results from then on are counted as lost and GetError() tells why.
+class TranscriptStoreWriter final
+{
+public:
+    struct Settings
+    {
+        uint32_t FlushIntervalMs = 2000;
+        size_t MaxBatchWords = 64 * 1024;
+        size_t MaxQueuedWords = 1024 * 1024;
+    };
+
+    struct Statistics
+    {
+        uint64_t Utterances = 0;
+        uint64_t Words = 0;
+        uint64_t Segments = 0;
+        uint64_t Bytes = 0;
+        // Utterances that were not written because writing had failed, or because they came after Close().
+        uint64_t LostUtterances = 0;
+    };
+
+    // Throws std::runtime_error if the file cannot be opened.
+    explicit TranscriptStoreWriter(const std::string& fileName)
+        : TranscriptStoreWriter(fileName, Settings())
+    {
+    }
+
+    TranscriptStoreWriter(const std::string& fileName, const Settings& settings)
+        : m_settings(settings), m_file(fileName, std::ios::binary | std::ios::app)
+    {
+        if (!m_file)
+        {
+            throw std::runtime_error("Cannot open the transcript store " + fileName);
+        }
+        m_thread = std::thread(&TranscriptStoreWriter::Run, this);
+    }
+
+    TranscriptStoreWriter(const TranscriptStoreWriter&) = delete;
+    TranscriptStoreWriter& operator=(const TranscriptStoreWriter&) = delete;
+
+    ~TranscriptStoreWriter()
+    {
+        Close();
+    }
+
+    // Writes the results still in memory, closes the file and returns once that is done.
+    void Close()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stopped = true;
+        }
+        m_wakeUp.notify_all();
+        m_roomAvailable.notify_all();
+        if (m_thread.joinable())
+        {
+            m_thread.join();
+        }
+        m_file.close();
+    }
+
+    // Adds a final result of the call 'callId', with the words of its best hypothesis. Word timings are only in
+    // the result when they are requested, with SpeechConfig::RequestWordLevelTimestamps(). Results added once
+    // Close() has been called are not written and count as lost.
+    void Append(const std::string& callId, const DetailedResultView& result)
+    {
+        const auto& nbest = result.GetNBest();
+        Utterance utterance{ callId, result.GetOffset(), result.GetDuration(), result.GetDisplayText().ToString(), 0, 0 };
+        if (!nbest.empty())
+        {
+            utterance.WordCount = (uint32_t)nbest[0].Words.size();
+        }
+
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_roomAvailable.wait(lock, [this] { return m_queued.Words.size() < m_settings.MaxQueuedWords || m_stopped; });
+        if (m_stopped)
+        {
+            m_statistics.LostUtterances++;
+            return;
+        }
+        utterance.FirstWord = (uint32_t)m_queued.Words.size();
+        m_queued.Utterances.push_back(std::move(utterance));
+        if (!nbest.empty())
+        {
+            for (const auto& word : nbest[0].Words)
+            {
+                m_queued.Words.push_back({ word.Text.ToString(), word.Offset, word.Duration, (float)word.Confidence });
+            }
+        }
+        if (m_queued.Words.size() >= m_settings.MaxBatchWords)
+        {
+            m_wakeUp.notify_all();
+        }
+    }
+
+    void Append(const std::string& callId, const std::shared_ptr<Microsoft::CognitiveServices::Speech::RecognitionResult>& result)
+    {
+        Append(callId, DetailedResultView(result));
+    }
+
+    // Makes the writer write what is in memory now, instead of at the end of the flush interval.
+    void Flush()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_flushRequested = true;
+        }
+        m_wakeUp.notify_all();
+    }
+
+    Statistics GetStatistics()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_statistics;
+    }
+
+    // The error that stopped writing, or an empty string.
+    std::string GetError()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_error;
+    }
+
+private:
+    struct Utterance
+    {
+        std::string Call;
+        uint64_t Offset;
+        uint64_t Duration;
+        std::string Text;
+        uint32_t FirstWord;
+        uint32_t WordCount;
+    };
+
+    struct Word
+    {
+        std::string Text;
+        uint64_t Offset;
+        uint64_t Duration;
+        float Confidence;
+    };
+
+    struct Batch
+    {
+        std::vector<Utterance> Utterances;
+        std::vector<Word> Words;
+    };
+
+    void Run()
+    {
+        Batch batch;
+        std::vector<char> segment;
+        std::unique_lock<std::mutex> lock(m_mutex);
+        for (;;)
+        {
+            m_wakeUp.wait_for(lock, std::chrono::milliseconds(m_settings.FlushIntervalMs), [this]
+            {
+                return m_stopped || m_flushRequested || m_queued.Words.size() >= m_settings.MaxBatchWords;
+            });
+
+            auto stopped = m_stopped;
+            m_flushRequested = false;
+            if (!m_queued.Utterances.empty())
+            {
+                // Appending goes on into the other batch while this one is written.
+                std::swap(batch, m_queued);
+                lock.unlock();
+                m_roomAvailable.notify_all();
+
+                // Only this thread sets the error, so it can be read without the lock here.
+                auto written = false;
+                if (m_error.empty())
+                {
+                    BuildSegment(batch, segment);
+                    m_file.write(segment.data(), segment.size());
+                    m_file.flush();
+                    written = !m_file.fail();
+                }
+
+                lock.lock();
+                if (written)
+                {
+                    m_statistics.Utterances += batch.Utterances.size();
+                    m_statistics.Words += batch.Words.size();
+                    m_statistics.Segments++;
+                    m_statistics.Bytes += segment.size();
+                }
+                else
+                {
+                    if (m_error.empty())
+                    {
+                        m_error = "Cannot write to the transcript store.";
+                    }
+                    m_statistics.LostUtterances += batch.Utterances.size();
+                }
+                batch.Utterances.clear();
+                batch.Words.clear();
+            }
+            if (stopped && m_queued.Utterances.empty())
+            {
+                break;
+            }
+        }
+    }
+
+    static void BuildSegment(const Batch& batch, std::vector<char>& segment)
+    {
+        using namespace TranscriptStoreFormat;
+
+        // Interns the strings; ids are the ranks in sorted order, so readers can binary search a call or a word.
+        std::map<std::string, uint32_t> strings;
+        for (const auto& utterance : batch.Utterances)
+        {
+            strings.emplace(utterance.Call, 0);
+            strings.emplace(utterance.Text, 0);
+        }
+        for (const auto& word : batch.Words)
+        {
+            strings.emplace(word.Text, 0);
+        }
+        std::vector<uint32_t> stringOffsets;
+        std::string stringBytes;
+        for (auto& entry : strings)
+        {
+            entry.second = (uint32_t)stringOffsets.size();
+            stringOffsets.push_back((uint32_t)stringBytes.size());
+            stringBytes += entry.first;
+        }
+        stringOffsets.push_back((uint32_t)stringBytes.size());
+
+        // The time index: utterances in call and offset order, their words moving along with them.
+        std::vector<uint32_t> order(batch.Utterances.size());
+        for (uint32_t i = 0; i < order.size(); i++)
+        {
+            order[i] = i;
+        }
+        std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b)
+        {
+            const auto& x = batch.Utterances[a];
+            const auto& y = batch.Utterances[b];
+            return x.Call != y.Call ? x.Call < y.Call : x.Offset < y.Offset;
+        });
+
+        TranscriptSegmentHeader header{};
+        memcpy(header.Tag, segmentTag, sizeof(header.Tag));
+        header.HeaderBytes = sizeof(header);
+        header.Utterances = (uint32_t)batch.Utterances.size();
+        header.Words = (uint32_t)batch.Words.size();
+        header.Strings = (uint32_t)strings.size();
+        header.MinOffset = UINT64_MAX;
+
+        std::vector<uint32_t> utteranceCalls, utteranceTexts, firstWords, wordCounts, wordTexts;
+        std::vector<uint64_t> utteranceOffsets, utteranceDurations, wordOffsets, wordDurations;
+        std::vector<float> wordConfidences;
+        for (auto index : order)
+        {
+            const auto& utterance = batch.Utterances[index];
+            utteranceCalls.push_back(strings[utterance.Call]);
+            utteranceOffsets.push_back(utterance.Offset);
+            utteranceDurations.push_back(utterance.Duration);
+            utteranceTexts.push_back(strings[utterance.Text]);
+            firstWords.push_back((uint32_t)wordTexts.size());
+            wordCounts.push_back(utterance.WordCount);
+            header.MinOffset = std::min(header.MinOffset, utterance.Offset);
+            header.MaxEnd = std::max(header.MaxEnd, utterance.Offset + utterance.Duration);
+
+            for (auto w = utterance.FirstWord; w < utterance.FirstWord + utterance.WordCount; w++)
+            {
+                const auto& word = batch.Words[w];
+                wordTexts.push_back(strings[word.Text]);
+                wordOffsets.push_back(word.Offset);
+                wordDurations.push_back(word.Duration);
+                wordConfidences.push_back(word.Confidence);
+            }
+        }
+
+        segment.assign(sizeof(header), 0);
+        auto addColumn = [&](Column column, const void* data, size_t size)
+        {
+            header.ColumnOffsets[column] = segment.size();
+            segment.insert(segment.end(), static_cast<const char*>(data), static_cast<const char*>(data) + size);
+            segment.resize((segment.size() + 7) & ~(size_t)7, 0);
+        };
+        addColumn(StringOffsets, stringOffsets.data(), stringOffsets.size() * sizeof(uint32_t));
+        addColumn(StringBytes, stringBytes.data(), stringBytes.size());
+        addColumn(UtteranceCall, utteranceCalls.data(), utteranceCalls.size() * sizeof(uint32_t));
+        addColumn(UtteranceOffset, utteranceOffsets.data(), utteranceOffsets.size() * sizeof(uint64_t));
+        addColumn(UtteranceDuration, utteranceDurations.data(), utteranceDurations.size() * sizeof(uint64_t));
+        addColumn(UtteranceText, utteranceTexts.data(), utteranceTexts.size() * sizeof(uint32_t));
+        addColumn(UtteranceFirstWord, firstWords.data(), firstWords.size() * sizeof(uint32_t));
+        addColumn(UtteranceWordCount, wordCounts.data(), wordCounts.size() * sizeof(uint32_t));
+        addColumn(WordText, wordTexts.data(), wordTexts.size() * sizeof(uint32_t));
+        addColumn(WordOffset, wordOffsets.data(), wordOffsets.size() * sizeof(uint64_t));
+        addColumn(WordDuration, wordDurations.data(), wordDurations.size() * sizeof(uint64_t));
+        addColumn(WordConfidence, wordConfidences.data(), wordConfidences.size() * sizeof(float));
+
+        header.SegmentBytes = segment.size();
+        memcpy(segment.data(), &header, sizeof(header));
+    }
+
+    const Settings m_settings;
+    std::ofstream m_file;
+
+    std::mutex m_mutex;
+    std::condition_variable m_wakeUp;
+    std::condition_variable m_roomAvailable;
+    Batch m_queued;
+    bool m_flushRequested = false;
+    bool m_stopped = false;
+    std::string m_error;
+    Statistics m_statistics;
+    std::thread m_thread;
+};
+
+// Read-only access to one segment of a transcript store, in place, e.g. in a memory-mapped file.
+// 'data' must be 8-byte aligned and stay valid while the view is used. The constructor checks every column, string
+// offset, string id and word range against the segment size once, so the accessors can use the columns unchecked.
+class TranscriptSegmentView final
+{
+public:
+    // Throws std::runtime_error if 'size' bytes do not start with a complete, consistent segment.
+    TranscriptSegmentView(const uint8_t* data, size_t size)
+        : m_data(data)
+    {
+        using namespace TranscriptStoreFormat;
+
+        if (size < sizeof(TranscriptSegmentHeader))
+        {
+            throw std::runtime_error("Truncated transcript segment.");
+        }
+        memcpy(&m_header, data, sizeof(m_header));
+        if (memcmp(m_header.Tag, segmentTag, sizeof(m_header.Tag)) != 0 || m_header.HeaderBytes != sizeof(TranscriptSegmentHeader) ||
+            m_header.SegmentBytes > size || m_header.SegmentBytes < sizeof(TranscriptSegmentHeader))
+        {
+            throw std::runtime_error("Invalid transcript segment.");
+        }
+
+        // The element counts come from the header too, so their products are computed in 64 bits and cannot wrap.
+        const uint64_t strings = m_header.Strings;
+        const uint64_t utterances = m_header.Utterances;
+        const uint64_t words = m_header.Words;
+        CheckColumn(StringOffsets, (strings + 1) * sizeof(uint32_t));
+        auto offsets = Column<uint32_t>(StringOffsets);
+        for (uint64_t i = 0; i < strings; i++)
+        {
+            if (offsets[i] > offsets[i + 1])
+            {
+                throw std::runtime_error("Invalid string offsets in transcript segment.");
+            }
+        }
+        CheckColumn(StringBytes, offsets[strings]);
+        CheckColumn(UtteranceCall, utterances * sizeof(uint32_t));
+        CheckColumn(UtteranceOffset, utterances * sizeof(uint64_t));
+        CheckColumn(UtteranceDuration, utterances * sizeof(uint64_t));
+        CheckColumn(UtteranceText, utterances * sizeof(uint32_t));
+        CheckColumn(UtteranceFirstWord, utterances * sizeof(uint32_t));
+        CheckColumn(UtteranceWordCount, utterances * sizeof(uint32_t));
+        CheckColumn(WordText, words * sizeof(uint32_t));
+        CheckColumn(WordOffset, words * sizeof(uint64_t));
+        CheckColumn(WordDuration, words * sizeof(uint64_t));
+        CheckColumn(WordConfidence, words * sizeof(float));
+
+        auto calls = Column<uint32_t>(UtteranceCall);
+        auto texts = Column<uint32_t>(UtteranceText);
+        auto firstWords = Column<uint32_t>(UtteranceFirstWord);
+        auto wordCounts = Column<uint32_t>(UtteranceWordCount);
+        for (uint64_t i = 0; i < utterances; i++)
+        {
+            if (calls[i] >= strings || texts[i] >= strings || (uint64_t)firstWords[i] + wordCounts[i] > words)
+            {
+                throw std::runtime_error("Invalid utterance in transcript segment.");
+            }
+        }
+        auto wordTexts = Column<uint32_t>(WordText);
+        for (uint64_t i = 0; i < words; i++)
+        {
+            if (wordTexts[i] >= strings)
+            {
+                throw std::runtime_error("Invalid word in transcript segment.");
+            }
+        }
+    }
+
+    const TranscriptSegmentHeader& GetHeader() const
+    {
+        return m_header;
+    }
+
+    // Throws std::out_of_range if the segment has no string 'id'.
+    std::string GetString(uint32_t id) const
+    {
+        if (id >= m_header.Strings)
+        {
+            throw std::out_of_range("No string " + std::to_string(id) + " in transcript segment.");
+        }
+        auto offsets = Column<uint32_t>(TranscriptStoreFormat::StringOffsets);
+        auto bytes = Column<char>(TranscriptStoreFormat::StringBytes);
+        return std::string(bytes + offsets[id], offsets[id + 1] - offsets[id]);
+    }
+
+    // Id of a string of the segment, -1 if the segment does not contain it.
+    int64_t FindString(const std::string& text) const
+    {
+        uint32_t first = 0;
+        uint32_t last = m_header.Strings;
+        while (first < last)
+        {
+            auto middle = first + (last - first) / 2;
+            if (GetString(middle) < text)
+            {
+                first = middle + 1;
+            }
+            else
+            {
+                last = middle;
+            }
+        }
+        return first < m_header.Strings && GetString(first) == text ? (int64_t)first : -1;
+    }
+
+    template <class T>
+    const T* Column(TranscriptStoreFormat::Column column) const
+    {
+        return reinterpret_cast<const T*>(m_data + m_header.ColumnOffsets[column]);
+    }
+
+private:
+    // Columns start after the header, 8-byte aligned, and end within the segment.
+    void CheckColumn(TranscriptStoreFormat::Column column, uint64_t bytes) const
+    {
+        auto offset = m_header.ColumnOffsets[column];
+        if (offset < sizeof(TranscriptSegmentHeader) || offset % 8 != 0 || offset > m_header.SegmentBytes || bytes > m_header.SegmentBytes - offset)
+        {
+            throw std::runtime_error("Column " + std::to_string((int)column) + " is outside of the transcript segment.");
+        }
+    }
+
+    const uint8_t* m_data;
+    TranscriptSegmentHeader m_header;
+};
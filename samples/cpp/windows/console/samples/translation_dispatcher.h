@@ -0,0 +1,169 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#pragma once
+
+#include <speechapi_cxx.h>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// Passes translation results on to subscribers, only with the target languages whose text changed.
+// A partial result usually changes the translation of one or two of many target languages, so every
+// language is compared with its last partial result and dropped when unchanged. Updates are collected
+// for a time window and delivered as one batch, where a language updated several times in a window
+// is only delivered with its latest text. Final results are always delivered, without waiting for the
+// end of the window. Subscribers are called on a thread of the dispatcher, not on the SDK callback thread.
+class TranslationDispatcher final
+{
+public:
+    struct Update
+    {
+        std::string Language;
+        std::string Text;
+        bool IsFinal;
+        // Offset of the utterance, the same for its partial and final results.
+        uint64_t Offset;
+    };
+
+    // Updates of a batch are ordered by utterance, then by language.
+    using Subscriber = std::function<void(const std::vector<Update>&)>;
+
+    struct Statistics
+    {
+        // Translations of all languages in all results.
+        uint64_t Received = 0;
+        uint64_t Delivered = 0;
+        uint64_t Batches = 0;
+    };
+
+    explicit TranslationDispatcher(std::chrono::milliseconds window = std::chrono::milliseconds(250))
+        : m_window(window)
+    {
+        m_thread = std::thread([this]() { Run(); });
+    }
+
+    TranslationDispatcher(const TranslationDispatcher&) = delete;
+    TranslationDispatcher& operator=(const TranslationDispatcher&) = delete;
+
+    // Delivers the pending updates and stops.
+    ~TranslationDispatcher()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stopping = true;
+        }
+        m_changed.notify_one();
+        m_thread.join();
+    }
+
+    void Subscribe(Subscriber subscriber)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_subscribers.push_back(std::move(subscriber));
+    }
+
+    // Subscribes to the Recognizing and Recognized events. The dispatcher must outlive the recognizer.
+    void Attach(Microsoft::CognitiveServices::Speech::Translation::TranslationRecognizer& recognizer)
+    {
+        using namespace Microsoft::CognitiveServices::Speech::Translation;
+
+        recognizer.Recognizing.Connect([this](const TranslationRecognitionEventArgs& e)
+        {
+            OnResult(e.Result->Offset(), e.Result->Translations, false);
+        });
+        recognizer.Recognized.Connect([this](const TranslationRecognitionEventArgs& e)
+        {
+            OnResult(e.Result->Offset(), e.Result->Translations, true);
+        });
+    }
+
+    void OnResult(uint64_t offset, const std::map<std::string, std::string>& translations, bool isFinal)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for (const auto& translation : translations)
+        {
+            m_statistics.Received++;
+
+            auto& last = m_lastPartials[translation.first];
+            if (!isFinal && last == translation.second)
+            {
+                continue;
+            }
+            last = isFinal ? std::string() : translation.second;
+
+            // A later update of the same utterance and language replaces the pending one.
+            m_pending[std::make_pair(offset, translation.first)] = Update{ translation.first, translation.second, isFinal, offset };
+        }
+
+        if (isFinal)
+        {
+            m_flushNow = true;
+            m_changed.notify_one();
+        }
+    }
+
+    Statistics GetStatistics()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_statistics;
+    }
+
+private:
+    void Run()
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        while (true)
+        {
+            m_changed.wait_for(lock, m_window, [this]() { return m_flushNow || m_stopping; });
+            m_flushNow = false;
+
+            if (!m_pending.empty())
+            {
+                std::vector<Update> batch;
+                batch.reserve(m_pending.size());
+                for (auto& update : m_pending)
+                {
+                    batch.push_back(std::move(update.second));
+                }
+                m_pending.clear();
+                m_statistics.Delivered += batch.size();
+                m_statistics.Batches++;
+                auto subscribers = m_subscribers;
+
+                // Subscribers run without the lock, so new results are not held up by slow subscribers.
+                lock.unlock();
+                for (const auto& subscriber : subscribers)
+                {
+                    subscriber(batch);
+                }
+                lock.lock();
+                continue;
+            }
+
+            if (m_stopping)
+            {
+                return;
+            }
+        }
+    }
+
+    const std::chrono::milliseconds m_window;
+
+    std::mutex m_mutex;
+    std::condition_variable m_changed;
+    std::vector<Subscriber> m_subscribers;
+    std::map<std::string, std::string> m_lastPartials;
+    std::map<std::pair<uint64_t, std::string>, Update> m_pending;
+    Statistics m_statistics;
+    bool m_flushNow = false;
+    bool m_stopping = false;
+    std::thread m_thread;
+};
@@ -6,9 +6,15 @@
 #include "stdafx.h"
 
 // <toplevel>
+#include <chrono>
+#include <fstream>
+#include <mutex>
 #include <string>
 #include <vector>
 #include <speechapi_cxx.h>
+#include "translation_dispatcher.h"
+#include "recognition_session_runner.h"
+#include "speech_to_speech_interpreter.h"
 
 using namespace std;
 using namespace Microsoft::CognitiveServices::Speech;
@@ -91,42 +97,57 @@ void TranslationContinuousRecognition()
     config->AddTargetLanguage("de");
     config->AddTargetLanguage("fr");
 
+    // The translations are printed from the dispatcher thread, the recognition results from the event dispatch
+    // executor and the synthesis results from the SDK callback thread; the lock keeps their lines apart.
+    mutex outputMutex;
+
+    // Passes on only the translations that changed, in batches of 250 ms.
+    // The dispatcher is created before the recognizer, so it outlives the event handlers.
+    TranslationDispatcher dispatcher(std::chrono::milliseconds(250));
+    dispatcher.Subscribe([&outputMutex](const std::vector<TranslationDispatcher::Update>& updates)
+    {
+        lock_guard<mutex> lock(outputMutex);
+        for (const auto& update : updates)
+        {
+            cout << "  " << (update.IsFinal ? "Translated" : "Translating") << " into '" << update.Language << "': " << update.Text << std::endl;
+        }
+    });
+
+    // Runs the event handlers below on the shared event dispatch executor instead of the SDK callback thread.
+    RecognitionSessionRunner session;
+
     // Creates a translation recognizer using microphone as audio input.
     auto recognizer = TranslationRecognizer::FromConfig(config);
 
     // Subscribes to events.
-    recognizer->Recognizing.Connect([](const TranslationRecognitionEventArgs& e)
+    dispatcher.Attach(*recognizer);
+
+    session.OnPartial(recognizer->Recognizing, [&outputMutex](const shared_ptr<TranslationRecognitionResult>& result)
     {
-        cout << "Recognizing:" << e.Result->Text << std::endl;
-        for (const auto& it : e.Result->Translations)
-        {
-            cout << "  Translated into '" << it.first.c_str() << "': " << it.second.c_str() << std::endl;
-        }
+        lock_guard<mutex> lock(outputMutex);
+        cout << "Recognizing:" << result->Text << std::endl;
     });
 
-    recognizer->Recognized.Connect([](const TranslationRecognitionEventArgs& e)
+    session.OnFinal(recognizer->Recognized, [&outputMutex](const shared_ptr<TranslationRecognitionResult>& result)
     {
-        if (e.Result->Reason == ResultReason::TranslatedSpeech)
+        lock_guard<mutex> lock(outputMutex);
+        if (result->Reason == ResultReason::TranslatedSpeech)
         {
-            cout << "RECOGNIZED: Text=" << e.Result->Text << std::endl;
+            cout << "RECOGNIZED: Text=" << result->Text << std::endl;
         }
-        else if (e.Result->Reason == ResultReason::RecognizedSpeech)
+        else if (result->Reason == ResultReason::RecognizedSpeech)
         {
-            cout << "RECOGNIZED: Text=" << e.Result->Text << " (text could not be translated)" << std::endl;
+            cout << "RECOGNIZED: Text=" << result->Text << " (text could not be translated)" << std::endl;
         }
-        else if (e.Result->Reason == ResultReason::NoMatch)
+        else if (result->Reason == ResultReason::NoMatch)
         {
             cout << "NOMATCH: Speech could not be recognized." << std::endl;
         }
-
-        for (const auto& it : e.Result->Translations)
-        {
-            cout << "  Translated into '" << it.first.c_str() << "': " << it.second.c_str() << std::endl;
-        }
     });
 
-    recognizer->Canceled.Connect([](const TranslationRecognitionCanceledEventArgs& e)
+    session.OnCanceled(recognizer->Canceled, [&outputMutex](const RecognitionSessionRunner::CancellationInfo& e)
     {
+        lock_guard<mutex> lock(outputMutex);
         cout << "CANCELED: Reason=" << (int)e.Reason << std::endl;
         if (e.Reason == CancellationReason::Error)
         {
@@ -136,8 +157,9 @@ void TranslationContinuousRecognition()
         }
     });
 
-    recognizer->Synthesizing.Connect([](const TranslationSynthesisEventArgs& e)
+    recognizer->Synthesizing.Connect([&outputMutex](const TranslationSynthesisEventArgs& e)
     {
+        lock_guard<mutex> lock(outputMutex);
         auto size = e.Result->Audio.size();
         cout << "Translation synthesis result: size of audio data: " << size
              << (size == 0 ? "(END)" : "");
@@ -154,6 +176,99 @@ void TranslationContinuousRecognition()
 
     // Stops recognition.
     recognizer->StopContinuousRecognitionAsync().get();
+
+    auto statistics = dispatcher.GetStatistics();
+    cout << "Delivered " << statistics.Delivered << " of " << statistics.Received << " translations in "
+         << statistics.Batches << " batches." << std::endl;
+}
+
+// Speech to speech translation: the final translations are spoken while recognition goes on.
+void TranslationContinuousRecognitionToSpeech()
+{
+    // Creates an instance of a speech translation config with specified subscription key and service region.
+    // Replace with your own subscription key and service region (e.g., "westus").
+    auto config = SpeechTranslationConfig::FromSubscription("YourSubscriptionKey", "YourServiceRegion");
+    config->SetSpeechRecognitionLanguage("en-US");
+    config->AddTargetLanguage("de");
+    config->AddTargetLanguage("fr");
+
+    // The synthesis config of the same subscription. Raw PCM, so the utterances of a language form one stream.
+    auto synthesisConfig = SpeechConfig::FromSubscription("YourSubscriptionKey", "YourServiceRegion");
+    synthesisConfig->SetSpeechSynthesisOutputFormat(SpeechSynthesisOutputFormat::Raw16Khz16BitMonoPcm);
+
+    // Writes the audio of a language to a file, in order of the utterances.
+    class FileOutput : public PushAudioOutputStreamCallback
+    {
+    public:
+        explicit FileOutput(const string& fileName) : m_file(fileName, ios::binary) {}
+
+        int Write(uint8_t* dataBuffer, uint32_t size) override
+        {
+            m_file.write(reinterpret_cast<const char*>(dataBuffer), size);
+            return (int)size;
+        }
+
+        void Close() override
+        {
+            m_file.close();
+        }
+
+    private:
+        ofstream m_file;
+    };
+
+    // One lane per target language, each with its own synthesizer, so German and French are spoken at the same time.
+    unique_ptr<SpeechToSpeechInterpreter> interpreter;
+    try
+    {
+        interpreter = make_unique<SpeechToSpeechInterpreter>(synthesisConfig, vector<SpeechToSpeechInterpreter::Lane>{
+            { "de", "de-DE-KatjaNeural", make_shared<FileOutput>("translation_de.raw") },
+            { "fr", "fr-FR-DeniseNeural", make_shared<FileOutput>("translation_fr.raw") } });
+    }
+    catch (const exception& e)
+    {
+        cout << "Cannot create the interpreter: " << e.what() << std::endl;
+        return;
+    }
+
+    RecognitionSessionRunner session;
+
+    // Replace with your own audio file name.
+    auto recognizer = TranslationRecognizer::FromConfig(config, AudioConfig::FromWavFileInput("whatstheweatherlike.wav"));
+
+    // Queues every final translation in the lane of its language; synthesis runs while the next utterance is recognized.
+    interpreter->Attach(*recognizer);
+
+    session.OnFinal(recognizer->Recognized, [](const shared_ptr<TranslationRecognitionResult>& result)
+    {
+        if (result->Reason == ResultReason::TranslatedSpeech)
+        {
+            cout << "RECOGNIZED: Text=" << result->Text << std::endl;
+            for (const auto& it : result->Translations)
+            {
+                cout << "  Translated into '" << it.first << "': " << it.second << std::endl;
+            }
+        }
+    });
+
+    session.OnCanceled(recognizer->Canceled, [](const RecognitionSessionRunner::CancellationInfo& e)
+    {
+        if (e.Reason == CancellationReason::Error)
+        {
+            cout << "CANCELED: ErrorCode=" << (int)e.ErrorCode << std::endl;
+            cout << "CANCELED: ErrorDetails=" << e.ErrorDetails << std::endl;
+        }
+    });
+
+    session.RunContinuous(*recognizer);
+
+    // Waits for the translations still being spoken.
+    interpreter->Finish();
+    for (const auto& lane : interpreter->GetStatistics())
+    {
+        cout << "Lane '" << lane.Language << "': Utterances=" << lane.Utterances << " Failures=" << lane.Failures
+             << " Bytes=" << lane.Bytes << " MeanDelayMs=" << lane.MeanDelay.count() << " MaxDelayMs=" << lane.MaxDelay.count() << std::endl;
+    }
 }
 
 #pragma region Language Detection related samples
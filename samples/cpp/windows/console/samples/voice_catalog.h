@@ -0,0 +1,245 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#pragma once
+
+#include <speechapi_cxx.h>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "file_replace.h"
+
+// List of available synthesis voices, fetched from the service once and kept in a file for 'ttl'.
+// A process starting with a list that is still fresh does not contact the service at all. With a stale
+// list it serves the stale voices right away and refreshes them in the background. Only without any list
+// on disk does the first lookup wait for the service.
+// The file holds one voice per line with tab separated fields, after a header line with the fetch time.
+class VoiceCatalog final
+{
+public:
+    struct Voice
+    {
+        std::string Name;
+        std::string ShortName;
+        std::string Locale;
+        std::string LocalName;
+        int Gender = 0;
+    };
+
+    VoiceCatalog(std::shared_ptr<Microsoft::CognitiveServices::Speech::SpeechConfig> config, const std::string& fileName,
+        std::chrono::seconds ttl = std::chrono::hours(24))
+        : m_config(std::move(config)), m_fileName(fileName), m_ttl(ttl)
+    {
+        std::time_t fetched = 0;
+        auto voices = std::make_shared<Index>();
+        if (Load(*voices, fetched))
+        {
+            m_index = voices;
+            if (std::time(nullptr) - fetched >= m_ttl.count())
+            {
+                m_refresh = std::thread([this]() { RefreshInBackground(); });
+            }
+        }
+    }
+
+    VoiceCatalog(const VoiceCatalog&) = delete;
+    VoiceCatalog& operator=(const VoiceCatalog&) = delete;
+
+    ~VoiceCatalog()
+    {
+        if (m_refresh.joinable())
+        {
+            m_refresh.join();
+        }
+    }
+
+    // Returns the voice with the given full or short name, or nullptr when there is none.
+    std::shared_ptr<const Voice> FindByName(const std::string& name)
+    {
+        auto index = GetIndex();
+        auto voice = index->ByName.find(name);
+        if (voice == index->ByName.end())
+        {
+            return nullptr;
+        }
+        return std::shared_ptr<const Voice>(index, &index->Voices[voice->second]);
+    }
+
+    // Returns the voices of a locale (e.g. en-US), or all voices for an empty locale.
+    std::vector<Voice> FindByLocale(const std::string& locale)
+    {
+        auto index = GetIndex();
+        if (locale.empty())
+        {
+            return index->Voices;
+        }
+        std::vector<Voice> voices;
+        auto range = index->ByLocale.equal_range(locale);
+        for (auto voice = range.first; voice != range.second; ++voice)
+        {
+            voices.push_back(index->Voices[voice->second]);
+        }
+        return voices;
+    }
+
+    // Fetches the voices from the service and replaces the list in memory and on disk.
+    // Throws std::runtime_error when the voices cannot be retrieved.
+    void Refresh()
+    {
+        using namespace Microsoft::CognitiveServices::Speech;
+
+        auto synthesizer = SpeechSynthesizer::FromConfig(m_config, nullptr);
+        auto result = synthesizer->GetVoicesAsync().get();
+        if (result->Reason != ResultReason::VoicesListRetrieved)
+        {
+            throw std::runtime_error("Failed to retrieve the voices: " + result->ErrorDetails);
+        }
+
+        auto index = std::make_shared<Index>();
+        for (const auto& info : result->Voices)
+        {
+            Voice voice;
+            voice.Name = info->Name;
+            voice.ShortName = info->ShortName;
+            voice.Locale = info->Locale;
+            voice.LocalName = info->LocalName;
+            voice.Gender = (int)info->Gender;
+            index->Add(std::move(voice));
+        }
+        Save(*index);
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_index = index;
+    }
+
+private:
+    static constexpr const char* fileHeader = "voices-v1";
+
+    struct Index
+    {
+        std::vector<Voice> Voices;
+        std::unordered_map<std::string, size_t> ByName;
+        std::multimap<std::string, size_t> ByLocale;
+
+        void Add(Voice voice)
+        {
+            auto position = Voices.size();
+            ByName[voice.Name] = position;
+            if (!voice.ShortName.empty())
+            {
+                ByName[voice.ShortName] = position;
+            }
+            ByLocale.emplace(voice.Locale, position);
+            Voices.push_back(std::move(voice));
+        }
+    };
+
+    // Returns the current list, fetching it first when there is none yet.
+    std::shared_ptr<const Index> GetIndex()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (m_index)
+            {
+                return m_index;
+            }
+        }
+
+        // Only one thread fetches, the others wait for it.
+        std::lock_guard<std::mutex> fetchLock(m_fetchMutex);
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (m_index)
+            {
+                return m_index;
+            }
+        }
+        Refresh();
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_index;
+    }
+
+    void RefreshInBackground()
+    {
+        try
+        {
+            Refresh();
+        }
+        catch (const std::exception&)
+        {
+            // Keeps serving the stale list, the next start tries again.
+        }
+    }
+
+    bool Load(Index& index, std::time_t& fetched) const
+    {
+        std::ifstream file(m_fileName);
+        std::string header;
+        if (!(file >> header >> fetched) || header != fileHeader)
+        {
+            return false;
+        }
+
+        std::string line;
+        std::getline(file, line);
+        while (std::getline(file, line))
+        {
+            std::istringstream fields(line);
+            Voice voice;
+            std::string gender;
+            if (std::getline(fields, voice.Name, '\t') && std::getline(fields, voice.ShortName, '\t') &&
+                std::getline(fields, voice.Locale, '\t') && std::getline(fields, voice.LocalName, '\t') &&
+                std::getline(fields, gender))
+            {
+                voice.Gender = std::atoi(gender.c_str());
+                index.Add(std::move(voice));
+            }
+        }
+        return !index.Voices.empty();
+    }
+
+    // Writes to a temporary file first, so a process starting meanwhile never reads a partial list.
+    void Save(const Index& index) const
+    {
+        auto temporaryName = m_fileName + ".tmp";
+        {
+            std::ofstream file(temporaryName, std::ios::trunc);
+            file << fileHeader << ' ' << std::time(nullptr) << '\n';
+            for (const auto& voice : index.Voices)
+            {
+                file << voice.Name << '\t' << voice.ShortName << '\t' << voice.Locale << '\t' << voice.LocalName << '\t' << voice.Gender << '\n';
+            }
+            file.close();
+            if (file.fail())
+            {
+                std::remove(temporaryName.c_str());
+                return;
+            }
+        }
+        if (!MoveFileOver(temporaryName, m_fileName))
+        {
+            std::remove(temporaryName.c_str());
+        }
+    }
+
+    const std::shared_ptr<Microsoft::CognitiveServices::Speech::SpeechConfig> m_config;
+    const std::string m_fileName;
+    const std::chrono::seconds m_ttl;
+
+    std::mutex m_mutex;
+    std::mutex m_fetchMutex;
+    std::shared_ptr<const Index> m_index;
+    std::thread m_refresh;
+};
@@ -0,0 +1,229 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#pragma once
+
+#include <speechapi_cxx.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include "read_ahead_audio_callback.h"
+
+// Creates and enrolls many voice profiles from recorded audio, e.g. when onboarding the speakers of a customer.
+// Up to 'MaxConcurrent' speakers are enrolled at once, each with its own pull stream per audio file through a
+// shared VoiceProfileClient. Throttled requests (TooManyRequests, ServiceUnavailable, or an exception from the
+// client) are retried with exponential backoff. Every finished speaker is appended to the manifest right away,
+// as a tab-separated line "<speaker>\t<profile id>\t<status>\t<details>", so an interrupted run loses nothing
+// and can be resumed by leaving out the speakers already in the manifest.
+class VoiceProfileBulkEnroller final
+{
+public:
+    using VoiceProfileType = Microsoft::CognitiveServices::Speech::Speaker::VoiceProfileType;
+
+    struct Speaker
+    {
+        // The application's key of the speaker, written to the manifest next to the profile id.
+        std::string Key;
+        // WAV files (16 kHz, 16-bit mono) used in turn until the profile is enrolled.
+        std::vector<std::string> AudioFiles;
+    };
+
+    struct Settings
+    {
+        VoiceProfileType ProfileType = VoiceProfileType::TextIndependentIdentification;
+        std::string Locale = "en-us";
+        unsigned MaxConcurrent = 8;
+        // Attempts of one request before the speaker is given up.
+        unsigned MaxAttempts = 6;
+        uint32_t InitialBackoffMs = 500;
+        uint32_t MaxBackoffMs = 30000;
+    };
+
+    struct Statistics
+    {
+        uint64_t Enrolled = 0;
+        // Speakers whose audio ran out before the profile was enrolled.
+        uint64_t Incomplete = 0;
+        uint64_t Failed = 0;
+        uint64_t Retries = 0;
+    };
+
+    VoiceProfileBulkEnroller(std::shared_ptr<Microsoft::CognitiveServices::Speech::Speaker::VoiceProfileClient> client, const Settings& settings)
+        : m_client(std::move(client)), m_settings(settings)
+    {
+        if (m_settings.MaxConcurrent == 0 || m_settings.MaxAttempts == 0)
+        {
+            throw std::invalid_argument("Concurrency and attempts must be at least 1.");
+        }
+    }
+
+    explicit VoiceProfileBulkEnroller(std::shared_ptr<Microsoft::CognitiveServices::Speech::Speaker::VoiceProfileClient> client)
+        : VoiceProfileBulkEnroller(std::move(client), Settings())
+    {
+    }
+
+    // Enrolls all speakers and writes one manifest line each, in the order they finish. Returns when all are done.
+    Statistics Run(const std::vector<Speaker>& speakers, std::ostream& manifest)
+    {
+        m_statistics = Statistics();
+        std::atomic<size_t> next(0);
+        auto worker = [&]()
+        {
+            for (auto index = next++; index < speakers.size(); index = next++)
+            {
+                Outcome outcome;
+                try
+                {
+                    outcome = Enroll(speakers[index]);
+                }
+                catch (const std::exception& e)
+                {
+                    outcome.Status = "failed";
+                    outcome.Details = e.what();
+                }
+
+                std::lock_guard<std::mutex> lock(m_mutex);
+                manifest << speakers[index].Key << '\t' << outcome.ProfileId << '\t' << outcome.Status << '\t' << outcome.Details << '\n';
+                manifest.flush();
+                if (outcome.Status == "enrolled")
+                {
+                    m_statistics.Enrolled++;
+                }
+                else if (outcome.Status == "incomplete")
+                {
+                    m_statistics.Incomplete++;
+                }
+                else
+                {
+                    m_statistics.Failed++;
+                }
+            }
+        };
+
+        std::vector<std::thread> workers;
+        auto count = std::min<size_t>(m_settings.MaxConcurrent, speakers.size());
+        for (size_t i = 0; i < count; i++)
+        {
+            workers.emplace_back(worker);
+        }
+        for (auto& t : workers)
+        {
+            t.join();
+        }
+        return m_statistics;
+    }
+
+private:
+    struct Outcome
+    {
+        std::string ProfileId;
+        std::string Status;
+        std::string Details;
+    };
+
+    Outcome Enroll(const Speaker& speaker)
+    {
+        using namespace Microsoft::CognitiveServices::Speech;
+        using namespace Microsoft::CognitiveServices::Speech::Audio;
+        using namespace Microsoft::CognitiveServices::Speech::Speaker;
+
+        Outcome outcome;
+        std::shared_ptr<VoiceProfile> profile;
+        WithRetry([&]()
+        {
+            profile = m_client->CreateProfileAsync(m_settings.ProfileType, m_settings.Locale).get();
+            return true;
+        });
+        outcome.ProfileId = profile->GetId();
+
+        for (const auto& audioFile : speaker.AudioFiles)
+        {
+            std::shared_ptr<VoiceProfileEnrollmentResult> result;
+            bool throttled = false;
+            WithRetry([&]()
+            {
+                // A new stream for every attempt, a throttled request may have consumed part of the audio.
+                auto pullStream = AudioInputStream::CreatePullStream(CreateReadAheadWavFileCallback(audioFile));
+                result = m_client->EnrollProfileAsync(profile, AudioConfig::FromStreamInput(pullStream)).get();
+                throttled = false;
+                if (result->Reason == ResultReason::Canceled)
+                {
+                    auto cancellation = VoiceProfileEnrollmentCancellationDetails::FromResult(result);
+                    throttled = IsThrottling(cancellation->ErrorCode);
+                    outcome.Details = cancellation->ErrorDetails;
+                }
+                return !throttled;
+            });
+
+            if (result->Reason == ResultReason::EnrolledVoiceProfile)
+            {
+                outcome.Status = "enrolled";
+                outcome.Details.clear();
+                return outcome;
+            }
+            if (result->Reason == ResultReason::Canceled)
+            {
+                outcome.Status = throttled ? "throttled" : "failed";
+                return outcome;
+            }
+            // EnrollingVoiceProfile: more audio is needed, goes on with the next file.
+        }
+
+        outcome.Status = "incomplete";
+        outcome.Details = "not enough audio";
+        return outcome;
+    }
+
+    static bool IsThrottling(Microsoft::CognitiveServices::Speech::CancellationErrorCode errorCode)
+    {
+        using Microsoft::CognitiveServices::Speech::CancellationErrorCode;
+        return errorCode == CancellationErrorCode::TooManyRequests || errorCode == CancellationErrorCode::ServiceUnavailable;
+    }
+
+    // Calls 'attempt' until it returns true, waiting with exponential backoff after a false return or an
+    // exception. The last exception is rethrown when all attempts are used up; after a last false return,
+    // the caller looks at the state left by 'attempt'.
+    void WithRetry(const std::function<bool()>& attempt)
+    {
+        auto backoffMs = m_settings.InitialBackoffMs;
+        for (unsigned attempts = 1;; attempts++)
+        {
+            try
+            {
+                if (attempt() || attempts == m_settings.MaxAttempts)
+                {
+                    return;
+                }
+            }
+            catch (const std::exception&)
+            {
+                if (attempts == m_settings.MaxAttempts)
+                {
+                    throw;
+                }
+            }
+
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_statistics.Retries++;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(backoffMs));
+            backoffMs = std::min(backoffMs * 2, m_settings.MaxBackoffMs);
+        }
+    }
+
+    std::shared_ptr<Microsoft::CognitiveServices::Speech::Speaker::VoiceProfileClient> m_client;
+    const Settings m_settings;
+
+    std::mutex m_mutex;
+    Statistics m_statistics;
+};
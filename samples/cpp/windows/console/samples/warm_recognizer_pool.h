@@ -0,0 +1,319 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#pragma once
+
+#include <speechapi_cxx.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+
+// Pool of recognizers whose service connections are opened ahead of time, for single-shot recognition
+// like voice commands. The first RecognizeOnceAsync() of a new recognizer has to set up TLS and the
+// websocket on the user-visible path, a recognizer from the pool already has a connection.
+// A background thread checks the idle recognizers every 'healthCheckInterval', reopens connections the
+// service has closed and tops the pool up after recognizers have been discarded or handed out.
+// 'RecognizerType' is SpeechRecognizer, IntentRecognizer or any other recognizer with a Connection.
+template <class RecognizerType>
+class WarmRecognizerPool final
+{
+    struct Entry;
+
+public:
+    // Creates a recognizer, e.g. with its language, audio input and intent models already set up.
+    using Factory = std::function<std::shared_ptr<RecognizerType>()>;
+
+    struct Statistics
+    {
+        // Leases handed out with an open connection.
+        uint64_t WarmLeases = 0;
+        // Leases that had to connect first, because no recognizer was idle or its connection was closed.
+        uint64_t ColdLeases = 0;
+        // Connections reopened by the health check.
+        uint64_t Reconnects = 0;
+    };
+
+    // A recognizer handed out by the pool. It goes back to the pool when the lease is destroyed.
+    class Lease final
+    {
+    public:
+        Lease(Lease&& other) : m_pool(other.m_pool), m_entry(std::move(other.m_entry)), m_warm(other.m_warm)
+        {
+            other.m_pool = nullptr;
+        }
+
+        Lease(const Lease&) = delete;
+        Lease& operator=(const Lease&) = delete;
+        Lease& operator=(Lease&&) = delete;
+
+        ~Lease()
+        {
+            if (m_pool != nullptr && m_entry)
+            {
+                m_pool->Release(std::move(m_entry));
+            }
+        }
+
+        RecognizerType* operator->() const
+        {
+            return m_entry->Recognizer.get();
+        }
+
+        std::shared_ptr<RecognizerType> Get() const
+        {
+            return m_entry->Recognizer;
+        }
+
+        // Whether the recognizer had an open connection when it was handed out.
+        bool IsWarm() const
+        {
+            return m_warm;
+        }
+
+        // Drops the recognizer instead of returning it, e.g. after a canceled recognition.
+        void Discard()
+        {
+            m_entry.reset();
+            if (m_pool != nullptr)
+            {
+                m_pool->RequestRefill();
+            }
+        }
+
+    private:
+        friend class WarmRecognizerPool;
+
+        Lease(WarmRecognizerPool* pool, std::shared_ptr<Entry> entry, bool warm) : m_pool(pool), m_entry(std::move(entry)), m_warm(warm)
+        {
+        }
+
+        WarmRecognizerPool* m_pool;
+        std::shared_ptr<Entry> m_entry;
+        bool m_warm;
+    };
+
+    // Creates 'size' recognizers and opens their connections. The pool must outlive its leases.
+    WarmRecognizerPool(Factory factory, size_t size, std::chrono::seconds healthCheckInterval = std::chrono::seconds(30))
+        : m_factory(std::move(factory)), m_size(size), m_healthCheckInterval(healthCheckInterval)
+    {
+        if (!m_factory || size == 0)
+        {
+            throw std::invalid_argument("The pool needs a recognizer factory and at least one recognizer.");
+        }
+
+        for (size_t i = 0; i < size; i++)
+        {
+            m_idle.push_back(CreateEntry());
+        }
+        m_thread = std::thread([this]() { Maintain(); });
+    }
+
+    WarmRecognizerPool(const WarmRecognizerPool&) = delete;
+    WarmRecognizerPool& operator=(const WarmRecognizerPool&) = delete;
+
+    ~WarmRecognizerPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stopping = true;
+        }
+        m_wakeUp.notify_one();
+        m_thread.join();
+    }
+
+    // Hands out an idle recognizer, preferring one with an open connection. When all are in use, a new
+    // recognizer is created on the spot rather than waiting for one to come back.
+    Lease Acquire()
+    {
+        std::shared_ptr<Entry> entry;
+        bool warm = false;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            for (auto candidate = m_idle.begin(); candidate != m_idle.end(); ++candidate)
+            {
+                if ((*candidate)->Connected)
+                {
+                    entry = std::move(*candidate);
+                    m_idle.erase(candidate);
+                    break;
+                }
+            }
+            if (!entry && !m_idle.empty())
+            {
+                entry = std::move(m_idle.front());
+                m_idle.pop_front();
+            }
+
+            warm = entry && entry->Connected;
+            if (warm)
+            {
+                m_statistics.WarmLeases++;
+            }
+            else
+            {
+                m_statistics.ColdLeases++;
+            }
+        }
+        RequestRefill();
+
+        if (!entry)
+        {
+            entry = CreateEntry();
+        }
+        return Lease(this, std::move(entry), warm);
+    }
+
+    // Changes the number of recognizers kept connected. Growing connects the new ones in the background; shrinking
+    // closes idle recognizers, and leases returned while the pool is over its size.
+    void Resize(size_t size)
+    {
+        if (size == 0)
+        {
+            throw std::invalid_argument("The pool needs at least one recognizer.");
+        }
+        std::deque<std::shared_ptr<Entry>> removed;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_size = size;
+            while (m_idle.size() > m_size)
+            {
+                // The least recently used recognizers are at the back.
+                removed.push_back(std::move(m_idle.back()));
+                m_idle.pop_back();
+            }
+        }
+        // The removed recognizers are destroyed here, without the lock.
+        removed.clear();
+        RequestRefill();
+    }
+
+    size_t Size()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_size;
+    }
+
+    Statistics GetStatistics()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_statistics;
+    }
+
+private:
+    struct Entry
+    {
+        std::shared_ptr<RecognizerType> Recognizer;
+        std::atomic<bool> Connected{ false };
+        // Declared last, so it is destroyed first and disconnects its event handlers before 'Connected' is gone.
+        std::shared_ptr<Microsoft::CognitiveServices::Speech::Connection> Connection;
+    };
+
+    std::shared_ptr<Entry> CreateEntry()
+    {
+        using namespace Microsoft::CognitiveServices::Speech;
+
+        auto entry = std::make_shared<Entry>();
+        entry->Recognizer = m_factory();
+        entry->Connection = Connection::FromRecognizer(entry->Recognizer);
+
+        auto connected = &entry->Connected;
+        entry->Connection->Connected.Connect([connected](const ConnectionEventArgs&) { *connected = true; });
+        entry->Connection->Disconnected.Connect([connected](const ConnectionEventArgs&) { *connected = false; });
+        entry->Connection->Open(false);
+        return entry;
+    }
+
+    void Release(std::shared_ptr<Entry> entry)
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        if (!m_stopping && m_idle.size() < m_size)
+        {
+            // The recognizer used last has the most recently used connection, so it is handed out first.
+            m_idle.push_front(std::move(entry));
+            return;
+        }
+        // A recognizer that is not kept is destroyed without the lock.
+        lock.unlock();
+        entry.reset();
+    }
+
+    void RequestRefill()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_refill = true;
+        }
+        m_wakeUp.notify_one();
+    }
+
+    void Maintain()
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        while (true)
+        {
+            m_wakeUp.wait_for(lock, m_healthCheckInterval, [this]() { return m_stopping || m_refill; });
+            if (m_stopping)
+            {
+                return;
+            }
+            m_refill = false;
+
+            // Connections are opened without the lock, so Acquire() never waits for them.
+            auto idle = m_idle;
+            auto missing = m_idle.size() < m_size ? m_size - m_idle.size() : 0;
+            lock.unlock();
+
+            uint64_t reconnects = 0;
+            for (auto& entry : idle)
+            {
+                if (!entry->Connected)
+                {
+                    entry->Connection->Open(false);
+                    reconnects++;
+                }
+            }
+
+            std::deque<std::shared_ptr<Entry>> created;
+            try
+            {
+                for (size_t i = 0; i < missing; i++)
+                {
+                    created.push_back(CreateEntry());
+                }
+            }
+            catch (const std::exception&)
+            {
+                // Tries again with the next health check, Acquire() falls back to creating recognizers itself.
+            }
+
+            lock.lock();
+            m_statistics.Reconnects += reconnects;
+            for (auto& entry : created)
+            {
+                if (m_idle.size() < m_size)
+                {
+                    m_idle.push_back(std::move(entry));
+                }
+            }
+        }
+    }
+
+    const Factory m_factory;
+    size_t m_size;
+    const std::chrono::seconds m_healthCheckInterval;
+
+    std::mutex m_mutex;
+    std::condition_variable m_wakeUp;
+    std::deque<std::shared_ptr<Entry>> m_idle;
+    Statistics m_statistics;
+    bool m_refill = false;
+    bool m_stopping = false;
+    std::thread m_thread;
+};
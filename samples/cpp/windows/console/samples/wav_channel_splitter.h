@@ -0,0 +1,331 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#pragma once
+
+#include <speechapi_cxx.h>
+#include <algorithm>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "wav_file_reader.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define PCM_DEINTERLEAVE_SSE2
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define PCM_DEINTERLEAVE_NEON
+#endif
+
+// Splits interleaved 16-bit PCM into one buffer per channel.
+class PcmDeinterleaver final
+{
+public:
+    // Channel counts up to this one take the vectorized path when they are a power of two.
+    static constexpr uint16_t maxVectorizedChannels = 32;
+
+    // Copies channel c of 'frames' frames of 'interleaved' into planes[c], for all 'channels' channels.
+    // 'scratch' is only used for more than two channels and must then hold 2 * frames * channels samples.
+    static void Deinterleave(const int16_t* interleaved, size_t frames, uint16_t channels, int16_t* const* planes, int16_t* scratch)
+    {
+        if (channels == 1)
+        {
+            memcpy(planes[0], interleaved, frames * sizeof(int16_t));
+        }
+        else if ((channels & (channels - 1)) == 0 && channels <= maxVectorizedChannels)
+        {
+            SplitPowerOfTwo(interleaved, frames, channels, planes, scratch);
+        }
+        else
+        {
+            for (size_t frame = 0; frame < frames; frame++)
+            {
+                for (uint16_t channel = 0; channel < channels; channel++)
+                {
+                    planes[channel][frame] = interleaved[frame * channels + channel];
+                }
+            }
+        }
+    }
+
+    // Moves the samples at even positions of 'samples' to 'even' and those at odd positions to 'odd'.
+    // 'count' is the number of samples in 'samples' and must be even.
+    static void SplitEvenOdd(const int16_t* samples, size_t count, int16_t* even, int16_t* odd)
+    {
+        size_t i = 0;
+#if defined(PCM_DEINTERLEAVE_SSE2)
+        // Each 32-bit lane holds an even sample in its low half and an odd sample in its high half. Shifts
+        // sign-extend either half to 32 bits, which packs back to 16 bits without saturating.
+        for (; i + 16 <= count; i += 16)
+        {
+            auto first = _mm_loadu_si128(reinterpret_cast<const __m128i*>(samples + i));
+            auto second = _mm_loadu_si128(reinterpret_cast<const __m128i*>(samples + i + 8));
+            auto evenSamples = _mm_packs_epi32(_mm_srai_epi32(_mm_slli_epi32(first, 16), 16), _mm_srai_epi32(_mm_slli_epi32(second, 16), 16));
+            auto oddSamples = _mm_packs_epi32(_mm_srai_epi32(first, 16), _mm_srai_epi32(second, 16));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(even + i / 2), evenSamples);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(odd + i / 2), oddSamples);
+        }
+#elif defined(PCM_DEINTERLEAVE_NEON)
+        for (; i + 16 <= count; i += 16)
+        {
+            auto pairs = vld2q_s16(samples + i);
+            vst1q_s16(even + i / 2, pairs.val[0]);
+            vst1q_s16(odd + i / 2, pairs.val[1]);
+        }
+#endif
+        for (; i < count; i += 2)
+        {
+            even[i / 2] = samples[i];
+            odd[i / 2] = samples[i + 1];
+        }
+    }
+
+private:
+    // Frames of N channels are N/2 pairs of samples: the even samples are the even channels and the odd
+    // samples the odd channels, each still interleaved with N/2 channels. Splitting them again until one
+    // channel is left takes log2(N) passes of SplitEvenOdd() over data that stays in the cache.
+    static void SplitPowerOfTwo(const int16_t* interleaved, size_t frames, uint16_t channels, int16_t* const* planes, int16_t* scratch)
+    {
+        if (channels == 2)
+        {
+            SplitEvenOdd(interleaved, frames * 2, planes[0], planes[1]);
+            return;
+        }
+
+        auto half = (size_t)frames * channels / 2;
+        auto even = scratch;
+        auto odd = scratch + half;
+        SplitEvenOdd(interleaved, frames * channels, even, odd);
+
+        int16_t* evenPlanes[maxVectorizedChannels / 2];
+        int16_t* oddPlanes[maxVectorizedChannels / 2];
+        for (uint16_t channel = 0; channel < channels / 2; channel++)
+        {
+            evenPlanes[channel] = planes[channel * 2];
+            oddPlanes[channel] = planes[channel * 2 + 1];
+        }
+
+        // Both halves reuse the scratch space behind the current level.
+        SplitPowerOfTwo(even, frames, channels / 2, evenPlanes, scratch + 2 * half);
+        SplitPowerOfTwo(odd, frames, channels / 2, oddPlanes, scratch + 2 * half);
+    }
+};
+
+// Reads a multi-channel 16-bit PCM WAV file once and passes the channels on as separate mono streams,
+// e.g. the agent and the customer of a stereo call center recording, each to its own recognizer.
+// The file is read block by block when a stream runs out of audio, so no channel is decoded twice.
+// A stream that gets too far ahead of the others waits for them, which bounds the memory used; a stream
+// closed by its recognizer is not waited for anymore.
+class MultiChannelWavSplitter final : public std::enable_shared_from_this<MultiChannelWavSplitter>
+{
+public:
+    // Opens 'audioFileName' and splits the channels in 'channels', or all channels when it is empty.
+    // Throws std::invalid_argument when the file is not 16-bit PCM, or a channel does not exist or is selected twice.
+    static std::shared_ptr<MultiChannelWavSplitter> Open(const std::string& audioFileName, std::vector<uint16_t> channels = {},
+        uint32_t blockDurationMs = 100, size_t maxQueuedBlocks = 8)
+    {
+        return std::shared_ptr<MultiChannelWavSplitter>(new MultiChannelWavSplitter(audioFileName, std::move(channels), blockDurationMs, maxQueuedBlocks));
+    }
+
+    MultiChannelWavSplitter(const MultiChannelWavSplitter&) = delete;
+    MultiChannelWavSplitter& operator=(const MultiChannelWavSplitter&) = delete;
+
+    // Returns the number of mono streams, one per selected channel.
+    size_t GetStreamCount() const
+    {
+        return m_streams.size();
+    }
+
+    // Returns the channel of the file that stream 'index' carries.
+    uint16_t GetChannel(size_t index) const
+    {
+        return m_streams.at(index).Channel;
+    }
+
+    // Returns the format of every mono stream.
+    std::shared_ptr<Microsoft::CognitiveServices::Speech::Audio::AudioStreamFormat> GetStreamFormat() const
+    {
+        return Microsoft::CognitiveServices::Speech::Audio::AudioStreamFormat::GetWaveFormatPCM(m_format.SamplesPerSec, 16, 1);
+    }
+
+    // Returns a pull stream callback for stream 'index'. Each stream can be read by one recognizer.
+    std::shared_ptr<Microsoft::CognitiveServices::Speech::Audio::PullAudioInputStreamCallback> GetStreamCallback(size_t index)
+    {
+        if (index >= m_streams.size())
+        {
+            throw std::out_of_range("No such channel stream.");
+        }
+        return std::make_shared<ChannelCallback>(shared_from_this(), index);
+    }
+
+private:
+    class ChannelCallback final : public Microsoft::CognitiveServices::Speech::Audio::PullAudioInputStreamCallback
+    {
+    public:
+        ChannelCallback(std::shared_ptr<MultiChannelWavSplitter> splitter, size_t index)
+            : m_splitter(std::move(splitter)), m_index(index)
+        {
+        }
+
+        int Read(uint8_t* dataBuffer, uint32_t size) override
+        {
+            return m_splitter->Read(m_index, dataBuffer, size);
+        }
+
+        void Close() override
+        {
+            m_splitter->Close(m_index);
+        }
+
+    private:
+        const std::shared_ptr<MultiChannelWavSplitter> m_splitter;
+        const size_t m_index;
+    };
+
+    struct Stream
+    {
+        uint16_t Channel;
+        std::deque<std::vector<int16_t>> Blocks;
+        // Samples of the front block that have been read already.
+        size_t Position = 0;
+        bool Closed = false;
+    };
+
+    MultiChannelWavSplitter(const std::string& audioFileName, std::vector<uint16_t> channels, uint32_t blockDurationMs, size_t maxQueuedBlocks)
+        : m_reader(audioFileName), m_format(m_reader.GetFormat()), m_maxQueuedBlocks(std::max<size_t>(1, maxQueuedBlocks))
+    {
+        if (m_format.BitsPerSample != 16 || m_format.Channels == 0 || m_format.BlockAlign != m_format.Channels * 2)
+        {
+            throw std::invalid_argument("Only 16-bit PCM audio can be split into channels.");
+        }
+
+        if (channels.empty())
+        {
+            for (uint16_t channel = 0; channel < m_format.Channels; channel++)
+            {
+                channels.push_back(channel);
+            }
+        }
+        for (auto channel : channels)
+        {
+            if (channel >= m_format.Channels)
+            {
+                throw std::invalid_argument("The audio file does not have channel " + std::to_string(channel) + ".");
+            }
+            if (std::any_of(m_streams.begin(), m_streams.end(), [channel](const Stream& stream) { return stream.Channel == channel; }))
+            {
+                throw std::invalid_argument("Channel " + std::to_string(channel) + " is selected more than once.");
+            }
+            Stream stream;
+            stream.Channel = channel;
+            m_streams.push_back(std::move(stream));
+        }
+
+        m_blockFrames = std::max<uint32_t>(1, (uint32_t)((uint64_t)m_format.SamplesPerSec * blockDurationMs / 1000));
+        m_interleaved.resize((size_t)m_blockFrames * m_format.Channels);
+        m_planes.resize(m_format.Channels);
+        m_scratch.resize(m_format.Channels > 2 ? 2 * m_interleaved.size() : 0);
+    }
+
+    int Read(size_t index, uint8_t* dataBuffer, uint32_t size)
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        auto& stream = m_streams[index];
+        while (stream.Blocks.empty() && !m_endOfFile)
+        {
+            if (MayReadBlock())
+            {
+                ReadBlock();
+            }
+            else
+            {
+                m_drained.wait(lock);
+            }
+        }
+
+        // Copies whole samples only, the SDK asks for an even number of bytes.
+        uint32_t copied = 0;
+        while (!stream.Blocks.empty() && copied + sizeof(int16_t) <= size)
+        {
+            auto& block = stream.Blocks.front();
+            auto count = std::min<size_t>(block.size() - stream.Position, (size - copied) / sizeof(int16_t));
+            memcpy(dataBuffer + copied, block.data() + stream.Position, count * sizeof(int16_t));
+            copied += (uint32_t)(count * sizeof(int16_t));
+            stream.Position += count;
+            if (stream.Position == block.size())
+            {
+                stream.Blocks.pop_front();
+                stream.Position = 0;
+                m_drained.notify_all();
+            }
+        }
+        return (int)copied;
+    }
+
+    void Close(size_t index)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_streams[index].Closed = true;
+        m_streams[index].Blocks.clear();
+        m_drained.notify_all();
+    }
+
+    // Returns true when no open stream has reached the queue limit. Must be called with the lock held.
+    bool MayReadBlock() const
+    {
+        return std::none_of(m_streams.begin(), m_streams.end(), [this](const Stream& stream)
+        {
+            return !stream.Closed && stream.Blocks.size() >= m_maxQueuedBlocks;
+        });
+    }
+
+    // Reads the next block of frames and appends each channel to its stream. Must be called with the lock held.
+    void ReadBlock()
+    {
+        auto bytes = m_reader.Read(reinterpret_cast<uint8_t*>(m_interleaved.data()), (uint32_t)(m_interleaved.size() * sizeof(int16_t)));
+        auto frames = bytes > 0 ? (size_t)bytes / m_format.BlockAlign : 0;
+        if (frames == 0)
+        {
+            m_endOfFile = true;
+            m_drained.notify_all();
+            return;
+        }
+
+        // The planes of all channels are filled in one pass, those not selected are then dropped.
+        std::vector<std::vector<int16_t>> blocks(m_format.Channels, std::vector<int16_t>(frames));
+        for (uint16_t channel = 0; channel < m_format.Channels; channel++)
+        {
+            m_planes[channel] = blocks[channel].data();
+        }
+        PcmDeinterleaver::Deinterleave(m_interleaved.data(), frames, m_format.Channels, m_planes.data(), m_scratch.data());
+
+        for (auto& stream : m_streams)
+        {
+            if (!stream.Closed)
+            {
+                stream.Blocks.push_back(std::move(blocks[stream.Channel]));
+            }
+        }
+        m_drained.notify_all();
+    }
+
+    WavFileReader m_reader;
+    const WavFileReader::WAVEFORMAT m_format;
+    const size_t m_maxQueuedBlocks;
+    uint32_t m_blockFrames = 0;
+
+    std::mutex m_mutex;
+    std::condition_variable m_drained;
+    std::vector<Stream> m_streams;
+    std::vector<int16_t> m_interleaved;
+    std::vector<int16_t*> m_planes;
+    std::vector<int16_t> m_scratch;
+    bool m_endOfFile = false;
+};
@@ -6,11 +6,50 @@
 
 #include <speechapi_cxx.h>
 #include <fstream>
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 
 // Helper functions
 class WavFileReader final
 {
 public:
+    // The format structure expected in wav files.
+    struct WAVEFORMAT
+    {
+        uint16_t FormatTag;        // format type.
+        uint16_t Channels;         // number of channels (i.e. mono, stereo...).
+        uint32_t SamplesPerSec;    // sample rate.
+        uint32_t AvgBytesPerSec;   // for buffer estimation.
+        uint16_t BlockAlign;       // block size of data.
+        uint16_t BitsPerSample;    // Number of bits per sample of mono data.
+    };
+    static_assert(sizeof(WAVEFORMAT) == 16, "unexpected size of WAVEFORMAT");
+
+    // The fields of WAVE_FORMAT_EXTENSIBLE that follow WAVEFORMAT in the 'fmt ' chunk.
+    struct FormatExtension
+    {
+        uint16_t ValidBitsPerSample = 0;   // bits of precision in each sample, at most BitsPerSample.
+        uint32_t ChannelMask = 0;          // speaker positions of the channels, 0 when not assigned.
+        uint16_t SubFormatTag = 0;         // format tag of the sub format GUID, 0 when it is not a standard one.
+    };
+
+    static constexpr uint16_t formatTagExtensible = 0xFFFE;
 
     // Constructor that creates an input stream from a file.
     WavFileReader(const std::string& audioFileName)
@@ -31,18 +70,29 @@ public:
         GetFormatFromWavFile();
     }
 
+    // Reads up to 'size' bytes of the 'data' chunk. The file is streamed, so data chunks of any size
+    // (up to 2^64 bytes in RF64 files) never have to fit in memory. Chunks after the audio are not returned.
     int Read(uint8_t* dataBuffer, uint32_t size)
     {
         if (m_fs.eof())
             // returns 0 to indicate that the stream reaches end.
             return 0;
+        if (m_dataSize > 0)
+        {
+            size = (uint32_t)std::min<uint64_t>(size, m_dataSize - std::min(m_position, m_dataSize));
+            if (size == 0)
+                return 0;
+        }
         m_fs.read((char*)dataBuffer, size);
         if (!m_fs.eof() && !m_fs.good())
             // returns 0 to close the stream on read error.
             return 0;
         else
+        {
             // returns the number of bytes that have been read.
+            m_position += (uint64_t)m_fs.gcount();
             return (int)m_fs.gcount();
+        }
     }
 
     void Close()
@@ -50,12 +100,79 @@ public:
         m_fs.close();
     }
 
+    // Returns the format read from the 'fmt ' chunk.
+    const WAVEFORMAT& GetFormat() const
+    {
+        return m_formatHeader;
+    }
+
+    // Returns the extension of a WAVE_FORMAT_EXTENSIBLE header, all zero for other formats.
+    const FormatExtension& GetFormatExtension() const
+    {
+        return m_formatExtension;
+    }
+
+    // Returns the format with the tag of the sub format in place of WAVE_FORMAT_EXTENSIBLE, e.g. 1 for
+    // integer PCM or 3 for float PCM, so code that only knows WAVEFORMAT can tell the sample encoding.
+    WAVEFORMAT GetSampleFormat() const
+    {
+        auto format = m_formatHeader;
+        if (format.FormatTag == formatTagExtensible && m_formatExtension.SubFormatTag != 0)
+        {
+            format.FormatTag = m_formatExtension.SubFormatTag;
+        }
+        return format;
+    }
+
+    // Moves the read position to 'ticks' (in 100 nanoseconds) from the start of the audio data, rounded down
+    // to a whole frame and limited to the size of the 'data' chunk. Returns the position actually moved to, in ticks.
+    // Throws std::runtime_error when the format does not allow to compute positions.
+    uint64_t SeekToTime(uint64_t ticks)
+    {
+        if (m_formatHeader.AvgBytesPerSec == 0 || m_formatHeader.BlockAlign == 0)
+        {
+            throw std::runtime_error("Cannot seek in audio with an unknown byte rate.");
+        }
+
+        // Split into seconds and the rest, so hours of audio do not overflow 64 bits.
+        uint64_t offset = ticks / ticksPerSecond * m_formatHeader.AvgBytesPerSec + ticks % ticksPerSecond * m_formatHeader.AvgBytesPerSec / ticksPerSecond;
+        if (m_dataSize > 0)
+        {
+            // Files written while streaming may have no size in the 'data' chunk, those are not limited.
+            offset = std::min<uint64_t>(offset, m_dataSize);
+        }
+        offset -= offset % m_formatHeader.BlockAlign;
+
+        // Seeking also resets the end of file reached by an earlier Read().
+        m_fs.clear();
+        m_fs.seekg(m_dataStart + (std::streamoff)offset, std::ios_base::beg);
+        m_position = offset;
+        return offset / m_formatHeader.AvgBytesPerSec * ticksPerSecond + offset % m_formatHeader.AvgBytesPerSec * ticksPerSecond / m_formatHeader.AvgBytesPerSec;
+    }
+
+    // Returns the size of the audio data, as given by the 'data' chunk or, in RF64 files, the 'ds64' chunk.
+    // Returns 0 when the size is not known.
+    uint64_t GetDataSize() const
+    {
+        return m_dataSize;
+    }
+
 private:
+    static constexpr uint64_t ticksPerSecond = 10000000;
+
     // Defines common constants for WAV format.
     static constexpr uint16_t tagBufferSize = 4;
     static constexpr uint16_t chunkTypeBufferSize = 4;
     static constexpr uint16_t chunkSizeBufferSize = 4;
 
+    // Sizes of the parts of the 'fmt ' chunk of WAVE_FORMAT_EXTENSIBLE after WAVEFORMAT: cbSize, then the extension.
+    static constexpr uint32_t extensionSizeBufferSize = 2;
+    static constexpr uint32_t extensionBufferSize = 22;
+    // Size of the part of the 'ds64' chunk that is read: the 64-bit RIFF size, data size and sample count.
+    static constexpr uint32_t ds64BufferSize = 24;
+    // 32-bit chunk size of RF64 files whose real size is in the 'ds64' chunk.
+    static constexpr uint32_t sizeInDs64 = 0xFFFFFFFF;
+
     // Get format data from a wav file.
     void GetFormatFromWavFile()
     {
@@ -63,17 +180,21 @@ private:
         char chunkType[chunkTypeBufferSize];
         char chunkSizeBuffer[chunkSizeBufferSize];
         uint32_t chunkSize = 0;
+        uint64_t ds64DataSize = 0;
+        bool foundDs64Chunk = false;
 
         // Set to throw exceptions when reading file header.
         m_fs.exceptions(std::ifstream::failbit | std::ifstream::badbit);
 
         try
         {
-            // Checks the RIFF tag
+            // Checks the RIFF tag. RF64 (and the identical BW64) files are RIFF files with 64-bit sizes
+            // in a 'ds64' chunk, for audio of more than 4 GB.
             m_fs.read(tag, tagBufferSize);
-            if (memcmp(tag, "RIFF", tagBufferSize) != 0)
+            bool rf64 = memcmp(tag, "RF64", tagBufferSize) == 0 || memcmp(tag, "BW64", tagBufferSize) == 0;
+            if (memcmp(tag, "RIFF", tagBufferSize) != 0 && !rf64)
             {
-                throw std::runtime_error("Invalid file header, tag 'RIFF' is expected.");
+                throw std::runtime_error("Invalid file header, tag 'RIFF' or 'RF64' is expected.");
             }
 
             // The next is the RIFF chunk size, ignore now.
@@ -94,21 +215,60 @@ private:
                 {
                     // Reads format data.
                     m_fs.read((char *)&m_formatHeader, sizeof(m_formatHeader));
+                    uint32_t formatSize = sizeof(m_formatHeader);
+
+                    // Reads the extension of WAVE_FORMAT_EXTENSIBLE, e.g. the channel mask of multi-channel recorders.
+                    if (m_formatHeader.FormatTag == formatTagExtensible && chunkSize >= formatSize + extensionSizeBufferSize + extensionBufferSize)
+                    {
+                        uint8_t extension[extensionSizeBufferSize + extensionBufferSize];
+                        m_fs.read((char*)extension, sizeof(extension));
+                        formatSize += sizeof(extension);
+                        ParseFormatExtension(extension + extensionSizeBufferSize);
+                    }
 
                     // Skips the rest of format data.
-                    if (chunkSize > sizeof(m_formatHeader))
+                    if (chunkSize > formatSize)
+                    {
+                        m_fs.seekg(PaddedSize(chunkSize) - formatSize, std::ios_base::cur);
+                    }
+                }
+                else if (rf64 && memcmp(chunkType, "ds64", chunkTypeBufferSize) == 0)
+                {
+                    if (chunkSize < ds64BufferSize)
                     {
-                        m_fs.seekg(chunkSize - sizeof(m_formatHeader), std::ios_base::cur);
+                        throw std::runtime_error("Invalid file header, the 'ds64' chunk is too small.");
                     }
+                    uint8_t ds64[ds64BufferSize];
+                    m_fs.read((char*)ds64, sizeof(ds64));
+                    // The RIFF size comes first and is not needed, then the size of the data chunk.
+                    ds64DataSize = ReadUInt64(ds64 + 8);
+                    foundDs64Chunk = true;
+                    // Skips the sample count and the table of the sizes of other large chunks.
+                    m_fs.seekg(PaddedSize(chunkSize) - sizeof(ds64), std::ios_base::cur);
                 }
                 else if (memcmp(chunkType, "data", chunkTypeBufferSize) == 0)
                 {
+                    // Remembers where the audio starts, for SeekToTime().
+                    m_dataStart = m_fs.tellg();
+                    if (chunkSize == sizeInDs64 && (rf64 || foundDs64Chunk))
+                    {
+                        if (!foundDs64Chunk)
+                        {
+                            throw std::runtime_error("Invalid file header, the 'ds64' chunk is missing.");
+                        }
+                        m_dataSize = ds64DataSize;
+                    }
+                    else if (chunkSize != sizeInDs64)
+                    {
+                        m_dataSize = chunkSize;
+                    }
+                    // Else the size is unknown, as in files written while streaming, and the audio is read to the end.
                     foundDataChunk = true;
                     break;
                 }
                 else
                 {
-                    m_fs.seekg(chunkSize, std::ios_base::cur);
+                    m_fs.seekg(PaddedSize(chunkSize), std::ios_base::cur);
                 }
             }
 
@@ -129,6 +289,22 @@ private:
         m_fs.exceptions(std::ifstream::goodbit);
     }
 
+    void ParseFormatExtension(const uint8_t* extension)
+    {
+        // The standard sub formats are KSDATAFORMAT_SUBTYPE_* GUIDs, which start with the format tag and
+        // end with these 14 bytes.
+        static const uint8_t subFormatSuffix[] = { 0x00, 0x00, 0x00, 0x00, 0x10, 0x00, 0x80, 0x00, 0x00, 0xAA, 0x00, 0x38, 0x9B, 0x71 };
+
+        m_formatExtension.ValidBitsPerSample = (uint16_t)(extension[0] | (extension[1] << 8));
+        m_formatExtension.ChannelMask = (uint32_t)extension[2] | ((uint32_t)extension[3] << 8) |
+            ((uint32_t)extension[4] << 16) | ((uint32_t)extension[5] << 24);
+        const uint8_t* subFormat = extension + 6;
+        if (memcmp(subFormat + 2, subFormatSuffix, sizeof(subFormatSuffix)) == 0)
+        {
+            m_formatExtension.SubFormatTag = (uint16_t)(subFormat[0] | (subFormat[1] << 8));
+        }
+    }
+
     void ReadChunkTypeAndSize(char* chunkType, uint32_t* chunkSize)
     {
         // Read the chunk type
@@ -145,18 +321,277 @@ private:
             (uint32_t)chunkSizeBuffer[0];
     }
 
-    // The format structure expected in wav files.
-    struct WAVEFORMAT
+    static uint64_t ReadUInt64(const uint8_t* buffer)
     {
-        uint16_t FormatTag;        // format type.
-        uint16_t Channels;         // number of channels (i.e. mono, stereo...).
-        uint32_t SamplesPerSec;    // sample rate.
-        uint32_t AvgBytesPerSec;   // for buffer estimation.
-        uint16_t BlockAlign;       // block size of data.
-        uint16_t BitsPerSample;    // Number of bits per sample of mono data.
-    } m_formatHeader;
-    static_assert(sizeof(m_formatHeader) == 16, "unexpected size of m_formatHeader");
+        uint64_t value = 0;
+        for (int i = 7; i >= 0; i--)
+        {
+            value = (value << 8) | buffer[i];
+        }
+        return value;
+    }
+
+    // Chunks are word aligned, odd sized chunks are followed by a pad byte.
+    static std::streamoff PaddedSize(uint32_t chunkSize)
+    {
+        return (std::streamoff)chunkSize + (chunkSize & 1);
+    }
+
+    WAVEFORMAT m_formatHeader;
+    FormatExtension m_formatExtension;
 
 private:
     std::fstream m_fs;
+    std::streampos m_dataStart = 0;
+    uint64_t m_dataSize = 0;
+    // Bytes of the data chunk that have been read or skipped.
+    uint64_t m_position = 0;
+};
+
+// Memory-mapped WAV file reader.
+// The RIFF chunks are parsed once when the file is opened, and the 'data' chunk is exposed as a read-only
+// span over the mapping, so audio can be handed to PushAudioInputStream::Write() without staging copies.
+class MappedWavFileReader final
+{
+public:
+
+    // Constructor that maps the file into memory and locates the 'fmt ' and 'data' chunks.
+    MappedWavFileReader(const std::string& audioFileName)
+    {
+        if (audioFileName.empty())
+        {
+            throw std::invalid_argument("Audio filename is empty");
+        }
+
+        Map(audioFileName);
+        try
+        {
+            ParseChunks();
+        }
+        catch (...)
+        {
+            Close();
+            throw;
+        }
+    }
+
+    ~MappedWavFileReader()
+    {
+        Close();
+    }
+
+    MappedWavFileReader(const MappedWavFileReader&) = delete;
+    MappedWavFileReader& operator=(const MappedWavFileReader&) = delete;
+
+    // Returns the start of the audio data. The memory stays valid until Close() is called.
+    const uint8_t* Data() const
+    {
+        return m_data;
+    }
+
+    // Returns the size of the audio data in bytes.
+    uint32_t Size() const
+    {
+        return m_dataSize;
+    }
+
+    // Returns the number of bytes that have not been consumed by Read() or Next() yet.
+    uint32_t Remaining() const
+    {
+        return m_dataSize - m_position;
+    }
+
+    // Copies up to 'size' bytes into 'dataBuffer', with the same contract as WavFileReader::Read().
+    int Read(uint8_t* dataBuffer, uint32_t size)
+    {
+        const uint8_t* slice = nullptr;
+        auto count = Next(&slice, size);
+        if (count > 0)
+        {
+            memcpy(dataBuffer, slice, count);
+        }
+        return (int)count;
+    }
+
+    // Returns the next slice of at most 'maxSize' bytes without copying, and advances the read position.
+    // Returns 0 when all audio data has been consumed.
+    uint32_t Next(const uint8_t** slice, uint32_t maxSize)
+    {
+        auto count = std::min(maxSize, Remaining());
+        *slice = m_data + m_position;
+        m_position += count;
+        return count;
+    }
+
+    // Returns the format read from the 'fmt ' chunk.
+    const WavFileReader::WAVEFORMAT& GetFormat() const
+    {
+        return m_formatHeader;
+    }
+
+    void Close()
+    {
+#ifdef _WIN32
+        if (m_view != nullptr)
+        {
+            UnmapViewOfFile(m_view);
+        }
+        if (m_mapping != nullptr)
+        {
+            CloseHandle(m_mapping);
+        }
+        if (m_file != INVALID_HANDLE_VALUE)
+        {
+            CloseHandle(m_file);
+        }
+        m_mapping = nullptr;
+        m_file = INVALID_HANDLE_VALUE;
+#else
+        if (m_view != nullptr)
+        {
+            munmap(m_view, m_fileSize);
+        }
+#endif
+        m_view = nullptr;
+        m_fileSize = 0;
+        m_data = nullptr;
+        m_dataSize = 0;
+        m_position = 0;
+    }
+
+private:
+    static constexpr uint32_t chunkHeaderSize = 8;
+    static constexpr uint32_t riffHeaderSize = 12;
+
+    void Map(const std::string& audioFileName)
+    {
+#ifdef _WIN32
+        m_file = CreateFileA(audioFileName.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+        if (m_file == INVALID_HANDLE_VALUE)
+        {
+            throw std::invalid_argument("Failed to open the specified audio file.");
+        }
+
+        LARGE_INTEGER fileSize;
+        if (!GetFileSizeEx(m_file, &fileSize) || fileSize.QuadPart < riffHeaderSize)
+        {
+            Close();
+            throw std::runtime_error("Invalid file header, the file is too small to be a wav file.");
+        }
+        m_fileSize = (size_t)fileSize.QuadPart;
+
+        m_mapping = CreateFileMappingA(m_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        m_view = m_mapping != nullptr ? MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+        if (m_view == nullptr)
+        {
+            Close();
+            throw std::runtime_error("Failed to map the audio file into memory.");
+        }
+#else
+        int fd = open(audioFileName.c_str(), O_RDONLY);
+        if (fd < 0)
+        {
+            throw std::invalid_argument("Failed to open the specified audio file.");
+        }
+
+        struct stat st;
+        if (fstat(fd, &st) != 0 || st.st_size < (off_t)riffHeaderSize)
+        {
+            close(fd);
+            throw std::runtime_error("Invalid file header, the file is too small to be a wav file.");
+        }
+        m_fileSize = (size_t)st.st_size;
+
+        // The mapping keeps its own reference to the file, so the descriptor is not needed afterwards.
+        void* view = mmap(nullptr, m_fileSize, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if (view == MAP_FAILED)
+        {
+            m_fileSize = 0;
+            throw std::runtime_error("Failed to map the audio file into memory.");
+        }
+        m_view = view;
+
+        // Audio is consumed front to back.
+        madvise(m_view, m_fileSize, MADV_SEQUENTIAL);
+#endif
+    }
+
+    // Finds the format and data chunks in the mapped file, in a single pass.
+    void ParseChunks()
+    {
+        const uint8_t* file = static_cast<const uint8_t*>(m_view);
+
+        if (memcmp(file, "RIFF", 4) != 0)
+        {
+            throw std::runtime_error("Invalid file header, tag 'RIFF' is expected.");
+        }
+        // The RIFF chunk size is ignored, the file size is used instead.
+        if (memcmp(file + 8, "WAVE", 4) != 0)
+        {
+            throw std::runtime_error("Invalid file header, tag 'WAVE' is expected.");
+        }
+
+        bool foundFormatChunk = false;
+        size_t offset = riffHeaderSize;
+        while (offset + chunkHeaderSize <= m_fileSize)
+        {
+            const uint8_t* chunk = file + offset;
+            uint32_t chunkSize = ReadUInt32(chunk + 4);
+            size_t available = m_fileSize - offset - chunkHeaderSize;
+
+            if (memcmp(chunk, "fmt ", 4) == 0)
+            {
+                if (chunkSize < sizeof(m_formatHeader) || available < sizeof(m_formatHeader))
+                {
+                    throw std::runtime_error("Unexpected end of file or error when reading audio file.");
+                }
+                memcpy(&m_formatHeader, chunk + chunkHeaderSize, sizeof(m_formatHeader));
+                foundFormatChunk = true;
+            }
+            else if (memcmp(chunk, "data", 4) == 0)
+            {
+                if (!foundFormatChunk)
+                {
+                    throw std::runtime_error("Did not find format chunk before data chunk.");
+                }
+                if (available == 0 && chunkSize > 0)
+                {
+                    throw std::runtime_error("Unexpected end of file, before any audio data can be read.");
+                }
+
+                // Truncated recordings (and streamed files with a placeholder size) are clamped to what is on disk.
+                m_data = chunk + chunkHeaderSize;
+                m_dataSize = (uint32_t)std::min<size_t>(chunkSize, available);
+                return;
+            }
+
+            // Chunks are word aligned, odd sized chunks are followed by a pad byte.
+            offset += chunkHeaderSize + (size_t)chunkSize + (chunkSize & 1);
+        }
+
+        throw std::runtime_error("Did not find data chunk.");
+    }
+
+    static uint32_t ReadUInt32(const uint8_t* buffer)
+    {
+        // chunk size is little endian
+        return ((uint32_t)buffer[3] << 24) |
+            ((uint32_t)buffer[2] << 16) |
+            ((uint32_t)buffer[1] << 8) |
+            (uint32_t)buffer[0];
+    }
+
+    WavFileReader::WAVEFORMAT m_formatHeader{};
+
+#ifdef _WIN32
+    HANDLE m_file = INVALID_HANDLE_VALUE;
+    HANDLE m_mapping = nullptr;
+#endif
+    void* m_view = nullptr;
+    size_t m_fileSize = 0;
+
+    const uint8_t* m_data = nullptr;
+    uint32_t m_dataSize = 0;
+    uint32_t m_position = 0;
 };
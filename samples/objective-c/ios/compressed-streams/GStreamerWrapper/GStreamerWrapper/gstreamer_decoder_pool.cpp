@@ -0,0 +1,339 @@
+//
+// Copyright (c) Microsoft.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// gstreamer_decoder_pool.cpp
+//
+
+#include "gstreamer_decoder_pool.h"
+
+#include <algorithm>
+#include <cstring>
+#include <utility>
+
+namespace Microsoft {
+namespace CognitiveServices {
+namespace Speech {
+namespace Impl {
+
+namespace {
+
+// How long Read() waits for a sample before it checks the bus for errors.
+const GstClockTime pullTimeout = 100 * GST_MSECOND;
+
+// Compressed audio queued in the source at most, Write() blocks above it.
+const guint64 maxQueuedBytes = 1024 * 1024;
+
+// Every pipeline ends in the conversion to the PCM format of the service.
+#define SPX_GST_PCM_SINK " ! audioconvert ! audioresample ! audio/x-raw,format=S16LE,rate=16000,channels=1 ! appsink name=sink sync=false"
+
+} // namespace
+
+GstDecoderPool::GstDecoderPool(size_t maxIdlePerFormat)
+    : m_maxIdlePerFormat(maxIdlePerFormat)
+{
+    if (!gst_is_initialized())
+    {
+        gst_init(nullptr, nullptr);
+    }
+    spx_gst_init_base();
+}
+
+GstDecoderPool::~GstDecoderPool()
+{
+    for (auto& format : m_idle)
+    {
+        for (auto& pipeline : format.second)
+        {
+            Destroy(pipeline.Element);
+        }
+    }
+}
+
+const char* GstDecoderPool::DescriptionOf(int containerFormat)
+{
+    switch (containerFormat)
+    {
+    case SPX_GST_FORMAT_MP3:
+        return "appsrc name=src format=bytes ! mpegaudioparse ! mpg123audiodec" SPX_GST_PCM_SINK;
+    case SPX_GST_FORMAT_OGG_OPUS:
+        return "appsrc name=src format=bytes ! oggdemux ! opusparse ! opusdec" SPX_GST_PCM_SINK;
+    case SPX_GST_FORMAT_FLAC:
+        return "appsrc name=src format=bytes ! flacparse ! flacdec" SPX_GST_PCM_SINK;
+    // A-law and mu-law streams have no header, they are telephony audio at 8 kHz.
+    case SPX_GST_FORMAT_ALAW:
+        return "appsrc name=src format=bytes caps=audio/x-alaw,rate=8000,channels=1 ! alawdec" SPX_GST_PCM_SINK;
+    case SPX_GST_FORMAT_MULAW:
+        return "appsrc name=src format=bytes caps=audio/x-mulaw,rate=8000,channels=1 ! mulawdec" SPX_GST_PCM_SINK;
+    default:
+        return nullptr;
+    }
+}
+
+bool GstDecoderPool::Build(int containerFormat, Pipeline& pipeline)
+{
+    auto description = DescriptionOf(containerFormat);
+    if (description == nullptr || !spx_gst_request_format(containerFormat))
+    {
+        return false;
+    }
+
+    GError* error = nullptr;
+    auto element = gst_parse_launch(description, &error);
+    if (error != nullptr)
+    {
+        g_error_free(error);
+        if (element != nullptr)
+        {
+            gst_object_unref(element);
+        }
+        return false;
+    }
+
+    // The pipeline holds the elements, the references taken by gst_bin_get_by_name() are not needed.
+    auto source = gst_bin_get_by_name(GST_BIN(element), "src");
+    auto sink = gst_bin_get_by_name(GST_BIN(element), "sink");
+    gst_object_unref(source);
+    gst_object_unref(sink);
+    g_object_set(source, "max-bytes", maxQueuedBytes, "block", TRUE, nullptr);
+
+    // READY opens the elements, which is most of the setup cost.
+    if (gst_element_set_state(element, GST_STATE_READY) == GST_STATE_CHANGE_FAILURE)
+    {
+        Destroy(element);
+        return false;
+    }
+    pipeline = Pipeline{ element, GST_APP_SRC(source), GST_APP_SINK(sink) };
+    return true;
+}
+
+bool GstDecoderPool::Prewarm(int containerFormat, size_t count)
+{
+    for (size_t i = 0; i < count; i++)
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (m_idle[containerFormat].size() >= m_maxIdlePerFormat)
+            {
+                return true;
+            }
+        }
+
+        Pipeline pipeline;
+        if (!Build(containerFormat, pipeline))
+        {
+            return false;
+        }
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_statistics.Created++;
+        m_idle[containerFormat].push_back(pipeline);
+    }
+    return true;
+}
+
+GstDecoderPool::Decoder GstDecoderPool::Acquire(int containerFormat)
+{
+    Pipeline pipeline{};
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto& idle = m_idle[containerFormat];
+        if (!idle.empty())
+        {
+            pipeline = idle.back();
+            idle.pop_back();
+            m_statistics.Reused++;
+        }
+    }
+
+    // New pipelines are built outside of the lock, streams of other formats do not wait for them.
+    if (pipeline.Element == nullptr)
+    {
+        if (!Build(containerFormat, pipeline))
+        {
+            return Decoder();
+        }
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_statistics.Created++;
+    }
+
+    if (gst_element_set_state(pipeline.Element, GST_STATE_PLAYING) == GST_STATE_CHANGE_FAILURE)
+    {
+        Release(containerFormat, pipeline.Element, pipeline.Source, pipeline.Sink, false);
+        return Decoder();
+    }
+    return Decoder(this, containerFormat, pipeline.Element, pipeline.Source, pipeline.Sink);
+}
+
+void GstDecoderPool::Release(int containerFormat, GstElement* pipeline, GstAppSrc* source, GstAppSink* sink, bool reusable)
+{
+    if (reusable)
+    {
+        // READY flushes all elements and clears the end of stream, so the pipeline can decode a new stream.
+        reusable = gst_element_set_state(pipeline, GST_STATE_READY) != GST_STATE_CHANGE_FAILURE;
+
+        // Messages of the old stream must not be taken for errors of the next one.
+        auto bus = gst_element_get_bus(pipeline);
+        gst_bus_set_flushing(bus, TRUE);
+        gst_bus_set_flushing(bus, FALSE);
+        gst_object_unref(bus);
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto& idle = m_idle[containerFormat];
+        if (reusable && idle.size() < m_maxIdlePerFormat)
+        {
+            idle.push_back(Pipeline{ pipeline, source, sink });
+            return;
+        }
+        m_statistics.Discarded++;
+    }
+    Destroy(pipeline);
+}
+
+void GstDecoderPool::Destroy(GstElement* pipeline)
+{
+    gst_element_set_state(pipeline, GST_STATE_NULL);
+    gst_object_unref(pipeline);
+}
+
+GstDecoderPool::Statistics GstDecoderPool::GetStatistics()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_statistics;
+}
+
+GstDecoderPool::Decoder::Decoder() = default;
+
+GstDecoderPool::Decoder::Decoder(GstDecoderPool* pool, int containerFormat, GstElement* pipeline, GstAppSrc* source, GstAppSink* sink)
+    : m_pool(pool), m_containerFormat(containerFormat), m_pipeline(pipeline), m_source(source), m_sink(sink)
+{
+}
+
+GstDecoderPool::Decoder::Decoder(Decoder&& other) noexcept
+{
+    *this = std::move(other);
+}
+
+GstDecoderPool::Decoder& GstDecoderPool::Decoder::operator=(Decoder&& other) noexcept
+{
+    if (this != &other)
+    {
+        ReleaseSample();
+        if (m_pipeline != nullptr)
+        {
+            m_pool->Release(m_containerFormat, m_pipeline, m_source, m_sink, m_endOfOutput && !m_failed);
+        }
+
+        m_pool = other.m_pool;
+        m_containerFormat = other.m_containerFormat;
+        m_pipeline = other.m_pipeline;
+        m_source = other.m_source;
+        m_sink = other.m_sink;
+        m_sample = other.m_sample;
+        m_map = other.m_map;
+        m_offset = other.m_offset;
+        m_endOfOutput = other.m_endOfOutput;
+        m_failed = other.m_failed;
+
+        other.m_pipeline = nullptr;
+        other.m_sample = nullptr;
+    }
+    return *this;
+}
+
+GstDecoderPool::Decoder::~Decoder()
+{
+    ReleaseSample();
+    if (m_pipeline != nullptr)
+    {
+        // Only a pipeline that decoded its stream to the end is known to be clean, others are discarded.
+        m_pool->Release(m_containerFormat, m_pipeline, m_source, m_sink, m_endOfOutput && !m_failed);
+    }
+}
+
+bool GstDecoderPool::Decoder::Write(const uint8_t* data, uint32_t size)
+{
+    if (m_pipeline == nullptr || m_failed)
+    {
+        return false;
+    }
+
+    // The source takes ownership of the buffer.
+    auto buffer = gst_buffer_new_allocate(nullptr, size, nullptr);
+    gst_buffer_fill(buffer, 0, data, size);
+    return gst_app_src_push_buffer(m_source, buffer) == GST_FLOW_OK;
+}
+
+void GstDecoderPool::Decoder::EndOfStream()
+{
+    if (m_pipeline != nullptr)
+    {
+        gst_app_src_end_of_stream(m_source);
+    }
+}
+
+int GstDecoderPool::Decoder::Read(uint8_t* dataBuffer, uint32_t size)
+{
+    if (m_pipeline == nullptr)
+    {
+        return 0;
+    }
+
+    while (m_sample == nullptr)
+    {
+        if (m_endOfOutput || m_failed)
+        {
+            return 0;
+        }
+
+        m_sample = gst_app_sink_try_pull_sample(m_sink, pullTimeout);
+        if (m_sample == nullptr)
+        {
+            m_endOfOutput = gst_app_sink_is_eos(m_sink);
+            CheckBus();
+            continue;
+        }
+        if (!gst_buffer_map(gst_sample_get_buffer(m_sample), &m_map, GST_MAP_READ))
+        {
+            gst_sample_unref(m_sample);
+            m_sample = nullptr;
+            m_failed = true;
+            return 0;
+        }
+        m_offset = 0;
+    }
+
+    auto count = std::min<size_t>(size, m_map.size - m_offset);
+    memcpy(dataBuffer, m_map.data + m_offset, count);
+    m_offset += count;
+    if (m_offset == m_map.size)
+    {
+        ReleaseSample();
+    }
+    return (int)count;
+}
+
+void GstDecoderPool::Decoder::ReleaseSample()
+{
+    if (m_sample != nullptr)
+    {
+        gst_buffer_unmap(gst_sample_get_buffer(m_sample), &m_map);
+        gst_sample_unref(m_sample);
+        m_sample = nullptr;
+    }
+}
+
+void GstDecoderPool::Decoder::CheckBus()
+{
+    auto bus = gst_element_get_bus(m_pipeline);
+    auto message = gst_bus_pop_filtered(bus, GST_MESSAGE_ERROR);
+    if (message != nullptr)
+    {
+        m_failed = true;
+        gst_message_unref(message);
+    }
+    gst_object_unref(bus);
+}
+
+} } } } // Microsoft::CognitiveServices::Speech::Impl
@@ -0,0 +1,123 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// gstreamer_decoder_pool.h
+//
+
+#pragma once
+
+#include "gstreamer_modules.h"
+
+#include <gst/app/gstappsink.h>
+#include <gst/app/gstappsrc.h>
+
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <vector>
+
+namespace Microsoft {
+namespace CognitiveServices {
+namespace Speech {
+namespace Impl {
+
+// Pool of GStreamer pipelines that decode compressed audio (mp3, ogg/opus, flac, a-law, mu-law) to 16 kHz,
+// 16-bit mono PCM, for an ordinary PCM push or pull stream. Building a pipeline costs more than decoding
+// a short clip, so pipelines are not destroyed after a stream: they are reset to the READY state and kept
+// for the next stream of the same format, up to 'maxIdlePerFormat' per format.
+class __attribute__((visibility ("default"))) GstDecoderPool final
+{
+public:
+    struct Statistics
+    {
+        uint64_t Created = 0;
+        uint64_t Reused = 0;
+        // Pipelines destroyed because the pool of their format was full, or after a decoding error.
+        uint64_t Discarded = 0;
+    };
+
+    // One stream being decoded. Write() the compressed audio, then EndOfStream(), and Read() the PCM from
+    // another thread: Write() blocks while 1 MB of compressed audio is queued. The pipeline goes back to the
+    // pool when the decoder is destroyed.
+    class Decoder final
+    {
+    public:
+        // An empty decoder, as returned by Acquire() on failure.
+        Decoder();
+        Decoder(Decoder&& other) noexcept;
+        Decoder& operator=(Decoder&& other) noexcept;
+        Decoder(const Decoder&) = delete;
+        Decoder& operator=(const Decoder&) = delete;
+        ~Decoder();
+
+        // Queues compressed audio. Returns false after a decoding error.
+        bool Write(const uint8_t* data, uint32_t size);
+
+        // Marks the end of the compressed audio.
+        void EndOfStream();
+
+        // Copies up to 'size' bytes of PCM, waiting until some is decoded. Returns 0 at the end of the
+        // stream or after a decoding error, like PullAudioInputStreamCallback::Read().
+        int Read(uint8_t* dataBuffer, uint32_t size);
+
+        // True when the pipeline reported an error.
+        bool Failed() const { return m_failed; }
+
+        explicit operator bool() const { return m_pipeline != nullptr; }
+
+    private:
+        friend class GstDecoderPool;
+        Decoder(GstDecoderPool* pool, int containerFormat, GstElement* pipeline, GstAppSrc* source, GstAppSink* sink);
+        void ReleaseSample();
+        void CheckBus();
+
+        GstDecoderPool* m_pool = nullptr;
+        int m_containerFormat = 0;
+        GstElement* m_pipeline = nullptr;
+        GstAppSrc* m_source = nullptr;
+        GstAppSink* m_sink = nullptr;
+        GstSample* m_sample = nullptr;
+        GstMapInfo m_map{};
+        size_t m_offset = 0;
+        bool m_endOfOutput = false;
+        bool m_failed = false;
+    };
+
+    explicit GstDecoderPool(size_t maxIdlePerFormat = 4);
+    ~GstDecoderPool();
+
+    GstDecoderPool(const GstDecoderPool&) = delete;
+    GstDecoderPool& operator=(const GstDecoderPool&) = delete;
+
+    // Builds 'count' pipelines of a format ahead of the first stream, so that stream does not wait either.
+    // Returns false for formats without a decoder pipeline.
+    bool Prewarm(int containerFormat, size_t count);
+
+    // Returns a decoder for a stream in 'containerFormat', one of the spx_gst_container_format values.
+    // A pipeline from the pool is reused if there is one. Returns an empty decoder for formats without a
+    // decoder pipeline, or when GStreamer cannot build it (e.g. a plugin is missing).
+    Decoder Acquire(int containerFormat);
+
+    Statistics GetStatistics();
+
+private:
+    struct Pipeline
+    {
+        GstElement* Element;
+        GstAppSrc* Source;
+        GstAppSink* Sink;
+    };
+
+    static const char* DescriptionOf(int containerFormat);
+    bool Build(int containerFormat, Pipeline& pipeline);
+    void Release(int containerFormat, GstElement* pipeline, GstAppSrc* source, GstAppSink* sink, bool reusable);
+    static void Destroy(GstElement* pipeline);
+
+    const size_t m_maxIdlePerFormat;
+    std::mutex m_mutex;
+    std::map<int, std::vector<Pipeline>> m_idle;
+    Statistics m_statistics;
+};
+
+} } } } // Microsoft::CognitiveServices::Speech::Impl
@@ -7,6 +7,111 @@
 
 #include "gstreamer_modules.h"
 
+#include <mutex>
+
+namespace {
+
+#if defined(TARGET_OS_IPHONE)
+// The statically linked plugins, registered at most once each.
+enum Plugin
+{
+    PluginCoreElements,
+    PluginApp,
+    PluginAudioConvert,
+    PluginAudioResample,
+    PluginAudioParsers,
+    PluginMpg123,
+    PluginOgg,
+    PluginOpusParse,
+    PluginOpus,
+    PluginWavParse,
+    PluginAlaw,
+    PluginMulaw,
+    PluginFlac,
+    PluginPlayback,
+    PluginCount
+};
+
+void RegisterPlugin(Plugin plugin)
+{
+    switch (plugin)
+    {
+    case PluginCoreElements: GST_PLUGIN_STATIC_REGISTER(coreelements); break;
+    case PluginApp: GST_PLUGIN_STATIC_REGISTER(app); break;
+    case PluginAudioConvert: GST_PLUGIN_STATIC_REGISTER(audioconvert); break;
+    case PluginAudioResample: GST_PLUGIN_STATIC_REGISTER(audioresample); break;
+    case PluginAudioParsers: GST_PLUGIN_STATIC_REGISTER(audioparsers); break;
+    case PluginMpg123: GST_PLUGIN_STATIC_REGISTER(mpg123); break;
+    case PluginOgg: GST_PLUGIN_STATIC_REGISTER(ogg); break;
+    case PluginOpusParse: GST_PLUGIN_STATIC_REGISTER(opusparse); break;
+    case PluginOpus: GST_PLUGIN_STATIC_REGISTER(opus); break;
+    case PluginWavParse: GST_PLUGIN_STATIC_REGISTER(wavparse); break;
+    case PluginAlaw: GST_PLUGIN_STATIC_REGISTER(alaw); break;
+    case PluginMulaw: GST_PLUGIN_STATIC_REGISTER(mulaw); break;
+    case PluginFlac: GST_PLUGIN_STATIC_REGISTER(flac); break;
+    case PluginPlayback: GST_PLUGIN_STATIC_REGISTER(playback); break;
+    case PluginCount: break;
+    }
+}
+
+// Every pipeline starts with appsrc and ends in raw PCM conversion.
+const Plugin basePlugins[] = { PluginCoreElements, PluginApp, PluginAudioConvert, PluginAudioResample };
+
+const Plugin opusPlugins[] = { PluginOgg, PluginOpusParse, PluginOpus };
+const Plugin mp3Plugins[] = { PluginAudioParsers, PluginMpg123 };
+const Plugin flacPlugins[] = { PluginAudioParsers, PluginFlac };
+const Plugin alawPlugins[] = { PluginAlaw };
+const Plugin mulawPlugins[] = { PluginMulaw };
+// ANY lets decodebin pick the decoder, so it needs them all.
+const Plugin anyPlugins[] = { PluginAudioParsers, PluginMpg123, PluginOgg, PluginOpusParse, PluginOpus, PluginWavParse,
+    PluginAlaw, PluginMulaw, PluginFlac, PluginPlayback };
+#endif
+
+struct Registry
+{
+    std::mutex Mutex;
+    // Set by the first spx_gst_request_format(), from then on only requested plugins are registered.
+    bool OnDemand = false;
+    // Set once GStreamer is initialized and spx_gst_init_base() has run, requests then register immediately.
+    bool Initialized = false;
+#if defined(TARGET_OS_IPHONE)
+    bool Requested[PluginCount] = {};
+    bool Registered[PluginCount] = {};
+#endif
+};
+
+Registry& GetRegistry()
+{
+    static Registry registry;
+    return registry;
+}
+
+#if defined(TARGET_OS_IPHONE)
+template <size_t N>
+void Request(Registry& registry, const Plugin (&plugins)[N])
+{
+    for (auto plugin : plugins)
+    {
+        registry.Requested[plugin] = true;
+    }
+}
+
+// Registers the requested plugins that are not registered yet. Called with the mutex held.
+void RegisterRequested(Registry& registry)
+{
+    for (int plugin = 0; plugin < PluginCount; plugin++)
+    {
+        if (registry.Requested[plugin] && !registry.Registered[plugin])
+        {
+            RegisterPlugin((Plugin)plugin);
+            registry.Registered[plugin] = true;
+        }
+    }
+}
+#endif
+
+} // namespace
+
 namespace Microsoft {
 namespace CognitiveServices {
 namespace Speech {
@@ -14,116 +119,61 @@ namespace Impl {
 
 void spx_gst_init_base() {
 #if defined(TARGET_OS_IPHONE)
-    GST_PLUGIN_STATIC_REGISTER(coreelements);
-    GST_PLUGIN_STATIC_REGISTER(app);
-    GST_PLUGIN_STATIC_REGISTER(audioconvert);
-    GST_PLUGIN_STATIC_REGISTER(mpg123);
-    GST_PLUGIN_STATIC_REGISTER(audioresample);
-    GST_PLUGIN_STATIC_REGISTER(audioparsers);
-    GST_PLUGIN_STATIC_REGISTER(ogg);
-    GST_PLUGIN_STATIC_REGISTER(opusparse);
-    GST_PLUGIN_STATIC_REGISTER(opus);
-    GST_PLUGIN_STATIC_REGISTER(wavparse);
-    GST_PLUGIN_STATIC_REGISTER(alaw);
-    GST_PLUGIN_STATIC_REGISTER(mulaw);
-    GST_PLUGIN_STATIC_REGISTER(flac);
+    auto& registry = GetRegistry();
+    std::lock_guard<std::mutex> lock(registry.Mutex);
+    Request(registry, basePlugins);
+    if (!registry.OnDemand)
+    {
+        // No format was requested, all decoders are registered up front.
+        const Plugin allDecoders[] = { PluginMpg123, PluginAudioParsers, PluginOgg, PluginOpusParse, PluginOpus,
+            PluginWavParse, PluginAlaw, PluginMulaw, PluginFlac };
+        Request(registry, allDecoders);
+    }
+    RegisterRequested(registry);
+    registry.Initialized = true;
 #endif
 }
 
 void spx_gst_init_extra() {
 #if defined(TARGET_OS_IPHONE)
-    GST_PLUGIN_STATIC_REGISTER(playback);
-
-    //TODO: Need to enable the following on 1.16.0. Blocked on mac device
-/*
-    GST_PLUGIN_STATIC_REGISTER(adder);
-    GST_PLUGIN_STATIC_REGISTER(audiomixer);
-    GST_PLUGIN_STATIC_REGISTER(audiorate);
-    GST_PLUGIN_STATIC_REGISTER(audiotestsrc);
-    GST_PLUGIN_STATIC_REGISTER(compositor);
-    GST_PLUGIN_STATIC_REGISTER(gio);
-    GST_PLUGIN_STATIC_REGISTER(overlaycomposition);
-    GST_PLUGIN_STATIC_REGISTER(pango);
-    GST_PLUGIN_STATIC_REGISTER(rawparse);
-    GST_PLUGIN_STATIC_REGISTER(typefindfunctions);
-    GST_PLUGIN_STATIC_REGISTER(videoconvert);
-    GST_PLUGIN_STATIC_REGISTER(videorate);
-    GST_PLUGIN_STATIC_REGISTER(videoscale);
-    GST_PLUGIN_STATIC_REGISTER(videotestsrc);
-    GST_PLUGIN_STATIC_REGISTER(volume);
-    GST_PLUGIN_STATIC_REGISTER(autodetect);
-    GST_PLUGIN_STATIC_REGISTER(videofilter);
-    GST_PLUGIN_STATIC_REGISTER(subparse);
-    GST_PLUGIN_STATIC_REGISTER(theora);
-    GST_PLUGIN_STATIC_REGISTER(vorbis);
-    GST_PLUGIN_STATIC_REGISTER(ivorbisdec);
-    GST_PLUGIN_STATIC_REGISTER(apetag);
-    GST_PLUGIN_STATIC_REGISTER(auparse);
-    GST_PLUGIN_STATIC_REGISTER(avi);
-    GST_PLUGIN_STATIC_REGISTER(dv);
-    GST_PLUGIN_STATIC_REGISTER(flv);
-    GST_PLUGIN_STATIC_REGISTER(flxdec);
-    GST_PLUGIN_STATIC_REGISTER(icydemux);
-    GST_PLUGIN_STATIC_REGISTER(id3demux);
-    GST_PLUGIN_STATIC_REGISTER(isomp4);
-    GST_PLUGIN_STATIC_REGISTER(jpeg);
-    GST_PLUGIN_STATIC_REGISTER(lame);
-    GST_PLUGIN_STATIC_REGISTER(matroska);
-    GST_PLUGIN_STATIC_REGISTER(multipart);
-    GST_PLUGIN_STATIC_REGISTER(png);
-    GST_PLUGIN_STATIC_REGISTER(speex);
-    GST_PLUGIN_STATIC_REGISTER(taglib);
-    GST_PLUGIN_STATIC_REGISTER(vpx);
-    GST_PLUGIN_STATIC_REGISTER(wavenc);
-    GST_PLUGIN_STATIC_REGISTER(wavpack);
-    GST_PLUGIN_STATIC_REGISTER(y4menc);
-    GST_PLUGIN_STATIC_REGISTER(adpcmdec);
-    GST_PLUGIN_STATIC_REGISTER(adpcmenc);
-    GST_PLUGIN_STATIC_REGISTER(bz2);
-    GST_PLUGIN_STATIC_REGISTER(dashdemux);
-    GST_PLUGIN_STATIC_REGISTER(dvbsuboverlay);
-    GST_PLUGIN_STATIC_REGISTER(dvdspu);
-    GST_PLUGIN_STATIC_REGISTER(hls);
-    GST_PLUGIN_STATIC_REGISTER(id3tag);
-    GST_PLUGIN_STATIC_REGISTER(kate);
-    GST_PLUGIN_STATIC_REGISTER(midi);
-    GST_PLUGIN_STATIC_REGISTER(mxf);
-    GST_PLUGIN_STATIC_REGISTER(openh264);
-    GST_PLUGIN_STATIC_REGISTER(pcapparse);
-    GST_PLUGIN_STATIC_REGISTER(pnm);
-    GST_PLUGIN_STATIC_REGISTER(rfbsrc);
-    GST_PLUGIN_STATIC_REGISTER(siren);
-    GST_PLUGIN_STATIC_REGISTER(smoothstreaming);
-    GST_PLUGIN_STATIC_REGISTER(subenc);
-    GST_PLUGIN_STATIC_REGISTER(videoparsersbad);
-    GST_PLUGIN_STATIC_REGISTER(y4mdec);
-    GST_PLUGIN_STATIC_REGISTER(jpegformat);
-    GST_PLUGIN_STATIC_REGISTER(gdp);
-    GST_PLUGIN_STATIC_REGISTER(rsvg);
-    GST_PLUGIN_STATIC_REGISTER(openjpeg);
-    GST_PLUGIN_STATIC_REGISTER(spandsp);
-    GST_PLUGIN_STATIC_REGISTER(sbc);
-    GST_PLUGIN_STATIC_REGISTER(assrender);
-    GST_PLUGIN_STATIC_REGISTER(asfmux);
-    GST_PLUGIN_STATIC_REGISTER(dtsdec);
-    GST_PLUGIN_STATIC_REGISTER(mpegpsdemux);
-    GST_PLUGIN_STATIC_REGISTER(mpegpsmux);
-    GST_PLUGIN_STATIC_REGISTER(mpegtsdemux);
-    GST_PLUGIN_STATIC_REGISTER(mpegtsmux);
-    GST_PLUGIN_STATIC_REGISTER(voaacenc);
-    GST_PLUGIN_STATIC_REGISTER(a52dec);
-    GST_PLUGIN_STATIC_REGISTER(amrnb);
-    GST_PLUGIN_STATIC_REGISTER(amrwbdec);
-    GST_PLUGIN_STATIC_REGISTER(asf);
-    GST_PLUGIN_STATIC_REGISTER(dvdsub);
-    GST_PLUGIN_STATIC_REGISTER(dvdlpcmdec);
-    GST_PLUGIN_STATIC_REGISTER(xingmux);
-    GST_PLUGIN_STATIC_REGISTER(realmedia);
-    GST_PLUGIN_STATIC_REGISTER(x264);
-    GST_PLUGIN_STATIC_REGISTER(libav);
-    */
-
+    auto& registry = GetRegistry();
+    std::lock_guard<std::mutex> lock(registry.Mutex);
+    if (!registry.OnDemand)
+    {
+        const Plugin extraPlugins[] = { PluginPlayback };
+        Request(registry, extraPlugins);
+    }
+    RegisterRequested(registry);
 #endif
 }
 
 } } } } // Microsoft::CognitiveServices::Speech::Impl
+
+bool spx_gst_request_format(int containerFormat) {
+    auto& registry = GetRegistry();
+    std::lock_guard<std::mutex> lock(registry.Mutex);
+#if defined(TARGET_OS_IPHONE)
+    switch (containerFormat)
+    {
+    case SPX_GST_FORMAT_OGG_OPUS: Request(registry, opusPlugins); break;
+    case SPX_GST_FORMAT_MP3: Request(registry, mp3Plugins); break;
+    case SPX_GST_FORMAT_FLAC: Request(registry, flacPlugins); break;
+    case SPX_GST_FORMAT_ALAW: Request(registry, alawPlugins); break;
+    case SPX_GST_FORMAT_MULAW: Request(registry, mulawPlugins); break;
+    case SPX_GST_FORMAT_ANY: Request(registry, anyPlugins); break;
+    default: return false;
+    }
+    registry.OnDemand = true;
+    // Before spx_gst_init_base() GStreamer may not be initialized yet, the plugins are then registered there.
+    if (registry.Initialized)
+    {
+        RegisterRequested(registry);
+    }
+    return true;
+#else
+    // Other platforms load the plugins from the GStreamer installation, on demand.
+    (void)registry;
+    return containerFormat == SPX_GST_FORMAT_OGG_OPUS || containerFormat == SPX_GST_FORMAT_MP3 || containerFormat == SPX_GST_FORMAT_FLAC ||
+        containerFormat == SPX_GST_FORMAT_ALAW || containerFormat == SPX_GST_FORMAT_MULAW || containerFormat == SPX_GST_FORMAT_ANY;
+#endif
+}
@@ -36,96 +36,6 @@ extern "C"
     GST_PLUGIN_STATIC_DECLARE(mulaw);
     GST_PLUGIN_STATIC_DECLARE(flac);
     GST_PLUGIN_STATIC_DECLARE(playback);
-
-    //TODO: Need to enable the following on 1.16.0. Blocked on mac device
-
-/*
-    GST_PLUGIN_STATIC_DECLARE(adder);
-    GST_PLUGIN_STATIC_DECLARE(audiomixer);
-    GST_PLUGIN_STATIC_DECLARE(audiorate);
-    GST_PLUGIN_STATIC_DECLARE(audiotestsrc);
-    GST_PLUGIN_STATIC_DECLARE(compositor);
-    GST_PLUGIN_STATIC_DECLARE(gio);
-    GST_PLUGIN_STATIC_DECLARE(overlaycomposition);
-    GST_PLUGIN_STATIC_DECLARE(pango);
-    GST_PLUGIN_STATIC_DECLARE(rawparse);
-    GST_PLUGIN_STATIC_DECLARE(typefindfunctions);
-    GST_PLUGIN_STATIC_DECLARE(videoconvert);
-    GST_PLUGIN_STATIC_DECLARE(videorate);
-    GST_PLUGIN_STATIC_DECLARE(videoscale);
-    GST_PLUGIN_STATIC_DECLARE(videotestsrc);
-    GST_PLUGIN_STATIC_DECLARE(volume);
-    GST_PLUGIN_STATIC_DECLARE(autodetect);
-    GST_PLUGIN_STATIC_DECLARE(videofilter);
-    GST_PLUGIN_STATIC_DECLARE(subparse);
-    GST_PLUGIN_STATIC_DECLARE(theora);
-    GST_PLUGIN_STATIC_DECLARE(vorbis);
-    GST_PLUGIN_STATIC_DECLARE(ivorbisdec);
-    GST_PLUGIN_STATIC_DECLARE(apetag);
-    GST_PLUGIN_STATIC_DECLARE(auparse);
-    GST_PLUGIN_STATIC_DECLARE(avi);
-    GST_PLUGIN_STATIC_DECLARE(dv);
-    GST_PLUGIN_STATIC_DECLARE(flv);
-    GST_PLUGIN_STATIC_DECLARE(flxdec);
-    GST_PLUGIN_STATIC_DECLARE(icydemux);
-    GST_PLUGIN_STATIC_DECLARE(id3demux);
-    GST_PLUGIN_STATIC_DECLARE(isomp4);
-    GST_PLUGIN_STATIC_DECLARE(jpeg);
-    GST_PLUGIN_STATIC_DECLARE(lame);
-    GST_PLUGIN_STATIC_DECLARE(matroska);
-    GST_PLUGIN_STATIC_DECLARE(multipart);
-    GST_PLUGIN_STATIC_DECLARE(png);
-    GST_PLUGIN_STATIC_DECLARE(speex);
-    GST_PLUGIN_STATIC_DECLARE(taglib);
-    GST_PLUGIN_STATIC_DECLARE(vpx);
-    GST_PLUGIN_STATIC_DECLARE(wavenc);
-    GST_PLUGIN_STATIC_DECLARE(wavpack);
-    GST_PLUGIN_STATIC_DECLARE(y4menc);
-    GST_PLUGIN_STATIC_DECLARE(adpcmdec);
-    GST_PLUGIN_STATIC_DECLARE(adpcmenc);
-    GST_PLUGIN_STATIC_DECLARE(bz2);
-    GST_PLUGIN_STATIC_DECLARE(dashdemux);
-    GST_PLUGIN_STATIC_DECLARE(dvbsuboverlay);
-    GST_PLUGIN_STATIC_DECLARE(dvdspu);
-    GST_PLUGIN_STATIC_DECLARE(hls);
-    GST_PLUGIN_STATIC_DECLARE(id3tag);
-    GST_PLUGIN_STATIC_DECLARE(kate);
-    GST_PLUGIN_STATIC_DECLARE(midi);
-    GST_PLUGIN_STATIC_DECLARE(mxf);
-    GST_PLUGIN_STATIC_DECLARE(openh264);
-    GST_PLUGIN_STATIC_DECLARE(pcapparse);
-    GST_PLUGIN_STATIC_DECLARE(pnm);
-    GST_PLUGIN_STATIC_DECLARE(rfbsrc);
-    GST_PLUGIN_STATIC_DECLARE(siren);
-    GST_PLUGIN_STATIC_DECLARE(smoothstreaming);
-    GST_PLUGIN_STATIC_DECLARE(subenc);
-    GST_PLUGIN_STATIC_DECLARE(videoparsersbad);
-    GST_PLUGIN_STATIC_DECLARE(y4mdec);
-    GST_PLUGIN_STATIC_DECLARE(jpegformat);
-    GST_PLUGIN_STATIC_DECLARE(gdp);
-    GST_PLUGIN_STATIC_DECLARE(rsvg);
-    GST_PLUGIN_STATIC_DECLARE(openjpeg);
-    GST_PLUGIN_STATIC_DECLARE(spandsp);
-    GST_PLUGIN_STATIC_DECLARE(sbc);
-    GST_PLUGIN_STATIC_DECLARE(assrender);
-    GST_PLUGIN_STATIC_DECLARE(asfmux);
-    GST_PLUGIN_STATIC_DECLARE(dtsdec);
-    GST_PLUGIN_STATIC_DECLARE(mpegpsdemux);
-    GST_PLUGIN_STATIC_DECLARE(mpegpsmux);
-    GST_PLUGIN_STATIC_DECLARE(mpegtsdemux);
-    GST_PLUGIN_STATIC_DECLARE(mpegtsmux);
-    GST_PLUGIN_STATIC_DECLARE(voaacenc);
-    GST_PLUGIN_STATIC_DECLARE(a52dec);
-    GST_PLUGIN_STATIC_DECLARE(amrnb);
-    GST_PLUGIN_STATIC_DECLARE(amrwbdec);
-    GST_PLUGIN_STATIC_DECLARE(asf);
-    GST_PLUGIN_STATIC_DECLARE(dvdsub);
-    GST_PLUGIN_STATIC_DECLARE(dvdlpcmdec);
-    GST_PLUGIN_STATIC_DECLARE(xingmux);
-    GST_PLUGIN_STATIC_DECLARE(realmedia);
-    GST_PLUGIN_STATIC_DECLARE(x264);
-    GST_PLUGIN_STATIC_DECLARE(libav);
-    */
 }
 #endif
 
@@ -138,3 +48,21 @@ __attribute__((visibility ("default"))) void spx_gst_init_base();
 __attribute__((visibility ("default"))) void spx_gst_init_extra();
 
 } } } } // Microsoft::CognitiveServices::Speech::Impl
+
+// Container formats of compressed streams, with the values of AudioStreamContainerFormat (SPXAudioStreamContainerFormat).
+enum spx_gst_container_format
+{
+    SPX_GST_FORMAT_OGG_OPUS = 0x101,
+    SPX_GST_FORMAT_MP3 = 0x102,
+    SPX_GST_FORMAT_FLAC = 0x103,
+    SPX_GST_FORMAT_ALAW = 0x104,
+    SPX_GST_FORMAT_MULAW = 0x105,
+    SPX_GST_FORMAT_ANY = 0x108
+};
+
+// Requests the parser and decoder plugins of one container format. Call it before the first compressed
+// stream of that format is created. Once any format has been requested, spx_gst_init_base() and
+// spx_gst_init_extra() register only the plugins of the requested formats, each plugin once and only when
+// first needed. Without a request all plugins are registered at startup, as before.
+// Returns false for unknown formats.
+extern "C" __attribute__((visibility ("default"))) bool spx_gst_request_format(int containerFormat);
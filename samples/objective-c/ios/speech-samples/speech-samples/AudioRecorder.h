@@ -6,15 +6,32 @@
 #import <Foundation/Foundation.h>
 #import <MicrosoftCognitiveServicesSpeech/SPXSpeechApi.h>
 
+// Records 16 kHz 16-bit mono audio from the microphone into a push stream.
+// The audio queue callback only copies each captured buffer into a preallocated lock-free ring and never calls into
+// the Speech SDK; a separate thread drains the ring into the push stream in chunks of chunkSize bytes. When the
+// drain thread falls behind by more than the capacity of the ring, captured buffers are dropped and counted.
 @interface AudioRecorder : NSObject
 
+// Uses chunks of 100 ms and a ring of 2 s.
 - (instancetype)initWithPushStream:(SPXPushAudioInputStream *)stream;
 
+// chunkSize is rounded down to whole samples, ringCapacity up to a power of two of at least twice the chunk size.
+- (instancetype)initWithPushStream:(SPXPushAudioInputStream *)stream chunkSize:(NSUInteger)chunkSize ringCapacity:(NSUInteger)ringCapacity;
+
 @property (nonatomic, assign, readonly) BOOL isRunning;
 
+@property (nonatomic, assign, readonly) NSUInteger chunkSize;
+@property (nonatomic, assign, readonly) NSUInteger ringCapacity;
+
+// Captured buffers dropped because the ring was full, and their size in bytes.
+@property (nonatomic, assign, readonly) NSUInteger overrunCount;
+@property (nonatomic, assign, readonly) NSUInteger overrunBytes;
+// The most audio that was waiting in the ring at once, in bytes.
+@property (nonatomic, assign, readonly) NSUInteger maxFillBytes;
+
 - (void)record;
 
+// Stops capturing, and returns after the audio in the ring has been written to the push stream.
 - (void)stop;
 
 @end
-
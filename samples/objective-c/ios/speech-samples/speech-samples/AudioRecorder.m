@@ -5,13 +5,36 @@
 
 #import "AudioRecorder.h"
 #import <AVFoundation/AVFoundation.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
 
 static const int kNumberBuffers = 3;
+static const UInt32 kCaptureBufferBytes = 3200;
+static const NSUInteger kBytesPerSecond = 16000 * 2;
+
+// Single-producer single-consumer ring. The positions only grow; the audio queue callback advances writePosition
+// and the drain thread advances readPosition, so neither ever waits for the other.
+typedef struct {
+    uint8_t *buffer;
+    size_t capacity;
+    _Atomic uint64_t writePosition;
+    _Atomic uint64_t readPosition;
+    _Atomic uint64_t overruns;
+    _Atomic uint64_t overrunBytes;
+    _Atomic uint64_t maxFill;
+} CaptureRing;
 
 @interface AudioRecorder () {
     AudioQueueRef               queueRef;
     AudioQueueBufferRef         buffers[kNumberBuffers];
     SPXPushAudioInputStream     *pushStream;
+    CaptureRing                 ring;
+    uint8_t                     *chunk;
+    atomic_bool                 capturing;
+    atomic_bool                 draining;
+    dispatch_semaphore_t        drainFinished;
 }
 
 @property (nonatomic, assign) SInt64 currPacket;
@@ -21,6 +44,11 @@ static const int kNumberBuffers = 3;
 @implementation AudioRecorder
 
 - (instancetype)initWithPushStream:(SPXPushAudioInputStream *)stream
+{
+    return [self initWithPushStream:stream chunkSize:kBytesPerSecond / 10 ringCapacity:kBytesPerSecond * 2];
+}
+
+- (instancetype)initWithPushStream:(SPXPushAudioInputStream *)stream chunkSize:(NSUInteger)chunkSize ringCapacity:(NSUInteger)ringCapacity
 {
     if (self = [super init]) {
         AudioStreamBasicDescription recordFormat = {0};
@@ -35,6 +63,24 @@ static const int kNumberBuffers = 3;
         self->pushStream = stream;
         self.currPacket = 0;
 
+        _chunkSize = MAX(chunkSize - chunkSize % recordFormat.mBytesPerFrame, recordFormat.mBytesPerFrame);
+        size_t capacity = 1;
+        while (capacity < MAX(ringCapacity, 2 * _chunkSize) || capacity < 2 * kCaptureBufferBytes) {
+            capacity *= 2;
+        }
+        _ringCapacity = capacity;
+        // Allocated up front, the audio queue callback never allocates.
+        ring.buffer = malloc(capacity);
+        ring.capacity = capacity;
+        atomic_init(&ring.writePosition, 0);
+        atomic_init(&ring.readPosition, 0);
+        atomic_init(&ring.overruns, 0);
+        atomic_init(&ring.overrunBytes, 0);
+        atomic_init(&ring.maxFill, 0);
+        chunk = malloc(_chunkSize);
+        atomic_init(&capturing, false);
+        atomic_init(&draining, false);
+
         OSStatus status = AudioQueueNewInput(&recordFormat,
                                              recorderCallBack,
                                              (__bridge void *)self,
@@ -47,7 +93,7 @@ static const int kNumberBuffers = 3;
         }
 
         for (int i = 0; i < kNumberBuffers; i++) {
-            AudioQueueAllocateBuffer(queueRef, 3200, &buffers[i]);
+            AudioQueueAllocateBuffer(queueRef, kCaptureBufferBytes, &buffers[i]);
             AudioQueueEnqueueBuffer(queueRef, buffers[i], 0, NULL);
         }
 
@@ -59,9 +105,14 @@ static const int kNumberBuffers = 3;
 }
 
 - (void)dealloc {
+    [self stop];
     AudioQueueDispose(queueRef, true);
+    free(ring.buffer);
+    free(chunk);
 }
 
+// Runs on the audio queue thread: copies the buffer into the ring, or drops it if it does not fit. No locks, no
+// allocations and no Objective-C messages.
 static void recorderCallBack(void *aqData,
                              AudioQueueRef inAQ,
                              AudioQueueBufferRef inBuffer,
@@ -69,17 +120,61 @@ static void recorderCallBack(void *aqData,
                              UInt32 inNumPackets,
                              const AudioStreamPacketDescription *inPacketDesc) {
     AudioRecorder *recorder = (__bridge AudioRecorder *)aqData;
+    CaptureRing *ring = &recorder->ring;
+
+    size_t size = inBuffer->mAudioDataByteSize;
+    uint64_t write = atomic_load_explicit(&ring->writePosition, memory_order_relaxed);
+    uint64_t read = atomic_load_explicit(&ring->readPosition, memory_order_acquire);
+    uint64_t fill = write - read;
+    if (ring->capacity - fill < size) {
+        atomic_fetch_add_explicit(&ring->overruns, 1, memory_order_relaxed);
+        atomic_fetch_add_explicit(&ring->overrunBytes, size, memory_order_relaxed);
+    } else if (size > 0) {
+        size_t offset = (size_t)(write & (ring->capacity - 1));
+        size_t first = MIN(size, ring->capacity - offset);
+        memcpy(ring->buffer + offset, inBuffer->mAudioData, first);
+        memcpy(ring->buffer, (const uint8_t *)inBuffer->mAudioData + first, size - first);
+        atomic_store_explicit(&ring->writePosition, write + size, memory_order_release);
+        if (fill + size > atomic_load_explicit(&ring->maxFill, memory_order_relaxed)) {
+            atomic_store_explicit(&ring->maxFill, fill + size, memory_order_relaxed);
+        }
+    }
 
-    NSData* data = [[NSData alloc] initWithBytesNoCopy:(void*)inBuffer->mAudioData
-                                                length:(NSUInteger)inBuffer->mAudioDataByteSize
-                                          freeWhenDone:false];
-    [recorder->pushStream write:data];
-
-    if (recorder.isRunning) {
+    if (atomic_load_explicit(&recorder->capturing, memory_order_relaxed)) {
         AudioQueueEnqueueBuffer(inAQ, inBuffer, 0, NULL);
     }
 }
 
+// Runs on the drain thread: writes a chunk whenever one is complete, and the rest once capturing has stopped.
+- (void)drain
+{
+    // Polls four times per chunk, so a chunk waits at most a quarter of its duration.
+    useconds_t interval = (useconds_t)(1000000 * (uint64_t)_chunkSize / kBytesPerSecond / 4);
+    while (true) {
+        bool stopping = !atomic_load_explicit(&draining, memory_order_acquire);
+        uint64_t read = atomic_load_explicit(&ring.readPosition, memory_order_relaxed);
+        uint64_t available = atomic_load_explicit(&ring.writePosition, memory_order_acquire) - read;
+        if (available >= _chunkSize || (stopping && available > 0)) {
+            size_t size = (size_t)MIN(available, (uint64_t)_chunkSize);
+            size_t offset = (size_t)(read & (ring.capacity - 1));
+            size_t first = MIN(size, ring.capacity - offset);
+            memcpy(chunk, ring.buffer + offset, first);
+            memcpy(chunk + first, ring.buffer, size - first);
+            // The space is free for the callback again before the SDK is called.
+            atomic_store_explicit(&ring.readPosition, read + size, memory_order_release);
+            @autoreleasepool {
+                [pushStream write:[NSData dataWithBytesNoCopy:chunk length:size freeWhenDone:false]];
+            }
+            continue;
+        }
+        if (stopping) {
+            break;
+        }
+        usleep(interval);
+    }
+    dispatch_semaphore_signal(drainFinished);
+}
+
 - (void)record {
     if (self.isRunning) {
         return;
@@ -88,9 +183,19 @@ static void recorderCallBack(void *aqData,
     [[AVAudioSession sharedInstance] setCategory:AVAudioSessionCategoryPlayAndRecord error:nil];
     [[AVAudioSession sharedInstance] setActive:true error:nil];
 
+    atomic_store(&capturing, true);
+    atomic_store(&draining, true);
+    drainFinished = dispatch_semaphore_create(0);
+    NSThread *drainThread = [[NSThread alloc] initWithTarget:self selector:@selector(drain) object:nil];
+    drainThread.qualityOfService = NSQualityOfServiceUserInteractive;
+    [drainThread start];
+
     OSStatus status = AudioQueueStart(queueRef, NULL);
     if (status != noErr) {
         NSLog(@"start queue failure");
+        atomic_store(&capturing, false);
+        atomic_store(&draining, false);
+        dispatch_semaphore_wait(drainFinished, DISPATCH_TIME_FOREVER);
         return;
     }
     _isRunning = true;
@@ -100,12 +205,32 @@ static void recorderCallBack(void *aqData,
 {
     if (self.isRunning) {
         AudioQueueStop(queueRef, true);
+        atomic_store(&capturing, false);
         _isRunning = false;
 
+        // The queue has stopped calling back, so the ring holds all captured audio.
+        atomic_store(&draining, false);
+        dispatch_semaphore_wait(drainFinished, DISPATCH_TIME_FOREVER);
+
         [[AVAudioSession sharedInstance] setActive:false
                                        withOptions:AVAudioSessionSetActiveOptionNotifyOthersOnDeactivation
                                              error:nil];
     }
 }
 
+- (NSUInteger)overrunCount
+{
+    return (NSUInteger)atomic_load_explicit(&ring.overruns, memory_order_relaxed);
+}
+
+- (NSUInteger)overrunBytes
+{
+    return (NSUInteger)atomic_load_explicit(&ring.overrunBytes, memory_order_relaxed);
+}
+
+- (NSUInteger)maxFillBytes
+{
+    return (NSUInteger)atomic_load_explicit(&ring.maxFill, memory_order_relaxed);
+}
+
 @end
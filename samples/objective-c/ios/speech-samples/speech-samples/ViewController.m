@@ -716,6 +716,9 @@
     }
 
     [self->recorder stop];
+    NSLog(@"Audio capture: %lu overruns, %lu bytes dropped, at most %lu of %lu bytes buffered.",
+          (unsigned long)self->recorder.overrunCount, (unsigned long)self->recorder.overrunBytes,
+          (unsigned long)self->recorder.maxFillBytes, (unsigned long)self->recorder.ringCapacity);
 }
 
 /*